@@ -0,0 +1,81 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * per-stage cycle accounting of data path, for benchmark only.
+ *
+ * build with CONFIG_DPVS_BENCH to enable, the macros are empty otherwise.
+ * in bench builds rx of all ports is held after start-up until enabled
+ * by "dpip bench set rx on", so that a replayed pcap is not consumed
+ * before services are configured. see test/bench/.
+ */
+#ifndef __DPVS_BENCH_H__
+#define __DPVS_BENCH_H__
+#include "dpdk.h"
+#include "conf/bench.h"
+
+#define RTE_LOGTYPE_BENCH   RTE_LOGTYPE_USER1
+
+#ifdef CONFIG_DPVS_BENCH
+
+struct dpvs_bench_stats {
+    uint64_t    calls;
+    uint64_t    pkts;
+    uint64_t    cycles;
+};
+
+struct dpvs_bench_lcore {
+    uint32_t                reset_gen;
+    struct dpvs_bench_stats stats[DPVS_BENCH_STAGE_MAX];
+} __rte_cache_aligned;
+
+extern struct dpvs_bench_lcore dpvs_bench_lcores[DPVS_MAX_LCORE];
+extern volatile uint32_t dpvs_bench_reset_gen;
+extern volatile bool dpvs_bench_rx_on;
+
+static inline void dpvs_bench_account(int stage, uint64_t cycles, uint32_t pkts)
+{
+    struct dpvs_bench_lcore *b = &dpvs_bench_lcores[rte_lcore_id()];
+
+    /* reset is requested by master, done by owner lcore */
+    if (unlikely(b->reset_gen != dpvs_bench_reset_gen)) {
+        memset(b->stats, 0, sizeof(b->stats));
+        b->reset_gen = dpvs_bench_reset_gen;
+    }
+
+    b->stats[stage].calls++;
+    b->stats[stage].pkts += pkts;
+    b->stats[stage].cycles += cycles;
+}
+
+#define DPVS_BENCH_START(tsc)           uint64_t tsc = rte_rdtsc()
+#define DPVS_BENCH_END(stage, tsc, n)   \
+    dpvs_bench_account((stage), rte_rdtsc() - (tsc), (n))
+#define DPVS_BENCH_RX_HELD()            (unlikely(!dpvs_bench_rx_on))
+
+#else
+
+#define DPVS_BENCH_START(tsc)           do {} while (0)
+#define DPVS_BENCH_END(stage, tsc, n)   do {} while (0)
+#define DPVS_BENCH_RX_HELD()            (false)
+
+#endif /* CONFIG_DPVS_BENCH */
+
+int dpvs_bench_init(void);
+int dpvs_bench_term(void);
+
+#endif /* __DPVS_BENCH_H__ */
@@ -0,0 +1,80 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#ifndef __DPVS_BENCH_CONF_H__
+#define __DPVS_BENCH_CONF_H__
+#include <stdint.h>
+
+enum {
+    /* set */
+    SOCKOPT_SET_BENCH_RESET = 1200,
+    SOCKOPT_SET_BENCH_RX,
+
+    /* get */
+    SOCKOPT_GET_BENCH_SHOW,
+};
+
+/* data path stages measured, timing is inclusive of nested stages */
+enum {
+    DPVS_BENCH_RX           = 0,    /* rx burst, non-empty only */
+    DPVS_BENCH_L2,                  /* L2 filter and deliver, per burst */
+    DPVS_BENCH_IPV4,                /* ipv4_rcv */
+    DPVS_BENCH_IPV6,                /* ipv6_rcv */
+    DPVS_BENCH_IPVS_IN,             /* ipvs PRE_ROUTING hook */
+    DPVS_BENCH_SCHED,               /* RS scheduling and conn creation */
+    DPVS_BENCH_TX,                  /* tx burst */
+    DPVS_BENCH_STAGE_MAX,
+};
+
+static const char *dpvs_bench_stage_names[DPVS_BENCH_STAGE_MAX] = {
+    [DPVS_BENCH_RX]         = "rx",
+    [DPVS_BENCH_L2]         = "l2",
+    [DPVS_BENCH_IPV4]       = "ipv4",
+    [DPVS_BENCH_IPV6]       = "ipv6",
+    [DPVS_BENCH_IPVS_IN]    = "ipvs_in",
+    [DPVS_BENCH_SCHED]      = "sched",
+    [DPVS_BENCH_TX]         = "tx",
+};
+
+static inline const char *dpvs_bench_stage_name(int stage)
+{
+    if (stage < 0 || stage >= DPVS_BENCH_STAGE_MAX)
+        return "<unknow>";
+    return dpvs_bench_stage_names[stage];
+}
+
+struct dp_vs_bench_rx_conf {
+    uint8_t     enable;             /* 0 holds rx of all ports */
+} __attribute__((__packed__));
+
+struct dp_vs_bench_entry {
+    uint8_t     cid;
+    uint8_t     stage;
+    uint64_t    calls;
+    uint64_t    pkts;
+    uint64_t    cycles;
+} __attribute__((__packed__));
+
+struct dp_vs_bench_conf_array {
+    uint8_t     enabled;            /* built with CONFIG_DPVS_BENCH */
+    uint8_t     rx_enabled;
+    uint64_t    tsc_hz;
+    uint32_t    nentry;
+    struct dp_vs_bench_entry entries[0];
+} __attribute__((__packed__));
+
+#endif /* __DPVS_BENCH_CONF_H__ */
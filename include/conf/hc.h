@@ -0,0 +1,119 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * Note: control plane only
+ * based on dpvs_sockopt.
+ */
+#ifndef __DPVS_HC_CONF_H__
+#define __DPVS_HC_CONF_H__
+#include "inet.h"
+
+enum {
+    /* set */
+    SOCKOPT_SET_HC_ADD      = 1300,
+    SOCKOPT_SET_HC_DEL,
+    /* get */
+    SOCKOPT_GET_HC_SHOW,
+};
+
+/* probe types */
+enum {
+    DP_VS_HC_TCP            = 1,    /* SYN, expect SYN-ACK */
+    DP_VS_HC_HTTP,                  /* GET, expect status line */
+    DP_VS_HC_UDP,                   /* payload, expect any reply */
+};
+
+/* probe state of a real server */
+enum {
+    DP_VS_HC_ST_UP          = 0,
+    DP_VS_HC_ST_DOWN,
+    DP_VS_HC_ST_SUPPRESSED,         /* up, but held down by flap damping */
+};
+
+/* result of the last probe */
+enum {
+    DP_VS_HC_RES_NONE       = 0,
+    DP_VS_HC_RES_OK,
+    DP_VS_HC_RES_TIMEOUT,
+    DP_VS_HC_RES_REFUSED,           /* TCP RST */
+    DP_VS_HC_RES_BAD_STATUS,        /* unexpected HTTP status */
+    DP_VS_HC_RES_NO_SOURCE,         /* no LIP/port from sa_pool */
+    DP_VS_HC_RES_NO_ROUTE,
+    DP_VS_HC_RES_MAX,
+};
+
+#define DP_VS_HC_PATH_LEN       64
+#define DP_VS_HC_PAYLOAD_LEN    64
+
+struct dp_vs_hc_conf {
+    /* identify service */
+    int                 af;
+    uint8_t             proto;
+    union inet_addr     vaddr;
+    uint16_t            vport;
+    uint32_t            fwmark;
+
+    /* for add */
+    uint8_t             type;       /* DP_VS_HC_XXX */
+    int                 saf;        /* af of saddr, AF_UNSPEC: by route */
+    union inet_addr     saddr;      /* source LIP, must have sapool */
+    uint16_t            port;       /* probe port, 0 for dest port */
+    uint32_t            interval;   /* ms */
+    uint32_t            timeout;    /* ms */
+    uint16_t            rise;       /* successes to be up */
+    uint16_t            fall;       /* failures to be down */
+    uint16_t            damp_halflife;  /* seconds, 0 to disable damping */
+    uint16_t            http_status;    /* 0 for any 2xx/3xx */
+    char                path[DP_VS_HC_PATH_LEN];
+    uint16_t            payload_len;
+    uint8_t             payload[DP_VS_HC_PAYLOAD_LEN];
+};
+
+struct dp_vs_hc_entry {
+    /* service */
+    int                 af;
+    uint8_t             proto;
+    union inet_addr     vaddr;
+    uint16_t            vport;
+    uint32_t            fwmark;
+
+    /* real server */
+    int                 daf;
+    union inet_addr     daddr;
+    uint16_t            dport;      /* probe port */
+
+    uint8_t             type;
+    uint8_t             state;      /* DP_VS_HC_ST_XXX */
+    uint8_t             result;     /* DP_VS_HC_RES_XXX */
+    uint8_t             cid;        /* probing lcore */
+    uint32_t            rtt_us;     /* last successful probe */
+    uint32_t            srtt_us;    /* smoothed */
+    uint32_t            penalty;    /* flap damping */
+    uint32_t            flaps;
+    uint64_t            probes;
+    uint64_t            succ;
+    uint64_t            fail;
+    uint32_t            since;      /* seconds in current state */
+} __attribute__((__packed__));
+
+struct dp_vs_hc_entry_array {
+    int                 nentry;
+    struct dp_vs_hc_entry   entries[0];
+} __attribute__((__packed__));
+
+#endif /* __DPVS_HC_CONF_H__ */
@@ -0,0 +1,55 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * Note: control plane only
+ * based on dpvs_sockopt.
+ */
+#ifndef __DPVS_ICMP_CONF_H__
+#define __DPVS_ICMP_CONF_H__
+#include <stdint.h>
+
+enum {
+    /* set */
+    SOCKOPT_SET_ICMP        = 1400,
+    /* get */
+    SOCKOPT_GET_ICMP_RL,
+};
+
+/* ICMP/ICMPv6 error rate limit of an lcore */
+struct icmp_rl_stats {
+    uint64_t            passed;
+    uint64_t            host_limited;   /* by per-destination bucket */
+    uint64_t            global_limited; /* by per-lcore cap */
+    uint64_t            evicted;        /* bucket taken by another prefix */
+} __attribute__((__packed__));
+
+struct icmp_rl_param {
+    uint32_t            ratelimit;      /* ms, 0: per-destination off */
+    uint32_t            ratelimit_burst;
+    uint32_t            ratemask;       /* ICMPv4 types limited */
+    uint8_t             prefix_len;
+    uint8_t             prefix6_len;
+    uint32_t            msgs_per_sec;   /* per lcore, 0: cap off */
+    uint32_t            msgs_burst;
+    uint32_t            buckets;        /* per lcore */
+
+    struct icmp_rl_stats    stats;
+    struct icmp_rl_stats    stats_cpus[DPVS_MAX_LCORE];
+} __attribute__((__packed__));
+
+#endif /* __DPVS_ICMP_CONF_H__ */
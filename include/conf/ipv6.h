@@ -29,6 +29,7 @@ enum {
     SOCKOPT_IP6_SET = 1100,
     /* get */
     SOCKOPT_IP6_STATS,
+    SOCKOPT_IP6_FRAG,
 };
 
 struct ip6_stats_param {
@@ -36,4 +37,26 @@ struct ip6_stats_param {
     struct inet_stats stats_cpus[DPVS_MAX_LCORE];
 } __attribute__((__packed__));
 
+/* reassembly table of an lcore */
+struct ip6_frag_stats {
+    uint32_t            use_entries;    /* datagrams being reassembled */
+    uint64_t            add_num;
+    uint64_t            del_num;
+    uint64_t            reuse_num;      /* reclaimed on timeout */
+    uint64_t            fail_total;
+    uint64_t            fail_nospace;   /* table is full */
+} __attribute__((__packed__));
+
+struct ip6_frag_param {
+    /* limits of each lcore */
+    uint32_t            buckets;
+    uint32_t            bucket_entries;
+    uint32_t            max_entries;
+    uint32_t            max_frags;      /* fragments of a datagram */
+    uint32_t            ttl;            /* seconds */
+
+    struct ip6_frag_stats   stats;
+    struct ip6_frag_stats   stats_cpus[DPVS_MAX_LCORE];
+} __attribute__((__packed__));
+
 #endif /* __DPVS_IPV6_CONF_H__ */
@@ -28,6 +28,7 @@
 
 #define RTE_ETHDEV_QUEUE_STAT_CNTRS     16
 #define NETIF_MAX_BOND_SLAVES           32
+#define NETIF_LCORE_MAX_TXQ_STATS       16
 
 typedef uint8_t lcoreid_t;
 typedef uint16_t portid_t;
@@ -45,6 +46,7 @@ enum {
     SOCKOPT_NETIF_GET_PORT_STATS,
     SOCKOPT_NETIF_GET_PORT_EXT_INFO,
     SOCKOPT_NETIF_GET_BOND_STATUS,
+    SOCKOPT_NETIF_GET_LCORE_NUMA,
     SOCKOPT_NETIF_GET_MAX,
     /* set */
     SOCKOPT_NETIF_SET_LCORE = 500,
@@ -61,6 +63,10 @@ typedef struct netif_lcore_mask_get
     uint8_t isol_rx_lcore_num;
     uint64_t slave_lcore_mask;
     uint64_t isol_rx_lcore_mask;
+    uint8_t kni_lcore_num;  /* 0: KNI I/O on master */
+    lcoreid_t kni_lcore_id;
+    uint8_t neigh_lcore_num;  /* 0: neighbour relay by workers */
+    lcoreid_t neigh_lcore_id;
 } netif_lcore_mask_get_t;
 
 /* basic lcore info specified by lcore_id  */
@@ -72,6 +78,26 @@ typedef struct netif_lcore_basic_get
     char queue_data[0];
 } netif_lcore_basic_get_t;
 
+/* NUMA placement of a rx/tx queue processed by lcore_id */
+struct netif_lcore_numa_entry
+{
+    char port_name[IFNAMSIZ];
+    queueid_t qid;
+    uint8_t is_rx;
+    uint8_t port_socket;    /* NIC socket */
+    uint8_t pool_socket;    /* rx mbuf pool socket */
+};
+
+typedef struct netif_lcore_numa_get
+{
+    lcoreid_t lcore_id;
+    uint8_t socket_id;
+    uint8_t arp_ring_socket;
+    uint16_t nremote;       /* number of remote socket placements */
+    uint16_t nentries;
+    struct netif_lcore_numa_entry entries[0];
+} netif_lcore_numa_get_t;
+
 /* statistics info of lcore_id */
 typedef struct netif_lcore_stats_get
 {
@@ -87,6 +113,15 @@ typedef struct netif_lcore_stats_get
     uint64_t opackets;
     uint64_t obytes;
     uint64_t dropped; // software packet drop
+    uint64_t txretry; // packets kept for tx retry
+    uint64_t txdrop;  // packets dropped on full tx queues
+    uint16_t ntxq;
+    struct netif_txq_stats_get {
+        portid_t pid;
+        queueid_t qid;
+        uint64_t retried;
+        uint64_t dropped;
+    } txqs[NETIF_LCORE_MAX_TXQ_STATS];
 } netif_lcore_stats_get_t;
 
 struct port_id_name
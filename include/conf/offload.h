@@ -0,0 +1,60 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * Note: control plane only
+ * based on dpvs_sockopt.
+ */
+#ifndef __DPVS_OFFLOAD_CONF_H__
+#define __DPVS_OFFLOAD_CONF_H__
+#include <stdint.h>
+
+enum {
+    /* set */
+    SOCKOPT_SET_OFFLOAD     = 1600,
+    /* get */
+    SOCKOPT_GET_OFFLOAD,
+};
+
+enum {
+    DP_VS_OFFLOAD_RTE_FLOW  = 0,    /* NIC rules by rte_flow */
+    DP_VS_OFFLOAD_SW,               /* software emulation of NIC rules */
+};
+
+/* flow offload of an lcore */
+struct dp_vs_offload_stats {
+    uint64_t            added;      /* rules installed */
+    uint64_t            removed;    /* rules removed as conns expired */
+    uint64_t            evicted;    /* rules replaced by hotter flows */
+    uint64_t            failed;     /* rules refused by NIC */
+    uint64_t            hits;       /* packets found conn by mark */
+    uint64_t            stale;      /* marks not matching the slot's conn */
+    uint32_t            used;       /* slots in use */
+    uint32_t            slots;
+} __attribute__((__packed__));
+
+struct dp_vs_offload_param {
+    uint8_t             enable;
+    uint8_t             backend;
+    uint32_t            max_rules;
+    uint32_t            threshold;  /* packets before offload */
+
+    struct dp_vs_offload_stats stats;
+    struct dp_vs_offload_stats stats_cpus[DPVS_MAX_LCORE];
+} __attribute__((__packed__));
+
+#endif /* __DPVS_OFFLOAD_CONF_H__ */
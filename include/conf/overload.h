@@ -0,0 +1,73 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * Note: control plane only
+ * based on dpvs_sockopt.
+ */
+#ifndef __DPVS_OVERLOAD_CONF_H__
+#define __DPVS_OVERLOAD_CONF_H__
+#include <stdint.h>
+#include "inet.h"
+
+enum {
+    /* set */
+    SOCKOPT_SET_OVERLOAD    = 1500,
+    /* get */
+    SOCKOPT_GET_OVERLOAD,
+};
+
+enum {
+    DP_VS_SHED_DROP         = 0,    /* drop new flows */
+    DP_VS_SHED_RST,                 /* reset new TCP flows, drop others */
+    DP_VS_SHED_SYNCOOKIE,           /* answer SYNs with cookies only */
+};
+
+/* overload protection of an lcore */
+struct dp_vs_overload_stats {
+    uint64_t            enters;     /* times entered overload */
+    uint64_t            overload_ms;/* time spent overloaded */
+    uint64_t            shed;       /* new flows not scheduled */
+    uint64_t            rst;        /* RSTs sent to shed flows */
+    uint64_t            syncookie;  /* SYNs answered by cookie for overload */
+    uint64_t            svc_shed;   /* "shed" of the requested service */
+    uint8_t             overloaded;
+    uint8_t             busy;       /* % of cycles on rx bursts, smoothed */
+    uint8_t             rxq;        /* % of rx descriptors in use, max */
+} __attribute__((__packed__));
+
+struct dp_vs_overload_param {
+    /* service to show shed of, optional */
+    int                 af;
+    uint8_t             proto;
+    union inet_addr     vaddr;
+    uint16_t            vport;
+    uint32_t            fwmark;
+
+    uint8_t             enable;
+    uint8_t             policy;
+    uint8_t             busy_high;
+    uint8_t             busy_low;
+    uint8_t             rxq_high;
+    uint8_t             rxq_low;
+    uint32_t            hold_ms;
+
+    struct dp_vs_overload_stats stats;
+    struct dp_vs_overload_stats stats_cpus[DPVS_MAX_LCORE];
+} __attribute__((__packed__));
+
+#endif /* __DPVS_OVERLOAD_CONF_H__ */
@@ -0,0 +1,136 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * always-on data path profiling, see include/prof.h.
+ */
+#ifndef __DPVS_PROF_CONF_H__
+#define __DPVS_PROF_CONF_H__
+#include <stdint.h>
+
+enum {
+    /* set */
+    SOCKOPT_SET_PROF        = 1700,
+    SOCKOPT_SET_PROF_RESET,
+
+    /* get */
+    SOCKOPT_GET_PROF_SHOW,
+};
+
+/* data path stages timed, timing is inclusive of nested stages */
+enum {
+    DPVS_PROF_RX            = 0,    /* rx burst, non-empty only */
+    DPVS_PROF_HOOK,                 /* inet hook chain, without okfn */
+    DPVS_PROF_CONN_LOOKUP,          /* ipvs conn lookup */
+    DPVS_PROF_SCHED,                /* RS scheduling and conn creation */
+    DPVS_PROF_XMIT,                 /* ipvs packet xmit to RS/client */
+    DPVS_PROF_TX_FLUSH,             /* tx burst */
+    DPVS_PROF_TIMER,                /* rte_timer_manage */
+    DPVS_PROF_MSG,                  /* lcore msg processing */
+    DPVS_PROF_STAGE_MAX,
+};
+
+static const char *dpvs_prof_stage_names[DPVS_PROF_STAGE_MAX] = {
+    [DPVS_PROF_RX]          = "rx",
+    [DPVS_PROF_HOOK]        = "hook",
+    [DPVS_PROF_CONN_LOOKUP] = "conn_lookup",
+    [DPVS_PROF_SCHED]       = "sched",
+    [DPVS_PROF_XMIT]        = "xmit",
+    [DPVS_PROF_TX_FLUSH]    = "tx_flush",
+    [DPVS_PROF_TIMER]       = "timer",
+    [DPVS_PROF_MSG]         = "msg",
+};
+
+static inline const char *dpvs_prof_stage_name(int stage)
+{
+    if (stage < 0 || stage >= DPVS_PROF_STAGE_MAX)
+        return "<unknow>";
+    return dpvs_prof_stage_names[stage];
+}
+
+/*
+ * log-linear histogram of TSC cycles: values below DPVS_PROF_HIST_SUB
+ * have a bucket each, then every power of 2 is split into
+ * DPVS_PROF_HIST_SUB linear buckets, so the relative error is < 25%.
+ * values beyond the last bucket are counted in it.
+ */
+#define DPVS_PROF_HIST_SUB_BITS 2
+#define DPVS_PROF_HIST_SUB      (1 << DPVS_PROF_HIST_SUB_BITS)
+#define DPVS_PROF_HIST_BUCKETS  160     /* up to 2^40 cycles */
+
+static inline int dpvs_prof_hist_bucket(uint64_t cycles)
+{
+    int msb, idx;
+
+    if (cycles < DPVS_PROF_HIST_SUB)
+        return (int)cycles;
+
+    msb = 63 - __builtin_clzll(cycles);
+    idx = ((msb - DPVS_PROF_HIST_SUB_BITS + 1) << DPVS_PROF_HIST_SUB_BITS) +
+          ((cycles >> (msb - DPVS_PROF_HIST_SUB_BITS)) & (DPVS_PROF_HIST_SUB - 1));
+
+    return idx < DPVS_PROF_HIST_BUCKETS ? idx : DPVS_PROF_HIST_BUCKETS - 1;
+}
+
+/* lowest value of bucket @idx, the inverse of dpvs_prof_hist_bucket */
+static inline uint64_t dpvs_prof_hist_lower(int idx)
+{
+    int msb;
+
+    if (idx < DPVS_PROF_HIST_SUB)
+        return idx;
+
+    msb = (idx >> DPVS_PROF_HIST_SUB_BITS) + DPVS_PROF_HIST_SUB_BITS - 1;
+    return (uint64_t)(DPVS_PROF_HIST_SUB + (idx & (DPVS_PROF_HIST_SUB - 1)))
+           << (msb - DPVS_PROF_HIST_SUB_BITS);
+}
+
+#define DPVS_PROF_NAME_LEN      32
+#define DPVS_PROF_JOB_MAX       16
+
+/* kind of a histogram in dp_vs_prof_hist */
+enum {
+    DPVS_PROF_KIND_STAGE    = 0,    /* @id is DPVS_PROF_XXX stage */
+    DPVS_PROF_KIND_JOB,             /* @id is lcore loop job, see @name */
+    DPVS_PROF_KIND_LOOP,            /* a whole lcore loop */
+};
+
+struct dp_vs_prof_conf {
+    uint8_t     enable;
+    uint32_t    sample;             /* 1 of @sample, power of 2, 0 keeps */
+} __attribute__((__packed__));
+
+struct dp_vs_prof_hist {
+    uint8_t     cid;
+    uint8_t     kind;
+    uint8_t     id;
+    char        name[DPVS_PROF_NAME_LEN];
+    uint64_t    count;
+    uint64_t    cycles;             /* sum */
+    uint64_t    max;
+    uint64_t    buckets[DPVS_PROF_HIST_BUCKETS];
+} __attribute__((__packed__));
+
+struct dp_vs_prof_conf_array {
+    uint8_t     enabled;
+    uint32_t    sample;
+    uint64_t    tsc_hz;
+    uint32_t    nhist;
+    struct dp_vs_prof_hist hists[0];
+} __attribute__((__packed__));
+
+#endif /* __DPVS_PROF_CONF_H__ */
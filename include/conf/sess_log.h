@@ -0,0 +1,49 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * Note: control plane only
+ * based on dpvs_sockopt.
+ */
+#ifndef __DPVS_SESS_LOG_CONF_H__
+#define __DPVS_SESS_LOG_CONF_H__
+#include <stdint.h>
+
+enum {
+    /* set */
+    SOCKOPT_SET_SESS_LOG    = 1900,
+    /* get */
+    SOCKOPT_GET_SESS_LOG,
+};
+
+struct dp_vs_sess_log_stats {
+    uint64_t            logged;     /* records queued to exporter */
+    uint64_t            dropped;    /* no free record, exporter behind */
+    uint64_t            pending;    /* records queued, not exported yet */
+} __attribute__((__packed__));
+
+struct dp_vs_sess_log_param {
+    uint8_t             enable;
+    uint32_t            ring_size;
+    uint64_t            exported;   /* records in messages sent */
+    uint64_t            export_err; /* messages failed to send or write */
+
+    struct dp_vs_sess_log_stats stats;
+    struct dp_vs_sess_log_stats stats_cpus[DPVS_MAX_LCORE];
+} __attribute__((__packed__));
+
+#endif /* __DPVS_SESS_LOG_CONF_H__ */
@@ -0,0 +1,203 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * layout of the statistics shared memory segment, published by dpvs
+ * and read by external scrapers without talking to dpvs.
+ *
+ *   +--------------------+ 0
+ *   | dpvs_shm_hdr       |
+ *   +--------------------+ lcore_off
+ *   | dpvs_shm_lcore     | x max_lcores, indexed by lcore id
+ *   +--------------------+ port_off
+ *   | dpvs_shm_port      | x max_ports
+ *   +--------------------+ dest_off
+ *   | dpvs_shm_dest      | x max_dests
+ *   +--------------------+ dest_stats_off
+ *   | dpvs_shm_stats     | x max_dests x max_lcores, [dest][lcore]
+ *   +--------------------+ size
+ *
+ * lcore, port and dest slots are seqlock protected, each has a single
+ * writer: the lcore itself for lcore slots, master for the others.
+ * dest counters are live, written by lcores on the data path; each is
+ * a naturally aligned 64-bit word of a single writer, so readers never
+ * see it torn, but fields of a slot may be a packet apart.
+ */
+#ifndef __DPVS_STATS_SHM_CONF_H__
+#define __DPVS_STATS_SHM_CONF_H__
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DPVS_SHM_MAGIC          0x44505653  /* "DPVS" */
+#define DPVS_SHM_VERSION        1
+#define DPVS_SHM_ALIGN          64
+#define DPVS_SHM_NAME_DEF       "/dpvs-stats"
+#define DPVS_SHM_IFNAMSIZ       16
+
+struct dpvs_shm_hdr {
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    pid;                /* of dpvs */
+    volatile uint32_t ready;        /* 0 while creating or destroying */
+    uint64_t    size;               /* of the segment */
+    uint64_t    start_time;         /* epoch seconds dpvs started */
+    uint64_t    tsc_hz;
+
+    /* sizes let readers detect a layout mismatch */
+    uint32_t    lcore_size;
+    uint32_t    port_size;
+    uint32_t    dest_size;
+    uint32_t    stats_size;
+
+    uint32_t    max_lcores;
+    uint32_t    max_ports;
+    uint32_t    max_dests;
+    uint32_t    pad;
+
+    uint64_t    lcore_off;
+    uint64_t    port_off;
+    uint64_t    dest_off;
+    uint64_t    dest_stats_off;
+} __attribute__((aligned(DPVS_SHM_ALIGN)));
+
+/* counters of a data path lcore, refreshed every few loops */
+struct dpvs_shm_lcore {
+    volatile uint32_t seq;
+    uint32_t    active;             /* lcore forwards packets */
+    uint64_t    update_tsc;         /* when last published */
+
+    /* netif */
+    uint64_t    loops;
+    uint64_t    ipackets;
+    uint64_t    ibytes;
+    uint64_t    opackets;
+    uint64_t    obytes;
+    uint64_t    dropped;
+    uint64_t    txdrop;
+    uint64_t    busy_cycles;
+
+    /* ipvs */
+    uint64_t    conns;              /* created */
+    uint64_t    inpkts;
+    uint64_t    inbytes;
+    uint64_t    outpkts;
+    uint64_t    outbytes;
+    uint32_t    conn_count;         /* current */
+} __attribute__((aligned(DPVS_SHM_ALIGN)));
+
+/* counters of a netif port, refreshed every second */
+struct dpvs_shm_port {
+    volatile uint32_t seq;
+    uint32_t    active;
+    uint32_t    port_id;
+    char        name[DPVS_SHM_IFNAMSIZ];
+
+    uint64_t    ipackets;
+    uint64_t    opackets;
+    uint64_t    ibytes;
+    uint64_t    obytes;
+    uint64_t    imissed;
+    uint64_t    ierrors;
+    uint64_t    oerrors;
+    uint64_t    rx_nombuf;
+} __attribute__((aligned(DPVS_SHM_ALIGN)));
+
+/* a real server of a service, @gen changes whenever the slot is reused */
+struct dpvs_shm_dest {
+    volatile uint32_t seq;
+    uint32_t    active;
+    uint32_t    gen;
+    uint8_t     af;
+    uint8_t     proto;
+    uint16_t    vport;              /* network order */
+    uint32_t    fwmark;
+    uint16_t    port;               /* network order */
+    uint16_t    weight;
+    uint8_t     vaddr[16];          /* in_addr or in6_addr */
+    uint8_t     addr[16];
+
+    /* refreshed every second */
+    uint32_t    actconns;
+    uint32_t    inactconns;
+    uint32_t    persistconns;
+} __attribute__((aligned(DPVS_SHM_ALIGN)));
+
+/* same layout as struct dp_vs_stats, which lives here for exported dests */
+struct dpvs_shm_stats {
+    uint64_t    conns;
+    uint64_t    inpkts;
+    uint64_t    inbytes;
+    uint64_t    outpkts;
+    uint64_t    outbytes;
+
+    uint32_t    cps;
+    uint32_t    inpps;
+    uint32_t    inbps;
+    uint32_t    outpps;
+    uint32_t    outbps;
+};
+
+static inline struct dpvs_shm_lcore *
+dpvs_shm_lcore(const struct dpvs_shm_hdr *hdr, unsigned cid)
+{
+    return (struct dpvs_shm_lcore *)((char *)hdr + hdr->lcore_off) + cid;
+}
+
+static inline struct dpvs_shm_port *
+dpvs_shm_port(const struct dpvs_shm_hdr *hdr, unsigned idx)
+{
+    return (struct dpvs_shm_port *)((char *)hdr + hdr->port_off) + idx;
+}
+
+static inline struct dpvs_shm_dest *
+dpvs_shm_dest(const struct dpvs_shm_hdr *hdr, unsigned idx)
+{
+    return (struct dpvs_shm_dest *)((char *)hdr + hdr->dest_off) + idx;
+}
+
+static inline struct dpvs_shm_stats *
+dpvs_shm_dest_stats(const struct dpvs_shm_hdr *hdr, unsigned idx)
+{
+    return (struct dpvs_shm_stats *)((char *)hdr + hdr->dest_stats_off) +
+           (uint64_t)idx * hdr->max_lcores;
+}
+
+/*
+ * seqlock of readers, bound the retries in case dpvs died in the middle
+ * of an update:
+ *
+ *   do {
+ *       seq = dpvs_shm_read_begin(&slot->seq);
+ *       copy = *slot;
+ *   } while (dpvs_shm_read_retry(&slot->seq, seq) && --tries > 0);
+ */
+static inline uint32_t dpvs_shm_read_begin(const volatile uint32_t *seq)
+{
+    uint32_t s = *seq;
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return s;
+}
+
+static inline bool dpvs_shm_read_retry(const volatile uint32_t *seq,
+                                       uint32_t s)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (s & 1) || *seq != s;    /* odd: writer in progress */
+}
+
+#endif /* __DPVS_STATS_SHM_CONF_H__ */
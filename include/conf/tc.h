@@ -48,6 +48,15 @@ typedef enum {
 /**
  * scheduler section
  */
+/* fq_codel, per lcore */
+struct tc_fq_codel_qopt {
+    uint32_t        limit;              /* packets */
+    uint32_t        flows;
+    uint32_t        quantum;            /* bytes */
+    uint32_t        target;             /* us */
+    uint32_t        interval;           /* us */
+} __attribute__((__packed__));
+
 struct tc_qsch_param {
     tc_handle_t     handle;
     tc_handle_t     where;              /* TC_H_ROOT | TC_H_INGRESS | parent */
@@ -57,6 +66,7 @@ struct tc_qsch_param {
         struct tc_tbf_qopt tbf;
         struct tc_fifo_qopt fifo;
         struct tc_prio_qopt prio;       /* pfifo_fast ... */
+        struct tc_fq_codel_qopt fq_codel;
     } qopt;
 
     /* get only */
@@ -0,0 +1,94 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * warm restart, see include/ipvs/warm.h.
+ */
+#ifndef __DPVS_WARM_CONF_H__
+#define __DPVS_WARM_CONF_H__
+#include <stdint.h>
+
+enum {
+    /* set */
+    SOCKOPT_SET_WARM_SAVE   = 1800,
+    SOCKOPT_SET_WARM_RESTORE,
+
+    /* get */
+    SOCKOPT_GET_WARM_SHOW,
+};
+
+/* why a conn is not saved or restored */
+enum {
+    DP_VS_WARM_SKIP_EXPIRED = 0,    /* timed out in between */
+    DP_VS_WARM_SKIP_NOLCORE,        /* lcore not working now */
+    DP_VS_WARM_SKIP_NOSVC,          /* service not configured */
+    DP_VS_WARM_SKIP_NODEST,         /* real server not configured */
+    DP_VS_WARM_SKIP_NOLPORT,        /* <lip:lport> missing or taken */
+    DP_VS_WARM_SKIP_EXIST,          /* conn is already there */
+    DP_VS_WARM_SKIP_SYNPROXY,       /* packets held by synproxy */
+    DP_VS_WARM_SKIP_NOROOM,         /* lcore's section is full */
+    DP_VS_WARM_SKIP_OTHER,
+    DP_VS_WARM_SKIP_MAX,
+};
+
+static const char *dp_vs_warm_skip_names[DP_VS_WARM_SKIP_MAX] = {
+    [DP_VS_WARM_SKIP_EXPIRED]   = "expired",
+    [DP_VS_WARM_SKIP_NOLCORE]   = "no_lcore",
+    [DP_VS_WARM_SKIP_NOSVC]     = "no_service",
+    [DP_VS_WARM_SKIP_NODEST]    = "no_dest",
+    [DP_VS_WARM_SKIP_NOLPORT]   = "no_lport",
+    [DP_VS_WARM_SKIP_EXIST]     = "exist",
+    [DP_VS_WARM_SKIP_SYNPROXY]  = "synproxy",
+    [DP_VS_WARM_SKIP_NOROOM]    = "no_room",
+    [DP_VS_WARM_SKIP_OTHER]     = "other",
+};
+
+static inline const char *dp_vs_warm_skip_name(int reason)
+{
+    if (reason < 0 || reason >= DP_VS_WARM_SKIP_MAX)
+        return "<unknow>";
+    return dp_vs_warm_skip_names[reason];
+}
+
+enum {
+    DP_VS_WARM_OP_NONE      = 0,
+    DP_VS_WARM_OP_SAVE,
+    DP_VS_WARM_OP_RESTORE,
+};
+
+/* one lcore's part of a save or restore */
+struct dp_vs_warm_stats {
+    uint32_t    conns;              /* saved or restored */
+    uint32_t    skipped[DP_VS_WARM_SKIP_MAX];
+    uint32_t    usecs;              /* time the lcore spent */
+} __attribute__((__packed__));
+
+/* the last save or restore */
+struct dp_vs_warm_report {
+    char        file[256];
+    uint8_t     op;                 /* DP_VS_WARM_OP_XXX */
+    int32_t     result;             /* EDPVS_XXX */
+    uint64_t    time;               /* when it's done, seconds since epoch */
+    uint32_t    usecs;              /* wall time of the operation */
+    uint32_t    age_ms;             /* restore: age of the file */
+    uint32_t    max_age;            /* restore: file older is refused, sec */
+
+    struct dp_vs_warm_stats total;
+    struct dp_vs_warm_stats lcores[DPVS_MAX_LCORE];
+} __attribute__((__packed__));
+
+#endif /* __DPVS_WARM_CONF_H__ */
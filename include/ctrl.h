@@ -177,6 +177,9 @@ int msg_master_process(int step); /* Master lcore msg loop */
 /* Slave lcore msg process loop */
 int msg_slave_process(int step);  /* Slave lcore msg loop */
 
+/* any msg waiting for lcore @cid */
+bool msg_lcore_pending(lcoreid_t cid);
+
 /* allocator for msg reply data */
 void *msg_reply_alloc(int size);
 void msg_reply_free(void *mptr);
@@ -204,6 +207,11 @@ int msg_dump(const struct dpvs_msg *msg, char *buf, int len);
 #define MSG_TYPE_IPV6_STATS                 16
 #define MSG_TYPE_ROUTE6                     17
 #define MSG_TYPE_NEIGH_GET                  18
+#define MSG_TYPE_IPV6_FRAG_STATS            22
+#define MSG_TYPE_ICMP_RL_STATS              23
+#define MSG_TYPE_OVERLOAD_STATS             24
+#define MSG_TYPE_OFFLOAD_STATS              25
+#define MSG_TYPE_WARM                       26
 
 #define SOCKOPT_VERSION_MAJOR               1
 #define SOCKOPT_VERSION_MINOR               0
@@ -219,6 +227,7 @@ typedef uint32_t sockoptid_t;
 enum sockopt_type {
     SOCKOPT_GET = 0,
     SOCKOPT_SET,
+    SOCKOPT_BATCH,          /* many SETs in one msg, id is not used */
     SOCKOPT_TYPE_MAX,
 };
 
@@ -240,6 +249,37 @@ struct dpvs_sock_msg_reply {
     char data[0];
 };
 
+/*
+ * batch envelope, the data of SOCKOPT_BATCH msg.
+ *
+ * items are applied in order in one pass, each item is padded to 8 bytes.
+ * the reply carries errcode of every item, items not applied because of
+ * SOCKOPT_BATCH_F_STOP_ON_ERR are set to EDPVS_IDLE. errcode of the reply
+ * header is only set if the envelope itself is invalid.
+ */
+#define SOCKOPT_BATCH_F_STOP_ON_ERR         0x1
+#define SOCKOPT_BATCH_MAX                   (1 << 20)
+#define SOCKOPT_BATCH_ITEM_SIZE(len)        \
+    RTE_ALIGN_CEIL(sizeof(struct dpvs_sock_batch_item) + (len), 8)
+
+struct dpvs_sock_batch_hdr {
+    uint32_t nitem;
+    uint32_t flags;
+    char items[0];
+};
+
+struct dpvs_sock_batch_item {
+    sockoptid_t id;
+    uint32_t len;
+    char data[0];
+};
+
+struct dpvs_sock_batch_reply {
+    uint32_t nitem;
+    uint32_t ndone;         /* items applied successfully */
+    int errcode[0];
+};
+
 struct dpvs_sockopts {
     uint32_t version;
     struct list_head list;
@@ -71,5 +71,50 @@ extern int dpvs_log(uint32_t level, uint32_t logtype, const char *func, int line
         RTE_LOGTYPE_ ## t,  __func__, __LINE__, # t ": " __VA_ARGS__) 
 #endif
 
+/*
+ * binary log, for logs on data path.
+ *
+ * usage is the same as RTE_LOG(), but the worker only puts the call site
+ * ID, TSC and raw arguments to a per-lcore ring, formatting and rate
+ * limit (per call site) are done by the log lcore. "%s" arguments are
+ * copied (truncated to DPVS_BLOG_STR_LEN in total), "*" width/precision
+ * is not supported. falls back to RTE_LOG() if async log is off.
+ */
+#define DPVS_BLOG_MAX_ARGS      8
+#define DPVS_BLOG_STR_LEN       128
+
+struct dpvs_log_site {
+    const char          *fmt;
+    const char          *func;
+    int                 line;
+    uint32_t            level;
+    uint32_t            logtype;
+
+    /* set on first use */
+    volatile uint32_t   state;
+    uint16_t            id;
+    uint8_t             nargs;
+    uint8_t             argtypes[DPVS_BLOG_MAX_ARGS];
+
+    /* rate limit, by log lcore only */
+    uint64_t            rl_begin;
+    uint32_t            rl_count;
+    uint32_t            suppressed;
+};
+
+extern int dpvs_blog(struct dpvs_log_site *site, ...);
+
+#define RTE_BLOG(l, t, format, ...)                                 \
+    ({                                                              \
+        static struct dpvs_log_site __blog_site = {                 \
+            .fmt        = # t ": " format,                          \
+            .func       = __func__,                                 \
+            .line       = __LINE__,                                 \
+            .level      = RTE_LOG_ ## l,                            \
+            .logtype    = RTE_LOGTYPE_ ## t,                        \
+        };                                                          \
+        dpvs_blog(&__blog_site, ## __VA_ARGS__);                    \
+    })
+
 
 #endif /* __DPVS_DPDK_H__ */
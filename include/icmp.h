@@ -18,12 +18,19 @@
 #ifndef __DPVS_ICMP_H__
 #define __DPVS_ICMP_H__
 #include <netinet/ip_icmp.h>
+#include "inet.h"
 
 int icmp_init(void);
 int icmp_term(void);
 
 void icmp_send(struct rte_mbuf *imbuf, int type, int code, uint32_t info);
 
+/* rate limit of ICMP/ICMPv6 errors to @daddr, on current lcore */
+bool icmp_ratelimit_allow(int af, const union inet_addr *daddr, int type);
+
+void icmp_keyword_value_init(void);
+void install_icmp_keywords(void);
+
 #define icmp4_id(icmph)      (((icmph)->un).echo.id)
 
 #endif /* __DPVS_ICMP_H__ */
@@ -16,7 +16,7 @@
  *
  */
 /*
- * dpvs IPv4 tunnel common codes.
+ * dpvs IPv4/IPv6 tunnel common codes.
  * refer linux:include/net/ip_tunnels.h
  *       linux:include/uapi/linux/if_tunnel.h
  *
@@ -25,12 +25,17 @@
 #ifndef __DPVS_TUNNEL_H__
 #define __DPVS_TUNNEL_H__
 #include <net/if.h>
+#include <arpa/inet.h>
 #include <netinet/ip.h>
+#include <netinet/ip6.h>
 #include <endian.h>
+#include <string.h>
+#include <stdbool.h>
 #if defined(__DPVS__)
 #include "list.h"
 #include "netif.h"
 #include "route.h"
+#include "route6.h"
 #endif
 
 #define TNLKINDSIZ              16
@@ -71,14 +76,30 @@ struct ip_tunnel_param {
     __be32          i_key;
     __be32          o_key;
     struct iphdr    iph;
+    /* outer header of IPv6 tunnels (ip6ip6, ipip6, ip6gre),
+     * @ip6_nxt is inner protocol and 0x1 in tclass means inherit. */
+    struct ip6_hdr  ip6h;
 } __attribute__((__packed__));
 
+static inline bool ip_tunnel_kind_is_ip6(const char *kind)
+{
+    return strcmp(kind, "ip6ip6") == 0 ||
+           strcmp(kind, "ipip6") == 0 ||
+           strcmp(kind, "ip6gre") == 0;
+}
+
+static inline uint8_t ip6_tnl_tclass(__be32 flow)
+{
+    return (ntohl(flow) >> 20) & 0xff;
+}
+
 #if defined(__DPVS__)
 
 struct ip_tunnel_tab;
 
 struct ip_tunnel_ops {
     const char              *kind;
+    int                     af;         /* family of outer header */
     uint32_t                priv_size;
     struct list_head        list;
     struct ip_tunnel_tab    *tab;
@@ -98,15 +119,37 @@ struct ip_tunnel_tab {
     struct ip_tunnel_ops    *ops;
 };
 
+/*
+ * per-lcore route cache of connected tunnel, with the outer header
+ * prebuilt from it. routes are per-lcore, so the entry is only touched
+ * by its owner and refreshed when route or tunnel generation changes.
+ */
+struct ip_tunnel_dst {
+    union {
+        struct route_entry  *rt4;
+        struct route6       *rt6;
+    };
+    uint32_t                rt_genid;
+    uint32_t                tnl_genid;
+    uint32_t                mtu;
+    union {
+        struct iphdr        iph;
+        struct ip6_hdr      ip6h;
+    } tmpl;
+} __rte_cache_aligned;
+
 struct ip_tunnel {
     struct hlist_node       hlist;
     struct netif_port       *dev;
     struct netif_port       *link;
     struct ip_tunnel_tab    *tab;
     struct ip_tunnel_param  params;
+    int                     af;         /* family of outer header */
     int                     hlen;
 
-    struct route_entry      *rt_cache;
+    /* bumped by master on change, see ip_tunnel_dst */
+    volatile uint32_t       genid;
+    struct ip_tunnel_dst    *dst_cache; /* [DPVS_MAX_LCORE] */
 
     /* GRE only */
     uint32_t                i_seqno;
@@ -133,12 +176,21 @@ struct ip_tunnel *ip_tunnel_lookup(struct ip_tunnel_tab *tab,
                                    __be32 remote, __be32 local,
                                    __be32 key);
 
+struct ip_tunnel *ip6_tunnel_lookup(struct ip_tunnel_tab *tab,
+                                    portid_t link, __be16 flags,
+                                    const struct in6_addr *remote,
+                                    const struct in6_addr *local,
+                                    __be32 key);
+
 int ip_tunnel_rcv(struct ip_tunnel *tnl, struct ip_tunnel_pktinfo *tpi,
                   struct rte_mbuf *mbuf);
 
 int ip_tunnel_xmit(struct rte_mbuf *mbuf, struct netif_port *dev,
                    const struct iphdr *tiph, uint8_t proto);
 
+int ip6_tunnel_xmit(struct rte_mbuf *mbuf, struct netif_port *dev,
+                    const struct ip6_hdr *tip6h, uint8_t proto);
+
 int ip_tunnel_pull_header(struct rte_mbuf *mbuf, int hlen, __be16 in_proto);
 
 int ip_tunnel_get_link(struct netif_port *dev, struct rte_eth_link *link);
@@ -151,5 +203,8 @@ int ipip_term(void);
 int gre_init(void);
 int gre_term(void);
 
+int ip6_tunnel_init(void);
+int ip6_tunnel_term(void);
+
 #endif /* __DPVS__ */
 #endif /* __DPVS_TUNNEL_H__ */
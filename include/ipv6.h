@@ -47,6 +47,46 @@ static inline bool ip6_is_frag(struct ip6_hdr *ip6h)
     return (ip6h->ip6_nxt == IPPROTO_FRAGMENT);
 }
 
+/*
+ * reassembled datagrams are flagged like LRO ones, with @tso_segsz set to
+ * the largest fragment. paths passing them on check that against MTU, as
+ * frag_max_size of linux, and leave the datagram to ip6_output to refrag.
+ */
+static inline bool ip6_pkt_toobig(const struct rte_mbuf *mbuf, uint32_t mtu)
+{
+    if (mbuf->ol_flags & PKT_RX_LRO)
+        return mbuf->tso_segsz > mtu;
+
+    return mbuf->pkt_len > mtu;
+}
+
+/*
+ * IPv6 statistics
+ */
+RTE_DECLARE_PER_LCORE(struct inet_stats, ip6_stats);
+#define this_ip6_stats  RTE_PER_LCORE(ip6_stats)
+
+#define IP6_INC_STATS(__f__) \
+    do { \
+        this_ip6_stats.__f__++; \
+    } while (0)
+
+#define IP6_DEC_STATS(__f__) \
+    do { \
+        this_ip6_stats.__f__--; \
+    } while (0)
+
+#define IP6_ADD_STATS(__f__, val) \
+    do { \
+        this_ip6_stats.__f__ += (val); \
+    } while (0)
+
+#define IP6_UPD_PO_STATS(__f__, val) \
+    do { \
+        this_ip6_stats.__f__##pkts ++; \
+        this_ip6_stats.__f__##octets += (val); \
+    } while (0)
+
 enum {
     INET6_PROTO_F_NONE      = 0x01,
     INET6_PROTO_F_FINAL     = 0x02,
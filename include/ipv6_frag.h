@@ -0,0 +1,48 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * fragment and reassemble of IPv6 packet.
+ */
+#ifndef __DPVS_IPV6_FRAG_H__
+#define __DPVS_IPV6_FRAG_H__
+#include "conf/ipv6.h"
+
+#define IP6_FRAG_FREE_DEATH_ROW_INTERVAL 100
+
+int ipv6_frag_init(void);
+int ipv6_frag_term(void);
+
+/* false if conn redirect is off, fragments are passed up as they are */
+extern bool ipv6_reasm_on;
+
+/*
+ * @mbuf starts with IPv6 header, which must be followed by the fragment
+ * header. it's replaced by the reassembled datagram on EDPVS_OK, and
+ * consumed on EDPVS_INPROGRESS.
+ */
+int ipv6_reassemble(struct rte_mbuf **mbuf);
+int ipv6_fragment(struct rte_mbuf *mbuf, unsigned int mtu,
+                  int (*output)(struct rte_mbuf *));
+
+int ipv6_frag_stats_cpu(struct ip6_frag_stats *stats);
+void ipv6_frag_conf_get(struct ip6_frag_param *param);
+
+void ip6_frag_keyword_value_init(void);
+void install_ip6_frag_keywords(void);
+
+#endif /* __DPVS_IPV6_FRAG_H__ */
@@ -27,6 +27,7 @@
 #include "ipvs/conn.h"
 #include "ipvs/proto.h"
 #include "ipvs/service.h"
+#include "ipvs/dest.h"
 #include "ipvs/redirect.h"
 
 enum {
@@ -42,6 +43,7 @@ enum {
     DPVS_CONN_F_SYNPROXY        = 0x8000,
     DPVS_CONN_F_TEMPLATE        = 0x1000,
     DPVS_CONN_F_NOFASTXMIT      = 0x2000,
+    DPVS_CONN_F_RTT_SAMPLED     = 0x4000,
 };
 
 struct dp_vs_conn_param {
@@ -77,6 +79,7 @@ struct dp_vs_conn_stats {
 
 struct dp_vs_fdir_filt;
 struct dp_vs_proto;
+struct dp_vs_warm_conn;
 
 struct dp_vs_conn {
     int                     af;
@@ -156,6 +159,10 @@ struct dp_vs_conn {
   
     /* flag for gfwip */
     bool outwall;
+
+    /* flow offload */
+    uint32_t offload_pkts;              /* inbound packets before offload */
+    uint32_t offload_mark;              /* NIC mark of the rule, 0 if none */
   
 } __rte_cache_aligned;
 
@@ -197,9 +204,24 @@ void dp_vs_conn_put(struct dp_vs_conn *conn);
 /* put conn without reset the timer */
 void dp_vs_conn_put_no_reset(struct dp_vs_conn *conn);
 
+/* warm restart */
+int dp_vs_conn_restore(const struct dp_vs_warm_conn *wc,
+                       struct dp_vs_dest *dest, const struct timeval *left);
+int dp_vs_conn_walk(int (*fn)(struct dp_vs_conn *conn, void *arg), void *arg);
+
 void ipvs_conn_keyword_value_init(void);
 void install_ipvs_conn_keywords(void);
 
+/* first SYN-ACK from RS, the conn was created with the SYN sent to it */
+static inline void dp_vs_conn_rtt_sample(struct dp_vs_conn *conn)
+{
+    if ((conn->flags & DPVS_CONN_F_RTT_SAMPLED) || !conn->dest)
+        return;
+
+    conn->flags |= DPVS_CONN_F_RTT_SAMPLED;
+    dp_vs_dest_rtt_sample(conn->dest, rte_rdtsc() - conn->ctime);
+}
+
 static inline void dp_vs_conn_fill_param(int af, uint8_t proto,
         const union inet_addr *caddr, const union inet_addr *vaddr,
         uint16_t cport, uint16_t vport, uint16_t ct_dport,
@@ -304,6 +326,7 @@ inline uint32_t dp_vs_conn_hashkey(int af,
     uint32_t mask);
 int dp_vs_conn_pool_size(void);
 int dp_vs_conn_pool_cache_size(void);
+uint32_t dp_vs_conn_count_get(void);
 
 extern bool dp_vs_redirect_disable;
 
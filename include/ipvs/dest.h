@@ -30,6 +30,14 @@ enum dpvs_fwd_mode {
     DPVS_FWD_MODE_FNAT      = 5,
     DPVS_FWD_MODE_NAT       = DPVS_FWD_MASQ,
     DPVS_FWD_MODE_SNAT      = 6,
+    DPVS_FWD_MODE_OVERLAY   = 7,
+};
+
+/* overlay encapsulation towards dest, for OVERLAY and FNAT mode */
+enum dpvs_dest_encap {
+    DPVS_DEST_ENCAP_NONE    = 0,
+    DPVS_DEST_ENCAP_VXLAN   = 1,
+    DPVS_DEST_ENCAP_GENEVE  = 2,
 };
 
 enum {
@@ -42,6 +50,39 @@ enum {
 #include "list.h"
 #include "dpdk.h"
 
+/* outer IPv6 + UDP + VXLAN/GENEVE + inner ethernet */
+#define DPVS_ENCAP_TMPL_MAX     72
+
+/*
+ * per-dest encapsulation, the outer headers are pre-built when dest
+ * is created. only route dependent fields (source address, lengths,
+ * UDP source port and checksums) are filled in on xmit.
+ */
+struct dp_vs_encap {
+    uint8_t             type;       /* DPVS_DEST_ENCAP_XXX */
+    uint8_t             l3_len;     /* outer IP header length */
+    uint8_t             hlen;       /* length of tmpl in use */
+    uint32_t            vni;
+    union inet_addr     vtep;       /* outer destination */
+    uint8_t             tmpl[DPVS_ENCAP_TMPL_MAX];
+};
+
+/*
+ * per-lcore connection counters of dest. conns are created, change state
+ * and expire on the lcore owning them, so each lcore updates its own
+ * slot only, with no atomic op and no cache line shared with others.
+ */
+struct dp_vs_dest_lcore {
+    int32_t             actconns;
+    int32_t             inactconns;
+    int32_t             persistconns;
+    uint32_t            lc_pos;     /* position in least-connection index */
+    uint32_t            rtt_cnt;    /* handshake RTT samples */
+    uint64_t            rtt_sum;    /* us */
+} __rte_cache_aligned;
+
+struct dp_vs_hc_target;
+
 struct dp_vs_dest {
     struct list_head    n_list;     /* for the dests in the service */
 
@@ -60,16 +101,23 @@ struct dp_vs_dest {
 
     rte_atomic32_t      refcnt;     /* reference counter */
     struct dp_vs_stats  *stats;     /* Use per-cpu statistics for destination server */
+    struct dpvs_shm_dest *stats_shm; /* slot if @stats is in stats shm */
 
     enum dpvs_fwd_mode  fwdmode;
 
     /* connection counters and thresholds */
-    rte_atomic32_t      actconns;   /* active connections */
-    rte_atomic32_t      inactconns; /* inactive connections */
-    rte_atomic32_t      persistconns;   /* persistent connections */
+    struct dp_vs_dest_lcore *lcore; /* per-lcore counters, DPVS_MAX_LCORE */
+    uint32_t            actconns;   /* active connections, aggregated */
+    uint32_t            inactconns; /* inactive connections, aggregated */
+    uint32_t            persistconns;   /* persistent connections, aggregated */
     uint32_t            max_conn;   /* upper threshold */
     uint32_t            min_conn;   /* lower threshold */
 
+    /* handshake RTT of server, samples of lcores merged by master */
+    uint32_t            rtt_us;     /* EWMA, 0 if not sampled yet */
+    uint64_t            rtt_samples;
+    uint64_t            rtt_sum;    /* us, of samples merged */
+
     /* for virtual service */
     uint16_t            proto;      /* which protocol (TCP/UDP) */
     uint16_t            vport;      /* virtual port number */
@@ -78,6 +126,12 @@ struct dp_vs_dest {
     union inet_addr     vaddr;      /* virtual IP address */
     unsigned            conn_timeout; /* conn timeout copied from svc*/
     unsigned            limit_proportion; /* limit copied from svc*/
+
+    struct dp_vs_encap  encap;      /* overlay encapsulation */
+
+    uint64_t            trash_tsc;  /* when moved into trash */
+
+    struct dp_vs_hc_target *hc;     /* native health check */
 } __rte_cache_aligned;
 #endif
 
@@ -95,6 +149,12 @@ struct dp_vs_dest_conf {
     /* thresholds for active connections */
     uint32_t           max_conn;    /* upper threshold */
     uint32_t           min_conn;    /* lower threshold */
+
+    /* overlay encapsulation */
+    uint8_t            encap;       /* DPVS_DEST_ENCAP_XXX */
+    uint32_t           vni;
+    union inet_addr    vtep;        /* outer destination, dest addr if zero */
+    uint8_t            inner_dmac[6]; /* inner dest MAC, broadcast if zero */
 };
 
 struct dp_vs_dest_entry {
@@ -113,6 +173,16 @@ struct dp_vs_dest_entry {
 
     /* statistics */
     struct dp_vs_stats stats;
+
+    /* overlay encapsulation */
+    uint8_t         encap;
+    uint32_t        vni;
+    union inet_addr vtep;
+    uint8_t         inner_dmac[6];
+
+    /* handshake RTT */
+    uint32_t        rtt_us;
+    uint64_t        rtt_samples;
 };
 
 struct dp_vs_get_dests {
@@ -145,6 +215,11 @@ struct dp_vs_dest_user{
 
     uint32_t        max_conn;
     uint32_t        min_conn;
+
+    uint8_t         encap;
+    uint32_t        vni;
+    union inet_addr vtep;
+    uint8_t         inner_dmac[6];
 };
 
 #ifdef __DPVS__
@@ -175,6 +250,85 @@ dp_vs_dest_is_valid(struct dp_vs_dest *dest)
             && dp_vs_dest_get_weight(dest) > 0) ? true : false;
 }
 
+/* synproxy cookies only work for modes translating the connection */
+static inline bool
+dp_vs_dest_is_nat(const struct dp_vs_dest *dest)
+{
+    return dest->fwdmode == DPVS_FWD_MODE_FNAT ||
+           dest->fwdmode == DPVS_FWD_MODE_NAT;
+}
+
+static inline struct dp_vs_dest_lcore *
+dp_vs_dest_this_lcore(struct dp_vs_dest *dest)
+{
+    return &dest->lcore[rte_lcore_id()];
+}
+
+/* update least-connection index of dest's service, see ip_vs_wlc.c */
+void dp_vs_dest_load_changed(struct dp_vs_dest *dest);
+
+/* new conn is bound to dest, which starts as INACTIVE */
+static inline void dp_vs_dest_conn_bind(struct dp_vs_dest *dest, bool template)
+{
+    if (template) {
+        dp_vs_dest_this_lcore(dest)->persistconns++;
+    } else {
+        dp_vs_dest_this_lcore(dest)->inactconns++;
+        dp_vs_dest_load_changed(dest);
+    }
+}
+
+static inline void dp_vs_dest_conn_unbind(struct dp_vs_dest *dest,
+                                          bool template, bool inactive)
+{
+    struct dp_vs_dest_lcore *this = dp_vs_dest_this_lcore(dest);
+
+    if (template) {
+        this->persistconns--;
+        return;
+    }
+
+    if (inactive)
+        this->inactconns--;
+    else
+        this->actconns--;
+    dp_vs_dest_load_changed(dest);
+}
+
+/* conn turns from INACTIVE to active, or the reverse */
+static inline void dp_vs_dest_conn_activate(struct dp_vs_dest *dest)
+{
+    dp_vs_dest_this_lcore(dest)->actconns++;
+    dp_vs_dest_this_lcore(dest)->inactconns--;
+    dp_vs_dest_load_changed(dest);
+}
+
+static inline void dp_vs_dest_conn_inactivate(struct dp_vs_dest *dest)
+{
+    dp_vs_dest_this_lcore(dest)->actconns--;
+    dp_vs_dest_this_lcore(dest)->inactconns++;
+    dp_vs_dest_load_changed(dest);
+}
+
+/* sum per-lcore counters up and update overload status, on master */
+void dp_vs_dest_conns_aggregate(struct dp_vs_dest *dest);
+
+/* handshake RTT of dest seen by this lcore, from SYN to SYN-ACK */
+#define DP_VS_DEST_RTT_MAX_US       1000000
+
+static inline void dp_vs_dest_rtt_sample(struct dp_vs_dest *dest,
+                                         uint64_t cycles)
+{
+    struct dp_vs_dest_lcore *this = dp_vs_dest_this_lcore(dest);
+    uint64_t us = cycles * 1000000 / rte_get_tsc_hz();
+
+    this->rtt_sum += RTE_MIN(us, (uint64_t)DP_VS_DEST_RTT_MAX_US);
+    this->rtt_cnt++;
+}
+
+/* merge per-lcore RTT samples into EWMA, on master */
+void dp_vs_dest_rtt_aggregate(struct dp_vs_dest *dest);
+
 int dp_vs_new_dest(struct dp_vs_service *svc, struct dp_vs_dest_conf *udest,
                                               struct dp_vs_dest **dest_p);
 
@@ -184,6 +338,8 @@ struct dp_vs_dest *dp_vs_lookup_dest(int af, struct dp_vs_service *svc,
 struct dp_vs_dest *dp_vs_trash_get_dest(struct dp_vs_service *svc,
                                         const union inet_addr *daddr, uint16_t dport);
 
+void dp_vs_trash_sweep(void);
+
 void dp_vs_trash_cleanup(void);
 
 int dp_vs_add_dest(struct dp_vs_service *svc, struct dp_vs_dest_conf *udest);
@@ -0,0 +1,81 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * VXLAN/GENEVE encapsulation towards real servers living in overlay
+ * networks, used by OVERLAY forwarding and FNAT-over-overlay.
+ *
+ * outer headers are built once per dest (see struct dp_vs_encap),
+ * encapsulation is a prepend plus copy of the template. the return
+ * traffic of FNAT-over-overlay is decapsulated by the UDP handler
+ * and re-injected to IP layer as if it's received from the port, if
+ * it's from the VTEP and VNI of an overlay dest.
+ */
+#ifndef __DPVS_ENCAP_H__
+#define __DPVS_ENCAP_H__
+#include "dpdk.h"
+#include "ipvs/conn.h"
+#include "ipvs/dest.h"
+#include "ipvs/service.h"
+
+#define DPVS_VXLAN_PORT         4789    /* IANA assigned */
+#define DPVS_GENEVE_PORT        6081    /* IANA assigned */
+
+#define ENCAP_VXLAN_F_VNI       0x08000000
+
+struct encap_vxlan_hdr {
+    uint32_t    flags;
+    uint32_t    vni;                    /* VNI << 8 */
+} __attribute__((__packed__));
+
+struct encap_geneve_hdr {
+    uint8_t     ver_optlen;             /* version:2, option length:6 */
+    uint8_t     flags;
+    uint16_t    proto;
+    uint32_t    vni;                    /* VNI << 8 */
+} __attribute__((__packed__));
+
+static inline bool dp_vs_dest_has_encap(const struct dp_vs_dest *dest)
+{
+    return dest->encap.type != DPVS_DEST_ENCAP_NONE;
+}
+
+int dp_vs_encap_verify(const struct dp_vs_service *svc,
+                       const struct dp_vs_dest_conf *udest);
+
+void dp_vs_encap_build(struct dp_vs_encap *encap, int af,
+                       const union inet_addr *daddr,
+                       const struct dp_vs_dest_conf *udest);
+
+/* (VTEP, VNI) of dests allowed to send overlay packets to us */
+int dp_vs_encap_vtep_add(int af, const struct dp_vs_encap *encap);
+void dp_vs_encap_vtep_del(int af, const struct dp_vs_encap *encap);
+
+/*
+ * encapsulate the complete inner packet in @mbuf and send it to dest's
+ * VTEP. mbuf->userdata must be the route (route4 or route6 by dest af)
+ * towards the VTEP, which is consumed as other xmit routines do.
+ */
+int dp_vs_encap_xmit(struct dp_vs_conn *conn, struct rte_mbuf *mbuf);
+
+int dp_vs_encap_init(void);
+int dp_vs_encap_term(void);
+
+void install_encap_keywords(void);
+void encap_keyword_value_init(void);
+
+#endif /* __DPVS_ENCAP_H__ */
@@ -0,0 +1,44 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * native health check of real servers.
+ *
+ * each dest of a checked service is probed by one worker lcore, from a
+ * LIP/port taken from that lcore's sa_pool, so replies are steered back
+ * to it and matched by an inet hook behind dp_vs_in. no kernel stack or
+ * KNI is involved. master applies the results to DPVS_DEST_F_AVAILABLE,
+ * with flap damping.
+ */
+#ifndef __DPVS_HC_H__
+#define __DPVS_HC_H__
+#include "ipvs/service.h"
+#include "ipvs/dest.h"
+#include "conf/hc.h"
+
+/* called on master with dests changed */
+void dp_vs_hc_dest_add(struct dp_vs_service *svc, struct dp_vs_dest *dest);
+void dp_vs_hc_dest_del(struct dp_vs_dest *dest);
+void dp_vs_hc_flush(struct dp_vs_service *svc);
+
+/* dest is held down by health check */
+bool dp_vs_hc_dest_down(const struct dp_vs_dest *dest);
+
+int dp_vs_hc_init(void);
+int dp_vs_hc_term(void);
+
+#endif /* __DPVS_HC_H__ */
@@ -23,6 +23,7 @@
 
 int dp_vs_laddr_bind(struct dp_vs_conn *conn, struct dp_vs_service *svc);
 int dp_vs_laddr_unbind(struct dp_vs_conn *conn);
+int dp_vs_laddr_rebind(struct dp_vs_conn *conn, struct dp_vs_service *svc);
 
 int dp_vs_laddr_add(struct dp_vs_service *svc, int af, const union inet_addr *addr,
                     const char *ifname);
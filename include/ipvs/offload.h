@@ -0,0 +1,61 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * flow offload.
+ *
+ * inbound packets of established DR/tunnel conns past a threshold get a
+ * NIC rule marking them with the conn's slot, so later packets find the
+ * conn by the mark instead of a conn table lookup.
+ */
+#ifndef __DPVS_OFFLOAD_H__
+#define __DPVS_OFFLOAD_H__
+#include "dpdk.h"
+#include "ipvs/ipvs.h"
+#include "ipvs/conn.h"
+#include "conf/offload.h"
+
+extern bool dp_vs_offload_on;
+extern uint32_t dp_vs_offload_threshold;
+
+void __dp_vs_offload_add(struct dp_vs_conn *conn, struct rte_mbuf *mbuf);
+
+/* count an inbound packet of @conn, offload it once hot enough */
+static inline void dp_vs_offload_count(struct dp_vs_conn *conn,
+                                       struct rte_mbuf *mbuf)
+{
+    if (!dp_vs_offload_on || conn->offload_mark)
+        return;
+
+    if (unlikely(++conn->offload_pkts == dp_vs_offload_threshold))
+        __dp_vs_offload_add(conn, mbuf);
+}
+
+/* conn of a marked packet with a reference held, NULL if not offloaded */
+struct dp_vs_conn *dp_vs_offload_conn_get(const struct dp_vs_iphdr *iph,
+                                          struct rte_mbuf *mbuf, int *dir);
+
+/* remove the rule of @conn, it's going to be freed */
+void dp_vs_offload_del(struct dp_vs_conn *conn);
+
+int dp_vs_offload_init(void);
+int dp_vs_offload_term(void);
+
+void offload_keyword_value_init(void);
+void install_offload_keywords(void);
+
+#endif /* __DPVS_OFFLOAD_H__ */
@@ -0,0 +1,57 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * overload protection.
+ *
+ * each worker samples the share of its cycles spent on rx bursts and
+ * the fill level of its rx queues. past the high watermarks it sheds
+ * new flows (drop, RST, or SYN cookies only) instead of scheduling
+ * them, until both fall below the low watermarks. packets of existing
+ * connections are never shed.
+ */
+#ifndef __DPVS_OVERLOAD_H__
+#define __DPVS_OVERLOAD_H__
+#include "dpdk.h"
+#include "ipvs/ipvs.h"
+#include "ipvs/proto.h"
+#include "ipvs/service.h"
+#include "conf/overload.h"
+
+extern bool dp_vs_lcore_overloaded[DPVS_MAX_LCORE];
+
+static inline bool dp_vs_overloaded(void)
+{
+    return unlikely(dp_vs_lcore_overloaded[rte_lcore_id()]);
+}
+
+/* for a packet without conn, return true if it's shed with @verdict set */
+bool dp_vs_overload_shed(struct dp_vs_proto *prot,
+                         const struct dp_vs_iphdr *iph,
+                         struct rte_mbuf *mbuf, int *verdict);
+
+/* SYN to @svc should be answered by synproxy cookie because of overload,
+ * only if all its dests are FNAT/NAT, otherwise the SYN is shed */
+bool dp_vs_overload_syncookie(struct dp_vs_service *svc);
+
+int dp_vs_overload_init(void);
+int dp_vs_overload_term(void);
+
+void overload_keyword_value_init(void);
+void install_overload_keywords(void);
+
+#endif /* __DPVS_OVERLOAD_H__ */
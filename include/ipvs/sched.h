@@ -23,10 +23,13 @@
 #include "ctrl.h"
 #include "ipvs/service.h"
 
+/* scheduler flags */
+#define DP_VS_SCHED_F_RTT       0x0001  /* uses handshake RTT of dests */
 
 struct dp_vs_scheduler {
     struct list_head    n_list;
     char                *name;
+    unsigned int        flags;
 //    rte_atomic32_t      refcnt;
 
     struct dp_vs_dest *
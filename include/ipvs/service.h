@@ -44,6 +44,9 @@
 
 rte_rwlock_t __dp_vs_svc_lock;
 
+struct dp_vs_lc_index;
+struct dp_vs_hc;
+
 /* virtual service */
 struct dp_vs_service {
     struct list_head    s_list;     /* node for normal service table */
@@ -74,13 +77,24 @@ struct dp_vs_service {
 
     struct list_head    dests;      /* real services (dp_vs_dest{}) */
     uint32_t            num_dests;
+    uint32_t            num_nonat_dests;    /* no overload syncookie if any */
     long                weight;     /* sum of servers weight */
 
     struct dp_vs_scheduler  *scheduler;
     void                *sched_data;
     rte_rwlock_t        sched_lock;
 
+    /* per-lcore dest index of least-connection schedulers, lcores
+     * rebuild their index when lc_gen changes, see ip_vs_wlc.c */
+    struct dp_vs_lc_index *lc_index;
+    rte_atomic32_t      lc_gen;
+    bool                lc_weighted;
+
+    /* mean handshake RTT of dests sampled, see ip_vs_wll.c */
+    uint32_t            rtt_us;
+
     struct dp_vs_stats  *stats;
+    uint64_t            shed[DPVS_MAX_LCORE];   /* by overload protection */
 
     /* FNAT only */
     struct list_head    laddr_list; /* local address (LIP) pool */
@@ -88,6 +102,8 @@ struct dp_vs_service {
     rte_rwlock_t        laddr_lock;
     uint32_t            num_laddrs;
 
+    struct dp_vs_hc     *hc;        /* native health check, see ip_vs_hc.c */
+
     /* ... flags, timer ... */
 } __rte_cache_aligned;
 #endif
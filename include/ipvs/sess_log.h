@@ -0,0 +1,85 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * session logging.
+ *
+ * workers put a fixed-size record to a per-lcore single-producer
+ * single-consumer ring when a connection is created or expired,
+ * no string formatting or memory allocation on forwarding path.
+ * records are preallocated per lcore, and dropped (and counted, see
+ * "dpip sesslog show") if all of them are waiting for the exporter.
+ *
+ * an exporter running on an idle lcore (or master lcore if there's
+ * no idle one) drains the rings and exports the records as IPFIX
+ * (RFC 7011) to a UDP collector and/or a local file (RFC 5655).
+ */
+#ifndef __DPVS_SESS_LOG_H__
+#define __DPVS_SESS_LOG_H__
+#include "dpdk.h"
+#include "inet.h"
+#include "ipvs/conn.h"
+
+/* same as IPFIX natEvent */
+enum {
+    DPVS_SESS_LOG_CREATE    = 1,
+    DPVS_SESS_LOG_DELETE    = 2,
+};
+
+struct dp_vs_sess_rec {
+    uint64_t        ctime;      /* create time, TSC cycles */
+    uint64_t        etime;      /* expire time, TSC cycles */
+    uint64_t        inpkts;
+    uint64_t        inbytes;
+    uint64_t        outpkts;
+    uint64_t        outbytes;
+    union inet_addr caddr;
+    union inet_addr vaddr;
+    union inet_addr laddr;
+    union inet_addr daddr;
+    uint16_t        cport;
+    uint16_t        vport;
+    uint16_t        lport;
+    uint16_t        dport;
+    uint8_t         event;
+    uint8_t         iaf;
+    uint8_t         oaf;
+    uint8_t         proto;
+} __rte_cache_aligned;
+
+extern bool dp_vs_sess_log_on;
+
+void __dp_vs_sess_log(const struct dp_vs_conn *conn, uint8_t event);
+
+static inline void dp_vs_sess_log(const struct dp_vs_conn *conn, uint8_t event)
+{
+    if (unlikely(dp_vs_sess_log_on) && !(conn->flags & DPVS_CONN_F_TEMPLATE))
+        __dp_vs_sess_log(conn, event);
+}
+
+int dp_vs_sess_log_init(void);
+int dp_vs_sess_log_term(void);
+
+/* launch the exporter, after data plane lcores started */
+void dp_vs_sess_log_start(void);
+/* export on master lcore if no idle lcore for exporter */
+void sess_log_process_on_master(void);
+
+void install_sess_log_keywords(void);
+void sess_log_keyword_value_init(void);
+
+#endif /* __DPVS_SESS_LOG_H__ */
@@ -104,6 +104,7 @@ void dp_svc_stats_clear(struct dp_vs_stats *stats);
 int dp_vs_stats_in(struct dp_vs_conn *conn, struct rte_mbuf *mbuf);
 int dp_vs_stats_out(struct dp_vs_conn *conn, struct rte_mbuf *mbuf);
 void dp_vs_stats_conn(struct dp_vs_conn *conn);
+void dp_vs_stats_lcore_get(struct dp_vs_stats *stats);
 
 void dp_vs_estats_inc(enum dp_vs_estats_type field);
 void dp_vs_estats_clear(void);
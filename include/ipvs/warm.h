@@ -0,0 +1,101 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * warm restart.
+ *
+ * conns of each worker are saved to a file on hugetlbfs before DPVS is
+ * stopped, and rebuilt by the workers of the new process once services
+ * are configured again. the file outlives the process, as EAL removes
+ * only its own "*map_*" files from the hugetlbfs directory.
+ *
+ * file layout: header, then a section of records per lcore.
+ */
+#ifndef __DPVS_WARM_H__
+#define __DPVS_WARM_H__
+#include <stdint.h>
+#include "inet.h"
+#include "match.h"
+#include "ipvs/ipvs.h"
+#include "conf/warm.h"
+
+#define DP_VS_WARM_MAGIC        0x44505657  /* "DPVW" */
+#define DP_VS_WARM_VERSION      1
+
+struct dp_vs_warm_section {
+    uint64_t            offset;     /* of first record, from file start */
+    uint32_t            nconns;
+    uint32_t            capacity;
+};
+
+struct dp_vs_warm_hdr {
+    uint32_t            magic;
+    uint16_t            version;
+    uint16_t            hdr_size;
+    uint32_t            conn_size;
+    uint32_t            complete;   /* set after all lcores are done */
+    uint64_t            saved_at;   /* ms since epoch */
+    struct dp_vs_warm_section sections[DPVS_MAX_LCORE];
+};
+
+/* a saved conn, with what's needed to find its service and dest again */
+struct dp_vs_warm_conn {
+    /* service */
+    int32_t             svc_af;
+    uint8_t             svc_proto;
+    union inet_addr     svc_addr;
+    uint16_t            svc_port;
+    uint32_t            svc_fwmark;
+    struct dp_vs_match  svc_match;  /* SNAT services */
+
+    /* dest */
+    int32_t             dest_af;
+    union inet_addr     dest_addr;
+    uint16_t            dest_port;
+
+    /* conn */
+    int32_t             af;
+    uint8_t             proto;
+    uint8_t             outwall;
+    uint16_t            flags;
+    uint16_t            state;
+    uint16_t            old_state;
+    union inet_addr     caddr;
+    union inet_addr     vaddr;
+    union inet_addr     laddr;
+    union inet_addr     daddr;
+    uint16_t            cport;
+    uint16_t            vport;
+    uint16_t            lport;
+    uint16_t            dport;
+
+    struct dp_vs_seq    fnat_seq;
+    struct dp_vs_seq    syn_proxy_seq;
+    uint32_t            rs_end_seq;
+    uint32_t            rs_end_ack;
+
+    uint32_t            timeout;    /* sec */
+    uint32_t            expire_ms;  /* time left when saved */
+};
+
+int dp_vs_warm_init(void);
+int dp_vs_warm_term(void);
+
+void warm_keyword_value_init(void);
+void install_warm_keywords(void);
+
+#endif /* __DPVS_WARM_H__ */
@@ -22,6 +22,26 @@
 #include "ipvs/dest.h"
 #include "ipvs/sched.h"
 
+/*
+ * lc/wlc keep a min-heap of the service's dests on each lcore, keyed by
+ * the load the lcore itself puts on each dest. picking a dest is O(1),
+ * and a conn created, changing state or expired costs O(log n) on its
+ * own lcore, no cache line is shared between lcores.
+ */
+struct dp_vs_lc_node {
+    uint64_t            key;
+    struct dp_vs_dest   *dest;
+};
+
+struct dp_vs_lc_index {
+    uint32_t            gen;        /* svc->lc_gen it's built for */
+    uint32_t            num;
+    uint32_t            size;
+    struct dp_vs_lc_node *heap;
+} __rte_cache_aligned;
+
+void dp_vs_lc_index_free(struct dp_vs_service *svc);
+
 int dp_vs_wlc_init(void);
 int dp_vs_wlc_term(void);
 
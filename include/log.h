@@ -29,6 +29,12 @@
 #define DPVS_LOG_POOL_SIZE_MIN     65536
 #define DPVS_LOG_CACHE_SIZE_DEF    256
 
+/* binary log, see RTE_BLOG() */
+#define DPVS_BLOG_MAX_SITES        4096
+#define DPVS_BLOG_RING_SIZE_DEF    4096     /* per lcore */
+#define DPVS_BLOG_POOL_SIZE_DEF    65535
+#define DPVS_BLOG_SITE_BURST       10       /* per call site in LOG_INTERNAL_TIME */
+
 
 struct dpvs_log {
     lcoreid_t cid;          
@@ -38,6 +44,15 @@ struct dpvs_log {
     char data[0];           
 };
 
+struct dpvs_blog_rec {
+    uint16_t site;          /* dpvs_log_site.id */
+    lcoreid_t cid;
+    uint8_t slen;           /* bytes used of strs */
+    uint64_t tsc;
+    uint64_t args[DPVS_BLOG_MAX_ARGS];
+    char strs[DPVS_BLOG_STR_LEN];
+};
+
 typedef struct log_buf {
     char buf[LOG_BUF_MAX_LEN];
     int pos;
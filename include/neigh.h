@@ -115,6 +115,8 @@ int neigh_resolve_input(struct rte_mbuf *mbuf, struct netif_port *port);
 
 void neigh_process_ring(void *arg);
 
+unsigned neigh_relay_ring(void);
+
 void neigh_confirm(int af, union inet_addr *nexthop, struct netif_port *port);
 
 int neigh_sync_core(const void *param, bool add_del, enum param_kind kind);
@@ -73,6 +73,12 @@ struct netif_queue_conf
     queueid_t id;
     uint16_t len;
     uint16_t kni_len;
+    /* tx only: mbufs[0, tx_kept) were refused by the NIC and are retried */
+    uint16_t tx_kept;
+    uint16_t tx_retries;    /* bursts in a row without progress */
+    uint64_t tx_deadline;   /* TSC to flush partial burst */
+    uint64_t tx_retried;
+    uint64_t tx_dropped;
     struct rx_partner *isol_rxq;
     struct rte_mbuf *mbufs[NETIF_MAX_PKT_BURST];
     struct rte_mbuf *kni_mbufs[NETIF_MAX_PKT_BURST];
@@ -109,6 +115,7 @@ struct netif_lcore_conf
 /* isolate RX lcore */
 struct rx_partner {
     lcoreid_t cid;
+    lcoreid_t worker_cid; /* lcore processing packets of rb */
     portid_t pid;
     queueid_t qid;
     struct rte_ring *rb;
@@ -130,6 +137,9 @@ struct netif_lcore_stats
     uint64_t opackets; /* Total number of successfully transmitted packets. */
     uint64_t obytes;/* Total number of successfully transmitted bytes. */
     uint64_t dropped; /* Total number of dropped packets by software. */
+    uint64_t txretry; /* Total number of packets kept for TX retry. */
+    uint64_t txdrop; /* Total number of packets dropped on full TX queues. */
+    uint64_t busy_cycles; /* Total number of cycles spent on non-empty RX bursts. */
 } __rte_cache_aligned;
 
 /**************************** lcore loop job ****************************/
@@ -147,9 +157,7 @@ struct netif_lcore_loop_job
     void *data;
     enum netif_lcore_job_type type;
     uint32_t skip_loops; /* for NETIF_LCORE_JOB_SLOW type only */
-#ifdef CONFIG_RECORD_BIG_LOOP
-    uint32_t job_time[DPVS_MAX_LCORE];
-#endif
+    int prof_id;         /* histogram index, see prof.h */
     struct list_head list;
 } __rte_cache_aligned;
 
@@ -276,6 +284,10 @@ int netif_print_lcore_conf(char *buf, int *len, bool is_all, portid_t pid);
 int netif_print_lcore_queue_conf(lcoreid_t cid, char *buf, int *len, bool title);
 void netif_get_slave_lcores(uint8_t *nb, uint64_t *mask);
 void netif_update_master_loop_cnt(void);
+uint64_t netif_lcore_loops(lcoreid_t cid);
+/* grace period of data unlinked from lcores' lock-free view */
+void netif_lcore_loops_save(uint64_t *loops);
+bool netif_lcores_quiescent(const uint64_t *loops);
 // function only for init or termination //
 int netif_register_master_xmit_msg(void);
 int netif_lcore_conf_set(int lcores, const struct netif_lcore_conf *lconf);
@@ -283,7 +295,37 @@ int netif_lcore_loop_job_register(struct netif_lcore_loop_job *lcore_job);
 int netif_lcore_loop_job_unregister(struct netif_lcore_loop_job *lcore_job);
 int netif_lcore_start(void);
 bool is_lcore_id_valid(lcoreid_t cid);
+bool is_lcore_id_fwd(lcoreid_t cid);
+lcoreid_t netif_neigh_lcore(void);
 bool netif_lcore_is_idle(lcoreid_t cid);
+void netif_lcore_load(uint64_t *busy_cycles, int *rxq_usage);
+void netif_copy_lcore_stats(struct netif_lcore_stats *stats);
+
+/* idle lcores may sleep on rx interrupts, see netif_lcore_wakeup */
+struct netif_lcore_sleep {
+    volatile uint32_t sleeping;
+    int efd;
+} __rte_cache_aligned;
+
+extern struct netif_lcore_sleep netif_lcore_sleeps[DPVS_MAX_LCORE];
+extern bool netif_idle_sleep_on;
+
+void __netif_lcore_wakeup(lcoreid_t cid);
+
+/*
+ * producers of rings to other lcores must call it after enqueue,
+ * or the consumer may sleep up to idle_sleep_ms before seeing them.
+ */
+static inline void netif_lcore_wakeup(lcoreid_t cid)
+{
+    if (likely(!netif_idle_sleep_on))
+        return;
+
+    /* pairs with lcore_sleep() */
+    rte_smp_mb();
+    if (unlikely(netif_lcore_sleeps[cid].sleeping))
+        __netif_lcore_wakeup(cid);
+}
 
 /************************** protocol API *****************************/
 int netif_register_pkt(struct pkt_type *pt);
@@ -308,6 +350,8 @@ int netif_port_stop(struct netif_port *port); // stop nic
 int netif_set_mc_list(struct netif_port *port);
 int __netif_set_mc_list(struct netif_port *port);
 int netif_get_queue(struct netif_port *port, lcoreid_t id, queueid_t *qid);
+int netif_get_queue_lcore(const struct netif_port *port, queueid_t qid,
+                          lcoreid_t *cid);
 int netif_get_link(struct netif_port *dev, struct rte_eth_link *link);
 int netif_get_promisc(struct netif_port *dev, bool *promisc);
 int netif_get_stats(struct netif_port *dev, struct rte_eth_stats *stats);
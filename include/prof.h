@@ -0,0 +1,108 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * always-on, sampled profiling of data path stages and lcore loop jobs
+ * into per-lcore log-linear histograms of TSC cycles.
+ *
+ * unlike bench.h it's built in and switched at runtime by
+ * "dpip prof set on|off". when off, DPVS_PROF_START costs a load of
+ * dpvs_prof_enabled and a branch. when on, 1 of dpvs_prof_sample_mask+1
+ * calls per lcore are timed.
+ */
+#ifndef __DPVS_PROF_H__
+#define __DPVS_PROF_H__
+#include "dpdk.h"
+#include "conf/prof.h"
+
+#define RTE_LOGTYPE_PROF    RTE_LOGTYPE_USER1
+
+struct dpvs_prof_hist {
+    uint64_t    count;
+    uint64_t    cycles;
+    uint64_t    max;
+    uint64_t    buckets[DPVS_PROF_HIST_BUCKETS];
+};
+
+struct dpvs_prof_lcore {
+    uint32_t                tick;       /* sampling counter */
+    uint32_t                reset_gen;
+    struct dpvs_prof_hist   stages[DPVS_PROF_STAGE_MAX];
+    struct dpvs_prof_hist   jobs[DPVS_PROF_JOB_MAX];
+    struct dpvs_prof_hist   loop;
+} __rte_cache_aligned;
+
+extern struct dpvs_prof_lcore dpvs_prof_lcores[DPVS_MAX_LCORE];
+extern volatile bool dpvs_prof_enabled;
+extern volatile uint32_t dpvs_prof_sample_mask;
+extern volatile uint32_t dpvs_prof_reset_gen;
+
+static inline bool dpvs_prof_sample(void)
+{
+    struct dpvs_prof_lcore *p;
+
+    if (likely(!dpvs_prof_enabled))
+        return false;
+
+    p = &dpvs_prof_lcores[rte_lcore_id()];
+    return (++p->tick & dpvs_prof_sample_mask) == 0;
+}
+
+static inline void dpvs_prof_hist_add(struct dpvs_prof_hist *h,
+                                      uint64_t cycles)
+{
+    h->count++;
+    h->cycles += cycles;
+    if (cycles > h->max)
+        h->max = cycles;
+    h->buckets[dpvs_prof_hist_bucket(cycles)]++;
+}
+
+static inline struct dpvs_prof_lcore *dpvs_prof_this(void)
+{
+    struct dpvs_prof_lcore *p = &dpvs_prof_lcores[rte_lcore_id()];
+
+    /* reset is requested by master, done by owner lcore */
+    if (unlikely(p->reset_gen != dpvs_prof_reset_gen)) {
+        memset(p->stages, 0, sizeof(p->stages));
+        memset(p->jobs, 0, sizeof(p->jobs));
+        memset(&p->loop, 0, sizeof(p->loop));
+        p->reset_gen = dpvs_prof_reset_gen;
+    }
+
+    return p;
+}
+
+static inline void dpvs_prof_account(int stage, uint64_t cycles)
+{
+    dpvs_prof_hist_add(&dpvs_prof_this()->stages[stage], cycles);
+}
+
+#define DPVS_PROF_START(tsc)            \
+    uint64_t tsc = dpvs_prof_sample() ? rte_rdtsc() : 0
+#define DPVS_PROF_END(stage, tsc)       \
+    do { \
+        if (unlikely(tsc)) \
+            dpvs_prof_account((stage), rte_rdtsc() - (tsc)); \
+    } while (0)
+
+int dpvs_prof_job_register(const char *name);
+
+int dpvs_prof_init(void);
+int dpvs_prof_term(void);
+
+#endif /* __DPVS_PROF_H__ */
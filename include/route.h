@@ -40,6 +40,11 @@ struct route_entry {
     rte_atomic32_t refcnt;
 };
 
+/* bumped on each change of this lcore's route tables,
+ * so that cached references can tell they are stale. */
+RTE_DECLARE_PER_LCORE(uint32_t, route4_genid);
+#define this_route4_genid       (RTE_PER_LCORE(route4_genid))
+
 struct route_entry *route4_local(uint32_t src, struct netif_port *port);
 
 struct route_entry *route_out_local_lookup(uint32_t dest);
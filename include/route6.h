@@ -44,6 +44,10 @@ struct route6 {
     rte_atomic32_t      refcnt;
 };
 
+/* bumped on each change of this lcore's route6 table. */
+RTE_DECLARE_PER_LCORE(uint32_t, route6_genid);
+#define this_route6_genid       (RTE_PER_LCORE(route6_genid))
+
 struct route6 *route6_input(const struct rte_mbuf *mbuf, struct flow6 *fl6);
 struct route6 *route6_output(const struct rte_mbuf *mbuf, struct flow6 *fl6);
 int route6_get(struct route6 *rt);
@@ -55,6 +55,10 @@ int sa_pool_create(struct inet_ifaddr *ifa, uint16_t low, uint16_t high);
 
 int sa_pool_destroy(struct inet_ifaddr *ifa);
 
+/* rebuild RSS pre-calculating state after @dev (re)started,
+ * EDPVS_INPROGRESS if deferred until workers leave the old state */
+int sa_pool_rss_update(struct netif_port *dev);
+
 /**
  * @dev and @daddr is optional,
  * note: if @daddr is used, it must be the same for sa_fetch and sa_release.
@@ -67,6 +71,14 @@ int sa_release(const struct netif_port *dev,
                const struct sockaddr_storage *daddr,
                const struct sockaddr_storage *saddr);
 
+/**
+ * take the given @saddr (<ip, port>) as sa_fetch does, for conns restored
+ * by warm restart. it fails if the pair is in use or of other lcores.
+ */
+int sa_reserve(const struct netif_port *dev,
+               const struct sockaddr_storage *daddr,
+               const struct sockaddr_storage *saddr);
+
 int sa_pool_stats(const struct inet_ifaddr *ifa, struct sa_pool_stats *stats);
 
 /* config file */
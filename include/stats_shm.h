@@ -0,0 +1,58 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * statistics export by a named shared memory segment, see
+ * conf/stats_shm.h for the layout. external readers map it read-only
+ * and never talk to dpvs, the reference reader is tools/dpvs-exporter.
+ */
+#ifndef __DPVS_STATS_SHM_H__
+#define __DPVS_STATS_SHM_H__
+#include "dpdk.h"
+#include "conf/stats_shm.h"
+
+#define RTE_LOGTYPE_STATSHM     RTE_LOGTYPE_USER1
+
+struct dp_vs_dest;
+
+/* seqlock of the single writer of a slot, no atomics needed */
+static inline void dpvs_shm_write_begin(volatile uint32_t *seq)
+{
+    (*seq)++;
+    rte_smp_wmb();
+}
+
+static inline void dpvs_shm_write_end(volatile uint32_t *seq)
+{
+    rte_smp_wmb();
+    (*seq)++;
+}
+
+/*
+ * place dest->stats in the segment so the data path counts into it
+ * directly, EDPVS_NOROOM if disabled or full. master only.
+ */
+int dpvs_stats_shm_dest_attach(struct dp_vs_dest *dest);
+void dpvs_stats_shm_dest_detach(struct dp_vs_dest *dest);
+
+int dpvs_stats_shm_init(void);
+int dpvs_stats_shm_term(void);
+
+void stats_shm_keyword_value_init(void);
+void install_stats_shm_keywords(void);
+
+#endif /* __DPVS_STATS_SHM_H__ */
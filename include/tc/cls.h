@@ -24,8 +24,10 @@
 #define __DPVS_TC_CLS_H__
 #include "common.h"
 #include "match.h"
+#include "tc/police.h"
 #ifdef __DPVS__
 #include "dpdk.h"
+#include "timer.h"
 #endif /* __DPVS__ */
 
 struct tc_cls_result {
@@ -37,6 +39,7 @@ struct tc_cls_match_copt {
     uint8_t                 proto;      /* IPPROTO_XXX */
     struct dp_vs_match      match;
     struct tc_cls_result    result;
+    struct tc_police_copt   police;     /* drop matched pkts over rate */
 } __attribute__((__packed__));
 
 #ifdef __DPVS__
@@ -69,6 +72,10 @@ struct tc_cls {
     struct tc_cls_ops       *ops;
     __be16                  pkt_type;   /* ETH_P_XXX */
     int                     prio;       /* priority */
+
+    /* recycle after lcores leave it, like Qsch */
+    struct dpvs_timer       rc_timer;
+    uint64_t                rc_loops[DPVS_MAX_LCORE];
 };
 
 static inline void *tc_cls_priv(struct tc_cls *cls)
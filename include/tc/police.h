@@ -0,0 +1,158 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * packet rate policer for traffic control classifiers.
+ *
+ * the rate is shared by the lcores a rule sees traffic on: each lcore
+ * owns a token bucket refilled at rate/N, N being the number of lcores
+ * active on the rule in the last TC_POLICE_ACTIVE_MS. no lock or atomic
+ * operation on the packet path, buckets are only read by other lcores.
+ */
+#ifndef __DPVS_TC_POLICE_H__
+#define __DPVS_TC_POLICE_H__
+#include <stdint.h>
+#ifdef __DPVS__
+#include "dpdk.h"
+#endif /* __DPVS__ */
+
+struct tc_police_copt {
+    uint32_t                rate;       /* packets per second, 0: off */
+    uint32_t                burst;      /* packets */
+
+    /* get only */
+    uint64_t                passed;
+    uint64_t                dropped;
+} __attribute__((__packed__));
+
+#ifdef __DPVS__
+
+#define TC_POLICE_SCALE         1000    /* tokens per packet */
+#define TC_POLICE_ACTIVE_MS     100
+#define TC_POLICE_MAX_IDLE_MS   60000
+
+struct tc_policer_lcore {
+    uint64_t                tokens;
+    uint64_t                last;       /* TSC of last refill */
+    uint64_t                seen;       /* TSC of last packet */
+    uint64_t                passed;
+    uint64_t                dropped;
+} __rte_cache_aligned;
+
+struct tc_policer {
+    uint32_t                rate;
+    uint32_t                burst;
+    uint64_t                ms_cycles;
+    struct tc_policer_lcore lcore[DPVS_MAX_LCORE];
+};
+
+static inline void tc_policer_init(struct tc_policer *p,
+                                   const struct tc_police_copt *copt)
+{
+    memset(p, 0, sizeof(*p));
+
+    p->rate = copt->rate;
+    p->burst = copt->burst ? : (copt->rate / 10 ? : 1);
+    p->ms_cycles = rte_get_tsc_hz() / 1000;
+}
+
+/* update rate and burst of a policer in use, buckets and counters kept */
+static inline void tc_policer_change(struct tc_policer *p,
+                                     const struct tc_police_copt *copt)
+{
+    p->burst = copt->burst ? : (copt->rate / 10 ? : 1);
+    p->ms_cycles = rte_get_tsc_hz() / 1000;
+
+    /* lcores check rate first, let them see the others ahead */
+    rte_wmb();
+    p->rate = copt->rate;
+}
+
+static inline void tc_policer_dump(const struct tc_policer *p,
+                                   struct tc_police_copt *copt)
+{
+    lcoreid_t cid;
+
+    memset(copt, 0, sizeof(*copt));
+    copt->rate = p->rate;
+    copt->burst = p->burst;
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        copt->passed += p->lcore[cid].passed;
+        copt->dropped += p->lcore[cid].dropped;
+    }
+}
+
+/* number of lcores the rate is shared by, at least the caller itself */
+static inline unsigned tc_policer_share(const struct tc_policer *p,
+                                        uint64_t now)
+{
+    int64_t window = p->ms_cycles * TC_POLICE_ACTIVE_MS;
+    unsigned n = 0;
+    lcoreid_t cid;
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        if (p->lcore[cid].seen && (int64_t)(now - p->lcore[cid].seen) < window)
+            n++;
+    }
+
+    return n ? : 1;
+}
+
+/* return true if the packet conforms to the rate and may pass */
+static inline bool tc_policer_conform(struct tc_policer *p)
+{
+    struct tc_policer_lcore *pl = &p->lcore[rte_lcore_id()];
+    uint64_t now = rte_rdtsc();
+    uint64_t ms, cap;
+    unsigned share;
+
+    if (!p->rate)
+        return true;
+
+    pl->seen = now;
+
+    /* refill at most once per ms, rate pps is rate tokens per ms */
+    if (unlikely(now - pl->last >= p->ms_cycles)) {
+        share = tc_policer_share(p, now);
+        ms = (now - pl->last) / p->ms_cycles;
+        pl->last += ms * p->ms_cycles;
+        if (ms > TC_POLICE_MAX_IDLE_MS)
+            ms = TC_POLICE_MAX_IDLE_MS;
+
+        cap = (uint64_t)p->burst * TC_POLICE_SCALE / share;
+        if (cap < TC_POLICE_SCALE)
+            cap = TC_POLICE_SCALE;
+
+        pl->tokens += ms * p->rate / share;
+        if (pl->tokens > cap)
+            pl->tokens = cap;
+    }
+
+    if (likely(pl->tokens >= TC_POLICE_SCALE)) {
+        pl->tokens -= TC_POLICE_SCALE;
+        pl->passed++;
+        return true;
+    }
+
+    pl->dropped++;
+    return false;
+}
+
+#endif /* __DPVS__ */
+
+#endif /* __DPVS_TC_POLICE_H__ */
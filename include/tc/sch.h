@@ -54,6 +54,7 @@ struct qsch_bstats {
 struct Qsch_ops {
     char                    name[TCNAMESIZ];
     uint32_t                priv_size;
+    uint32_t                lcore_priv_size; /* per-lcore private data */
 
     int                     (*enqueue)(struct Qsch *sch, struct rte_mbuf *mbuf);
     struct rte_mbuf *       (*dequeue)(struct Qsch *sch);
@@ -64,13 +65,31 @@ struct Qsch_ops {
     void                    (*destroy)(struct Qsch *sch);
     int                     (*change)(struct Qsch *sch, const void *arg);
     int                     (*dump)(struct Qsch *sch, void *arg);
+    /* take @child as inner queue, for Qsch having one, e.g., tbf */
+    int                     (*graft)(struct Qsch *sch, struct Qsch *child);
 
     /* internal use */
     struct list_head        list;       /* global sch ops list */
     rte_atomic32_t          refcnt;
 };
 
-/* queue scheduler, see kernel Qdisc */
+/*
+ * per-lcore part of Qsch, allocated on the NUMA node of the lcore and
+ * followed by Qsch_ops.lcore_priv_size bytes of private data.
+ */
+struct qsch_lcore {
+    struct tc_mbuf_head     q;
+    struct qsch_qstats      qstats;
+    struct qsch_bstats      bstats;
+} __rte_cache_aligned;
+
+/*
+ * queue scheduler, see kernel Qdisc.
+ *
+ * the data path takes no reference. a destroyed Qsch is unlinked at
+ * once but freed only after every lcore has finished the netif loop it
+ * was in at that time (see netif_lcores_quiescent), nobody can see it then.
+ */
 struct Qsch {
     tc_handle_t             handle;
     tc_handle_t             parent;
@@ -79,23 +98,22 @@ struct Qsch {
     int                     cls_cnt;
     struct hlist_node       hlist;      /* netif_tc.qsch_hash node */
     struct netif_tc         *tc;
-    rte_atomic32_t          refcnt;
 
     uint32_t                limit;
-    struct tc_mbuf_head     q[RTE_MAX_LCORE];
     uint32_t                flags;
 
     struct Qsch_ops         *ops;
 
-    /* per-lcore statistics */
-    struct qsch_qstats      qstats[RTE_MAX_LCORE];
-    struct qsch_bstats      bstats[RTE_MAX_LCORE];
+    /* NULL for lcores not enabled */
+    struct qsch_lcore       *lcore[RTE_MAX_LCORE];
 
     struct dpvs_timer       rc_timer;
+    uint64_t                rc_loops[DPVS_MAX_LCORE];
 
-#define this_q      q[rte_lcore_id()]
-#define this_qstats qstats[rte_lcore_id()]
-#define this_bstats bstats[rte_lcore_id()]
+#define this_lcore  lcore[rte_lcore_id()]
+#define this_q      this_lcore->q
+#define this_qstats this_lcore->qstats
+#define this_bstats this_lcore->bstats
 };
 
 struct qsch_rate {
@@ -107,6 +125,16 @@ static inline void *qsch_priv(struct Qsch *sch)
     return (char *)sch + TC_ALIGN(sizeof(struct Qsch));
 }
 
+static inline void *qsch_lcore_priv(struct Qsch *sch, lcoreid_t cid)
+{
+    return (char *)sch->lcore[cid] + TC_ALIGN(sizeof(struct qsch_lcore));
+}
+
+static inline void *qsch_this_priv(struct Qsch *sch)
+{
+    return qsch_lcore_priv(sch, rte_lcore_id());
+}
+
 static inline struct netif_port *qsch_dev(struct Qsch *sch)
 {
     return sch->tc->dev;
@@ -233,20 +261,9 @@ void qsch_stats(struct Qsch *sch, struct qsch_qstats *qstats,
 void qsch_hash_add(struct Qsch *sch, bool invisible);
 void qsch_hash_del(struct Qsch *sch);
 
-struct Qsch *qsch_lookup(const struct netif_tc *tc, tc_handle_t handle);
 struct Qsch *qsch_lookup_noref(const struct netif_tc *tc, tc_handle_t handle);
 void qsch_do_sched(struct Qsch *sch);
 
-static inline void qsch_get(struct Qsch *sch)
-{
-    rte_atomic32_inc(&sch->refcnt);
-}
-
-static inline void qsch_put(struct Qsch *sch)
-{
-    rte_atomic32_dec(&sch->refcnt);
-}
-
 int fifo_set_limit(struct Qsch *sch, unsigned int limit);
 struct Qsch *fifo_create_dflt(struct Qsch *sch, struct Qsch_ops *ops,
                               unsigned int limit);
@@ -53,6 +53,7 @@ struct tc_mbuf_head {
 struct tc_mbuf {
     struct list_head        list;
     struct rte_mbuf         *mbuf;
+    uint64_t                tstamp;     /* TSC at enqueue, if needed */
 };
 
 struct netif_tc {
@@ -99,6 +100,8 @@ void tc_cls_ops_put(struct tc_cls_ops *ops);
 
 struct rte_mbuf *tc_handle_egress(struct netif_tc *tc,
                                   struct rte_mbuf *mbuf, int *ret);
+struct rte_mbuf *tc_handle_ingress(struct netif_tc *tc, __be16 eth_type,
+                                   struct rte_mbuf *mbuf, int *ret);
 
 static inline int64_t tc_get_ns(void)
 {
@@ -108,6 +108,10 @@ int dpvs_timer_update_nolock(struct dpvs_timer *timer,
 
 void dpvs_time_rand_delay(struct timeval *tv, long delay_us);
 
+/* time left before a pending one-shot timer expires */
+int dpvs_timer_remaining(const struct dpvs_timer *timer, bool global,
+                         struct timeval *left);
+
 /* config file */
 int dpvs_timer_sched_interval_get(void);
 void timer_keyword_value_init(void);
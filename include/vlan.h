@@ -16,7 +16,7 @@
  *
  */
 /*
- * dpvs VLAN (802.1q) implementation.
+ * dpvs VLAN (802.1q/802.1ad) implementation.
  *
  * raychen@qiyi.com, May 2017, initial.
  */
@@ -26,6 +26,7 @@
 #include "common.h"
 #include "list.h"
 #include "netif.h"
+#include "timer.h"
 
 #define VLAN_ID_MAX                 4096
 #define VLAN_ID_MASK                0x0fff
@@ -34,10 +35,24 @@
 
 #define mbuf_vlan_tag_get_id(m)     htons(((m)->vlan_tci & VLAN_ID_MASK))
 
-/* VLANs info for real device */
+/* index of vlan_info.vlan_devs */
+enum {
+    VLAN_PROTO_8021Q    = 0,
+    VLAN_PROTO_8021AD,      /* QinQ S-tag */
+    VLAN_PROTO_NUM,
+};
+
+/**
+ * VLANs info for real device.
+ *
+ * vlan devices are direct indexed by protocol and VLAN ID, entries are
+ * published by control plane (under vlan_lock) and read lock-free by
+ * data plane. for QinQ, 802.1q devices stack on a 802.1ad device and
+ * found in vlan_info of it.
+ */
 struct vlan_info {
     struct netif_port   *real_dev;
-    struct hlist_head   *vlan_dev_hash;
+    struct netif_port   *(*vlan_devs)[VLAN_ID_MAX];  /* [VLAN_PROTO_NUM] */
     uint16_t            vlan_dev_num;
     rte_rwlock_t        vlan_lock;
     rte_atomic32_t      refcnt;
@@ -64,8 +79,7 @@ struct vlan_stats {
  *    then add to netif_port.
  */
 struct vlan_dev_priv {
-    struct hlist_node   hlist;      /* node of real_dev.vlan_dev_hash */
-    __be16              vlan_proto; /* now ETH_P_8021Q */
+    __be16              vlan_proto; /* ETH_P_8021Q or ETH_P_8021AD */
     __be16              vlan_id;
     uint16_t            flags;
 
@@ -75,6 +89,10 @@ struct vlan_dev_priv {
     /* per-CPU statistics
      * RTE_DEFINE_PER_LCORE cannot be used inside struct */
     struct vlan_stats   lcore_stats[RTE_MAX_LCORE];
+
+    /* deferred free after deleted, see vlan_del_dev() */
+    struct dpvs_timer   rc_timer;
+    uint64_t            rc_loops[DPVS_MAX_LCORE];
 };
 
 /**
@@ -106,6 +124,11 @@ struct netif_port *vlan_find_dev(const struct netif_port *real_dev,
 
 int vlan_rcv(struct rte_mbuf *mbuf, struct netif_port *rdev);
 
+static inline bool eth_type_vlan(__be16 ethertype)
+{
+    return ethertype == htons(ETH_P_8021Q) || ethertype == htons(ETH_P_8021AD);
+}
+
 int vlan_init(void);
 
 static inline int vlan_insert_tag(struct rte_mbuf *mbuf,
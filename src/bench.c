@@ -0,0 +1,126 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include "common.h"
+#include "ctrl.h"
+#include "bench.h"
+#include "conf/bench.h"
+
+#ifdef CONFIG_DPVS_BENCH
+struct dpvs_bench_lcore dpvs_bench_lcores[DPVS_MAX_LCORE];
+volatile uint32_t dpvs_bench_reset_gen = 0;
+volatile bool dpvs_bench_rx_on = false;
+#endif
+
+static int bench_sockopt_set(sockoptid_t opt, const void *conf, size_t size)
+{
+#ifdef CONFIG_DPVS_BENCH
+    const struct dp_vs_bench_rx_conf *rx_conf = conf;
+
+    switch (opt) {
+    case SOCKOPT_SET_BENCH_RESET:
+        dpvs_bench_reset_gen++;
+        return EDPVS_OK;
+    case SOCKOPT_SET_BENCH_RX:
+        if (!conf || size < sizeof(*rx_conf))
+            return EDPVS_INVAL;
+        dpvs_bench_rx_on = !!rx_conf->enable;
+        RTE_LOG(INFO, BENCH, "bench: rx %s\n", dpvs_bench_rx_on ? "on" : "off");
+        return EDPVS_OK;
+    default:
+        return EDPVS_NOTSUPP;
+    }
+#else
+    return EDPVS_NOTSUPP;
+#endif
+}
+
+static int bench_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
+                             void **out, size_t *outsize)
+{
+    struct dp_vs_bench_conf_array *array;
+    size_t nentry = 0;
+#ifdef CONFIG_DPVS_BENCH
+    const struct dpvs_bench_stats *st;
+    lcoreid_t cid;
+    int stage;
+
+    RTE_LCORE_FOREACH(cid) {
+        if (cid < DPVS_MAX_LCORE)
+            nentry += DPVS_BENCH_STAGE_MAX;
+    }
+#endif
+
+    *outsize = sizeof(*array) + nentry * sizeof(struct dp_vs_bench_entry);
+    array = rte_calloc_socket(NULL, 1, *outsize, 0, rte_socket_id());
+    if (!array)
+        return EDPVS_NOMEM;
+
+    array->tsc_hz = rte_get_tsc_hz();
+
+#ifdef CONFIG_DPVS_BENCH
+    array->enabled = 1;
+    array->rx_enabled = dpvs_bench_rx_on;
+
+    /* lockless read, counters may be a burst behind */
+    RTE_LCORE_FOREACH(cid) {
+        if (cid >= DPVS_MAX_LCORE)
+            continue;
+        if (dpvs_bench_lcores[cid].reset_gen != dpvs_bench_reset_gen)
+            continue;   /* reset pending */
+
+        for (stage = 0; stage < DPVS_BENCH_STAGE_MAX; stage++) {
+            st = &dpvs_bench_lcores[cid].stats[stage];
+            if (!st->calls)
+                continue;
+            array->entries[array->nentry].cid = cid;
+            array->entries[array->nentry].stage = stage;
+            array->entries[array->nentry].calls = st->calls;
+            array->entries[array->nentry].pkts = st->pkts;
+            array->entries[array->nentry].cycles = st->cycles;
+            array->nentry++;
+        }
+    }
+#endif
+
+    *out = array;
+    return EDPVS_OK;
+}
+
+static struct dpvs_sockopts bench_sockopts = {
+    .version            = SOCKOPT_VERSION,
+    .set_opt_min        = SOCKOPT_SET_BENCH_RESET,
+    .set_opt_max        = SOCKOPT_SET_BENCH_RX,
+    .set                = bench_sockopt_set,
+    .get_opt_min        = SOCKOPT_GET_BENCH_SHOW,
+    .get_opt_max        = SOCKOPT_GET_BENCH_SHOW,
+    .get                = bench_sockopt_get,
+};
+
+int dpvs_bench_init(void)
+{
+#ifdef CONFIG_DPVS_BENCH
+    RTE_LOG(WARNING, BENCH, "bench: built with CONFIG_DPVS_BENCH, rx is held "
+            "until \"dpip bench set rx on\"\n");
+#endif
+    return sockopt_register(&bench_sockopts);
+}
+
+int dpvs_bench_term(void)
+{
+    return sockopt_unregister(&bench_sockopts);
+}
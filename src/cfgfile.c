@@ -27,12 +27,19 @@
 #include "ipv4.h"
 #include "ipv4_frag.h"
 #include "ipv6.h"
+#include "icmp.h"
 #include "ctrl.h"
 #include "sa_pool.h"
 #include "ipvs/conn.h"
 #include "ipvs/proto_tcp.h"
 #include "ipvs/proto_udp.h"
 #include "ipvs/synproxy.h"
+#include "ipvs/encap.h"
+#include "ipvs/sess_log.h"
+#include "ipvs/overload.h"
+#include "ipvs/offload.h"
+#include "ipvs/warm.h"
+#include "stats_shm.h"
 
 typedef void (*sighandler_t)(int);
 
@@ -48,12 +55,19 @@ static void keyword_value_init(void)
     ip4_frag_keyword_value_init();
 
     control_keyword_value_init();
+    stats_shm_keyword_value_init();
     ipvs_conn_keyword_value_init();
     udp_keyword_value_init();
     tcp_keyword_value_init();
     synproxy_keyword_value_init();
+    encap_keyword_value_init();
+    sess_log_keyword_value_init();
+    overload_keyword_value_init();
+    offload_keyword_value_init();
+    warm_keyword_value_init();
 
     ipv6_keyword_value_init();
+    icmp_keyword_value_init();
 }
 
 static vector_t install_keywords(void)
@@ -71,6 +85,10 @@ static vector_t install_keywords(void)
     install_ip4_frag_keywords();
 
     install_control_keywords();
+    install_keyword("stats_shm", NULL, KW_TYPE_INIT);
+    install_sublevel();
+    install_stats_shm_keywords();
+    install_sublevel_end();
 
     install_keyword_root("ipvs_defs", NULL);
     install_keyword("conn", NULL, KW_TYPE_NORMAL);
@@ -87,7 +105,28 @@ static vector_t install_keywords(void)
     install_proto_udp_keywords();
     install_sublevel_end();
 
+    install_keyword("session_log", NULL, KW_TYPE_NORMAL);
+    install_sublevel();
+    install_sess_log_keywords();
+    install_sublevel_end();
+
+    install_keyword("overload", NULL, KW_TYPE_NORMAL);
+    install_sublevel();
+    install_overload_keywords();
+    install_sublevel_end();
+
+    install_keyword("flow_offload", NULL, KW_TYPE_NORMAL);
+    install_sublevel();
+    install_offload_keywords();
+    install_sublevel_end();
+
+    install_keyword("warm_restart", NULL, KW_TYPE_NORMAL);
+    install_sublevel();
+    install_warm_keywords();
+    install_sublevel_end();
+
     install_ipv6_keywords();
+    install_icmp_keywords();
 
     return g_keywords;
 }
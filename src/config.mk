@@ -25,7 +25,6 @@ CFLAGS += -D DPVS_MAX_SOCKET=2
 CFLAGS += -D DPVS_MAX_LCORE=64
 
 #CFLAGS += -D CONFIG_DPVS_NEIGH_DEBUG
-#CFLAGS += -D CONFIG_RECORD_BIG_LOOP
 #CFLAGS += -D CONFIG_DPVS_SAPOOL_DEBUG
 #CFLAGS += -D CONFIG_DPVS_IPVS_DEBUG
 #CFLAGS += -D CONFIG_SYNPROXY_DEBUG
@@ -40,6 +39,7 @@ CFLAGS += -D DPVS_MAX_LCORE=64
 #CFLAGS += -D CONFIG_DPVS_IPSET_DEBUG
 #CFLAGS += -D CONFIG_NDISC_DEBUG
 #CFLAGS += -D CONFIG_MSG_DEBUG
+#CFLAGS += -D CONFIG_DPVS_BENCH
 
 GCC_MAJOR = $(shell echo __GNUC__ | $(CC) -E -x c - | tail -n 1)
 GCC_MINOR = $(shell echo __GNUC_MINOR__ | $(CC) -E -x c - | tail -n 1)
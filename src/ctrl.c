@@ -16,6 +16,7 @@
  *
  */
 #include <sys/socket.h>
+#include <sys/epoll.h>
 #include <fcntl.h>
 #include <sys/un.h>
 #include <unistd.h>
@@ -26,6 +27,7 @@
 #include "netif.h"
 #include "mempool.h"
 #include "parser/parser.h"
+#include "prof.h"
 
 /////////////////////////////////// lcore  msg ///////////////////////////////////////////
 
@@ -493,6 +495,7 @@ int msg_send(struct dpvs_msg *msg, lcoreid_t cid, uint32_t flags, struct dpvs_ms
         rte_atomic16_dec(&msg->refcnt); /* not enqueued, free manually */
         return EDPVS_DPDKAPIFAIL;
     }
+    netif_lcore_wakeup(cid);
 
     if (flags & DPVS_MSG_F_ASYNC)
         return EDPVS_OK;
@@ -706,6 +709,11 @@ int msg_master_process(int step)
     return EDPVS_OK;
 }
 
+bool msg_lcore_pending(lcoreid_t cid)
+{
+    return msg_ring[cid] && !rte_ring_empty(msg_ring[cid]);
+}
+
 /* only unicast msg can be recieved on slave lcore */
 int msg_slave_process(int step)
 {
@@ -794,7 +802,9 @@ cont:
 
 static inline void slave_lcore_loop_func(__rte_unused void *dumpy)
 {
+    DPVS_PROF_START(prof_tsc);
     msg_slave_process(0);
+    DPVS_PROF_END(DPVS_PROF_MSG, prof_tsc);
 }
 
 /* for debug */
@@ -1039,8 +1049,10 @@ static inline int msg_init(void)
     /* per-lcore msg queue */
     for (ii = 0; ii < DPVS_MAX_LCORE; ii++) {
         snprintf(ring_name, sizeof(ring_name), "msg_ring_%d", ii);
+        /* the ring is consumed by lcore ii only */
         msg_ring[ii] = rte_ring_create(ring_name, msg_ring_size,
-                rte_socket_id(), RING_F_SC_DEQ);
+                rte_lcore_is_enabled(ii) ? rte_lcore_to_socket_id(ii)
+                : rte_socket_id(), RING_F_SC_DEQ);
         if (unlikely(NULL == msg_ring[ii])) {
             RTE_LOG(ERR, MSGMGR, "%s: fail to create msg ring\n", __func__);
             dpvs_mempool_destroy(msg_pool);
@@ -1092,49 +1104,83 @@ static inline int msg_term(void)
 
 /////////////////////////////// sockopt process msg ///////////////////////////////////////////
 
+/*
+ * sockopt server runs on master lcore, for the handlers are not thread
+ * safe and may send lcore msgs. clients can keep the connection and
+ * pipeline requests, each request is answered in order. all sockets are
+ * nonblock and multiplexed by epoll, reading is budgeted per loop so
+ * one busy or slow client does not stall the master loop.
+ */
+
 #define UNIX_DOMAIN_DEF "/var/run/dpvs_ctrl"
 char ipc_unix_domain[256];
 
+#define SOCKOPT_CONN_MAX            256
+#define SOCKOPT_EPOLL_EVENTS        32
+#define SOCKOPT_LISTEN_BACKLOG      128
+#define SOCKOPT_READ_BUDGET         (1 << 16)   /* bytes per conn per loop */
+#define SOCKOPT_BUF_MIN             4096
+#define SOCKOPT_MSG_MAX             (256 << 20)
+#define SOCKOPT_WBUF_HIGH           (16 << 20)  /* stop reading above it */
+
+struct sockopt_conn {
+    struct list_head    list;
+    int                 fd;
+    uint32_t            events;
+    bool                eof;        /* peer shut down writing */
+
+    char                *rbuf;
+    size_t              rlen;
+    size_t              rsize;
+
+    char                *wbuf;
+    size_t              woff;
+    size_t              wlen;
+    size_t              wsize;
+};
+
 static struct list_head sockopt_list;
+static struct list_head sockopt_conns;
+static int sockopt_nconn = 0;
 
-static int srv_fd;
+static int srv_fd = -1;
+static int sockopt_epfd = -1;
 
 static inline int judge_id_betw(sockoptid_t num, sockoptid_t min, sockoptid_t max)
 {
     return ((num <= max) && (num >= min));
 }
 
-static struct dpvs_sockopts* sockopts_get(struct dpvs_sock_msg *msg)
+static struct dpvs_sockopts *sockopts_lookup(enum sockopt_type type,
+                                             sockoptid_t id, uint32_t version)
 {
     struct dpvs_sockopts *skopt;
+
+    list_for_each_entry(skopt, &sockopt_list, list) {
+        if ((type == SOCKOPT_GET &&
+             judge_id_betw(id, skopt->get_opt_min, skopt->get_opt_max)) ||
+            (type == SOCKOPT_SET &&
+             judge_id_betw(id, skopt->set_opt_min, skopt->set_opt_max))) {
+            if (unlikely(skopt->version != version)) {
+                RTE_LOG(WARNING, MSGMGR, "%s: socket msg version not match\n", __func__);
+                return NULL;
+            }
+            return skopt;
+        }
+    }
+
+    return NULL;
+}
+
+static struct dpvs_sockopts* sockopts_get(struct dpvs_sock_msg *msg)
+{
     if (unlikely(NULL == msg))
         return NULL;
 
     switch (msg->type) {
         case SOCKOPT_GET:
-            list_for_each_entry(skopt, &sockopt_list, list) {
-                if (judge_id_betw(msg->id, skopt->get_opt_min, skopt->get_opt_max)) {
-                    if (unlikely(skopt->version != msg->version)) {
-                        RTE_LOG(WARNING, MSGMGR, "%s: socket msg version not match\n", __func__);
-                        return NULL;
-                    }
-                    return skopt;
-                }
-            }
-            return NULL;
-            break;
         case SOCKOPT_SET:
-            list_for_each_entry(skopt, &sockopt_list, list) {
-                if (judge_id_betw(msg->id, skopt->set_opt_min, skopt->set_opt_max)) {
-                    if (unlikely(skopt->version != msg->version)) {
-                        RTE_LOG(WARNING, MSGMGR, "%s: socket msg version not match\n", __func__);
-                        return NULL;
-                    }
-                    return skopt;
-                }
-            }
-            return NULL;
-            break;
+            return sockopts_lookup(msg->type, msg->id, msg->version);
         default:
             RTE_LOG(WARNING, MSGMGR, "%s: unkown sock msg type: %d\n", __func__, msg->type);
     }
@@ -1199,161 +1245,425 @@ int sockopt_unregister(struct dpvs_sockopts *sockopts)
     return EDPVS_NOTEXIST;
 }
 
-static inline int sockopt_msg_recv(int clt_fd, struct dpvs_sock_msg **pmsg)
+/* free recieved msg */
+static inline void sockopt_msg_free(struct dpvs_sock_msg *msg)
 {
-    struct dpvs_sock_msg msg_hdr;
-    struct dpvs_sock_msg *msg;
-    int len, res;
+    rte_free(msg);
+}
 
-    if (unlikely(!pmsg))
-        return EDPVS_INVAL;
-    *pmsg = NULL;
+static int sockopt_buf_reserve(char **buf, size_t *size, size_t need)
+{
+    size_t nsize;
+    char *nbuf;
 
-    len = sizeof(msg_hdr);
-    memset(&msg_hdr, 0, len);
-    res = readn(clt_fd, &msg_hdr, len);
-    if (sizeof(msg_hdr) != res) {
-        RTE_LOG(WARNING, MSGMGR, "%s: sockopt msg header recv fail -- %d/%d recieved\n",
-                __func__, res, len);
-        return EDPVS_IO;
-    }
+    if (need <= *size)
+        return EDPVS_OK;
 
-    *pmsg = rte_malloc("sockopt_msg",
-            sizeof(struct dpvs_sock_msg) + msg_hdr.len, RTE_CACHE_LINE_SIZE);
-    if (unlikely(NULL == *pmsg)) {
-        RTE_LOG(ERR, MSGMGR, "%s: no memory\n", __func__);
-        return EDPVS_NOMEM;
-    }
+    nsize = *size ? *size : SOCKOPT_BUF_MIN;
+    while (nsize < need)
+        nsize <<= 1;
 
-    msg = *pmsg;
-    msg->version = msg_hdr.version;
-    msg->id = msg_hdr.id;
-    msg->type = msg_hdr.type;
-    msg->len = msg_hdr.len;
-
-    if (msg_hdr.len > 0) {
-        res = readn(clt_fd, msg->data, msg->len);
-        if (res != msg->len) {
-            RTE_LOG(WARNING, MSGMGR, "%s: sockopt msg body recv fail -- "
-                    "%d/%d recieved\n", __func__, res, (int)msg->len);
-            rte_free(msg);
-            *pmsg = NULL;
-            return EDPVS_IO;
-        }
-    }
+    nbuf = rte_realloc(*buf, nsize, 0);
+    if (unlikely(!nbuf))
+        return EDPVS_NOMEM;
 
+    *buf = nbuf;
+    *size = nsize;
     return EDPVS_OK;
 }
 
-/* free recieved msg */
-static inline void sockopt_msg_free(struct dpvs_sock_msg *msg)
-{
-    rte_free(msg);
-}
-
 /* Note:
  * 1. data is created by user using rte_malloc, rte_zmalloc, etc.
- * 2. msg data not sent when errcode is set in reply header */
-static int sockopt_msg_send(int clt_fd,
+ * 2. msg data not sent when errcode is set in reply header
+ * replies are queued and sent by sockopt_conn_flush() */
+static int sockopt_msg_send(struct sockopt_conn *conn,
         const struct dpvs_sock_msg_reply *hdr,
         const char *data, int data_len)
 {
-    int len, res;
-
-    len = sizeof(struct dpvs_sock_msg_reply);
-    res = sendn(clt_fd, hdr, len, MSG_NOSIGNAL);
-    if (len != res) {
-        RTE_LOG(WARNING, MSGMGR, "[%s:msg#%d] sockopt reply msg header send error"
-                " -- %d/%d sent\n", __func__, hdr->id, res, len);
-        return EDPVS_IO;
-    }
+    size_t len = sizeof(*hdr);
+    int err;
 
     if (hdr->errcode) {
         RTE_LOG(DEBUG, MSGMGR, "[%s:msg#%d] errcode set in sockopt msg reply: %s\n",
                 __func__, hdr->id, dpvs_strerror(hdr->errcode));
-        return hdr->errcode;
+        data_len = 0;
+    }
+
+    err = sockopt_buf_reserve(&conn->wbuf, &conn->wsize,
+                              conn->wlen + len + data_len);
+    if (err != EDPVS_OK) {
+        RTE_LOG(WARNING, MSGMGR, "[%s:msg#%d] no memory for sockopt reply\n",
+                __func__, hdr->id);
+        return err;
     }
 
+    memcpy(conn->wbuf + conn->wlen, hdr, len);
+    conn->wlen += len;
     if (data_len) {
-        res = sendn(clt_fd, data, data_len, MSG_NOSIGNAL);
-        if (data_len != res) {
-            RTE_LOG(WARNING, MSGMGR, "[%s:msg#%d] sockopt reply msg body send error"
-                    " -- %d/%d sent\n", __func__, hdr->id, res, data_len);
-            return EDPVS_IO;
-        }
+        memcpy(conn->wbuf + conn->wlen, data, data_len);
+        conn->wlen += data_len;
     }
 
     return EDPVS_OK;
 }
 
-int sockopt_ctl(__rte_unused void *arg)
+/* validate all items before applying any of them */
+static int sockopt_batch_check(const struct dpvs_sock_msg *msg)
 {
-    int clt_fd;
-    int ret;
-    socklen_t clt_len;
-    struct sockaddr_un clt_addr;
+    const struct dpvs_sock_batch_hdr *bh = (const void *)msg->data;
+    const struct dpvs_sock_batch_item *item;
+    size_t off = sizeof(*bh);
+    uint32_t i;
+
+    if (msg->len < sizeof(*bh) || bh->nitem > SOCKOPT_BATCH_MAX)
+        return EDPVS_INVAL;
+
+    for (i = 0; i < bh->nitem; i++) {
+        if (off + sizeof(*item) > msg->len)
+            return EDPVS_INVAL;
+        item = (const void *)(msg->data + off);
+        if (item->len > msg->len - off - sizeof(*item))
+            return EDPVS_INVAL;
+        if (!sockopts_lookup(SOCKOPT_SET, item->id, msg->version))
+            return EDPVS_NOTSUPP;
+        off += SOCKOPT_BATCH_ITEM_SIZE(item->len);
+    }
+
+    return EDPVS_OK;
+}
+
+static int sockopt_batch_process(const struct dpvs_sock_msg *msg,
+                                 void **out, size_t *outlen)
+{
+    const struct dpvs_sock_batch_hdr *bh = (const void *)msg->data;
+    const struct dpvs_sock_batch_item *item;
+    struct dpvs_sock_batch_reply *reply;
     struct dpvs_sockopts *skopt;
-    struct dpvs_sock_msg *msg;
+    size_t off = sizeof(*bh);
+    bool failed = false;
+    uint32_t i;
+    int err;
+
+    err = sockopt_batch_check(msg);
+    if (err != EDPVS_OK)
+        return err;
+
+    *outlen = sizeof(*reply) + bh->nitem * sizeof(int);
+    reply = rte_zmalloc("sockopt_batch", *outlen, 0);
+    if (unlikely(!reply))
+        return EDPVS_NOMEM;
+    reply->nitem = bh->nitem;
+
+    for (i = 0; i < bh->nitem; i++) {
+        item = (const void *)(msg->data + off);
+        off += SOCKOPT_BATCH_ITEM_SIZE(item->len);
+
+        if (failed && (bh->flags & SOCKOPT_BATCH_F_STOP_ON_ERR)) {
+            reply->errcode[i] = EDPVS_IDLE;
+            continue;
+        }
+
+        skopt = sockopts_lookup(SOCKOPT_SET, item->id, msg->version);
+        reply->errcode[i] = skopt->set(item->id, item->data, item->len);
+        if (reply->errcode[i] == EDPVS_OK)
+            reply->ndone++;
+        else
+            failed = true;
+    }
+
+    if (failed)
+        RTE_LOG(INFO, MSGMGR, "%s: %u/%u items of batch applied\n",
+                __func__, reply->ndone, reply->nitem);
+
+    *out = reply;
+    return EDPVS_OK;
+}
+
+static int sockopt_msg_process(struct sockopt_conn *conn,
+                               struct dpvs_sock_msg *msg)
+{
+    struct dpvs_sockopts *skopt = NULL;
     struct dpvs_sock_msg_reply reply_hdr;
     void *reply_data = NULL;
     size_t reply_data_len = 0;
+    int ret = EDPVS_NOTSUPP;
+
+    if (msg->type == SOCKOPT_BATCH) {
+        if (msg->version == SOCKOPT_VERSION)
+            ret = sockopt_batch_process(msg, &reply_data, &reply_data_len);
+        else
+            ret = EDPVS_INVAL;
+    } else {
+        skopt = sockopts_get(msg);
+        if (!skopt)
+            RTE_LOG(WARNING, MSGMGR, "%s: sockopt %d not support\n", __func__, msg->id);
+        else if (msg->type == SOCKOPT_GET)
+            ret = skopt->get(msg->id, msg->data, msg->len, &reply_data, &reply_data_len);
+        else if (msg->type == SOCKOPT_SET)
+            ret = skopt->set(msg->id, msg->data, msg->len);
+    }
+
+    if (ret < 0) {
+        /* assume that reply_data is freed by user when callback fails */
+        reply_data = NULL;
+        reply_data_len = 0;
+        RTE_LOG(INFO, MSGMGR, "%s: socket msg<type=%s, id=%d> callback failed\n",
+                __func__, msg->type == SOCKOPT_GET ? "GET" :
+                (msg->type == SOCKOPT_SET ? "SET" : "BATCH"), msg->id);
+    }
+
+    memset(&reply_hdr, 0, sizeof(reply_hdr));
+    reply_hdr.version = SOCKOPT_VERSION;
+    reply_hdr.id = msg->id;
+    reply_hdr.type = msg->type;
+    reply_hdr.errcode = ret;
+    strncpy(reply_hdr.errstr, dpvs_strerror(ret), SOCKOPT_ERRSTR_LEN - 1);
+    reply_hdr.len = reply_data_len;
+
+    ret = sockopt_msg_send(conn, &reply_hdr, reply_data, reply_data_len);
+
+    if (reply_data)
+        rte_free(reply_data);
+
+    return ret;
+}
+
+static void sockopt_conn_close(struct sockopt_conn *conn)
+{
+    epoll_ctl(sockopt_epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    list_del(&conn->list);
+    sockopt_nconn--;
+
+    if (conn->rbuf)
+        rte_free(conn->rbuf);
+    if (conn->wbuf)
+        rte_free(conn->wbuf);
+    rte_free(conn);
+}
+
+static int sockopt_conn_set_events(struct sockopt_conn *conn)
+{
+    struct epoll_event ev;
+    uint32_t events = 0;
+
+    /* back pressure: stop reading if client does not take replies */
+    if (!conn->eof && conn->wlen - conn->woff < SOCKOPT_WBUF_HIGH)
+        events |= EPOLLIN;
+    if (conn->wlen > conn->woff)
+        events |= EPOLLOUT;
+
+    if (events == conn->events)
+        return EDPVS_OK;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = conn;
+    if (epoll_ctl(sockopt_epfd, EPOLL_CTL_MOD, conn->fd, &ev) < 0)
+        return EDPVS_SYSCALL;
+
+    conn->events = events;
+    return EDPVS_OK;
+}
 
-    memset(&clt_addr, 0, sizeof(struct sockaddr_un));
-    clt_len = sizeof(clt_addr);
+static int sockopt_conn_flush(struct sockopt_conn *conn)
+{
+    ssize_t n;
 
-    /* Note: srv_fd is nonblock */
-    clt_fd = accept(srv_fd, (struct sockaddr*)&clt_addr, &clt_len);
-    if (clt_fd < 0) {
-        if (EWOULDBLOCK != errno) {
-            RTE_LOG(WARNING, MSGMGR, "%s: Fail to accept client request\n", __func__);
+    while (conn->woff < conn->wlen) {
+        n = send(conn->fd, conn->wbuf + conn->woff, conn->wlen - conn->woff,
+                 MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            RTE_LOG(WARNING, MSGMGR, "%s: sockopt reply send error: %s\n",
+                    __func__, strerror(errno));
+            return EDPVS_IO;
         }
-        return EDPVS_IO;
+        conn->woff += n;
     }
 
-    /* Note: clt_fd is block */
-    ret = sockopt_msg_recv(clt_fd, &msg);
-    if (unlikely(EDPVS_OK != ret)) {
-        close(clt_fd);
-        return ret;
+    if (conn->woff == conn->wlen)
+        conn->woff = conn->wlen = 0;
+
+    return sockopt_conn_set_events(conn);
+}
+
+/* handle all complete msgs in read buffer, in order */
+static int sockopt_conn_process(struct sockopt_conn *conn)
+{
+    struct dpvs_sock_msg msg_hdr;
+    struct dpvs_sock_msg *msg;
+    size_t off = 0;
+    int err = EDPVS_OK;
+
+    while (conn->rlen - off >= sizeof(msg_hdr)) {
+        memcpy(&msg_hdr, conn->rbuf + off, sizeof(msg_hdr));
+        if (unlikely(msg_hdr.len > SOCKOPT_MSG_MAX)) {
+            RTE_LOG(WARNING, MSGMGR, "%s: sockopt msg too large: %zu\n",
+                    __func__, msg_hdr.len);
+            return EDPVS_INVAL;
+        }
+
+        if (conn->rlen - off < sizeof(msg_hdr) + msg_hdr.len) {
+            /* make room for the whole msg */
+            err = sockopt_buf_reserve(&conn->rbuf, &conn->rsize,
+                                      off + sizeof(msg_hdr) + msg_hdr.len);
+            break;
+        }
+
+        /* copy out to keep the body aligned for handlers */
+        msg = rte_malloc("sockopt_msg", sizeof(msg_hdr) + msg_hdr.len,
+                         RTE_CACHE_LINE_SIZE);
+        if (unlikely(!msg)) {
+            RTE_LOG(ERR, MSGMGR, "%s: no memory\n", __func__);
+            return EDPVS_NOMEM;
+        }
+        memcpy(msg, conn->rbuf + off, sizeof(msg_hdr) + msg_hdr.len);
+        off += sizeof(msg_hdr) + msg_hdr.len;
+
+        err = sockopt_msg_process(conn, msg);
+        sockopt_msg_free(msg);
+        if (err != EDPVS_OK)
+            break;
+
+        if (conn->wlen - conn->woff >= SOCKOPT_WBUF_HIGH)
+            break;
     }
 
-    skopt = sockopts_get(msg);
-    if (skopt) {
-        if (msg->type == SOCKOPT_GET)
-            ret = skopt->get(msg->id, msg->data, msg->len, &reply_data, &reply_data_len);
-        else if (msg->type == SOCKOPT_SET)
-            ret = skopt->set(msg->id, msg->data, msg->len);
-        if (ret < 0) {
-            /* assume that reply_data is freed by user when callback fails */
-            reply_data = NULL;
-            reply_data_len = 0;
-            RTE_LOG(INFO, MSGMGR, "%s: socket msg<type=%s, id=%d> callback failed\n",
-                    __func__, msg->type == SOCKOPT_GET ? "GET" : "SET", msg->id);
+    if (off) {
+        memmove(conn->rbuf, conn->rbuf + off, conn->rlen - off);
+        conn->rlen -= off;
+    }
+
+    return err;
+}
+
+static int sockopt_conn_recv(struct sockopt_conn *conn)
+{
+    size_t budget = SOCKOPT_READ_BUDGET;
+    ssize_t n;
+    int err;
+
+    while (budget > 0) {
+        if (conn->rlen == conn->rsize) {
+            err = sockopt_buf_reserve(&conn->rbuf, &conn->rsize, conn->rlen + 1);
+            if (err != EDPVS_OK)
+                return err;
+        }
+
+        n = recv(conn->fd, conn->rbuf + conn->rlen,
+                 RTE_MIN(conn->rsize - conn->rlen, budget), MSG_DONTWAIT);
+        if (n == 0) {
+            /* peer may only shut down writing after a batch,
+             * serve requests buffered before closing */
+            conn->eof = true;
+            break;
+        }
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return EDPVS_IO;
         }
 
-        memset(&reply_hdr, 0, sizeof(reply_hdr));
-        reply_hdr.version = SOCKOPT_VERSION;
-        reply_hdr.id = msg->id;
-        reply_hdr.type = msg->type;
-        reply_hdr.errcode = ret;
-        strncpy(reply_hdr.errstr, dpvs_strerror(ret), SOCKOPT_ERRSTR_LEN - 1);
-        reply_hdr.len = reply_data_len;
+        conn->rlen += n;
+        budget -= n;
+    }
+
+    return sockopt_conn_process(conn);
+}
+
+static void sockopt_accept(void)
+{
+    struct sockopt_conn *conn;
+    struct epoll_event ev;
+    int clt_fd;
 
-        /* send response */
-        ret = sockopt_msg_send(clt_fd, &reply_hdr, reply_data, reply_data_len);
+    while (sockopt_nconn < SOCKOPT_CONN_MAX) {
+        /* Note: srv_fd is nonblock */
+        clt_fd = accept(srv_fd, NULL, NULL);
+        if (clt_fd < 0) {
+            if (errno != EWOULDBLOCK && errno != EAGAIN && errno != EINTR)
+                RTE_LOG(WARNING, MSGMGR, "%s: Fail to accept client request\n",
+                        __func__);
+            return;
+        }
 
-        if (reply_data)
-            rte_free(reply_data);
+        if (-1 == fcntl(clt_fd, F_SETFL, fcntl(clt_fd, F_GETFL, 0) | O_NONBLOCK)) {
+            RTE_LOG(WARNING, MSGMGR, "%s: Fail to set client socket NONBLOCK\n",
+                    __func__);
+            close(clt_fd);
+            continue;
+        }
 
-        if (EDPVS_OK != ret) {
-            sockopt_msg_free(msg);
+        conn = rte_zmalloc("sockopt_conn", sizeof(*conn), 0);
+        if (unlikely(!conn)) {
             close(clt_fd);
-            return ret;
+            return;
+        }
+        conn->fd = clt_fd;
+        conn->events = EPOLLIN;
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = conn->events;
+        ev.data.ptr = conn;
+        if (epoll_ctl(sockopt_epfd, EPOLL_CTL_ADD, clt_fd, &ev) < 0) {
+            RTE_LOG(WARNING, MSGMGR, "%s: epoll_ctl: %s\n", __func__, strerror(errno));
+            close(clt_fd);
+            rte_free(conn);
+            return;
         }
+
+        list_add_tail(&conn->list, &sockopt_conns);
+        sockopt_nconn++;
     }
+}
 
-    sockopt_msg_free(msg);
-    close(clt_fd);
+int sockopt_ctl(__rte_unused void *arg)
+{
+    struct epoll_event evs[SOCKOPT_EPOLL_EVENTS];
+    struct sockopt_conn *conn;
+    int i, n, err;
+
+    n = epoll_wait(sockopt_epfd, evs, NELEMS(evs), 0);
+    if (n <= 0) {
+        if (n < 0 && errno != EINTR)
+            RTE_LOG(WARNING, MSGMGR, "%s: epoll_wait: %s\n", __func__, strerror(errno));
+        return EDPVS_IDLE;
+    }
+
+    for (i = 0; i < n; i++) {
+        conn = evs[i].data.ptr;
+        if (!conn) {
+            sockopt_accept();
+            continue;
+        }
+
+        err = EDPVS_OK;
+        if (!conn->eof && (evs[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+            err = sockopt_conn_recv(conn);
+        if (err == EDPVS_OK)
+            err = sockopt_conn_flush(conn);
+
+        /* resume msgs held by back pressure */
+        if (err == EDPVS_OK && conn->rlen &&
+                conn->wlen - conn->woff < SOCKOPT_WBUF_HIGH) {
+            err = sockopt_conn_process(conn);
+            if (err == EDPVS_OK)
+                err = sockopt_conn_flush(conn);
+        }
+
+        /* all requests of the closed peer are served and replied */
+        if (err == EDPVS_OK && conn->eof && !conn->wlen)
+            err = EDPVS_NOTEXIST;
+
+        if (err != EDPVS_OK)
+            sockopt_conn_close(conn);
+    }
 
     return EDPVS_OK;
 }
@@ -1361,9 +1671,11 @@ int sockopt_ctl(__rte_unused void *arg)
 static inline int sockopt_init(void)
 {
     struct sockaddr_un srv_addr;
+    struct epoll_event ev;
     int srv_fd_flags = 0;
 
     INIT_LIST_HEAD(&sockopt_list);
+    INIT_LIST_HEAD(&sockopt_conns);
 
     memset(ipc_unix_domain, 0, sizeof(ipc_unix_domain));
     strncpy(ipc_unix_domain, UNIX_DOMAIN_DEF, sizeof(ipc_unix_domain) - 1);
@@ -1393,18 +1705,44 @@ static inline int sockopt_init(void)
         return EDPVS_IO;
     }
 
-    if (-1 == listen(srv_fd, 1)) {
+    if (-1 == listen(srv_fd, SOCKOPT_LISTEN_BACKLOG)) {
         RTE_LOG(ERR, MSGMGR, "%s: Server socket listen failed\n", __func__);
         close(srv_fd);
         unlink(ipc_unix_domain);
         return EDPVS_IO;
     }
 
+    sockopt_epfd = epoll_create(SOCKOPT_CONN_MAX);
+    if (sockopt_epfd < 0) {
+        RTE_LOG(ERR, MSGMGR, "%s: Fail to create epoll fd\n", __func__);
+        close(srv_fd);
+        unlink(ipc_unix_domain);
+        return EDPVS_IO;
+    }
+
+    /* listener is the one with NULL data.ptr */
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(sockopt_epfd, EPOLL_CTL_ADD, srv_fd, &ev) < 0) {
+        RTE_LOG(ERR, MSGMGR, "%s: Fail to add server socket to epoll\n", __func__);
+        close(sockopt_epfd);
+        close(srv_fd);
+        unlink(ipc_unix_domain);
+        return EDPVS_IO;
+    }
+
     return EDPVS_OK;
 }
 
 static inline int sockopt_term(void)
 {
+    struct sockopt_conn *conn, *next;
+
+    list_for_each_entry_safe(conn, next, &sockopt_conns, list)
+        sockopt_conn_close(conn);
+
+    close(sockopt_epfd);
     close(srv_fd);
     unlink(ipc_unix_domain);
     return EDPVS_OK;
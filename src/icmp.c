@@ -18,8 +18,13 @@
 #include <assert.h>
 #include "ipv4.h"
 #include "icmp.h"
+#include "linux_ipv6.h"
+#include "ctrl.h"
+#include "parser/parser.h"
+#include "conf/icmp.h"
 #include "netinet/in.h"
 #include "netinet/ip_icmp.h"
+#include "netinet/icmp6.h"
 
 #define ICMP
 #define RTE_LOGTYPE_ICMP    RTE_LOGTYPE_USER1
@@ -147,6 +152,162 @@ static struct icmp_ctrl icmp_ctrls[MAX_ICMP_CTRL] = {
     },
 };
 
+/*
+ * rate limit of ICMP errors, for both ICMP and ICMPv6.
+ *
+ * like linux icmp_ratelimit/icmp_ratemask, each lcore keeps token buckets
+ * of destination prefixes in a fixed, direct-mapped table (a colliding
+ * prefix takes the slot over), and a per-lcore cap of all errors sent,
+ * like icmp_msgs_per_sec/icmp_msgs_burst. tokens are in milliseconds.
+ */
+#define ICMP_RL_BUCKETS             1024    /* power of 2 */
+#define ICMP_RL_BUCKETS_MASK        (ICMP_RL_BUCKETS - 1)
+
+#define ICMP_RATELIMIT_DEF          1000    /* ms */
+#define ICMP_RATELIMIT_MAX          60000
+#define ICMP_RATELIMIT_BURST_DEF    6
+#define ICMP_RATELIMIT_BURST_MAX    1000
+#define ICMP_RATEMASK_DEF           0x1818  /* unreach, quench, time-exceed, param-prob */
+#define ICMP_PREFIX_LEN_DEF         32
+#define ICMP_PREFIX6_LEN_DEF        64
+#define ICMP_MSGS_PER_SEC_DEF       1000
+#define ICMP_MSGS_BURST_DEF         50
+
+static uint32_t icmp_ratelimit = ICMP_RATELIMIT_DEF;
+static uint32_t icmp_ratelimit_burst = ICMP_RATELIMIT_BURST_DEF;
+static uint32_t icmp_ratemask = ICMP_RATEMASK_DEF;
+static uint8_t icmp_prefix_len = ICMP_PREFIX_LEN_DEF;
+static uint8_t icmp_prefix6_len = ICMP_PREFIX6_LEN_DEF;
+static uint32_t icmp_msgs_per_sec = ICMP_MSGS_PER_SEC_DEF;
+static uint32_t icmp_msgs_burst = ICMP_MSGS_BURST_DEF;
+
+struct icmp_rl_bucket {
+    union inet_addr     prefix;
+    uint64_t            last;       /* ms */
+    uint32_t            tokens;     /* ms */
+    uint8_t             af;         /* AF_UNSPEC: unused */
+};
+
+struct icmp_rl {
+    uint64_t            last;       /* ms, of global credit */
+    uint32_t            credit;
+    uint32_t            seed;
+    struct icmp_rl_stats    stats;
+    struct icmp_rl_bucket   buckets[ICMP_RL_BUCKETS];
+} __rte_cache_aligned;
+
+static struct icmp_rl *icmp_rls[RTE_MAX_LCORE];
+static uint64_t icmp_rl_cycles_per_ms;
+
+static inline bool icmp_rl_masked(int af, int type)
+{
+    if (af == AF_INET6) /* errors, but PMTU discovery, like linux */
+        return !(type & ICMP6_INFOMSG_MASK) && type != ICMP6_PACKET_TOO_BIG;
+
+    return type < 32 && (icmp_ratemask & (1U << type));
+}
+
+static struct icmp_rl_bucket *icmp_rl_bucket_get(struct icmp_rl *rl, int af,
+                                                 const union inet_addr *daddr,
+                                                 union inet_addr *prefix)
+{
+    uint32_t hash;
+
+    memset(prefix, 0, sizeof(*prefix));
+    if (af == AF_INET6) {
+        ipv6_addr_prefix(&prefix->in6, &daddr->in6, icmp_prefix6_len);
+        hash = rte_jhash_32b((const uint32_t *)&prefix->in6, 4, rl->seed);
+    } else {
+        if (icmp_prefix_len)
+            prefix->in.s_addr = daddr->in.s_addr & \
+                                htonl(~0U << (32 - icmp_prefix_len));
+        hash = rte_jhash_1word(prefix->in.s_addr, rl->seed);
+    }
+
+    return &rl->buckets[hash & ICMP_RL_BUCKETS_MASK];
+}
+
+/* linux inet_peer_xrlim_allow */
+static bool icmp_rl_host_allow(struct icmp_rl *rl, int af,
+                               const union inet_addr *daddr, uint64_t now)
+{
+    struct icmp_rl_bucket *bkt;
+    union inet_addr prefix;
+    uint64_t token, max;
+    bool allow = false;
+
+    if (!icmp_ratelimit)
+        return true;
+
+    max = (uint64_t)icmp_ratelimit * icmp_ratelimit_burst;
+
+    bkt = icmp_rl_bucket_get(rl, af, daddr, &prefix);
+    if (bkt->af != af || !inet_addr_equal(af, &bkt->prefix, &prefix)) {
+        if (bkt->af != AF_UNSPEC)
+            rl->stats.evicted++;
+        bkt->af = af;
+        bkt->prefix = prefix;
+        token = max;
+    } else {
+        token = bkt->tokens + (now - bkt->last);
+        if (token > max)
+            token = max;
+    }
+
+    if (token >= icmp_ratelimit) {
+        token -= icmp_ratelimit;
+        allow = true;
+    }
+
+    bkt->tokens = token;
+    bkt->last = now;
+    return allow;
+}
+
+/* linux icmp_global_allow, refill only, consumed by caller */
+static bool icmp_rl_global_allow(struct icmp_rl *rl, uint64_t now)
+{
+    uint64_t delta, incr;
+
+    if (!icmp_msgs_per_sec)
+        return true;
+
+    delta = RTE_MIN(now - rl->last, (uint64_t)1000);
+    incr = delta * icmp_msgs_per_sec / 1000;
+    if (incr) {
+        rl->credit = RTE_MIN(rl->credit + incr, (uint64_t)icmp_msgs_burst);
+        rl->last = now;
+    }
+
+    return rl->credit > 0;
+}
+
+bool icmp_ratelimit_allow(int af, const union inet_addr *daddr, int type)
+{
+    struct icmp_rl *rl = icmp_rls[rte_lcore_id()];
+    uint64_t now;
+
+    if (unlikely(!rl))
+        return true;
+
+    now = rte_get_timer_cycles() / icmp_rl_cycles_per_ms;
+
+    if (!icmp_rl_global_allow(rl, now)) {
+        rl->stats.global_limited++;
+        return false;
+    }
+
+    if (icmp_rl_masked(af, type) && !icmp_rl_host_allow(rl, af, daddr, now)) {
+        rl->stats.host_limited++;
+        return false;
+    }
+
+    if (icmp_msgs_per_sec)
+        rl->credit--;
+    rl->stats.passed++;
+    return true;
+}
+
 /* @imbuf is input (original) IP packet to trigger ICMP. */
 void icmp_send(struct rte_mbuf *imbuf, int type, int code, uint32_t info)
 {
@@ -205,6 +366,12 @@ void icmp_send(struct rte_mbuf *imbuf, int type, int code, uint32_t info)
         }
     }
 
+    if (!icmp_ratelimit_allow(AF_INET,
+                              (union inet_addr *)&iph->src_addr, type)) {
+        RTE_LOG(DEBUG, ICMP, "%s: rate limited.\n", __func__);
+        return;
+    }
+
     /* determing source address */
     if (rt->flag & RTF_LOCALIN) { /* original pkt's dest is us ? */
         saddr.s_addr = iph->dst_addr;
@@ -309,11 +476,266 @@ static struct inet_protocol icmp_protocol = {
     .handler    = icmp_rcv,
 };
 
+/*
+ * configure file
+ */
+static uint32_t icmp_conf_uint(vector_t tokens, const char *name,
+                               uint32_t min, uint32_t max, uint32_t def)
+{
+    char *str = set_value(tokens);
+    unsigned long val;
+    char *end;
+
+    assert(str);
+    val = strtoul(str, &end, 0);
+    if (*end != '\0' || val < min || val > max) {
+        RTE_LOG(WARNING, ICMP, "invalid icmp %s %s, using default %u\n",
+                name, str, def);
+        val = def;
+    } else {
+        RTE_LOG(INFO, ICMP, "icmp %s = %lu\n", name, val);
+    }
+
+    FREE_PTR(str);
+    return val;
+}
+
+static void ratelimit_handler(vector_t tokens)
+{
+    icmp_ratelimit = icmp_conf_uint(tokens, "ratelimit", 0,
+                                    ICMP_RATELIMIT_MAX, ICMP_RATELIMIT_DEF);
+}
+
+static void ratelimit_burst_handler(vector_t tokens)
+{
+    icmp_ratelimit_burst = icmp_conf_uint(tokens, "ratelimit_burst", 1,
+                                          ICMP_RATELIMIT_BURST_MAX,
+                                          ICMP_RATELIMIT_BURST_DEF);
+}
+
+static void ratemask_handler(vector_t tokens)
+{
+    icmp_ratemask = icmp_conf_uint(tokens, "ratemask", 0, UINT32_MAX,
+                                   ICMP_RATEMASK_DEF);
+}
+
+static void prefix_len_handler(vector_t tokens)
+{
+    icmp_prefix_len = icmp_conf_uint(tokens, "prefix_len", 0, 32,
+                                     ICMP_PREFIX_LEN_DEF);
+}
+
+static void prefix6_len_handler(vector_t tokens)
+{
+    icmp_prefix6_len = icmp_conf_uint(tokens, "prefix6_len", 0, 128,
+                                      ICMP_PREFIX6_LEN_DEF);
+}
+
+static void msgs_per_sec_handler(vector_t tokens)
+{
+    icmp_msgs_per_sec = icmp_conf_uint(tokens, "msgs_per_sec", 0, 1000000,
+                                       ICMP_MSGS_PER_SEC_DEF);
+}
+
+static void msgs_burst_handler(vector_t tokens)
+{
+    icmp_msgs_burst = icmp_conf_uint(tokens, "msgs_burst", 1, 1000000,
+                                     ICMP_MSGS_BURST_DEF);
+}
+
+void icmp_keyword_value_init(void)
+{
+    if (dpvs_state_get() == DPVS_STATE_INIT) {
+        /* KW_TYPE_INIT keyword */
+    }
+    /* KW_TYPE_NORMAL keyword */
+    icmp_ratelimit = ICMP_RATELIMIT_DEF;
+    icmp_ratelimit_burst = ICMP_RATELIMIT_BURST_DEF;
+    icmp_ratemask = ICMP_RATEMASK_DEF;
+    icmp_prefix_len = ICMP_PREFIX_LEN_DEF;
+    icmp_prefix6_len = ICMP_PREFIX6_LEN_DEF;
+    icmp_msgs_per_sec = ICMP_MSGS_PER_SEC_DEF;
+    icmp_msgs_burst = ICMP_MSGS_BURST_DEF;
+}
+
+void install_icmp_keywords(void)
+{
+    install_keyword_root("icmp_defs", NULL);
+    install_keyword("ratelimit", ratelimit_handler, KW_TYPE_NORMAL);
+    install_keyword("ratelimit_burst", ratelimit_burst_handler, KW_TYPE_NORMAL);
+    install_keyword("ratemask", ratemask_handler, KW_TYPE_NORMAL);
+    install_keyword("prefix_len", prefix_len_handler, KW_TYPE_NORMAL);
+    install_keyword("prefix6_len", prefix6_len_handler, KW_TYPE_NORMAL);
+    install_keyword("msgs_per_sec", msgs_per_sec_handler, KW_TYPE_NORMAL);
+    install_keyword("msgs_burst", msgs_burst_handler, KW_TYPE_NORMAL);
+}
+
+/*
+ * control plane
+ */
+static int icmp_msg_get_rl_stats(struct dpvs_msg *msg)
+{
+    struct icmp_rl *rl = icmp_rls[rte_lcore_id()];
+    struct icmp_rl_stats *stats;
+    assert(msg);
+
+    stats = msg_reply_alloc(sizeof(*stats));
+    if (!stats)
+        return EDPVS_NOMEM;
+
+    if (rl)
+        *stats = rl->stats;
+    else
+        memset(stats, 0, sizeof(*stats));
+
+    msg->reply.len = sizeof(*stats);
+    msg->reply.data = stats;
+
+    return EDPVS_OK;
+}
+
+static int icmp_sockopt_set(sockoptid_t opt, const void *in, size_t inlen)
+{
+    return EDPVS_NOTSUPP;
+}
+
+static int icmp_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
+                            void **out, size_t *outsize)
+{
+    struct icmp_rl_param *param;
+    struct dpvs_msg *req, *reply;
+    struct dpvs_multicast_queue *replies = NULL;
+    int err;
+
+    if (opt != SOCKOPT_GET_ICMP_RL)
+        return EDPVS_NOTSUPP;
+    if (!out || !outsize)
+        return EDPVS_INVAL;
+
+    req = msg_make(MSG_TYPE_ICMP_RL_STATS, 0, DPVS_MSG_MULTICAST,
+                   rte_lcore_id(), 0, NULL);
+    if (!req)
+        return EDPVS_NOMEM;
+
+    param = rte_zmalloc(NULL, sizeof(struct icmp_rl_param), 0);
+    if (!param) {
+        msg_destroy(&req);
+        return EDPVS_NOMEM;
+    }
+
+    param->ratelimit        = icmp_ratelimit;
+    param->ratelimit_burst  = icmp_ratelimit_burst;
+    param->ratemask         = icmp_ratemask;
+    param->prefix_len       = icmp_prefix_len;
+    param->prefix6_len      = icmp_prefix6_len;
+    param->msgs_per_sec     = icmp_msgs_per_sec;
+    param->msgs_burst       = icmp_msgs_burst;
+    param->buckets          = ICMP_RL_BUCKETS;
+
+    err = multicast_msg_send(req, 0, &replies);
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, ICMP, "%s: send msg: %s\n", __func__, dpvs_strerror(err));
+        msg_destroy(&req);
+        rte_free(param);
+        return err;
+    }
+
+    list_for_each_entry(reply, &replies->mq, mq_node) {
+        struct icmp_rl_stats *stats = (struct icmp_rl_stats *)reply->data;
+
+        param->stats.passed += stats->passed;
+        param->stats.host_limited += stats->host_limited;
+        param->stats.global_limited += stats->global_limited;
+        param->stats.evicted += stats->evicted;
+        param->stats_cpus[reply->cid] = *stats;
+    }
+
+    *out = param;
+    *outsize = sizeof(*param);
+
+    msg_destroy(&req);
+    return EDPVS_OK;
+}
+
+static struct dpvs_msg_type icmp_rl_stats_msg = {
+    .type           = MSG_TYPE_ICMP_RL_STATS,
+    .prio           = MSG_PRIO_LOW,
+    .unicast_msg_cb = icmp_msg_get_rl_stats,
+};
+
+static struct dpvs_sockopts icmp_sockopts = {
+    .version        = SOCKOPT_VERSION,
+    .set_opt_min    = SOCKOPT_SET_ICMP,
+    .set_opt_max    = SOCKOPT_SET_ICMP,
+    .set            = icmp_sockopt_set,
+    .get_opt_min    = SOCKOPT_GET_ICMP_RL,
+    .get_opt_max    = SOCKOPT_GET_ICMP_RL,
+    .get            = icmp_sockopt_get,
+};
+
+static int icmp_rl_init(void)
+{
+    lcoreid_t cid;
+    int err;
+
+    icmp_rl_cycles_per_ms = rte_get_timer_hz() / 1000;
+
+    RTE_LCORE_FOREACH(cid) {
+        icmp_rls[cid] = rte_zmalloc_socket("icmp_rl", sizeof(struct icmp_rl),
+                                           RTE_CACHE_LINE_SIZE,
+                                           rte_lcore_to_socket_id(cid));
+        if (!icmp_rls[cid]) {
+            err = EDPVS_NOMEM;
+            goto errout;
+        }
+        icmp_rls[cid]->seed = (uint32_t)rte_rand();
+        icmp_rls[cid]->credit = icmp_msgs_burst;
+    }
+
+    err = msg_type_mc_register(&icmp_rl_stats_msg);
+    if (err != EDPVS_OK)
+        goto errout;
+
+    err = sockopt_register(&icmp_sockopts);
+    if (err != EDPVS_OK) {
+        msg_type_mc_unregister(&icmp_rl_stats_msg);
+        goto errout;
+    }
+
+    return EDPVS_OK;
+
+errout:
+    RTE_LCORE_FOREACH(cid) {
+        rte_free(icmp_rls[cid]);
+        icmp_rls[cid] = NULL;
+    }
+    return err;
+}
+
+static void icmp_rl_term(void)
+{
+    lcoreid_t cid;
+
+    sockopt_unregister(&icmp_sockopts);
+    msg_type_mc_unregister(&icmp_rl_stats_msg);
+
+    RTE_LCORE_FOREACH(cid) {
+        rte_free(icmp_rls[cid]);
+        icmp_rls[cid] = NULL;
+    }
+}
+
 int icmp_init(void)
 {
     int err;
 
+    err = icmp_rl_init();
+    if (err != EDPVS_OK)
+        return err;
+
     err = ipv4_register_protocol(&icmp_protocol, IPPROTO_ICMP);
+    if (err != EDPVS_OK)
+        icmp_rl_term();
 
     return err;
 }
@@ -324,5 +746,7 @@ int icmp_term(void)
 
     err = ipv4_unregister_protocol(&icmp_protocol, IPPROTO_ICMP);
 
+    icmp_rl_term();
+
     return err;
 }
@@ -29,6 +29,7 @@
 #include "icmp6.h"
 #include "inetaddr.h"
 #include "ipset.h"
+#include "prof.h"
 
 #define INET
 #define RTE_LOGTYPE_INET RTE_LOGTYPE_USER1
@@ -242,6 +243,7 @@ int INET_HOOK(int af, unsigned int hook, struct rte_mbuf *mbuf,
     ops = list_entry(hook_list, struct inet_hook_ops, list);
 
     if (!list_empty(hook_list)) {
+        DPVS_PROF_START(prof_tsc);
         verdict = INET_ACCEPT;
         list_for_each_entry_continue(ops, hook_list, list) {
 repeat:
@@ -252,6 +254,7 @@ repeat:
                 break;
             }
         }
+        DPVS_PROF_END(DPVS_PROF_HOOK, prof_tsc);
     }
 
     if (verdict == INET_ACCEPT || verdict == INET_STOP) {
@@ -0,0 +1,231 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * dpvs IPv6 tunnels, IPv6-in-IPv6 (ip6ip6) and IPv4-in-IPv6 (ipip6).
+ * refer linux:net/ipv6/ip6_tunnel.c
+ */
+#include <assert.h>
+#include <linux/if_ether.h>
+#include "ipv6.h"
+#include "ip_tunnel.h"
+
+#define IP6TNL
+#define RTE_LOGTYPE_IP6TNL  RTE_LOGTYPE_USER1
+
+static struct ip_tunnel_tab ip6ip6_tunnel_tab;
+static struct ip_tunnel_tab ipip6_tunnel_tab;
+
+/* dummy packet info for ip6ip6/ipip6 tunnel. */
+static struct ip_tunnel_pktinfo ip6ip6_tpi = {
+    /* .proto      = htons(ETH_P_IPV6), */
+};
+
+static struct ip_tunnel_pktinfo ipip6_tpi = {
+    /* .proto      = htons(ETH_P_IP), */
+};
+
+static inline bool ip6_tnl_proto_match(const struct ip_tunnel *tnl,
+                                       uint8_t proto)
+{
+    return tnl->params.ip6h.ip6_nxt == proto ||
+           tnl->params.ip6h.ip6_nxt == 0;
+}
+
+static int ip6ip6_xmit(struct rte_mbuf *mbuf, struct netif_port *dev)
+{
+    struct ip_tunnel *tnl = netif_priv(dev);
+
+    if (mbuf->packet_type != ETHER_TYPE_IPv6 ||
+        !ip6_tnl_proto_match(tnl, IPPROTO_IPV6)) {
+        rte_pktmbuf_free(mbuf);
+        return EDPVS_DROP;
+    }
+
+    return ip6_tunnel_xmit(mbuf, dev, &tnl->params.ip6h, IPPROTO_IPV6);
+}
+
+static int ipip6_xmit(struct rte_mbuf *mbuf, struct netif_port *dev)
+{
+    struct ip_tunnel *tnl = netif_priv(dev);
+
+    if (mbuf->packet_type != ETHER_TYPE_IPv4 ||
+        !ip6_tnl_proto_match(tnl, IPPROTO_IPIP)) {
+        rte_pktmbuf_free(mbuf);
+        return EDPVS_DROP;
+    }
+
+    return ip6_tunnel_xmit(mbuf, dev, &tnl->params.ip6h, IPPROTO_IPIP);
+}
+
+static struct netif_ops ip6ip6_dev_ops = {
+    .op_xmit        = ip6ip6_xmit,
+    .op_get_link    = ip_tunnel_get_link,
+    .op_get_stats   = ip_tunnel_get_stats,
+    .op_get_promisc = ip_tunnel_get_promisc,
+};
+
+static struct netif_ops ipip6_dev_ops = {
+    .op_xmit        = ipip6_xmit,
+    .op_get_link    = ip_tunnel_get_link,
+    .op_get_stats   = ip_tunnel_get_stats,
+    .op_get_promisc = ip_tunnel_get_promisc,
+};
+
+static void ip6ip6_setup(struct netif_port *dev)
+{
+    struct ip_tunnel *tnl = netif_priv(dev);
+
+    dev->netif_ops = &ip6ip6_dev_ops;
+    tnl->hlen = 0; /* no overhead other than outer IPv6 header */
+}
+
+static void ipip6_setup(struct netif_port *dev)
+{
+    struct ip_tunnel *tnl = netif_priv(dev);
+
+    dev->netif_ops = &ipip6_dev_ops;
+    tnl->hlen = 0;
+}
+
+static int ip6_tnl_rcv(struct rte_mbuf *mbuf, struct ip_tunnel_tab *tab,
+                       struct ip_tunnel_pktinfo *tpi, uint8_t proto)
+{
+    struct ip6_hdr *ip6h;
+    struct ip_tunnel *tnl;
+
+    /* IPv6's upper layer can use @userdata for IPv6 header,
+     * see ip6_local_in_fin() */
+    ip6h = mbuf->userdata;
+    assert((ip6h->ip6_vfc >> 4) == 6);
+
+    tnl = ip6_tunnel_lookup(tab, mbuf->port, TUNNEL_F_NO_KEY,
+                            &ip6h->ip6_src, &ip6h->ip6_dst, 0);
+    if (!tnl)
+        goto drop;
+
+    if (!ip6_tnl_proto_match(tnl, proto))
+        goto drop;
+
+    if (ip_tunnel_pull_header(mbuf, 0, tpi->proto) != EDPVS_OK)
+        goto drop;
+
+    return ip_tunnel_rcv(tnl, tpi, mbuf);
+
+drop:
+    rte_pktmbuf_free(mbuf);
+    return EDPVS_DROP;
+}
+
+static int ip6ip6_rcv(struct rte_mbuf *mbuf)
+{
+    return ip6_tnl_rcv(mbuf, &ip6ip6_tunnel_tab, &ip6ip6_tpi, IPPROTO_IPV6);
+}
+
+static int ipip6_rcv(struct rte_mbuf *mbuf)
+{
+    return ip6_tnl_rcv(mbuf, &ipip6_tunnel_tab, &ipip6_tpi, IPPROTO_IPIP);
+}
+
+static struct ip_tunnel_ops ip6ip6_tunnel_ops = {
+    .kind       = "ip6ip6",
+    .af         = AF_INET6,
+    .priv_size  = sizeof(struct ip_tunnel),
+    .setup      = ip6ip6_setup,
+};
+
+static struct ip_tunnel_ops ipip6_tunnel_ops = {
+    .kind       = "ipip6",
+    .af         = AF_INET6,
+    .priv_size  = sizeof(struct ip_tunnel),
+    .setup      = ipip6_setup,
+};
+
+static struct inet6_protocol ip6ip6_proto = {
+    .handler    = ip6ip6_rcv,
+    .flags      = INET6_PROTO_F_FINAL,
+};
+
+static struct inet6_protocol ipip6_proto = {
+    .handler    = ipip6_rcv,
+    .flags      = INET6_PROTO_F_FINAL,
+};
+
+int ip6_tunnel_init(void)
+{
+    int err;
+
+    ip6ip6_tpi.proto = htons(ETH_P_IPV6);
+    ipip6_tpi.proto = htons(ETH_P_IP);
+
+    err = ip_tunnel_init_tab(&ip6ip6_tunnel_tab, &ip6ip6_tunnel_ops,
+                             "ip6tnl0");
+    if (err != EDPVS_OK)
+        return err;
+
+    err = ipv6_register_protocol(&ip6ip6_proto, IPPROTO_IPV6);
+    if (err != EDPVS_OK)
+        goto ip6ip6_fail;
+
+    err = ip_tunnel_init_tab(&ipip6_tunnel_tab, &ipip6_tunnel_ops,
+                             "ipip6tnl0");
+    if (err != EDPVS_OK)
+        goto tab_fail;
+
+    err = ipv6_register_protocol(&ipip6_proto, IPPROTO_IPIP);
+    if (err != EDPVS_OK)
+        goto ipip6_fail;
+
+    return EDPVS_OK;
+
+ipip6_fail:
+    ip_tunnel_term_tab(&ipip6_tunnel_tab);
+tab_fail:
+    ipv6_unregister_protocol(&ip6ip6_proto, IPPROTO_IPV6);
+ip6ip6_fail:
+    ip_tunnel_term_tab(&ip6ip6_tunnel_tab);
+    return err;
+}
+
+int ip6_tunnel_term(void)
+{
+    int err;
+
+    err = ipv6_unregister_protocol(&ipip6_proto, IPPROTO_IPIP);
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IP6TNL, "%s: fail to unregister ipip6 proto\n", __func__);
+        return err;
+    }
+
+    err = ip_tunnel_term_tab(&ipip6_tunnel_tab);
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IP6TNL, "%s: fail to term ipip6 tab\n", __func__);
+        return err;
+    }
+
+    err = ipv6_unregister_protocol(&ip6ip6_proto, IPPROTO_IPV6);
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IP6TNL, "%s: fail to unregister ip6ip6 proto\n", __func__);
+        return err;
+    }
+
+    err = ip_tunnel_term_tab(&ip6ip6_tunnel_tab);
+    if (err != EDPVS_OK)
+        RTE_LOG(ERR, IP6TNL, "%s: fail to term ip6ip6 tab\n", __func__);
+
+    return err;
+}
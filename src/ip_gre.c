@@ -16,17 +16,20 @@
  *
  */
 /*
- * dpvs GRE/IP tunnel.
- * refer linux:net/ipv4/ip_gre.c, net/gre.h
+ * dpvs GRE/IP and GRE/IPv6 tunnel.
+ * refer linux:net/ipv4/ip_gre.c, net/ipv6/ip6_gre.c, net/gre.h
  *
  * raychen@qiyi.com, Jan 2018, initial.
  */
 #include <assert.h>
 #include <endian.h>
+#include <netinet/icmp6.h>
 #include "dpdk.h"
 #include "netif.h"
 #include "ipv4.h"
+#include "ipv6.h"
 #include "icmp.h"
+#include "icmp6.h"
 #include "ip_tunnel.h"
 
 #define GRE
@@ -48,6 +51,7 @@ struct gre_base_hdr {
 } __attribute__((__packed__));
 
 static struct ip_tunnel_tab gre_tunnel_tab;
+static struct ip_tunnel_tab ip6gre_tunnel_tab;
 
 /* linux: gre_flags_to_tnl_flags */
 static inline __be16 flags_gre2tnl(__be16 flags)
@@ -227,6 +231,25 @@ static int gre_xmit(struct rte_mbuf *mbuf, struct netif_port *dev)
     return ip_tunnel_xmit(mbuf, dev, tiph, IPPROTO_GRE);
 }
 
+static int ip6gre_xmit(struct rte_mbuf *mbuf, struct netif_port *dev)
+{
+    struct ip_tunnel *tnl = netif_priv(dev);
+    int err;
+
+    if (tnl->params.o_flags & TUNNEL_F_SEQ)
+        tnl->o_seqno++;
+
+    err = gre_build_header(mbuf, tnl->hlen, tnl->params.o_flags,
+                           htons(mbuf->packet_type), tnl->params.o_key,
+                           htonl(tnl->o_seqno));
+    if (err != EDPVS_OK) {
+        rte_pktmbuf_free(mbuf);
+        return err;
+    }
+
+    return ip6_tunnel_xmit(mbuf, dev, &tnl->params.ip6h, IPPROTO_GRE);
+}
+
 static int gre_dev_init(struct netif_port *dev)
 {
     struct ip_tunnel *tnl = netif_priv(dev);
@@ -244,11 +267,24 @@ static struct netif_ops gre_dev_ops = {
     .op_get_promisc = ip_tunnel_get_promisc,
 };
 
+static struct netif_ops ip6gre_dev_ops = {
+    .op_init        = gre_dev_init,
+    .op_xmit        = ip6gre_xmit,
+    .op_get_link    = ip_tunnel_get_link,
+    .op_get_stats   = ip_tunnel_get_stats,
+    .op_get_promisc = ip_tunnel_get_promisc,
+};
+
 static void gre_setup(struct netif_port *dev)
 {
     dev->netif_ops = &gre_dev_ops;
 }
 
+static void ip6gre_setup(struct netif_port *dev)
+{
+    dev->netif_ops = &ip6gre_dev_ops;
+}
+
 static int gre_change(struct netif_port *dev,
                       const struct ip_tunnel_param *param)
 {
@@ -291,17 +327,63 @@ drop:
     return EDPVS_DROP;
 }
 
+static int ip6gre_rcv(struct rte_mbuf *mbuf)
+{
+    int hlen;
+    struct ip6_hdr *ip6h;
+    struct ip_tunnel *tnl;
+    struct ip_tunnel_pktinfo tpi;
+    bool csum_err = false;
+
+    hlen = gre_parse_header(mbuf, &tpi, &csum_err, htons(ETH_P_IPV6));
+    if (hlen < 0)
+        goto drop;
+
+    ip6h = mbuf->userdata; /* see ip6_local_in_fin */
+    assert((ip6h->ip6_vfc >> 4) == 6);
+
+    tnl = ip6_tunnel_lookup(&ip6gre_tunnel_tab, mbuf->port, tpi.flags,
+                            &ip6h->ip6_src, &ip6h->ip6_dst, tpi.key);
+    if (!tnl) {
+        icmp6_send(mbuf, ICMP6_DST_UNREACH, ICMP6_DST_UNREACH_NOPORT, 0);
+        goto drop;
+    }
+
+    if (ip_tunnel_pull_header(mbuf, hlen, tpi.proto) != 0)
+        goto drop;
+
+    return ip_tunnel_rcv(tnl, &tpi, mbuf);
+
+drop:
+    rte_pktmbuf_free(mbuf);
+    return EDPVS_DROP;
+}
+
 static struct ip_tunnel_ops gre_tnl_ops = {
     .kind       = "gre",
+    .af         = AF_INET,
     .priv_size  = sizeof(struct ip_tunnel),
     .setup      = gre_setup,
     .change     = gre_change,
 };
 
+static struct ip_tunnel_ops ip6gre_tnl_ops = {
+    .kind       = "ip6gre",
+    .af         = AF_INET6,
+    .priv_size  = sizeof(struct ip_tunnel),
+    .setup      = ip6gre_setup,
+    .change     = gre_change,
+};
+
 static struct inet_protocol gre_proto = {
     .handler    = gre_rcv,
 };
 
+static struct inet6_protocol ip6gre_proto = {
+    .handler    = ip6gre_rcv,
+    .flags      = INET6_PROTO_F_FINAL,
+};
+
 int gre_init(void)
 {
     int err;
@@ -311,11 +393,25 @@ int gre_init(void)
         return err;
 
     err = ipv4_register_protocol(&gre_proto, IPPROTO_GRE);
-    if (err != EDPVS_OK) {
-        ip_tunnel_term_tab(&gre_tunnel_tab);
-        return err;
-    }
+    if (err != EDPVS_OK)
+        goto gre_fail;
+
+    err = ip_tunnel_init_tab(&ip6gre_tunnel_tab, &ip6gre_tnl_ops, "ip6gre0");
+    if (err != EDPVS_OK)
+        goto tab6_fail;
+
+    err = ipv6_register_protocol(&ip6gre_proto, IPPROTO_GRE);
+    if (err != EDPVS_OK)
+        goto ip6gre_fail;
+
+    return EDPVS_OK;
 
+ip6gre_fail:
+    ip_tunnel_term_tab(&ip6gre_tunnel_tab);
+tab6_fail:
+    ipv4_unregister_protocol(&gre_proto, IPPROTO_GRE);
+gre_fail:
+    ip_tunnel_term_tab(&gre_tunnel_tab);
     return err;
 }
 
@@ -323,6 +419,14 @@ int gre_term(void)
 {
     int err;
 
+    err = ipv6_unregister_protocol(&ip6gre_proto, IPPROTO_GRE);
+    if (err != EDPVS_OK)
+        return err;
+
+    err = ip_tunnel_term_tab(&ip6gre_tunnel_tab);
+    if (err != EDPVS_OK)
+        return err;
+
     err = ipv4_unregister_protocol(&gre_proto, IPPROTO_GRE);
     if (err != EDPVS_OK)
         return err;
@@ -16,18 +16,23 @@
  *
  */
 /*
- * IPv4 tunnel commom routines and control plane codes.
+ * IPv4/IPv6 tunnel commom routines and control plane codes.
  *
  * raychen@qiyi.com, Dec 2017, initial.
  */
 #include <assert.h>
 #include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/icmp6.h>
 #include <linux/if_ether.h>
 #include "list.h"
 #include "common.h"
 #include "netif.h"
 #include "ipv4.h"
+#include "ipv6.h"
 #include "icmp.h"
+#include "icmp6.h"
+#include "inetaddr.h"
 #include "ctrl.h"
 #include "ip_tunnel.h"
 
@@ -90,19 +95,88 @@ static struct ip_tunnel_ops *tunnel_find_ops(const char *kind)
     return NULL;
 }
 
+static const union inet_addr tunnel_addr_any;
+
 static inline struct hlist_head *
-tunnel_hash_head(struct ip_tunnel_tab *tab, __be32 key, __be32 remote)
+tunnel_hash_head(struct ip_tunnel_tab *tab, __be32 key, int af,
+                 const union inet_addr *remote)
 {
-    uint32_t h = (uint32_t)key ^ (uint32_t)remote;
+    uint32_t h = (uint32_t)key ^ inet_addr_fold(af, remote);
     return &tab->tunnels[h % IP_TNL_HASH_SIZE];
 }
 
-static inline void tunnel_clear_rt_cache(struct ip_tunnel *tnl)
+static inline const union inet_addr *tunnel_raddr(const struct ip_tunnel *tnl)
 {
-    if (tnl->rt_cache) {
-        route4_put(tnl->rt_cache);
-        tnl->rt_cache = NULL;
-    }
+    if (tnl->af == AF_INET6)
+        return (const union inet_addr *)&tnl->params.ip6h.ip6_dst;
+    return (const union inet_addr *)&tnl->params.iph.daddr;
+}
+
+static inline const union inet_addr *tunnel_laddr(const struct ip_tunnel *tnl)
+{
+    if (tnl->af == AF_INET6)
+        return (const union inet_addr *)&tnl->params.ip6h.ip6_src;
+    return (const union inet_addr *)&tnl->params.iph.saddr;
+}
+
+static inline bool tunnel_addr_equal(int af, const union inet_addr *a1,
+                                     const union inet_addr *a2)
+{
+    if (af == AF_INET6)
+        return ipv6_addr_equal(&a1->in6, &a2->in6);
+    return a1->in.s_addr == a2->in.s_addr;
+}
+
+static inline bool tunnel_addr_is_any(int af, const union inet_addr *addr)
+{
+    if (af == AF_INET6)
+        return ipv6_addr_any(&addr->in6);
+    return addr->in.s_addr == htonl(INADDR_ANY);
+}
+
+static inline bool tunnel_addr_multicast(int af, const union inet_addr *addr)
+{
+    if (af == AF_INET6)
+        return ipv6_addr_is_multicast(&addr->in6);
+    return IN_MULTICAST(ntohl(addr->in.s_addr));
+}
+
+static inline void tunnel_dst_release(struct ip_tunnel *tnl,
+                                      struct ip_tunnel_dst *idst)
+{
+    if (!idst->rt4)
+        return;
+
+    if (tnl->af == AF_INET6)
+        route6_put(idst->rt6);
+    else
+        route4_put(idst->rt4);
+    idst->rt4 = NULL;
+}
+
+/*
+ * stale the per-lcore route caches, each lcore drops its own entry on
+ * next xmit. called on master with ip_tunnel_lock held.
+ */
+static inline void tunnel_dst_invalidate(struct ip_tunnel *tnl)
+{
+    tnl->genid++;
+    rte_wmb();
+}
+
+/* release all per-lcore caches, the device is no longer reachable. */
+static void tunnel_dst_flush(struct ip_tunnel *tnl)
+{
+    lcoreid_t cid;
+
+    if (!tnl->dst_cache)
+        return;
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++)
+        tunnel_dst_release(tnl, &tnl->dst_cache[cid]);
+
+    rte_free(tnl->dst_cache);
+    tnl->dst_cache = NULL;
 }
 
 /* linux:ip_tunnel_bind_dev
@@ -111,12 +185,37 @@ static int tunnel_bind_dev(struct netif_port *dev)
 {
     struct ip_tunnel *tnl = netif_priv(dev);
     const struct iphdr *tiph = &tnl->params.iph;
+    const struct ip6_hdr *tip6h = &tnl->params.ip6h;
     struct netif_port *linkdev = NULL;
     int mtu = ETH_DATA_LEN; /* 1500 */
-    int t_hlen = tnl->hlen + sizeof(struct iphdr);
+    int t_hlen, min_mtu;
+
+    if (tnl->af == AF_INET6) {
+        t_hlen = tnl->hlen + sizeof(struct ip6_hdr);
+        min_mtu = IPV6_MIN_MTU;
+    } else {
+        t_hlen = tnl->hlen + sizeof(struct iphdr);
+        min_mtu = IPV4_MIN_MTU;
+    }
 
     /* guess output device to choose mtu and headroom */
-    if (tiph->daddr) {
+    if (tnl->af == AF_INET6 && !ipv6_addr_any(&tip6h->ip6_dst)) {
+        struct route6 *rt6;
+        struct flow6 fl6 = {
+            .fl6_proto          = tip6h->ip6_nxt,
+            .fl6_daddr          = tip6h->ip6_dst,
+            .fl6_saddr          = tip6h->ip6_src,
+            .fl6_oif            = tnl->link,
+        };
+
+        rt6 = route6_output(NULL, &fl6);
+        if (rt6) {
+            linkdev = rt6->rt6_dev;
+            route6_put(rt6);
+        }
+
+        tunnel_dst_invalidate(tnl);
+    } else if (tnl->af == AF_INET && tiph->daddr) {
         struct route_entry *rt;
         struct flow4 fl4 = {
             .fl4_proto          = tiph->protocol,
@@ -132,7 +231,7 @@ static int tunnel_bind_dev(struct netif_port *dev)
             route4_put(rt);
         }
 
-        tunnel_clear_rt_cache(tnl);
+        tunnel_dst_invalidate(tnl);
     }
 
     if (!linkdev && tnl->link)
@@ -143,8 +242,8 @@ static int tunnel_bind_dev(struct netif_port *dev)
 
     mtu -= dev->hw_header_len + t_hlen;
 
-    if (mtu < IPV4_MIN_MTU)
-        mtu = IPV4_MIN_MTU;
+    if (mtu < min_mtu)
+        mtu = min_mtu;
 
     return mtu;
 }
@@ -184,6 +283,16 @@ static struct netif_port *tunnel_create(struct ip_tunnel_tab *tab,
     tnl->dev = dev;
     tnl->tab = tab;
     tnl->params = params;
+    tnl->af = ops->af;
+
+    tnl->dst_cache = rte_zmalloc("tunnel_dst",
+                                 sizeof(struct ip_tunnel_dst) * DPVS_MAX_LCORE,
+                                 RTE_CACHE_LINE_SIZE);
+    if (!tnl->dst_cache) {
+        netif_free(dev);
+        return NULL;
+    }
+
     if (strlen(params.link)) {
         tnl->link = netif_port_get_by_name(params.link);
         if (!tnl->link) {
@@ -207,6 +316,7 @@ static struct netif_port *tunnel_create(struct ip_tunnel_tab *tab,
 
     err = netif_port_register(dev);
     if (err != EDPVS_OK) {
+        tunnel_dst_flush(tnl);
         netif_free(dev);
         return NULL;
     }
@@ -215,8 +325,8 @@ static struct netif_port *tunnel_create(struct ip_tunnel_tab *tab,
     dev->mtu = tunnel_bind_dev(dev);
 
     /* insert to table */
-    hlist_add_head(&tnl->hlist, tunnel_hash_head(tab, params.i_key,
-                                                 params.iph.daddr));
+    hlist_add_head(&tnl->hlist, tunnel_hash_head(tab, params.i_key, tnl->af,
+                                                 tunnel_raddr(tnl)));
     tab->nb_tnl++;
 
     return dev;
@@ -237,12 +347,12 @@ static int tunnel_change(struct netif_port *dev,
         tnl->link = link;
     }
 
-    tunnel_clear_rt_cache(tnl);
+    tunnel_dst_invalidate(tnl);
 
     hlist_del(&tnl->hlist);
     tnl->params = *params; /* FIXME: all params changes ! */
     hlist_add_head(&tnl->hlist, tunnel_hash_head(tnl->tab, params->i_key,
-                                                 params->iph.daddr));
+                                                 tnl->af, tunnel_raddr(tnl)));
 
     dev->mtu = tunnel_bind_dev(dev);
 
@@ -264,6 +374,7 @@ static int tunnel_destroy(struct ip_tunnel_tab *tab, struct netif_port *dev)
         tab->fb_tunnel_dev = NULL;
 
     netif_port_unregister(dev);
+    tunnel_dst_flush(tnl);
     return netif_free(dev);
 }
 
@@ -321,28 +432,185 @@ static int tunnel_dump_table(struct ip_tunnel_tab *tab,
 
 /* linux:tnl_update_pmtu */
 static int tunnel_update_pmtu(struct netif_port *dev, struct rte_mbuf *mbuf,
-                              struct route_entry *rt, __be16 df,
-                              const struct iphdr *iiph)
+                              uint32_t rt_mtu, __be16 df)
 {
     struct ip_tunnel *tnl = netif_priv(dev);
     int pkt_size = mbuf->pkt_len - tnl->hlen - dev->hw_header_len;
-    int mtu;
+    int ohlen, mtu;
+
+    if (tnl->af == AF_INET6)
+        ohlen = sizeof(struct ip6_hdr);
+    else
+        ohlen = sizeof(struct iphdr);
 
     if (df)
-        mtu = rt->mtu - dev->hw_header_len - sizeof(struct iphdr) - tnl->hlen;
+        mtu = rt_mtu - dev->hw_header_len - ohlen - tnl->hlen;
     else
-        mtu = rt->mtu ? : dev->mtu;
+        mtu = rt_mtu ? : dev->mtu;
 
     if (mbuf->packet_type == ETHER_TYPE_IPv4) {
+        const struct iphdr *iiph;
+
+        iiph = rte_pktmbuf_mtod_offset(mbuf, struct iphdr *, tnl->hlen);
         if ((iiph->frag_off & htons(IP_DF)) && mtu < pkt_size) {
+            /* icmp quotes inner packet, not the tunnel header */
+            rte_pktmbuf_adj(mbuf, tnl->hlen);
             icmp_send(mbuf, ICMP_DEST_UNREACH, ICMP_FRAG_NEEDED, htonl(mtu));
             return EDPVS_FRAG;
         }
+    } else if (mbuf->packet_type == ETHER_TYPE_IPv6) {
+        if (mtu < IPV6_MIN_MTU)
+            mtu = IPV6_MIN_MTU;
+
+        if (mtu < pkt_size) {
+            rte_pktmbuf_adj(mbuf, tnl->hlen);
+            icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, mtu);
+            return EDPVS_FRAG;
+        }
     }
 
     return EDPVS_OK;
 }
 
+/*
+ * get dsfield, ttl and DF of inner IP packet for "inherit" params.
+ * return false if inner packet is neither IPv4 nor IPv6.
+ */
+static inline bool tunnel_inner_info(const struct rte_mbuf *mbuf, int hlen,
+                                     uint8_t *dsfield, uint8_t *ttl,
+                                     __be16 *df)
+{
+    if (mbuf->packet_type == ETHER_TYPE_IPv4) {
+        const struct iphdr *iiph;
+
+        iiph = rte_pktmbuf_mtod_offset(mbuf, struct iphdr *, hlen);
+        *dsfield = iiph->tos;
+        *ttl = iiph->ttl;
+        *df = iiph->frag_off & htons(IP_DF);
+        return true;
+    } else if (mbuf->packet_type == ETHER_TYPE_IPv6) {
+        const struct ip6_hdr *ii6h;
+
+        ii6h = rte_pktmbuf_mtod_offset(mbuf, struct ip6_hdr *, hlen);
+        *dsfield = ip6_tnl_tclass(ii6h->ip6_flow);
+        *ttl = ii6h->ip6_hlim;
+        *df = 0;
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * this lcore's route cache of connected IPv4 tunnel, looked up again and
+ * the outer header rebuilt if routes or the tunnel changed since cached.
+ */
+static struct ip_tunnel_dst *tunnel_dst_check(struct ip_tunnel *tnl,
+                                              const struct iphdr *tiph,
+                                              uint8_t proto)
+{
+    struct ip_tunnel_dst *idst = &tnl->dst_cache[rte_lcore_id()];
+    struct iphdr *oiph = &idst->tmpl.iph;
+    struct route_entry *rt;
+    uint32_t genid = tnl->genid;
+    struct flow4 fl4 = {};
+
+    if (likely(idst->rt4 && idst->rt_genid == this_route4_genid &&
+               idst->tnl_genid == genid))
+        return idst;
+
+    tunnel_dst_release(tnl, idst);
+
+    fl4.fl4_proto           = proto;
+    fl4.fl4_daddr.s_addr    = tiph->daddr;
+    fl4.fl4_saddr.s_addr    = tiph->saddr;
+    fl4.fl4_tos             = tiph->tos;
+    fl4.fl4_oif             = tnl->link;
+
+    rt = route4_output(&fl4);
+    if (!rt)
+        return NULL;
+
+    /* refer route in cache, put on release. */
+    idst->rt4       = rt;
+    idst->rt_genid  = this_route4_genid;
+    idst->tnl_genid = genid;
+    idst->mtu       = rt->mtu;
+
+    memset(oiph, 0, sizeof(*oiph));
+    oiph->version   = 4;
+    oiph->ihl       = sizeof(struct iphdr) >> 2;
+    oiph->frag_off  = tiph->frag_off;
+    oiph->protocol  = proto;
+    oiph->tos       = tiph->tos;
+    oiph->ttl       = tiph->ttl ? : INET_DEF_TTL;
+    oiph->daddr     = tiph->daddr;
+    oiph->saddr     = rt->src.s_addr;
+
+    if (!oiph->saddr)
+        RTE_LOG(WARNING, TUNNEL, "%s: xmit with no source IP\n", __func__);
+
+    return idst;
+}
+
+/* IPv6 version of tunnel_dst_check. */
+static struct ip_tunnel_dst *tunnel_dst_check6(struct ip_tunnel *tnl,
+                                               const struct ip6_hdr *tip6h,
+                                               uint8_t proto)
+{
+    struct ip_tunnel_dst *idst = &tnl->dst_cache[rte_lcore_id()];
+    struct ip6_hdr *oip6h = &idst->tmpl.ip6h;
+    struct route6 *rt;
+    uint32_t genid = tnl->genid;
+    struct flow6 fl6 = {};
+
+    if (likely(idst->rt6 && idst->rt_genid == this_route6_genid &&
+               idst->tnl_genid == genid))
+        return idst;
+
+    tunnel_dst_release(tnl, idst);
+
+    fl6.fl6_proto   = proto;
+    fl6.fl6_daddr   = tip6h->ip6_dst;
+    fl6.fl6_saddr   = tip6h->ip6_src;
+    fl6.fl6_oif     = tnl->link;
+
+    rt = route6_output(NULL, &fl6);
+    if (!rt)
+        return NULL;
+
+    idst->rt6       = rt;
+    idst->rt_genid  = this_route6_genid;
+    idst->tnl_genid = genid;
+    idst->mtu       = rt->rt6_mtu;
+
+    memset(oip6h, 0, sizeof(*oip6h));
+    oip6h->ip6_flow = htonl(0x60000000 |
+                            ((ip6_tnl_tclass(tip6h->ip6_flow) & ~0x1) << 20) |
+                            (ntohl(tip6h->ip6_flow) & 0xfffff));
+    oip6h->ip6_nxt  = proto;
+    oip6h->ip6_hlim = tip6h->ip6_hlim ? : INET_DEF_TTL;
+    oip6h->ip6_dst  = tip6h->ip6_dst;
+
+    if (!ipv6_addr_any(&tip6h->ip6_src)) {
+        oip6h->ip6_src = tip6h->ip6_src;
+    } else if (!ipv6_addr_any(&rt->rt6_prefsrc.addr)) {
+        oip6h->ip6_src = rt->rt6_prefsrc.addr;
+    } else {
+        union inet_addr saddr;
+
+        inet_addr_select(AF_INET6, rt->rt6_dev,
+                         (const union inet_addr *)&tip6h->ip6_dst,
+                         0, &saddr);
+        oip6h->ip6_src = saddr.in6;
+    }
+
+    if (ipv6_addr_any(&oip6h->ip6_src))
+        RTE_LOG(WARNING, TUNNEL, "%s: xmit with no source IP\n", __func__);
+
+    return idst;
+}
+
 static int tunnel_xmit(struct rte_mbuf *mbuf, __be32 src, __be32 dst,
                        uint8_t proto, uint8_t tos, uint8_t ttl, __be16 df)
 {
@@ -633,7 +901,7 @@ int ip_tunnel_init(void)
         goto so_fail;
 
     /*
-     * init all ipv4 tunnels.
+     * init all ipv4/ipv6 tunnels.
      */
 
     if ((err = ipip_init()) != EDPVS_OK)
@@ -642,8 +910,13 @@ int ip_tunnel_init(void)
     if ((err = gre_init()) != EDPVS_OK)
         goto gre_fail;
 
+    if ((err = ip6_tunnel_init()) != EDPVS_OK)
+        goto ip6_fail;
+
     return EDPVS_OK;
 
+ip6_fail:
+    gre_term();
 gre_fail:
     ipip_term();
 ipip_fail:
@@ -664,6 +937,10 @@ int ip_tunnel_term(void)
     if (err != EDPVS_OK)
         return err;
 
+    err = ip6_tunnel_term();
+    if (err != EDPVS_OK)
+        return err;
+
     err = sockopt_unregister(&ip_tunnel_sockopts);
     if (err != EDPVS_OK)
         return err;
@@ -672,19 +949,20 @@ int ip_tunnel_term(void)
 }
 
 /* linux:ip_tunnel_lookup */
-struct ip_tunnel *ip_tunnel_lookup(struct ip_tunnel_tab *tab,
-                                   portid_t link, __be16 flags,
-                                   __be32 remote, __be32 local,
-                                   __be32 key)
+static struct ip_tunnel *tunnel_lookup(struct ip_tunnel_tab *tab,
+                                       portid_t link, __be16 flags, int af,
+                                       const union inet_addr *remote,
+                                       const union inet_addr *local,
+                                       __be32 key)
 {
     struct hlist_head *head;
     struct ip_tunnel *tnl, *cand = NULL;
 
-    head = tunnel_hash_head(tab, key, remote);
+    head = tunnel_hash_head(tab, key, af, remote);
 
     hlist_for_each_entry(tnl, head, hlist) {
-        if (local != tnl->params.iph.saddr ||
-            remote != tnl->params.iph.daddr ||
+        if (!tunnel_addr_equal(af, local, tunnel_laddr(tnl)) ||
+            !tunnel_addr_equal(af, remote, tunnel_raddr(tnl)) ||
             !(tnl->dev->flag & NETIF_PORT_FLAG_RUNNING))
             continue;
 
@@ -698,8 +976,8 @@ struct ip_tunnel *ip_tunnel_lookup(struct ip_tunnel_tab *tab,
     }
 
     hlist_for_each_entry(tnl, head, hlist) {
-        if (remote != tnl->params.iph.daddr ||
-            tnl->params.iph.saddr != 0 ||
+        if (!tunnel_addr_equal(af, remote, tunnel_raddr(tnl)) ||
+            !tunnel_addr_is_any(af, tunnel_laddr(tnl)) ||
             !(tnl->dev->flag & NETIF_PORT_FLAG_RUNNING))
             continue;
 
@@ -712,11 +990,13 @@ struct ip_tunnel *ip_tunnel_lookup(struct ip_tunnel_tab *tab,
             cand = tnl;
     }
 
-    head = tunnel_hash_head(tab, key, 0);
+    head = tunnel_hash_head(tab, key, af, &tunnel_addr_any);
 
     hlist_for_each_entry(tnl, head, hlist) {
-        if ((local != tnl->params.iph.saddr || tnl->params.iph.daddr != 0) &&
-            (local != tnl->params.iph.daddr || !IN_MULTICAST(local)))
+        if ((!tunnel_addr_equal(af, local, tunnel_laddr(tnl)) ||
+             !tunnel_addr_is_any(af, tunnel_raddr(tnl))) &&
+            (!tunnel_addr_equal(af, local, tunnel_raddr(tnl)) ||
+             !tunnel_addr_multicast(af, local)))
             continue;
 
         if (!(tnl->dev->flag & NETIF_PORT_FLAG_RUNNING))
@@ -736,8 +1016,8 @@ struct ip_tunnel *ip_tunnel_lookup(struct ip_tunnel_tab *tab,
 
     hlist_for_each_entry(tnl, head, hlist) {
         if (tnl->params.i_key != key ||
-            tnl->params.iph.saddr != 0 ||
-            tnl->params.iph.daddr != 0 ||
+            !tunnel_addr_is_any(af, tunnel_laddr(tnl)) ||
+            !tunnel_addr_is_any(af, tunnel_raddr(tnl)) ||
             !(tnl->dev->flag & NETIF_PORT_FLAG_RUNNING))
             continue;
 
@@ -758,6 +1038,28 @@ skip_key_lookup:
     return NULL;
 }
 
+struct ip_tunnel *ip_tunnel_lookup(struct ip_tunnel_tab *tab,
+                                   portid_t link, __be16 flags,
+                                   __be32 remote, __be32 local,
+                                   __be32 key)
+{
+    union inet_addr raddr = { .in.s_addr = remote };
+    union inet_addr laddr = { .in.s_addr = local };
+
+    return tunnel_lookup(tab, link, flags, AF_INET, &raddr, &laddr, key);
+}
+
+struct ip_tunnel *ip6_tunnel_lookup(struct ip_tunnel_tab *tab,
+                                    portid_t link, __be16 flags,
+                                    const struct in6_addr *remote,
+                                    const struct in6_addr *local,
+                                    __be32 key)
+{
+    return tunnel_lookup(tab, link, flags, AF_INET6,
+                         (const union inet_addr *)remote,
+                         (const union inet_addr *)local, key);
+}
+
 /* linux:ip_tunnel_rcv */
 int ip_tunnel_rcv(struct ip_tunnel *tnl, struct ip_tunnel_pktinfo *tpi,
                   struct rte_mbuf *mbuf)
@@ -780,7 +1082,7 @@ int ip_tunnel_rcv(struct ip_tunnel *tnl, struct ip_tunnel_pktinfo *tpi,
 
     mbuf->port = tnl->dev->id;
 
-    return netif_rcv(tnl->dev, htons(ETH_P_IP), mbuf);
+    return netif_rcv(tnl->dev, tpi->proto, mbuf);
 
 drop:
     rte_pktmbuf_free(mbuf);
@@ -792,19 +1094,19 @@ int ip_tunnel_xmit(struct rte_mbuf *mbuf, struct netif_port *dev,
                    const struct iphdr *tiph, uint8_t proto)
 {
     struct ip_tunnel    *tnl = netif_priv(dev);
-    const struct iphdr  *iiph = NULL; /* inner ip header*/
+    struct ip_tunnel_dst *idst = NULL;
     struct route_entry  *rt;
     struct flow4        fl4 = {};
+    struct iphdr        *oiph;
     int                 err = EDPVS_DROP;
-    uint8_t             tos, ttl;
-    bool                connected;
-    __be16              df;
+    uint8_t             tos, ttl, itos = 0, ittl = 0;
+    bool                connected, inner_ip;
+    __be16              df, idf = 0;
     __be32              dip;
 
     assert(mbuf && dev && tiph);
 
-    if (mbuf->packet_type == ETHER_TYPE_IPv4)
-        iiph = rte_pktmbuf_mtod_offset(mbuf, struct iphdr *, tnl->hlen);
+    inner_ip = tunnel_inner_info(mbuf, tnl->hlen, &itos, &ittl, &idf);
 
     connected = tiph->daddr != 0;
 
@@ -819,15 +1121,21 @@ int ip_tunnel_xmit(struct rte_mbuf *mbuf, struct netif_port *dev,
     tos = tiph->tos;
     if (tos & 0x1) {
         tos &= ~0x1;
-        if (iiph)
-            tos = iiph->tos;
+        if (inner_ip)
+            tos = itos;
         connected = false;
     }
 
-    /* try cache first then route lookup */
-    rt = connected ? tnl->rt_cache : NULL;
-    if (!rt) {
-        /* not connected or no route cache */
+    if (likely(connected)) {
+        /* per-lcore cache, no shared cache line touched */
+        idst = tunnel_dst_check(tnl, tiph, proto);
+        if (unlikely(!idst)) {
+            err = EDPVS_NOROUTE;
+            goto errout;
+        }
+        rt = idst->rt4;
+        route4_get(rt);
+    } else {
         fl4.fl4_proto           = proto;
         fl4.fl4_daddr.s_addr    = dip;
         fl4.fl4_saddr.s_addr    = tiph->saddr;
@@ -839,39 +1147,123 @@ int ip_tunnel_xmit(struct rte_mbuf *mbuf, struct netif_port *dev,
             err = EDPVS_NOROUTE;
             goto errout;
         }
-
-        tunnel_clear_rt_cache(tnl);
-        tnl->rt_cache = rt;
-        /* refer route in tunnel do not put it. */
     }
 
     if (rt->port == dev)
-        goto errout;
+        goto errout_put;
 
     /* refer route in mbuf and this reference will be put later. */
-    route4_get(rt);
     mbuf->userdata = (void *)rt;
 
-    err = tunnel_update_pmtu(dev, mbuf, rt, tiph->frag_off, iiph);
+    err = tunnel_update_pmtu(dev, mbuf, rt->mtu, tiph->frag_off);
     if (err != EDPVS_OK)
-        goto errout;
+        goto errout_put;
 
     ttl = tiph->ttl;
     if (!ttl) {
-        if (iiph)
-            ttl = iiph->ttl;
+        if (inner_ip)
+            ttl = ittl;
         else
             ttl = INET_DEF_TTL;
     }
 
-    df = tiph->frag_off;
-    if (iiph)
-        df |= (iiph->frag_off & htons(IP_DF));
+    df = tiph->frag_off | idf;
 
-    if (!rt->src.s_addr)
-        RTE_LOG(WARNING, TUNNEL, "%s: xmit with no source IP\n", __func__);
+    if (unlikely(!idst)) {
+        if (!rt->src.s_addr)
+            RTE_LOG(WARNING, TUNNEL, "%s: xmit with no source IP\n", __func__);
+
+        return tunnel_xmit(mbuf, rt->src.s_addr, dip, proto, tos, ttl, df);
+    }
+
+    /* connected: copy prebuilt header, then the per-packet fields */
+    oiph = (struct iphdr *)rte_pktmbuf_prepend(mbuf, sizeof(*oiph));
+    if (unlikely(!oiph)) {
+        err = EDPVS_NOROOM;
+        goto errout_put;
+    }
+
+    rte_memcpy(oiph, &idst->tmpl.iph, sizeof(*oiph));
+    oiph->ttl       = ttl;
+    oiph->frag_off  = df;
+    oiph->id        = ip4_select_id((struct ipv4_hdr *)oiph);
+
+    return ipv4_local_out(mbuf);
+
+errout_put:
+    route4_put(rt);
+errout:
+    rte_pktmbuf_free(mbuf);
+    return err;
+}
+
+/* linux: ip6_tnl_xmit */
+int ip6_tunnel_xmit(struct rte_mbuf *mbuf, struct netif_port *dev,
+                    const struct ip6_hdr *tip6h, uint8_t proto)
+{
+    struct ip_tunnel    *tnl = netif_priv(dev);
+    struct ip_tunnel_dst *idst;
+    struct route6       *rt;
+    struct ip6_hdr      *oip6h;
+    int                 err = EDPVS_DROP;
+    uint8_t             tclass, itclass = 0, ihlim = 0;
+    __be16              idf = 0;
+    bool                inner_ip;
+
+    assert(mbuf && dev && tip6h);
+
+    if (unlikely(ipv6_addr_any(&tip6h->ip6_dst))) {
+        /* TODO: NBMA tunnel */
+        RTE_LOG(DEBUG, TUNNEL, "%s: NBMA dev not support\n", __func__);
+        err = EDPVS_NOTSUPP;
+        goto errout;
+    }
+
+    inner_ip = tunnel_inner_info(mbuf, tnl->hlen, &itclass, &ihlim, &idf);
+
+    /* route6 ignores tclass, the cache serves "inherit" as well */
+    idst = tunnel_dst_check6(tnl, tip6h, proto);
+    if (unlikely(!idst)) {
+        err = EDPVS_NOROUTE;
+        goto errout;
+    }
+    rt = idst->rt6;
+
+    if (unlikely(rt->rt6_dev == dev))
+        goto errout;
+
+    /* outer IPv6 is never fragmented on path, always use path MTU. */
+    err = tunnel_update_pmtu(dev, mbuf, idst->mtu, htons(IP_DF));
+    if (err != EDPVS_OK)
+        goto errout;
+
+    if (unlikely(mbuf->pkt_len > IPV6_MAXPLEN)) {
+        err = EDPVS_NOROOM;
+        goto errout;
+    }
+
+    oip6h = (struct ip6_hdr *)rte_pktmbuf_prepend(mbuf, sizeof(*oip6h));
+    if (unlikely(!oip6h)) {
+        err = EDPVS_NOROOM;
+        goto errout;
+    }
+
+    rte_memcpy(oip6h, &idst->tmpl.ip6h, sizeof(*oip6h));
+    oip6h->ip6_plen = htons(mbuf->pkt_len - sizeof(*oip6h));
+
+    tclass = ip6_tnl_tclass(tip6h->ip6_flow);
+    if ((tclass & 0x1) && inner_ip)
+        oip6h->ip6_flow = (oip6h->ip6_flow & htonl(0xf00fffff)) |
+                          htonl((uint32_t)itclass << 20);
+
+    if (!tip6h->ip6_hlim && inner_ip)
+        oip6h->ip6_hlim = ihlim;
+
+    /* refer route in mbuf and this reference will be put later. */
+    route6_get(rt);
+    mbuf->userdata = (void *)rt;
 
-    return tunnel_xmit(mbuf, rt->src.s_addr, dip, proto, tos, ttl, df);
+    return ip6_local_out(mbuf);
 
 errout:
     rte_pktmbuf_free(mbuf);
@@ -96,6 +96,7 @@ drop:
 
 static struct ip_tunnel_ops ipip_tunnel_ops = {
     .kind       = "ipip",
+    .af         = AF_INET,
     .priv_size  = sizeof(struct ip_tunnel),
     .setup      = ipip_setup,
 };
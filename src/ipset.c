@@ -66,7 +66,8 @@ static struct ipset_entry *ipset_new_entry(int af, union inet_addr *dest)
     struct ipset_entry *new_ipset=NULL;
     if(!dest)
         return NULL;
-    new_ipset = rte_zmalloc("new_ipset_entry", sizeof(struct ipset_entry), 0);
+    new_ipset = rte_zmalloc_socket("new_ipset_entry", sizeof(struct ipset_entry),
+                                   0, rte_socket_id());
     if (new_ipset == NULL){
         return NULL;
     }
@@ -26,6 +26,7 @@
 #include "neigh.h"
 #include "icmp.h"
 #include "parser/parser.h"
+#include "bench.h"
 
 #define IPV4
 #define RTE_LOGTYPE_IPV4    RTE_LOGTYPE_USER1
@@ -440,9 +441,26 @@ drop:
     return EDPVS_INVPKT;
 }
 
+#ifdef CONFIG_DPVS_BENCH
+static int ipv4_rcv_bench(struct rte_mbuf *mbuf, struct netif_port *port)
+{
+    int err;
+
+    DPVS_BENCH_START(tsc);
+    err = ipv4_rcv(mbuf, port);
+    DPVS_BENCH_END(DPVS_BENCH_IPV4, tsc, 1);
+
+    return err;
+}
+#endif
+
 static struct pkt_type ip4_pkt_type = {
     //.type       = rte_cpu_to_be_16(ETHER_TYPE_IPv4),
+#ifdef CONFIG_DPVS_BENCH
+    .func       = ipv4_rcv_bench,
+#else
     .func       = ipv4_rcv,
+#endif
     .port       = NULL,
 };
 
@@ -19,6 +19,7 @@
  * fragment and reassemble of IPv4 packet.
  */
 #include <assert.h>
+#include <stddef.h>
 #include "dpdk.h"
 #include "netif.h"
 #include "ipv4.h"
@@ -255,6 +256,40 @@ int ipv4_reassamble(struct rte_mbuf *mbuf)
 }
 
 /* this function consumes mbuf also free route. */
+/* fragments are not offloaded, finish pending L4 checksum first */
+static int ip4_frag_finish_csum(struct rte_mbuf *mbuf)
+{
+    uint64_t l4_flag = mbuf->ol_flags & PKT_TX_L4_MASK;
+    uint16_t *csum, sum;
+    uint32_t off;
+
+    if (likely(!l4_flag))
+        return EDPVS_OK;
+
+    /* pseudo header sum is seeded in checksum field already */
+    if (l4_flag == PKT_TX_TCP_CKSUM)
+        off = mbuf->l3_len + offsetof(struct tcp_hdr, cksum);
+    else if (l4_flag == PKT_TX_UDP_CKSUM)
+        off = mbuf->l3_len + offsetof(struct udp_hdr, dgram_cksum);
+    else
+        return EDPVS_NOTSUPP;
+
+    if (unlikely(mbuf_may_pull(mbuf, off + sizeof(*csum)) != 0))
+        return EDPVS_INVPKT;
+
+    if (rte_raw_cksum_mbuf(mbuf, mbuf->l3_len,
+                           mbuf->pkt_len - mbuf->l3_len, &sum) != 0)
+        return EDPVS_INVPKT;
+
+    csum = rte_pktmbuf_mtod_offset(mbuf, uint16_t *, off);
+    *csum = (uint16_t)~sum;
+    if (l4_flag == PKT_TX_UDP_CKSUM && *csum == 0)
+        *csum = 0xffff;
+
+    mbuf->ol_flags &= ~PKT_TX_L4_MASK;
+    return EDPVS_OK;
+}
+
 int ipv4_fragment(struct rte_mbuf *mbuf, unsigned int mtu,
           int (*output)(struct rte_mbuf *))
 {
@@ -273,6 +308,10 @@ int ipv4_fragment(struct rte_mbuf *mbuf, unsigned int mtu,
         goto out;
     }
 
+    err = ip4_frag_finish_csum(mbuf);
+    if (err != EDPVS_OK)
+        goto out;
+
     hlen = ip4_hdrlen(mbuf);
     mtu -= hlen; /* IP payload space */
     left = mbuf->pkt_len - hlen;
@@ -300,7 +339,9 @@ int ipv4_fragment(struct rte_mbuf *mbuf, unsigned int mtu,
         route4_get(rt);
         frag->userdata = rt; /* no need to hold before consume mbuf */
         frag->port = mbuf->port;
-        frag->ol_flags = 0; /* do not offload csum for frag */
+        /* do not offload csum for frag, keep flow hash for tx queue */
+        frag->ol_flags = mbuf->ol_flags & PKT_RX_RSS_HASH;
+        frag->hash.rss = mbuf->hash.rss;
         frag->l2_len = mbuf->l2_len;
         frag->l3_len = mbuf->l3_len;
 
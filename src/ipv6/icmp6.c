@@ -2,6 +2,7 @@
 #include <assert.h>
 #include "ipv6.h"
 #include "common.h"
+#include "icmp.h"
 #include "icmp6.h"
 #include "ndisc.h"
 
@@ -182,6 +183,12 @@ void icmp6_send(struct rte_mbuf *imbuf, int type, int code, uint32_t info)
         return;
     }
 
+    if (!icmp_ratelimit_allow(AF_INET6,
+                              (union inet_addr *)&iph->ip6_src, type)) {
+        RTE_LOG(DEBUG, ICMP6, "icmpv6_send: rate limited\n");
+        return;
+    }
+
     memset(&shdr, 0, sizeof(struct ip6_hdr));
     memset(&fl6, 0, sizeof(fl6));
     shdr.ip6_nxt = IPPROTO_ICMPV6;
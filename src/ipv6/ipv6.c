@@ -30,11 +30,14 @@
 #include "common.h"
 #include "mbuf.h"
 #include "inet.h"
+#include "inetaddr.h"
 #include "ipv6.h"
+#include "ipv6_frag.h"
 #include "route6.h"
 #include "parser/parser.h"
 #include "neigh.h"
 #include "icmp6.h"
+#include "bench.h"
 
 /*
  * IPv6 inet hooks
@@ -51,29 +54,7 @@ static bool conf_ipv6_disable = false;
 /*
  * IPv6 statistics
  */
-static RTE_DEFINE_PER_LCORE(struct inet_stats, ip6_stats);
-#define this_ip6_stats  RTE_PER_LCORE(ip6_stats)
-
-#define IP6_INC_STATS(__f__) \
-    do { \
-        this_ip6_stats.__f__++; \
-    } while (0)
-
-#define IP6_DEC_STATS(__f__) \
-    do { \
-        this_ip6_stats.__f__--; \
-    } while (0)
-
-#define IP6_ADD_STATS(__f__, val) \
-    do { \
-        this_ip6_stats.__f__ += (val); \
-    } while (0)
-
-#define IP6_UPD_PO_STATS(__f__, val) \
-    do { \
-        this_ip6_stats.__f__##pkts ++; \
-        this_ip6_stats.__f__##octets += (val); \
-    } while (0)
+RTE_DEFINE_PER_LCORE(struct inet_stats, ip6_stats);
 
 #ifdef CONFIG_DPVS_IP_HEADER_DEBUG
 static inline void ip6_show_hdr(const char *func, struct rte_mbuf *mbuf)
@@ -288,19 +269,6 @@ static inline unsigned int ip6_mtu_forward(struct route6 *rt)
         return IPV6_MIN_MTU;
 }
 
-static int ip6_fragment(struct rte_mbuf *mbuf, uint32_t mtu,
-                        int (*out)(struct rte_mbuf *))
-{
-    struct route6 *rt = mbuf->userdata;
-
-    /* TODO: */
-
-    IP6_INC_STATS(fragfails);
-    route6_put(rt);
-    rte_pktmbuf_free(mbuf);
-    return EDPVS_FRAG;
-}
-
 static int ip6_output_fin2(struct rte_mbuf *mbuf)
 {
     struct ip6_hdr *hdr = ip6_hdr(mbuf);
@@ -348,7 +316,7 @@ static int ip6_output_fin(struct rte_mbuf *mbuf)
         mtu = ((struct route6 *)mbuf->userdata)->rt6_mtu;
 
     if (mbuf->pkt_len > mtu)
-        return ip6_fragment(mbuf, mtu, ip6_output_fin2);
+        return ipv6_fragment(mbuf, mtu, ip6_output_fin2);
     else
         return ip6_output_fin2(mbuf);
 }
@@ -524,11 +492,34 @@ kni:
     return EDPVS_KNICONTINUE;
 }
 
+static int ip6_defrag(struct rte_mbuf **mbuf)
+{
+    int err;
+
+    IP6_INC_STATS(reasmreqds);
+
+    err = ipv6_reassemble(mbuf);
+    switch (err) {
+    case EDPVS_INPROGRESS: /* collecting fragments */
+        break;
+    case EDPVS_OK:
+        IP6_INC_STATS(reasmoks);
+        break;
+    default: /* error happened */
+        rte_pktmbuf_free(*mbuf);
+        IP6_INC_STATS(reasmfails);
+        break;
+    }
+
+    return err;
+}
+
 static int ip6_rcv(struct rte_mbuf *mbuf, struct netif_port *dev)
 {
     const struct ip6_hdr *hdr;
     uint32_t pkt_len, tot_len;
     eth_type_t etype = mbuf->packet_type;
+    int err;
 
     if (unlikely(etype == ETH_PKT_OTHERHOST || !dev)) {
         rte_pktmbuf_free(mbuf);
@@ -618,6 +609,18 @@ static int ip6_rcv(struct rte_mbuf *mbuf, struct netif_port *dev)
             goto err;
     }
 
+    /*
+     * reassemble datagrams to local addresses (VIPs included) before any
+     * hook, so that IPVS sees whole datagrams. forwarded ones are left as
+     * they are, routers never reassemble.
+     */
+    if (unlikely(hdr->ip6_nxt == NEXTHDR_FRAGMENT) && ipv6_reasm_on &&
+        inet_addr_get_iface(AF_INET6, (union inet_addr *)&hdr->ip6_dst)) {
+        if ((err = ip6_defrag(&mbuf)) != EDPVS_OK)
+            return err;
+        hdr = ip6_hdr(mbuf);
+    }
+
 #ifdef CONFIG_DPVS_IP_HEADER_DEBUG
     ip6_show_hdr(__func__, mbuf);
 #endif
@@ -632,9 +635,26 @@ drop:
     return EDPVS_DROP;
 }
 
+#ifdef CONFIG_DPVS_BENCH
+static int ip6_rcv_bench(struct rte_mbuf *mbuf, struct netif_port *port)
+{
+    int err;
+
+    DPVS_BENCH_START(tsc);
+    err = ip6_rcv(mbuf, port);
+    DPVS_BENCH_END(DPVS_BENCH_IPV6, tsc, 1);
+
+    return err;
+}
+#endif
+
 static struct pkt_type ip6_pkt_type = {
     /*.type    =  */
+#ifdef CONFIG_DPVS_BENCH
+    .func   = ip6_rcv_bench,
+#else
     .func   = ip6_rcv,
+#endif
     .port   = NULL,
 };
 
@@ -658,16 +678,22 @@ int ipv6_init(void)
     if (err)
         goto reg_pkt_err;
 
+    err = ipv6_frag_init();
+    if (err)
+        goto frag_err;
+
     err = ipv6_ctrl_init();
     if (err)
         goto ctrl_err;
 
     return EDPVS_OK;
 
-reg_pkt_err:
-    ipv6_exthdrs_term();
 ctrl_err:
+    ipv6_frag_term();
+frag_err:
     netif_unregister_pkt(&ip6_pkt_type);
+reg_pkt_err:
+    ipv6_exthdrs_term();
 
     return err;
 }
@@ -680,6 +706,10 @@ int ipv6_term(void)
     if (err)
         return err;
 
+    err = ipv6_frag_term();
+    if (err)
+        return err;
+
     err = netif_unregister_pkt(&ip6_pkt_type);
     if (err)
         return err;
@@ -816,6 +846,7 @@ void ipv6_keyword_value_init(void)
     conf_ipv6_disable = false;
 
     route6_keyword_value_init();
+    ip6_frag_keyword_value_init();
 }
 
 void install_ipv6_keywords(void)
@@ -825,6 +856,7 @@ void install_ipv6_keywords(void)
     install_keyword("disable", ip6_conf_disable, KW_TYPE_NORMAL);
 
     install_route6_keywords();
+    install_ip6_frag_keywords();
 }
 
 /*
@@ -25,6 +25,7 @@
 #include "dpdk.h"
 #include "inet.h"
 #include "ipv6.h"
+#include "ipv6_frag.h"
 #include "conf/ipv6.h"
 #include "ctrl.h"
 
@@ -50,11 +51,79 @@ static int ip6_msg_get_stats(struct dpvs_msg *msg)
     return EDPVS_OK;
 }
 
+static int ip6_msg_get_frag_stats(struct dpvs_msg *msg)
+{
+    int err;
+    struct ip6_frag_stats *stats;
+    assert(msg);
+
+    stats = msg_reply_alloc(sizeof(*stats));
+    if (!stats)
+        return EDPVS_NOMEM;
+
+    err = ipv6_frag_stats_cpu(stats);
+    if (err != EDPVS_OK) {
+        rte_free(stats);
+        return err;
+    }
+
+    msg->reply.len = sizeof(*stats);
+    msg->reply.data = stats;
+
+    return EDPVS_OK;
+}
+
 static int ip6_sockopt_set(sockoptid_t opt, const void *in, size_t inlen)
 {
     return EDPVS_NOTSUPP;
 }
 
+static int ip6_frag_sockopt_get(void **out, size_t *outsize)
+{
+    struct ip6_frag_param *param;
+    struct dpvs_msg *req, *reply;
+    struct dpvs_multicast_queue *replies = NULL;
+    int err;
+
+    req = msg_make(MSG_TYPE_IPV6_FRAG_STATS, 0, DPVS_MSG_MULTICAST,
+                   rte_lcore_id(), 0, NULL);
+    if (!req)
+        return EDPVS_NOMEM;
+
+    param = rte_zmalloc(NULL, sizeof(struct ip6_frag_param), 0);
+    if (!param) {
+        msg_destroy(&req);
+        return EDPVS_NOMEM;
+    }
+    ipv6_frag_conf_get(param);
+
+    err = multicast_msg_send(req, 0, &replies);
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IPV6, "%s: send msg: %s\n", __func__, dpvs_strerror(err));
+        msg_destroy(&req);
+        rte_free(param);
+        return err;
+    }
+
+    list_for_each_entry(reply, &replies->mq, mq_node) {
+        struct ip6_frag_stats *stats = (struct ip6_frag_stats *)reply->data;
+
+        param->stats.use_entries += stats->use_entries;
+        param->stats.add_num += stats->add_num;
+        param->stats.del_num += stats->del_num;
+        param->stats.reuse_num += stats->reuse_num;
+        param->stats.fail_total += stats->fail_total;
+        param->stats.fail_nospace += stats->fail_nospace;
+        param->stats_cpus[reply->cid] = *stats;
+    }
+
+    *out = param;
+    *outsize = sizeof(*param);
+
+    msg_destroy(&req);
+    return EDPVS_OK;
+}
+
 static int ip6_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
                            void **out, size_t *outsize)
 {
@@ -63,12 +132,15 @@ static int ip6_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
     struct dpvs_multicast_queue *replies = NULL;
     int err;
 
-    if (opt != SOCKOPT_IP6_STATS)
-        return EDPVS_NOTSUPP;
-
     if (!out || !outsize)
         return EDPVS_INVAL;
 
+    if (opt == SOCKOPT_IP6_FRAG)
+        return ip6_frag_sockopt_get(out, outsize);
+
+    if (opt != SOCKOPT_IP6_STATS)
+        return EDPVS_NOTSUPP;
+
     /* ask each worker lcore for stats by msg */
     req = msg_make(MSG_TYPE_IPV6_STATS, 0, DPVS_MSG_MULTICAST,
                    rte_lcore_id(), 0, NULL);
@@ -111,6 +183,12 @@ static struct dpvs_msg_type ip6_stats_msg = {
     .unicast_msg_cb = ip6_msg_get_stats,
 };
 
+static struct dpvs_msg_type ip6_frag_stats_msg = {
+    .type           = MSG_TYPE_IPV6_FRAG_STATS,
+    .prio           = MSG_PRIO_LOW,
+    .unicast_msg_cb = ip6_msg_get_frag_stats,
+};
+
 static struct dpvs_sockopts ip6_sockopts = {
     .version        = SOCKOPT_VERSION,
     .set_opt_min    = SOCKOPT_IP6_SET,
@@ -118,7 +196,7 @@ static struct dpvs_sockopts ip6_sockopts = {
     .set            = ip6_sockopt_set,
 
     .get_opt_min    = SOCKOPT_IP6_STATS,
-    .get_opt_max    = SOCKOPT_IP6_STATS,
+    .get_opt_max    = SOCKOPT_IP6_FRAG,
     .get            = ip6_sockopt_get,
 };
 
@@ -137,6 +215,14 @@ int ipv6_ctrl_init(void)
         return err;
     }
 
+    err = msg_type_mc_register(&ip6_frag_stats_msg);
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IPV6, "%s: fail to register msg\n", __func__);
+        msg_type_mc_unregister(&ip6_stats_msg);
+        sockopt_unregister(&ip6_sockopts);
+        return err;
+    }
+
     return EDPVS_OK;
 }
 
@@ -144,6 +230,10 @@ int ipv6_ctrl_term(void)
 {
     int err;
 
+    err = msg_type_mc_unregister(&ip6_frag_stats_msg);
+    if (err != EDPVS_OK)
+        RTE_LOG(WARNING, IPV6, "%s: fail to unregister msg\n", __func__);
+
     err = msg_type_mc_unregister(&ip6_stats_msg);
     if (err != EDPVS_OK)
         RTE_LOG(WARNING, IPV6, "%s: fail to unregister msg\n", __func__);
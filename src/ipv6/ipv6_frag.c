@@ -0,0 +1,599 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * fragment and reassemble of IPv6 packet.
+ */
+#include <assert.h>
+#include <netinet/ip6.h>
+#include "dpdk.h"
+#include "common.h"
+#include "netif.h"
+#include "inet.h"
+#include "ipv6.h"
+#include "ipv6_frag.h"
+#include "route6.h"
+#include "parser/parser.h"
+#include "ipvs/conn.h"
+
+#define IP6FRAG
+#define RTE_LOGTYPE_IP6FRAG RTE_LOGTYPE_USER1
+
+#define IP6FRAG_PREFETCH_OFFSET        3
+
+struct ipv6_frag {
+    struct rte_ip_frag_tbl          *reasm_tbl;
+    struct rte_ip_frag_death_row    death_tbl; /* frags to be free */
+    uint32_t                        ident;
+};
+
+/* parameters */
+#define IP6_FRAG_BUCKETS_DEF        4096
+#define IP6_FRAG_BUCKETS_MIN        32
+#define IP6_FRAG_BUCKETS_MAX        65536
+
+#define IP6_FRAG_BUCKET_ENTRIES_DEF 16
+#define IP6_FRAG_BUCKET_ENTRIES_MIN 1
+#define IP6_FRAG_BUCKET_ENTRIES_MAX 256
+
+#define IP6_FRAG_TTL_DEF            1
+
+/*
+ * indirect mbufs referring payload of the original packet, they have
+ * no data room. one per fragment, or more if payload is segmented.
+ */
+#define IP6_FRAG_INDIRECT_POOL_SIZE     16383
+#define IP6_FRAG_INDIRECT_CACHE_SIZE    256
+
+static uint32_t ip6_frag_buckets = IP6_FRAG_BUCKETS_DEF;
+static uint32_t ip6_frag_bucket_entries = IP6_FRAG_BUCKET_ENTRIES_DEF;
+static uint32_t ip6_frag_max_entries = IP6_FRAG_BUCKETS_DEF;
+static uint32_t ip6_frag_ttl = IP6_FRAG_TTL_DEF; /* seconds */
+
+/* reassembled datagrams reach their flow's lcore by conn redirect only */
+bool ipv6_reasm_on = false;
+
+static struct rte_mempool *ip6_frag_indirect_pool[DPVS_MAX_SOCKET];
+
+static void frag_bucket_number_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    uint32_t frag_buckets;
+
+    assert(str);
+    frag_buckets = atoi(str);
+    if (frag_buckets >= IP6_FRAG_BUCKETS_MIN && frag_buckets <= IP6_FRAG_BUCKETS_MAX) {
+        RTE_LOG(INFO, IP6FRAG, "ip6_frag_buckets = %d\n", frag_buckets);
+        ip6_frag_buckets = frag_buckets;
+    } else {
+        RTE_LOG(WARNING, IP6FRAG, "invalid ip6_frag_buckets config %s, using default "
+                "%d\n", str, IP6_FRAG_BUCKETS_DEF);
+        ip6_frag_buckets = IP6_FRAG_BUCKETS_DEF;
+    }
+
+    FREE_PTR(str);
+}
+
+static void frag_bucket_entries_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int bucket_entries;
+
+    assert(str);
+    bucket_entries = atoi(str);
+    if (bucket_entries >= IP6_FRAG_BUCKET_ENTRIES_MIN &&
+            bucket_entries <= IP6_FRAG_BUCKET_ENTRIES_MAX) {
+        is_power2(bucket_entries, 0, &bucket_entries);
+        RTE_LOG(INFO, IP6FRAG, "ip6_frag_bucket_entries = %d (round to 2^n)\n",
+                bucket_entries);
+        ip6_frag_bucket_entries = bucket_entries;
+    } else {
+        RTE_LOG(WARNING, IP6FRAG, "invalid ip6_frag_bucket_entries config %s, using "
+                "default %d\n", str, IP6_FRAG_BUCKET_ENTRIES_DEF);
+        ip6_frag_bucket_entries = IP6_FRAG_BUCKET_ENTRIES_DEF;
+    }
+
+    FREE_PTR(str);
+}
+
+static void frag_max_entries_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    uint32_t max_entries;
+
+    assert(str);
+    if ((max_entries = atoi(str)) > 0) {
+        RTE_LOG(INFO, IP6FRAG, "ip6_frag_max_entries = %d\n", max_entries);
+        ip6_frag_max_entries = max_entries;
+    } else {
+        RTE_LOG(WARNING, IP6FRAG, "invalid ip6_frag_max_entries config %s, using "
+                "default %d\n", str, IP6_FRAG_BUCKETS_DEF);
+        ip6_frag_max_entries = IP6_FRAG_BUCKETS_DEF;
+    }
+
+    FREE_PTR(str);
+}
+
+static void frag_ttl_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    uint32_t ttl;
+
+    assert(str);
+    ttl = atoi(str);
+    if (ttl > 0 && ttl < 256) {
+        RTE_LOG(INFO, IP6FRAG, "ip6_frag_ttl = %d\n", ttl);
+        ip6_frag_ttl = ttl;
+    } else {
+        RTE_LOG(WARNING, IP6FRAG, "invalid ip6_frag_ttl %s, using default %d\n",
+                str, IP6_FRAG_TTL_DEF);
+        ip6_frag_ttl = IP6_FRAG_TTL_DEF;
+    }
+
+    FREE_PTR(str);
+}
+
+void ip6_frag_keyword_value_init(void)
+{
+    if (dpvs_state_get() == DPVS_STATE_INIT) {
+        /* KW_TYPE_INIT keyword */
+        ip6_frag_buckets = IP6_FRAG_BUCKETS_DEF;
+        ip6_frag_bucket_entries = IP6_FRAG_BUCKET_ENTRIES_DEF;
+        ip6_frag_max_entries = IP6_FRAG_BUCKETS_DEF;
+        ip6_frag_ttl = IP6_FRAG_TTL_DEF;
+    }
+    /* KW_TYPE_NORMAL keyword */
+}
+
+void install_ip6_frag_keywords(void)
+{
+    install_keyword("fragment", NULL, KW_TYPE_INIT);
+    install_sublevel();
+    install_keyword("bucket_number", frag_bucket_number_handler, KW_TYPE_INIT);
+    install_keyword("bucket_entries", frag_bucket_entries_handler, KW_TYPE_INIT);
+    install_keyword("max_entries", frag_max_entries_handler, KW_TYPE_INIT);
+    install_keyword("ttl", frag_ttl_handler, KW_TYPE_INIT);
+    install_sublevel_end();
+}
+
+/*
+ * per-lcore reassamble table, see ipv4_frag.c.
+ *
+ * the whole datagram is reassembled on the lcore its fragments arrive,
+ * RSS hashes fragments by addresses only so they arrive on the same one.
+ * reassembled datagram is then steered to the lcore owning its flow by
+ * conn redirect of IPVS like any other packet, so reassembly is only on
+ * with redirect (ipv6_reasm_on). memory is capped by
+ * max_entries datagrams of RTE_LIBRTE_IP_FRAG_MAX_FRAG fragments each,
+ * timed-out or failed ones go to death row and are freed by loop job.
+ */
+static struct ipv6_frag ip6_frags[RTE_MAX_LCORE];
+#define this_ip6_frag    (ip6_frags[rte_lcore_id()])
+
+int ipv6_reassemble(struct rte_mbuf **pmbuf)
+{
+    struct rte_mbuf *mbuf = *pmbuf, *asm_mbuf, *seg;
+    struct ipv6_hdr *iph = rte_pktmbuf_mtod(mbuf, struct ipv6_hdr *);
+    struct ipv6_extension_fragment *fh;
+    uint16_t frag_max = mbuf->pkt_len;
+
+    fh = rte_ipv6_frag_get_ipv6_fragment_header(iph);
+    if (unlikely(!fh))
+        return EDPVS_INVPKT;
+
+    /* dpdk frag lib need mbuf->data_off of fragments start with
+     * l2 header if exist, and l3_len including fragment header. */
+    mbuf->l3_len = sizeof(*iph) + sizeof(*fh);
+    rte_pktmbuf_prepend(mbuf, mbuf->l2_len);
+
+    asm_mbuf = rte_ipv6_frag_reassemble_packet(
+            this_ip6_frag.reasm_tbl,
+            &this_ip6_frag.death_tbl,
+            mbuf, rte_rdtsc(), iph, fh);
+
+    if (!asm_mbuf) /* no way to distinguish error and in-progress */
+        return EDPVS_INPROGRESS;
+
+    /*
+     * unlike IPv4, no one holds the fragment after ipv6_rcv, so the head
+     * fragment (with L2 header kept ahead, as conn redirect needs) is just
+     * returned, not swapped with @mbuf.
+     */
+    rte_pktmbuf_adj(asm_mbuf, asm_mbuf->l2_len);
+    asm_mbuf->l3_len = sizeof(*iph);
+    asm_mbuf->userdata = NULL;
+
+    /* head has its IPv6 header, others are payload only */
+    frag_max = RTE_MAX(frag_max, asm_mbuf->data_len + sizeof(*fh));
+    for (seg = asm_mbuf->next; seg; seg = seg->next)
+        frag_max = RTE_MAX(frag_max, seg->data_len + sizeof(*iph) + sizeof(*fh));
+    asm_mbuf->ol_flags |= PKT_RX_LRO;
+    asm_mbuf->tso_segsz = frag_max;
+
+    *pmbuf = asm_mbuf;
+    return EDPVS_OK;
+}
+
+/*
+ * length of unfragmentable part, i.e., IPv6 header and extension headers
+ * up to routing header, and offset of the nexthdr field to be changed.
+ * refer linux:ip6_find_1stfragopt().
+ */
+static int ip6_unfrag_len(struct rte_mbuf *mbuf, unsigned int *prevhdr)
+{
+    unsigned int off = sizeof(struct ip6_hdr);
+    bool found_rhdr = false;
+    uint8_t *nexthdr, _opt[2], *opt;
+
+    *prevhdr = offsetof(struct ip6_hdr, ip6_nxt);
+
+    while (off <= mbuf->pkt_len) {
+        nexthdr = rte_pktmbuf_mtod_offset(mbuf, uint8_t *, *prevhdr);
+
+        switch (*nexthdr) {
+        case NEXTHDR_HOP:
+            break;
+        case NEXTHDR_ROUTING:
+            found_rhdr = true;
+            break;
+        case NEXTHDR_DEST:
+            if (found_rhdr)
+                return off;
+            break;
+        default:
+            return off;
+        }
+
+        opt = mbuf_header_pointer(mbuf, off, sizeof(_opt), _opt);
+        if (unlikely(!opt))
+            return -1;
+
+        *prevhdr = off;
+        off += (opt[1] + 1) << 3;
+
+        if (unlikely(mbuf_may_pull(mbuf, off) != 0))
+            return -1;
+    }
+
+    return -1;
+}
+
+/* payload can't be touched once referred, finish checksum offload first */
+static int ip6_frag_finish_csum(struct rte_mbuf *mbuf)
+{
+    uint64_t l4_flag = mbuf->ol_flags & PKT_TX_L4_MASK;
+    uint16_t *csum, sum;
+    uint32_t off;
+
+    if (likely(!l4_flag))
+        return EDPVS_OK;
+
+    /* pseudo header sum is seeded in checksum field already */
+    if (l4_flag == PKT_TX_TCP_CKSUM)
+        off = mbuf->l3_len + offsetof(struct tcp_hdr, cksum);
+    else if (l4_flag == PKT_TX_UDP_CKSUM)
+        off = mbuf->l3_len + offsetof(struct udp_hdr, dgram_cksum);
+    else
+        return EDPVS_NOTSUPP;
+
+    if (unlikely(mbuf_may_pull(mbuf, off + sizeof(*csum)) != 0))
+        return EDPVS_INVPKT;
+
+    if (rte_raw_cksum_mbuf(mbuf, mbuf->l3_len,
+                           mbuf->pkt_len - mbuf->l3_len, &sum) != 0)
+        return EDPVS_INVPKT;
+
+    csum = rte_pktmbuf_mtod_offset(mbuf, uint16_t *, off);
+    *csum = (uint16_t)~sum;
+    if (l4_flag == PKT_TX_UDP_CKSUM && *csum == 0)
+        *csum = 0xffff;
+
+    mbuf->ol_flags &= ~(PKT_TX_L4_MASK | PKT_TX_IPV6);
+    return EDPVS_OK;
+}
+
+/* chain indirect mbufs referring [off, off + len) of @mbuf to @frag */
+static int ip6_frag_attach(struct rte_mbuf *frag, struct rte_mbuf *mbuf,
+                           uint32_t off, uint32_t len)
+{
+    struct rte_mempool *pool = ip6_frag_indirect_pool[rte_socket_id()];
+    struct rte_mbuf *seg, *mi, *last = frag;
+    uint32_t n;
+
+    for (seg = mbuf; seg && off >= seg->data_len; seg = seg->next)
+        off -= seg->data_len;
+
+    while (len > 0) {
+        if (unlikely(!seg))
+            return EDPVS_INVPKT;
+
+        mi = rte_pktmbuf_alloc(pool);
+        if (unlikely(!mi))
+            return EDPVS_NOMEM;
+
+        n = RTE_MIN(seg->data_len - off, len);
+
+        rte_pktmbuf_attach(mi, seg);
+        mi->data_off += off;
+        mi->data_len = n;
+        mi->pkt_len = n;
+
+        last->next = mi;
+        last = mi;
+        frag->nb_segs++;
+        frag->pkt_len += n;
+
+        len -= n;
+        off = 0;
+        seg = seg->next;
+    }
+
+    return EDPVS_OK;
+}
+
+/*
+ * zero-copy fragmentation: each fragment is a new mbuf holding a copy of
+ * unfragmentable part and the fragment header, with its payload referred
+ * from the original packet by indirect mbufs.
+ *
+ * this function consumes mbuf also free route.
+ */
+int ipv6_fragment(struct rte_mbuf *mbuf, unsigned int mtu,
+                  int (*output)(struct rte_mbuf *))
+{
+    struct ip6_hdr *hdr = ip6_hdr(mbuf);
+    struct route6 *rt = NULL;
+    struct rte_mbuf *frag;
+    struct ip6_frag *fh;
+    unsigned int hlen, prevhdr, left, len, from;
+    uint8_t *nexthdr, proto;
+    uint32_t ident;
+    int err;
+    void *to;
+
+    /* @userdata is output device for multicast */
+    if (!ipv6_addr_is_multicast(&hdr->ip6_dst))
+        rt = mbuf->userdata;
+
+    if (mtu < IPV6_MIN_MTU)
+        mtu = IPV6_MIN_MTU;
+
+    err = ip6_unfrag_len(mbuf, &prevhdr);
+    if (unlikely(err < 0)) {
+        err = EDPVS_INVPKT;
+        goto out;
+    }
+    hlen = err;
+
+    err = ip6_frag_finish_csum(mbuf);
+    if (unlikely(err != EDPVS_OK))
+        goto out;
+
+    hdr = ip6_hdr(mbuf);
+    nexthdr = rte_pktmbuf_mtod_offset(mbuf, uint8_t *, prevhdr);
+    proto = *nexthdr;
+
+    /* payload space of each fragment, on eight byte boundary */
+    if (unlikely(hlen + sizeof(*fh) + 8 > mtu)) {
+        err = EDPVS_NOROOM;
+        goto out;
+    }
+    mtu = (mtu - hlen - sizeof(*fh)) & ~7;
+
+    ident = htonl(this_ip6_frag.ident++);
+    left = mbuf->pkt_len - hlen;
+    from = hlen;
+
+    while (left > 0) {
+        len = left < mtu ? left : mtu; /* min(left, mtu) */
+
+        frag = rte_pktmbuf_alloc(mbuf->pool);
+        if (!frag) {
+            err = EDPVS_NOMEM;
+            goto out;
+        }
+
+        /* copy metadata from orig pkt */
+        if (rt)
+            route6_get(rt);
+        frag->userdata = mbuf->userdata; /* no need to hold before consume mbuf */
+        frag->port = mbuf->port;
+        /* do not offload csum for frag, keep flow hash for tx queue */
+        frag->ol_flags = mbuf->ol_flags & PKT_RX_RSS_HASH;
+        frag->hash.rss = mbuf->hash.rss;
+        frag->l2_len = mbuf->l2_len;
+        frag->l3_len = hlen + sizeof(*fh);
+
+        /* copy unfragmentable part and add fragment header */
+        to = rte_pktmbuf_append(frag, hlen + sizeof(*fh));
+        if (unlikely(!to) || mbuf_copy_bits(mbuf, 0, to, hlen) != 0) {
+            err = EDPVS_NOROOM;
+            goto free_frag;
+        }
+        *((uint8_t *)to + prevhdr) = NEXTHDR_FRAGMENT;
+
+        fh = to + hlen;
+        fh->ip6f_nxt = proto;
+        fh->ip6f_reserved = 0;
+        fh->ip6f_offlg = htons(from - hlen);
+        if (left > len)
+            fh->ip6f_offlg |= IP6F_MORE_FRAG;
+        fh->ip6f_ident = ident;
+
+        /* refer data block */
+        err = ip6_frag_attach(frag, mbuf, from, len);
+        if (unlikely(err != EDPVS_OK))
+            goto free_frag;
+
+        ((struct ip6_hdr *)to)->ip6_plen =
+            htons(frag->pkt_len - sizeof(struct ip6_hdr));
+        left -= len;
+        from += len;
+
+        /* consumes frag and it's route */
+        err = output(frag);
+        if (err != EDPVS_OK)
+            goto out;
+
+        IP6_INC_STATS(fragcreates);
+    }
+
+    err = EDPVS_OK;
+    goto out;
+
+free_frag:
+    if (rt)
+        route6_put(rt);
+    rte_pktmbuf_free(frag);
+out:
+    /* fragments still refer the data until they're sent */
+    if (rt)
+        route6_put(rt);
+    rte_pktmbuf_free(mbuf);
+    if (err == EDPVS_OK)
+        IP6_INC_STATS(fragoks);
+    else
+        IP6_INC_STATS(fragfails);
+    return err;
+}
+
+int ipv6_frag_stats_cpu(struct ip6_frag_stats *stats)
+{
+    const struct rte_ip_frag_tbl *tbl = this_ip6_frag.reasm_tbl;
+
+    if (!stats)
+        return EDPVS_INVAL;
+    if (!tbl)
+        return EDPVS_NOTEXIST;
+
+    stats->use_entries = tbl->use_entries;
+    stats->add_num = tbl->stat.add_num;
+    stats->del_num = tbl->stat.del_num;
+    stats->reuse_num = tbl->stat.reuse_num;
+    stats->fail_total = tbl->stat.fail_total;
+    stats->fail_nospace = tbl->stat.fail_nospace;
+
+    return EDPVS_OK;
+}
+
+void ipv6_frag_conf_get(struct ip6_frag_param *param)
+{
+    param->buckets = ip6_frag_buckets;
+    param->bucket_entries = ip6_frag_bucket_entries;
+    param->max_entries = ip6_frag_max_entries;
+    param->max_frags = RTE_LIBRTE_IP_FRAG_MAX_FRAG;
+    param->ttl = ip6_frag_ttl;
+}
+
+static void ipv6_frag_job(void *arg)
+{
+    struct ipv6_frag *f = &ip6_frags[rte_lcore_id()];
+
+    rte_ip_frag_free_death_row(&f->death_tbl, IP6FRAG_PREFETCH_OFFSET);
+    return;
+}
+
+static struct netif_lcore_loop_job frag_job;
+
+int ipv6_frag_init(void)
+{
+    lcoreid_t cid;
+    int socket_id; /* NUMA-socket ID */
+    uint64_t max_cycles;
+    char name[32];
+    int err;
+    struct ipv6_frag *f6;
+
+    if (ip6_frag_bucket_entries <=0 ||
+            ip6_frag_max_entries > ip6_frag_buckets * ip6_frag_bucket_entries) {
+        RTE_LOG(WARNING, IP6FRAG, "invalid ip6_frag_max_entries %d (should be no "
+                "bigger than ip6_frag_buckets(%d) * ip6_frag_bucket_entries(%d), using "
+                "%d instead\n", ip6_frag_max_entries,
+                ip6_frag_buckets, ip6_frag_bucket_entries,
+                ip6_frag_buckets * ip6_frag_bucket_entries / 2);
+        ip6_frag_max_entries = ip6_frag_buckets * ip6_frag_bucket_entries / 2;
+    }
+
+    /* config is loaded, IPVS keywords included */
+    ipv6_reasm_on = !dp_vs_redirect_disable;
+    if (!ipv6_reasm_on)
+        RTE_LOG(WARNING, IP6FRAG, "reassembly is off, it needs conn redirect on.\n");
+
+    /* this magic expression comes from DPDK ip_reassembly example */
+    max_cycles = (rte_get_tsc_hz() + MS_PER_S - 1) / MS_PER_S *
+             (ip6_frag_ttl * MS_PER_S);
+
+    for (cid = 0; cid < RTE_MAX_LCORE; cid++) {
+        if (!rte_lcore_is_enabled(cid))
+            continue;
+
+        f6 = &ip6_frags[cid];
+        memset(f6, 0, sizeof(struct ipv6_frag));
+        socket_id = rte_lcore_to_socket_id(cid);
+
+        f6->reasm_tbl = rte_ip_frag_table_create(
+                    ip6_frag_buckets,
+                    ip6_frag_bucket_entries,
+                    ip6_frag_max_entries,
+                    max_cycles,
+                    socket_id);
+        if (!f6->reasm_tbl) {
+            RTE_LOG(ERR, IP6FRAG,
+                "[%d] fail to create frag table.\n", cid);
+            return EDPVS_DPDKAPIFAIL;
+        }
+        f6->ident = (uint32_t)rte_rand();
+    }
+
+    for (socket_id = 0; socket_id < get_numa_nodes(); socket_id++) {
+        snprintf(name, sizeof(name), "ip6_frag_indirect_%d", socket_id);
+        ip6_frag_indirect_pool[socket_id] = rte_pktmbuf_pool_create(name,
+                IP6_FRAG_INDIRECT_POOL_SIZE, IP6_FRAG_INDIRECT_CACHE_SIZE,
+                0, 0, socket_id);
+        if (!ip6_frag_indirect_pool[socket_id]) {
+            RTE_LOG(ERR, IP6FRAG, "fail to create indirect pool on socket %d.\n",
+                    socket_id);
+            return EDPVS_NOMEM;
+        }
+    }
+
+    snprintf(frag_job.name, sizeof(frag_job.name) - 1, "%s", "ipv6_frag");
+    frag_job.func = ipv6_frag_job;
+    frag_job.data = NULL;
+    frag_job.type = NETIF_LCORE_JOB_SLOW;
+    frag_job.skip_loops = IP6_FRAG_FREE_DEATH_ROW_INTERVAL;
+    err = netif_lcore_loop_job_register(&frag_job);
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IP6FRAG, "fail to register loop job.\n");
+        return err;
+    }
+
+    return EDPVS_OK;
+}
+
+int ipv6_frag_term(void)
+{
+    int err;
+
+    err = netif_lcore_loop_job_unregister(&frag_job);
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IP6FRAG, "fail to unregister loop job.\n");
+        return err;
+    }
+
+    return EDPVS_OK;
+}
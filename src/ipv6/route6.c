@@ -40,6 +40,7 @@ struct rt6_dustbin {
 
 static int g_rt6_recycle_time = RT6_RECYCLE_TIME_DEF;
 static RTE_DEFINE_PER_LCORE(struct rt6_dustbin, rt6_dbin);
+RTE_DEFINE_PER_LCORE(uint32_t, route6_genid);
 
 static inline void rt6_zero_prefix_tail(struct rt6_prefix *rt6_p)
 {
@@ -187,11 +188,13 @@ static struct route6 *rt6_get(const struct dp_vs_route6_conf *rt6_cfg)
 
 static int rt6_add_lcore(const struct dp_vs_route6_conf *rt6_cfg)
 {
+    this_route6_genid++;
     return g_rt6_method->rt6_add_lcore(rt6_cfg);
 }
 
 static int rt6_del_lcore(const struct dp_vs_route6_conf *rt6_cfg)
 {
+    this_route6_genid++;
     return g_rt6_method->rt6_del_lcore(rt6_cfg);
 }
 
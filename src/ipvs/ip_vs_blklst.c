@@ -85,7 +85,8 @@ static int dp_vs_blklst_add_lcore(uint8_t proto, const union inet_addr *vaddr,
 
     hashkey = blklst_hashkey(vaddr, blklst);
 
-    new = rte_zmalloc("new_blklst_entry", sizeof(struct blklst_entry), 0);
+    new = rte_zmalloc_socket("new_blklst_entry", sizeof(struct blklst_entry),
+                             0, rte_socket_id());
     if (new == NULL)
         return EDPVS_NOMEM;
 
@@ -27,7 +27,11 @@
 #include "ipvs/dest.h"
 #include "ipvs/laddr.h"
 #include "ipvs/xmit.h"
+#include "ipvs/encap.h"
+#include "ipvs/sess_log.h"
 #include "ipvs/synproxy.h"
+#include "ipvs/offload.h"
+#include "ipvs/warm.h"
 #include "ipvs/proto_tcp.h"
 #include "ipvs/proto_udp.h"
 #include "ipvs/proto_icmp.h"
@@ -116,6 +120,9 @@ static void dp_vs_conn_free(struct dp_vs_conn *conn)
 
     dp_vs_redirect_free(conn);
 
+    if (conn->offload_mark)
+        dp_vs_offload_del(conn);
+
     rte_mempool_put(conn->connpool, conn);
     this_conn_count--;
 }
@@ -262,19 +269,16 @@ static int conn_bind_dest(struct dp_vs_conn *conn, struct dp_vs_dest *dest)
      *   the dest here. */
     conn->flags |= rte_atomic16_read(&dest->conn_flags);
 
+    /* counters are aggregated periodically, the threshold is loose */
     if (dest->max_conn &&
-            (rte_atomic32_read(&dest->inactconns) + \
-             rte_atomic32_read(&dest->actconns) >= dest->max_conn)) {
+            (dest->inactconns + dest->actconns >= dest->max_conn)) {
         dest->flags |= DPVS_DEST_F_OVERLOAD;
         return EDPVS_OVERLOAD;
     }
 
     rte_atomic32_inc(&dest->refcnt);
 
-    if (conn->flags & DPVS_CONN_F_TEMPLATE)
-        rte_atomic32_inc(&dest->persistconns);
-    else
-        rte_atomic32_inc(&dest->inactconns);
+    dp_vs_dest_conn_bind(dest, !!(conn->flags & DPVS_CONN_F_TEMPLATE));
 
     switch (dest->fwdmode) {
     case DPVS_FWD_MODE_NAT:
@@ -284,6 +288,9 @@ static int conn_bind_dest(struct dp_vs_conn *conn, struct dp_vs_dest *dest)
     case DPVS_FWD_MODE_TUNNEL:
         conn->packet_xmit = dp_vs_xmit_tunnel;
         break;
+    case DPVS_FWD_MODE_OVERLAY:
+        conn->packet_xmit = dp_vs_xmit_overlay;
+        break;
     case DPVS_FWD_MODE_DR:
         conn->packet_xmit = dp_vs_xmit_dr;
         break;
@@ -307,20 +314,9 @@ static int conn_unbind_dest(struct dp_vs_conn *conn)
 {
     struct dp_vs_dest *dest = conn->dest;
 
-    if (conn->flags & DPVS_CONN_F_TEMPLATE) {
-        rte_atomic32_dec(&dest->persistconns);
-    } else  {
-        if (conn->flags & DPVS_CONN_F_INACTIVE)
-            rte_atomic32_dec(&dest->inactconns);
-        else
-            rte_atomic32_dec(&dest->actconns);
-    }
-
-    if (dest->max_conn &&
-            (rte_atomic32_read(&dest->inactconns) + \
-             rte_atomic32_read(&dest->actconns) < dest->max_conn)) {
-        dest->flags &= ~DPVS_DEST_F_OVERLOAD;
-    }
+    /* overload is cleared by dp_vs_dest_conns_aggregate() */
+    dp_vs_dest_conn_unbind(dest, !!(conn->flags & DPVS_CONN_F_TEMPLATE),
+                           !!(conn->flags & DPVS_CONN_F_INACTIVE));
 
     rte_atomic32_dec(&dest->refcnt);
 
@@ -507,6 +503,8 @@ static int conn_expire(void *priv)
         if (pp && pp->conn_expire)
             pp->conn_expire(pp, conn);
 
+        dp_vs_sess_log(conn, DPVS_SESS_LOG_DELETE);
+
         if (conn->dest->fwdmode == DPVS_FWD_MODE_SNAT
                 && conn->proto != IPPROTO_ICMP
                 && conn->proto != IPPROTO_ICMPV6) {
@@ -608,6 +606,7 @@ static void conn_flush(void)
                 rte_atomic32_dec(&conn->refcnt);
             } else {
                 dp_vs_conn_unhash(conn);
+                dp_vs_sess_log(conn, DPVS_SESS_LOG_DELETE);
 
                 if (conn->dest->fwdmode == DPVS_FWD_MODE_SNAT &&
                         conn->proto != IPPROTO_ICMP &&
@@ -766,9 +765,7 @@ struct dp_vs_conn *dp_vs_conn_new(struct rte_mbuf *mbuf,
     rte_atomic32_set(&new->refcnt, 1);
     new->flags  = flags;
     new->state  = 0;
-#ifdef CONFIG_DPVS_IPVS_STATS_DEBUG
     new->ctime = rte_rdtsc();
-#endif
 
     /* bind destination and corresponding trasmitter */
     err = conn_bind_dest(new, dest);
@@ -842,6 +839,7 @@ struct dp_vs_conn *dp_vs_conn_new(struct rte_mbuf *mbuf,
 #ifdef CONFIG_DPVS_IPVS_DEBUG
     conn_dump("new conn: ", new);
 #endif
+    dp_vs_sess_log(new, DPVS_SESS_LOG_CREATE);
     return new;
 
 unbind_laddr:
@@ -853,6 +851,217 @@ errout:
     return NULL;
 }
 
+/* take the SNAT <vaddr:vport> of a restored conn back from sa_pool */
+static int conn_snat_reserve(struct dp_vs_conn *conn)
+{
+    struct sockaddr_storage saddr, daddr;
+
+    memset(&saddr, 0, sizeof(saddr));
+    memset(&daddr, 0, sizeof(daddr));
+    if (AF_INET == conn->af) {
+        struct sockaddr_in *daddr4 = (struct sockaddr_in *)&daddr;
+        struct sockaddr_in *saddr4 = (struct sockaddr_in *)&saddr;
+
+        daddr4->sin_family = AF_INET;
+        daddr4->sin_addr = conn->caddr.in;
+        daddr4->sin_port = conn->cport;
+
+        saddr4->sin_family = AF_INET;
+        saddr4->sin_addr = conn->vaddr.in;
+        saddr4->sin_port = conn->vport;
+    } else { /* AF_INET6 */
+        struct sockaddr_in6 *daddr6 = (struct sockaddr_in6 *)&daddr;
+        struct sockaddr_in6 *saddr6 = (struct sockaddr_in6 *)&saddr;
+
+        daddr6->sin6_family = AF_INET6;
+        daddr6->sin6_addr = conn->caddr.in6;
+        daddr6->sin6_port = conn->cport;
+
+        saddr6->sin6_family = AF_INET6;
+        saddr6->sin6_addr = conn->vaddr.in6;
+        saddr6->sin6_port = conn->vport;
+    }
+
+    /* out_dev is unknown until the first packet, any dev with vaddr */
+    return sa_reserve(NULL, &daddr, &saddr);
+}
+
+/*
+ * rebuild a conn saved by warm restart on this lcore, with its dest of
+ * the new process. the conn expires @left later.
+ */
+int dp_vs_conn_restore(const struct dp_vs_warm_conn *wc,
+                       struct dp_vs_dest *dest, const struct timeval *left)
+{
+    struct dp_vs_conn *new;
+    struct conn_tuple_hash *t;
+    struct timeval delay;
+    int err;
+
+    assert(wc && dest && left);
+
+    if (wc->flags & DPVS_CONN_F_TEMPLATE)
+        return EDPVS_NOTSUPP;
+
+    new = dp_vs_conn_get(wc->af, wc->proto, &wc->caddr, &wc->vaddr,
+                         wc->cport, wc->vport, NULL, false);
+    if (new) {
+        dp_vs_conn_put_no_reset(new);
+        return EDPVS_EXIST;
+    }
+
+    new = dp_vs_conn_alloc(dest->fwdmode, 0);
+    if (unlikely(!new))
+        return EDPVS_NOMEM;
+
+    /* init inbound conn tuple hash */
+    t = &tuplehash_in(new);
+    t->direct   = DPVS_CONN_DIR_INBOUND;
+    t->af       = wc->af;
+    t->proto    = wc->proto;
+    t->saddr    = wc->caddr;
+    t->sport    = wc->cport;
+    t->daddr    = wc->vaddr;
+    t->dport    = wc->vport;
+    INIT_LIST_HEAD(&t->list);
+
+    /* init outbound conn tuple hash, laddr is caddr for non-FNAT */
+    t = &tuplehash_out(new);
+    t->direct   = DPVS_CONN_DIR_OUTBOUND;
+    t->af       = dest->af;
+    t->proto    = wc->proto;
+    t->saddr    = wc->daddr;
+    t->sport    = wc->dport;
+    t->daddr    = wc->laddr;
+    t->dport    = wc->lport;
+    INIT_LIST_HEAD(&t->list);
+
+    /* init connection */
+    new->af     = wc->af;
+    new->proto  = wc->proto;
+    new->caddr  = wc->caddr;
+    new->cport  = wc->cport;
+    new->vaddr  = wc->vaddr;
+    new->vport  = wc->vport;
+    new->laddr  = wc->laddr;
+    new->lport  = wc->lport;
+    new->daddr  = wc->daddr;
+    new->dport  = wc->dport;
+    new->outwall = !!wc->outwall;
+
+    new->fnat_seq = wc->fnat_seq;
+    new->syn_proxy_seq = wc->syn_proxy_seq;
+    new->rs_end_seq = wc->rs_end_seq;
+    new->rs_end_ack = wc->rs_end_ack;
+
+    /* neighbour confirm cache */
+    if (AF_INET == tuplehash_in(new).af) {
+        new->in_nexthop.in.s_addr = htonl(INADDR_ANY);
+    } else {
+        new->in_nexthop.in6 = in6addr_any;
+    }
+
+    if (AF_INET == tuplehash_out(new).af) {
+        new->out_nexthop.in.s_addr = htonl(INADDR_ANY);
+    } else {
+        new->out_nexthop.in6 = in6addr_any;
+    }
+
+    new->in_dev = NULL;
+    new->out_dev = NULL;
+
+    new->control = NULL;
+    rte_atomic32_clear(&new->n_control);
+
+    rte_atomic32_set(&new->refcnt, 1);
+    new->flags  = 0;
+    new->state  = wc->state;
+    new->old_state = wc->old_state;
+    new->ctime = rte_rdtsc();
+
+    err = conn_bind_dest(new, dest);
+    if (err != EDPVS_OK)
+        goto errout;
+
+    /* flags of the dest are for new conns, take the saved ones */
+    new->flags &= ~DPVS_CONN_F_SYNPROXY;
+    new->flags |= wc->flags & DPVS_CONN_F_SYNPROXY;
+    if (!(wc->flags & DPVS_CONN_F_INACTIVE) &&
+            (new->flags & DPVS_CONN_F_INACTIVE)) {
+        dp_vs_dest_conn_activate(dest);
+        new->flags &= ~DPVS_CONN_F_INACTIVE;
+    }
+
+    if (dest->fwdmode == DPVS_FWD_MODE_FNAT) {
+        if (dp_vs_laddr_rebind(new, dest->svc) != EDPVS_OK) {
+            err = EDPVS_RESOURCE;
+            goto unbind_dest;
+        }
+    } else if (dest->fwdmode == DPVS_FWD_MODE_SNAT &&
+               new->proto != IPPROTO_ICMP && new->proto != IPPROTO_ICMPV6) {
+        if (conn_snat_reserve(new) != EDPVS_OK) {
+            err = EDPVS_RESOURCE;
+            goto unbind_dest;
+        }
+    }
+
+    dp_vs_redirect_init(new);
+
+    if ((err = dp_vs_conn_hash(new)) != EDPVS_OK)
+        goto unbind_laddr;
+
+    INIT_LIST_HEAD(&new->ack_mbuf);
+    rte_atomic32_set(&new->syn_retry_max, 0);
+    rte_atomic32_set(&new->dup_ack_cnt, 0);
+
+    new->timeout.tv_sec = wc->timeout;
+    new->timeout.tv_usec = 0;
+    delay = *left;
+    dpvs_timer_sched(&new->timer, &delay, conn_expire, new, false);
+
+    /* no one holds it but the hash table */
+    rte_atomic32_dec(&new->refcnt);
+
+#ifdef CONFIG_DPVS_IPVS_DEBUG
+    conn_dump("restored conn: ", new);
+#endif
+    return EDPVS_OK;
+
+unbind_laddr:
+    dp_vs_laddr_unbind(new);
+unbind_dest:
+    conn_unbind_dest(new);
+errout:
+    dp_vs_conn_free(new);
+    return err;
+}
+
+/* call @fn for each conn of this lcore, stop if it fails */
+int dp_vs_conn_walk(int (*fn)(struct dp_vs_conn *conn, void *arg), void *arg)
+{
+    struct conn_tuple_hash *tuphash;
+    struct dp_vs_conn *conn;
+    int i, err = EDPVS_OK;
+
+#ifdef CONFIG_DPVS_IPVS_CONN_LOCK
+    rte_spinlock_lock(&this_conn_lock);
+#endif
+    for (i = 0; i < DPVS_CONN_TBL_SIZE; i++) {
+        list_for_each_entry(tuphash, &this_conn_tbl[i], list) {
+            if (tuphash->direct != DPVS_CONN_DIR_INBOUND)
+                continue;
+            conn = tuplehash_to_conn(tuphash);
+            if ((err = fn(conn, arg)) != EDPVS_OK)
+                goto out;
+        }
+    }
+out:
+#ifdef CONFIG_DPVS_IPVS_CONN_LOCK
+    rte_spinlock_unlock(&this_conn_lock);
+#endif
+    return err;
+}
+
 /**
  * try lookup and hold dp_vs_conn{} by packet tuple
  *
@@ -1701,6 +1910,12 @@ int dp_vs_conn_pool_size(void)
     return conn_pool_size;
 }
 
+/* conns of the calling lcore */
+uint32_t dp_vs_conn_count_get(void)
+{
+    return this_conn_count;
+}
+
 int dp_vs_conn_pool_cache_size(void)
 {
     return conn_pool_cache;
@@ -1816,5 +2031,6 @@ void install_ipvs_conn_keywords(void)
             KW_TYPE_NORMAL);
     install_keyword("redirect", conn_redirect_handler, KW_TYPE_INIT);
     install_xmit_keywords();
+    install_encap_keywords();
     install_sublevel_end();
 }
@@ -33,10 +33,18 @@
 #include "ipvs/laddr.h"
 #include "ipvs/xmit.h"
 #include "ipvs/synproxy.h"
+#include "ipvs/overload.h"
+#include "ipvs/offload.h"
+#include "ipvs/warm.h"
 #include "ipvs/blklst.h"
 #include "ipvs/proto_udp.h"
 #include "route6.h"
 #include "ipvs/redirect.h"
+#include "ipvs/encap.h"
+#include "ipvs/sess_log.h"
+#include "ipvs/hc.h"
+#include "bench.h"
+#include "prof.h"
 
 static inline int dp_vs_fill_iphdr(int af, struct rte_mbuf *mbuf,
                                    struct dp_vs_iphdr *iph)
@@ -270,12 +278,11 @@ static struct dp_vs_conn *dp_vs_snat_schedule(struct dp_vs_dest *dest,
     return conn;
 }
 
-/* select an RS by service's scheduler and create a connection */
-struct dp_vs_conn *dp_vs_schedule(struct dp_vs_service *svc,
-                                  const struct dp_vs_iphdr *iph,
-                                  struct rte_mbuf *mbuf,
-                                  bool is_synproxy_on,
-                                  bool outwall)
+static struct dp_vs_conn *__dp_vs_schedule(struct dp_vs_service *svc,
+                                           const struct dp_vs_iphdr *iph,
+                                           struct rte_mbuf *mbuf,
+                                           bool is_synproxy_on,
+                                           bool outwall)
 {
     uint16_t _ports[2], *ports; /* sport, dport */
     struct dp_vs_dest *dest;
@@ -346,6 +353,24 @@ struct dp_vs_conn *dp_vs_schedule(struct dp_vs_service *svc,
     return conn;
 }
 
+/* select an RS by service's scheduler and create a connection */
+struct dp_vs_conn *dp_vs_schedule(struct dp_vs_service *svc,
+                                  const struct dp_vs_iphdr *iph,
+                                  struct rte_mbuf *mbuf,
+                                  bool is_synproxy_on,
+                                  bool outwall)
+{
+    struct dp_vs_conn *conn;
+
+    DPVS_BENCH_START(tsc);
+    DPVS_PROF_START(prof_tsc);
+    conn = __dp_vs_schedule(svc, iph, mbuf, is_synproxy_on, outwall);
+    DPVS_PROF_END(DPVS_PROF_SCHED, prof_tsc);
+    DPVS_BENCH_END(DPVS_BENCH_SCHED, tsc, 1);
+
+    return conn;
+}
+
 /* return verdict INET_XXX */
 static int xmit_outbound(struct rte_mbuf *mbuf,
                          struct dp_vs_proto *prot,
@@ -365,7 +390,9 @@ static int xmit_outbound(struct rte_mbuf *mbuf,
         return INET_ACCEPT;
     }
 
+    DPVS_PROF_START(prof_tsc);
     err = conn->packet_out_xmit(prot, conn, mbuf);
+    DPVS_PROF_END(DPVS_PROF_XMIT, prof_tsc);
     if (err != EDPVS_OK)
         RTE_LOG(DEBUG, IPVS, "%s: fail to out xmit: %d\n", __func__, err);
 
@@ -402,7 +429,9 @@ static int xmit_inbound(struct rte_mbuf *mbuf,
     }
 
     /* forward to RS */
+    DPVS_PROF_START(prof_tsc);
     err = conn->packet_xmit(prot, conn, mbuf);
+    DPVS_PROF_END(DPVS_PROF_XMIT, prof_tsc);
     if (err != EDPVS_OK)
         RTE_LOG(DEBUG, IPVS, "%s: fail to transmit: %d\n", __func__, err);
 
@@ -974,8 +1003,14 @@ static int __dp_vs_in(void *priv, struct rte_mbuf *mbuf,
         return INET_DROP;
     }
 
-    /* packet belongs to existing connection ? */
-    conn = prot->conn_lookup(prot, &iph, mbuf, &dir, false, &drop, &peer_cid);
+    /* packet belongs to existing connection ? offloaded ones are marked */
+    DPVS_PROF_START(prof_tsc);
+    conn = NULL;
+    if (dp_vs_offload_on)
+        conn = dp_vs_offload_conn_get(&iph, mbuf, &dir);
+    if (!conn)
+        conn = prot->conn_lookup(prot, &iph, mbuf, &dir, false, &drop, &peer_cid);
+    DPVS_PROF_END(DPVS_PROF_CONN_LOOKUP, prof_tsc);
 
     if (unlikely(drop)) {
         RTE_LOG(DEBUG, IPVS, "%s: deny ip try to visit.\n", __func__);
@@ -994,6 +1029,11 @@ static int __dp_vs_in(void *priv, struct rte_mbuf *mbuf,
     }
 
     if (unlikely(!conn)) {
+        /* shed new flows first when the lcore is overloaded */
+        if (dp_vs_overloaded() &&
+                dp_vs_overload_shed(prot, &iph, mbuf, &verdict))
+            return verdict;
+
         /* try schedule RS and create new connection */
         if (prot->conn_sched(prot, &iph, mbuf, &conn, &verdict) != EDPVS_OK) {
             /* RTE_LOG(DEBUG, IPVS, "%s: fail to schedule.\n", __func__); */
@@ -1007,6 +1047,9 @@ static int __dp_vs_in(void *priv, struct rte_mbuf *mbuf,
             dir = DPVS_CONN_DIR_INBOUND;
     }
 
+    if (dir == DPVS_CONN_DIR_INBOUND)
+        dp_vs_offload_count(conn, mbuf);
+
     if (conn->flags & DPVS_CONN_F_SYNPROXY) {
         if (dir == DPVS_CONN_DIR_INBOUND) {
             /* Filter out-in ack packet when cp is at SYN_SENT state.
@@ -1057,13 +1100,25 @@ static int __dp_vs_in(void *priv, struct rte_mbuf *mbuf,
 static int dp_vs_in(void *priv, struct rte_mbuf *mbuf,
                       const struct inet_hook_state *state)
 {
-    return __dp_vs_in(priv, mbuf, state, AF_INET);
+    int verdict;
+
+    DPVS_BENCH_START(tsc);
+    verdict = __dp_vs_in(priv, mbuf, state, AF_INET);
+    DPVS_BENCH_END(DPVS_BENCH_IPVS_IN, tsc, 1);
+
+    return verdict;
 }
 
 static int dp_vs_in6(void *priv, struct rte_mbuf *mbuf,
                       const struct inet_hook_state *state)
 {
-    return __dp_vs_in(priv, mbuf, state, AF_INET6);
+    int verdict;
+
+    DPVS_BENCH_START(tsc);
+    verdict = __dp_vs_in(priv, mbuf, state, AF_INET6);
+    DPVS_BENCH_END(DPVS_BENCH_IPVS_IN, tsc, 1);
+
+    return verdict;
 }
 
 static int __dp_vs_pre_routing(void *priv, struct rte_mbuf *mbuf,
@@ -1198,6 +1253,42 @@ int dp_vs_init(void)
         goto err_stats;
     }
 
+    err = dp_vs_encap_init();
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IPVS, "fail to init encap: %s\n", dpvs_strerror(err));
+        goto err_encap;
+    }
+
+    err = dp_vs_sess_log_init();
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IPVS, "fail to init session log: %s\n", dpvs_strerror(err));
+        goto err_sess_log;
+    }
+
+    err = dp_vs_hc_init();
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IPVS, "fail to init health check: %s\n", dpvs_strerror(err));
+        goto err_hc;
+    }
+
+    err = dp_vs_overload_init();
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IPVS, "fail to init overload: %s\n", dpvs_strerror(err));
+        goto err_overload;
+    }
+
+    err = dp_vs_offload_init();
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IPVS, "fail to init flow offload: %s\n", dpvs_strerror(err));
+        goto err_offload;
+    }
+
+    err = dp_vs_warm_init();
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IPVS, "fail to init warm restart: %s\n", dpvs_strerror(err));
+        goto err_warm;
+    }
+
     err = inet_register_hooks(dp_vs_ops, NELEMS(dp_vs_ops));
     if (err != EDPVS_OK) {
         RTE_LOG(ERR, IPVS, "fail to register hooks: %s\n", dpvs_strerror(err));
@@ -1208,6 +1299,18 @@ int dp_vs_init(void)
     return EDPVS_OK;
 
 err_hooks:
+    dp_vs_warm_term();
+err_warm:
+    dp_vs_offload_term();
+err_offload:
+    dp_vs_overload_term();
+err_overload:
+    dp_vs_hc_term();
+err_hc:
+    dp_vs_sess_log_term();
+err_sess_log:
+    dp_vs_encap_term();
+err_encap:
     dp_vs_stats_term();
 err_stats:
     dp_vs_blklst_term();
@@ -1237,6 +1340,30 @@ int dp_vs_term(void)
     if (err != EDPVS_OK)
         RTE_LOG(ERR, IPVS, "fail to unregister hooks: %s\n", dpvs_strerror(err));
 
+    err = dp_vs_warm_term();
+    if (err != EDPVS_OK)
+        RTE_LOG(ERR, IPVS, "fail to terminate warm restart: %s\n", dpvs_strerror(err));
+
+    err = dp_vs_offload_term();
+    if (err != EDPVS_OK)
+        RTE_LOG(ERR, IPVS, "fail to terminate flow offload: %s\n", dpvs_strerror(err));
+
+    err = dp_vs_overload_term();
+    if (err != EDPVS_OK)
+        RTE_LOG(ERR, IPVS, "fail to terminate overload: %s\n", dpvs_strerror(err));
+
+    err = dp_vs_hc_term();
+    if (err != EDPVS_OK)
+        RTE_LOG(ERR, IPVS, "fail to terminate health check: %s\n", dpvs_strerror(err));
+
+    err = dp_vs_sess_log_term();
+    if (err != EDPVS_OK)
+        RTE_LOG(ERR, IPVS, "fail to terminate session log: %s\n", dpvs_strerror(err));
+
+    err = dp_vs_encap_term();
+    if (err != EDPVS_OK)
+        RTE_LOG(ERR, IPVS, "fail to terminate encap: %s\n", dpvs_strerror(err));
+
     err = dp_vs_stats_term();
     if (err != EDPVS_OK)
         RTE_LOG(ERR, IPVS, "fail to terminate term: %s\n", dpvs_strerror(err));
@@ -24,6 +24,9 @@
 #include "ipvs/sched.h"
 #include "ipvs/laddr.h"
 #include "ipvs/conn.h"
+#include "ipvs/encap.h"
+#include "ipvs/hc.h"
+#include "stats_shm.h"
 
 /*
  * Trash for destinations
@@ -31,6 +34,91 @@
 
 struct list_head dp_vs_dest_trash = LIST_HEAD_INIT(dp_vs_dest_trash);
 
+static void dp_vs_dest_free(struct dp_vs_dest *dest)
+{
+    dp_vs_encap_vtep_del(dest->af, &dest->encap);
+    if (dest->stats_shm)
+        dpvs_stats_shm_dest_detach(dest);
+    else
+        dp_vs_del_stats(dest->stats);
+    rte_free(dest->lcore);
+    rte_free(dest);
+}
+
+void dp_vs_dest_conns_aggregate(struct dp_vs_dest *dest)
+{
+    int i;
+    int32_t act = 0, inact = 0, persist = 0;
+    uint32_t low;
+
+    /* slots of lcores not forwarding are all zero */
+    for (i = 0; i < DPVS_MAX_LCORE; i++) {
+        act += dest->lcore[i].actconns;
+        inact += dest->lcore[i].inactconns;
+        persist += dest->lcore[i].persistconns;
+    }
+
+    dest->actconns = act > 0 ? act : 0;
+    dest->inactconns = inact > 0 ? inact : 0;
+    dest->persistconns = persist > 0 ? persist : 0;
+
+    if (!dest->max_conn)
+        return;
+
+    if (dest->actconns + dest->inactconns >= dest->max_conn) {
+        dest->flags |= DPVS_DEST_F_OVERLOAD;
+        return;
+    }
+
+    /* leave overload below lower threshold, or upper if not set */
+    low = dest->min_conn ? : dest->max_conn;
+    if ((dest->flags & DPVS_DEST_F_OVERLOAD) &&
+            dest->actconns + dest->inactconns < low) {
+        dest->flags &= ~DPVS_DEST_F_OVERLOAD;
+        /* let schedulers take it back */
+        if (dest->svc)
+            rte_atomic32_inc(&dest->svc->lc_gen);
+    }
+}
+
+/*
+ * lcores only add up their samples, master takes the mean of samples
+ * arrived since last time and smooths it by EWMA (1/4), so a slow or
+ * pausing server shows up within a few rounds.
+ */
+void dp_vs_dest_rtt_aggregate(struct dp_vs_dest *dest)
+{
+    int i;
+    uint64_t sum = 0, cnt = 0, rtt;
+
+    for (i = 0; i < DPVS_MAX_LCORE; i++) {
+        sum += dest->lcore[i].rtt_sum;
+        cnt += dest->lcore[i].rtt_cnt;
+    }
+
+    if (cnt <= dest->rtt_samples)
+        return;
+
+    rtt = (sum - dest->rtt_sum) / (cnt - dest->rtt_samples);
+    dest->rtt_us = dest->rtt_us ? (dest->rtt_us * 3 + rtt) / 4 : RTE_MAX(rtt, 1UL);
+    dest->rtt_sum = sum;
+    dest->rtt_samples = cnt;
+}
+
+/*
+ * lcores may still touch a dest shortly after it's unlinked, e.g., its
+ * slot in a least-connection index not rebuilt yet. so an unreferenced
+ * dest stays in trash for a while before freed.
+ */
+#define DP_VS_TRASH_GRACE_MS    200
+
+static inline bool dp_vs_trash_expired(struct dp_vs_dest *dest)
+{
+    return rte_atomic32_read(&dest->refcnt) == 1 &&
+           rte_get_timer_cycles() - dest->trash_tsc >
+           rte_get_timer_hz() * DP_VS_TRASH_GRACE_MS / 1000;
+}
+
 struct dp_vs_dest *dp_vs_lookup_dest(int af,
                                      struct dp_vs_service *svc,
                                      const union inet_addr *daddr,
@@ -78,19 +166,32 @@ struct dp_vs_dest *dp_vs_trash_get_dest(struct dp_vs_service *svc,
              dest->limit_proportion = svc->limit_proportion;
              return dest;
             }
-        if (rte_atomic32_read(&dest->refcnt) == 1) {
+        if (dp_vs_trash_expired(dest)) {
             RTE_LOG(DEBUG, SERVICE, "%s: Removing destination from trash.\n", __func__);
             list_del(&dest->n_list);
             //dp_vs_dst_reset(dest);//to be finished
             __dp_vs_unbind_svc(dest);
 
-            dp_vs_del_stats(dest->stats);
-            rte_free(dest);
+            dp_vs_dest_free(dest);
         }
     }
     return NULL;
 }
 
+/* free expired dests in trash, called periodically */
+void dp_vs_trash_sweep(void)
+{
+    struct dp_vs_dest *dest, *nxt;
+
+    list_for_each_entry_safe(dest, nxt, &dp_vs_dest_trash, n_list) {
+        if (!dp_vs_trash_expired(dest))
+            continue;
+        list_del(&dest->n_list);
+        __dp_vs_unbind_svc(dest);
+        dp_vs_dest_free(dest);
+    }
+}
+
 void dp_vs_trash_cleanup(void)
 {
     struct dp_vs_dest *dest, *nxt;
@@ -100,8 +201,7 @@ void dp_vs_trash_cleanup(void)
         //dp_vs_dst_reset(dest);
         __dp_vs_unbind_svc(dest);
 
-        dp_vs_del_stats(dest->stats);
-        rte_free(dest);
+        dp_vs_dest_free(dest);
     }
 }
 
@@ -129,7 +229,9 @@ static void __dp_vs_update_dest(struct dp_vs_service *svc,
         }
     }
 
-    dest->flags |= DPVS_DEST_F_AVAILABLE;
+    /* health check may hold it down */
+    if (!dp_vs_hc_dest_down(dest))
+        dest->flags |= DPVS_DEST_F_AVAILABLE;
 
     if (udest->max_conn == 0 || udest->max_conn > dest->max_conn)
         dest->flags &= ~DPVS_DEST_F_OVERLOAD;
@@ -162,16 +264,30 @@ int dp_vs_new_dest(struct dp_vs_service *svc,
     dest->addr = udest->addr;
     dest->port = udest->port;
     dest->fwdmode = udest->fwdmode;
-    rte_atomic32_set(&dest->actconns, 0);
-    rte_atomic32_set(&dest->inactconns, 0);
-    rte_atomic32_set(&dest->persistconns, 0);
+    dp_vs_encap_build(&dest->encap, dest->af, &dest->addr, udest);
     rte_atomic32_set(&dest->refcnt, 0);
 
-    if (dp_vs_new_stats(&(dest->stats)) != EDPVS_OK) {
+    dest->lcore = rte_zmalloc("dpvs_dest_lcore",
+            sizeof(struct dp_vs_dest_lcore) * DPVS_MAX_LCORE, RTE_CACHE_LINE_SIZE);
+    if (!dest->lcore) {
         rte_free(dest);
         return EDPVS_NOMEM;
     }
 
+    /* exported by stats shm if possible */
+    if (dpvs_stats_shm_dest_attach(dest) != EDPVS_OK &&
+            dp_vs_new_stats(&(dest->stats)) != EDPVS_OK) {
+        rte_free(dest->lcore);
+        rte_free(dest);
+        return EDPVS_NOMEM;
+    }
+
+    if (dp_vs_encap_vtep_add(dest->af, &dest->encap) != EDPVS_OK) {
+        dest->encap.type = DPVS_DEST_ENCAP_NONE; /* not added */
+        dp_vs_dest_free(dest);
+        return EDPVS_NOMEM;
+    }
+
     __dp_vs_update_dest(svc, dest, udest);
 
     *dest_p = dest;
@@ -197,6 +313,10 @@ dp_vs_add_dest(struct dp_vs_service *svc, struct dp_vs_dest_conf *udest)
         return EDPVS_NOTSUPP;
     }
 
+    ret = dp_vs_encap_verify(svc, udest);
+    if (ret != EDPVS_OK)
+        return ret;
+
     daddr = udest->addr;
 
     /*
@@ -237,12 +357,16 @@ dp_vs_add_dest(struct dp_vs_service *svc, struct dp_vs_dest_conf *udest)
         list_add(&dest->n_list, &svc->dests);
         svc->weight += udest->weight;
         svc->num_dests++;
+        if (!dp_vs_dest_is_nat(dest))
+            svc->num_nonat_dests++;
 
         /* call the update_service function of its scheduler */
         if (svc->scheduler->update_service)
             svc->scheduler->update_service(svc, dest, DPVS_SO_SET_ADDDEST);
 
         rte_rwlock_write_unlock(&__dp_vs_svc_lock);
+
+        dp_vs_hc_dest_add(svc, dest);
         return EDPVS_OK;
     }
 
@@ -269,6 +393,8 @@ dp_vs_add_dest(struct dp_vs_service *svc, struct dp_vs_dest_conf *udest)
     list_add(&dest->n_list, &svc->dests);
     svc->weight += udest->weight;
     svc->num_dests++;
+    if (!dp_vs_dest_is_nat(dest))
+        svc->num_nonat_dests++;
 
     /* call the update_service function of its scheduler */
     if (svc->scheduler->update_service)
@@ -276,6 +402,7 @@ dp_vs_add_dest(struct dp_vs_service *svc, struct dp_vs_dest_conf *udest)
 
     rte_rwlock_write_unlock(&__dp_vs_svc_lock);
 
+    dp_vs_hc_dest_add(svc, dest);
     return EDPVS_OK;
 }
 
@@ -346,25 +473,15 @@ dp_vs_edit_dest(struct dp_vs_service *svc, struct dp_vs_dest_conf *udest)
 void __dp_vs_del_dest(struct dp_vs_dest *dest)
 {
     /*
-     *  Decrease the refcnt of the dest, and free the dest
-     *  if nobody refers to it (refcnt=0). Otherwise, throw
-     *  the destination into the trash.
+     *  Throw the destination into the trash, it's freed by
+     *  dp_vs_trash_sweep() after a grace period if nobody
+     *  refers to it (refcnt=1) then.
      */
-    if (rte_atomic32_dec_and_test(&dest->refcnt)) {
-     //   dp_vs_dst_reset(dest);
-        /* simply decrease svc->refcnt here, let the caller check
-           and release the service if nobody refers to it.
-           Only user context can release destination and service,
-           and only one user context can update virtual service at a
-           time, so the operation here is OK */
-        __dp_vs_unbind_svc(dest);
-        dp_vs_del_stats(dest->stats);
-        rte_free(dest);
-    } else {
-        RTE_LOG(DEBUG, SERVICE,"%s moving dest into trash\n", __func__);
-        list_add(&dest->n_list, &dp_vs_dest_trash);
-        rte_atomic32_inc(&dest->refcnt);
-    }
+    dp_vs_hc_dest_del(dest);
+
+    RTE_LOG(DEBUG, SERVICE,"%s moving dest into trash\n", __func__);
+    dest->trash_tsc = rte_get_timer_cycles();
+    list_add(&dest->n_list, &dp_vs_dest_trash);
 }
 
 /*
@@ -380,6 +497,8 @@ void __dp_vs_unlink_dest(struct dp_vs_service *svc,
      */
     list_del(&dest->n_list);
     svc->num_dests--;
+    if (!dp_vs_dest_is_nat(dest))
+        svc->num_nonat_dests--;
 
     svc->weight -= rte_atomic16_read(&dest->weight);
     if (svc->weight < 0) {
@@ -453,9 +572,19 @@ int dp_vs_get_dest_entries(const struct dp_vs_service *svc,
         entry.weight = rte_atomic16_read(&dest->weight);
         entry.max_conn = dest->max_conn;
         entry.min_conn = dest->min_conn;
-        entry.actconns = rte_atomic32_read(&dest->actconns);
-        entry.inactconns = rte_atomic32_read(&dest->inactconns);
-        entry.persistconns = rte_atomic32_read(&dest->persistconns);
+        dp_vs_dest_conns_aggregate(dest);
+        entry.actconns = dest->actconns;
+        entry.inactconns = dest->inactconns;
+        entry.persistconns = dest->persistconns;
+        entry.rtt_us = dest->rtt_us;
+        entry.rtt_samples = dest->rtt_samples;
+        entry.encap = dest->encap.type;
+        if (dp_vs_dest_has_encap(dest)) {
+            entry.vni = dest->encap.vni;
+            entry.vtep = dest->encap.vtep;
+            memcpy(entry.inner_dmac, dest->encap.tmpl + dest->encap.hlen
+                   - sizeof(struct ether_hdr), sizeof(entry.inner_dmac));
+        }
         ret = dp_vs_copy_stats(&(entry.stats), dest->stats);
 
         memcpy(&uptr->entrytable[count], &entry, sizeof(entry));
@@ -0,0 +1,574 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include <assert.h>
+#include <stddef.h>
+#include <linux/if_ether.h>
+#include <rte_jhash.h>
+#include "list.h"
+#include "ipv4.h"
+#include "ipv6.h"
+#include "route.h"
+#include "route6.h"
+#include "netif.h"
+#include "inetaddr.h"
+#include "ip_tunnel.h"
+#include "ipvs/ipvs.h"
+#include "ipvs/encap.h"
+#include "ipvs/proto_udp.h"
+#include "parser/parser.h"
+
+/* dynamic port range for UDP source port entropy [RFC 7348, section 5] */
+#define ENCAP_SPORT_MIN         49152
+#define ENCAP_SPORT_MASK        0x3fff
+
+#define ENCAP_VNI_MAX           0xffffff
+
+#define ENCAP_VTEP_TAB_BITS     8
+#define ENCAP_VTEP_TAB_SIZE     (1 << ENCAP_VTEP_TAB_BITS)
+#define ENCAP_VTEP_TAB_MASK     (ENCAP_VTEP_TAB_SIZE - 1)
+
+/*
+ * (VTEP, VNI) of overlay dests, only packets from them are decapsulated.
+ * dests sharing a VTEP and VNI share the entry.
+ */
+struct encap_vtep {
+    struct list_head    list;
+    int                 af;
+    uint32_t            vni;
+    union inet_addr     addr;
+    int                 refcnt;     /* dests using it */
+};
+
+static bool encap_decap = false;
+
+static struct list_head encap_vtep_tab[ENCAP_VTEP_TAB_SIZE];
+static rte_rwlock_t encap_vtep_lock;
+
+static const struct ether_addr encap_bcast_mac = {
+    .addr_bytes = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },
+};
+
+int dp_vs_encap_verify(const struct dp_vs_service *svc,
+                       const struct dp_vs_dest_conf *udest)
+{
+    switch (udest->encap) {
+    case DPVS_DEST_ENCAP_NONE:
+        if (udest->fwdmode == DPVS_FWD_MODE_OVERLAY) {
+            RTE_LOG(DEBUG, SERVICE, "%s: overlay mode without encapsulation.\n",
+                    __func__);
+            return EDPVS_INVAL;
+        }
+        return EDPVS_OK;
+    case DPVS_DEST_ENCAP_VXLAN:
+    case DPVS_DEST_ENCAP_GENEVE:
+        break;
+    default:
+        return EDPVS_INVAL;
+    }
+
+    if (udest->vni > ENCAP_VNI_MAX) {
+        RTE_LOG(DEBUG, SERVICE, "%s: invalid VNI %u.\n", __func__, udest->vni);
+        return EDPVS_INVAL;
+    }
+
+    if (udest->fwdmode != DPVS_FWD_MODE_OVERLAY &&
+        udest->fwdmode != DPVS_FWD_MODE_FNAT) {
+        RTE_LOG(DEBUG, SERVICE, "%s: encapsulation needs OVERLAY or FNAT mode.\n",
+                __func__);
+        return EDPVS_NOTSUPP;
+    }
+
+    /* inner packet of FNAT-over-overlay is built by FNAT4/FNAT6 only */
+    if (udest->fwdmode == DPVS_FWD_MODE_FNAT && udest->af != svc->af) {
+        RTE_LOG(DEBUG, SERVICE, "%s: encapsulation not support NAT64.\n",
+                __func__);
+        return EDPVS_NOTSUPP;
+    }
+
+    /*
+     * replies are RSS-ed by outer headers, fdir can't match the inner
+     * lport either, so they land on any lcore and only conn redirect
+     * brings them to the lcore owning the conn.
+     */
+    if (udest->fwdmode == DPVS_FWD_MODE_FNAT && dp_vs_redirect_disable) {
+        RTE_LOG(WARNING, SERVICE, "%s: FNAT-over-overlay needs conn "
+                "redirect on.\n", __func__);
+        return EDPVS_NOTSUPP;
+    }
+
+    return EDPVS_OK;
+}
+
+void dp_vs_encap_build(struct dp_vs_encap *encap, int af,
+                       const union inet_addr *daddr,
+                       const struct dp_vs_dest_conf *udest)
+{
+    uint8_t *hdr = encap->tmpl;
+    struct udp_hdr *uh;
+    struct ether_hdr *eth;
+
+    memset(encap, 0, sizeof(*encap));
+
+    encap->type = udest->encap;
+    if (encap->type == DPVS_DEST_ENCAP_NONE)
+        return;
+
+    encap->vni = udest->vni;
+    if (inet_is_addr_any(af, &udest->vtep))
+        encap->vtep = *daddr;
+    else
+        encap->vtep = udest->vtep;
+
+    /* outer DF is not set, let oversized inner packets be fragmented */
+    if (af == AF_INET) {
+        struct ipv4_hdr *iph = (struct ipv4_hdr *)hdr;
+
+        iph->version_ihl = 0x45;
+        iph->time_to_live = INET_DEF_TTL;
+        iph->next_proto_id = IPPROTO_UDP;
+        iph->dst_addr = encap->vtep.in.s_addr;
+        encap->l3_len = sizeof(struct ipv4_hdr);
+    } else {
+        struct ip6_hdr *ip6h = (struct ip6_hdr *)hdr;
+
+        ip6h->ip6_flow = htonl(6 << 28);
+        ip6h->ip6_nxt = IPPROTO_UDP;
+        ip6h->ip6_hlim = INET_DEF_TTL;
+        ip6h->ip6_dst = encap->vtep.in6;
+        encap->l3_len = sizeof(struct ip6_hdr);
+    }
+
+    uh = (struct udp_hdr *)(hdr + encap->l3_len);
+
+    if (encap->type == DPVS_DEST_ENCAP_VXLAN) {
+        struct encap_vxlan_hdr *vxh = (struct encap_vxlan_hdr *)(uh + 1);
+
+        uh->dst_port = htons(DPVS_VXLAN_PORT);
+        vxh->flags = htonl(ENCAP_VXLAN_F_VNI);
+        vxh->vni = htonl(encap->vni << 8);
+        eth = (struct ether_hdr *)(vxh + 1);
+    } else {
+        struct encap_geneve_hdr *gnh = (struct encap_geneve_hdr *)(uh + 1);
+
+        uh->dst_port = htons(DPVS_GENEVE_PORT);
+        gnh->proto = htons(ETH_P_TEB);
+        gnh->vni = htonl(encap->vni << 8);
+        eth = (struct ether_hdr *)(gnh + 1);
+    }
+
+    /* inner source MAC and ether type are filled on xmit */
+    if (is_zero_ether_addr((const struct ether_addr *)udest->inner_dmac))
+        ether_addr_copy(&encap_bcast_mac, &eth->d_addr);
+    else
+        memcpy(&eth->d_addr, udest->inner_dmac, ETHER_ADDR_LEN);
+
+    encap->hlen = (uint8_t *)(eth + 1) - hdr;
+    assert(encap->hlen <= DPVS_ENCAP_TMPL_MAX);
+}
+
+/* inner flow entropy for underlay ECMP and VTEP's RSS */
+static inline uint16_t encap_sport(const struct dp_vs_conn *conn)
+{
+    uint32_t ports = ((uint32_t)conn->cport << 16) | conn->vport;
+    uint32_t hash;
+
+    if (conn->af == AF_INET)
+        hash = rte_jhash_3words(conn->caddr.in.s_addr, conn->vaddr.in.s_addr,
+                                ports, conn->proto);
+    else
+        hash = rte_jhash_32b((const uint32_t *)&conn->caddr.in6, 4, ports);
+
+    return htons(ENCAP_SPORT_MIN + ((hash ^ (hash >> 16)) & ENCAP_SPORT_MASK));
+}
+
+/*
+ * TX checksum offload flags of the inner packet (set by FNAT handlers)
+ * use inner header offsets, which are meaningless once outer headers are
+ * prepended. finish them in software, the offload path has seeded the
+ * pseudo header sum in the checksum field already.
+ */
+static int encap_inner_csum(struct rte_mbuf *mbuf, uint16_t inner_type)
+{
+    uint64_t l4_flag = mbuf->ol_flags & PKT_TX_L4_MASK;
+    uint16_t *csum;
+    void *l4h;
+
+    if (likely(!(mbuf->ol_flags & PKT_TX_IP_CKSUM) && !l4_flag))
+        return EDPVS_OK;
+
+    if (mbuf_may_pull(mbuf, mbuf->pkt_len) != 0)
+        return EDPVS_INVPKT;
+
+    if ((mbuf->ol_flags & PKT_TX_IP_CKSUM) && inner_type == ETHER_TYPE_IPv4)
+        ip4_send_csum(ip4_hdr(mbuf));
+
+    if (l4_flag == PKT_TX_TCP_CKSUM || l4_flag == PKT_TX_UDP_CKSUM) {
+        l4h = rte_pktmbuf_mtod_offset(mbuf, void *, mbuf->l3_len);
+        if (l4_flag == PKT_TX_TCP_CKSUM)
+            csum = l4h + offsetof(struct tcp_hdr, cksum);
+        else
+            csum = l4h + offsetof(struct udp_hdr, dgram_cksum);
+
+        *csum = (uint16_t)~rte_raw_cksum(l4h, mbuf->pkt_len - mbuf->l3_len);
+        if (l4_flag == PKT_TX_UDP_CKSUM && *csum == 0)
+            *csum = 0xffff;
+    }
+
+    mbuf->ol_flags &= ~(PKT_TX_IP_CKSUM | PKT_TX_L4_MASK |
+                        PKT_TX_IPV4 | PKT_TX_IPV6);
+    return EDPVS_OK;
+}
+
+int dp_vs_encap_xmit(struct dp_vs_conn *conn, struct rte_mbuf *mbuf)
+{
+    const struct dp_vs_encap *encap = &conn->dest->encap;
+    int af = conn->dest->af;
+    struct netif_port *dev;
+    struct udp_hdr *uh;
+    struct ether_hdr *eth;
+    uint16_t inner_type;
+    void *hdr;
+    int err;
+
+    assert(mbuf->userdata);
+
+    if ((*rte_pktmbuf_mtod(mbuf, uint8_t *) >> 4) == 6)
+        inner_type = ETHER_TYPE_IPv6;
+    else
+        inner_type = ETHER_TYPE_IPv4;
+
+    err = encap_inner_csum(mbuf, inner_type);
+    if (unlikely(err != EDPVS_OK))
+        goto errout;
+
+    hdr = rte_pktmbuf_prepend(mbuf, encap->hlen);
+    if (unlikely(!hdr)) {
+        RTE_LOG(WARNING, IPVS, "%s: mbuf has not enough headroom"
+                " space for overlay encapsulation\n", __func__);
+        err = EDPVS_NOROOM;
+        goto errout;
+    }
+    rte_memcpy(hdr, encap->tmpl, encap->hlen);
+
+    uh = hdr + encap->l3_len;
+    uh->src_port = encap_sport(conn);
+    uh->dgram_len = htons(mbuf->pkt_len - encap->l3_len);
+
+    eth = hdr + encap->hlen - sizeof(struct ether_hdr);
+    eth->ether_type = htons(inner_type);
+
+    if (af == AF_INET) {
+        struct route_entry *rt = mbuf->userdata;
+        struct ipv4_hdr *iph = hdr;
+
+        dev = rt->port;
+        ether_addr_copy(&dev->addr, &eth->s_addr);
+
+        iph->total_length = htons(mbuf->pkt_len);
+        iph->src_addr = rt->src.s_addr;
+        if (unlikely(iph->src_addr == htonl(INADDR_ANY))) {
+            union inet_addr saddr;
+
+            /* whole union is copied, not to select into the header */
+            inet_addr_select(AF_INET, dev, &encap->vtep, 0, &saddr);
+            iph->src_addr = saddr.in.s_addr;
+        }
+        iph->packet_id = ip4_select_id(iph);
+
+        /* zero UDP checksum is recommended for IPv4 VTEPs [RFC 7348] */
+        uh->dgram_cksum = 0;
+
+        if (dev->flag & NETIF_PORT_FLAG_TX_IP_CSUM_OFFLOAD) {
+            mbuf->l3_len = sizeof(struct ipv4_hdr);
+            mbuf->ol_flags |= (PKT_TX_IP_CKSUM | PKT_TX_IPV4);
+            iph->hdr_checksum = 0;
+        } else {
+            ip4_send_csum(iph);
+        }
+
+        return INET_HOOK(AF_INET, INET_HOOK_LOCAL_OUT, mbuf,
+                         NULL, dev, ipv4_output);
+    } else {
+        struct route6 *rt6 = mbuf->userdata;
+        struct ip6_hdr *ip6h = hdr;
+
+        dev = rt6->rt6_dev;
+        ether_addr_copy(&dev->addr, &eth->s_addr);
+
+        ip6h->ip6_plen = htons(mbuf->pkt_len - sizeof(struct ip6_hdr));
+        ip6h->ip6_src = rt6->rt6_src.addr;
+        if (unlikely(ipv6_addr_any(&ip6h->ip6_src)))
+            inet_addr_select(AF_INET6, dev, &encap->vtep, 0,
+                             (union inet_addr *)&ip6h->ip6_src);
+
+        /* UDP checksum is mandatory for IPv6 */
+        if (dev->flag & NETIF_PORT_FLAG_TX_UDP_CSUM_OFFLOAD) {
+            mbuf->l3_len = sizeof(struct ip6_hdr);
+            mbuf->l4_len = mbuf->pkt_len - sizeof(struct ip6_hdr);
+            mbuf->ol_flags |= (PKT_TX_UDP_CKSUM | PKT_TX_IPV6);
+            uh->dgram_cksum = ip6_phdr_cksum(ip6h, mbuf->ol_flags,
+                                             sizeof(struct ip6_hdr), IPPROTO_UDP);
+        } else {
+            if (mbuf_may_pull(mbuf, mbuf->pkt_len) != 0) {
+                err = EDPVS_INVPKT;
+                goto errout;
+            }
+            udp6_send_csum((struct ipv6_hdr *)ip6h, uh);
+        }
+
+        return INET_HOOK(AF_INET6, INET_HOOK_LOCAL_OUT, mbuf,
+                         NULL, dev, ip6_output);
+    }
+
+errout:
+    if (af == AF_INET)
+        route4_put((struct route_entry *)mbuf->userdata);
+    else
+        route6_put((struct route6 *)mbuf->userdata);
+    rte_pktmbuf_free(mbuf);
+    return err;
+}
+
+static inline uint32_t encap_vtep_hash(int af, const union inet_addr *addr,
+                                       uint32_t vni)
+{
+    if (af == AF_INET)
+        return rte_jhash_2words(addr->in.s_addr, vni, 0) & ENCAP_VTEP_TAB_MASK;
+
+    return rte_jhash_32b((const uint32_t *)&addr->in6, 4, vni)
+           & ENCAP_VTEP_TAB_MASK;
+}
+
+static struct encap_vtep *__encap_vtep_lookup(int af,
+                                              const union inet_addr *addr,
+                                              uint32_t vni)
+{
+    struct encap_vtep *vtep;
+    uint32_t hash = encap_vtep_hash(af, addr, vni);
+
+    list_for_each_entry(vtep, &encap_vtep_tab[hash], list) {
+        if (vtep->af == af && vtep->vni == vni &&
+            inet_addr_equal(af, &vtep->addr, addr))
+            return vtep;
+    }
+
+    return NULL;
+}
+
+static bool encap_vtep_known(int af, const union inet_addr *addr,
+                             uint32_t vni)
+{
+    bool known;
+
+    rte_rwlock_read_lock(&encap_vtep_lock);
+    known = (__encap_vtep_lookup(af, addr, vni) != NULL);
+    rte_rwlock_read_unlock(&encap_vtep_lock);
+
+    return known;
+}
+
+int dp_vs_encap_vtep_add(int af, const struct dp_vs_encap *encap)
+{
+    struct encap_vtep *vtep;
+    int err = EDPVS_OK;
+
+    if (encap->type == DPVS_DEST_ENCAP_NONE)
+        return EDPVS_OK;
+
+    rte_rwlock_write_lock(&encap_vtep_lock);
+
+    vtep = __encap_vtep_lookup(af, &encap->vtep, encap->vni);
+    if (vtep) {
+        vtep->refcnt++;
+        goto out;
+    }
+
+    vtep = rte_zmalloc("encap_vtep", sizeof(*vtep), 0);
+    if (!vtep) {
+        err = EDPVS_NOMEM;
+        goto out;
+    }
+
+    vtep->af = af;
+    vtep->vni = encap->vni;
+    vtep->addr = encap->vtep;
+    vtep->refcnt = 1;
+    list_add(&vtep->list,
+             &encap_vtep_tab[encap_vtep_hash(af, &vtep->addr, vtep->vni)]);
+
+out:
+    rte_rwlock_write_unlock(&encap_vtep_lock);
+    return err;
+}
+
+void dp_vs_encap_vtep_del(int af, const struct dp_vs_encap *encap)
+{
+    struct encap_vtep *vtep;
+
+    if (encap->type == DPVS_DEST_ENCAP_NONE)
+        return;
+
+    rte_rwlock_write_lock(&encap_vtep_lock);
+
+    vtep = __encap_vtep_lookup(af, &encap->vtep, encap->vni);
+    if (vtep && --vtep->refcnt == 0) {
+        list_del(&vtep->list);
+        rte_free(vtep);
+    }
+
+    rte_rwlock_write_unlock(&encap_vtep_lock);
+}
+
+/*
+ * decapsulate VXLAN/GENEVE packets sent to local address, e.g., the
+ * RS replies of FNAT-over-overlay, and re-inject the inner packet.
+ * packets not from (VTEP, VNI) of a configured overlay dest are dropped,
+ * non-overlay UDP traffic is left to KNI.
+ */
+static int encap_rcv(struct rte_mbuf *mbuf, int af,
+                     const union inet_addr *saddr)
+{
+    struct udp_hdr *uh;
+    struct ether_hdr *eth;
+    struct netif_port *dev;
+    uint16_t hlen, eth_type;
+    uint32_t vni;
+
+    if (!encap_decap)
+        return EDPVS_KNICONTINUE;
+
+    hlen = sizeof(struct udp_hdr) + sizeof(struct encap_vxlan_hdr);
+    if (mbuf_may_pull(mbuf, hlen + sizeof(struct ether_hdr)) != 0)
+        return EDPVS_KNICONTINUE;
+
+    uh = rte_pktmbuf_mtod(mbuf, struct udp_hdr *);
+
+    if (uh->dst_port == htons(DPVS_VXLAN_PORT)) {
+        struct encap_vxlan_hdr *vxh = (struct encap_vxlan_hdr *)(uh + 1);
+
+        if (unlikely(!(vxh->flags & htonl(ENCAP_VXLAN_F_VNI))))
+            goto drop;
+        vni = ntohl(vxh->vni) >> 8;
+    } else if (uh->dst_port == htons(DPVS_GENEVE_PORT)) {
+        struct encap_geneve_hdr *gnh = (struct encap_geneve_hdr *)(uh + 1);
+
+        if (unlikely((gnh->ver_optlen >> 6) != 0 ||
+                     gnh->proto != htons(ETH_P_TEB)))
+            goto drop;
+        vni = ntohl(gnh->vni) >> 8;
+
+        /* skip GENEVE options */
+        hlen += (gnh->ver_optlen & 0x3f) << 2;
+        if (mbuf_may_pull(mbuf, hlen + sizeof(struct ether_hdr)) != 0)
+            goto drop;
+    } else {
+        return EDPVS_KNICONTINUE;
+    }
+
+    /* never let spoofed inner packets in */
+    if (!encap_vtep_known(af, saddr, vni))
+        goto drop;
+
+    eth = rte_pktmbuf_mtod_offset(mbuf, struct ether_hdr *, hlen);
+    eth_type = eth->ether_type;
+    if (eth_type != htons(ETHER_TYPE_IPv4) && eth_type != htons(ETHER_TYPE_IPv6))
+        goto drop;
+
+    dev = netif_port_get(mbuf->port);
+    if (unlikely(!dev))
+        goto drop;
+
+    if (ip_tunnel_pull_header(mbuf, hlen + sizeof(struct ether_hdr),
+                              eth_type) != EDPVS_OK)
+        goto drop;
+
+    mbuf->userdata = NULL;
+    return netif_rcv(dev, eth_type, mbuf);
+
+drop:
+    rte_pktmbuf_free(mbuf);
+    return EDPVS_DROP;
+}
+
+static int encap_rcv4(struct rte_mbuf *mbuf)
+{
+    struct ipv4_hdr *iph = mbuf->userdata; /* see ipv4_local_in_fin */
+    union inet_addr saddr = { .in.s_addr = iph->src_addr };
+
+    return encap_rcv(mbuf, AF_INET, &saddr);
+}
+
+static int encap_rcv6(struct rte_mbuf *mbuf)
+{
+    struct ip6_hdr *ip6h = mbuf->userdata; /* see ip6_local_in_fin */
+    union inet_addr saddr = { .in6 = ip6h->ip6_src };
+
+    return encap_rcv(mbuf, AF_INET6, &saddr);
+}
+
+static struct inet_protocol encap_udp4_proto = {
+    .handler    = encap_rcv4,
+};
+
+static struct inet6_protocol encap_udp6_proto = {
+    .handler    = encap_rcv6,
+    .flags      = INET6_PROTO_F_FINAL,
+};
+
+int dp_vs_encap_init(void)
+{
+    int i, err;
+
+    for (i = 0; i < ENCAP_VTEP_TAB_SIZE; i++)
+        INIT_LIST_HEAD(&encap_vtep_tab[i]);
+    rte_rwlock_init(&encap_vtep_lock);
+
+    err = ipv4_register_protocol(&encap_udp4_proto, IPPROTO_UDP);
+    if (err != EDPVS_OK)
+        return err;
+
+    err = ipv6_register_protocol(&encap_udp6_proto, IPPROTO_UDP);
+    if (err != EDPVS_OK) {
+        ipv4_unregister_protocol(&encap_udp4_proto, IPPROTO_UDP);
+        return err;
+    }
+
+    return EDPVS_OK;
+}
+
+int dp_vs_encap_term(void)
+{
+    ipv6_unregister_protocol(&encap_udp6_proto, IPPROTO_UDP);
+    return ipv4_unregister_protocol(&encap_udp4_proto, IPPROTO_UDP);
+}
+
+static void overlay_decap_handler(vector_t tokens)
+{
+    RTE_LOG(INFO, IPVS, "overlay decapsulation ON\n");
+    encap_decap = true;
+}
+
+void encap_keyword_value_init(void)
+{
+    encap_decap = false;
+}
+
+void install_encap_keywords(void)
+{
+    install_keyword("overlay_decap", overlay_decap_handler, KW_TYPE_NORMAL);
+}
@@ -0,0 +1,1287 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * native health check of real servers.
+ *
+ * master owns the config and a target per checked dest. a target is
+ * handed to one worker lcore through a per-lcore ring, the worker then
+ * probes the dest with its own timer:
+ *
+ *  - TCP:  SYN, SYN-ACK is success, RST is refused. reset after that.
+ *  - HTTP: SYN, ACK with "GET <path>" on SYN-ACK, the status line of
+ *          the first data segment is checked. reset after that.
+ *  - UDP:  payload, any reply is success.
+ *
+ * it's stateless beyond the single probe in flight, no retransmission,
+ * a lost packet is a failure and absorbed by rise/fall counters.
+ *
+ * source LIP and port come from the worker's sa_pool, so that replies
+ * reach the same lcore. they are matched by an inet hook behind dp_vs_in
+ * which only sees packets no connection or service took.
+ *
+ * master periodically applies the up/down verdicts of workers to
+ * DPVS_DEST_F_AVAILABLE. a dest flapping too often is held down by
+ * route-flap-damping like penalty: each down adds a penalty decaying
+ * with a half-life, the dest is suppressed above a threshold and reused
+ * once the penalty decays below a lower one.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/ip6.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include "common.h"
+#include "dpdk.h"
+#include "list.h"
+#include "netif.h"
+#include "inet.h"
+#include "ipv4.h"
+#include "ipv6.h"
+#include "route.h"
+#include "route6.h"
+#include "sa_pool.h"
+#include "timer.h"
+#include "ctrl.h"
+#include "ipvs/ipvs.h"
+#include "ipvs/hc.h"
+
+#define RTE_LOGTYPE_HC              RTE_LOGTYPE_USER1
+
+#define DP_VS_HC_DEF_INTERVAL       2000    /* ms */
+#define DP_VS_HC_DEF_TIMEOUT        1000    /* ms */
+#define DP_VS_HC_DEF_RISE           2
+#define DP_VS_HC_DEF_FALL           3
+#define DP_VS_HC_MIN_INTERVAL       100     /* ms */
+
+#define DP_VS_HC_HASH_BITS          8
+#define DP_VS_HC_HASH_SIZE          (1 << DP_VS_HC_HASH_BITS)
+#define DP_VS_HC_HASH_MASK          (DP_VS_HC_HASH_SIZE - 1)
+
+#define DP_VS_HC_RING_SIZE          1024
+#define DP_VS_HC_RING_BURST         32
+#define DP_VS_HC_JOB_INTERVAL       100     /* loops */
+
+/* master applies verdicts every DP_VS_HC_APPLY_MS */
+#define DP_VS_HC_APPLY_MS           100
+
+/* flap damping, penalties are scaled by 2^DP_VS_HC_PENALTY_SHIFT */
+#define DP_VS_HC_PENALTY_SHIFT      10
+#define DP_VS_HC_PENALTY            (1000 << DP_VS_HC_PENALTY_SHIFT)
+#define DP_VS_HC_SUPPRESS           (2000 << DP_VS_HC_PENALTY_SHIFT)
+#define DP_VS_HC_REUSE              (750 << DP_VS_HC_PENALTY_SHIFT)
+#define DP_VS_HC_PENALTY_MAX        (8000 << DP_VS_HC_PENALTY_SHIFT)
+
+#define DP_VS_HC_MSS                1460
+#define DP_VS_HC_REQ_LEN            192
+
+/* commands on ring, tagged in lowest bit of target pointer */
+#define DP_VS_HC_CMD_ADD            0x0UL
+#define DP_VS_HC_CMD_DEL            0x1UL
+#define DP_VS_HC_CMD_MASK           0x1UL
+
+enum {
+    HC_STAGE_IDLE   = 0,
+    HC_STAGE_SYN_SENT,
+    HC_STAGE_REQ_SENT,
+    HC_STAGE_UDP_SENT,
+};
+
+/* health check config of a service, master only */
+struct dp_vs_hc {
+    struct list_head        list;       /* dp_vs_hc_list */
+    struct dp_vs_service    *svc;
+    struct dp_vs_hc_conf    conf;
+    struct list_head        targets;
+    uint32_t                ntargets;
+};
+
+struct dp_vs_hc_target {
+    /* master */
+    struct list_head        list;       /* dp_vs_hc.targets */
+    struct dp_vs_hc         *hc;
+    bool                    last_up;
+    bool                    suppressed;
+    bool                    avail;      /* applied to dest */
+    uint32_t                penalty;
+    uint32_t                flaps;
+    uint64_t                since;      /* TSC of last change of avail */
+
+    /* read-only after created */
+    struct dp_vs_dest       *dest;
+    struct dp_vs_hc_conf    conf;
+    lcoreid_t               cid;
+    int                     af;
+    uint8_t                 proto;
+    union inet_addr         daddr;
+    uint16_t                dport;
+    uint16_t                req_len;
+    char                    req[DP_VS_HC_REQ_LEN];
+
+    /* owner lcore */
+    struct list_head        hnode;      /* dp_vs_hc_lcore.hash */
+    struct dpvs_timer       timer;
+    bool                    hashed;
+    uint8_t                 stage;      /* HC_STAGE_XXX */
+    union inet_addr         laddr;
+    uint16_t                lport;
+    uint32_t                iss;
+    uint32_t                irs;
+    uint64_t                sent_tsc;
+    uint16_t                nsucc;      /* consecutive */
+    uint16_t                nfail;      /* consecutive */
+
+    /* owner lcore writes, master reads */
+    volatile bool           up;
+    volatile uint8_t        result;
+    volatile uint32_t       rtt_us;
+    volatile uint32_t       srtt_us;
+    volatile uint64_t       probes;
+    volatile uint64_t       succ;
+    volatile uint64_t       fail;
+} __rte_cache_aligned;
+
+struct dp_vs_hc_lcore {
+    struct rte_ring         *ring;      /* commands from master */
+    uint32_t                inflight;
+    struct list_head        hash[DP_VS_HC_HASH_SIZE];   /* by local port */
+} __rte_cache_aligned;
+
+static struct dp_vs_hc_lcore dp_vs_hc_lcores[DPVS_MAX_LCORE];
+static struct list_head dp_vs_hc_list;
+static struct dpvs_timer dp_vs_hc_timer;
+static struct netif_lcore_loop_job dp_vs_hc_job;
+static uint32_t dp_vs_hc_next_lcore;
+
+static inline uint32_t hc_hashkey(uint16_t lport)
+{
+    return (ntohs(lport) ^ (ntohs(lport) >> DP_VS_HC_HASH_BITS))
+            & DP_VS_HC_HASH_MASK;
+}
+
+static void hc_sockaddr(int af, const union inet_addr *addr, uint16_t port,
+                        struct sockaddr_storage *ss)
+{
+    memset(ss, 0, sizeof(*ss));
+    if (af == AF_INET) {
+        struct sockaddr_in *sin = (struct sockaddr_in *)ss;
+
+        sin->sin_family = AF_INET;
+        sin->sin_addr = addr->in;
+        sin->sin_port = port;
+    } else {
+        struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ss;
+
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_addr = addr->in6;
+        sin6->sin6_port = port;
+    }
+}
+
+static inline void hc_ms2tv(uint32_t ms, struct timeval *tv)
+{
+    tv->tv_sec = ms / 1000;
+    tv->tv_usec = (ms % 1000) * 1000;
+}
+
+/*
+ * worker side
+ */
+
+static int hc_probe_hash(struct dp_vs_hc_lcore *hl, struct dp_vs_hc_target *t)
+{
+    struct sockaddr_storage daddr, saddr;
+    union inet_addr any;
+    int err;
+
+    memset(&any, 0, sizeof(any));
+    hc_sockaddr(t->af, &t->daddr, t->dport, &daddr);
+    hc_sockaddr(t->af, t->conf.saf == t->af ? &t->conf.saddr : &any,
+                0, &saddr);
+
+    err = sa_fetch(t->af, NULL, &daddr, &saddr);
+    if (err != EDPVS_OK)
+        return err;
+
+    if (t->af == AF_INET) {
+        t->laddr.in = ((struct sockaddr_in *)&saddr)->sin_addr;
+        t->lport = ((struct sockaddr_in *)&saddr)->sin_port;
+    } else {
+        t->laddr.in6 = ((struct sockaddr_in6 *)&saddr)->sin6_addr;
+        t->lport = ((struct sockaddr_in6 *)&saddr)->sin6_port;
+    }
+
+    list_add(&t->hnode, &hl->hash[hc_hashkey(t->lport)]);
+    t->hashed = true;
+    hl->inflight++;
+
+    return EDPVS_OK;
+}
+
+static void hc_probe_unhash(struct dp_vs_hc_lcore *hl,
+                            struct dp_vs_hc_target *t)
+{
+    struct sockaddr_storage daddr, saddr;
+
+    if (!t->hashed)
+        return;
+
+    list_del(&t->hnode);
+    t->hashed = false;
+    hl->inflight--;
+
+    hc_sockaddr(t->af, &t->daddr, t->dport, &daddr);
+    hc_sockaddr(t->af, &t->laddr, t->lport, &saddr);
+    sa_release(NULL, &daddr, &saddr);
+}
+
+static struct dp_vs_hc_target *hc_probe_lookup(struct dp_vs_hc_lcore *hl,
+                                               int af, uint8_t proto,
+                                               const union inet_addr *laddr,
+                                               uint16_t lport,
+                                               const union inet_addr *raddr,
+                                               uint16_t rport)
+{
+    struct dp_vs_hc_target *t;
+
+    list_for_each_entry(t, &hl->hash[hc_hashkey(lport)], hnode) {
+        if (t->lport == lport && t->dport == rport && t->af == af
+                && t->proto == proto
+                && inet_addr_equal(af, &t->laddr, laddr)
+                && inet_addr_equal(af, &t->daddr, raddr))
+            return t;
+    }
+
+    return NULL;
+}
+
+static struct rte_mbuf *hc_mbuf_alloc(const struct dp_vs_hc_target *t)
+{
+    struct netif_port *dev;
+    struct rte_mbuf *mbuf;
+
+    if (t->af == AF_INET) {
+        struct route_entry *rt;
+        struct flow4 fl4;
+
+        memset(&fl4, 0, sizeof(fl4));
+        fl4.fl4_saddr = t->laddr.in;
+        fl4.fl4_daddr = t->daddr.in;
+        fl4.fl4_proto = t->proto;
+        rt = route4_output(&fl4);
+        if (!rt)
+            return NULL;
+        dev = rt->port;
+        route4_put(rt);
+    } else {
+        struct route6 *rt6;
+        struct flow6 fl6;
+
+        memset(&fl6, 0, sizeof(fl6));
+        fl6.fl6_saddr = t->laddr.in6;
+        fl6.fl6_daddr = t->daddr.in6;
+        fl6.fl6_proto = t->proto;
+        rt6 = route6_output(NULL, &fl6);
+        if (!rt6)
+            return NULL;
+        dev = rt6->rt6_dev;
+        route6_put(rt6);
+    }
+
+    mbuf = rte_pktmbuf_alloc(dev->mbuf_pool);
+    if (!mbuf)
+        return NULL;
+    mbuf->userdata = NULL;
+
+    return mbuf;
+}
+
+static uint16_t hc_l4_cksum(const struct dp_vs_hc_target *t,
+                            const void *l4, uint16_t len)
+{
+    if (t->af == AF_INET) {
+        struct ipv4_hdr iph;
+
+        memset(&iph, 0, sizeof(iph));
+        iph.version_ihl = 0x45;
+        iph.total_length = htons(sizeof(iph) + len);
+        iph.next_proto_id = t->proto;
+        iph.src_addr = t->laddr.in.s_addr;
+        iph.dst_addr = t->daddr.in.s_addr;
+        return rte_ipv4_udptcp_cksum(&iph, l4);
+    } else {
+        struct ipv6_hdr ip6h;
+
+        memset(&ip6h, 0, sizeof(ip6h));
+        ip6h.payload_len = htons(len);
+        ip6h.proto = t->proto;
+        memcpy(ip6h.src_addr, &t->laddr.in6, sizeof(ip6h.src_addr));
+        memcpy(ip6h.dst_addr, &t->daddr.in6, sizeof(ip6h.dst_addr));
+        return rte_ipv6_udptcp_cksum(&ip6h, l4);
+    }
+}
+
+static int hc_output(const struct dp_vs_hc_target *t, struct rte_mbuf *mbuf)
+{
+    if (t->af == AF_INET) {
+        struct flow4 fl4;
+
+        memset(&fl4, 0, sizeof(fl4));
+        fl4.fl4_saddr = t->laddr.in;
+        fl4.fl4_daddr = t->daddr.in;
+        fl4.fl4_proto = t->proto;
+        return ipv4_xmit(mbuf, &fl4);
+    } else {
+        struct flow6 fl6;
+
+        memset(&fl6, 0, sizeof(fl6));
+        fl6.fl6_saddr = t->laddr.in6;
+        fl6.fl6_daddr = t->daddr.in6;
+        fl6.fl6_proto = t->proto;
+        return ipv6_xmit(mbuf, &fl6);
+    }
+}
+
+/* @flags: TH_XXX */
+static int hc_send_tcp(const struct dp_vs_hc_target *t, uint8_t flags,
+                       uint32_t seq, uint32_t ack,
+                       const void *data, uint16_t dlen)
+{
+    struct rte_mbuf *mbuf;
+    struct tcphdr *th;
+    uint16_t hlen;
+    uint8_t *opt;
+
+    mbuf = hc_mbuf_alloc(t);
+    if (!mbuf)
+        return EDPVS_NOROUTE;
+
+    hlen = sizeof(*th) + ((flags & TH_SYN) ? TCPOLEN_MAXSEG : 0);
+    th = (struct tcphdr *)rte_pktmbuf_append(mbuf, hlen + dlen);
+    if (!th) {
+        rte_pktmbuf_free(mbuf);
+        return EDPVS_NOROOM;
+    }
+
+    memset(th, 0, hlen);
+    th->source = t->lport;
+    th->dest = t->dport;
+    th->seq = htonl(seq);
+    th->ack_seq = htonl(ack);
+    th->doff = hlen >> 2;
+    th->syn = !!(flags & TH_SYN);
+    th->ack = !!(flags & TH_ACK);
+    th->psh = !!(flags & TH_PUSH);
+    th->rst = !!(flags & TH_RST);
+    th->window = htons(UINT16_MAX);
+
+    if (flags & TH_SYN) {
+        opt = (uint8_t *)(th + 1);
+        opt[0] = TCPOPT_MAXSEG;
+        opt[1] = TCPOLEN_MAXSEG;
+        *(uint16_t *)&opt[2] = htons(DP_VS_HC_MSS);
+    }
+
+    if (dlen)
+        memcpy((uint8_t *)th + hlen, data, dlen);
+
+    th->check = hc_l4_cksum(t, th, hlen + dlen);
+
+    return hc_output(t, mbuf);
+}
+
+static int hc_send_udp(const struct dp_vs_hc_target *t)
+{
+    struct rte_mbuf *mbuf;
+    struct udphdr *uh;
+    uint16_t len;
+
+    mbuf = hc_mbuf_alloc(t);
+    if (!mbuf)
+        return EDPVS_NOROUTE;
+
+    len = sizeof(*uh) + t->conf.payload_len;
+    uh = (struct udphdr *)rte_pktmbuf_append(mbuf, len);
+    if (!uh) {
+        rte_pktmbuf_free(mbuf);
+        return EDPVS_NOROOM;
+    }
+
+    uh->source = t->lport;
+    uh->dest = t->dport;
+    uh->len = htons(len);
+    uh->check = 0;
+    memcpy(uh + 1, t->conf.payload, t->conf.payload_len);
+
+    uh->check = hc_l4_cksum(t, uh, len);
+    if (uh->check == 0)
+        uh->check = 0xffff;
+
+    return hc_output(t, mbuf);
+}
+
+/* reset the probe connection if the server has seen our SYN-ACK ack */
+static void hc_probe_reset(const struct dp_vs_hc_target *t)
+{
+    if (t->stage == HC_STAGE_REQ_SENT)
+        hc_send_tcp(t, TH_RST, t->iss + 1 + t->req_len, 0, NULL, 0);
+}
+
+static void hc_probe_done(struct dp_vs_hc_lcore *hl,
+                          struct dp_vs_hc_target *t, uint8_t result)
+{
+    uint32_t rtt;
+
+    hc_probe_unhash(hl, t);
+    t->stage = HC_STAGE_IDLE;
+    t->result = result;
+
+    if (result == DP_VS_HC_RES_OK) {
+        rtt = (rte_rdtsc() - t->sent_tsc) * 1000000 / rte_get_tsc_hz();
+        t->rtt_us = rtt;
+        t->srtt_us = t->srtt_us ? (t->srtt_us * 7 + rtt) / 8 : rtt;
+        t->succ++;
+
+        t->nfail = 0;
+        if (!t->up && ++t->nsucc >= t->conf.rise) {
+            t->up = true;
+            t->nsucc = 0;
+        }
+    } else {
+        t->fail++;
+
+        t->nsucc = 0;
+        if (t->up && ++t->nfail >= t->conf.fall) {
+            t->up = false;
+            t->nfail = 0;
+        }
+    }
+}
+
+/* keep probes @interval apart, however long the last one took */
+static void hc_next_probe(const struct dp_vs_hc_target *t, struct timeval *tv)
+{
+    uint64_t elapsed;
+
+    elapsed = (rte_rdtsc() - t->sent_tsc) * 1000 / rte_get_tsc_hz();
+    if (elapsed >= t->conf.interval)
+        elapsed = t->conf.interval - 1;
+
+    hc_ms2tv(t->conf.interval - elapsed, tv);
+}
+
+static void hc_probe_send(struct dp_vs_hc_lcore *hl, struct dp_vs_hc_target *t)
+{
+    int err;
+
+    t->probes++;
+    t->sent_tsc = rte_rdtsc();
+
+    err = hc_probe_hash(hl, t);
+    if (err != EDPVS_OK) {
+        hc_probe_done(hl, t, DP_VS_HC_RES_NO_SOURCE);
+        return;
+    }
+
+    if (t->conf.type == DP_VS_HC_UDP) {
+        t->stage = HC_STAGE_UDP_SENT;
+        err = hc_send_udp(t);
+    } else {
+        t->stage = HC_STAGE_SYN_SENT;
+        t->iss = (uint32_t)random();
+        err = hc_send_tcp(t, TH_SYN, t->iss, 0, NULL, 0);
+    }
+
+    if (err != EDPVS_OK)
+        hc_probe_done(hl, t, DP_VS_HC_RES_NO_ROUTE);
+}
+
+static int hc_timer_expire(void *arg)
+{
+    struct dp_vs_hc_target *t = arg;
+    struct dp_vs_hc_lcore *hl = &dp_vs_hc_lcores[rte_lcore_id()];
+    struct timeval tv;
+
+    if (t->stage != HC_STAGE_IDLE) {
+        /* no (complete) reply in time */
+        hc_probe_reset(t);
+        hc_probe_done(hl, t, DP_VS_HC_RES_TIMEOUT);
+        hc_next_probe(t, &tv);
+    } else {
+        hc_probe_send(hl, t);
+        if (t->stage != HC_STAGE_IDLE)
+            hc_ms2tv(t->conf.timeout, &tv);
+        else
+            hc_next_probe(t, &tv);
+    }
+
+    dpvs_timer_sched_nolock(&t->timer, &tv, hc_timer_expire, t, false);
+    return DTIMER_OK;
+}
+
+static int hc_http_status(const uint8_t *data, uint16_t len)
+{
+    /* "HTTP/1.x NNN " */
+    if (len < 12 || memcmp(data, "HTTP/1.", 7) != 0 || data[8] != ' ')
+        return -1;
+
+    if (!isdigit(data[9]) || !isdigit(data[10]) || !isdigit(data[11]))
+        return -1;
+
+    return (data[9] - '0') * 100 + (data[10] - '0') * 10 + (data[11] - '0');
+}
+
+static bool hc_http_status_ok(const struct dp_vs_hc_target *t, int status)
+{
+    if (t->conf.http_status)
+        return status == t->conf.http_status;
+
+    return status >= 200 && status < 400;
+}
+
+/* returns true if the probe is done */
+static bool hc_rcv_tcp(struct dp_vs_hc_lcore *hl, struct dp_vs_hc_target *t,
+                       const struct tcphdr *th, const uint8_t *data,
+                       uint16_t dlen)
+{
+    uint32_t seq = ntohl(th->seq);
+    uint32_t ack = ntohl(th->ack_seq);
+    int status;
+
+    switch (t->stage) {
+    case HC_STAGE_SYN_SENT:
+        if (th->rst) {
+            if (th->ack && ack == t->iss + 1) {
+                hc_probe_done(hl, t, DP_VS_HC_RES_REFUSED);
+                return true;
+            }
+            return false;
+        }
+
+        if (!th->syn || !th->ack || ack != t->iss + 1)
+            return false;
+
+        t->irs = seq;
+        if (t->conf.type == DP_VS_HC_TCP) {
+            hc_send_tcp(t, TH_RST, t->iss + 1, 0, NULL, 0);
+            hc_probe_done(hl, t, DP_VS_HC_RES_OK);
+            return true;
+        }
+
+        t->stage = HC_STAGE_REQ_SENT;
+        if (hc_send_tcp(t, TH_ACK | TH_PUSH, t->iss + 1, t->irs + 1,
+                        t->req, t->req_len) != EDPVS_OK) {
+            hc_probe_done(hl, t, DP_VS_HC_RES_NO_ROUTE);
+            return true;
+        }
+        return false;
+
+    case HC_STAGE_REQ_SENT:
+        if (th->rst) {
+            hc_probe_done(hl, t, DP_VS_HC_RES_REFUSED);
+            return true;
+        }
+
+        /* only the first segment of response, with status line */
+        if (seq != t->irs + 1 || !dlen)
+            return false;
+
+        status = hc_http_status(data, dlen);
+        hc_probe_reset(t);
+        hc_probe_done(hl, t, hc_http_status_ok(t, status) ?
+                      DP_VS_HC_RES_OK : DP_VS_HC_RES_BAD_STATUS);
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+static int __dp_vs_hc_in(struct rte_mbuf *mbuf, int af)
+{
+    struct dp_vs_hc_lcore *hl = &dp_vs_hc_lcores[rte_lcore_id()];
+    struct dp_vs_hc_target *t;
+    union inet_addr saddr, daddr;
+    const struct tcphdr *th;
+    const uint16_t *ports;
+    struct timeval tv;
+    int l4off, len;
+    uint8_t proto;
+    bool done;
+
+    if (likely(!hl->inflight))
+        return INET_ACCEPT;
+
+    if (af == AF_INET) {
+        struct ipv4_hdr *iph = ip4_hdr(mbuf);
+
+        if (ip4_is_frag(iph))
+            return INET_ACCEPT;
+
+        proto = iph->next_proto_id;
+        saddr.in.s_addr = iph->src_addr;
+        daddr.in.s_addr = iph->dst_addr;
+        l4off = ip4_hdrlen(mbuf);
+        len = ntohs(iph->total_length);
+    } else {
+        struct ip6_hdr *ip6h = ip6_hdr(mbuf);
+
+        saddr.in6 = ip6h->ip6_src;
+        daddr.in6 = ip6h->ip6_dst;
+        len = ntohs(ip6h->ip6_plen) + sizeof(*ip6h);
+        proto = ip6h->ip6_nxt;
+        l4off = ip6_skip_exthdr(mbuf, sizeof(*ip6h), &proto);
+        if (l4off < 0)
+            return INET_ACCEPT;
+    }
+
+    if (proto != IPPROTO_TCP && proto != IPPROTO_UDP)
+        return INET_ACCEPT;
+
+    if (mbuf_may_pull(mbuf, l4off + sizeof(uint16_t) * 2) != 0)
+        return INET_ACCEPT;
+
+    ports = rte_pktmbuf_mtod_offset(mbuf, const uint16_t *, l4off);
+    t = hc_probe_lookup(hl, af, proto, &daddr, ports[1], &saddr, ports[0]);
+    if (!t)
+        return INET_ACCEPT;
+
+    if (proto == IPPROTO_UDP) {
+        done = (t->stage == HC_STAGE_UDP_SENT);
+        if (done)
+            hc_probe_done(hl, t, DP_VS_HC_RES_OK);
+    } else {
+        if (len > mbuf->pkt_len || mbuf_may_pull(mbuf, len) != 0)
+            goto out;
+
+        th = rte_pktmbuf_mtod_offset(mbuf, const struct tcphdr *, l4off);
+        if (len < l4off + (th->doff << 2))
+            goto out;
+
+        done = hc_rcv_tcp(hl, t, th, (const uint8_t *)th + (th->doff << 2),
+                          len - l4off - (th->doff << 2));
+    }
+
+    if (done) {
+        hc_next_probe(t, &tv);
+        dpvs_timer_update(&t->timer, &tv, false);
+    }
+
+out:
+    rte_pktmbuf_free(mbuf);
+    return INET_STOLEN;
+}
+
+static int dp_vs_hc_in(void *priv, struct rte_mbuf *mbuf,
+                       const struct inet_hook_state *state)
+{
+    return __dp_vs_hc_in(mbuf, AF_INET);
+}
+
+static int dp_vs_hc_in6(void *priv, struct rte_mbuf *mbuf,
+                        const struct inet_hook_state *state)
+{
+    return __dp_vs_hc_in(mbuf, AF_INET6);
+}
+
+static void hc_target_start(struct dp_vs_hc_target *t)
+{
+    struct timeval tv;
+
+    /* spread the first probes over an interval */
+    memset(&tv, 0, sizeof(tv));
+    dpvs_time_rand_delay(&tv, t->conf.interval * 1000);
+
+    dpvs_timer_sched(&t->timer, &tv, hc_timer_expire, t, false);
+}
+
+static void hc_target_stop(struct dp_vs_hc_lcore *hl,
+                           struct dp_vs_hc_target *t)
+{
+    dpvs_timer_cancel(&t->timer, false);
+
+    if (t->stage != HC_STAGE_IDLE) {
+        hc_probe_reset(t);
+        hc_probe_unhash(hl, t);
+    }
+
+    rte_atomic32_dec(&t->dest->refcnt);
+    rte_free(t);
+}
+
+static void hc_process_ring(void *arg)
+{
+    struct dp_vs_hc_lcore *hl = &dp_vs_hc_lcores[rte_lcore_id()];
+    void *cmds[DP_VS_HC_RING_BURST];
+    struct dp_vs_hc_target *t;
+    unsigned i, n;
+
+    if (unlikely(!hl->ring))
+        return;
+
+    n = rte_ring_sc_dequeue_burst(hl->ring, cmds, NELEMS(cmds), NULL);
+    for (i = 0; i < n; i++) {
+        t = (void *)((uintptr_t)cmds[i] & ~DP_VS_HC_CMD_MASK);
+
+        if (((uintptr_t)cmds[i] & DP_VS_HC_CMD_MASK) == DP_VS_HC_CMD_ADD)
+            hc_target_start(t);
+        else
+            hc_target_stop(hl, t);
+    }
+}
+
+/*
+ * master side
+ */
+
+static void hc_cmd_send(struct dp_vs_hc_target *t, uintptr_t cmd)
+{
+    struct rte_ring *ring = dp_vs_hc_lcores[t->cid].ring;
+
+    DPVS_WAIT_WHILE(rte_ring_sp_enqueue(ring, (void *)((uintptr_t)t | cmd)));
+    netif_lcore_wakeup(t->cid);
+}
+
+static lcoreid_t hc_select_lcore(void)
+{
+    uint8_t nlcore, k;
+    uint64_t mask;
+    lcoreid_t cid;
+
+    netif_get_slave_lcores(&nlcore, &mask);
+    if (!nlcore)
+        return DPVS_MAX_LCORE;
+
+    k = dp_vs_hc_next_lcore++ % nlcore;
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        if (!(mask & (1UL << cid)))
+            continue;
+        if (!k--)
+            return cid;
+    }
+
+    return DPVS_MAX_LCORE;
+}
+
+static void hc_build_req(struct dp_vs_hc_target *t)
+{
+    char addr[64], host[80];
+    int len;
+
+    if (!inet_ntop(t->af, &t->daddr, addr, sizeof(addr)))
+        addr[0] = '\0';
+
+    if (t->af == AF_INET6)
+        snprintf(host, sizeof(host), "[%s]", addr);
+    else
+        snprintf(host, sizeof(host), "%s", addr);
+
+    if (ntohs(t->dport) != 80) {
+        len = strlen(host);
+        snprintf(host + len, sizeof(host) - len, ":%u", ntohs(t->dport));
+    }
+
+    len = snprintf(t->req, sizeof(t->req),
+                   "GET %s HTTP/1.0\r\nHost: %s\r\nUser-Agent: dpvs\r\n"
+                   "Connection: close\r\n\r\n",
+                   t->conf.path[0] ? t->conf.path : "/", host);
+    t->req_len = RTE_MIN(len, (int)sizeof(t->req) - 1);
+}
+
+static int hc_target_add(struct dp_vs_hc *hc, struct dp_vs_dest *dest)
+{
+    struct dp_vs_hc_target *t;
+    lcoreid_t cid;
+
+    if (hc->conf.saf != AF_UNSPEC && hc->conf.saf != dest->af)
+        return EDPVS_NOTSUPP;
+
+    cid = hc_select_lcore();
+    if (cid >= DPVS_MAX_LCORE || !dp_vs_hc_lcores[cid].ring)
+        return EDPVS_NOTSUPP;
+
+    t = rte_zmalloc_socket("hc_target", sizeof(*t), RTE_CACHE_LINE_SIZE,
+                           rte_lcore_to_socket_id(cid));
+    if (!t)
+        return EDPVS_NOMEM;
+
+    t->hc = hc;
+    t->last_up = true;
+    t->avail = true;
+    t->since = rte_get_timer_cycles();
+
+    t->dest = dest;
+    t->conf = hc->conf;
+    t->cid = cid;
+    t->af = dest->af;
+    t->proto = hc->conf.type == DP_VS_HC_UDP ? IPPROTO_UDP : IPPROTO_TCP;
+    t->daddr = dest->addr;
+    t->dport = hc->conf.port ? htons(hc->conf.port) : dest->port;
+    if (hc->conf.type == DP_VS_HC_HTTP)
+        hc_build_req(t);
+
+    t->up = true;
+
+    rte_atomic32_inc(&dest->refcnt);
+    dest->hc = t;
+    list_add_tail(&t->list, &hc->targets);
+    hc->ntargets++;
+
+    hc_cmd_send(t, DP_VS_HC_CMD_ADD);
+    return EDPVS_OK;
+}
+
+/* owner lcore frees the target, don't touch it after this */
+static void hc_target_del(struct dp_vs_hc_target *t, bool restore)
+{
+    struct dp_vs_dest *dest = t->dest;
+
+    list_del(&t->list);
+    t->hc->ntargets--;
+    dest->hc = NULL;
+
+    /* hand the dest back if we hold it down */
+    if (restore && !t->avail) {
+        dest->flags |= DPVS_DEST_F_AVAILABLE;
+        if (dest->svc)
+            rte_atomic32_inc(&dest->svc->lc_gen);
+    }
+
+    hc_cmd_send(t, DP_VS_HC_CMD_DEL);
+}
+
+static void hc_del(struct dp_vs_hc *hc)
+{
+    struct dp_vs_hc_target *t, *next;
+
+    list_for_each_entry_safe(t, next, &hc->targets, list)
+        hc_target_del(t, true);
+
+    hc->svc->hc = NULL;
+    list_del(&hc->list);
+    rte_free(hc);
+}
+
+static int hc_conf_check(struct dp_vs_hc_conf *conf)
+{
+    if (conf->type < DP_VS_HC_TCP || conf->type > DP_VS_HC_UDP)
+        return EDPVS_INVAL;
+
+    if (conf->saf != AF_UNSPEC && conf->saf != AF_INET
+            && conf->saf != AF_INET6)
+        return EDPVS_INVAL;
+
+    if (!conf->interval)
+        conf->interval = DP_VS_HC_DEF_INTERVAL;
+    if (!conf->timeout)
+        conf->timeout = RTE_MIN(DP_VS_HC_DEF_TIMEOUT, conf->interval / 2);
+    if (!conf->rise)
+        conf->rise = DP_VS_HC_DEF_RISE;
+    if (!conf->fall)
+        conf->fall = DP_VS_HC_DEF_FALL;
+
+    if (conf->interval < DP_VS_HC_MIN_INTERVAL
+            || conf->timeout >= conf->interval)
+        return EDPVS_INVAL;
+
+    if (conf->payload_len > DP_VS_HC_PAYLOAD_LEN)
+        return EDPVS_INVAL;
+
+    conf->path[DP_VS_HC_PATH_LEN - 1] = '\0';
+    if (conf->type == DP_VS_HC_HTTP && conf->path[0] && conf->path[0] != '/')
+        return EDPVS_INVAL;
+
+    return EDPVS_OK;
+}
+
+static int hc_add(struct dp_vs_service *svc, const struct dp_vs_hc_conf *uconf)
+{
+    struct dp_vs_hc_conf conf = *uconf;
+    struct dp_vs_dest *dest;
+    struct dp_vs_hc *hc;
+    int err;
+
+    err = hc_conf_check(&conf);
+    if (err != EDPVS_OK)
+        return err;
+
+    /* replace the old one */
+    if (svc->hc)
+        hc_del(svc->hc);
+
+    hc = rte_zmalloc("dp_vs_hc", sizeof(*hc), RTE_CACHE_LINE_SIZE);
+    if (!hc)
+        return EDPVS_NOMEM;
+
+    hc->svc = svc;
+    hc->conf = conf;
+    INIT_LIST_HEAD(&hc->targets);
+    list_add_tail(&hc->list, &dp_vs_hc_list);
+    svc->hc = hc;
+
+    list_for_each_entry(dest, &svc->dests, n_list) {
+        err = hc_target_add(hc, dest);
+        if (err == EDPVS_NOTSUPP)
+            continue;
+        if (err != EDPVS_OK) {
+            hc_del(hc);
+            return err;
+        }
+    }
+
+    return EDPVS_OK;
+}
+
+void dp_vs_hc_dest_add(struct dp_vs_service *svc, struct dp_vs_dest *dest)
+{
+    int err;
+
+    if (!svc->hc || dest->hc)
+        return;
+
+    err = hc_target_add(svc->hc, dest);
+    if (err != EDPVS_OK && err != EDPVS_NOTSUPP)
+        RTE_LOG(WARNING, HC, "%s: fail to check new dest: %s\n",
+                __func__, dpvs_strerror(err));
+}
+
+void dp_vs_hc_dest_del(struct dp_vs_dest *dest)
+{
+    if (dest->hc)
+        hc_target_del(dest->hc, false);
+}
+
+void dp_vs_hc_flush(struct dp_vs_service *svc)
+{
+    if (svc->hc)
+        hc_del(svc->hc);
+}
+
+bool dp_vs_hc_dest_down(const struct dp_vs_dest *dest)
+{
+    return dest->hc && !dest->hc->avail;
+}
+
+static void hc_target_apply(struct dp_vs_hc_target *t)
+{
+    uint32_t halflife = t->conf.damp_halflife;
+    struct dp_vs_dest *dest = t->dest;
+    bool up = t->up, avail;
+    uint64_t decay;
+    char dbuf[64];
+
+    /* exponential decay, ln2 / halflife per tick */
+    if (t->penalty && halflife) {
+        decay = (uint64_t)t->penalty * 693 * DP_VS_HC_APPLY_MS
+                / ((uint64_t)halflife * 1000 * 1000);
+        t->penalty -= RTE_MIN(RTE_MAX(decay, 1UL), (uint64_t)t->penalty);
+    }
+
+    if (up != t->last_up) {
+        t->last_up = up;
+        if (!up) {
+            t->flaps++;
+            if (halflife)
+                t->penalty = RTE_MIN(t->penalty + DP_VS_HC_PENALTY,
+                                     (uint32_t)DP_VS_HC_PENALTY_MAX);
+        }
+    }
+
+    if (t->penalty >= DP_VS_HC_SUPPRESS)
+        t->suppressed = true;
+    else if (t->penalty < DP_VS_HC_REUSE)
+        t->suppressed = false;
+
+    avail = up && !t->suppressed;
+    if (avail == t->avail)
+        return;
+
+    t->avail = avail;
+    t->since = rte_get_timer_cycles();
+
+    if (avail)
+        dest->flags |= DPVS_DEST_F_AVAILABLE;
+    else
+        dest->flags &= ~DPVS_DEST_F_AVAILABLE;
+
+    /* let schedulers see it */
+    if (dest->svc)
+        rte_atomic32_inc(&dest->svc->lc_gen);
+
+    RTE_LOG(INFO, HC, "dest %s:%u %s%s\n",
+            inet_ntop(t->af, &t->daddr, dbuf, sizeof(dbuf)) ? dbuf : "::",
+            ntohs(t->dport), avail ? "up" : "down",
+            up && !avail ? " (suppressed)" : "");
+}
+
+static int hc_apply(void *arg)
+{
+    struct dp_vs_hc_target *t;
+    struct dp_vs_hc *hc;
+
+    list_for_each_entry(hc, &dp_vs_hc_list, list) {
+        list_for_each_entry(t, &hc->targets, list)
+            hc_target_apply(t);
+    }
+
+    return DTIMER_OK;
+}
+
+/*
+ * control plane
+ */
+
+static struct dp_vs_service *hc_svc_lookup(const struct dp_vs_hc_conf *conf)
+{
+    return dp_vs_service_lookup(conf->af, conf->proto, &conf->vaddr,
+                                conf->vport, conf->fwmark, NULL, NULL, NULL);
+}
+
+static int hc_sockopt_set(sockoptid_t opt, const void *conf, size_t size)
+{
+    const struct dp_vs_hc_conf *hc_conf = conf;
+    struct dp_vs_service *svc;
+    int err;
+
+    if (!conf || size < sizeof(*hc_conf))
+        return EDPVS_INVAL;
+
+    svc = hc_svc_lookup(hc_conf);
+    if (!svc)
+        return EDPVS_NOSERV;
+
+    switch (opt) {
+    case SOCKOPT_SET_HC_ADD:
+        err = hc_add(svc, hc_conf);
+        break;
+    case SOCKOPT_SET_HC_DEL:
+        if (svc->hc) {
+            hc_del(svc->hc);
+            err = EDPVS_OK;
+        } else {
+            err = EDPVS_NOTEXIST;
+        }
+        break;
+    default:
+        err = EDPVS_NOTSUPP;
+        break;
+    }
+
+    dp_vs_service_put(svc);
+    return err;
+}
+
+static void hc_fill_entry(struct dp_vs_hc_entry *ent,
+                          const struct dp_vs_hc_target *t)
+{
+    const struct dp_vs_service *svc = t->hc->svc;
+
+    memset(ent, 0, sizeof(*ent));
+    ent->af = svc->af;
+    ent->proto = svc->proto;
+    ent->vaddr = svc->addr;
+    ent->vport = svc->port;
+    ent->fwmark = svc->fwmark;
+
+    ent->daf = t->af;
+    ent->daddr = t->daddr;
+    ent->dport = t->dport;
+
+    ent->type = t->conf.type;
+    if (t->avail)
+        ent->state = DP_VS_HC_ST_UP;
+    else if (t->last_up)
+        ent->state = DP_VS_HC_ST_SUPPRESSED;
+    else
+        ent->state = DP_VS_HC_ST_DOWN;
+    ent->result = t->result;
+    ent->cid = t->cid;
+    ent->rtt_us = t->rtt_us;
+    ent->srtt_us = t->srtt_us;
+    ent->penalty = t->penalty >> DP_VS_HC_PENALTY_SHIFT;
+    ent->flaps = t->flaps;
+    ent->probes = t->probes;
+    ent->succ = t->succ;
+    ent->fail = t->fail;
+    ent->since = (rte_get_timer_cycles() - t->since) / rte_get_timer_hz();
+}
+
+static int hc_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
+                          void **out, size_t *outsize)
+{
+    const struct dp_vs_hc_conf *hc_conf = conf;
+    struct dp_vs_service *svc = NULL;
+    struct dp_vs_hc_entry_array *array;
+    struct dp_vs_hc_target *t;
+    struct dp_vs_hc *hc;
+    int n = 0;
+
+    if (opt != SOCKOPT_GET_HC_SHOW)
+        return EDPVS_NOTSUPP;
+
+    /* all services if not specified */
+    if (conf && size >= sizeof(*hc_conf) && hc_conf->af != AF_UNSPEC) {
+        svc = hc_svc_lookup(hc_conf);
+        if (!svc)
+            return EDPVS_NOSERV;
+    }
+
+    list_for_each_entry(hc, &dp_vs_hc_list, list) {
+        if (!svc || hc->svc == svc)
+            n += hc->ntargets;
+    }
+
+    *outsize = sizeof(*array) + n * sizeof(struct dp_vs_hc_entry);
+    *out = rte_malloc_socket(0, *outsize, RTE_CACHE_LINE_SIZE, rte_socket_id());
+    if (!*out) {
+        if (svc)
+            dp_vs_service_put(svc);
+        return EDPVS_NOMEM;
+    }
+
+    array = *out;
+    array->nentry = 0;
+    list_for_each_entry(hc, &dp_vs_hc_list, list) {
+        if (svc && hc->svc != svc)
+            continue;
+        list_for_each_entry(t, &hc->targets, list)
+            hc_fill_entry(&array->entries[array->nentry++], t);
+    }
+
+    if (svc)
+        dp_vs_service_put(svc);
+    return EDPVS_OK;
+}
+
+static struct dpvs_sockopts hc_sockopts = {
+    .version            = SOCKOPT_VERSION,
+    .set_opt_min        = SOCKOPT_SET_HC_ADD,
+    .set_opt_max        = SOCKOPT_SET_HC_DEL,
+    .set                = hc_sockopt_set,
+    .get_opt_min        = SOCKOPT_GET_HC_SHOW,
+    .get_opt_max        = SOCKOPT_GET_HC_SHOW,
+    .get                = hc_sockopt_get,
+};
+
+/* behind dp_vs_in, sees only what ipvs doesn't take */
+static struct inet_hook_ops dp_vs_hc_ops[] = {
+    {
+        .af         = AF_INET,
+        .hook       = dp_vs_hc_in,
+        .hooknum    = INET_HOOK_PRE_ROUTING,
+        .priority   = 101,
+    },
+    {
+        .af         = AF_INET6,
+        .hook       = dp_vs_hc_in6,
+        .hooknum    = INET_HOOK_PRE_ROUTING,
+        .priority   = 101,
+    },
+};
+
+int dp_vs_hc_init(void)
+{
+    char name[RTE_RING_NAMESIZE];
+    struct timeval tv;
+    lcoreid_t cid;
+    int i, err;
+
+    INIT_LIST_HEAD(&dp_vs_hc_list);
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        for (i = 0; i < DP_VS_HC_HASH_SIZE; i++)
+            INIT_LIST_HEAD(&dp_vs_hc_lcores[cid].hash[i]);
+    }
+
+    RTE_LCORE_FOREACH_SLAVE(cid) {
+        snprintf(name, sizeof(name), "dp_vs_hc_c%d", cid);
+        dp_vs_hc_lcores[cid].ring = rte_ring_create(name, DP_VS_HC_RING_SIZE,
+                        rte_lcore_to_socket_id(cid),
+                        RING_F_SP_ENQ | RING_F_SC_DEQ);
+        if (!dp_vs_hc_lcores[cid].ring) {
+            err = EDPVS_NOMEM;
+            goto err_ring;
+        }
+    }
+
+    snprintf(dp_vs_hc_job.name, sizeof(dp_vs_hc_job.name) - 1, "%s", "hc_ring");
+    dp_vs_hc_job.func = hc_process_ring;
+    dp_vs_hc_job.data = NULL;
+    dp_vs_hc_job.type = NETIF_LCORE_JOB_SLOW;
+    dp_vs_hc_job.skip_loops = DP_VS_HC_JOB_INTERVAL;
+    err = netif_lcore_loop_job_register(&dp_vs_hc_job);
+    if (err != EDPVS_OK)
+        goto err_ring;
+
+    err = inet_register_hooks(dp_vs_hc_ops, NELEMS(dp_vs_hc_ops));
+    if (err != EDPVS_OK)
+        goto err_hooks;
+
+    err = sockopt_register(&hc_sockopts);
+    if (err != EDPVS_OK)
+        goto err_sockopt;
+
+    hc_ms2tv(DP_VS_HC_APPLY_MS, &tv);
+    err = dpvs_timer_sched_period(&dp_vs_hc_timer, &tv, hc_apply, NULL, true);
+    if (err != EDPVS_OK)
+        goto err_timer;
+
+    return EDPVS_OK;
+
+err_timer:
+    sockopt_unregister(&hc_sockopts);
+err_sockopt:
+    inet_unregister_hooks(dp_vs_hc_ops, NELEMS(dp_vs_hc_ops));
+err_hooks:
+    netif_lcore_loop_job_unregister(&dp_vs_hc_job);
+err_ring:
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        if (dp_vs_hc_lcores[cid].ring) {
+            rte_ring_free(dp_vs_hc_lcores[cid].ring);
+            dp_vs_hc_lcores[cid].ring = NULL;
+        }
+    }
+    return err;
+}
+
+int dp_vs_hc_term(void)
+{
+    struct dp_vs_hc_target *t, *tnext;
+    struct dp_vs_hc *hc, *next;
+
+    dpvs_timer_cancel(&dp_vs_hc_timer, true);
+    sockopt_unregister(&hc_sockopts);
+    inet_unregister_hooks(dp_vs_hc_ops, NELEMS(dp_vs_hc_ops));
+    netif_lcore_loop_job_unregister(&dp_vs_hc_job);
+
+    /* lcores are stopped, targets left to them are not freed */
+    list_for_each_entry_safe(hc, next, &dp_vs_hc_list, list) {
+        list_for_each_entry_safe(t, tnext, &hc->targets, list) {
+            list_del(&t->list);
+            t->dest->hc = NULL;
+        }
+        hc->svc->hc = NULL;
+        list_del(&hc->list);
+        rte_free(hc);
+    }
+
+    return EDPVS_OK;
+}
@@ -255,6 +255,74 @@ int dp_vs_laddr_bind(struct dp_vs_conn *conn, struct dp_vs_service *svc)
     return EDPVS_OK;
 }
 
+/*
+ * take back the <lip:lport> a restored conn (warm restart) was using,
+ * conn->laddr/lport and its out-tuple are already filled.
+ */
+int dp_vs_laddr_rebind(struct dp_vs_conn *conn, struct dp_vs_service *svc)
+{
+    struct dp_vs_laddr *laddr = NULL, *curr;
+    struct sockaddr_storage dsin, ssin;
+    int af, err;
+
+    if (!conn || !conn->dest || !svc)
+        return EDPVS_INVAL;
+    if (svc->proto != IPPROTO_TCP && svc->proto != IPPROTO_UDP)
+        return EDPVS_NOTSUPP;
+    if (conn->flags & DPVS_CONN_F_TEMPLATE)
+        return EDPVS_OK;
+
+    af = tuplehash_out(conn).af;
+
+    rte_rwlock_read_lock(&svc->laddr_lock);
+    list_for_each_entry(curr, &svc->laddr_list, list) {
+        if (curr->af == af && inet_addr_equal(af, &curr->addr, &conn->laddr)) {
+            rte_atomic32_inc(&curr->refcnt);
+            laddr = curr;
+            break;
+        }
+    }
+    rte_rwlock_read_unlock(&svc->laddr_lock);
+
+    if (!laddr)
+        return EDPVS_NOTEXIST;
+
+    memset(&dsin, 0, sizeof(struct sockaddr_storage));
+    memset(&ssin, 0, sizeof(struct sockaddr_storage));
+
+    if (af == AF_INET) {
+        struct sockaddr_in *daddr, *saddr;
+        daddr = (struct sockaddr_in *)&dsin;
+        daddr->sin_family = af;
+        daddr->sin_addr = conn->daddr.in;
+        daddr->sin_port = conn->dport;
+        saddr = (struct sockaddr_in *)&ssin;
+        saddr->sin_family = af;
+        saddr->sin_addr = conn->laddr.in;
+        saddr->sin_port = conn->lport;
+    } else {
+        struct sockaddr_in6 *daddr, *saddr;
+        daddr = (struct sockaddr_in6 *)&dsin;
+        daddr->sin6_family = af;
+        daddr->sin6_addr = conn->daddr.in6;
+        daddr->sin6_port = conn->dport;
+        saddr = (struct sockaddr_in6 *)&ssin;
+        saddr->sin6_family = af;
+        saddr->sin6_addr = conn->laddr.in6;
+        saddr->sin6_port = conn->lport;
+    }
+
+    err = sa_reserve(laddr->iface, &dsin, &ssin);
+    if (err != EDPVS_OK) {
+        put_laddr(laddr);
+        return err;
+    }
+
+    rte_atomic32_inc(&laddr->conn_counts);
+    conn->local = laddr;
+    return EDPVS_OK;
+}
+
 int dp_vs_laddr_unbind(struct dp_vs_conn *conn)
 {
     struct sockaddr_storage dsin, ssin;
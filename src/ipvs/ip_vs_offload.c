@@ -0,0 +1,920 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * flow offload of DR/tunnel conns.
+ *
+ * each worker owns a table of slots, max_rules split over the workers.
+ * when an inbound DR/tunnel conn reaches threshold packets (TCP ones
+ * must be established), it takes a slot and its 5-tuple is installed
+ * as a NIC rule: MARK <slot> and QUEUE <worker's rx queue>. marked
+ * packets index the slot table directly, the slot's conn is checked
+ * against the packet tuple and used without conn table lookup. forward
+ * itself and conn stats are still done in software.
+ *
+ * slots are reclaimed by CLOCK (approximate LRU): a hit sets the slot's
+ * ref bit, the hand clears it on its way, and the first slot found
+ * without it is evicted when the table is full. conns release their
+ * slots when freed.
+ *
+ * backends:
+ *  - rte_flow: workers post rule requests to master by per-lcore rings,
+ *              master creates/destroys rte_flow rules periodically, as
+ *              rte_flow calls are neither lockless nor fast. until then
+ *              packets are simply not marked, and a stale mark left by
+ *              an evicted rule fails the tuple check.
+ *  - sw:       rules are kept in a per-lcore exact match table and the
+ *              worker marks packets itself, to test without the NIC.
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <rte_flow.h>
+#include "common.h"
+#include "dpdk.h"
+#include "netif.h"
+#include "inet.h"
+#include "ctrl.h"
+#include "parser/parser.h"
+#include "ipvs/ipvs.h"
+#include "ipvs/conn.h"
+#include "ipvs/dest.h"
+#include "ipvs/blklst.h"
+#include "ipvs/proto_tcp.h"
+#include "ipvs/offload.h"
+
+#define OFFLOAD_BACKEND_DEF         DP_VS_OFFLOAD_RTE_FLOW
+#define OFFLOAD_MAX_RULES_DEF       8192
+#define OFFLOAD_THRESHOLD_DEF       64
+
+#define OFFLOAD_RING_SIZE           4096
+#define OFFLOAD_POOL_CACHE          32
+#define OFFLOAD_APPLY_MS            10
+
+/* mark: | 1 | cid (7 bits) | slot (16 bits) |, other fdir ids are small */
+#define OFFLOAD_MARK_F              (1U << 23)
+#define OFFLOAD_MARK(cid, slot)     (OFFLOAD_MARK_F | ((cid) << 16) | (slot))
+#define OFFLOAD_MARK_CID(mark)      (((mark) >> 16) & 0x7f)
+#define OFFLOAD_MARK_SLOT(mark)     ((mark) & 0xffff)
+#define OFFLOAD_SLOTS_MAX           (1U << 16)
+
+enum {
+    OFFLOAD_ADD,
+    OFFLOAD_DEL,
+};
+
+struct offload_slot {
+    struct dp_vs_conn   *conn;      /* NULL if free */
+    struct list_head    emu_node;   /* sw backend */
+    bool                ref;        /* hit since the hand passed */
+};
+
+struct offload_lcore {
+    struct offload_slot *slots;
+    uint32_t            nslots;
+    uint32_t            hand;       /* CLOCK hand */
+    struct list_head    *emu_tbl;   /* sw backend */
+    uint32_t            emu_mask;
+    struct rte_ring     *ring;      /* rte_flow backend, requests to master */
+    struct dp_vs_offload_stats stats;
+} __rte_cache_aligned;
+
+/* rule request from worker to master */
+struct offload_req {
+    uint8_t             op;
+    uint8_t             af;
+    uint8_t             proto;
+    portid_t            port;
+    queueid_t           queue;
+    uint32_t            slot;
+    uint32_t            mark;
+    union inet_addr     saddr;
+    union inet_addr     daddr;
+    uint16_t            sport;
+    uint16_t            dport;
+};
+
+/* rte_flow rule of a slot, master only */
+struct offload_flow {
+    struct rte_flow     *flow;
+    portid_t            port;
+};
+
+bool dp_vs_offload_on = false;
+uint32_t dp_vs_offload_threshold = OFFLOAD_THRESHOLD_DEF;
+
+static struct offload_lcore offload_lcores[DPVS_MAX_LCORE];
+
+/* master side of rte_flow backend */
+static struct offload_flow *offload_flows[DPVS_MAX_LCORE];
+static struct dp_vs_offload_stats offload_flow_stats[DPVS_MAX_LCORE];
+static struct rte_mempool *offload_req_pool;
+static struct dpvs_timer offload_timer;
+
+static bool offload_enable = false;
+static int offload_backend = OFFLOAD_BACKEND_DEF;
+static uint32_t offload_max_rules = OFFLOAD_MAX_RULES_DEF;
+
+static const char *offload_backend_names[] = {
+    [DP_VS_OFFLOAD_RTE_FLOW]    = "rte_flow",
+    [DP_VS_OFFLOAD_SW]          = "sw",
+};
+
+static inline uint32_t offload_emu_hash(struct offload_lcore *ol, int af,
+                                        const union inet_addr *saddr,
+                                        uint16_t sport,
+                                        const union inet_addr *daddr,
+                                        uint16_t dport)
+{
+    return dp_vs_conn_hashkey(af, saddr, sport, daddr, dport, ol->emu_mask);
+}
+
+static inline bool offload_match(const struct dp_vs_conn *conn,
+                                 const struct dp_vs_iphdr *iph,
+                                 const uint16_t *ports)
+{
+    const struct conn_tuple_hash *t = &tuplehash_in(conn);
+
+    return t->af == iph->af && t->proto == iph->proto &&
+           t->sport == ports[0] && t->dport == ports[1] &&
+           inet_addr_equal(iph->af, &t->saddr, &iph->saddr) &&
+           inet_addr_equal(iph->af, &t->daddr, &iph->daddr);
+}
+
+/* sw backend: what the NIC does for rules installed */
+static void offload_emu_mark(struct offload_lcore *ol,
+                             const struct dp_vs_iphdr *iph,
+                             const uint16_t *ports, struct rte_mbuf *mbuf)
+{
+    struct offload_slot *slot;
+    uint32_t hash;
+
+    hash = offload_emu_hash(ol, iph->af, &iph->saddr, ports[0],
+                            &iph->daddr, ports[1]);
+
+    list_for_each_entry(slot, &ol->emu_tbl[hash], emu_node) {
+        if (offload_match(slot->conn, iph, ports)) {
+            mbuf->hash.fdir.hi = slot->conn->offload_mark;
+            mbuf->ol_flags |= PKT_RX_FDIR | PKT_RX_FDIR_ID;
+            return;
+        }
+    }
+}
+
+static int offload_req_post(struct offload_lcore *ol, int op,
+                            const struct dp_vs_conn *conn, uint32_t slot,
+                            portid_t port, queueid_t queue)
+{
+    const struct conn_tuple_hash *t = &tuplehash_in(conn);
+    struct offload_req *req;
+
+    if (unlikely(rte_mempool_get(offload_req_pool, (void **)&req) != 0))
+        return EDPVS_NOMEM;
+
+    req->op     = op;
+    req->af     = t->af;
+    req->proto  = t->proto;
+    req->port   = port;
+    req->queue  = queue;
+    req->slot   = slot;
+    req->mark   = conn->offload_mark;
+    req->saddr  = t->saddr;
+    req->daddr  = t->daddr;
+    req->sport  = t->sport;
+    req->dport  = t->dport;
+
+    if (unlikely(rte_ring_enqueue(ol->ring, req) != 0)) {
+        rte_mempool_put(offload_req_pool, req);
+        return EDPVS_NOROOM;
+    }
+
+    return EDPVS_OK;
+}
+
+static void offload_slot_release(struct offload_lcore *ol,
+                                 struct offload_slot *slot)
+{
+    struct dp_vs_conn *conn = slot->conn;
+
+    if (offload_backend == DP_VS_OFFLOAD_SW)
+        list_del(&slot->emu_node);
+
+    conn->offload_mark = 0;
+    slot->conn = NULL;
+    slot->ref = false;
+    ol->stats.used--;
+}
+
+/* take a slot by CLOCK, evict its conn if any */
+static uint32_t offload_slot_alloc(struct offload_lcore *ol)
+{
+    struct offload_slot *slot;
+    uint32_t id;
+
+    for (;;) {
+        id = ol->hand;
+        slot = &ol->slots[id];
+        if (++ol->hand == ol->nslots)
+            ol->hand = 0;
+
+        if (!slot->conn)
+            return id;
+
+        if (slot->ref) {
+            slot->ref = false;
+            continue;
+        }
+
+        /* the new rule of the slot replaces the rule of rte_flow, and
+         * the conn has to be hot again to be offloaded again */
+        slot->conn->offload_pkts = 0;
+        offload_slot_release(ol, slot);
+        ol->stats.evicted++;
+        return id;
+    }
+}
+
+void __dp_vs_offload_add(struct dp_vs_conn *conn, struct rte_mbuf *mbuf)
+{
+    lcoreid_t cid = rte_lcore_id();
+    struct offload_lcore *ol = &offload_lcores[cid];
+    struct offload_slot *slot;
+    struct netif_port *dev;
+    queueid_t qid = 0;
+    uint32_t id, hash;
+
+    if (!ol->nslots)
+        return;
+
+    if (!conn->dest || (conn->dest->fwdmode != DPVS_FWD_MODE_DR &&
+                        conn->dest->fwdmode != DPVS_FWD_MODE_TUNNEL))
+        return;
+    if (conn->flags & (DPVS_CONN_F_SYNPROXY | DPVS_CONN_F_TEMPLATE))
+        return;
+
+    if (conn->proto == IPPROTO_TCP) {
+        if (conn->state != DPVS_TCP_S_ESTABLISHED) {
+            /* count again */
+            conn->offload_pkts = 0;
+            return;
+        }
+    } else if (conn->proto != IPPROTO_UDP) {
+        return;
+    }
+
+    if (offload_backend == DP_VS_OFFLOAD_RTE_FLOW) {
+        dev = netif_port_get(mbuf->port);
+        if (!dev || dev->type != PORT_TYPE_GENERAL)
+            return;
+        if (netif_get_queue(dev, cid, &qid) != EDPVS_OK)
+            return;
+    }
+
+    id = offload_slot_alloc(ol);
+    slot = &ol->slots[id];
+    slot->conn = conn;
+    slot->ref = false;
+    conn->offload_mark = OFFLOAD_MARK(cid, id);
+    ol->stats.used++;
+
+    if (offload_backend == DP_VS_OFFLOAD_SW) {
+        hash = offload_emu_hash(ol, tuplehash_in(conn).af,
+                                &tuplehash_in(conn).saddr,
+                                tuplehash_in(conn).sport,
+                                &tuplehash_in(conn).daddr,
+                                tuplehash_in(conn).dport);
+        list_add(&slot->emu_node, &ol->emu_tbl[hash]);
+        ol->stats.added++;
+        return;
+    }
+
+    if (offload_req_post(ol, OFFLOAD_ADD, conn, id, mbuf->port,
+                         qid) != EDPVS_OK) {
+        offload_slot_release(ol, slot);
+        ol->stats.failed++;
+    }
+}
+
+void dp_vs_offload_del(struct dp_vs_conn *conn)
+{
+    struct offload_lcore *ol;
+    struct offload_slot *slot;
+    uint32_t mark = conn->offload_mark, id;
+
+    if (!dp_vs_offload_on || !mark)
+        return;
+
+    ol = &offload_lcores[OFFLOAD_MARK_CID(mark)];
+    id = OFFLOAD_MARK_SLOT(mark);
+    if (unlikely(id >= ol->nslots || ol->slots[id].conn != conn)) {
+        conn->offload_mark = 0;
+        return;
+    }
+    slot = &ol->slots[id];
+
+    if (offload_backend == DP_VS_OFFLOAD_SW) {
+        offload_slot_release(ol, slot);
+        ol->stats.removed++;
+        return;
+    }
+
+    /* if it's lost, the rule goes with the next user of the slot */
+    offload_req_post(ol, OFFLOAD_DEL, conn, id, 0, 0);
+    offload_slot_release(ol, slot);
+}
+
+struct dp_vs_conn *dp_vs_offload_conn_get(const struct dp_vs_iphdr *iph,
+                                          struct rte_mbuf *mbuf, int *dir)
+{
+    lcoreid_t cid = rte_lcore_id();
+    struct offload_lcore *ol = &offload_lcores[cid];
+    struct offload_slot *slot;
+    struct dp_vs_conn *conn;
+    uint16_t *ports, _ports[2];
+    uint32_t mark, id;
+
+    if (iph->proto != IPPROTO_TCP && iph->proto != IPPROTO_UDP)
+        return NULL;
+
+    ports = mbuf_header_pointer(mbuf, iph->len, sizeof(_ports), _ports);
+    if (unlikely(!ports))
+        return NULL;
+
+    if (offload_backend == DP_VS_OFFLOAD_SW && ol->nslots)
+        offload_emu_mark(ol, iph, ports, mbuf);
+
+    if (!(mbuf->ol_flags & PKT_RX_FDIR_ID))
+        return NULL;
+
+    mark = mbuf->hash.fdir.hi;
+    if (!(mark & OFFLOAD_MARK_F) || OFFLOAD_MARK_CID(mark) != cid)
+        return NULL;
+
+    id = OFFLOAD_MARK_SLOT(mark);
+    if (unlikely(id >= ol->nslots))
+        return NULL;
+    slot = &ol->slots[id];
+
+    conn = slot->conn;
+    if (unlikely(!conn || conn->offload_mark != mark ||
+                 !offload_match(conn, iph, ports))) {
+        ol->stats.stale++;
+        return NULL;
+    }
+
+    /* let the lookup deny it */
+    if (dp_vs_blklst_lookup(iph->proto, &iph->daddr, ports[1], &iph->saddr))
+        return NULL;
+
+    slot->ref = true;
+    ol->stats.hits++;
+
+    rte_atomic32_inc(&conn->refcnt);
+    *dir = DPVS_CONN_DIR_INBOUND;
+    return conn;
+}
+
+/*
+ * rte_flow backend, master
+ */
+static struct rte_flow *offload_flow_create(const struct offload_req *req,
+                                            struct rte_flow_error *error)
+{
+    struct rte_flow_attr attr = { .ingress = 1 };
+    struct rte_flow_item pattern[4];
+    struct rte_flow_action actions[3];
+    struct rte_flow_item_ipv4 ip4_spec, ip4_mask;
+    struct rte_flow_item_ipv6 ip6_spec, ip6_mask;
+    struct rte_flow_item_tcp tcp_spec, tcp_mask;
+    struct rte_flow_item_udp udp_spec, udp_mask;
+    struct rte_flow_action_mark mark = { .id = req->mark };
+    struct rte_flow_action_queue queue = { .index = req->queue };
+
+    memset(pattern, 0, sizeof(pattern));
+    memset(actions, 0, sizeof(actions));
+
+    pattern[0].type = RTE_FLOW_ITEM_TYPE_ETH;
+
+    if (req->af == AF_INET6) {
+        memset(&ip6_spec, 0, sizeof(ip6_spec));
+        memset(&ip6_mask, 0, sizeof(ip6_mask));
+        memcpy(ip6_spec.hdr.src_addr, &req->saddr.in6, 16);
+        memcpy(ip6_spec.hdr.dst_addr, &req->daddr.in6, 16);
+        memset(ip6_mask.hdr.src_addr, 0xff, 16);
+        memset(ip6_mask.hdr.dst_addr, 0xff, 16);
+        pattern[1].type = RTE_FLOW_ITEM_TYPE_IPV6;
+        pattern[1].spec = &ip6_spec;
+        pattern[1].mask = &ip6_mask;
+    } else {
+        memset(&ip4_spec, 0, sizeof(ip4_spec));
+        memset(&ip4_mask, 0, sizeof(ip4_mask));
+        ip4_spec.hdr.src_addr = req->saddr.in.s_addr;
+        ip4_spec.hdr.dst_addr = req->daddr.in.s_addr;
+        ip4_mask.hdr.src_addr = 0xffffffff;
+        ip4_mask.hdr.dst_addr = 0xffffffff;
+        pattern[1].type = RTE_FLOW_ITEM_TYPE_IPV4;
+        pattern[1].spec = &ip4_spec;
+        pattern[1].mask = &ip4_mask;
+    }
+
+    if (req->proto == IPPROTO_TCP) {
+        memset(&tcp_spec, 0, sizeof(tcp_spec));
+        memset(&tcp_mask, 0, sizeof(tcp_mask));
+        tcp_spec.hdr.src_port = req->sport;
+        tcp_spec.hdr.dst_port = req->dport;
+        tcp_mask.hdr.src_port = 0xffff;
+        tcp_mask.hdr.dst_port = 0xffff;
+        pattern[2].type = RTE_FLOW_ITEM_TYPE_TCP;
+        pattern[2].spec = &tcp_spec;
+        pattern[2].mask = &tcp_mask;
+    } else {
+        memset(&udp_spec, 0, sizeof(udp_spec));
+        memset(&udp_mask, 0, sizeof(udp_mask));
+        udp_spec.hdr.src_port = req->sport;
+        udp_spec.hdr.dst_port = req->dport;
+        udp_mask.hdr.src_port = 0xffff;
+        udp_mask.hdr.dst_port = 0xffff;
+        pattern[2].type = RTE_FLOW_ITEM_TYPE_UDP;
+        pattern[2].spec = &udp_spec;
+        pattern[2].mask = &udp_mask;
+    }
+
+    pattern[3].type = RTE_FLOW_ITEM_TYPE_END;
+
+    actions[0].type = RTE_FLOW_ACTION_TYPE_MARK;
+    actions[0].conf = &mark;
+    actions[1].type = RTE_FLOW_ACTION_TYPE_QUEUE;
+    actions[1].conf = &queue;
+    actions[2].type = RTE_FLOW_ACTION_TYPE_END;
+
+    return rte_flow_create(req->port, &attr, pattern, actions, error);
+}
+
+static void offload_flow_apply(lcoreid_t cid, const struct offload_req *req)
+{
+    struct offload_flow *f = &offload_flows[cid][req->slot];
+    struct dp_vs_offload_stats *stats = &offload_flow_stats[cid];
+    struct rte_flow_error error;
+
+    if (f->flow) {
+        if (rte_flow_destroy(f->port, f->flow, &error) != 0)
+            RTE_LOG(WARNING, IPVS, "%s: fail to destroy rule of lcore%d "
+                    "slot %u: %s\n", __func__, cid, req->slot,
+                    error.message ? error.message : "unknown");
+        f->flow = NULL;
+        if (req->op == OFFLOAD_DEL)
+            stats->removed++;
+    }
+
+    if (req->op != OFFLOAD_ADD)
+        return;
+
+    f->flow = offload_flow_create(req, &error);
+    if (!f->flow) {
+        /* the slot is never hit and the hand reclaims it soon */
+        stats->failed++;
+        RTE_LOG(DEBUG, IPVS, "%s: fail to create rule of lcore%d slot %u: "
+                "%s\n", __func__, cid, req->slot,
+                error.message ? error.message : "unknown");
+        return;
+    }
+
+    f->port = req->port;
+    stats->added++;
+}
+
+static void offload_flow_drain(void)
+{
+    struct offload_req *reqs[64];
+    lcoreid_t cid;
+    unsigned i, n;
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        if (!offload_lcores[cid].ring)
+            continue;
+
+        do {
+            n = rte_ring_dequeue_burst(offload_lcores[cid].ring,
+                                       (void **)reqs, NELEMS(reqs), NULL);
+            for (i = 0; i < n; i++) {
+                offload_flow_apply(cid, reqs[i]);
+                rte_mempool_put(offload_req_pool, reqs[i]);
+            }
+        } while (n == NELEMS(reqs));
+    }
+}
+
+static int offload_apply(void *arg)
+{
+    offload_flow_drain();
+    return DTIMER_OK;
+}
+
+/*
+ * config file
+ */
+static void offload_switch_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+
+    assert(str);
+
+    if (strcasecmp(str, "on") == 0)
+        offload_enable = true;
+    else if (strcasecmp(str, "off") == 0)
+        offload_enable = false;
+    else
+        RTE_LOG(WARNING, IPVS, "invalid flow_offload:switch %s\n", str);
+
+    RTE_LOG(INFO, IPVS, "flow_offload:switch = %s\n",
+            offload_enable ? "on" : "off");
+
+    FREE_PTR(str);
+}
+
+static void offload_backend_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int i;
+
+    assert(str);
+
+    for (i = 0; i < NELEMS(offload_backend_names); i++) {
+        if (strcasecmp(str, offload_backend_names[i]) == 0)
+            break;
+    }
+
+    if (i < NELEMS(offload_backend_names)) {
+        offload_backend = i;
+        RTE_LOG(INFO, IPVS, "flow_offload:backend = %s\n", str);
+    } else {
+        RTE_LOG(WARNING, IPVS, "invalid flow_offload:backend %s, "
+                "using default %s\n", str,
+                offload_backend_names[OFFLOAD_BACKEND_DEF]);
+        offload_backend = OFFLOAD_BACKEND_DEF;
+    }
+
+    FREE_PTR(str);
+}
+
+static void offload_max_rules_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int rules;
+
+    assert(str);
+
+    rules = atoi(str);
+    if (rules > 0 && rules <= DPVS_MAX_LCORE * OFFLOAD_SLOTS_MAX) {
+        offload_max_rules = rules;
+        RTE_LOG(INFO, IPVS, "flow_offload:max_rules = %d\n", rules);
+    } else {
+        RTE_LOG(WARNING, IPVS, "invalid flow_offload:max_rules %s, "
+                "using default %d\n", str, OFFLOAD_MAX_RULES_DEF);
+        offload_max_rules = OFFLOAD_MAX_RULES_DEF;
+    }
+
+    FREE_PTR(str);
+}
+
+static void offload_threshold_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int pkts;
+
+    assert(str);
+
+    pkts = atoi(str);
+    if (pkts > 0) {
+        dp_vs_offload_threshold = pkts;
+        RTE_LOG(INFO, IPVS, "flow_offload:threshold = %d\n", pkts);
+    } else {
+        RTE_LOG(WARNING, IPVS, "invalid flow_offload:threshold %s, "
+                "using default %d\n", str, OFFLOAD_THRESHOLD_DEF);
+        dp_vs_offload_threshold = OFFLOAD_THRESHOLD_DEF;
+    }
+
+    FREE_PTR(str);
+}
+
+void offload_keyword_value_init(void)
+{
+    if (dpvs_state_get() == DPVS_STATE_INIT) {
+        /* KW_TYPE_INIT keyword */
+        offload_enable = false;
+        offload_backend = OFFLOAD_BACKEND_DEF;
+        offload_max_rules = OFFLOAD_MAX_RULES_DEF;
+    }
+    /* KW_TYPE_NORMAL keyword */
+    dp_vs_offload_threshold = OFFLOAD_THRESHOLD_DEF;
+}
+
+void install_offload_keywords(void)
+{
+    install_keyword("switch", offload_switch_handler, KW_TYPE_INIT);
+    install_keyword("backend", offload_backend_handler, KW_TYPE_INIT);
+    install_keyword("max_rules", offload_max_rules_handler, KW_TYPE_INIT);
+    install_keyword("threshold", offload_threshold_handler, KW_TYPE_NORMAL);
+}
+
+/*
+ * control plane
+ */
+static int offload_msg_get_stats(struct dpvs_msg *msg)
+{
+    struct offload_lcore *ol = &offload_lcores[rte_lcore_id()];
+    struct dp_vs_offload_stats *stats;
+
+    stats = msg_reply_alloc(sizeof(*stats));
+    if (!stats)
+        return EDPVS_NOMEM;
+
+    *stats = ol->stats;
+    stats->slots = ol->nslots;
+
+    msg->reply.len = sizeof(*stats);
+    msg->reply.data = stats;
+
+    return EDPVS_OK;
+}
+
+static int offload_sockopt_set(sockoptid_t opt, const void *in, size_t inlen)
+{
+    return EDPVS_NOTSUPP;
+}
+
+static int offload_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
+                               void **out, size_t *outsize)
+{
+    struct dp_vs_offload_param *param;
+    struct dpvs_msg *req, *reply;
+    struct dpvs_multicast_queue *replies = NULL;
+    int err;
+
+    if (opt != SOCKOPT_GET_OFFLOAD)
+        return EDPVS_NOTSUPP;
+    if (!out || !outsize)
+        return EDPVS_INVAL;
+
+    param = rte_zmalloc(NULL, sizeof(*param), 0);
+    if (!param)
+        return EDPVS_NOMEM;
+
+    param->enable       = dp_vs_offload_on;
+    param->backend      = offload_backend;
+    param->max_rules    = offload_max_rules;
+    param->threshold    = dp_vs_offload_threshold;
+
+    req = msg_make(MSG_TYPE_OFFLOAD_STATS, 0, DPVS_MSG_MULTICAST,
+                   rte_lcore_id(), 0, NULL);
+    if (!req) {
+        rte_free(param);
+        return EDPVS_NOMEM;
+    }
+
+    err = multicast_msg_send(req, 0, &replies);
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IPVS, "%s: send msg: %s\n", __func__, dpvs_strerror(err));
+        msg_destroy(&req);
+        rte_free(param);
+        return err;
+    }
+
+    list_for_each_entry(reply, &replies->mq, mq_node) {
+        struct dp_vs_offload_stats *stats =
+            (struct dp_vs_offload_stats *)reply->data;
+        struct dp_vs_offload_stats *cpu = &param->stats_cpus[reply->cid];
+
+        *cpu = *stats;
+        /* rules of rte_flow are accounted by master */
+        cpu->added += offload_flow_stats[reply->cid].added;
+        cpu->removed += offload_flow_stats[reply->cid].removed;
+        cpu->failed += offload_flow_stats[reply->cid].failed;
+
+        param->stats.added += cpu->added;
+        param->stats.removed += cpu->removed;
+        param->stats.evicted += cpu->evicted;
+        param->stats.failed += cpu->failed;
+        param->stats.hits += cpu->hits;
+        param->stats.stale += cpu->stale;
+        param->stats.used += cpu->used;
+        param->stats.slots += cpu->slots;
+    }
+
+    *out = param;
+    *outsize = sizeof(*param);
+
+    msg_destroy(&req);
+    return EDPVS_OK;
+}
+
+static struct dpvs_msg_type offload_stats_msg = {
+    .type           = MSG_TYPE_OFFLOAD_STATS,
+    .prio           = MSG_PRIO_LOW,
+    .unicast_msg_cb = offload_msg_get_stats,
+};
+
+static struct dpvs_sockopts offload_sockopts = {
+    .version        = SOCKOPT_VERSION,
+    .set_opt_min    = SOCKOPT_SET_OFFLOAD,
+    .set_opt_max    = SOCKOPT_SET_OFFLOAD,
+    .set            = offload_sockopt_set,
+    .get_opt_min    = SOCKOPT_GET_OFFLOAD,
+    .get_opt_max    = SOCKOPT_GET_OFFLOAD,
+    .get            = offload_sockopt_get,
+};
+
+static void offload_lcores_free(void)
+{
+    lcoreid_t cid;
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        struct offload_lcore *ol = &offload_lcores[cid];
+
+        if (ol->ring)
+            rte_ring_free(ol->ring);
+        if (ol->emu_tbl)
+            rte_free(ol->emu_tbl);
+        if (ol->slots)
+            rte_free(ol->slots);
+        if (offload_flows[cid])
+            rte_free(offload_flows[cid]);
+
+        memset(ol, 0, sizeof(*ol));
+        offload_flows[cid] = NULL;
+    }
+}
+
+static int offload_lcore_init(lcoreid_t cid, uint32_t nslots)
+{
+    struct offload_lcore *ol = &offload_lcores[cid];
+    int socket = rte_lcore_to_socket_id(cid);
+    char name[32];
+    uint32_t i;
+
+    ol->slots = rte_zmalloc_socket(NULL, nslots * sizeof(struct offload_slot),
+                                   RTE_CACHE_LINE_SIZE, socket);
+    if (!ol->slots)
+        return EDPVS_NOMEM;
+    ol->nslots = nslots;
+
+    if (offload_backend == DP_VS_OFFLOAD_SW) {
+        ol->emu_mask = rte_align32pow2(nslots) - 1;
+        ol->emu_tbl = rte_malloc_socket(NULL, (ol->emu_mask + 1) *
+                                        sizeof(struct list_head),
+                                        RTE_CACHE_LINE_SIZE, socket);
+        if (!ol->emu_tbl)
+            return EDPVS_NOMEM;
+        for (i = 0; i <= ol->emu_mask; i++)
+            INIT_LIST_HEAD(&ol->emu_tbl[i]);
+        return EDPVS_OK;
+    }
+
+    snprintf(name, sizeof(name), "offload_ring_%d", cid);
+    ol->ring = rte_ring_create(name, OFFLOAD_RING_SIZE, socket,
+                               RING_F_SP_ENQ | RING_F_SC_DEQ);
+    if (!ol->ring)
+        return EDPVS_DPDKAPIFAIL;
+
+    offload_flows[cid] = rte_zmalloc(NULL, nslots * sizeof(struct offload_flow),
+                                     RTE_CACHE_LINE_SIZE);
+    if (!offload_flows[cid])
+        return EDPVS_NOMEM;
+
+    return EDPVS_OK;
+}
+
+static int offload_start(void)
+{
+    struct timeval tv;
+    uint8_t nlcores;
+    uint64_t mask;
+    uint32_t nslots;
+    lcoreid_t cid;
+    int err;
+
+    netif_get_slave_lcores(&nlcores, &mask);
+    if (!nlcores)
+        return EDPVS_OK;
+
+    nslots = RTE_MIN(offload_max_rules / nlcores, OFFLOAD_SLOTS_MAX);
+    if (!nslots) {
+        RTE_LOG(WARNING, IPVS, "flow offload: max_rules %u less than "
+                "workers, offload off\n", offload_max_rules);
+        return EDPVS_OK;
+    }
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        if (!(mask & (1UL << cid)))
+            continue;
+        err = offload_lcore_init(cid, nslots);
+        if (err != EDPVS_OK)
+            goto errout;
+    }
+
+    if (offload_backend == DP_VS_OFFLOAD_RTE_FLOW) {
+        offload_req_pool = rte_mempool_create("offload_req_pool",
+                                nlcores * OFFLOAD_RING_SIZE,
+                                sizeof(struct offload_req),
+                                OFFLOAD_POOL_CACHE,
+                                0, NULL, NULL, NULL, NULL,
+                                SOCKET_ID_ANY, 0);
+        if (!offload_req_pool) {
+            err = EDPVS_NOMEM;
+            goto errout;
+        }
+
+        tv.tv_sec = 0;
+        tv.tv_usec = OFFLOAD_APPLY_MS * 1000;
+        err = dpvs_timer_sched_period(&offload_timer, &tv, offload_apply,
+                                      NULL, true);
+        if (err != EDPVS_OK)
+            goto errout;
+    }
+
+    dp_vs_offload_on = true;
+
+    RTE_LOG(INFO, IPVS, "flow offload: %s, %u rules on each of %d lcores\n",
+            offload_backend_names[offload_backend], nslots, nlcores);
+    return EDPVS_OK;
+
+errout:
+    offload_lcores_free();
+    /* no API opposite to rte_mempool_create() */
+    return err;
+}
+
+int dp_vs_offload_init(void)
+{
+    int err;
+
+    err = msg_type_mc_register(&offload_stats_msg);
+    if (err != EDPVS_OK)
+        return err;
+
+    err = sockopt_register(&offload_sockopts);
+    if (err != EDPVS_OK)
+        goto err_sockopt;
+
+    if (offload_enable) {
+        err = offload_start();
+        if (err != EDPVS_OK)
+            goto err_start;
+    }
+
+    return EDPVS_OK;
+
+err_start:
+    sockopt_unregister(&offload_sockopts);
+err_sockopt:
+    msg_type_mc_unregister(&offload_stats_msg);
+    return err;
+}
+
+int dp_vs_offload_term(void)
+{
+    struct rte_flow_error error;
+    lcoreid_t cid;
+    uint32_t i;
+
+    if (dp_vs_offload_on) {
+        dp_vs_offload_on = false;
+
+        if (offload_backend == DP_VS_OFFLOAD_RTE_FLOW) {
+            dpvs_timer_cancel(&offload_timer, true);
+            offload_flow_drain();
+
+            for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+                if (!offload_flows[cid])
+                    continue;
+                for (i = 0; i < offload_lcores[cid].nslots; i++) {
+                    struct offload_flow *f = &offload_flows[cid][i];
+
+                    if (f->flow)
+                        rte_flow_destroy(f->port, f->flow, &error);
+                }
+            }
+        }
+
+        /* conns still holding marks are ignored as offload is off */
+        offload_lcores_free();
+    }
+
+    sockopt_unregister(&offload_sockopts);
+    return msg_type_mc_unregister(&offload_stats_msg);
+}
@@ -0,0 +1,632 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * overload protection of workers.
+ *
+ * a loop job samples the lcore's load every OVERLOAD_SAMPLE_US:
+ *
+ *  - busy: share of TSC cycles spent on non-empty rx bursts since the
+ *          last sample, smoothed by EWMA (1/4).
+ *  - rxq:  highest fill level of the lcore's rx queues, smoothed alike.
+ *          it tells how far the lcore falls behind even if busy is 100.
+ *
+ * the lcore enters overload if either reaches its high watermark, and
+ * leaves when both are below the low watermarks and it has been in
+ * overload for at least hold_time.
+ *
+ * while overloaded, packets without a connection are shed before conn
+ * scheduling, which is the expensive part (scheduler, conn and laddr
+ * allocation, synproxy SYN to RS). by policy:
+ *
+ *  - drop:      drop them.
+ *  - rst:       reply RST to TCP ones, so clients fail fast rather than
+ *               retransmit SYN into the overload. drop others.
+ *  - syncookie: answer SYNs of all TCP services with synproxy cookies,
+ *               which costs no state, and only schedule ACKs carrying a
+ *               valid cookie, i.e. clients proved to be real. drop UDP.
+ *               it works for the same forwarding modes as synproxy.
+ */
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/tcp.h>
+#include "common.h"
+#include "dpdk.h"
+#include "netif.h"
+#include "inet.h"
+#include "ipv4.h"
+#include "ipv6.h"
+#include "ctrl.h"
+#include "parser/parser.h"
+#include "ipvs/ipvs.h"
+#include "ipvs/proto_tcp.h"
+#include "ipvs/service.h"
+#include "ipvs/overload.h"
+
+#define OVERLOAD_SAMPLE_US          1000
+
+#define OVERLOAD_POLICY_DEF         DP_VS_SHED_SYNCOOKIE
+#define OVERLOAD_BUSY_HIGH_DEF      95
+#define OVERLOAD_BUSY_LOW_DEF       80
+#define OVERLOAD_RXQ_HIGH_DEF       75
+#define OVERLOAD_RXQ_LOW_DEF        25
+#define OVERLOAD_HOLD_MS_DEF        100
+
+struct overload_lcore {
+    uint64_t        next_sample;    /* TSC */
+    uint64_t        last_tsc;
+    uint64_t        last_busy;      /* busy cycles at last sample */
+    uint64_t        since;          /* TSC entering overload */
+    uint32_t        busy;
+    uint32_t        rxq;
+    struct dp_vs_overload_stats stats;
+} __rte_cache_aligned;
+
+bool dp_vs_lcore_overloaded[DPVS_MAX_LCORE];
+
+static struct overload_lcore overload_lcores[DPVS_MAX_LCORE];
+static struct netif_lcore_loop_job overload_job;
+static uint64_t overload_sample_cycles;
+
+static bool overload_enable = false;
+static int overload_policy = OVERLOAD_POLICY_DEF;
+static uint32_t overload_busy_high = OVERLOAD_BUSY_HIGH_DEF;
+static uint32_t overload_busy_low = OVERLOAD_BUSY_LOW_DEF;
+static uint32_t overload_rxq_high = OVERLOAD_RXQ_HIGH_DEF;
+static uint32_t overload_rxq_low = OVERLOAD_RXQ_LOW_DEF;
+static uint32_t overload_hold_ms = OVERLOAD_HOLD_MS_DEF;
+
+static const char *overload_policy_names[] = {
+    [DP_VS_SHED_DROP]       = "drop",
+    [DP_VS_SHED_RST]        = "rst",
+    [DP_VS_SHED_SYNCOOKIE]  = "syncookie",
+};
+
+static void overload_enter(lcoreid_t cid, struct overload_lcore *ol,
+                           uint64_t now)
+{
+    ol->since = now;
+    ol->stats.enters++;
+    dp_vs_lcore_overloaded[cid] = true;
+
+    RTE_LOG(WARNING, IPVS, "lcore%d overloaded (busy %u%%, rxq %u%%), "
+            "shedding new flows by %s\n", cid, ol->busy, ol->rxq,
+            overload_policy_names[overload_policy]);
+}
+
+static void overload_leave(lcoreid_t cid, struct overload_lcore *ol,
+                           uint64_t now)
+{
+    uint64_t ms = (now - ol->since) * 1000 / rte_get_tsc_hz();
+
+    ol->stats.overload_ms += ms;
+    dp_vs_lcore_overloaded[cid] = false;
+
+    RTE_LOG(WARNING, IPVS, "lcore%d recovered from overload after %lums "
+            "(busy %u%%, rxq %u%%)\n", cid, ms, ol->busy, ol->rxq);
+}
+
+static void overload_sample(void *arg)
+{
+    lcoreid_t cid = rte_lcore_id();
+    struct overload_lcore *ol = &overload_lcores[cid];
+    uint64_t now = rte_rdtsc();
+    uint64_t busy_cycles;
+    uint32_t busy;
+    int rxq;
+
+    if (likely(now < ol->next_sample))
+        return;
+
+    netif_lcore_load(&busy_cycles, &rxq);
+
+    if (ol->last_tsc && now > ol->last_tsc) {
+        busy = (busy_cycles - ol->last_busy) * 100 / (now - ol->last_tsc);
+        ol->busy = (ol->busy * 3 + RTE_MIN(busy, 100U)) / 4;
+    }
+    if (rxq >= 0)
+        ol->rxq = (ol->rxq * 3 + rxq) / 4;
+
+    ol->last_tsc = now;
+    ol->last_busy = busy_cycles;
+    ol->next_sample = now + overload_sample_cycles;
+
+    if (!dp_vs_lcore_overloaded[cid]) {
+        if (overload_enable && (ol->busy >= overload_busy_high ||
+                                ol->rxq >= overload_rxq_high))
+            overload_enter(cid, ol, now);
+    } else if (!overload_enable) {
+        overload_leave(cid, ol, now);
+    } else if (ol->busy < overload_busy_low && ol->rxq < overload_rxq_low &&
+               now - ol->since >= overload_hold_ms * rte_get_tsc_hz() / 1000) {
+        overload_leave(cid, ol, now);
+    }
+}
+
+/*
+ * reply RST to @mbuf by reusing it, like synproxy does for SYN-ACK.
+ * options and payload are trimmed. mbuf is consumed if EDPVS_OK.
+ */
+static int overload_send_rst(int af, struct rte_mbuf *mbuf, int iphlen)
+{
+    struct netif_port *dev;
+    struct ether_hdr *eth;
+    struct ether_addr ethaddr;
+    struct tcphdr *th;
+    uint32_t seq, datalen;
+    uint16_t port;
+
+    if (mbuf->l2_len != sizeof(struct ether_hdr))
+        return EDPVS_NOTSUPP;
+
+    if (mbuf_may_pull(mbuf, iphlen + sizeof(struct tcphdr)) != 0)
+        return EDPVS_INVPKT;
+
+    dev = netif_port_get(mbuf->port);
+    if (unlikely(!dev))
+        return EDPVS_NOTEXIST;
+
+    th = rte_pktmbuf_mtod_offset(mbuf, struct tcphdr *, iphlen);
+    if ((th->doff << 2) < sizeof(struct tcphdr) ||
+            mbuf->pkt_len < iphlen + (th->doff << 2))
+        return EDPVS_INVPKT;
+    datalen = mbuf->pkt_len - iphlen - (th->doff << 2);
+
+    if (rte_pktmbuf_trim(mbuf, mbuf->pkt_len - iphlen -
+                         sizeof(struct tcphdr)) != 0)
+        return EDPVS_NOTSUPP;
+
+    /* RFC 793: seq from the ACK if any, otherwise ack what was sent */
+    if (th->ack) {
+        seq = th->ack_seq;
+        th->ack_seq = 0;
+        ((uint8_t *)th)[13] = 0x04;
+    } else {
+        seq = 0;
+        th->ack_seq = htonl(ntohl(th->seq) + datalen + th->syn + th->fin);
+        ((uint8_t *)th)[13] = 0x14;
+    }
+    th->seq = seq;
+    th->doff = sizeof(struct tcphdr) >> 2;
+    th->window = 0;
+    th->urg_ptr = 0;
+
+    port = th->dest;
+    th->dest = th->source;
+    th->source = port;
+
+    mbuf->ol_flags &= ~(PKT_TX_TCP_CKSUM | PKT_TX_IP_CKSUM |
+                        PKT_TX_IPV4 | PKT_TX_IPV6);
+
+    if (af == AF_INET6) {
+        struct ip6_hdr *ip6h = ip6_hdr(mbuf);
+        struct in6_addr addr;
+
+        addr = ip6h->ip6_src;
+        ip6h->ip6_src = ip6h->ip6_dst;
+        ip6h->ip6_dst = addr;
+        ip6h->ip6_plen = htons(iphlen - sizeof(struct ip6_hdr) +
+                               sizeof(struct tcphdr));
+        ip6h->ip6_hlim = INET_DEF_TTL;
+        tcp6_send_csum((struct ipv6_hdr *)ip6h, th);
+    } else {
+        struct iphdr *iph = (struct iphdr *)ip4_hdr(mbuf);
+        uint32_t addr;
+
+        addr = iph->saddr;
+        iph->saddr = iph->daddr;
+        iph->daddr = addr;
+        iph->tot_len = htons(iphlen + sizeof(struct tcphdr));
+        iph->ttl = INET_DEF_TTL;
+        iph->tos = 0;
+        iph->frag_off = htons(IP_DF);
+        tcp4_send_csum((struct ipv4_hdr *)iph, th);
+        ip4_send_csum((struct ipv4_hdr *)iph);
+    }
+
+    /* mbuf is reused, swap L2 addresses and send it back */
+    eth = (struct ether_hdr *)rte_pktmbuf_prepend(mbuf, mbuf->l2_len);
+    if (unlikely(!eth))
+        return EDPVS_NOROOM;
+    ether_addr_copy(&eth->s_addr, &ethaddr);
+    ether_addr_copy(&eth->d_addr, &eth->s_addr);
+    ether_addr_copy(&ethaddr, &eth->d_addr);
+
+    /* netif_xmit always consumes mbuf */
+    netif_xmit(mbuf, dev);
+    return EDPVS_OK;
+}
+
+bool dp_vs_overload_shed(struct dp_vs_proto *prot,
+                         const struct dp_vs_iphdr *iph,
+                         struct rte_mbuf *mbuf, int *verdict)
+{
+    struct overload_lcore *ol = &overload_lcores[rte_lcore_id()];
+    struct dp_vs_service *svc;
+    struct tcphdr *th = NULL, _tcph;
+    uint16_t *ports, _ports[2];
+    bool outwall = false;
+
+    if (iph->proto == IPPROTO_TCP) {
+        th = mbuf_header_pointer(mbuf, iph->len, sizeof(_tcph), &_tcph);
+        if (unlikely(!th))
+            return false;
+
+        /* only SYN and, unless they're what we accept, cookie ACKs
+         * may create a conn, leave others to conn_sched */
+        if (th->rst || th->fin || (th->syn && th->ack))
+            return false;
+        if (!th->syn && overload_policy == DP_VS_SHED_SYNCOOKIE)
+            return false;
+        ports = &th->source;
+    } else if (iph->proto == IPPROTO_UDP) {
+        ports = mbuf_header_pointer(mbuf, iph->len, sizeof(_ports), _ports);
+        if (unlikely(!ports))
+            return false;
+    } else {
+        return false;
+    }
+
+    svc = dp_vs_service_lookup(iph->af, iph->proto, &iph->daddr, ports[1],
+                               0, mbuf, NULL, &outwall);
+    if (!svc)
+        return false;
+
+    if (th && !th->syn && !(svc->flags & DP_VS_SVC_F_SYNPROXY)) {
+        /* not a cookie ACK */
+        dp_vs_service_put(svc);
+        return false;
+    }
+
+    svc->shed[rte_lcore_id()]++;
+    dp_vs_service_put(svc);
+    ol->stats.shed++;
+
+    if (th && overload_policy == DP_VS_SHED_RST &&
+            overload_send_rst(iph->af, mbuf, iph->len) == EDPVS_OK) {
+        ol->stats.rst++;
+        *verdict = INET_STOLEN;
+    } else {
+        *verdict = INET_DROP;
+    }
+
+    return true;
+}
+
+bool dp_vs_overload_syncookie(struct dp_vs_service *svc)
+{
+    if (!dp_vs_overloaded() || overload_policy != DP_VS_SHED_SYNCOOKIE)
+        return false;
+
+    /* DR/TUNNEL dests see the client SYN, they're shed instead */
+    if (svc->num_nonat_dests)
+        return false;
+
+    svc->shed[rte_lcore_id()]++;
+    overload_lcores[rte_lcore_id()].stats.syncookie++;
+    return true;
+}
+
+/*
+ * config file
+ */
+static uint32_t overload_conf_percent(vector_t tokens, const char *name,
+                                      uint32_t def)
+{
+    char *str = set_value(tokens);
+    int val;
+
+    assert(str);
+
+    val = atoi(str);
+    if (val < 1 || val > 100) {
+        RTE_LOG(WARNING, IPVS, "invalid overload:%s %s, using default %u\n",
+                name, str, def);
+        val = def;
+    } else {
+        RTE_LOG(INFO, IPVS, "overload:%s = %d\n", name, val);
+    }
+
+    FREE_PTR(str);
+    return val;
+}
+
+static void overload_switch_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+
+    assert(str);
+
+    if (strcasecmp(str, "on") == 0)
+        overload_enable = true;
+    else if (strcasecmp(str, "off") == 0)
+        overload_enable = false;
+    else
+        RTE_LOG(WARNING, IPVS, "invalid overload:switch %s\n", str);
+
+    RTE_LOG(INFO, IPVS, "overload:switch = %s\n", overload_enable ? "on" : "off");
+
+    FREE_PTR(str);
+}
+
+static void overload_policy_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int i;
+
+    assert(str);
+
+    for (i = 0; i < NELEMS(overload_policy_names); i++) {
+        if (strcasecmp(str, overload_policy_names[i]) == 0)
+            break;
+    }
+
+    if (i < NELEMS(overload_policy_names)) {
+        overload_policy = i;
+        RTE_LOG(INFO, IPVS, "overload:policy = %s\n", str);
+    } else {
+        RTE_LOG(WARNING, IPVS, "invalid overload:policy %s, using default %s\n",
+                str, overload_policy_names[OVERLOAD_POLICY_DEF]);
+        overload_policy = OVERLOAD_POLICY_DEF;
+    }
+
+    FREE_PTR(str);
+}
+
+static void overload_busy_high_handler(vector_t tokens)
+{
+    overload_busy_high = overload_conf_percent(tokens, "busy_high",
+                                               OVERLOAD_BUSY_HIGH_DEF);
+}
+
+static void overload_busy_low_handler(vector_t tokens)
+{
+    overload_busy_low = overload_conf_percent(tokens, "busy_low",
+                                              OVERLOAD_BUSY_LOW_DEF);
+}
+
+static void overload_rxq_high_handler(vector_t tokens)
+{
+    overload_rxq_high = overload_conf_percent(tokens, "rxq_high",
+                                              OVERLOAD_RXQ_HIGH_DEF);
+}
+
+static void overload_rxq_low_handler(vector_t tokens)
+{
+    overload_rxq_low = overload_conf_percent(tokens, "rxq_low",
+                                             OVERLOAD_RXQ_LOW_DEF);
+}
+
+static void overload_hold_time_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int hold;
+
+    assert(str);
+
+    hold = atoi(str);
+    if (hold >= 0 && hold <= 60000) {
+        overload_hold_ms = hold;
+        RTE_LOG(INFO, IPVS, "overload:hold_time = %d\n", hold);
+    } else {
+        RTE_LOG(WARNING, IPVS, "invalid overload:hold_time %s, using default %d\n",
+                str, OVERLOAD_HOLD_MS_DEF);
+        overload_hold_ms = OVERLOAD_HOLD_MS_DEF;
+    }
+
+    FREE_PTR(str);
+}
+
+void overload_keyword_value_init(void)
+{
+    if (dpvs_state_get() == DPVS_STATE_INIT) {
+        /* KW_TYPE_INIT keyword */
+    }
+    /* KW_TYPE_NORMAL keyword */
+    overload_enable = false;
+    overload_policy = OVERLOAD_POLICY_DEF;
+    overload_busy_high = OVERLOAD_BUSY_HIGH_DEF;
+    overload_busy_low = OVERLOAD_BUSY_LOW_DEF;
+    overload_rxq_high = OVERLOAD_RXQ_HIGH_DEF;
+    overload_rxq_low = OVERLOAD_RXQ_LOW_DEF;
+    overload_hold_ms = OVERLOAD_HOLD_MS_DEF;
+}
+
+void install_overload_keywords(void)
+{
+    install_keyword("switch", overload_switch_handler, KW_TYPE_NORMAL);
+    install_keyword("policy", overload_policy_handler, KW_TYPE_NORMAL);
+    install_keyword("busy_high", overload_busy_high_handler, KW_TYPE_NORMAL);
+    install_keyword("busy_low", overload_busy_low_handler, KW_TYPE_NORMAL);
+    install_keyword("rxq_high", overload_rxq_high_handler, KW_TYPE_NORMAL);
+    install_keyword("rxq_low", overload_rxq_low_handler, KW_TYPE_NORMAL);
+    install_keyword("hold_time", overload_hold_time_handler, KW_TYPE_NORMAL);
+}
+
+/*
+ * control plane
+ */
+static int overload_msg_get_stats(struct dpvs_msg *msg)
+{
+    lcoreid_t cid = rte_lcore_id();
+    struct overload_lcore *ol = &overload_lcores[cid];
+    struct dp_vs_overload_stats *stats;
+    struct dp_vs_service *svc;
+
+    assert(msg && msg->len == sizeof(svc));
+    svc = *(struct dp_vs_service **)msg->data;
+
+    stats = msg_reply_alloc(sizeof(*stats));
+    if (!stats)
+        return EDPVS_NOMEM;
+
+    *stats = ol->stats;
+    stats->overloaded = dp_vs_lcore_overloaded[cid];
+    stats->busy = ol->busy;
+    stats->rxq = ol->rxq;
+    stats->svc_shed = svc ? svc->shed[cid] : 0;
+
+    /* count the ongoing overload in */
+    if (stats->overloaded)
+        stats->overload_ms += (rte_rdtsc() - ol->since) * 1000 / rte_get_tsc_hz();
+
+    msg->reply.len = sizeof(*stats);
+    msg->reply.data = stats;
+
+    return EDPVS_OK;
+}
+
+static int overload_sockopt_set(sockoptid_t opt, const void *in, size_t inlen)
+{
+    return EDPVS_NOTSUPP;
+}
+
+static int overload_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
+                                void **out, size_t *outsize)
+{
+    const struct dp_vs_overload_param *in = conf;
+    struct dp_vs_overload_param *param;
+    struct dp_vs_service *svc = NULL;
+    struct dpvs_msg *req, *reply;
+    struct dpvs_multicast_queue *replies = NULL;
+    int err;
+
+    if (opt != SOCKOPT_GET_OVERLOAD)
+        return EDPVS_NOTSUPP;
+    if (!conf || size < sizeof(*in) || !out || !outsize)
+        return EDPVS_INVAL;
+
+    if (in->af != AF_UNSPEC) {
+        svc = dp_vs_service_lookup(in->af, in->proto, &in->vaddr, in->vport,
+                                   in->fwmark, NULL, NULL, NULL);
+        if (!svc)
+            return EDPVS_NOSERV;
+    }
+
+    param = rte_zmalloc(NULL, sizeof(*param), 0);
+    if (!param) {
+        err = EDPVS_NOMEM;
+        goto out;
+    }
+    memcpy(param, in, offsetof(struct dp_vs_overload_param, enable));
+
+    param->enable       = overload_enable;
+    param->policy       = overload_policy;
+    param->busy_high    = overload_busy_high;
+    param->busy_low     = overload_busy_low;
+    param->rxq_high     = overload_rxq_high;
+    param->rxq_low      = overload_rxq_low;
+    param->hold_ms      = overload_hold_ms;
+
+    req = msg_make(MSG_TYPE_OVERLOAD_STATS, 0, DPVS_MSG_MULTICAST,
+                   rte_lcore_id(), sizeof(svc), &svc);
+    if (!req) {
+        rte_free(param);
+        err = EDPVS_NOMEM;
+        goto out;
+    }
+
+    err = multicast_msg_send(req, 0, &replies);
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IPVS, "%s: send msg: %s\n", __func__, dpvs_strerror(err));
+        msg_destroy(&req);
+        rte_free(param);
+        goto out;
+    }
+
+    list_for_each_entry(reply, &replies->mq, mq_node) {
+        struct dp_vs_overload_stats *stats =
+            (struct dp_vs_overload_stats *)reply->data;
+
+        param->stats.enters += stats->enters;
+        param->stats.overload_ms += stats->overload_ms;
+        param->stats.shed += stats->shed;
+        param->stats.rst += stats->rst;
+        param->stats.syncookie += stats->syncookie;
+        param->stats.svc_shed += stats->svc_shed;
+        param->stats.overloaded += stats->overloaded;
+        param->stats_cpus[reply->cid] = *stats;
+    }
+
+    *out = param;
+    *outsize = sizeof(*param);
+
+    msg_destroy(&req);
+out:
+    if (svc)
+        dp_vs_service_put(svc);
+    return err;
+}
+
+static struct dpvs_msg_type overload_stats_msg = {
+    .type           = MSG_TYPE_OVERLOAD_STATS,
+    .prio           = MSG_PRIO_LOW,
+    .unicast_msg_cb = overload_msg_get_stats,
+};
+
+static struct dpvs_sockopts overload_sockopts = {
+    .version        = SOCKOPT_VERSION,
+    .set_opt_min    = SOCKOPT_SET_OVERLOAD,
+    .set_opt_max    = SOCKOPT_SET_OVERLOAD,
+    .set            = overload_sockopt_set,
+    .get_opt_min    = SOCKOPT_GET_OVERLOAD,
+    .get_opt_max    = SOCKOPT_GET_OVERLOAD,
+    .get            = overload_sockopt_get,
+};
+
+int dp_vs_overload_init(void)
+{
+    int err;
+
+    overload_sample_cycles = rte_get_tsc_hz() / 1000000 * OVERLOAD_SAMPLE_US;
+
+    snprintf(overload_job.name, sizeof(overload_job.name) - 1, "%s", "overload");
+    overload_job.func = overload_sample;
+    overload_job.data = NULL;
+    overload_job.type = NETIF_LCORE_JOB_LOOP;
+    err = netif_lcore_loop_job_register(&overload_job);
+    if (err != EDPVS_OK)
+        return err;
+
+    err = msg_type_mc_register(&overload_stats_msg);
+    if (err != EDPVS_OK)
+        goto err_msg;
+
+    err = sockopt_register(&overload_sockopts);
+    if (err != EDPVS_OK)
+        goto err_sockopt;
+
+    return EDPVS_OK;
+
+err_sockopt:
+    msg_type_mc_unregister(&overload_stats_msg);
+err_msg:
+    netif_lcore_loop_job_unregister(&overload_job);
+    return err;
+}
+
+int dp_vs_overload_term(void)
+{
+    sockopt_unregister(&overload_sockopts);
+    msg_type_mc_unregister(&overload_stats_msg);
+    return netif_lcore_loop_job_unregister(&overload_job);
+}
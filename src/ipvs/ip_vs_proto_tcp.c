@@ -858,7 +858,8 @@ static int tcp_state_trans(struct dp_vs_proto *proto, struct dp_vs_conn *conn,
     th = mbuf_header_pointer(mbuf, iphdrlen, sizeof(_tcph), &_tcph);
     if (unlikely(!th))
         return EDPVS_INVPKT;
-    if (dest->fwdmode == DPVS_FWD_MODE_DR || dest->fwdmode == DPVS_FWD_MODE_TUNNEL)
+    if (dest->fwdmode == DPVS_FWD_MODE_DR || dest->fwdmode == DPVS_FWD_MODE_TUNNEL
+            || dest->fwdmode == DPVS_FWD_MODE_OVERLAY)
         off = 8;
     else if (dir == DPVS_CONN_DIR_INBOUND)
         off = 0;
@@ -867,6 +868,10 @@ static int tcp_state_trans(struct dp_vs_proto *proto, struct dp_vs_conn *conn,
     else
         return EDPVS_NOTSUPP; /* do not support INPUT_ONLY now */
 
+    /* RS answers the SYN, for schedulers aware of its latency */
+    if (dir == DPVS_CONN_DIR_OUTBOUND && th->syn && th->ack)
+        dp_vs_conn_rtt_sample(conn);
+
     if ((idx = tcp_state_idx(th)) < 0) {
         RTE_LOG(DEBUG, IPVS, "tcp_state_idx=%d !\n", idx);
         goto tcp_state_out;
@@ -912,13 +917,11 @@ tcp_state_out:
     if (dest) {
         if (!(conn->flags & DPVS_CONN_F_INACTIVE)
                 && (new_state != DPVS_TCP_S_ESTABLISHED)) {
-            rte_atomic32_dec(&dest->actconns);
-            rte_atomic32_inc(&dest->inactconns);
+            dp_vs_dest_conn_inactivate(dest);
             conn->flags |= DPVS_CONN_F_INACTIVE;
         } else if ((conn->flags & DPVS_CONN_F_INACTIVE)
                 && (new_state == DPVS_TCP_S_ESTABLISHED)) {
-            rte_atomic32_inc(&dest->actconns);
-            rte_atomic32_dec(&dest->inactconns);
+            dp_vs_dest_conn_activate(dest);
             conn->flags &= ~DPVS_CONN_F_INACTIVE;
         }
     }
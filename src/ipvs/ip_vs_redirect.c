@@ -74,7 +74,7 @@ dp_vs_redirect_alloc(enum dpvs_fwd_mode fwdmode)
     }
 
     if (unlikely(rte_mempool_get(this_cr_cache, (void **)&r) != 0)) {
-        RTE_LOG(WARNING, IPVS,
+        RTE_BLOG(WARNING, IPVS,
                 "%s: no memory for redirect\n", __func__);
         return NULL;
     }
@@ -228,11 +228,12 @@ int dp_vs_redirect_pkt(struct rte_mbuf *mbuf, lcoreid_t peer_cid)
 
     ret = rte_ring_enqueue(dp_vs_redirect_ring[peer_cid][cid], mbuf);
     if (ret < 0) {
-        RTE_LOG(ERR, IPVS,
+        RTE_BLOG(ERR, IPVS,
                 "%s: [%d] failed to enqueue mbuf to redirect_ring[%d][%d]\n",
                 __func__, cid, peer_cid, cid);
         return INET_DROP;
     }
+    netif_lcore_wakeup(peer_cid);
 
 #ifdef CONFIG_DPVS_IPVS_DEBUG
     RTE_LOG(DEBUG, IPVS,
@@ -352,13 +353,14 @@ static int dp_vs_redirect_ring_create(void)
     int socket_id;
     lcoreid_t cid, peer_cid;
 
-    socket_id = rte_socket_id();
-
     for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
         if (cid == rte_get_master_lcore() || netif_lcore_is_idle(cid)) {
             continue;
         }
 
+        /* rings of @cid are dequeued by @cid only */
+        socket_id = rte_lcore_to_socket_id(cid);
+
         for (peer_cid = 0; peer_cid < DPVS_MAX_LCORE; peer_cid++) {
             if (netif_lcore_is_idle(peer_cid)
                 || peer_cid == rte_get_master_lcore()
@@ -22,6 +22,7 @@
 #include "ipvs/rr.h"
 #include "ipvs/wrr.h"
 #include "ipvs/wlc.h"
+#include "ipvs/wll.h"
 #include "ipvs/conhash.h"
 #include "ipvs/fo.h"
 
@@ -183,6 +184,7 @@ int dp_vs_sched_init(void)
     dp_vs_rr_init();
     dp_vs_wrr_init();
     dp_vs_wlc_init();
+    dp_vs_wll_init();
     dp_vs_conhash_init();
     dp_vs_fo_init();
 
@@ -194,6 +196,7 @@ int dp_vs_sched_term(void)
     dp_vs_rr_term();
     dp_vs_wrr_term();
     dp_vs_wlc_term();
+    dp_vs_wll_term();
     dp_vs_conhash_term();    
     dp_vs_fo_term();
 
@@ -32,6 +32,9 @@
 #include "assert.h"
 #include "neigh.h"
 #include "ipset.h"
+#include "timer.h"
+#include "ipvs/wlc.h"
+#include "ipvs/hc.h"
 
 static int dp_vs_num_services = 0;
 
@@ -460,6 +463,7 @@ void __dp_vs_unbind_svc(struct dp_vs_dest *dest)
     dest->svc = NULL;
     if (rte_atomic32_dec_and_test(&svc->refcnt)) {
         dp_vs_del_stats(svc->stats);
+        dp_vs_lc_index_free(svc);
         if (svc->match)
             rte_free(svc->match);
         rte_free(svc);
@@ -548,6 +552,7 @@ out_err:
         if (svc->scheduler)
             dp_vs_unbind_scheduler(svc);
         dp_vs_del_stats(svc->stats);
+        dp_vs_lc_index_free(svc);
         if (svc->match)
             rte_free(svc->match);
         rte_free(svc);
@@ -644,6 +649,8 @@ static void __dp_vs_del_service(struct dp_vs_service *svc)
 
     dp_vs_blklst_flush(svc);
 
+    dp_vs_hc_flush(svc);
+
     /*
      *    Unlink the whole destination list
      */
@@ -658,6 +665,7 @@ static void __dp_vs_del_service(struct dp_vs_service *svc)
      */
     if (rte_atomic32_dec_and_test(&svc->refcnt)) {
         dp_vs_del_stats(svc->stats);
+        dp_vs_lc_index_free(svc);
         if (svc->match)
             rte_free(svc->match);
         rte_free(svc);
@@ -841,6 +849,7 @@ int dp_vs_zero_service(struct dp_vs_service *svc)
         dp_svc_stats_clear(dest->stats);
     }
     dp_svc_stats_clear(svc->stats);
+    memset(svc->shed, 0, sizeof(svc->shed));
     rte_rwlock_write_unlock(&__dp_vs_svc_lock);
     return EDPVS_OK;
 }
@@ -911,6 +920,10 @@ static void dp_vs_copy_udest_compat(struct dp_vs_dest_conf *udest,
     udest->weight     = udest_compat->weight;
     udest->max_conn   = udest_compat->max_conn;
     udest->min_conn   = udest_compat->min_conn;
+    udest->encap      = udest_compat->encap;
+    udest->vni        = udest_compat->vni;
+    udest->vtep       = udest_compat->vtep;
+    memcpy(udest->inner_dmac, udest_compat->inner_dmac, sizeof(udest->inner_dmac));
 }
 
 static int gratuitous_arp_send_vip(struct in_addr *vip)
@@ -1190,9 +1203,69 @@ struct dpvs_sockopts sockopts_svc = {
     .get            = dp_vs_get_svc,
 };
 
-int dp_vs_service_init(void)
+/*
+ * dest conn counters are per-lcore, sum them up periodically on master
+ * for the dests with thresholds, merge handshake RTT samples of dests
+ * for schedulers using RTT, and free unreferenced dests in trash.
+ * master is the only writer of the service table, so no lock is needed.
+ */
+#define DP_VS_DEST_AGGR_INTERVAL    100000  /* us */
+
+static struct dpvs_timer dp_vs_dest_aggr_timer;
+
+static void dp_vs_svc_dests_aggregate(struct dp_vs_service *svc)
+{
+    struct dp_vs_dest *dest;
+    uint64_t rtt = 0;
+    uint32_t n = 0;
+    bool need_rtt = svc->scheduler &&
+                    (svc->scheduler->flags & DP_VS_SCHED_F_RTT);
+
+    list_for_each_entry(dest, &svc->dests, n_list) {
+        if (dest->max_conn)
+            dp_vs_dest_conns_aggregate(dest);
+
+        if (!need_rtt)
+            continue;
+
+        dp_vs_dest_rtt_aggregate(dest);
+        if (dest->rtt_us) {
+            rtt += dest->rtt_us;
+            n++;
+        }
+    }
+
+    svc->rtt_us = n ? rtt / n : 0;
+}
+
+static int dp_vs_dest_aggr_timeout(void *arg __rte_unused)
 {
     int idx;
+    struct dp_vs_service *svc;
+
+    for (idx = 0; idx < DP_VS_SVC_TAB_SIZE; idx++) {
+        list_for_each_entry(svc, &dp_vs_svc_table[idx], s_list)
+            dp_vs_svc_dests_aggregate(svc);
+        list_for_each_entry(svc, &dp_vs_svc_fwm_table[idx], f_list)
+            dp_vs_svc_dests_aggregate(svc);
+    }
+
+    list_for_each_entry(svc, &dp_vs_svc_match_list, m_list)
+        dp_vs_svc_dests_aggregate(svc);
+
+    dp_vs_trash_sweep();
+
+    return DTIMER_OK;
+}
+
+int dp_vs_service_init(void)
+{
+    int idx, err;
+    struct timeval tv = {
+        .tv_sec = 0,
+        .tv_usec = DP_VS_DEST_AGGR_INTERVAL,
+    };
+
     for (idx = 0; idx < DP_VS_SVC_TAB_SIZE; idx++) {
         INIT_LIST_HEAD(&dp_vs_svc_table[idx]);
         INIT_LIST_HEAD(&dp_vs_svc_fwm_table[idx]);
@@ -1200,12 +1273,19 @@ int dp_vs_service_init(void)
     INIT_LIST_HEAD(&dp_vs_svc_match_list);
     rte_rwlock_init(&__dp_vs_svc_lock);
     dp_vs_dest_init();
+
+    err = dpvs_timer_sched_period(&dp_vs_dest_aggr_timer, &tv,
+                                  dp_vs_dest_aggr_timeout, NULL, true);
+    if (err != EDPVS_OK)
+        return err;
+
     sockopt_register(&sockopts_svc);
     return EDPVS_OK;
 }
 
 int dp_vs_service_term(void)
 {
+    dpvs_timer_cancel(&dp_vs_dest_aggr_timer, true);
     dp_vs_flush();
     dp_vs_dest_term();
     return EDPVS_OK;
@@ -0,0 +1,977 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "common.h"
+#include "netif.h"
+#include "ipvs/ipvs.h"
+#include "ipvs/conn.h"
+#include "ipvs/dest.h"
+#include "ipvs/sess_log.h"
+#include "parser/parser.h"
+#include "ctrl.h"
+#include "conf/sess_log.h"
+
+#define SESS_LOG_RING_SIZE_DEF      4096
+#define SESS_LOG_RING_SIZE_MIN      256
+#define SESS_LOG_BURST              64
+
+#define SESS_LOG_COLLECTOR_PORT     4739    /* IANA IPFIX port */
+#define SESS_LOG_TMPL_REFRESH_DEF   60      /* seconds */
+#define SESS_LOG_FLUSH_MS           1000
+
+/* IPFIX message size, fits in MTU 1500 with IPv6/UDP headers */
+#define IPFIX_MSG_MAX               1400
+#define IPFIX_VERSION               10
+#define IPFIX_SET_TEMPLATE          2
+#define IPFIX_TMPL_ID_BASE          256
+
+/* IANA IPFIX information elements */
+#define IPFIX_IE_PROTO              4
+#define IPFIX_IE_SPORT              7
+#define IPFIX_IE_SADDR4             8
+#define IPFIX_IE_DPORT              11
+#define IPFIX_IE_DADDR4             12
+#define IPFIX_IE_SADDR6             27
+#define IPFIX_IE_DADDR6             28
+#define IPFIX_IE_START_MS           152
+#define IPFIX_IE_END_MS             153
+#define IPFIX_IE_POST_SADDR4        225
+#define IPFIX_IE_POST_DADDR4        226
+#define IPFIX_IE_POST_SPORT         227
+#define IPFIX_IE_POST_DPORT         228
+#define IPFIX_IE_NAT_EVENT          230
+#define IPFIX_IE_INIT_OCTETS        231
+#define IPFIX_IE_RESP_OCTETS        232
+#define IPFIX_IE_POST_SADDR6        281
+#define IPFIX_IE_POST_DADDR6        282
+#define IPFIX_IE_INIT_PKTS          298
+#define IPFIX_IE_RESP_PKTS          299
+
+#define SESS_LOG_NFIELDS            16
+#define SESS_LOG_NTMPLS             4   /* inbound af x outbound af */
+
+struct ipfix_msg_hdr {
+    uint16_t    version;
+    uint16_t    length;
+    uint32_t    export_time;
+    uint32_t    seq;
+    uint32_t    domain_id;
+} __attribute__((__packed__));
+
+struct ipfix_set_hdr {
+    uint16_t    id;
+    uint16_t    length;
+} __attribute__((__packed__));
+
+struct ipfix_field {
+    uint16_t    id;
+    uint16_t    len;
+};
+
+struct sess_log_tmpl {
+    uint16_t            id;
+    uint16_t            nfields;
+    uint16_t            rec_len;
+    struct ipfix_field  fields[SESS_LOG_NFIELDS];
+};
+
+/*
+ * records are preallocated per lcore and cycle between two SPSC rings,
+ * @free from exporter to worker and @ring from worker to exporter.
+ */
+struct sess_log_lcore {
+    struct rte_ring     *ring;
+    struct rte_ring     *free;
+    struct dp_vs_sess_rec *recs;
+    uint64_t            logged;
+    uint64_t            dropped;
+} __rte_cache_aligned;
+
+bool dp_vs_sess_log_on = false;
+
+/* config */
+static bool sess_log_enable = false;
+static int sess_log_ring_size = SESS_LOG_RING_SIZE_DEF;
+static struct sockaddr_storage sess_log_collector;
+static char sess_log_file[256];
+static uint32_t sess_log_domain_id = 0;
+static int sess_log_tmpl_refresh = SESS_LOG_TMPL_REFRESH_DEF;
+
+static struct sess_log_lcore sess_log_lcores[DPVS_MAX_LCORE];
+static struct sess_log_tmpl sess_log_tmpls[SESS_LOG_NTMPLS];
+
+/* exporter states, only touched by the exporter */
+static lcoreid_t sess_log_exporter;
+static bool sess_log_launched = false;
+static volatile bool sess_log_stop = false;
+static int sess_log_sock = -1;
+static FILE *sess_log_fp = NULL;
+static uint64_t sess_log_base_ms;
+static uint64_t sess_log_base_cycles;
+static uint64_t sess_log_tmpl_cycles;
+static bool sess_log_tmpl_due = true;
+static uint32_t sess_log_seq = 0;
+static uint64_t sess_log_exported = 0;
+static uint64_t sess_log_send_err = 0;
+static uint64_t sess_log_dropped_reported = 0;
+
+static struct {
+    uint8_t     buf[IPFIX_MSG_MAX];
+    uint16_t    len;        /* 0 if no message open */
+    uint16_t    set_off;    /* open data set, 0 if none */
+    uint16_t    set_tmpl;
+    uint32_t    nrecs;
+    uint64_t    open_cycles;
+} sess_msg;
+
+extern lcoreid_t g_dpvs_log_core;
+extern bool g_dpvs_log_async_mode;
+
+/*
+ * worker side
+ */
+void __dp_vs_sess_log(const struct dp_vs_conn *conn, uint8_t event)
+{
+    lcoreid_t cid = rte_lcore_id();
+    struct sess_log_lcore *slc;
+    struct dp_vs_sess_rec *rec;
+
+    if (unlikely(cid >= DPVS_MAX_LCORE))
+        return;
+
+    slc = &sess_log_lcores[cid];
+    if (unlikely(!slc->ring))
+        return;
+
+    /* all records in flight, exporter is behind */
+    if (unlikely(rte_ring_sc_dequeue(slc->free, (void **)&rec) != 0)) {
+        slc->dropped++;
+        return;
+    }
+
+    rec->ctime = conn->ctime;
+    rec->etime = event == DPVS_SESS_LOG_DELETE ? rte_rdtsc() : 0;
+    rec->inpkts = conn->stats.inpkts.cnt;
+    rec->inbytes = conn->stats.inbytes.cnt;
+    rec->outpkts = conn->stats.outpkts.cnt;
+    rec->outbytes = conn->stats.outbytes.cnt;
+    rec->caddr = conn->caddr;
+    rec->vaddr = conn->vaddr;
+    rec->cport = conn->cport;
+    rec->vport = conn->vport;
+    if (conn->dest && conn->dest->fwdmode == DPVS_FWD_MODE_FNAT) {
+        rec->laddr = conn->laddr;
+        rec->lport = conn->lport;
+    } else {
+        rec->laddr = conn->caddr;
+        rec->lport = conn->cport;
+    }
+    rec->daddr = conn->daddr;
+    rec->dport = conn->dport;
+    rec->event = event;
+    rec->iaf = tuplehash_in(conn).af;
+    rec->oaf = tuplehash_out(conn).af;
+    rec->proto = conn->proto;
+
+    /* never fails, the ring has room for all records of the lcore */
+    rte_ring_sp_enqueue(slc->ring, rec);
+    slc->logged++;
+}
+
+/*
+ * exporter side
+ */
+static inline int sess_log_tmpl_index(int iaf, int oaf)
+{
+    return (iaf == AF_INET6 ? 2 : 0) + (oaf == AF_INET6 ? 1 : 0);
+}
+
+static void sess_log_tmpl_build(struct sess_log_tmpl *t, int iaf, int oaf)
+{
+    bool i6 = (iaf == AF_INET6), o6 = (oaf == AF_INET6);
+    uint16_t ilen = i6 ? 16 : 4, olen = o6 ? 16 : 4;
+    const struct ipfix_field fields[SESS_LOG_NFIELDS] = {
+        { IPFIX_IE_START_MS,    8 },
+        { IPFIX_IE_END_MS,      8 },
+        { IPFIX_IE_NAT_EVENT,   1 },
+        { IPFIX_IE_PROTO,       1 },
+        { i6 ? IPFIX_IE_SADDR6 : IPFIX_IE_SADDR4, ilen },
+        { i6 ? IPFIX_IE_DADDR6 : IPFIX_IE_DADDR4, ilen },
+        { IPFIX_IE_SPORT,       2 },
+        { IPFIX_IE_DPORT,       2 },
+        { o6 ? IPFIX_IE_POST_SADDR6 : IPFIX_IE_POST_SADDR4, olen },
+        { o6 ? IPFIX_IE_POST_DADDR6 : IPFIX_IE_POST_DADDR4, olen },
+        { IPFIX_IE_POST_SPORT,  2 },
+        { IPFIX_IE_POST_DPORT,  2 },
+        { IPFIX_IE_INIT_OCTETS, 8 },
+        { IPFIX_IE_INIT_PKTS,   8 },
+        { IPFIX_IE_RESP_OCTETS, 8 },
+        { IPFIX_IE_RESP_PKTS,   8 },
+    };
+    int i;
+
+    t->id = IPFIX_TMPL_ID_BASE + sess_log_tmpl_index(iaf, oaf);
+    t->nfields = SESS_LOG_NFIELDS;
+    t->rec_len = 0;
+    for (i = 0; i < SESS_LOG_NFIELDS; i++) {
+        t->fields[i] = fields[i];
+        t->rec_len += fields[i].len;
+    }
+}
+
+static inline uint64_t sess_log_cycles_to_ms(uint64_t cycles)
+{
+    uint64_t hz = rte_get_tsc_hz();
+    uint64_t delta;
+
+    if (!cycles)
+        return 0;
+
+    /* records created before exporter start are clamped */
+    delta = cycles > sess_log_base_cycles ? cycles - sess_log_base_cycles : 0;
+    return sess_log_base_ms + delta / hz * 1000 + delta % hz * 1000 / hz;
+}
+
+static inline uint8_t *ipfix_put16(uint8_t *p, uint16_t v)
+{
+    v = rte_cpu_to_be_16(v);
+    memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
+}
+
+static inline uint8_t *ipfix_put64(uint8_t *p, uint64_t v)
+{
+    v = rte_cpu_to_be_64(v);
+    memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
+}
+
+static void sess_log_rec_encode(uint8_t *p, const struct sess_log_tmpl *t,
+                                const struct dp_vs_sess_rec *rec)
+{
+    const struct ipfix_field *f;
+    int i;
+
+    for (i = 0; i < t->nfields; i++) {
+        f = &t->fields[i];
+        switch (f->id) {
+        case IPFIX_IE_START_MS:
+            ipfix_put64(p, sess_log_cycles_to_ms(rec->ctime));
+            break;
+        case IPFIX_IE_END_MS:
+            ipfix_put64(p, sess_log_cycles_to_ms(rec->etime));
+            break;
+        case IPFIX_IE_NAT_EVENT:
+            *p = rec->event;
+            break;
+        case IPFIX_IE_PROTO:
+            *p = rec->proto;
+            break;
+        case IPFIX_IE_SADDR4:
+        case IPFIX_IE_SADDR6:
+            memcpy(p, &rec->caddr, f->len);
+            break;
+        case IPFIX_IE_DADDR4:
+        case IPFIX_IE_DADDR6:
+            memcpy(p, &rec->vaddr, f->len);
+            break;
+        case IPFIX_IE_SPORT:
+            memcpy(p, &rec->cport, f->len);
+            break;
+        case IPFIX_IE_DPORT:
+            memcpy(p, &rec->vport, f->len);
+            break;
+        case IPFIX_IE_POST_SADDR4:
+        case IPFIX_IE_POST_SADDR6:
+            memcpy(p, &rec->laddr, f->len);
+            break;
+        case IPFIX_IE_POST_DADDR4:
+        case IPFIX_IE_POST_DADDR6:
+            memcpy(p, &rec->daddr, f->len);
+            break;
+        case IPFIX_IE_POST_SPORT:
+            memcpy(p, &rec->lport, f->len);
+            break;
+        case IPFIX_IE_POST_DPORT:
+            memcpy(p, &rec->dport, f->len);
+            break;
+        case IPFIX_IE_INIT_OCTETS:
+            ipfix_put64(p, rec->inbytes);
+            break;
+        case IPFIX_IE_INIT_PKTS:
+            ipfix_put64(p, rec->inpkts);
+            break;
+        case IPFIX_IE_RESP_OCTETS:
+            ipfix_put64(p, rec->outbytes);
+            break;
+        case IPFIX_IE_RESP_PKTS:
+            ipfix_put64(p, rec->outpkts);
+            break;
+        default:
+            memset(p, 0, f->len);
+            break;
+        }
+        p += f->len;
+    }
+}
+
+static void sess_log_set_close(void)
+{
+    struct ipfix_set_hdr *sh;
+
+    if (!sess_msg.set_off)
+        return;
+
+    sh = (struct ipfix_set_hdr *)(sess_msg.buf + sess_msg.set_off);
+    sh->length = htons(sess_msg.len - sess_msg.set_off);
+    sess_msg.set_off = 0;
+}
+
+static void sess_log_flush(void)
+{
+    struct ipfix_msg_hdr *mh = (struct ipfix_msg_hdr *)sess_msg.buf;
+    struct timeval tv;
+
+    if (!sess_msg.len)
+        return;
+
+    sess_log_set_close();
+
+    gettimeofday(&tv, NULL);
+    mh->version = htons(IPFIX_VERSION);
+    mh->length = htons(sess_msg.len);
+    mh->export_time = htonl((uint32_t)tv.tv_sec);
+    mh->seq = htonl(sess_log_seq);
+    mh->domain_id = htonl(sess_log_domain_id);
+
+    if (sess_log_sock >= 0) {
+        if (send(sess_log_sock, sess_msg.buf, sess_msg.len, MSG_DONTWAIT) < 0)
+            sess_log_send_err++;
+    }
+
+    if (sess_log_fp) {
+        if (fwrite(sess_msg.buf, sess_msg.len, 1, sess_log_fp) != 1)
+            sess_log_send_err++;
+        fflush(sess_log_fp);
+    }
+
+    /* sequence counts data records, RFC 7011 section 3.1 */
+    sess_log_seq += sess_msg.nrecs;
+    sess_log_exported += sess_msg.nrecs;
+
+    sess_msg.len = 0;
+    sess_msg.nrecs = 0;
+}
+
+static void sess_log_msg_open(void)
+{
+    struct ipfix_set_hdr *sh;
+    const struct sess_log_tmpl *t;
+    uint8_t *p;
+    int i, j;
+
+    sess_msg.len = sizeof(struct ipfix_msg_hdr);
+    sess_msg.set_off = 0;
+    sess_msg.nrecs = 0;
+    sess_msg.open_cycles = rte_get_timer_cycles();
+
+    if (!sess_log_tmpl_due)
+        return;
+
+    /* templates go ahead of data in the same message */
+    sh = (struct ipfix_set_hdr *)(sess_msg.buf + sess_msg.len);
+    p = (uint8_t *)(sh + 1);
+    for (i = 0; i < SESS_LOG_NTMPLS; i++) {
+        t = &sess_log_tmpls[i];
+        p = ipfix_put16(p, t->id);
+        p = ipfix_put16(p, t->nfields);
+        for (j = 0; j < t->nfields; j++) {
+            p = ipfix_put16(p, t->fields[j].id);
+            p = ipfix_put16(p, t->fields[j].len);
+        }
+    }
+    sh->id = htons(IPFIX_SET_TEMPLATE);
+    sh->length = htons(p - (uint8_t *)sh);
+    sess_msg.len = p - sess_msg.buf;
+
+    sess_log_tmpl_due = false;
+    sess_log_tmpl_cycles = rte_get_timer_cycles();
+}
+
+static void sess_log_add(const struct dp_vs_sess_rec *rec)
+{
+    const struct sess_log_tmpl *t;
+    struct ipfix_set_hdr *sh;
+    uint16_t need;
+
+    t = &sess_log_tmpls[sess_log_tmpl_index(rec->iaf, rec->oaf)];
+
+    need = t->rec_len;
+    if (!sess_msg.set_off || sess_msg.set_tmpl != t->id)
+        need += sizeof(struct ipfix_set_hdr);
+
+    if (sess_msg.len && sess_msg.len + need > IPFIX_MSG_MAX)
+        sess_log_flush();
+
+    if (!sess_msg.len)
+        sess_log_msg_open();
+
+    if (!sess_msg.set_off || sess_msg.set_tmpl != t->id) {
+        sess_log_set_close();
+        sh = (struct ipfix_set_hdr *)(sess_msg.buf + sess_msg.len);
+        sh->id = htons(t->id);
+        sess_msg.set_off = sess_msg.len;
+        sess_msg.set_tmpl = t->id;
+        sess_msg.len += sizeof(struct ipfix_set_hdr);
+    }
+
+    sess_log_rec_encode(sess_msg.buf + sess_msg.len, t, rec);
+    sess_msg.len += t->rec_len;
+    sess_msg.nrecs++;
+}
+
+static void sess_log_report(void)
+{
+    uint64_t logged = 0, dropped = 0;
+    lcoreid_t cid;
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        logged += sess_log_lcores[cid].logged;
+        dropped += sess_log_lcores[cid].dropped;
+    }
+
+    if (dropped == sess_log_dropped_reported)
+        return;
+
+    RTE_LOG(WARNING, IPVS, "session log: logged %lu dropped %lu "
+            "exported %lu export-errors %lu\n",
+            logged, dropped, sess_log_exported, sess_log_send_err);
+    sess_log_dropped_reported = dropped;
+}
+
+static void sess_log_export(void)
+{
+    struct dp_vs_sess_rec *recs[SESS_LOG_BURST];
+    uint64_t now, hz = rte_get_timer_hz();
+    struct sess_log_lcore *slc;
+    lcoreid_t cid;
+    int i, n;
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        slc = &sess_log_lcores[cid];
+        if (!slc->ring)
+            continue;
+
+        n = rte_ring_sc_dequeue_burst(slc->ring, (void **)recs,
+                                      SESS_LOG_BURST, NULL);
+        for (i = 0; i < n; i++)
+            sess_log_add(recs[i]);
+
+        if (n > 0)
+            rte_ring_sp_enqueue_burst(slc->free, (void **)recs, n, NULL);
+    }
+
+    now = rte_get_timer_cycles();
+
+    if (sess_msg.len && now - sess_msg.open_cycles > hz * SESS_LOG_FLUSH_MS / 1000)
+        sess_log_flush();
+
+    /* UDP collectors may lose or restart, resend templates periodically */
+    if (now - sess_log_tmpl_cycles > hz * sess_log_tmpl_refresh) {
+        sess_log_tmpl_due = true;
+        sess_log_tmpl_cycles = now;
+        sess_log_report();
+    }
+}
+
+static int sess_log_exporter_loop(void *arg)
+{
+    while (!sess_log_stop)
+        sess_log_export();
+
+    sess_log_flush();
+    return EDPVS_OK;
+}
+
+void sess_log_process_on_master(void)
+{
+    if (dp_vs_sess_log_on && !sess_log_launched)
+        sess_log_export();
+}
+
+static int sess_log_output_open(void)
+{
+    struct timeval tv;
+    socklen_t salen;
+
+    if (sess_log_collector.ss_family) {
+        sess_log_sock = socket(sess_log_collector.ss_family, SOCK_DGRAM, 0);
+        if (sess_log_sock < 0) {
+            RTE_LOG(ERR, IPVS, "%s: fail to create socket: %s\n",
+                    __func__, strerror(errno));
+            return EDPVS_IO;
+        }
+
+        salen = sess_log_collector.ss_family == AF_INET6 ?
+            sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+        if (connect(sess_log_sock, (struct sockaddr *)&sess_log_collector,
+                    salen) < 0) {
+            RTE_LOG(ERR, IPVS, "%s: fail to connect collector: %s\n",
+                    __func__, strerror(errno));
+            close(sess_log_sock);
+            sess_log_sock = -1;
+            return EDPVS_IO;
+        }
+    }
+
+    if (sess_log_file[0]) {
+        sess_log_fp = fopen(sess_log_file, "ab");
+        if (!sess_log_fp) {
+            RTE_LOG(ERR, IPVS, "%s: fail to open %s: %s\n",
+                    __func__, sess_log_file, strerror(errno));
+            if (sess_log_sock >= 0) {
+                close(sess_log_sock);
+                sess_log_sock = -1;
+            }
+            return EDPVS_IO;
+        }
+    }
+
+    if (sess_log_sock < 0 && !sess_log_fp) {
+        RTE_LOG(ERR, IPVS, "%s: neither collector nor file configured\n",
+                __func__);
+        return EDPVS_INVAL;
+    }
+
+    /* wall clock base for TSC timestamps of records */
+    gettimeofday(&tv, NULL);
+    sess_log_base_cycles = rte_rdtsc();
+    sess_log_base_ms = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+
+    return EDPVS_OK;
+}
+
+static void sess_log_output_close(void)
+{
+    if (sess_log_sock >= 0) {
+        close(sess_log_sock);
+        sess_log_sock = -1;
+    }
+
+    if (sess_log_fp) {
+        fclose(sess_log_fp);
+        sess_log_fp = NULL;
+    }
+}
+
+void dp_vs_sess_log_start(void)
+{
+    lcoreid_t cid;
+
+    if (!dp_vs_sess_log_on)
+        return;
+
+    /* pick an idle lcore like the async log does, master if none */
+    sess_log_exporter = rte_get_master_lcore();
+    RTE_LCORE_FOREACH_SLAVE(cid) {
+        if (g_dpvs_log_async_mode && cid == g_dpvs_log_core)
+            continue;
+        if (rte_eal_get_lcore_state(cid) == FINISHED) {
+            rte_eal_wait_lcore(cid);
+            sess_log_exporter = cid;
+            break;
+        }
+    }
+
+    if (sess_log_exporter == rte_get_master_lcore()) {
+        RTE_LOG(WARNING, IPVS, "session log: no idle lcore, "
+                "export on master lcore\n");
+        return;
+    }
+
+    if (rte_eal_remote_launch(sess_log_exporter_loop, NULL,
+                              sess_log_exporter) != 0) {
+        RTE_LOG(WARNING, IPVS, "session log: fail to launch exporter on "
+                "lcore %d, export on master lcore\n", sess_log_exporter);
+        sess_log_exporter = rte_get_master_lcore();
+        return;
+    }
+
+    sess_log_launched = true;
+    RTE_LOG(INFO, IPVS, "session log: exporter on lcore %d\n",
+            sess_log_exporter);
+}
+
+static void sess_log_lcores_free(void)
+{
+    struct sess_log_lcore *slc;
+    lcoreid_t cid;
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        slc = &sess_log_lcores[cid];
+        if (slc->ring) {
+            rte_ring_free(slc->ring);
+            slc->ring = NULL;
+        }
+        if (slc->free) {
+            rte_ring_free(slc->free);
+            slc->free = NULL;
+        }
+        if (slc->recs) {
+            rte_free(slc->recs);
+            slc->recs = NULL;
+        }
+    }
+}
+
+static int sess_log_lcore_alloc(lcoreid_t cid)
+{
+    struct sess_log_lcore *slc = &sess_log_lcores[cid];
+    int socket = rte_lcore_to_socket_id(cid);
+    char name[32];
+    void *rec;
+    int i;
+
+    /* a ring of size N holds N - 1 objects */
+    slc->recs = rte_zmalloc_socket("sess_log_recs", (sess_log_ring_size - 1) *
+                                   sizeof(struct dp_vs_sess_rec),
+                                   RTE_CACHE_LINE_SIZE, socket);
+    if (!slc->recs)
+        return EDPVS_NOMEM;
+
+    snprintf(name, sizeof(name), "sess_log_ring_%d", cid);
+    slc->ring = rte_ring_create(name, sess_log_ring_size, socket,
+                                RING_F_SP_ENQ | RING_F_SC_DEQ);
+    if (!slc->ring)
+        return EDPVS_DPDKAPIFAIL;
+
+    snprintf(name, sizeof(name), "sess_log_free_%d", cid);
+    slc->free = rte_ring_create(name, sess_log_ring_size, socket,
+                                RING_F_SP_ENQ | RING_F_SC_DEQ);
+    if (!slc->free)
+        return EDPVS_DPDKAPIFAIL;
+
+    for (i = 0; i < sess_log_ring_size - 1; i++) {
+        rec = &slc->recs[i];
+        rte_ring_sp_enqueue(slc->free, rec);
+    }
+
+    return EDPVS_OK;
+}
+
+static int sess_log_sockopt_set(sockoptid_t opt, const void *in, size_t inlen)
+{
+    return EDPVS_NOTSUPP;
+}
+
+static int sess_log_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
+                                void **out, size_t *outsize)
+{
+    struct dp_vs_sess_log_param *param;
+    struct dp_vs_sess_log_stats *stats;
+    lcoreid_t cid;
+
+    if (opt != SOCKOPT_GET_SESS_LOG)
+        return EDPVS_NOTSUPP;
+    if (!out || !outsize)
+        return EDPVS_INVAL;
+
+    param = rte_zmalloc(NULL, sizeof(*param), 0);
+    if (!param)
+        return EDPVS_NOMEM;
+
+    param->enable = dp_vs_sess_log_on;
+    param->ring_size = sess_log_ring_size;
+    param->exported = sess_log_exported;
+    param->export_err = sess_log_send_err;
+
+    /* counters are only written by their own lcore */
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        if (!sess_log_lcores[cid].ring)
+            continue;
+        stats = &param->stats_cpus[cid];
+        stats->logged = sess_log_lcores[cid].logged;
+        stats->dropped = sess_log_lcores[cid].dropped;
+        stats->pending = rte_ring_count(sess_log_lcores[cid].ring);
+
+        param->stats.logged += stats->logged;
+        param->stats.dropped += stats->dropped;
+        param->stats.pending += stats->pending;
+    }
+
+    *out = param;
+    *outsize = sizeof(*param);
+
+    return EDPVS_OK;
+}
+
+static struct dpvs_sockopts sess_log_sockopts = {
+    .version        = SOCKOPT_VERSION,
+    .set_opt_min    = SOCKOPT_SET_SESS_LOG,
+    .set_opt_max    = SOCKOPT_SET_SESS_LOG,
+    .set            = sess_log_sockopt_set,
+    .get_opt_min    = SOCKOPT_GET_SESS_LOG,
+    .get_opt_max    = SOCKOPT_GET_SESS_LOG,
+    .get            = sess_log_sockopt_get,
+};
+
+int dp_vs_sess_log_init(void)
+{
+    lcoreid_t cid;
+    int err, nlcores = 0;
+
+    /* stats are always available, so "off" can be told from "dropping" */
+    err = sockopt_register(&sess_log_sockopts);
+    if (err != EDPVS_OK)
+        return err;
+
+    if (!sess_log_enable)
+        return EDPVS_OK;
+
+    sess_log_tmpl_build(&sess_log_tmpls[sess_log_tmpl_index(AF_INET, AF_INET)],
+                        AF_INET, AF_INET);
+    sess_log_tmpl_build(&sess_log_tmpls[sess_log_tmpl_index(AF_INET, AF_INET6)],
+                        AF_INET, AF_INET6);
+    sess_log_tmpl_build(&sess_log_tmpls[sess_log_tmpl_index(AF_INET6, AF_INET)],
+                        AF_INET6, AF_INET);
+    sess_log_tmpl_build(&sess_log_tmpls[sess_log_tmpl_index(AF_INET6, AF_INET6)],
+                        AF_INET6, AF_INET6);
+
+    /* records and rings on each lcore's socket, master included for conn flush */
+    RTE_LCORE_FOREACH(cid) {
+        if (cid >= DPVS_MAX_LCORE)
+            continue;
+        err = sess_log_lcore_alloc(cid);
+        if (err != EDPVS_OK)
+            goto errout;
+        nlcores++;
+    }
+
+    err = sess_log_output_open();
+    if (err != EDPVS_OK)
+        goto errout;
+
+    sess_log_tmpl_cycles = rte_get_timer_cycles();
+    dp_vs_sess_log_on = true;
+
+    RTE_LOG(INFO, IPVS, "session log: ring size %d on %d lcores\n",
+            sess_log_ring_size, nlcores);
+    return EDPVS_OK;
+
+errout:
+    sess_log_lcores_free();
+    sockopt_unregister(&sess_log_sockopts);
+    return err;
+}
+
+int dp_vs_sess_log_term(void)
+{
+    sockopt_unregister(&sess_log_sockopts);
+
+    if (!dp_vs_sess_log_on)
+        return EDPVS_OK;
+
+    dp_vs_sess_log_on = false;
+
+    if (sess_log_launched) {
+        sess_log_stop = true;
+        rte_eal_wait_lcore(sess_log_exporter);
+    } else {
+        sess_log_export();
+        sess_log_flush();
+    }
+
+    sess_log_output_close();
+    sess_log_lcores_free();
+
+    return EDPVS_OK;
+}
+
+/*
+ * config file
+ */
+static void sess_log_switch_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+
+    assert(str);
+
+    if (strcasecmp(str, "on") == 0)
+        sess_log_enable = true;
+    else if (strcasecmp(str, "off") == 0)
+        sess_log_enable = false;
+    else
+        RTE_LOG(WARNING, IPVS, "invalid session_log:switch %s\n", str);
+
+    RTE_LOG(INFO, IPVS, "session_log:switch = %s\n", sess_log_enable ? "on" : "off");
+
+    FREE_PTR(str);
+}
+
+static void sess_log_ring_size_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int ring_size;
+
+    assert(str);
+
+    ring_size = atoi(str);
+    if (ring_size < SESS_LOG_RING_SIZE_MIN) {
+        RTE_LOG(WARNING, IPVS, "invalid session_log:ring_size %s, using default %d\n",
+                str, SESS_LOG_RING_SIZE_DEF);
+        sess_log_ring_size = SESS_LOG_RING_SIZE_DEF;
+    } else {
+        is_power2(ring_size, 0, &ring_size);
+        RTE_LOG(INFO, IPVS, "session_log:ring_size = %d (round to 2^n)\n", ring_size);
+        sess_log_ring_size = ring_size;
+    }
+
+    FREE_PTR(str);
+}
+
+static void sess_log_collector_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    struct sockaddr_in *sin = (struct sockaddr_in *)&sess_log_collector;
+    struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&sess_log_collector;
+    uint16_t port = htons(SESS_LOG_COLLECTOR_PORT);
+
+    assert(str);
+
+    /* keep the port if it's configured before */
+    if (sess_log_collector.ss_family == AF_INET)
+        port = sin->sin_port;
+    else if (sess_log_collector.ss_family == AF_INET6)
+        port = sin6->sin6_port;
+
+    memset(&sess_log_collector, 0, sizeof(sess_log_collector));
+    if (inet_pton(AF_INET, str, &sin->sin_addr) == 1) {
+        sin->sin_family = AF_INET;
+        sin->sin_port = port;
+    } else if (inet_pton(AF_INET6, str, &sin6->sin6_addr) == 1) {
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port = port;
+    } else {
+        RTE_LOG(WARNING, IPVS, "invalid session_log:collector %s\n", str);
+        FREE_PTR(str);
+        return;
+    }
+
+    RTE_LOG(INFO, IPVS, "session_log:collector = %s\n", str);
+
+    FREE_PTR(str);
+}
+
+static void sess_log_collector_port_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int port;
+
+    assert(str);
+
+    port = atoi(str);
+    if (port <= 0 || port > 65535) {
+        RTE_LOG(WARNING, IPVS, "invalid session_log:collector_port %s\n", str);
+        FREE_PTR(str);
+        return;
+    }
+
+    if (sess_log_collector.ss_family == AF_INET6)
+        ((struct sockaddr_in6 *)&sess_log_collector)->sin6_port = htons(port);
+    else
+        ((struct sockaddr_in *)&sess_log_collector)->sin_port = htons(port);
+
+    RTE_LOG(INFO, IPVS, "session_log:collector_port = %d\n", port);
+
+    FREE_PTR(str);
+}
+
+static void sess_log_file_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+
+    assert(str);
+
+    snprintf(sess_log_file, sizeof(sess_log_file), "%s", str);
+    RTE_LOG(INFO, IPVS, "session_log:file = %s\n", sess_log_file);
+
+    FREE_PTR(str);
+}
+
+static void sess_log_domain_id_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+
+    assert(str);
+
+    sess_log_domain_id = strtoul(str, NULL, 10);
+    RTE_LOG(INFO, IPVS, "session_log:domain_id = %u\n", sess_log_domain_id);
+
+    FREE_PTR(str);
+}
+
+static void sess_log_tmpl_refresh_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int refresh;
+
+    assert(str);
+
+    refresh = atoi(str);
+    if (refresh > 0 && refresh <= 3600) {
+        sess_log_tmpl_refresh = refresh;
+    } else {
+        RTE_LOG(WARNING, IPVS, "invalid session_log:template_refresh %s, "
+                "using default %d\n", str, SESS_LOG_TMPL_REFRESH_DEF);
+        sess_log_tmpl_refresh = SESS_LOG_TMPL_REFRESH_DEF;
+    }
+    RTE_LOG(INFO, IPVS, "session_log:template_refresh = %d\n",
+            sess_log_tmpl_refresh);
+
+    FREE_PTR(str);
+}
+
+void sess_log_keyword_value_init(void)
+{
+    if (dpvs_state_get() == DPVS_STATE_INIT) {
+        /* KW_TYPE_INIT keyword */
+        sess_log_enable = false;
+        sess_log_ring_size = SESS_LOG_RING_SIZE_DEF;
+        memset(&sess_log_collector, 0, sizeof(sess_log_collector));
+        sess_log_file[0] = '\0';
+        sess_log_domain_id = 0;
+        sess_log_tmpl_refresh = SESS_LOG_TMPL_REFRESH_DEF;
+    }
+}
+
+void install_sess_log_keywords(void)
+{
+    install_keyword("switch", sess_log_switch_handler, KW_TYPE_INIT);
+    install_keyword("ring_size", sess_log_ring_size_handler, KW_TYPE_INIT);
+    install_keyword("collector", sess_log_collector_handler, KW_TYPE_INIT);
+    install_keyword("collector_port", sess_log_collector_port_handler, KW_TYPE_INIT);
+    install_keyword("file", sess_log_file_handler, KW_TYPE_INIT);
+    install_keyword("domain_id", sess_log_domain_id_handler, KW_TYPE_INIT);
+    install_keyword("template_refresh", sess_log_tmpl_refresh_handler, KW_TYPE_INIT);
+}
@@ -24,6 +24,7 @@
 #include "ipvs/dest.h"
 #include "ipvs/service.h"
 #include "ipvs/stats.h"
+#include "ipvs/sess_log.h"
 
 #define this_dpvs_stats             (dpvs_stats[rte_lcore_id()])
 #define this_dpvs_estats            (dpvs_estats[rte_lcore_id()])
@@ -229,6 +230,12 @@ int dp_vs_stats_in(struct dp_vs_conn *conn, struct rte_mbuf *mbuf)
 #ifdef CONFIG_DPVS_IPVS_STATS_DEBUG
     rte_atomic64_inc(&conn->stats.inpkts);
     rte_atomic64_add(&conn->stats.inbytes, mbuf->pkt_len);
+#else
+    /* conn is only accessed by its owner lcore, no atomic needed */
+    if (unlikely(dp_vs_sess_log_on)) {
+        conn->stats.inpkts.cnt++;
+        conn->stats.inbytes.cnt += mbuf->pkt_len;
+    }
 #endif
 
     this_dpvs_stats.inpkts++;
@@ -258,6 +265,12 @@ int dp_vs_stats_out(struct dp_vs_conn *conn, struct rte_mbuf *mbuf)
 #ifdef CONFIG_DPVS_IPVS_STATS_DEBUG
     rte_atomic64_inc(&conn->stats.outpkts);
     rte_atomic64_add(&conn->stats.outbytes, mbuf->pkt_len);
+#else
+    /* conn is only accessed by its owner lcore, no atomic needed */
+    if (unlikely(dp_vs_sess_log_on)) {
+        conn->stats.outpkts.cnt++;
+        conn->stats.outbytes.cnt += mbuf->pkt_len;
+    }
 #endif
 
     this_dpvs_stats.outpkts++;
@@ -275,6 +288,12 @@ void dp_vs_stats_conn(struct dp_vs_conn *conn)
     this_dpvs_stats.conns++;
 }
 
+/* ipvs counters of the calling lcore */
+void dp_vs_stats_lcore_get(struct dp_vs_stats *stats)
+{
+    *stats = this_dpvs_stats;
+}
+
 void dp_vs_estats_inc(enum dp_vs_estats_type field)
 {
     this_dpvs_estats.mibs[field]++;
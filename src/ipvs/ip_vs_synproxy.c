@@ -29,6 +29,7 @@
 #include "ipvs/proto.h"
 #include "ipvs/proto_tcp.h"
 #include "ipvs/blklst.h"
+#include "ipvs/overload.h"
 #include "parser/parser.h"
 
 /* synproxy controll variables */
@@ -691,7 +692,8 @@ int dp_vs_synproxy_syn_rcv(int af, struct rte_mbuf *mbuf,
     if (th->syn && !th->ack && !th->rst && !th->fin &&
             (svc = dp_vs_service_lookup(af, iph->proto,
                                         &iph->daddr, th->dest, 0, NULL, NULL, NULL)) &&
-            (svc->flags & DP_VS_SVC_F_SYNPROXY)) {
+            ((svc->flags & DP_VS_SVC_F_SYNPROXY) ||
+             dp_vs_overload_syncookie(svc))) {
         /* if service's weight is zero (non-active realserver),
          * do noting and drop the packet */
         if (svc->weight == 0) {
@@ -1229,6 +1231,7 @@ int dp_vs_synproxy_synack_rcv(struct rte_mbuf *mbuf, struct dp_vs_conn *cp,
             (cp->state == DPVS_TCP_S_SYN_SENT)) {
         cp->syn_proxy_seq.delta = ntohl(cp->syn_proxy_seq.isn) - ntohl(th->seq);
         cp->state = DPVS_TCP_S_ESTABLISHED;
+        dp_vs_conn_rtt_sample(cp);
         conn_timeout = dp_vs_get_conn_timeout(cp);
         if (unlikely((conn_timeout != 0) && (cp->proto == IPPROTO_TCP)))
             cp->timeout.tv_sec = conn_timeout;
@@ -1236,8 +1239,7 @@ int dp_vs_synproxy_synack_rcv(struct rte_mbuf *mbuf, struct dp_vs_conn *cp,
             cp->timeout.tv_sec = pp->timeout_table[cp->state];
         dpvs_time_rand_delay(&cp->timeout, 1000000);
         if (dest) {
-            rte_atomic32_inc(&dest->actconns);
-            rte_atomic32_dec(&dest->inactconns);
+            dp_vs_dest_conn_activate(dest);
             cp->flags &= ~DPVS_CONN_F_INACTIVE;
         }
 
@@ -0,0 +1,735 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * warm restart: save conns of workers to a file before DPVS is stopped
+ * and rebuild them in the new process.
+ *
+ * both are done by the master on request (dpip warm save|restore), which
+ * sends a msg to every worker and waits for all of them, so workers save
+ * or restore their own conn tables in parallel. restore is expected once
+ * services, dests and laddrs are configured again, a worker doesn't poll
+ * its rx queues until its part is done.
+ *
+ * a restored conn takes back its <lip:lport> (FNAT) or <vip:vport> (SNAT)
+ * from sa_pool, its dest counters and redirect, and expires as it would
+ * have done in the old process. conn templates, conns with packets held
+ * by synproxy and per-conn stats are not kept.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/vfs.h>
+#include "common.h"
+#include "dpdk.h"
+#include "netif.h"
+#include "timer.h"
+#include "ctrl.h"
+#include "parser/parser.h"
+#include "ipvs/ipvs.h"
+#include "ipvs/conn.h"
+#include "ipvs/dest.h"
+#include "ipvs/service.h"
+#include "ipvs/warm.h"
+
+#define WARM_FILE_DEF           "/mnt/huge/dpvs_conns"
+#define WARM_MAX_AGE_DEF        60      /* sec */
+#define WARM_MAX_AGE_MAX        3600
+
+/* config file */
+static char warm_file[256] = WARM_FILE_DEF;
+static int warm_max_age = WARM_MAX_AGE_DEF;
+
+static uint8_t warm_slave_nb;
+static uint64_t warm_slave_mask;
+
+enum {
+    WARM_JOB_COUNT  = 0,
+    WARM_JOB_SAVE,
+    WARM_JOB_RESTORE,
+};
+
+/* the job workers are doing, set by master before msgs are sent */
+static struct {
+    void                *base;          /* file mapped */
+    uint64_t            age_ms;         /* restore: age of the file */
+    uint32_t            counts[DPVS_MAX_LCORE];
+    struct dp_vs_warm_stats stats[DPVS_MAX_LCORE];
+} warm_job;
+
+static struct dp_vs_warm_report warm_report;
+
+static inline uint64_t warm_now_ms(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static inline uint32_t warm_cycles_to_us(uint64_t cycles)
+{
+    return cycles * 1000000 / rte_get_tsc_hz();
+}
+
+static inline struct dp_vs_warm_hdr *warm_hdr(void)
+{
+    return (struct dp_vs_warm_hdr *)warm_job.base;
+}
+
+static inline struct dp_vs_warm_conn *
+warm_section_conns(const struct dp_vs_warm_section *sec)
+{
+    return (struct dp_vs_warm_conn *)((char *)warm_job.base + sec->offset);
+}
+
+/*
+ * worker side
+ */
+struct warm_save_arg {
+    struct dp_vs_warm_section   *sec;
+    struct dp_vs_warm_conn      *conns;
+    struct dp_vs_warm_stats     *stats;
+};
+
+static int warm_save_conn(struct dp_vs_conn *conn, void *arg)
+{
+    struct warm_save_arg *sa = arg;
+    struct dp_vs_warm_conn *wc;
+    struct dp_vs_service *svc = conn->dest ? conn->dest->svc : NULL;
+    struct timeval left;
+
+    if (conn->syn_mbuf || conn->ack_num) {
+        sa->stats->skipped[DP_VS_WARM_SKIP_SYNPROXY]++;
+        return EDPVS_OK;
+    }
+    if (!svc) {
+        /* dest removed, it's in trash */
+        sa->stats->skipped[DP_VS_WARM_SKIP_NOSVC]++;
+        return EDPVS_OK;
+    }
+    if (dpvs_timer_remaining(&conn->timer, false, &left) != EDPVS_OK) {
+        sa->stats->skipped[DP_VS_WARM_SKIP_EXPIRED]++;
+        return EDPVS_OK;
+    }
+    if (sa->sec->nconns >= sa->sec->capacity) {
+        sa->stats->skipped[DP_VS_WARM_SKIP_NOROOM]++;
+        return EDPVS_OK;
+    }
+
+    wc = &sa->conns[sa->sec->nconns];
+    memset(wc, 0, sizeof(*wc));
+
+    wc->svc_af      = svc->af;
+    wc->svc_proto   = svc->proto;
+    wc->svc_addr    = svc->addr;
+    wc->svc_port    = svc->port;
+    wc->svc_fwmark  = svc->fwmark;
+    if (svc->match)
+        wc->svc_match = *svc->match;
+
+    wc->dest_af     = conn->dest->af;
+    wc->dest_addr   = conn->dest->addr;
+    wc->dest_port   = conn->dest->port;
+
+    wc->af          = conn->af;
+    wc->proto       = conn->proto;
+    wc->outwall     = conn->outwall;
+    wc->flags       = conn->flags;
+    wc->state       = conn->state;
+    wc->old_state   = conn->old_state;
+    wc->caddr       = conn->caddr;
+    wc->vaddr       = conn->vaddr;
+    wc->laddr       = conn->laddr;
+    wc->daddr       = conn->daddr;
+    wc->cport       = conn->cport;
+    wc->vport       = conn->vport;
+    wc->lport       = conn->lport;
+    wc->dport       = conn->dport;
+
+    wc->fnat_seq    = conn->fnat_seq;
+    wc->syn_proxy_seq = conn->syn_proxy_seq;
+    wc->rs_end_seq  = conn->rs_end_seq;
+    wc->rs_end_ack  = conn->rs_end_ack;
+
+    wc->timeout     = conn->timeout.tv_sec;
+    wc->expire_ms   = left.tv_sec * 1000 + left.tv_usec / 1000;
+
+    sa->sec->nconns++;
+    sa->stats->conns++;
+    return EDPVS_OK;
+}
+
+static int warm_lcore_save(lcoreid_t cid)
+{
+    struct warm_save_arg sa = {
+        .sec    = &warm_hdr()->sections[cid],
+        .stats  = &warm_job.stats[cid],
+    };
+
+    sa.conns = warm_section_conns(sa.sec);
+    return dp_vs_conn_walk(warm_save_conn, &sa);
+}
+
+/* DP_VS_WARM_SKIP_MAX if it's restored, or why it's skipped */
+static int warm_restore_conn(const struct dp_vs_warm_conn *wc)
+{
+    struct dp_vs_service *svc;
+    struct dp_vs_dest *dest;
+    struct timeval left;
+    uint64_t left_ms;
+    int err;
+
+    if (wc->expire_ms <= warm_job.age_ms)
+        return DP_VS_WARM_SKIP_EXPIRED;
+    left_ms = wc->expire_ms - warm_job.age_ms;
+    left.tv_sec = left_ms / 1000;
+    left.tv_usec = left_ms % 1000 * 1000;
+
+    svc = dp_vs_service_lookup(wc->svc_af, wc->svc_proto, &wc->svc_addr,
+                               wc->svc_port, wc->svc_fwmark, NULL,
+                               &wc->svc_match, NULL);
+    if (!svc)
+        return DP_VS_WARM_SKIP_NOSVC;
+
+    dest = dp_vs_lookup_dest(wc->dest_af, svc, &wc->dest_addr, wc->dest_port);
+    if (!dest) {
+        dp_vs_service_put(svc);
+        return DP_VS_WARM_SKIP_NODEST;
+    }
+
+    err = dp_vs_conn_restore(wc, dest, &left);
+    dp_vs_service_put(svc);
+
+    switch (err) {
+    case EDPVS_OK:
+        return DP_VS_WARM_SKIP_MAX;
+    case EDPVS_EXIST:
+        return DP_VS_WARM_SKIP_EXIST;
+    case EDPVS_RESOURCE:
+        return DP_VS_WARM_SKIP_NOLPORT;
+    default:
+        return DP_VS_WARM_SKIP_OTHER;
+    }
+}
+
+static int warm_lcore_restore(lcoreid_t cid)
+{
+    const struct dp_vs_warm_section *sec = &warm_hdr()->sections[cid];
+    const struct dp_vs_warm_conn *conns = warm_section_conns(sec);
+    struct dp_vs_warm_stats *stats = &warm_job.stats[cid];
+    uint32_t i;
+    int reason;
+
+    for (i = 0; i < sec->nconns; i++) {
+        reason = warm_restore_conn(&conns[i]);
+        if (reason == DP_VS_WARM_SKIP_MAX)
+            stats->conns++;
+        else
+            stats->skipped[reason]++;
+    }
+
+    return EDPVS_OK;
+}
+
+static int warm_msg_cb(struct dpvs_msg *msg)
+{
+    lcoreid_t cid = rte_lcore_id();
+    uint64_t start = rte_rdtsc();
+    int err;
+
+    assert(msg->len == sizeof(uint8_t));
+
+    switch (msg->data[0]) {
+    case WARM_JOB_COUNT:
+        warm_job.counts[cid] = dp_vs_conn_count_get();
+        return EDPVS_OK;
+    case WARM_JOB_SAVE:
+        err = warm_lcore_save(cid);
+        break;
+    case WARM_JOB_RESTORE:
+        err = warm_lcore_restore(cid);
+        break;
+    default:
+        return EDPVS_INVAL;
+    }
+
+    warm_job.stats[cid].usecs = warm_cycles_to_us(rte_rdtsc() - start);
+    return err;
+}
+
+/*
+ * master side
+ */
+
+/* run the job on all workers at once, wait for them to finish */
+static int warm_run(uint8_t job)
+{
+    struct dpvs_msg *msgs[DPVS_MAX_LCORE] = { NULL };
+    lcoreid_t cid;
+    int err, ret = EDPVS_OK;
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        if (!(warm_slave_mask & (1UL << cid)))
+            continue;
+
+        msgs[cid] = msg_make(MSG_TYPE_WARM, 0, DPVS_MSG_UNICAST,
+                             rte_lcore_id(), sizeof(job), &job);
+        if (!msgs[cid]) {
+            ret = EDPVS_NOMEM;
+            break;
+        }
+
+        /* a job may take longer than a blocking msg is waited for */
+        err = msg_send(msgs[cid], cid, DPVS_MSG_F_ASYNC, NULL);
+        if (err != EDPVS_OK) {
+            RTE_LOG(WARNING, IPVS, "%s: fail to send msg to lcore%d -- %s\n",
+                    __func__, cid, dpvs_strerror(err));
+            msg_destroy(&msgs[cid]);
+            ret = err;
+            break;
+        }
+    }
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        if (!msgs[cid])
+            continue;
+
+        while (!test_msg_flags(msgs[cid], DPVS_MSG_F_STATE_FIN|
+                               DPVS_MSG_F_STATE_DROP))
+            ; /* wait until msg processed */
+
+        if (test_msg_flags(msgs[cid], DPVS_MSG_F_STATE_DROP|
+                           DPVS_MSG_F_CALLBACK_FAIL)) {
+            RTE_LOG(WARNING, IPVS, "%s: job %d failed on lcore%d\n",
+                    __func__, job, cid);
+            ret = EDPVS_MSG_FAIL;
+        }
+        msg_destroy(&msgs[cid]);
+    }
+
+    return ret;
+}
+
+static void warm_report_done(uint8_t op, int result, uint64_t start)
+{
+    struct dp_vs_warm_stats *total = &warm_report.total;
+    lcoreid_t cid;
+    int i;
+
+    snprintf(warm_report.file, sizeof(warm_report.file), "%s", warm_file);
+    warm_report.op = op;
+    warm_report.result = result;
+    warm_report.time = time(NULL);
+    warm_report.usecs = warm_cycles_to_us(rte_rdtsc() - start);
+    warm_report.age_ms = op == DP_VS_WARM_OP_RESTORE ? warm_job.age_ms : 0;
+
+    memset(total, 0, sizeof(*total));
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        warm_report.lcores[cid] = warm_job.stats[cid];
+        total->conns += warm_job.stats[cid].conns;
+        for (i = 0; i < DP_VS_WARM_SKIP_MAX; i++)
+            total->skipped[i] += warm_job.stats[cid].skipped[i];
+        /* lcores run in parallel */
+        if (warm_job.stats[cid].usecs > total->usecs)
+            total->usecs = warm_job.stats[cid].usecs;
+    }
+}
+
+static inline uint32_t warm_skipped(const struct dp_vs_warm_stats *stats)
+{
+    uint32_t n = 0;
+    int i;
+
+    for (i = 0; i < DP_VS_WARM_SKIP_MAX; i++)
+        n += stats->skipped[i];
+    return n;
+}
+
+static int warm_save(void)
+{
+    struct dp_vs_warm_hdr *hdr;
+    struct statfs sfs;
+    uint64_t start = rte_rdtsc();
+    size_t size, offset;
+    lcoreid_t cid;
+    uint32_t n;
+    void *addr;
+    int fd, err;
+
+    memset(&warm_job, 0, sizeof(warm_job));
+
+    /* size sections by conns now, with room for new ones in between */
+    err = warm_run(WARM_JOB_COUNT);
+    if (err != EDPVS_OK)
+        goto out;
+
+    offset = RTE_ALIGN(sizeof(struct dp_vs_warm_hdr), RTE_CACHE_LINE_SIZE);
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        if (!(warm_slave_mask & (1UL << cid)))
+            continue;
+        n = warm_job.counts[cid];
+        warm_job.counts[cid] = n + n / 8 + 64;
+        offset += (size_t)warm_job.counts[cid] * sizeof(struct dp_vs_warm_conn);
+    }
+
+    fd = open(warm_file, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        RTE_LOG(ERR, IPVS, "%s: open %s: %s\n",
+                __func__, warm_file, strerror(errno));
+        err = EDPVS_SYSCALL;
+        goto out;
+    }
+
+    /* hugetlbfs takes whole huge pages only */
+    if (fstatfs(fd, &sfs) != 0 || sfs.f_bsize <= 0)
+        sfs.f_bsize = getpagesize();
+    size = RTE_ALIGN_CEIL(offset, (size_t)sfs.f_bsize);
+
+    if (ftruncate(fd, size) != 0) {
+        RTE_LOG(ERR, IPVS, "%s: ftruncate %s: %s\n",
+                __func__, warm_file, strerror(errno));
+        close(fd);
+        err = EDPVS_SYSCALL;
+        goto cleanup;
+    }
+
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        RTE_LOG(ERR, IPVS, "%s: mmap %s: %s\n",
+                __func__, warm_file, strerror(errno));
+        err = EDPVS_SYSCALL;
+        goto cleanup;
+    }
+
+    hdr = addr;
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic      = DP_VS_WARM_MAGIC;
+    hdr->version    = DP_VS_WARM_VERSION;
+    hdr->hdr_size   = sizeof(struct dp_vs_warm_hdr);
+    hdr->conn_size  = sizeof(struct dp_vs_warm_conn);
+
+    offset = RTE_ALIGN(sizeof(struct dp_vs_warm_hdr), RTE_CACHE_LINE_SIZE);
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        if (!(warm_slave_mask & (1UL << cid)))
+            continue;
+        hdr->sections[cid].offset = offset;
+        hdr->sections[cid].capacity = warm_job.counts[cid];
+        offset += (size_t)warm_job.counts[cid] * sizeof(struct dp_vs_warm_conn);
+    }
+
+    warm_job.base = addr;
+    err = warm_run(WARM_JOB_SAVE);
+    if (err == EDPVS_OK) {
+        hdr->saved_at = warm_now_ms();
+        rte_smp_wmb();
+        hdr->complete = 1;
+        msync(addr, size, MS_SYNC);
+    }
+    munmap(addr, size);
+    warm_job.base = NULL;
+
+cleanup:
+    /* a partial file is never restored */
+    if (err != EDPVS_OK)
+        unlink(warm_file);
+out:
+    warm_report_done(DP_VS_WARM_OP_SAVE, err, start);
+    if (err == EDPVS_OK)
+        RTE_LOG(INFO, IPVS, "warm restart: saved %u conns to %s in %u ms, "
+                "skipped %u\n", warm_report.total.conns, warm_file,
+                warm_report.usecs / 1000, warm_skipped(&warm_report.total));
+    else
+        RTE_LOG(ERR, IPVS, "warm restart: fail to save conns to %s -- %s\n",
+                warm_file, dpvs_strerror(err));
+    return err;
+}
+
+static int warm_file_check(const struct dp_vs_warm_hdr *hdr, size_t size)
+{
+    const struct dp_vs_warm_section *sec;
+    lcoreid_t cid;
+
+    if (size < sizeof(*hdr) || hdr->magic != DP_VS_WARM_MAGIC)
+        return EDPVS_INVAL;
+
+    if (hdr->version != DP_VS_WARM_VERSION ||
+            hdr->hdr_size != sizeof(struct dp_vs_warm_hdr) ||
+            hdr->conn_size != sizeof(struct dp_vs_warm_conn)) {
+        RTE_LOG(ERR, IPVS, "%s: version %u, sizes %u/%u of %s not supported\n",
+                __func__, hdr->version, hdr->hdr_size, hdr->conn_size,
+                warm_file);
+        return EDPVS_NOTSUPP;
+    }
+
+    if (!hdr->complete)
+        return EDPVS_INVAL;
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        sec = &hdr->sections[cid];
+        if (sec->nconns > sec->capacity || sec->offset > size ||
+                (size - sec->offset) / sizeof(struct dp_vs_warm_conn)
+                < sec->nconns)
+            return EDPVS_INVAL;
+    }
+
+    return EDPVS_OK;
+}
+
+static int warm_restore(void)
+{
+    const struct dp_vs_warm_hdr *hdr;
+    uint64_t start = rte_rdtsc(), now;
+    struct stat st;
+    lcoreid_t cid;
+    void *addr;
+    int fd, err;
+
+    memset(&warm_job, 0, sizeof(warm_job));
+
+    fd = open(warm_file, O_RDONLY);
+    if (fd < 0) {
+        RTE_LOG(ERR, IPVS, "%s: open %s: %s\n",
+                __func__, warm_file, strerror(errno));
+        err = errno == ENOENT ? EDPVS_NOTEXIST : EDPVS_SYSCALL;
+        goto out;
+    }
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(*hdr)) {
+        close(fd);
+        err = EDPVS_INVAL;
+        goto out;
+    }
+
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        RTE_LOG(ERR, IPVS, "%s: mmap %s: %s\n",
+                __func__, warm_file, strerror(errno));
+        err = EDPVS_SYSCALL;
+        goto out;
+    }
+
+    hdr = addr;
+    err = warm_file_check(hdr, st.st_size);
+    if (err != EDPVS_OK)
+        goto unmap;
+
+    now = warm_now_ms();
+    warm_job.age_ms = now > hdr->saved_at ? now - hdr->saved_at : 0;
+    if (warm_job.age_ms > (uint64_t)warm_max_age * 1000) {
+        RTE_LOG(ERR, IPVS, "%s: %s is saved %lu ms ago, older than %d s\n",
+                __func__, warm_file, warm_job.age_ms, warm_max_age);
+        err = EDPVS_INVAL;
+        goto unmap;
+    }
+
+    /* conns must be on the lcore they were, for fdir/rss of lports */
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        if (!(warm_slave_mask & (1UL << cid)))
+            warm_job.stats[cid].skipped[DP_VS_WARM_SKIP_NOLCORE] =
+                hdr->sections[cid].nconns;
+    }
+
+    warm_job.base = addr;
+    err = warm_run(WARM_JOB_RESTORE);
+    warm_job.base = NULL;
+
+unmap:
+    munmap(addr, st.st_size);
+    /* never restored twice, nor if it's not usable */
+    unlink(warm_file);
+out:
+    warm_report_done(DP_VS_WARM_OP_RESTORE, err, start);
+    if (err == EDPVS_OK)
+        RTE_LOG(INFO, IPVS, "warm restart: restored %u conns from %s "
+                "in %u ms, skipped %u\n", warm_report.total.conns,
+                warm_file, warm_report.usecs / 1000,
+                warm_skipped(&warm_report.total));
+    else
+        RTE_LOG(ERR, IPVS, "warm restart: fail to restore conns from %s "
+                "-- %s\n", warm_file, dpvs_strerror(err));
+    return err;
+}
+
+/*
+ * control plane
+ */
+static int warm_sockopt_set(sockoptid_t opt, const void *in, size_t inlen)
+{
+    switch (opt) {
+    case SOCKOPT_SET_WARM_SAVE:
+        return warm_save();
+    case SOCKOPT_SET_WARM_RESTORE:
+        return warm_restore();
+    default:
+        return EDPVS_NOTSUPP;
+    }
+}
+
+static int warm_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
+                            void **out, size_t *outsize)
+{
+    struct dp_vs_warm_report *report;
+
+    if (opt != SOCKOPT_GET_WARM_SHOW)
+        return EDPVS_NOTSUPP;
+    if (!out || !outsize)
+        return EDPVS_INVAL;
+
+    report = rte_malloc(NULL, sizeof(*report), 0);
+    if (!report)
+        return EDPVS_NOMEM;
+
+    *report = warm_report;
+    if (report->op == DP_VS_WARM_OP_NONE)
+        snprintf(report->file, sizeof(report->file), "%s", warm_file);
+    report->max_age = warm_max_age;
+
+    *out = report;
+    *outsize = sizeof(*report);
+    return EDPVS_OK;
+}
+
+static struct dpvs_sockopts warm_sockopts = {
+    .version        = SOCKOPT_VERSION,
+    .set_opt_min    = SOCKOPT_SET_WARM_SAVE,
+    .set_opt_max    = SOCKOPT_SET_WARM_RESTORE,
+    .set            = warm_sockopt_set,
+    .get_opt_min    = SOCKOPT_GET_WARM_SHOW,
+    .get_opt_max    = SOCKOPT_GET_WARM_SHOW,
+    .get            = warm_sockopt_get,
+};
+
+static int warm_msg_register(bool reg)
+{
+    struct dpvs_msg_type mt;
+    lcoreid_t cid;
+    int err, ret = EDPVS_OK;
+
+    memset(&mt, 0, sizeof(mt));
+    mt.type = MSG_TYPE_WARM;
+    mt.mode = DPVS_MSG_UNICAST;
+    mt.prio = MSG_PRIO_LOW;
+    mt.unicast_msg_cb = warm_msg_cb;
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        if (!(warm_slave_mask & (1UL << cid)))
+            continue;
+        mt.cid = cid;
+        err = reg ? msg_type_register(&mt) : msg_type_unregister(&mt);
+        if (err != EDPVS_OK) {
+            RTE_LOG(WARNING, IPVS, "%s: fail to %sregister msg on lcore%d "
+                    "-- %s\n", __func__, reg ? "" : "un", cid,
+                    dpvs_strerror(err));
+            ret = err;
+            if (reg)
+                break;
+        }
+    }
+
+    return ret;
+}
+
+int dp_vs_warm_init(void)
+{
+    int err;
+
+    netif_get_slave_lcores(&warm_slave_nb, &warm_slave_mask);
+
+    err = warm_msg_register(true);
+    if (err != EDPVS_OK) {
+        warm_msg_register(false);
+        return err;
+    }
+
+    err = sockopt_register(&warm_sockopts);
+    if (err != EDPVS_OK) {
+        warm_msg_register(false);
+        return err;
+    }
+
+    return EDPVS_OK;
+}
+
+int dp_vs_warm_term(void)
+{
+    sockopt_unregister(&warm_sockopts);
+    return warm_msg_register(false);
+}
+
+/*
+ * config file
+ */
+static void warm_file_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    size_t slen;
+
+    assert(str);
+
+    slen = strlen(str);
+    if (slen > 1 && slen < sizeof(warm_file) && str[0] == '/') {
+        RTE_LOG(INFO, IPVS, "warm_restart:file = %s\n", str);
+        snprintf(warm_file, sizeof(warm_file), "%s", str);
+    } else {
+        RTE_LOG(WARNING, IPVS, "invalid warm_restart:file %s, "
+                "using default %s\n", str, WARM_FILE_DEF);
+        snprintf(warm_file, sizeof(warm_file), "%s", WARM_FILE_DEF);
+    }
+
+    FREE_PTR(str);
+}
+
+static void warm_max_age_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int age;
+
+    assert(str);
+
+    age = atoi(str);
+    if (age > 0 && age <= WARM_MAX_AGE_MAX) {
+        warm_max_age = age;
+        RTE_LOG(INFO, IPVS, "warm_restart:max_age = %d\n", age);
+    } else {
+        RTE_LOG(WARNING, IPVS, "invalid warm_restart:max_age %s, "
+                "using default %d\n", str, WARM_MAX_AGE_DEF);
+        warm_max_age = WARM_MAX_AGE_DEF;
+    }
+
+    FREE_PTR(str);
+}
+
+void warm_keyword_value_init(void)
+{
+    /* KW_TYPE_NORMAL keyword */
+    snprintf(warm_file, sizeof(warm_file), "%s", WARM_FILE_DEF);
+    warm_max_age = WARM_MAX_AGE_DEF;
+}
+
+void install_warm_keywords(void)
+{
+    install_keyword("file", warm_file_handler, KW_TYPE_NORMAL);
+    install_keyword("max_age", warm_max_age_handler, KW_TYPE_NORMAL);
+}
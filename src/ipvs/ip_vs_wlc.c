@@ -17,65 +17,267 @@
  */
 #include "ipvs/wlc.h"
 
-static inline unsigned int dp_vs_wlc_dest_overhead(struct dp_vs_dest *dest)
+/*
+ * Least-Connection and Weighted Least-Connection Scheduling
+ *
+ * each lcore balances the conns it owns: it keeps a min-heap of dests
+ * keyed by
+ *                (dest overhead on this lcore) / dest->weight
+ * (no division for lc), and updates the key of a dest when one of its
+ * conns on this lcore is bound, changes state or expires. the master
+ * only bumps svc->lc_gen when dests change, and each lcore rebuilds its
+ * own heap on next schedule, so the heap is never written by others.
+ *
+ * the server with weight=0 is quiesced and will not receive any new
+ * connections, it stays in the heap with an invalid key.
+ */
+
+#define DP_VS_LC_KEY_INVALID        UINT64_MAX
+
+static inline uint64_t dp_vs_lc_key(const struct dp_vs_service *svc,
+                                    struct dp_vs_dest *dest, lcoreid_t cid)
+{
+    const struct dp_vs_dest_lcore *this = &dest->lcore[cid];
+    uint64_t overhead;
+
+    if (!dp_vs_dest_is_valid(dest))
+        return DP_VS_LC_KEY_INVALID;
+
+    overhead = ((uint64_t)RTE_MAX(this->actconns, 0) << 8) +
+               RTE_MAX(this->inactconns, 0);
+
+    if (svc->lc_weighted)
+        return (overhead << 16) / dp_vs_dest_get_weight(dest);
+    return overhead;
+}
+
+static inline void dp_vs_lc_set(struct dp_vs_lc_index *idx, uint32_t pos,
+                                const struct dp_vs_lc_node *node, lcoreid_t cid)
+{
+    idx->heap[pos] = *node;
+    node->dest->lcore[cid].lc_pos = pos;
+}
+
+static void dp_vs_lc_sift_up(struct dp_vs_lc_index *idx, uint32_t pos,
+                             lcoreid_t cid)
+{
+    struct dp_vs_lc_node node = idx->heap[pos];
+    uint32_t parent;
+
+    while (pos > 0) {
+        parent = (pos - 1) / 2;
+        if (idx->heap[parent].key <= node.key)
+            break;
+        dp_vs_lc_set(idx, pos, &idx->heap[parent], cid);
+        pos = parent;
+    }
+    dp_vs_lc_set(idx, pos, &node, cid);
+}
+
+static void dp_vs_lc_sift_down(struct dp_vs_lc_index *idx, uint32_t pos,
+                               lcoreid_t cid)
 {
-    return (rte_atomic32_read(&dest->actconns) << 8) +
-           rte_atomic32_read(&dest->inactconns);
+    struct dp_vs_lc_node node = idx->heap[pos];
+    uint32_t child;
+
+    while ((child = 2 * pos + 1) < idx->num) {
+        if (child + 1 < idx->num &&
+                idx->heap[child + 1].key < idx->heap[child].key)
+            child++;
+        if (node.key <= idx->heap[child].key)
+            break;
+        dp_vs_lc_set(idx, pos, &idx->heap[child], cid);
+        pos = child;
+    }
+    dp_vs_lc_set(idx, pos, &node, cid);
 }
 
-static struct dp_vs_dest *dp_vs_wlc_schedule(struct dp_vs_service *svc,
-                                             const struct rte_mbuf *mbuf)
+static int dp_vs_lc_rebuild(struct dp_vs_service *svc,
+                            struct dp_vs_lc_index *idx,
+                            lcoreid_t cid, uint32_t gen)
 {
-    struct dp_vs_dest *dest, *least;
-    unsigned int loh, doh;
+    struct dp_vs_lc_node *heap;
+    struct dp_vs_dest *dest;
+    uint32_t i, size;
 
-    /*
-     * We calculate the load of each dest server as follows:
-     *                (dest overhead) / dest->weight
-     *
-     * The server with weight=0 is quiesced and will not receive any
-     * new connections.
-     */
+    if (idx->size < svc->num_dests) {
+        size = RTE_MAX(svc->num_dests, idx->size * 2);
+        heap = rte_malloc_socket("dp_vs_lc_index", size * sizeof(*heap),
+                                 RTE_CACHE_LINE_SIZE, rte_socket_id());
+        if (unlikely(!heap))
+            return EDPVS_NOMEM;
+        rte_free(idx->heap);
+        idx->heap = heap;
+        idx->size = size;
+    }
 
+    idx->num = 0;
     list_for_each_entry(dest, &svc->dests, n_list) {
-        if (dp_vs_dest_is_valid(dest)) {
-            least = dest;
-            loh = dp_vs_wlc_dest_overhead(least);
-            goto nextstage;
-        }
+        if (unlikely(idx->num >= idx->size))
+            break;
+        idx->heap[idx->num].dest = dest;
+        idx->heap[idx->num].key = dp_vs_lc_key(svc, dest, cid);
+        dest->lcore[cid].lc_pos = idx->num;
+        idx->num++;
     }
+
+    for (i = idx->num / 2; i > 0; i--)
+        dp_vs_lc_sift_down(idx, i - 1, cid);
+
+    idx->gen = gen;
+    return EDPVS_OK;
+}
+
+void dp_vs_dest_load_changed(struct dp_vs_dest *dest)
+{
+    struct dp_vs_service *svc = dest->svc;
+    struct dp_vs_lc_index *idx;
+    lcoreid_t cid;
+    uint64_t key, old;
+    uint32_t pos;
+
+    if (!svc || !svc->lc_index)
+        return;
+
+    cid = rte_lcore_id();
+    idx = &svc->lc_index[cid];
+
+    /* stale index is rebuilt on next schedule */
+    if (idx->gen != rte_atomic32_read(&svc->lc_gen))
+        return;
+
+    pos = dest->lcore[cid].lc_pos;
+    if (unlikely(pos >= idx->num || idx->heap[pos].dest != dest))
+        return;
+
+    key = dp_vs_lc_key(svc, dest, cid);
+    old = idx->heap[pos].key;
+    idx->heap[pos].key = key;
+
+    if (key < old)
+        dp_vs_lc_sift_up(idx, pos, cid);
+    else if (key > old)
+        dp_vs_lc_sift_down(idx, pos, cid);
+}
+
+static struct dp_vs_dest *dp_vs_lc_schedule(struct dp_vs_service *svc,
+                                            const struct rte_mbuf *mbuf)
+{
+    lcoreid_t cid = rte_lcore_id();
+    struct dp_vs_lc_index *idx = &svc->lc_index[cid];
+    uint32_t gen = rte_atomic32_read(&svc->lc_gen);
+    struct dp_vs_lc_node *top;
+    uint32_t i;
+
+    if (unlikely(idx->gen != gen) &&
+            dp_vs_lc_rebuild(svc, idx, cid, gen) != EDPVS_OK) {
+        RTE_LOG(WARNING, SERVICE, "%s: no memory for lc index\n", __func__);
+        return NULL;
+    }
+
+    for (i = 0; i < idx->num; i++) {
+        top = &idx->heap[0];
+        if (top->key == DP_VS_LC_KEY_INVALID)
+            return NULL;
+        if (likely(dp_vs_dest_is_valid(top->dest)))
+            return top->dest;
+
+        /* overloaded since last update, drop it until next rebuild */
+        top->key = DP_VS_LC_KEY_INVALID;
+        dp_vs_lc_sift_down(idx, 0, cid);
+    }
+
     return NULL;
+}
 
-    /*
-     *    Find the destination with the least load.
-     */
-nextstage:
-    list_for_each_entry_continue(dest, &svc->dests, n_list) {
-        if (dest->flags & DPVS_DEST_F_OVERLOAD)
-            continue;
-        doh = dp_vs_wlc_dest_overhead(dest);
-        if (loh * rte_atomic16_read(&dest->weight) >
-            doh * rte_atomic16_read(&least->weight)) {
-            least = dest;
-            loh = doh;
-        }
+static int dp_vs_lc_init_index(struct dp_vs_service *svc, bool weighted)
+{
+    if (!svc->lc_index) {
+        /* kept until svc is freed, for dests may outlive the scheduler */
+        svc->lc_index = rte_zmalloc("dp_vs_lc_index",
+                sizeof(struct dp_vs_lc_index) * DPVS_MAX_LCORE,
+                RTE_CACHE_LINE_SIZE);
+        if (!svc->lc_index)
+            return EDPVS_NOMEM;
     }
 
-    return least;
+    svc->lc_weighted = weighted;
+    rte_atomic32_inc(&svc->lc_gen);
+    return EDPVS_OK;
+}
+
+static int dp_vs_lc_init_svc(struct dp_vs_service *svc)
+{
+    return dp_vs_lc_init_index(svc, false);
+}
+
+static int dp_vs_wlc_init_svc(struct dp_vs_service *svc)
+{
+    return dp_vs_lc_init_index(svc, true);
 }
 
+static int dp_vs_lc_update_svc(struct dp_vs_service *svc,
+        struct dp_vs_dest *dest __rte_unused, sockoptid_t opt __rte_unused)
+{
+    rte_atomic32_inc(&svc->lc_gen);
+    return EDPVS_OK;
+}
+
+static int dp_vs_lc_exit_svc(struct dp_vs_service *svc)
+{
+    /* stop updating on conn events */
+    rte_atomic32_inc(&svc->lc_gen);
+    return EDPVS_OK;
+}
+
+void dp_vs_lc_index_free(struct dp_vs_service *svc)
+{
+    int i;
+
+    if (!svc->lc_index)
+        return;
+
+    for (i = 0; i < DPVS_MAX_LCORE; i++)
+        rte_free(svc->lc_index[i].heap);
+    rte_free(svc->lc_index);
+    svc->lc_index = NULL;
+}
+
+static struct dp_vs_scheduler dp_vs_lc_scheduler = {
+    .name = "lc",
+    .n_list = LIST_HEAD_INIT(dp_vs_lc_scheduler.n_list),
+    .init_service = dp_vs_lc_init_svc,
+    .exit_service = dp_vs_lc_exit_svc,
+    .update_service = dp_vs_lc_update_svc,
+    .schedule = dp_vs_lc_schedule,
+};
+
 static struct dp_vs_scheduler dp_vs_wlc_scheduler = {
     .name = "wlc",
     .n_list = LIST_HEAD_INIT(dp_vs_wlc_scheduler.n_list),
-    .schedule = dp_vs_wlc_schedule,
+    .init_service = dp_vs_wlc_init_svc,
+    .exit_service = dp_vs_lc_exit_svc,
+    .update_service = dp_vs_lc_update_svc,
+    .schedule = dp_vs_lc_schedule,
 };
 
 int dp_vs_wlc_init(void)
 {
-    return register_dp_vs_scheduler(&dp_vs_wlc_scheduler);
+    int err;
+
+    err = register_dp_vs_scheduler(&dp_vs_lc_scheduler);
+    if (err != EDPVS_OK)
+        return err;
+
+    err = register_dp_vs_scheduler(&dp_vs_wlc_scheduler);
+    if (err != EDPVS_OK)
+        unregister_dp_vs_scheduler(&dp_vs_lc_scheduler);
+
+    return err;
 }
 
 int dp_vs_wlc_term(void)
 {
+    unregister_dp_vs_scheduler(&dp_vs_lc_scheduler);
     return unregister_dp_vs_scheduler(&dp_vs_wlc_scheduler);
 }
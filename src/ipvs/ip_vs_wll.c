@@ -0,0 +1,133 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include "ipvs/wll.h"
+
+/*
+ * Weighted Least-Latency Scheduling
+ *
+ * picks two dests at random and takes the one with lower
+ *
+ *          rtt * (dest overhead on this lcore + 1) / dest->weight
+ *
+ * rtt is the handshake RTT of dest, i.e. from the SYN sent to it until
+ * its SYN-ACK, sampled by lcores in FNAT/NAT and merged into an EWMA by
+ * master (see dp_vs_dest_rtt_aggregate). dests not sampled yet take the
+ * mean of the service. random pairs keep slow dests probed and avoid
+ * all lcores herding onto the same dest between two merges.
+ *
+ * overhead counts inactive conns, which include handshakes in progress,
+ * a quarter of active ones.
+ */
+
+static RTE_DEFINE_PER_LCORE(uint32_t, wll_seed);
+
+static inline uint32_t dp_vs_wll_rand(void)
+{
+    uint32_t x = RTE_PER_LCORE(wll_seed);
+
+    /* xorshift32 */
+    if (unlikely(!x))
+        x = (uint32_t)rte_rdtsc() | 1;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    RTE_PER_LCORE(wll_seed) = x;
+
+    return x;
+}
+
+static inline uint64_t dp_vs_wll_cost(const struct dp_vs_service *svc,
+                                      struct dp_vs_dest *dest)
+{
+    const struct dp_vs_dest_lcore *this = dp_vs_dest_this_lcore(dest);
+    uint64_t rtt, overhead;
+
+    rtt = dest->rtt_us ? : (svc->rtt_us ? : 1);
+    overhead = ((uint64_t)RTE_MAX(this->actconns, 0) << 2) +
+               RTE_MAX(this->inactconns, 0) + 1;
+
+    return rtt * overhead;
+}
+
+/* true if @a is less loaded than @b */
+static inline bool dp_vs_wll_less(const struct dp_vs_service *svc,
+                                  struct dp_vs_dest *a, struct dp_vs_dest *b)
+{
+    return dp_vs_wll_cost(svc, a) * dp_vs_dest_get_weight(b) <
+           dp_vs_wll_cost(svc, b) * dp_vs_dest_get_weight(a);
+}
+
+static struct dp_vs_dest *dp_vs_wll_schedule(struct dp_vs_service *svc,
+        const struct rte_mbuf *mbuf __rte_unused)
+{
+    struct dp_vs_dest *dest, *a = NULL, *b = NULL, *least = NULL;
+    uint32_t n = svc->num_dests, i, ia, ib;
+
+    if (unlikely(!n))
+        return NULL;
+
+    ia = dp_vs_wll_rand() % n;
+    ib = n > 1 ? (ia + 1 + dp_vs_wll_rand() % (n - 1)) % n : ia;
+
+    i = 0;
+    list_for_each_entry(dest, &svc->dests, n_list) {
+        if (i == ia)
+            a = dest;
+        if (i == ib)
+            b = dest;
+        if (++i > RTE_MAX(ia, ib))
+            break;
+    }
+
+    if (!dp_vs_dest_is_valid(a))
+        a = NULL;
+    if (!dp_vs_dest_is_valid(b))
+        b = NULL;
+
+    if (a && b)
+        return dp_vs_wll_less(svc, b, a) ? b : a;
+    if (a || b)
+        return a ? : b;
+
+    /* both unusable, look for the least of all */
+    list_for_each_entry(dest, &svc->dests, n_list) {
+        if (!dp_vs_dest_is_valid(dest))
+            continue;
+        if (!least || dp_vs_wll_less(svc, dest, least))
+            least = dest;
+    }
+
+    return least;
+}
+
+static struct dp_vs_scheduler dp_vs_wll_scheduler = {
+    .name     = "wll",
+    .flags    = DP_VS_SCHED_F_RTT,
+    .n_list   = LIST_HEAD_INIT(dp_vs_wll_scheduler.n_list),
+    .schedule = dp_vs_wll_schedule,
+};
+
+int dp_vs_wll_init(void)
+{
+    return register_dp_vs_scheduler(&dp_vs_wll_scheduler);
+}
+
+int dp_vs_wll_term(void)
+{
+    return unregister_dp_vs_scheduler(&dp_vs_wll_scheduler);
+}
@@ -28,6 +28,7 @@
 #include "neigh.h"
 #include "ipvs/xmit.h"
 #include "ipvs/nat64.h"
+#include "ipvs/encap.h"
 #include "parser/parser.h"
 
 static bool fast_xmit_close = false;
@@ -395,9 +396,11 @@ static int __dp_vs_xmit_fnat4(struct dp_vs_proto *proto,
     struct flow4 fl4;
     struct ipv4_hdr *iph = ip4_hdr(mbuf);
     struct route_entry *rt;
+    bool encap = dp_vs_dest_has_encap(conn->dest);
     int err, mtu;
 
-    if (!fast_xmit_close && !(conn->flags & DPVS_CONN_F_NOFASTXMIT)) {
+    if (!fast_xmit_close && !encap &&
+        !(conn->flags & DPVS_CONN_F_NOFASTXMIT)) {
         dp_vs_save_xmit_info(mbuf, proto, conn);
         if (!dp_vs_fast_xmit_fnat(AF_INET, proto, conn, mbuf)) {
             return EDPVS_OK;
@@ -415,8 +418,13 @@ static int __dp_vs_xmit_fnat4(struct dp_vs_proto *proto,
     }
 
     memset(&fl4, 0, sizeof(struct flow4));
-    fl4.fl4_daddr = conn->daddr.in;
-    fl4.fl4_saddr = conn->laddr.in;
+    if (encap) {
+        /* FNAT-over-overlay, route to the VTEP of RS */
+        fl4.fl4_daddr = conn->dest->encap.vtep.in;
+    } else {
+        fl4.fl4_daddr = conn->daddr.in;
+        fl4.fl4_saddr = conn->laddr.in;
+    }
     fl4.fl4_tos = iph->type_of_service;
     rt = route4_output(&fl4);
     if (!rt) {
@@ -431,7 +439,7 @@ static int __dp_vs_xmit_fnat4(struct dp_vs_proto *proto,
      */
     dp_vs_conn_cache_rt(conn, rt, true);
 
-    mtu = rt->mtu;
+    mtu = rt->mtu - conn->dest->encap.hlen;
     if (mbuf->pkt_len > mtu
             && (iph->fragment_offset & htons(IPV4_HDR_DF_FLAG))) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
@@ -484,6 +492,9 @@ static int __dp_vs_xmit_fnat4(struct dp_vs_proto *proto,
         ip4_send_csum(iph);
     }
 
+    if (encap)
+        return dp_vs_encap_xmit(conn, mbuf);
+
     return INET_HOOK(AF_INET, INET_HOOK_LOCAL_OUT, mbuf,
                      NULL, rt->port, ipv4_output);
 
@@ -501,9 +512,11 @@ static int __dp_vs_xmit_fnat6(struct dp_vs_proto *proto,
     struct flow6 fl6;
     struct ip6_hdr *ip6h = ip6_hdr(mbuf);
     struct route6 *rt6;
+    bool encap = dp_vs_dest_has_encap(conn->dest);
     int err, mtu;
 
-    if (!fast_xmit_close && !(conn->flags & DPVS_CONN_F_NOFASTXMIT)) {
+    if (!fast_xmit_close && !encap &&
+        !(conn->flags & DPVS_CONN_F_NOFASTXMIT)) {
         dp_vs_save_xmit_info(mbuf, proto, conn);
         if (!dp_vs_fast_xmit_fnat(AF_INET6, proto, conn, mbuf)) {
             return EDPVS_OK;
@@ -521,8 +534,13 @@ static int __dp_vs_xmit_fnat6(struct dp_vs_proto *proto,
     }
 
     memset(&fl6, 0, sizeof(struct flow6));
-    fl6.fl6_daddr = conn->daddr.in6;
-    fl6.fl6_saddr = conn->laddr.in6;
+    if (encap) {
+        /* FNAT-over-overlay, route to the VTEP of RS */
+        fl6.fl6_daddr = conn->dest->encap.vtep.in6;
+    } else {
+        fl6.fl6_daddr = conn->daddr.in6;
+        fl6.fl6_saddr = conn->laddr.in6;
+    }
     rt6 = route6_output(mbuf, &fl6);
     if (!rt6) {
         err = EDPVS_NOROUTE;
@@ -537,8 +555,8 @@ static int __dp_vs_xmit_fnat6(struct dp_vs_proto *proto,
     dp_vs_conn_cache_rt6(conn, rt6, true);
 
     // check mtu
-    mtu = rt6->rt6_mtu;
-    if (mbuf->pkt_len > mtu) {
+    mtu = rt6->rt6_mtu - conn->dest->encap.hlen;
+    if (ip6_pkt_toobig(mbuf, mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, mtu);
 
@@ -583,6 +601,9 @@ static int __dp_vs_xmit_fnat6(struct dp_vs_proto *proto,
             goto errout;
     }
 
+    if (encap)
+        return dp_vs_encap_xmit(conn, mbuf);
+
     return INET_HOOK(AF_INET6, INET_HOOK_LOCAL_OUT, mbuf,
                      NULL, rt6->rt6_dev, ip6_output);
 
@@ -633,10 +654,12 @@ static int __dp_vs_xmit_fnat64(struct dp_vs_proto *proto,
     /*
      * mbuf is from IPv6, icmp should send by icmp6
      * ext_hdr and
+     * compare in IPv6 size, so that reassembled datagrams are checked
+     * by their largest fragment and refragmented by ipv4_output.
      */
-    mtu = rt->mtu;
     pkt_len = mbuf_nat6to4_len(mbuf);
-    if (pkt_len > mtu) {
+    mtu = rt->mtu + (mbuf->pkt_len - pkt_len);
+    if (ip6_pkt_toobig(mbuf, mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, mtu);
 
@@ -669,6 +692,10 @@ static int __dp_vs_xmit_fnat64(struct dp_vs_proto *proto,
     ip4h = ip4_hdr(mbuf);
     ip4h->hdr_checksum = 0;
 
+    /* client sent fragments, let IPv4 fragment it too [RFC 7915, 5.1.1] */
+    if (mbuf->ol_flags & PKT_RX_LRO)
+        ip4h->fragment_offset = 0;
+
     /* L4 FNAT translation */
     if (proto->fnat_in_handler) {
         err = proto->fnat_in_handler(proto, conn, mbuf);
@@ -856,7 +883,7 @@ static int __dp_vs_out_xmit_fnat6(struct dp_vs_proto *proto,
     dp_vs_conn_cache_rt6(conn, rt6, false);
 
     mtu = rt6->rt6_mtu;
-    if (mbuf->pkt_len > mtu) {
+    if (ip6_pkt_toobig(mbuf, mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(mtu));
         err = EDPVS_FRAG;
@@ -1302,7 +1329,7 @@ static int __dp_vs_xmit_dr6(struct dp_vs_proto *proto,
     dp_vs_conn_cache_rt6(conn, rt6, true);
 
     mtu = rt6->rt6_mtu;
-    if (mbuf->pkt_len > mtu) {
+    if (ip6_pkt_toobig(mbuf, mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(mtu));
         err = EDPVS_FRAG;
@@ -1454,7 +1481,7 @@ static int __dp_vs_xmit_snat6(struct dp_vs_proto *proto,
     dp_vs_conn_cache_rt6(conn, rt6, true);
 
     mtu = rt6->rt6_mtu;
-    if (mbuf->pkt_len > mtu) {
+    if (ip6_pkt_toobig(mbuf, mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(mtu));
         err = EDPVS_FRAG;
@@ -1701,7 +1728,7 @@ static int __dp_vs_out_xmit_snat6(struct dp_vs_proto *proto,
         dp_vs_conn_cache_rt6(conn, rt6, false);
     }
 
-    if (mbuf->pkt_len > rt6->rt6_mtu) {
+    if (ip6_pkt_toobig(mbuf, rt6->rt6_mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(rt6->rt6_mtu));
         err = EDPVS_FRAG;
@@ -1870,7 +1897,7 @@ static int __dp_vs_xmit_nat6(struct dp_vs_proto *proto,
     dp_vs_conn_cache_rt6(conn, rt6, true);
 
     mtu = rt6->rt6_mtu;
-    if (mbuf->pkt_len > mtu) {
+    if (ip6_pkt_toobig(mbuf, mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(mtu));
         err = EDPVS_FRAG;
@@ -2042,7 +2069,7 @@ static int __dp_vs_out_xmit_nat6(struct dp_vs_proto *proto,
     dp_vs_conn_cache_rt6(conn, rt6, false);
 
     mtu = rt6->rt6_mtu;
-    if (mbuf->pkt_len > mtu) {
+    if (ip6_pkt_toobig(mbuf, mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(mtu));
         err = EDPVS_FRAG;
@@ -2221,7 +2248,7 @@ static int __dp_vs_xmit_tunnel6(struct dp_vs_proto *proto,
         goto errout;
     }
 
-    if (mbuf->pkt_len > mtu) {
+    if (ip6_pkt_toobig(mbuf, mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(mtu));
         err = EDPVS_FRAG;
@@ -2363,6 +2390,99 @@ int dp_vs_xmit_tunnel(struct dp_vs_proto *proto,
     return __dp_vs_xmit_tunnel_6o4(proto, conn, mbuf);
 }
 
+/*
+ * OVERLAY mode, like TUNNEL the packet is not modified but carried to
+ * RS inside VXLAN/GENEVE towards its VTEP, RS replies client directly.
+ * the outer headers are pre-built per dest, see ip_vs_encap.c.
+ */
+int dp_vs_xmit_overlay(struct dp_vs_proto *proto,
+                       struct dp_vs_conn *conn,
+                       struct rte_mbuf *mbuf)
+{
+    struct dp_vs_dest *dest = conn->dest;
+    int iaf = tuplehash_in(conn).af;
+    struct route_entry *rt = NULL;
+    struct route6 *rt6 = NULL;
+    int err, mtu;
+
+    assert(iaf == AF_INET || iaf == AF_INET6);
+
+    /*
+     * drop old route. just for safe, because
+     * OVERLAY is PREROUTING, should not have route.
+     */
+    if (unlikely(mbuf->userdata != NULL)) {
+        RTE_LOG(WARNING, IPVS, "%s: OVERLAY have route %p ?\n",
+                __func__, mbuf->userdata);
+        if (iaf == AF_INET)
+            route4_put((struct route_entry *)mbuf->userdata);
+        else
+            route6_put((struct route6 *)mbuf->userdata);
+        mbuf->userdata = NULL;
+    }
+
+    if (dest->af == AF_INET) {
+        struct flow4 fl4;
+
+        memset(&fl4, 0, sizeof(struct flow4));
+        fl4.fl4_daddr = dest->encap.vtep.in;
+        rt = route4_output(&fl4);
+        if (!rt) {
+            err = EDPVS_NOROUTE;
+            goto errout;
+        }
+
+        dp_vs_conn_cache_rt(conn, rt, true);
+        mtu = rt->mtu;
+    } else {
+        struct flow6 fl6;
+
+        memset(&fl6, 0, sizeof(struct flow6));
+        fl6.fl6_daddr = dest->encap.vtep.in6;
+        rt6 = route6_output(mbuf, &fl6);
+        if (!rt6) {
+            err = EDPVS_NOROUTE;
+            goto errout;
+        }
+
+        dp_vs_conn_cache_rt6(conn, rt6, true);
+        mtu = rt6->rt6_mtu;
+    }
+
+    mtu -= dest->encap.hlen;
+    if (mbuf->pkt_len > mtu) {
+        if (iaf == AF_INET) {
+            if (ip4_hdr(mbuf)->fragment_offset & htons(IPV4_HDR_DF_FLAG)) {
+                RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
+                icmp_send(mbuf, ICMP_DEST_UNREACH, ICMP_UNREACH_NEEDFRAG,
+                          htonl(mtu));
+                err = EDPVS_FRAG;
+                goto errout;
+            }
+        } else if (ip6_pkt_toobig(mbuf, mtu)) {
+            RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
+            icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(mtu));
+            err = EDPVS_FRAG;
+            goto errout;
+        }
+    }
+
+    if (rt)
+        mbuf->userdata = rt;
+    else
+        mbuf->userdata = rt6;
+
+    return dp_vs_encap_xmit(conn, mbuf);
+
+errout:
+    if (rt)
+        route4_put(rt);
+    if (rt6)
+        route6_put(rt6);
+    rte_pktmbuf_free(mbuf);
+    return err;
+}
+
 static void conn_fast_xmit_handler(vector_t tockens)
 {
     RTE_LOG(INFO, IPVS, "fast xmit OFF\n");
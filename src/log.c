@@ -1,4 +1,5 @@
 #include <string.h>
+#include <ctype.h>
 #include <syslog.h>
 #include <rte_mempool.h>
 #include <signal.h>
@@ -21,6 +22,39 @@ static struct rte_mempool *dp_vs_log_pool;
 static int log_pool_size  = DPVS_LOG_POOL_SIZE_DEF;
 static int log_pool_cache = DPVS_LOG_CACHE_SIZE_DEF;
 
+/* binary log */
+#define BLOG_BURST  64
+
+enum {
+    BLOG_ARG_NONE = 0,      /* "%%" */
+    BLOG_ARG_INT,
+    BLOG_ARG_LONG,
+    BLOG_ARG_LLONG,
+    BLOG_ARG_PTR,
+    BLOG_ARG_STR,
+    BLOG_ARG_DOUBLE,
+};
+
+enum {
+    BLOG_SITE_NEW = 0,
+    BLOG_SITE_BUSY,         /* being registered */
+    BLOG_SITE_READY,
+    BLOG_SITE_TEXT,         /* format not supported, use text log */
+};
+
+struct blog_lcore {
+    struct rte_ring *ring;
+    uint64_t dropped;       /* by the lcore */
+    uint64_t reported;      /* by log lcore */
+} __rte_cache_aligned;
+
+static struct blog_lcore blog_lcores[DPVS_MAX_LCORE];
+static struct dpvs_log_site *blog_sites[DPVS_BLOG_MAX_SITES];
+static rte_atomic32_t blog_nsites;
+static struct rte_mempool *blog_pool;
+static uint64_t blog_base_tsc;
+static time_t blog_base_time;
+
 static int log_send(struct dpvs_log *msg)
 {
     int res;
@@ -79,9 +113,8 @@ static unsigned int log_BKDRHash(char *str, int len)
     return (hash & 0x7FFFFFFF);
 }
 
-static uint64_t log_get_time(char *time, int time_len)
+static void log_format_time(time_t tm, char *time, int time_len)
 {
-    time_t tm;
     long sec = 0;
     int yy = 0, mm = 0, dd = 0, hh = 0, mi = 0, ss = 0;
     int ad = 0;
@@ -89,7 +122,6 @@ static uint64_t log_get_time(char *time, int time_len)
     int m[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
     int i;
 
-    tm = sys_current_time();
     sec = tm + (60*60)*TIMEZONE;
     ad = sec/DAY;
     ad = ad - YEARSTART;
@@ -127,6 +159,13 @@ static uint64_t log_get_time(char *time, int time_len)
     mi = sec/60 - sec/(60*60)*60;
     ss = sec - sec/60*60;
     snprintf(time, time_len, "%d-%02d-%02d %02d:%02d:%02d\n", yy, mm, dd, hh, mi, ss);
+}
+
+static uint64_t log_get_time(char *time, int time_len)
+{
+    time_t tm = sys_current_time();
+
+    log_format_time(tm, time, time_len);
     return tm;
 }
 
@@ -167,19 +206,14 @@ static int dpvs_async_log(uint32_t level, uint32_t logtype, lcoreid_t cid, char
     return 0;
 }
 
-int dpvs_log(uint32_t level, uint32_t logtype, const char *func, int line, const char *format, ...)
+static void dpvs_vlog(uint32_t level, uint32_t logtype, const char *func,
+                      int line, const char *format, va_list ap)
 {
-    va_list ap;
     lcoreid_t cid;
     char log_buf[DPVS_LOG_MAX_LINE_LEN];
     int len = 0;
     int off = g_dpvs_log_time_off;
 
-    if (level > rte_logs.level)
-        return -1;
-
-    va_start(ap, format);
-
     do {
         if (!g_dpvs_log_async_mode || !g_dpvs_log_core || !g_dpvs_log_thread_ready) {
             rte_vlog(level, logtype, format, ap);
@@ -208,7 +242,208 @@ int dpvs_log(uint32_t level, uint32_t logtype, const char *func, int line, const
         len = vsnprintf(log_buf+off, sizeof(log_buf)-off, format, ap);
         dpvs_async_log(level, logtype, cid, log_buf, len, off);
     }while(0);
+}
 
+int dpvs_log(uint32_t level, uint32_t logtype, const char *func, int line, const char *format, ...)
+{
+    va_list ap;
+
+    if (level > rte_logs.level)
+        return -1;
+
+    va_start(ap, format);
+    dpvs_vlog(level, logtype, func, line, format, ap);
+    va_end(ap);
+    return 0;
+}
+
+/*
+ * parse the conversion after '%' at @p, set @type to argument type.
+ * return its length, or -1 if not supported.
+ */
+static int blog_parse_conv(const char *p, int *type)
+{
+    const char *s = p;
+    int lmod = 0;
+
+    while (*p && strchr("-+ #0'", *p))
+        p++;
+    while (isdigit(*p))
+        p++;
+    if (*p == '.') {
+        p++;
+        while (isdigit(*p))
+            p++;
+    }
+
+    for (;; p++) {
+        if (*p == 'h')
+            continue;
+        if (*p == 'l')
+            lmod++;
+        else if (*p == 'j' || *p == 'z' || *p == 't' || *p == 'q')
+            lmod = 2;
+        else
+            break;
+    }
+
+    switch (*p) {
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+        *type = lmod == 0 ? BLOG_ARG_INT :
+                (lmod == 1 ? BLOG_ARG_LONG : BLOG_ARG_LLONG);
+        break;
+    case 'p':
+        *type = BLOG_ARG_PTR;
+        break;
+    case 's':
+        if (lmod)
+            return -1;
+        *type = BLOG_ARG_STR;
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+        if (lmod > 1)
+            return -1;
+        *type = BLOG_ARG_DOUBLE;
+        break;
+    case '%':
+        if (p != s)
+            return -1;
+        *type = BLOG_ARG_NONE;
+        break;
+    default: /* '*', 'n', 'L' ... */
+        return -1;
+    }
+
+    return p - s + 1;
+}
+
+/* on first use of @site, false if it's not done (yet) */
+static bool blog_site_register(struct dpvs_log_site *site)
+{
+    const char *p;
+    int n, type, nargs = 0;
+    uint32_t id;
+
+    if (site->state != BLOG_SITE_NEW ||
+        !rte_atomic32_cmpset(&site->state, BLOG_SITE_NEW, BLOG_SITE_BUSY))
+        return false;
+
+    for (p = site->fmt; (p = strchr(p, '%')) != NULL; p += n + 1) {
+        n = blog_parse_conv(p + 1, &type);
+        if (n < 0 || n > 30)
+            goto text;
+        if (type == BLOG_ARG_NONE)
+            continue;
+        if (nargs >= DPVS_BLOG_MAX_ARGS)
+            goto text;
+        site->argtypes[nargs++] = type;
+    }
+
+    id = rte_atomic32_add_return(&blog_nsites, 1);
+    if (id >= DPVS_BLOG_MAX_SITES)
+        goto text;
+
+    site->nargs = nargs;
+    site->id = id;
+    blog_sites[id] = site;
+
+    rte_wmb();
+    site->state = BLOG_SITE_READY;
+    return true;
+
+text:
+    rte_wmb();
+    site->state = BLOG_SITE_TEXT;
+    return false;
+}
+
+static inline void blog_put_str(struct dpvs_blog_rec *rec, int i,
+                                const char *str)
+{
+    int room = DPVS_BLOG_STR_LEN - 1 - rec->slen;
+    int len;
+
+    if (!str)
+        str = "(null)";
+
+    len = strnlen(str, room);
+    memcpy(rec->strs + rec->slen, str, len);
+    rec->strs[rec->slen + len] = '\0';
+
+    rec->args[i] = rec->slen;
+    rec->slen += len + (room > len ? 1 : 0);
+}
+
+int dpvs_blog(struct dpvs_log_site *site, ...)
+{
+    va_list ap;
+    lcoreid_t cid = rte_lcore_id();
+    struct blog_lcore *bl;
+    struct dpvs_blog_rec *rec;
+    double d;
+    int i;
+
+    if (site->level > rte_logs.level)
+        return -1;
+
+    va_start(ap, site);
+
+    if (unlikely(!g_dpvs_log_thread_ready || cid >= DPVS_MAX_LCORE ||
+                 !blog_lcores[cid].ring))
+        goto text;
+
+    if (unlikely(site->state != BLOG_SITE_READY) &&
+        !blog_site_register(site))
+        goto text;
+
+    bl = &blog_lcores[cid];
+    if (unlikely(rte_mempool_get(blog_pool, (void **)&rec) != 0)) {
+        bl->dropped++;
+        goto out;
+    }
+
+    rec->site = site->id;
+    rec->cid = cid;
+    rec->slen = 0;
+    rec->tsc = rte_rdtsc();
+
+    for (i = 0; i < site->nargs; i++) {
+        switch (site->argtypes[i]) {
+        case BLOG_ARG_INT:
+            rec->args[i] = va_arg(ap, int);
+            break;
+        case BLOG_ARG_LONG:
+            rec->args[i] = va_arg(ap, long);
+            break;
+        case BLOG_ARG_LLONG:
+            rec->args[i] = va_arg(ap, long long);
+            break;
+        case BLOG_ARG_PTR:
+            rec->args[i] = (uintptr_t)va_arg(ap, void *);
+            break;
+        case BLOG_ARG_STR:
+            blog_put_str(rec, i, va_arg(ap, const char *));
+            break;
+        case BLOG_ARG_DOUBLE:
+            d = va_arg(ap, double);
+            memcpy(&rec->args[i], &d, sizeof(d));
+            break;
+        }
+    }
+
+    /* never wait for log lcore */
+    if (unlikely(rte_ring_sp_enqueue(bl->ring, rec) != 0)) {
+        rte_mempool_put(blog_pool, rec);
+        bl->dropped++;
+    }
+
+out:
+    va_end(ap);
+    return 0;
+
+text:
+    /* as RTE_LOG does, async log ring is used if it's on */
+    dpvs_vlog(site->level, site->logtype, site->func, site->line, site->fmt, ap);
     va_end(ap);
     return 0;
 }
@@ -238,6 +473,167 @@ static int log_buf_timeout_flush(FILE *f, int timeout)
     return 0;
 }
 
+static void log_buf_write(FILE *f, int level, const char *data, int len)
+{
+    if (w_buf.pos + len >= LOG_BUF_MAX_LEN) {
+        log_buf_flush(f);
+    }
+    if (!w_buf.pos) {
+        w_buf.level = level - 1;
+        w_buf.time = rte_get_timer_cycles();
+    }
+    strncpy(w_buf.buf+w_buf.pos, data, len);
+    w_buf.pos += len;
+    log_buf_timeout_flush(f, 5);
+}
+
+/* format binary log @rec with its call site, return length */
+static int blog_format(const struct dpvs_log_site *site,
+                       const struct dpvs_blog_rec *rec, char *buf, int size)
+{
+    const char *p = site->fmt;
+    char spec[32];
+    int n, type, ret, arg = 0, len = 0;
+    double d;
+
+    while (*p && len < size - 1) {
+        if (*p != '%') {
+            buf[len++] = *p++;
+            continue;
+        }
+
+        /* validated by blog_site_register() */
+        n = blog_parse_conv(p + 1, &type);
+        if (type == BLOG_ARG_NONE) {
+            buf[len++] = '%';
+            p += n + 1;
+            continue;
+        }
+
+        snprintf(spec, sizeof(spec), "%.*s", n + 1, p);
+        p += n + 1;
+
+        switch (site->argtypes[arg]) {
+        case BLOG_ARG_INT:
+            ret = snprintf(buf + len, size - len, spec, (int)rec->args[arg]);
+            break;
+        case BLOG_ARG_LONG:
+            ret = snprintf(buf + len, size - len, spec, (long)rec->args[arg]);
+            break;
+        case BLOG_ARG_LLONG:
+            ret = snprintf(buf + len, size - len, spec,
+                           (long long)rec->args[arg]);
+            break;
+        case BLOG_ARG_PTR:
+            ret = snprintf(buf + len, size - len, spec,
+                           (void *)(uintptr_t)rec->args[arg]);
+            break;
+        case BLOG_ARG_STR:
+            ret = snprintf(buf + len, size - len, spec,
+                           rec->strs + rec->args[arg]);
+            break;
+        case BLOG_ARG_DOUBLE:
+            memcpy(&d, &rec->args[arg], sizeof(d));
+            ret = snprintf(buf + len, size - len, spec, d);
+            break;
+        default:
+            ret = 0;
+            break;
+        }
+        arg++;
+
+        if (ret > 0)
+            len += RTE_MIN(ret, size - 1 - len);
+    }
+
+    buf[len] = '\0';
+    return len;
+}
+
+static void blog_emit(FILE *f, const struct dpvs_blog_rec *rec)
+{
+    struct dpvs_log_site *site;
+    char line[DPVS_LOG_MAX_LINE_LEN];
+    uint64_t hz = rte_get_tsc_hz();
+    int len = 0;
+
+    if (unlikely(!rec->site || rec->site >= DPVS_BLOG_MAX_SITES))
+        return;
+    site = blog_sites[rec->site];
+
+    /* rate limit per call site, like the dedup of text log */
+    if (rec->tsc - site->rl_begin > LOG_INTERNAL_TIME * hz) {
+        if (site->suppressed) {
+            len = snprintf(line, sizeof(line),
+                           "LOG: %s:%d: %u messages suppressed\n",
+                           site->func, site->line, site->suppressed);
+            log_buf_write(f, site->level, line, len);
+        }
+        site->rl_begin = rec->tsc;
+        site->rl_count = 0;
+        site->suppressed = 0;
+    }
+    if (site->rl_count >= DPVS_BLOG_SITE_BURST) {
+        site->suppressed++;
+        return;
+    }
+    site->rl_count++;
+
+    len = 0;
+    if (f != NULL) {
+        log_format_time(blog_base_time + (rec->tsc - blog_base_tsc) / hz,
+                        line, LOG_SYS_TIME_LEN);
+        line[LOG_SYS_TIME_LEN-1] = ' ';
+        len = LOG_SYS_TIME_LEN;
+    }
+    len += blog_format(site, rec, line + len, sizeof(line) - len);
+
+    log_buf_write(f, site->level, line, len);
+}
+
+static void blog_process(FILE *f)
+{
+    static uint64_t last_report;
+    struct dpvs_blog_rec *recs[BLOG_BURST];
+    struct blog_lcore *bl;
+    uint64_t now, dropped;
+    char line[128];
+    lcoreid_t cid;
+    unsigned int i, n;
+    int len;
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        bl = &blog_lcores[cid];
+        if (!bl->ring)
+            continue;
+
+        n = rte_ring_sc_dequeue_burst(bl->ring, (void **)recs, BLOG_BURST, NULL);
+        for (i = 0; i < n; i++)
+            blog_emit(f, recs[i]);
+        if (n > 0)
+            rte_mempool_put_bulk(blog_pool, (void **)recs, n);
+    }
+
+    /* overflow is counted by lcores, report it once per interval */
+    now = rte_get_timer_cycles();
+    if (now - last_report < LOG_INTERNAL_TIME * rte_get_timer_hz())
+        return;
+    last_report = now;
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        bl = &blog_lcores[cid];
+        dropped = bl->dropped;
+        if (dropped == bl->reported)
+            continue;
+
+        len = snprintf(line, sizeof(line),
+                       "LOG: lcore %d dropped %lu binary log messages\n",
+                       cid, dropped - bl->reported);
+        log_buf_write(f, RTE_LOG_WARNING, line, len);
+        bl->reported = dropped;
+    }
+}
+
 static int log_slave_process(void)
 {
     struct dpvs_log *msg_log;
@@ -246,18 +642,10 @@ static int log_slave_process(void)
 
     /* dequeue LOG from ring, no lock for ring and w_buf */
     while (0 == rte_ring_dequeue(log_ring, (void **)&msg_log)) {
-        if (w_buf.pos + msg_log->log_len >= LOG_BUF_MAX_LEN) {
-            log_buf_flush(f);
-        }
-        if (!w_buf.pos) {
-            w_buf.level = msg_log->log_level - 1;
-            w_buf.time = rte_get_timer_cycles();
-        }
-        strncpy(w_buf.buf+w_buf.pos, msg_log->data, msg_log->log_len);
-        w_buf.pos += msg_log->log_len;
-        log_buf_timeout_flush(f, 5);
+        log_buf_write(f, msg_log->log_level, msg_log->data, msg_log->log_len);
         dpvs_log_free(msg_log);
     }
+    blog_process(f);
     log_buf_timeout_flush(f, 5);
 
     return ret;
@@ -287,6 +675,7 @@ static int __log_slave_init(void)
 {
     char ring_name[16];
     int lcore_id;
+    unsigned int cid;
     FILE *f = rte_logs.file;
     char log_pool_name[32];
 
@@ -320,6 +709,34 @@ static int __log_slave_init(void)
         return EDPVS_DPDKAPIFAIL;
     }
 
+    /* binary log, a SPSC ring per lcore */
+    blog_pool = rte_mempool_create("blog_rec_pool",
+                                DPVS_BLOG_POOL_SIZE_DEF,
+                                sizeof(struct dpvs_blog_rec),
+                                log_pool_cache,
+                                0, NULL, NULL, NULL, NULL,
+                                0, 0);
+    if (!blog_pool) {
+        return EDPVS_DPDKAPIFAIL;
+    }
+
+    RTE_LCORE_FOREACH(cid) {
+        if (cid == g_dpvs_log_core || cid >= DPVS_MAX_LCORE)
+            continue;
+
+        snprintf(ring_name, sizeof(ring_name), "blog_ring_%d", cid);
+        blog_lcores[cid].ring = rte_ring_create(ring_name,
+                                    DPVS_BLOG_RING_SIZE_DEF, rte_socket_id(),
+                                    RING_F_SP_ENQ | RING_F_SC_DEQ);
+        if (!blog_lcores[cid].ring) {
+            fprintf(stderr, "Fail to init binary log ring of lcore %d\n", cid);
+            return EDPVS_DPDKAPIFAIL;
+        }
+    }
+
+    blog_base_tsc = rte_rdtsc();
+    blog_base_time = sys_current_time();
+
     signal(SIGABRT, log_signal_handler);
     signal(SIGSEGV, log_signal_handler);
 
@@ -35,6 +35,10 @@
 #include "ip_tunnel.h"
 #include "sys_time.h"
 #include "route6.h"
+#include "ipvs/sess_log.h"
+#include "bench.h"
+#include "prof.h"
+#include "stats_shm.h"
 
 #define DPVS    "dpvs"
 #define RTE_LOGTYPE_DPVS RTE_LOGTYPE_USER1
@@ -242,6 +246,18 @@ int main(int argc, char *argv[])
         rte_exit(EXIT_FAILURE, "Fail to init netif_ctrl: %s\n",
                  dpvs_strerror(err));
 
+    if ((err = dpvs_bench_init()) != EDPVS_OK)
+        rte_exit(EXIT_FAILURE, "Fail to init bench: %s\n",
+                 dpvs_strerror(err));
+
+    if ((err = dpvs_prof_init()) != EDPVS_OK)
+        rte_exit(EXIT_FAILURE, "Fail to init prof: %s\n",
+                 dpvs_strerror(err));
+
+    if ((err = dpvs_stats_shm_init()) != EDPVS_OK)
+        rte_exit(EXIT_FAILURE, "Fail to init stats_shm: %s\n",
+                 dpvs_strerror(err));
+
     /* config and start all available dpdk ports */
     nports = rte_eth_dev_count();
     for (pid = 0; pid < nports; pid++) {
@@ -266,6 +282,8 @@ int main(int argc, char *argv[])
     netif_lcore_start();
 
     log_slave_init();
+    /* session log exporter takes an idle lcore after log */
+    dp_vs_sess_log_start();
     /* write pid file */
     if (!pidfile_write(DPVS_PIDFILE, getpid()))
         goto end;
@@ -291,11 +309,15 @@ int main(int argc, char *argv[])
             rte_timer_manage();
             prev_cycles = now_cycles;
         }
-        /* kni */
+        /* kni requests, and I/O if no KNI lcore */
         kni_process_on_master();
 
-        /* process mac ring on master */
-        neigh_process_ring(NULL);
+        /* session log exporter, if no idle lcore for it */
+        sess_log_process_on_master();
+
+        /* process mac ring on master, if no neigh lcore */
+        if (netif_neigh_lcore() == NETIF_LCORE_ID_INVALID)
+            neigh_process_ring(NULL);
 
         /* increase loop counts */
         netif_update_master_loop_cnt();
@@ -303,6 +325,12 @@ int main(int argc, char *argv[])
 
 end:
     dpvs_state_set(DPVS_STATE_FINISH);
+    if ((err = dpvs_stats_shm_term()) != EDPVS_OK)
+        RTE_LOG(ERR, DPVS, "Fail to term stats_shm: %s\n", dpvs_strerror(err));
+    if ((err = dpvs_prof_term()) != EDPVS_OK)
+        RTE_LOG(ERR, DPVS, "Fail to term prof: %s\n", dpvs_strerror(err));
+    if ((err = dpvs_bench_term()) != EDPVS_OK)
+        RTE_LOG(ERR, DPVS, "Fail to term bench: %s\n", dpvs_strerror(err));
     if ((err = netif_ctrl_term()) !=0 )
         rte_exit(EXIT_FAILURE, "Fail to term netif_ctrl: %s\n",
                  dpvs_strerror(err));
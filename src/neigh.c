@@ -54,6 +54,7 @@ struct raw_neigh {
     struct netif_port *port;
     bool              add;
     uint8_t           flag;
+    lcoreid_t         cid;      /* lcore it comes from */
 } __rte_cache_aligned;
 
 struct nud_state {
@@ -423,12 +424,12 @@ static void neigh_state_confirm(struct neighbour_entry *neighbour)
         daddr.in.s_addr = neighbour->ip_addr.in.s_addr;
         inet_addr_select(AF_INET, neighbour->port, &daddr, 0, &saddr);
         if (!saddr.in.s_addr) {
-            RTE_LOG(ERR, NEIGHBOUR, "[%s]no source ip\n", __func__);
+            RTE_BLOG(ERR, NEIGHBOUR, "[%s]no source ip\n", __func__);
         }
 
         if (neigh_send_arp(neighbour->port, saddr.in.s_addr,
                            daddr.in.s_addr) != EDPVS_OK) {
-            RTE_LOG(ERR, NEIGHBOUR, "[%s] send arp failed\n", __func__);
+            RTE_BLOG(ERR, NEIGHBOUR, "[%s] send arp failed\n", __func__);
         }
     } else if (neighbour->af == AF_INET6) {
         /*to be continue*/
@@ -436,7 +437,7 @@ static void neigh_state_confirm(struct neighbour_entry *neighbour)
         inet_addr_select(AF_INET6, neighbour->port, &daddr, 0, &saddr);
 
         if (ipv6_addr_any(&saddr.in6))
-            RTE_LOG(ERR, NEIGHBOUR, "[%s]no source ip\n", __func__);
+            RTE_BLOG(ERR, NEIGHBOUR, "[%s]no source ip\n", __func__);
 
         ndisc_solicit(neighbour, &saddr.in6);
     }
@@ -489,7 +490,7 @@ int neigh_resolve_input(struct rte_mbuf *m, struct netif_port *port)
             neighbour = neigh_add_table(AF_INET, (union inet_addr *)&ipaddr,
                                     &arp->arp_data.arp_sha, port, hashkey, 0);
             if(!neighbour){
-                RTE_LOG(ERR, NEIGHBOUR, "[%s] add neighbour wrong\n", __func__);
+                RTE_BLOG(ERR, NEIGHBOUR, "[%s] add neighbour wrong\n", __func__);
                 rte_pktmbuf_free(m);
                 return EDPVS_NOMEM;
             }
@@ -596,7 +597,7 @@ int neigh_output(int af, union inet_addr *nexhop,
                  * and it will be released late
                  */
                 rte_pktmbuf_free(m);
-                RTE_LOG(ERR, NEIGHBOUR, "[%s] neigh_unres_queue is full, drop packet\n", __func__);
+                RTE_BLOG(ERR, NEIGHBOUR, "[%s] neigh_unres_queue is full, drop packet\n", __func__);
                 return EDPVS_DROP;
             }
             m_buf = rte_zmalloc("neigh_new_mbuf",
@@ -635,7 +636,7 @@ int neigh_output(int af, union inet_addr *nexhop,
     else{
         neighbour = neigh_add_table(af, nexhop, NULL, port, hashkey, 0);
         if(!neighbour){
-            RTE_LOG(ERR, NEIGHBOUR, "[%s] add neighbour wrong\n", __func__);
+            RTE_BLOG(ERR, NEIGHBOUR, "[%s] add neighbour wrong\n", __func__);
             rte_pktmbuf_free(m);
             return EDPVS_NOMEM;
         }
@@ -706,6 +707,7 @@ static struct raw_neigh* neigh_ring_clone_entry(const struct neighbour_entry* ne
     mac_param->flag = neighbour->flag & ~NEIGHBOUR_HASHED;
     mac_param->port = neighbour->port;
     mac_param->add = add;
+    mac_param->cid = rte_lcore_id();
     /*just copy*/
     rte_memcpy(&mac_param->eth_addr, &neighbour->eth_addr, 6);
     return mac_param;
@@ -725,6 +727,7 @@ static struct raw_neigh* neigh_ring_clone_param(const struct dp_vs_neigh_conf *p
     mac_param->flag = param->flag | NEIGHBOUR_STATIC;
     mac_param->port = port;
     mac_param->add = add;
+    mac_param->cid = rte_lcore_id();
     rte_memcpy(&mac_param->eth_addr, &param->eth_addr, 6);
     return mac_param;
 }
@@ -933,47 +936,104 @@ static int neigh_sockopt_get(sockoptid_t opt, const void *conf,
     return EDPVS_OK;
 }
 
-int neigh_sync_core(const void *param, bool add_del, enum param_kind kind)
+static int neigh_ring_enqueue(lcoreid_t cid, struct raw_neigh *mac_param)
+{
+    int ret;
+
+    ret = rte_ring_enqueue(neigh_ring[cid], mac_param);
+    if (unlikely(-EDQUOT == ret)) {
+        RTE_BLOG(WARNING, NEIGHBOUR, "%s: neigh ring quota exceeded\n",
+        __func__);
+    } else if (ret < 0) {
+        rte_free(mac_param);
+        RTE_BLOG(WARNING, NEIGHBOUR, "%s: neigh ring enqueue failed\n",
+        __func__);
+        return EDPVS_DPDKAPIFAIL;
+    }
+    netif_lcore_wakeup(cid);
+
+    return EDPVS_OK;
+}
+
+/* copy @param to the workers, but the one it comes from */
+static int neigh_ring_fanout(const struct raw_neigh *param)
 {
     struct raw_neigh *mac_param;
-    int ret = 0;
-    lcoreid_t cid, i;
-    cid = rte_lcore_id();
+    lcoreid_t i;
+    int err;
 
     for (i = 0; i < DPVS_MAX_LCORE; i++) {
-        if ((i == cid) || (!is_lcore_id_valid(i)) || (i == master_cid))
+        /* kni and isolated rx lcores never drain neigh_ring */
+        if ((i == param->cid) || (!is_lcore_id_fwd(i)) || (i == master_cid))
             continue;
-        switch (kind) {
-        case NEIGH_ENTRY:
-            mac_param = neigh_ring_clone_entry(param, add_del);
-            break;
-        case NEIGH_PARAM:
-            mac_param = neigh_ring_clone_param(param, add_del);
-            break;
-        default:
-            return EDPVS_NOTSUPP;
-        }
 
-        if (mac_param) {
-            ret = rte_ring_enqueue(neigh_ring[i], mac_param);
-            if (unlikely(-EDQUOT == ret)) {
-                RTE_LOG(WARNING, NEIGHBOUR, "%s: neigh ring quota exceeded\n",
-                __func__);
-            } else if (ret < 0) {
-                rte_free(mac_param);
-                RTE_LOG(WARNING, NEIGHBOUR, "%s: neigh ring enqueue failed\n",
-                __func__);
-                return EDPVS_DPDKAPIFAIL;
-            }
-        } else {
+        mac_param = rte_malloc("mac_entry", sizeof(struct raw_neigh),
+                               RTE_CACHE_LINE_SIZE);
+        if (!mac_param) {
             RTE_LOG(WARNING, NEIGHBOUR, "%s: clone mac faild\n", __func__);
             return EDPVS_NOMEM;
         }
+        rte_memcpy(mac_param, param, sizeof(struct raw_neigh));
+
+        err = neigh_ring_enqueue(i, mac_param);
+        if (err != EDPVS_OK)
+            return err;
     }
 
     return EDPVS_OK;
 }
 
+/*
+ * with a neigh lcore, the entry is handed over to it and it does the
+ * fan-out, otherwise the caller does.
+ */
+int neigh_sync_core(const void *param, bool add_del, enum param_kind kind)
+{
+    struct raw_neigh *mac_param;
+    lcoreid_t neigh_cid = netif_neigh_lcore();
+    int err;
+
+    switch (kind) {
+    case NEIGH_ENTRY:
+        mac_param = neigh_ring_clone_entry(param, add_del);
+        break;
+    case NEIGH_PARAM:
+        mac_param = neigh_ring_clone_param(param, add_del);
+        break;
+    default:
+        return EDPVS_NOTSUPP;
+    }
+
+    if (!mac_param) {
+        RTE_LOG(WARNING, NEIGHBOUR, "%s: clone mac faild\n", __func__);
+        return EDPVS_NOMEM;
+    }
+
+    if (neigh_cid != NETIF_LCORE_ID_INVALID)
+        return neigh_ring_enqueue(neigh_cid, mac_param);
+
+    err = neigh_ring_fanout(mac_param);
+    rte_free(mac_param);
+    return err;
+}
+
+/* on the neigh lcore, returns number of entries relayed */
+unsigned neigh_relay_ring(void)
+{
+    struct raw_neigh *params[NETIF_MAX_PKT_BURST];
+    lcoreid_t cid = rte_lcore_id();
+    unsigned nb_rb, i;
+
+    nb_rb = rte_ring_dequeue_burst(neigh_ring[cid], (void **)params,
+                                   NETIF_MAX_PKT_BURST, NULL);
+    for (i = 0; i < nb_rb; i++) {
+        neigh_ring_fanout(params[i]);
+        rte_free(params[i]);
+    }
+
+    return nb_rb;
+}
+
 static int neigh_sockopt_set(sockoptid_t opt, const void *conf, size_t size)
 {
     const struct dp_vs_neigh_conf *param = conf;
@@ -21,6 +21,8 @@
 #include <netinet/in.h>
 #include <netinet/ip.h>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
 #include <net/if.h>
@@ -37,6 +39,10 @@
 #include "timer.h"
 #include "parser/parser.h"
 #include "neigh.h"
+#include "bench.h"
+#include "prof.h"
+#include "inetaddr.h"
+#include "sa_pool.h"
 
 #include <rte_arp.h>
 #include <netinet/in.h>
@@ -61,11 +67,41 @@ static int netif_pktpool_mbuf_cache = NETIF_PKTPOOL_MBUF_CACHE_DEF;
 #define NETIF_NB_TX_DESC_MIN    16
 #define NETIF_NB_TX_DESC_MAX    8192
 
+#define NETIF_TX_FLUSH_US_DEF   100
+#define NETIF_TX_FLUSH_US_MAX   100000
+static int netif_tx_flush_us = NETIF_TX_FLUSH_US_DEF;
+static uint64_t netif_tx_flush_cycles;  /* 0 to flush at loop end only */
+
+#define NETIF_TX_RETRY_DEF      8
+#define NETIF_TX_RETRY_MAX      1024
+static int netif_tx_retry = NETIF_TX_RETRY_DEF;
+
+/* adaptive polling of idle lcores, see lcore_idle_backoff() */
+#define NETIF_IDLE_POLLS_MAX        100000000
+static uint32_t netif_idle_pause_polls = 0;     /* 0 for busy polling */
+static uint32_t netif_idle_sleep_polls = 0;     /* 0 for never sleep */
+bool netif_idle_sleep_on = false;
+
+#define NETIF_IDLE_SLEEP_MS_DEF     1
+#define NETIF_IDLE_SLEEP_MS_MAX     100
+static int netif_idle_sleep_ms = NETIF_IDLE_SLEEP_MS_DEF;
+
+struct netif_lcore_idle {
+    uint32_t polls;                 /* empty loops in a row */
+    bool can_sleep;
+    struct rte_epoll_event efd_ev;
+} __rte_cache_aligned;
+
+static struct netif_lcore_idle lcore_idle[DPVS_MAX_LCORE];
+
 #define NETIF_PKT_PREFETCH_OFFSET   3
 #define NETIF_ISOL_RXQ_RING_SZ_DEF  1048576 // 1M bytes
 
 #define ARP_RING_SIZE 2048
 
+/* refuse rx/tx queues processed by lcores on remote NUMA socket */
+static bool netif_numa_strict = false;
+
 /* physical nic id = phy_pid_base + index */
 static portid_t phy_pid_base = 0;
 static portid_t phy_pid_end = -1; // not inclusive
@@ -150,6 +186,25 @@ static uint8_t g_isol_rx_lcore_num;
 static uint64_t g_slave_lcore_mask;
 static uint64_t g_isol_rx_lcore_mask;
 
+/*
+ * lcore of KNI I/O (kernel to port), off the master lcore so that heavy
+ * control work does not stall it. KNI requests (MTU, link) are still
+ * handled on master, which owns the port config.
+ */
+static lcoreid_t kni_lcore = NETIF_LCORE_ID_INVALID;
+
+/*
+ * lcore relaying neighbour updates to the workers: ARP replies received by
+ * one worker, and neighbour entries from the control API or ndisc. It takes
+ * the fan-out off the master lcore and off the workers' receive path.
+ */
+static lcoreid_t neigh_lcore = NETIF_LCORE_ID_INVALID;
+
+lcoreid_t netif_neigh_lcore(void)
+{
+    return neigh_lcore;
+}
+
 bool is_lcore_id_valid(lcoreid_t cid)
 {
     if (unlikely(cid >= DPVS_MAX_LCORE))
@@ -157,10 +212,13 @@ bool is_lcore_id_valid(lcoreid_t cid)
 
     return ((cid == rte_get_master_lcore()) ||
             (g_slave_lcore_mask & (1L << cid)) ||
-            (g_isol_rx_lcore_mask & (1L << cid)));
+            (g_isol_rx_lcore_mask & (1L << cid)) ||
+            (cid == kni_lcore) ||
+            (cid == neigh_lcore));
 }
 
-static bool is_lcore_id_fwd(lcoreid_t cid)
+/* lcores running the job loop, i.e., draining per-lcore sync rings */
+bool is_lcore_id_fwd(lcoreid_t cid)
 {
     if (unlikely(cid >= DPVS_MAX_LCORE))
         return false;
@@ -239,6 +297,113 @@ static void pktpool_cache_handler(vector_t tokens)
     FREE_PTR(str);
 }
 
+static void numa_strict_handler(vector_t tokens)
+{
+    RTE_LOG(INFO, NETIF, "numa_strict ON\n");
+    netif_numa_strict = true;
+}
+
+static void tx_flush_us_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int flush_us;
+
+    assert(str);
+    flush_us = atoi(str);
+    if (strspn(str, "0123456789") != strlen(str) ||
+            flush_us > NETIF_TX_FLUSH_US_MAX) {
+        RTE_LOG(WARNING, NETIF, "invalid tx_flush_us %s, using default %d\n",
+                str, NETIF_TX_FLUSH_US_DEF);
+        flush_us = NETIF_TX_FLUSH_US_DEF;
+    } else {
+        RTE_LOG(INFO, NETIF, "tx_flush_us = %d\n", flush_us);
+    }
+    netif_tx_flush_us = flush_us;
+    netif_tx_flush_cycles = flush_us * rte_get_tsc_hz() / 1000000;
+
+    FREE_PTR(str);
+}
+
+static void idle_pause_polls_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int polls;
+
+    assert(str);
+    polls = atoi(str);
+    if (strspn(str, "0123456789") != strlen(str) ||
+            polls > NETIF_IDLE_POLLS_MAX) {
+        RTE_LOG(WARNING, NETIF, "invalid idle_pause_polls %s, using default 0\n",
+                str);
+        netif_idle_pause_polls = 0;
+    } else {
+        RTE_LOG(INFO, NETIF, "idle_pause_polls = %d\n", polls);
+        netif_idle_pause_polls = polls;
+    }
+
+    FREE_PTR(str);
+}
+
+static void idle_sleep_polls_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int polls;
+
+    assert(str);
+    polls = atoi(str);
+    if (strspn(str, "0123456789") != strlen(str) ||
+            polls > NETIF_IDLE_POLLS_MAX) {
+        RTE_LOG(WARNING, NETIF, "invalid idle_sleep_polls %s, using default 0\n",
+                str);
+        netif_idle_sleep_polls = 0;
+    } else {
+        RTE_LOG(INFO, NETIF, "idle_sleep_polls = %d\n", polls);
+        netif_idle_sleep_polls = polls;
+    }
+    netif_idle_sleep_on = !!netif_idle_sleep_polls;
+
+    FREE_PTR(str);
+}
+
+static void idle_sleep_ms_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int ms;
+
+    assert(str);
+    ms = atoi(str);
+    if (ms <= 0 || ms > NETIF_IDLE_SLEEP_MS_MAX) {
+        RTE_LOG(WARNING, NETIF, "invalid idle_sleep_ms %s, using default %d\n",
+                str, NETIF_IDLE_SLEEP_MS_DEF);
+        netif_idle_sleep_ms = NETIF_IDLE_SLEEP_MS_DEF;
+    } else {
+        RTE_LOG(INFO, NETIF, "idle_sleep_ms = %d\n", ms);
+        netif_idle_sleep_ms = ms;
+    }
+
+    FREE_PTR(str);
+}
+
+static void tx_retry_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int retry;
+
+    assert(str);
+    retry = atoi(str);
+    if (strspn(str, "0123456789") != strlen(str) ||
+            retry > NETIF_TX_RETRY_MAX) {
+        RTE_LOG(WARNING, NETIF, "invalid tx_retry %s, using default %d\n",
+                str, NETIF_TX_RETRY_DEF);
+        netif_tx_retry = NETIF_TX_RETRY_DEF;
+    } else {
+        RTE_LOG(INFO, NETIF, "tx_retry = %d\n", retry);
+        netif_tx_retry = retry;
+    }
+
+    FREE_PTR(str);
+}
+
 static void device_handler(vector_t tokens)
 {
     assert(VECTOR_SIZE(tokens) >= 1);
@@ -650,7 +815,8 @@ static void worker_type_handler(vector_t tokens)
             struct worker_conf_stream, worker_list_node);
 
     assert(str);
-    if (!strcmp(str, "master") || !strcmp(str, "slave")) {
+    if (!strcmp(str, "master") || !strcmp(str, "slave") ||
+            !strcmp(str, "kni") || !strcmp(str, "neigh")) {
         RTE_LOG(INFO, NETIF, "%s:type = %s\n", current_worker->name, str);
         strncpy(current_worker->type, str, sizeof(current_worker->type));
     } else {
@@ -818,8 +984,16 @@ void netif_keyword_value_init(void)
         /* KW_TYPE_INIT keyword */
         netif_pktpool_nb_mbuf = NETIF_PKTPOOL_NB_MBUF_DEF;
         netif_pktpool_mbuf_cache = NETIF_PKTPOOL_MBUF_CACHE_DEF;
+        netif_numa_strict = false;
+        netif_idle_sleep_polls = 0;
+        netif_idle_sleep_on = false;
     }
     /* KW_TYPE_NORMAL keyword */
+    netif_tx_flush_us = NETIF_TX_FLUSH_US_DEF;
+    netif_tx_flush_cycles = NETIF_TX_FLUSH_US_DEF * rte_get_tsc_hz() / 1000000;
+    netif_tx_retry = NETIF_TX_RETRY_DEF;
+    netif_idle_pause_polls = 0;
+    netif_idle_sleep_ms = NETIF_IDLE_SLEEP_MS_DEF;
 }
 
 void install_netif_keywords(void)
@@ -827,6 +1001,12 @@ void install_netif_keywords(void)
     install_keyword_root("netif_defs", netif_defs_handler);
     install_keyword("pktpool_size", pktpool_size_handler, KW_TYPE_INIT);
     install_keyword("pktpool_cache", pktpool_cache_handler, KW_TYPE_INIT);
+    install_keyword("numa_strict", numa_strict_handler, KW_TYPE_INIT);
+    install_keyword("tx_flush_us", tx_flush_us_handler, KW_TYPE_NORMAL);
+    install_keyword("tx_retry", tx_retry_handler, KW_TYPE_NORMAL);
+    install_keyword("idle_pause_polls", idle_pause_polls_handler, KW_TYPE_NORMAL);
+    install_keyword("idle_sleep_polls", idle_sleep_polls_handler, KW_TYPE_INIT);
+    install_keyword("idle_sleep_ms", idle_sleep_ms_handler, KW_TYPE_NORMAL);
     install_keyword("device", device_handler, KW_TYPE_INIT);
     install_sublevel();
     install_keyword("rx", NULL, KW_TYPE_INIT);
@@ -1090,6 +1270,7 @@ int netif_lcore_loop_job_register(struct netif_lcore_loop_job *lcore_job)
     if (unlikely(NETIF_LCORE_JOB_SLOW == lcore_job->type && lcore_job->skip_loops <= 0))
         return EDPVS_INVAL;
 
+    lcore_job->prof_id = dpvs_prof_job_register(lcore_job->name);
     list_add_tail(&lcore_job->list, &netif_lcore_jobs[lcore_job->type]);
     return EDPVS_OK;
 }
@@ -1142,10 +1323,26 @@ static struct netif_lcore_conf lcore_conf[DPVS_MAX_LCORE + 1] = {
 };
 */
 
-static int isol_rxq_add(lcoreid_t cid, portid_t pid, queueid_t qid,
-        unsigned rb_sz, struct netif_queue_conf *rxq);
+static int isol_rxq_add(lcoreid_t cid, lcoreid_t worker_cid, portid_t pid,
+        queueid_t qid, unsigned rb_sz, struct netif_queue_conf *rxq);
 static void isol_rxq_del(struct rx_partner *isol_rxq, bool force);
 
+/* pin the context @what of worker @type to its own lcore */
+static void ctx_lcore_set(lcoreid_t *lcore, int cpu_id,
+                          const char *type, const char *what)
+{
+    if (cpu_id >= DPVS_MAX_LCORE || !rte_lcore_is_enabled(cpu_id) ||
+            cpu_id == rte_get_master_lcore() ||
+            cpu_id == kni_lcore || cpu_id == neigh_lcore) {
+        RTE_LOG(WARNING, NETIF, "%s worker cpu%d is not an enabled idle slave "
+                "lcore, %s on master lcore\n", type, cpu_id, what);
+        return;
+    }
+
+    RTE_LOG(INFO, NETIF, "%s on lcore%d\n", what, cpu_id);
+    *lcore = cpu_id;
+}
+
 static void config_lcores(struct list_head *worker_list)
 {
     int ii, tk;
@@ -1158,6 +1355,11 @@ static void config_lcores(struct list_head *worker_list)
 
     cpu_left = list_elems(worker_list);
     list_for_each_entry(worker, worker_list, worker_list_node) {
+        if (!strcmp(worker->type, "kni"))
+            ctx_lcore_set(&kni_lcore, worker->cpu_id, "kni", "KNI I/O");
+        else if (!strcmp(worker->type, "neigh"))
+            ctx_lcore_set(&neigh_lcore, worker->cpu_id, "neigh",
+                          "neighbour relay");
         if (strcmp(worker->type, "slave")) {
             list_move_tail(&worker->worker_list_node, worker_list);
             cpu_left--;
@@ -1192,6 +1394,7 @@ static void config_lcores(struct list_head *worker_list)
                 lcore_conf[id].pqs[tk].rxqs[ii].id = queue->rx_queues[ii];
                 if (queue->isol_rxq_lcore_ids[ii] != NETIF_LCORE_ID_INVALID) {
                     if (isol_rxq_add(queue->isol_rxq_lcore_ids[ii],
+                                worker_min->cpu_id,
                                 port->id, queue->rx_queues[ii],
                                 queue->isol_rxq_ring_sz,
                                 &lcore_conf[id].pqs[tk].rxqs[ii]) < 0) {
@@ -1317,7 +1520,7 @@ static void netif_get_isol_rx_lcores(uint8_t *nb, uint64_t *mask)
         *mask = isol_lcore_mask;
 }
 
-static inline void netif_copy_lcore_stats(struct netif_lcore_stats *stats)
+void netif_copy_lcore_stats(struct netif_lcore_stats *stats)
 {
     lcoreid_t cid;
     cid = rte_lcore_id();
@@ -1460,6 +1663,44 @@ static int check_lcore_conf(int lcores, const struct netif_lcore_conf *lcore_con
     return LCONFCHK_OK;
 }
 
+/*
+ * rx/tx queues are better processed by lcores on the same NUMA socket
+ * as the NIC, or descriptors and mbufs are accessed across sockets.
+ * return the number of remote queue mappings.
+ */
+static int check_lcore_numa(const struct netif_lcore_conf *lcore_conf)
+{
+    int i = 0, j, k, nremote = 0;
+    unsigned socket;
+    struct netif_port *port;
+
+    while (lcore_conf[i].nports > 0) {
+        socket = rte_lcore_to_socket_id(lcore_conf[i].id);
+        for (j = 0; j < lcore_conf[i].nports; j++) {
+            port = netif_port_get(lcore_conf[i].pqs[j].id);
+            if (!port || port->socket == socket)
+                continue;
+            for (k = 0; k < lcore_conf[i].pqs[j].nrxq; k++) {
+                RTE_LOG(WARNING, NETIF, "%s: cpu%d(socket %d) processes "
+                        "%s:rx%d on remote socket %d\n", __func__,
+                        lcore_conf[i].id, socket, port->name,
+                        lcore_conf[i].pqs[j].rxqs[k].id, port->socket);
+                nremote++;
+            }
+            for (k = 0; k < lcore_conf[i].pqs[j].ntxq; k++) {
+                RTE_LOG(WARNING, NETIF, "%s: cpu%d(socket %d) processes "
+                        "%s:tx%d on remote socket %d\n", __func__,
+                        lcore_conf[i].id, socket, port->name,
+                        lcore_conf[i].pqs[j].txqs[k].id, port->socket);
+                nremote++;
+            }
+        }
+        i++;
+    }
+
+    return nremote;
+}
+
 static inline void lcore_stats_burst(struct netif_lcore_stats *stats,
                                      size_t len)
 {
@@ -1487,8 +1728,9 @@ static inline void isol_rxq_init(void)
 }
 
 /* call me at initialization before lcore loop */
-static int isol_rxq_add(lcoreid_t cid, portid_t pid, queueid_t qid,
-                        unsigned rb_sz, struct netif_queue_conf *rxq)
+static int isol_rxq_add(lcoreid_t cid, lcoreid_t worker_cid, portid_t pid,
+                        queueid_t qid, unsigned rb_sz,
+                        struct netif_queue_conf *rxq)
 {
     assert(cid <= DPVS_MAX_LCORE);
     int rb_sz_r;
@@ -1510,6 +1752,7 @@ static int isol_rxq_add(lcoreid_t cid, portid_t pid, queueid_t qid,
         return EDPVS_DPDKAPIFAIL;
 
     isol_rxq->cid = cid;
+    isol_rxq->worker_cid = worker_cid;
     isol_rxq->pid = pid;
     isol_rxq->qid = qid;
     isol_rxq->rxq = rxq;
@@ -1558,6 +1801,9 @@ inline static void recv_on_isol_lcore(void)
     int i, res;
     lcoreid_t cid = rte_lcore_id();
 
+    if (DPVS_BENCH_RX_HELD())
+        return;
+
     list_for_each_entry(isol_rxq, &isol_rxq_tab[cid], lnode) {
         assert(isol_rxq->cid == cid);
         rx_len = rte_eth_rx_burst(isol_rxq->pid, isol_rxq->qid,
@@ -1567,6 +1813,8 @@ inline static void recv_on_isol_lcore(void)
         lcore_stats_burst(&lcore_stats[cid], rx_len);
 
         res = rte_ring_enqueue_bulk(isol_rxq->rb, (void *const * )mbufs, rx_len, &qspc);
+        if (res > 0)
+            netif_lcore_wakeup(isol_rxq->worker_cid);
         if (res < rx_len) {
             RTE_LOG(WARNING, NETIF, "%s [%d]: %d packets failed to enqueue,"
                     " space avail: %u\n", __func__, cid, rx_len - res, qspc);
@@ -1929,11 +2177,16 @@ static int netif_print_isol_lcore_conf(lcoreid_t cid, char *buf, int *len, bool
     return EDPVS_OK;
 }
 
+/*
+ * mbufs the NIC does not take are kept at the head of txq and sent first
+ * next time, so a microburst does not turn into loss. they are dropped
+ * after netif_tx_retry bursts in a row without progress (link down, ...).
+ */
 static inline void netif_tx_burst(lcoreid_t cid, portid_t pid, queueid_t qindex)
 {
-    int ntx, ii;
+    int ntx, ii, left;
     struct netif_queue_conf *txq;
-    unsigned i = 0;
+    unsigned i;
     struct rte_mbuf *mbuf_copied = NULL;
     struct netif_port *dev = NULL;
 
@@ -1944,7 +2197,8 @@ static inline void netif_tx_burst(lcoreid_t cid, portid_t pid, queueid_t qindex)
 
     dev = netif_port_get(pid);
     if (dev && (dev->flag & NETIF_PORT_FLAG_FORWARD2KNI)) {
-        for (; i<txq->len; i++) {
+        /* kept ones were copied already */
+        for (i = txq->tx_kept; i<txq->len; i++) {
             if (NULL == (mbuf_copied = mbuf_copy(txq->mbufs[i],
                 pktmbuf_pool[dev->socket])))
                 RTE_LOG(WARNING, NETIF, "%s: Failed to copy mbuf\n", __func__);
@@ -1954,29 +2208,74 @@ static inline void netif_tx_burst(lcoreid_t cid, portid_t pid, queueid_t qindex)
         kni_send2kern_loop(pid, txq);
     }
 
+    DPVS_BENCH_START(tsc);
+    DPVS_PROF_START(prof_tsc);
     ntx = rte_eth_tx_burst(pid, txq->id, txq->mbufs, txq->len);
+    DPVS_PROF_END(DPVS_PROF_TX_FLUSH, prof_tsc);
+    DPVS_BENCH_END(DPVS_BENCH_TX, tsc, ntx);
     lcore_stats[cid].opackets += ntx;
     /* do not calculate obytes here in consideration of efficency */
-    if (unlikely(ntx < txq->len)) {
-        RTE_LOG(DEBUG, NETIF, "Fail to send %d packets on dpdk%d tx%d\n", ntx,pid, txq->id);
-        lcore_stats[cid].dropped += txq->len - ntx;
+    if (likely(ntx == txq->len)) {
+        txq->len = 0;
+        txq->tx_kept = 0;
+        txq->tx_retries = 0;
+        return;
+    }
+
+    left = txq->len - ntx;
+    txq->tx_retries = ntx > 0 ? 0 : txq->tx_retries + 1;
+    if (txq->tx_retries > netif_tx_retry) {
+        RTE_LOG(DEBUG, NETIF, "Fail to send %d packets on dpdk%d tx%d\n",
+                left, pid, txq->id);
+        lcore_stats[cid].dropped += left;
+        lcore_stats[cid].txdrop += left;
+        txq->tx_dropped += left;
         for (ii = ntx; ii < txq->len; ii++)
             rte_pktmbuf_free(txq->mbufs[ii]);
+        txq->len = 0;
+        txq->tx_kept = 0;
+        txq->tx_retries = 0;
+        return;
     }
+
+    if (ntx > 0)
+        memmove(&txq->mbufs[0], &txq->mbufs[ntx], left * sizeof(txq->mbufs[0]));
+    txq->len = left;
+    txq->tx_kept = left;
+    lcore_stats[cid].txretry += left;
+    txq->tx_retried += left;
+}
+
+/*
+ * tx queue by flow, to keep packets of a flow in order on the wire.
+ * forwarded mbufs keep the RSS hash they were received with; its low
+ * bits chose our rx queue and are alike for all flows here, so use the
+ * high ones. mbufs made locally have no hash and are spread as before.
+ */
+static inline int netif_tx_qindex(const struct rte_mbuf *mbuf, int ntxq)
+{
+    if (ntxq == 1)
+        return 0;
+
+    if (mbuf->ol_flags & PKT_RX_RSS_HASH)
+        return (mbuf->hash.rss >> 16) % ntxq;
+
+    return (((uint32_t) mbuf->buf_physaddr) >> 8) % ntxq;
 }
 
 /* Call me on MASTER lcore */
 static inline lcoreid_t get_master_xmit_lcore(void)
 {
-    static int i = 0;
+    static int idx[DPVS_MAX_LCORE] = { 0 }; /* of master and KNI lcore */
+    int *i = &idx[rte_lcore_id()];
     lcoreid_t cid;
 
-    if (lcore_conf[i].nports > 0) {
-        cid = lcore_conf[i].id;
-        i++;
+    if (lcore_conf[*i].nports > 0) {
+        cid = lcore_conf[*i].id;
+        (*i)++;
     } else {
         cid = lcore_conf[0].id;
-        i = 1;
+        *i = 1;
     }
 
     return cid;
@@ -2078,7 +2377,7 @@ int netif_hard_xmit(struct rte_mbuf *mbuf, struct netif_port *dev)
     if (likely(mbuf->ol_flags & PKT_TX_IP_CKSUM))
         mbuf->l2_len = sizeof(struct ether_hdr);
 
-    if (rte_get_master_lcore() == cid) { // master thread
+    if (rte_get_master_lcore() == cid || kni_lcore == cid) { // no tx queues
         struct dpvs_msg *msg;
         struct master_xmit_msg_data msg_data;
 
@@ -2106,27 +2405,41 @@ int netif_hard_xmit(struct rte_mbuf *mbuf, struct netif_port *dev)
     }
 
     if (unlikely((ret = validate_xmit_mbuf(mbuf, dev)) != EDPVS_OK)) {
-        RTE_LOG(WARNING, NETIF, "%s: validate_xmit_mbuf error\n", __func__);
+        RTE_BLOG(WARNING, NETIF, "%s: validate_xmit_mbuf error\n", __func__);
         rte_pktmbuf_free(mbuf);
         return ret;
     }
 
     /* port id is determined by routing */
     pid = dev->id;
-    /* qindex is hashed by physical address of mbuf */
-    qindex = (((uint32_t) mbuf->buf_physaddr) >> 8) %
-        (lcore_conf[lcore2index[cid]].pqs[port2index[cid][pid]].ntxq);
-    //RTE_LOG(DEBUG, NETIF, "tx-queue hash(%x) = %d\n", ((uint32_t)mbuf->buf_physaddr) >> 8, qindex);
+    qindex = netif_tx_qindex(mbuf,
+                lcore_conf[lcore2index[cid]].pqs[port2index[cid][pid]].ntxq);
     txq = &lcore_conf[lcore2index[cid]].pqs[port2index[cid][pid]].txqs[qindex];
 
     if (unlikely(txq->len == NETIF_MAX_PKT_BURST)) {
         netif_tx_burst(cid, pid, qindex);
-        txq->len = 0;
+        /* still full of kept mbufs, NIC is not draining */
+        if (unlikely(txq->len == NETIF_MAX_PKT_BURST)) {
+            lcore_stats[cid].dropped++;
+            lcore_stats[cid].txdrop++;
+            txq->tx_dropped++;
+            rte_pktmbuf_free(mbuf);
+            return EDPVS_DROP;
+        }
     }
 
     lcore_stats[cid].obytes += mbuf->pkt_len;
     txq->mbufs[txq->len] = mbuf;
     txq->len++;
+
+    /* flush partial burst by deadline too, not only at loop end */
+    if (netif_tx_flush_cycles) {
+        if (txq->len == txq->tx_kept + 1)
+            txq->tx_deadline = rte_rdtsc() + netif_tx_flush_cycles;
+        else if (unlikely(rte_rdtsc() >= txq->tx_deadline))
+            netif_tx_burst(cid, pid, qindex);
+    }
+
     return EDPVS_OK;
 }
 
@@ -2190,6 +2503,38 @@ int netif_rcv(struct netif_port *dev, __be16 eth_type, struct rte_mbuf *mbuf)
 /*for arp process*/
 static struct rte_ring *arp_ring[DPVS_MAX_LCORE];
 
+/* clone an ARP reply received by lcore @from to the other workers */
+static void arp_ring_fanout(struct rte_mbuf *mbuf, lcoreid_t from)
+{
+    struct rte_mempool *mbuf_pool;
+    struct rte_mbuf *mbuf_clone;
+    uint8_t i;
+    int ret;
+
+    mbuf_pool = pktmbuf_pool[rte_socket_id()];
+
+    for (i = 0; i < DPVS_MAX_LCORE; i++) {
+        if ((i == from) || (!is_lcore_id_fwd(i))
+             || (i == rte_get_master_lcore()))
+            continue;
+        /*rte_pktmbuf_clone will not clone pkt.data, just copy pointer!*/
+        mbuf_clone = rte_pktmbuf_clone(mbuf, mbuf_pool);
+        if (mbuf_clone) {
+            ret = rte_ring_enqueue(arp_ring[i], mbuf_clone);
+            if (unlikely(-EDQUOT == ret)) {
+                RTE_BLOG(WARNING, NETIF, "%s: arp ring of lcore %d quota exceeded\n",
+                        __func__, i);
+            }
+            else if (ret < 0) {
+                RTE_BLOG(WARNING, NETIF, "%s: arp ring of lcore %d enqueue failed\n",
+                        __func__, i);
+                rte_pktmbuf_free(mbuf_clone);
+            }
+            netif_lcore_wakeup(i);
+        }
+    }
+}
+
 static inline int netif_deliver_mbuf(struct rte_mbuf *mbuf,
                                      uint16_t eth_type,
                                      struct netif_port *dev,
@@ -2205,6 +2550,13 @@ static inline int netif_deliver_mbuf(struct rte_mbuf *mbuf,
     assert(mbuf->port <= NETIF_MAX_PORTS);
     assert(dev != NULL);
 
+    /* ingress classify/police before L3, ARP clones were done already */
+    if ((dev->flag & NETIF_PORT_FLAG_TC_INGRESS) && !pkts_from_ring) {
+        mbuf = tc_handle_ingress(netif_tc(dev), eth_type, mbuf, &err);
+        if (!mbuf)
+            return err;
+    }
+
     pt = pkt_type_get(eth_type, dev);
 
     if (NULL == pt) {
@@ -2217,34 +2569,24 @@ static inline int netif_deliver_mbuf(struct rte_mbuf *mbuf,
 
     /*clone arp pkt to every queue*/
     if (pt->type == rte_cpu_to_be_16(ETHER_TYPE_ARP) && !pkts_from_ring) {
-        struct rte_mempool *mbuf_pool;
         struct rte_mbuf *mbuf_clone;
-        uint8_t i;
         struct arp_hdr *arp;
-        unsigned socket_id;
-
-        socket_id = rte_socket_id();
-        mbuf_pool = pktmbuf_pool[socket_id];
 
         rte_pktmbuf_adj(mbuf, sizeof(struct ether_hdr));
         arp = rte_pktmbuf_mtod(mbuf, struct arp_hdr *);
         rte_pktmbuf_prepend(mbuf,(uint16_t)sizeof(struct ether_hdr));
         if (rte_be_to_cpu_16(arp->arp_op) == ARP_OP_REPLY) {
-            for (i = 0; i < DPVS_MAX_LCORE; i++) {
-                if ((i == cid) || (!is_lcore_id_fwd(i))
-                     || (i == rte_get_master_lcore()))
-                    continue;
-                /*rte_pktmbuf_clone will not clone pkt.data, just copy pointer!*/
-                mbuf_clone = rte_pktmbuf_clone(mbuf, mbuf_pool);
+            if (neigh_lcore == NETIF_LCORE_ID_INVALID) {
+                arp_ring_fanout(mbuf, cid);
+            } else {
+                /* a single clone, the neigh lcore does the fan-out */
+                mbuf_clone = rte_pktmbuf_clone(mbuf,
+                                               pktmbuf_pool[rte_socket_id()]);
                 if (mbuf_clone) {
-                    int ret = rte_ring_enqueue(arp_ring[i], mbuf_clone);
-                    if (unlikely(-EDQUOT == ret)) {
-                        RTE_LOG(WARNING, NETIF, "%s: arp ring of lcore %d quota exceeded\n",
-                                __func__, i);
-                    }
-                    else if (ret < 0) {
-                        RTE_LOG(WARNING, NETIF, "%s: arp ring of lcore %d enqueue failed\n",
-                                __func__, i);
+                    mbuf_clone->udata64 = cid; /* see try_neigh_lcore_loop */
+                    if (rte_ring_enqueue(arp_ring[neigh_lcore], mbuf_clone) < 0) {
+                        RTE_BLOG(WARNING, NETIF, "%s: arp ring of neigh lcore %d "
+                                 "enqueue failed\n", __func__, neigh_lcore);
                         rte_pktmbuf_free(mbuf_clone);
                     }
                 }
@@ -2283,8 +2625,10 @@ static int netif_arp_ring_init(void)
     int socket_id;
     uint8_t cid;
 
-    socket_id = rte_socket_id();
     for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        /* the ring is consumed by lcore @cid */
+        socket_id = rte_lcore_is_enabled(cid) ?
+                    rte_lcore_to_socket_id(cid) : rte_socket_id();
         snprintf(name_buf, RTE_RING_NAMESIZE, "arp_ring_c%d", cid);
         arp_ring[cid] = rte_ring_create(name_buf, ARP_RING_SIZE, socket_id, RING_F_SC_DEQ);
 
@@ -2342,7 +2686,7 @@ void lcore_process_packets(struct netif_queue_conf *qconf, struct rte_mbuf **mbu
                                 pktmbuf_pool[dev->socket]))))
                 kni_ingress(mbuf_copied, dev, qconf);
             else
-                RTE_LOG(WARNING, NETIF, "%s: Failed to copy mbuf\n",
+                RTE_BLOG(WARNING, NETIF, "%s: Failed to copy mbuf\n",
                         __func__);
         }
 
@@ -2353,11 +2697,11 @@ void lcore_process_packets(struct netif_queue_conf *qconf, struct rte_mbuf **mbu
          */
 
         /*
-         * handle VLAN
+         * handle VLAN (and QinQ)
          * if HW offload vlan strip, it's still need vlan module
          * to act as VLAN filter.
          */
-        if (eth_hdr->ether_type == htons(ETH_P_8021Q) ||
+        if (eth_type_vlan(eth_hdr->ether_type) ||
             mbuf->ol_flags & PKT_RX_VLAN_STRIPPED) {
 
             if (vlan_rcv(mbuf, netif_port_get(mbuf->port)) != EDPVS_OK) {
@@ -2409,6 +2753,8 @@ static void lcore_job_recv_fwd(void *arg)
     portid_t pid;
     lcoreid_t cid;
     struct netif_queue_conf *qconf;
+    uint64_t start = rte_rdtsc();
+    uint32_t nrx = 0;
 
     cid = rte_lcore_id();
     assert(LCORE_ID_ANY != cid);
@@ -2422,14 +2768,66 @@ static void lcore_job_recv_fwd(void *arg)
 
             lcore_process_arp_ring(qconf, cid);
             lcore_process_redirect_ring(qconf, cid);
+            if (DPVS_BENCH_RX_HELD())
+                continue;
+
+            DPVS_BENCH_START(rx_tsc);
+            DPVS_PROF_START(prof_tsc);
             qconf->len = netif_rx_burst(pid, qconf);
+            if (qconf->len) {
+                DPVS_BENCH_END(DPVS_BENCH_RX, rx_tsc, qconf->len);
+                DPVS_PROF_END(DPVS_PROF_RX, prof_tsc);
+            }
 
             lcore_stats_burst(&lcore_stats[cid], qconf->len);
 
+            DPVS_BENCH_START(l2_tsc);
             lcore_process_packets(qconf, qconf->mbufs, cid, qconf->len, 0);
+            if (qconf->len)
+                DPVS_BENCH_END(DPVS_BENCH_L2, l2_tsc, qconf->len);
+            nrx += qconf->len;
             kni_send2kern_loop(pid, qconf);
         }
     }
+
+    /* idle polling is not counted, see netif_lcore_load */
+    if (nrx) {
+        lcore_stats[cid].busy_cycles += rte_rdtsc() - start;
+        lcore_idle[cid].polls = 0;
+    } else if (lcore_idle[cid].polls < UINT32_MAX) {
+        lcore_idle[cid].polls++;
+    }
+}
+
+/*
+ * load of the calling lcore: TSC cycles spent on non-empty rx bursts
+ * since start, and the highest percentage of rx descriptors in use of
+ * its rx queues, -1 if no queue supports rte_eth_rx_queue_count.
+ */
+void netif_lcore_load(uint64_t *busy_cycles, int *rxq_usage)
+{
+    int i, j, cnt, usage = -1;
+    struct netif_port *port;
+    struct netif_port_conf *pconf;
+    lcoreid_t cid = rte_lcore_id();
+
+    *busy_cycles = lcore_stats[cid].busy_cycles;
+
+    for (i = 0; i < lcore_conf[lcore2index[cid]].nports; i++) {
+        pconf = &lcore_conf[lcore2index[cid]].pqs[i];
+        port = netif_port_get(pconf->id);
+        if (!port || !port->rxq_desc_nb)
+            continue;
+
+        for (j = 0; j < pconf->nrxq; j++) {
+            cnt = rte_eth_rx_queue_count(pconf->id, pconf->rxqs[j].id);
+            if (cnt < 0)
+                continue;
+            usage = RTE_MAX(usage, cnt * 100 / port->rxq_desc_nb);
+        }
+    }
+
+    *rxq_usage = usage;
 }
 
 static void lcore_job_xmit(void *args)
@@ -2453,7 +2851,6 @@ static void lcore_job_xmit(void *args)
             if (qconf->len <= 0)
                 continue;
             netif_tx_burst(cid, pid, j);
-            qconf->len = 0;
         }
     }
 }
@@ -2467,13 +2864,162 @@ static void lcore_job_timer_manage(void *args)
 
     if (unlikely((now - tm_manager_time[cid]) * 1000000 / cycles_per_sec
             > timer_sched_interval_us)) {
+        DPVS_PROF_START(prof_tsc);
         rte_timer_manage();
+        DPVS_PROF_END(DPVS_PROF_TIMER, prof_tsc);
         tm_manager_time[cid] = now;
     }
 }
 
+/*
+ * adaptive polling: after @netif_idle_pause_polls empty loops in a row an
+ * lcore backs off by rte_pause, doubling every NETIF_IDLE_PAUSE_STEP loops.
+ * after @netif_idle_sleep_polls it arms rx interrupts of its queues and
+ * sleeps on them for @netif_idle_sleep_ms at most, which also bounds the
+ * latency of timers and of rings not waking it up.
+ */
+#define NETIF_IDLE_PAUSE_STEP       64
+#define NETIF_IDLE_PAUSE_SHIFT_MAX  10
+#define NETIF_IDLE_EVENTS           16
+
+struct netif_lcore_sleep netif_lcore_sleeps[DPVS_MAX_LCORE];
+
+void __netif_lcore_wakeup(lcoreid_t cid)
+{
+    uint64_t one = 1;
+    int efd = netif_lcore_sleeps[cid].efd;
+
+    /* EAGAIN means it's being woken up already */
+    if (efd >= 0 && write(efd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        RTE_LOG(DEBUG, NETIF, "%s: lcore%d: %s\n", __func__, cid, strerror(errno));
+}
+
+/* runs on each lcore, the epoll instance is per thread */
+static void lcore_job_idle_init(void *arg)
+{
+    int i, j, efd;
+    portid_t pid;
+    queueid_t qid;
+    struct netif_port *port;
+    lcoreid_t cid = rte_lcore_id();
+    struct netif_lcore_idle *idle = &lcore_idle[cid];
+
+    for (i = 0; i < lcore_conf[lcore2index[cid]].nports; i++) {
+        pid = lcore_conf[lcore2index[cid]].pqs[i].id;
+        port = netif_port_get(pid);
+
+        for (j = 0; j < lcore_conf[lcore2index[cid]].pqs[i].nrxq; j++) {
+            qid = lcore_conf[lcore2index[cid]].pqs[i].rxqs[j].id;
+            if (!port || port->type != PORT_TYPE_GENERAL ||
+                    rte_eth_dev_rx_intr_ctl_q(pid, qid, RTE_EPOLL_PER_THREAD,
+                                              RTE_INTR_EVENT_ADD, NULL) < 0) {
+                RTE_LOG(WARNING, NETIF, "lcore%d: no rx interrupt of port%d "
+                        "rx%d, lcore never sleeps\n", cid, pid, qid);
+                return;
+            }
+        }
+    }
+
+    efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (efd < 0) {
+        RTE_LOG(WARNING, NETIF, "lcore%d: eventfd: %s, lcore never sleeps\n",
+                cid, strerror(errno));
+        return;
+    }
+
+    idle->efd_ev.epdata.event = EPOLLIN;
+    if (rte_epoll_ctl(RTE_EPOLL_PER_THREAD, EPOLL_CTL_ADD, efd,
+                      &idle->efd_ev) < 0) {
+        RTE_LOG(WARNING, NETIF, "lcore%d: fail to watch eventfd, "
+                "lcore never sleeps\n", cid);
+        close(efd);
+        return;
+    }
+
+    netif_lcore_sleeps[cid].efd = efd;
+    idle->can_sleep = true;
+    RTE_LOG(INFO, NETIF, "lcore%d sleeps after %u empty loops\n",
+            cid, netif_idle_sleep_polls);
+}
+
+static int lcore_rx_intr_set(lcoreid_t cid, bool on)
+{
+    int i, j;
+    portid_t pid;
+    queueid_t qid;
+
+    for (i = 0; i < lcore_conf[lcore2index[cid]].nports; i++) {
+        pid = lcore_conf[lcore2index[cid]].pqs[i].id;
+
+        for (j = 0; j < lcore_conf[lcore2index[cid]].pqs[i].nrxq; j++) {
+            qid = lcore_conf[lcore2index[cid]].pqs[i].rxqs[j].id;
+            if (!on) {
+                rte_eth_dev_rx_intr_disable(pid, qid);
+                continue;
+            }
+
+            if (rte_eth_dev_rx_intr_enable(pid, qid) < 0)
+                return EDPVS_DPDKAPIFAIL;
+            /* packets arrived before armed raise no interrupt */
+            if (rte_eth_rx_queue_count(pid, qid) > 0)
+                return EDPVS_BUSY;
+        }
+    }
+
+    return EDPVS_OK;
+}
+
+static void lcore_sleep(lcoreid_t cid)
+{
+    struct netif_lcore_sleep *sleep = &netif_lcore_sleeps[cid];
+    struct rte_epoll_event events[NETIF_IDLE_EVENTS];
+    uint64_t cnt;
+
+    /* packets sent by jobs after xmit of this loop */
+    lcore_job_xmit(NULL);
+
+    if (lcore_rx_intr_set(cid, true) == EDPVS_OK) {
+        sleep->sleeping = 1;
+        /* pairs with netif_lcore_wakeup() */
+        rte_smp_mb();
+        if (!msg_lcore_pending(cid))
+            rte_epoll_wait(RTE_EPOLL_PER_THREAD, events, NETIF_IDLE_EVENTS,
+                           netif_idle_sleep_ms);
+        sleep->sleeping = 0;
+    }
+
+    lcore_rx_intr_set(cid, false);
+    /* drain wakeups, nonblocking */
+    while (read(sleep->efd, &cnt, sizeof(cnt)) > 0)
+        ;
+}
+
+/* called at the end of each loop */
+static inline void lcore_idle_backoff(lcoreid_t cid)
+{
+    struct netif_lcore_idle *idle = &lcore_idle[cid];
+    uint32_t n, shift;
+
+    if (likely(idle->polls == 0))
+        return;
+
+    if (idle->can_sleep && idle->polls >= netif_idle_sleep_polls) {
+        lcore_sleep(cid);
+        return;
+    }
+
+    if (netif_idle_pause_polls && idle->polls >= netif_idle_pause_polls) {
+        shift = (idle->polls - netif_idle_pause_polls) / NETIF_IDLE_PAUSE_STEP;
+        if (shift > NETIF_IDLE_PAUSE_SHIFT_MAX)
+            shift = NETIF_IDLE_PAUSE_SHIFT_MAX;
+        for (n = 1u << shift; n > 0; n--)
+            rte_pause();
+    }
+}
+
 #define NETIF_JOB_COUNT 3
 struct netif_lcore_loop_job netif_jobs[NETIF_JOB_COUNT];
+static struct netif_lcore_loop_job netif_idle_job;
 static void netif_lcore_init(void)
 {
     int ii, res;
@@ -2499,6 +3045,9 @@ static void netif_lcore_init(void)
     if ((res = check_lcore_conf(rte_lcore_count(), lcore_conf)) != EDPVS_OK)
         rte_exit(EXIT_FAILURE, "[%s] bad lcore configuration (err=%d),"
                 " exit ...\n", __func__, res);
+    if ((res = check_lcore_numa(lcore_conf)) > 0 && netif_numa_strict)
+        rte_exit(EXIT_FAILURE, "[%s] %d queues on remote NUMA socket with "
+                "numa_strict on, exit ...\n", __func__, res);
 
     /* build port fast searching table */
     port_index_init();
@@ -2525,6 +3074,19 @@ static void netif_lcore_init(void)
             break;
         }
     }
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++)
+        netif_lcore_sleeps[cid].efd = -1;
+
+    if (netif_idle_sleep_on) {
+        snprintf(netif_idle_job.name, sizeof(netif_idle_job.name) - 1, "%s", "idle_init");
+        netif_idle_job.func = lcore_job_idle_init;
+        netif_idle_job.data = NULL;
+        netif_idle_job.type = NETIF_LCORE_JOB_INIT;
+        if (netif_lcore_loop_job_register(&netif_idle_job) < 0)
+            rte_exit(EXIT_FAILURE,
+                    "[%s] Fail to register netif idle job, exiting ...\n", __func__);
+    }
 }
 
 static inline void netif_lcore_cleanup(void)
@@ -2535,6 +3097,9 @@ static inline void netif_lcore_cleanup(void)
         if (netif_lcore_loop_job_unregister(&netif_jobs[ii]) < 0)
             RTE_LOG(WARNING, NETIF, "[%s] Fail to unregister netif lcore jobs\n", __func__);
     }
+
+    if (netif_idle_sleep_on)
+        netif_lcore_loop_job_unregister(&netif_idle_job);
 }
 
 /********************************************** kni *************************************************/
@@ -2655,7 +3220,56 @@ void kni_process_on_master(void)
             continue;
 
         kni_handle_request(dev);
-        kni_send2port_loop(dev);
+        if (kni_lcore == NETIF_LCORE_ID_INVALID)
+            kni_send2port_loop(dev);
+    }
+}
+
+static void try_kni_lcore_loop(void)
+{
+    struct netif_port *dev;
+    lcoreid_t cid = rte_lcore_id();
+    portid_t id;
+
+    if (cid != kni_lcore)
+        return;
+    RTE_LOG(INFO, NETIF, "KNI I/O on lcore%d !!!\n", cid);
+
+    while (1) {
+        for (id = 0; id < g_nports; id++) {
+            dev = netif_port_get(id);
+            if (dev && kni_dev_exist(dev))
+                kni_send2port_loop(dev);
+        }
+        lcore_stats[cid].lcore_loop++;
+    }
+}
+
+static void try_neigh_lcore_loop(void)
+{
+    struct rte_mbuf *mbufs[NETIF_MAX_PKT_BURST];
+    lcoreid_t cid = rte_lcore_id();
+    unsigned nb_rb, i;
+
+    if (cid != neigh_lcore)
+        return;
+    RTE_LOG(INFO, NETIF, "neighbour relay on lcore%d !!!\n", cid);
+
+    /* ipackets counts ARP replies and neighbour entries relayed */
+    while (1) {
+        /* ARP replies, tagged with the lcore they were received on */
+        nb_rb = rte_ring_dequeue_burst(arp_ring[cid], (void **)mbufs,
+                                       NETIF_MAX_PKT_BURST, NULL);
+        for (i = 0; i < nb_rb; i++) {
+            lcore_stats[cid].ibytes += mbufs[i]->pkt_len;
+            arp_ring_fanout(mbufs[i], (lcoreid_t)mbufs[i]->udata64);
+            rte_pktmbuf_free(mbufs[i]);
+        }
+        lcore_stats[cid].ipackets += nb_rb;
+
+        /* neighbour entries of the control API and ndisc */
+        lcore_stats[cid].ipackets += neigh_relay_ring();
+        lcore_stats[cid].lcore_loop++;
     }
 }
 
@@ -2991,19 +3605,12 @@ static inline void setup_dev_of_flags(struct netif_port *port)
     }
 
     /*
-     * we may have multiple vlan dev on one rte_ethdev,
-     * and mbuf->vlan_tci is RX only!
-     * while there's only one PVID (DEV_TX_OFFLOAD_VLAN_INSERT),
-     * to make things easier, do not support TX VLAN instert offload.
-     * or we have to check if VID is PVID (than to tx offload it).
+     * we may have multiple vlan dev on one rte_ethdev, so PVID is not
+     * used. the tag is inserted per packet from mbuf->vlan_tci with
+     * PKT_TX_VLAN_PKT, see vlan_xmit() and validate_xmit_mbuf().
      */
-#if 0
-    if (dev_info->tx_offload_capa & DEV_TX_OFFLOAD_VLAN_INSERT) {
+    if (port->dev_info.tx_offload_capa & DEV_TX_OFFLOAD_VLAN_INSERT)
         port->flag |= NETIF_PORT_FLAG_TX_VLAN_INSERT_OFFLOAD;
-        port->dev_conf.txmode.hw_vlan_insert_pvid = 1;
-        rte_eth_dev_set_vlan_pvid();
-    }
-#endif
 
     /* rx offload conf and flags */
     if (port->dev_info.rx_offload_capa & DEV_RX_OFFLOAD_VLAN_STRIP) {
@@ -3143,6 +3750,23 @@ int netif_get_queue(struct netif_port *port, lcoreid_t cid, queueid_t *qid)
     return EDPVS_OK;
 }
 
+/* get the lcore which processes rx queue @qid of @port */
+int netif_get_queue_lcore(const struct netif_port *port, queueid_t qid,
+                          lcoreid_t *cid)
+{
+    assert(port && cid);
+
+    if (unlikely(port->id >= NETIF_MAX_PORTS || qid >= NETIF_MAX_QUEUES))
+        return EDPVS_INVAL;
+
+    if (pql_map[port->id].pid != port->id ||
+            pql_map[port->id].rx_qid[qid] == NETIF_PORT_ID_INVALID)
+        return EDPVS_NOTEXIST;
+
+    *cid = pql_map[port->id].rx_qid[qid];
+    return EDPVS_OK;
+}
+
 int netif_get_link(struct netif_port *dev, struct rte_eth_link *link)
 {
     assert(dev && dev->netif_ops && link);
@@ -3478,6 +4102,9 @@ int netif_port_start(struct netif_port *port)
     // device configure
     if ((ret = netif_port_fdir_dstport_mask_set(port)) != EDPVS_OK)
         return ret;
+    /* rx interrupts to sleep on, see lcore_job_idle_init */
+    if (netif_idle_sleep_on && port->type == PORT_TYPE_GENERAL)
+        port->dev_conf.intr_conf.rxq = 1;
     ret = rte_eth_dev_configure(port->id, port->nrxq, port->ntxq, &port->dev_conf);
     if (ret < 0 ) {
         RTE_LOG(ERR, NETIF, "%s: fail to config %s\n", __func__, port->name);
@@ -3506,6 +4133,9 @@ int netif_port_start(struct netif_port *port)
                     || (port->flag & NETIF_PORT_FLAG_TX_UDP_CSUM_OFFLOAD)
                     || (port->flag & NETIF_PORT_FLAG_TX_TCP_CSUM_OFFLOAD))
                 txconf.txq_flags = 0;
+            /* simple tx path of some PMDs ignores PKT_TX_VLAN_PKT */
+            if (port->flag & NETIF_PORT_FLAG_TX_VLAN_INSERT_OFFLOAD)
+                txconf.txq_flags &= ~ETH_TXQ_FLAGS_NOVLANOFFL;
             ret = rte_eth_tx_queue_setup(port->id, qid, port->txq_desc_nb,
                     port->socket, &txconf);
             if (ret < 0) {
@@ -3556,6 +4186,13 @@ int netif_port_start(struct netif_port *port)
 
     port->flag |= NETIF_PORT_FLAG_RUNNING;
 
+    /* RETA, RSS key or queue-lcore map may differ from last start,
+     * sa_pool retries by itself if workers are still on old state */
+    ret = sa_pool_rss_update(port);
+    if (ret < 0)
+        RTE_LOG(WARNING, NETIF, "%s: fail to update RSS state of sa_pool "
+                "for %s: %s\n", __func__, port->name, dpvs_strerror(ret));
+
     // enable promicuous mode if configured
     if (promisc_on) {
         RTE_LOG(INFO, NETIF, "promiscous mode enabled for device %s\n", port->name);
@@ -3928,65 +4565,59 @@ inline static void netif_port_init(const struct rte_eth_conf *conf)
 }
 
 /******************************************* module ***********************************************/
-void netif_update_master_loop_cnt(void)
+/*
+ * number of loops lcore @cid has started. an lcore holds no reference to
+ * shared data between two loops, so a change of it is a quiescent state.
+ */
+uint64_t netif_lcore_loops(lcoreid_t cid)
 {
-    lcoreid_t cid = rte_get_master_lcore();
-    lcore_stats[cid].lcore_loop++;
+    return *(volatile uint64_t *)&lcore_stats[cid].lcore_loop;
 }
 
-#ifdef CONFIG_RECORD_BIG_LOOP
-#define BIG_LOOP_THRESH 2000 // 2000 us
-static uint32_t longest_lcore_loop[DPVS_MAX_LCORE] = { 0 };
-
-static void print_job_time(char *buf, size_t len)
+/* save loop counts of other lcores, right after unlinking shared data */
+void netif_lcore_loops_save(uint64_t *loops)
 {
-    assert(buf);
-    size_t pos = 0;
-    struct netif_lcore_loop_job *job;
     lcoreid_t cid;
 
-    memset(buf, 0, len);
-    cid = rte_lcore_id();
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++)
+        loops[cid] = (cid == rte_lcore_id()) ? 0 : netif_lcore_loops(cid);
+}
 
-    list_for_each_entry(job, &netif_lcore_jobs[NETIF_LCORE_JOB_INIT], list) {
-        if (unlikely(pos + 1 >= len))
-            return;
-        snprintf(buf + pos, len - pos - 1, "%s=%d ",
-                job->name, job->job_time[cid]);
-        pos = strlen(buf);
-    }
+/* all lcores passed a quiescent state since @loops were saved ? */
+bool netif_lcores_quiescent(const uint64_t *loops)
+{
+    lcoreid_t cid;
 
-    list_for_each_entry(job, &netif_lcore_jobs[NETIF_LCORE_JOB_LOOP], list) {
-        if (unlikely(pos + 1 >= len))
-            return;
-        snprintf(buf + pos, len - pos - 1, "%s=%d ",
-                job->name, job->job_time[cid]);
-        pos = strlen(buf);
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        /* 0: lcore not looping, e.g., idle or the one saved (we're on) */
+        if (loops[cid] && loops[cid] == netif_lcore_loops(cid))
+            return false;
     }
 
-    list_for_each_entry(job, &netif_lcore_jobs[NETIF_LCORE_JOB_SLOW], list) {
-        if (unlikely(pos + 1 >= len))
-            return;
-        snprintf(buf + pos, len - pos - 1, "%s=%d ",
-                job->name, job->job_time[cid]);
-        pos = strlen(buf);
-    }
+    return true;
 }
-#endif
 
-static inline void do_lcore_job(struct netif_lcore_loop_job *job)
+void netif_update_master_loop_cnt(void)
 {
-#ifdef CONFIG_RECORD_BIG_LOOP
-    uint64_t job_start, job_end;
-    job_start = rte_get_timer_cycles();
-#endif
+    lcoreid_t cid = rte_get_master_lcore();
+    lcore_stats[cid].lcore_loop++;
+}
 
-    job->func(job->data);
+/* @prof: time the job into its histogram, decided once per loop */
+static inline void do_lcore_job(struct netif_lcore_loop_job *job, bool prof)
+{
+    uint64_t start;
 
-#ifdef CONFIG_RECORD_BIG_LOOP
-    job_end = rte_get_timer_cycles();
-    job->job_time[rte_lcore_id()] = (job_end - job_start) * 1E6 / cycles_per_sec;
-#endif
+    if (likely(!prof)) {
+        job->func(job->data);
+        return;
+    }
+
+    start = rte_rdtsc();
+    job->func(job->data);
+    if (job->prof_id >= 0)
+        dpvs_prof_hist_add(&dpvs_prof_this()->jobs[job->prof_id],
+                           rte_rdtsc() - start);
 }
 
 static uint32_t netif_loop_tick[DPVS_MAX_LCORE] = { 0 };
@@ -3995,11 +4626,8 @@ static int netif_loop(void *dummy)
 {
     struct netif_lcore_loop_job *job;
     lcoreid_t cid = rte_lcore_id();
-#ifdef CONFIG_RECORD_BIG_LOOP
-    char buf[512];
-    uint32_t loop_time;
-    uint64_t loop_start, loop_end;
-#endif
+    uint64_t loop_start = 0;
+    bool prof;
 
 #ifdef DPVS_MAX_LCORE
     if (cid >= DPVS_MAX_LCORE)
@@ -4009,43 +4637,38 @@ static int netif_loop(void *dummy)
     assert(LCORE_ID_ANY != cid);
 
     try_isol_rxq_lcore_loop();
+    try_kni_lcore_loop();
+    try_neigh_lcore_loop();
     if (0 == lcore_conf[lcore2index[cid]].nports) {
         RTE_LOG(INFO, NETIF, "[%s] Lcore %d has nothing to do.\n", __func__, cid);
         return EDPVS_IDLE;
     }
 
     list_for_each_entry(job, &netif_lcore_jobs[NETIF_LCORE_JOB_INIT], list) {
-        do_lcore_job(job);
+        do_lcore_job(job, false);
     }
     while (1) {
-#ifdef CONFIG_RECORD_BIG_LOOP
-        loop_start = rte_get_timer_cycles();
-#endif
+        prof = dpvs_prof_sample();
+        if (unlikely(prof))
+            loop_start = rte_rdtsc();
+
         lcore_stats[cid].lcore_loop++;
         list_for_each_entry(job, &netif_lcore_jobs[NETIF_LCORE_JOB_LOOP], list) {
-            do_lcore_job(job);
+            do_lcore_job(job, prof);
         }
         ++netif_loop_tick[cid];
         list_for_each_entry(job, &netif_lcore_jobs[NETIF_LCORE_JOB_SLOW], list) {
             if (netif_loop_tick[cid] % job->skip_loops == 0) {
-                do_lcore_job(job);
+                do_lcore_job(job, prof);
                 //netif_loop_tick[cid] = 0;
             }
         }
-#ifdef CONFIG_RECORD_BIG_LOOP
-        loop_end = rte_get_timer_cycles();
-        loop_time = (loop_end - loop_start) * 1E6 / cycles_per_sec;
-        if (loop_time > longest_lcore_loop[cid]) {
-            RTE_LOG(WARNING, NETIF, "update longest_lcore_loop[%d] = %d (<- %d)\n",
-                    cid, loop_time, longest_lcore_loop[cid]);
-            longest_lcore_loop[cid] = loop_time;
-        }
-        if (loop_time > BIG_LOOP_THRESH) {
-            print_job_time(buf, sizeof(buf));
-            RTE_LOG(WARNING, NETIF, "lcore[%d] loop over %d usecs (actual=%d, max=%d):\n%s\n",
-                    cid, BIG_LOOP_THRESH, loop_time, longest_lcore_loop[cid], buf);
-        }
-#endif
+
+        if (unlikely(prof))
+            dpvs_prof_hist_add(&dpvs_prof_this()->loop,
+                               rte_rdtsc() - loop_start);
+
+        lcore_idle_backoff(cid);
     }
     return EDPVS_OK;
 }
@@ -4217,6 +4840,10 @@ static int get_lcore_mask(void **out, size_t *out_len)
     get->slave_lcore_mask = g_slave_lcore_mask;
     get->isol_rx_lcore_num = g_isol_rx_lcore_num;
     get->isol_rx_lcore_mask = g_isol_rx_lcore_mask;
+    get->kni_lcore_num = (kni_lcore != NETIF_LCORE_ID_INVALID);
+    get->kni_lcore_id = kni_lcore;
+    get->neigh_lcore_num = (neigh_lcore != NETIF_LCORE_ID_INVALID);
+    get->neigh_lcore_id = neigh_lcore;
 
     *out = get;
     *out_len = sizeof(netif_lcore_mask_get_t);
@@ -4258,6 +4885,69 @@ static int get_lcore_basic(lcoreid_t cid, void **out, size_t *out_len)
     return EDPVS_OK;
 }
 
+static int get_lcore_numa(lcoreid_t cid, void **out, size_t *out_len)
+{
+    assert(out && out_len);
+
+    netif_lcore_numa_get_t *get;
+    struct netif_lcore_conf *plcore = NULL;
+    struct netif_port_conf *pq;
+    struct netif_lcore_numa_entry *ent;
+    struct netif_port *port;
+    int i, j, nent = 0;
+    size_t len;
+
+    i = 0;
+    while (lcore_conf[i].nports > 0) {
+        if (lcore_conf[i].id == cid) {
+            plcore = &lcore_conf[i];
+            break;
+        }
+        ++i;
+    }
+
+    if (plcore) {
+        for (i = 0; i < plcore->nports; i++)
+            nent += plcore->pqs[i].nrxq + plcore->pqs[i].ntxq;
+    }
+
+    len = sizeof(netif_lcore_numa_get_t) + nent * sizeof(*ent);
+    get = rte_zmalloc_socket(NULL, len, RTE_CACHE_LINE_SIZE, rte_socket_id());
+    if (unlikely(NULL == get))
+        return EDPVS_NOMEM;
+
+    get->lcore_id = cid;
+    get->socket_id = rte_lcore_to_socket_id(cid);
+    get->arp_ring_socket = arp_ring[cid]->memzone->socket_id;
+    if (get->arp_ring_socket != get->socket_id)
+        get->nremote++;
+
+    for (i = 0; plcore && i < plcore->nports; i++) {
+        pq = &plcore->pqs[i];
+        port = netif_port_get(pq->id);
+        if (!port)
+            continue;
+
+        for (j = 0; j < pq->nrxq + pq->ntxq; j++) {
+            ent = &get->entries[get->nentries++];
+            snprintf(ent->port_name, sizeof(ent->port_name), "%s", port->name);
+            ent->is_rx = j < pq->nrxq;
+            ent->qid = ent->is_rx ? pq->rxqs[j].id : pq->txqs[j - pq->nrxq].id;
+            ent->port_socket = port->socket;
+            ent->pool_socket = port->mbuf_pool ?
+                               port->mbuf_pool->socket_id : port->socket;
+            if (ent->port_socket != get->socket_id ||
+                    ent->pool_socket != get->socket_id)
+                get->nremote++;
+        }
+    }
+
+    *out = get;
+    *out_len = sizeof(netif_lcore_numa_get_t) + get->nentries * sizeof(*ent);
+
+    return EDPVS_OK;
+}
+
 static int lcore_stats_msg_cb(struct dpvs_msg *msg)
 {
     void *reply_data;
@@ -4330,6 +5020,27 @@ static inline int lcore_stats_msg_term(void)
     return EDPVS_OK;
 }
 
+/* per tx queue counters of @cid, read without the lcore, may be stale */
+static void netif_lcore_txq_stats(lcoreid_t cid, netif_lcore_stats_get_t *get)
+{
+    struct netif_lcore_conf *plcore = &lcore_conf[lcore2index[cid]];
+    struct netif_queue_conf *txq;
+    int i, j;
+
+    for (i = 0; i < plcore->nports; i++) {
+        for (j = 0; j < plcore->pqs[i].ntxq; j++) {
+            if (get->ntxq >= NETIF_LCORE_MAX_TXQ_STATS)
+                return;
+            txq = &plcore->pqs[i].txqs[j];
+            get->txqs[get->ntxq].pid = plcore->pqs[i].id;
+            get->txqs[get->ntxq].qid = txq->id;
+            get->txqs[get->ntxq].retried = txq->tx_retried;
+            get->txqs[get->ntxq].dropped = txq->tx_dropped;
+            get->ntxq++;
+        }
+    }
+}
+
 static int get_lcore_stats(lcoreid_t cid, void **out, size_t *out_len)
 {
     assert(out && out_len);
@@ -4342,7 +5053,7 @@ static int get_lcore_stats(lcoreid_t cid, void **out, size_t *out_len)
     if (unlikely(!get))
         return EDPVS_NOMEM;
 
-    if (is_isol_rxq_lcore(cid)) {
+    if (is_isol_rxq_lcore(cid) || cid == kni_lcore || cid == neigh_lcore) {
         /* use write lock to ensure data safety */
         memcpy(&stats, &lcore_stats[cid], sizeof(stats));
     } else {
@@ -4383,6 +5094,9 @@ static int get_lcore_stats(lcoreid_t cid, void **out, size_t *out_len)
     get->opackets = stats.opackets;
     get->obytes = stats.obytes;
     get->dropped = stats.dropped;
+    get->txretry = stats.txretry;
+    get->txdrop = stats.txdrop;
+    netif_lcore_txq_stats(cid, get);
 
     *out = get;
     *out_len = sizeof(netif_lcore_stats_get_t);
@@ -4814,6 +5528,14 @@ static int netif_sockopt_get(sockoptid_t opt, const void *in, size_t inlen,
                 return EDPVS_INVAL;
             ret = get_lcore_stats(cid, out, outlen);
             break;
+        case SOCKOPT_NETIF_GET_LCORE_NUMA:
+            if (!in || inlen != sizeof(lcoreid_t))
+                return EDPVS_INVAL;
+            cid = *(lcoreid_t *)in;
+            if (!is_lcore_id_valid(cid))
+                return EDPVS_INVAL;
+            ret = get_lcore_numa(cid, out, outlen);
+            break;
         case SOCKOPT_NETIF_GET_PORT_LIST:
             ret = get_port_list(out, outlen);
             break;
@@ -0,0 +1,183 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include "common.h"
+#include "ctrl.h"
+#include "prof.h"
+#include "conf/prof.h"
+
+#define DPVS_PROF_SAMPLE_DEF    64
+
+struct dpvs_prof_lcore dpvs_prof_lcores[DPVS_MAX_LCORE];
+volatile bool dpvs_prof_enabled = false;
+volatile uint32_t dpvs_prof_sample_mask = DPVS_PROF_SAMPLE_DEF - 1;
+volatile uint32_t dpvs_prof_reset_gen = 0;
+
+/* loop job names, registered on initialization stage only */
+static char prof_job_names[DPVS_PROF_JOB_MAX][DPVS_PROF_NAME_LEN];
+static int prof_nb_jobs = 0;
+
+/* return histogram index of the job, -1 if no room */
+int dpvs_prof_job_register(const char *name)
+{
+    int i;
+
+    /* jobs re-registered keep their histograms */
+    for (i = 0; i < prof_nb_jobs; i++) {
+        if (strncmp(prof_job_names[i], name, DPVS_PROF_NAME_LEN) == 0)
+            return i;
+    }
+
+    if (prof_nb_jobs >= DPVS_PROF_JOB_MAX) {
+        RTE_LOG(WARNING, PROF, "%s: no room for job %s\n", __func__, name);
+        return -1;
+    }
+
+    snprintf(prof_job_names[prof_nb_jobs], DPVS_PROF_NAME_LEN, "%s", name);
+    return prof_nb_jobs++;
+}
+
+static int prof_sockopt_set(sockoptid_t opt, const void *conf, size_t size)
+{
+    const struct dp_vs_prof_conf *pconf = conf;
+
+    switch (opt) {
+    case SOCKOPT_SET_PROF:
+        if (!conf || size < sizeof(*pconf))
+            return EDPVS_INVAL;
+        if (pconf->sample && !rte_is_power_of_2(pconf->sample))
+            return EDPVS_INVAL;
+
+        if (pconf->sample)
+            dpvs_prof_sample_mask = pconf->sample - 1;
+        /* stale samples of an earlier run would skew the histograms */
+        if (pconf->enable && !dpvs_prof_enabled)
+            dpvs_prof_reset_gen++;
+        rte_wmb();
+        dpvs_prof_enabled = !!pconf->enable;
+
+        RTE_LOG(INFO, PROF, "prof: %s, sample 1/%u\n",
+                dpvs_prof_enabled ? "on" : "off", dpvs_prof_sample_mask + 1);
+        return EDPVS_OK;
+    case SOCKOPT_SET_PROF_RESET:
+        dpvs_prof_reset_gen++;
+        return EDPVS_OK;
+    default:
+        return EDPVS_NOTSUPP;
+    }
+}
+
+static void prof_fill_hist(struct dp_vs_prof_hist *out, lcoreid_t cid,
+                           int kind, int id, const char *name,
+                           const struct dpvs_prof_hist *h)
+{
+    out->cid    = cid;
+    out->kind   = kind;
+    out->id     = id;
+    snprintf(out->name, sizeof(out->name), "%s", name);
+    out->count  = h->count;
+    out->cycles = h->cycles;
+    out->max    = h->max;
+    rte_memcpy(out->buckets, h->buckets, sizeof(out->buckets));
+}
+
+static int prof_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
+                            void **out, size_t *outsize)
+{
+    struct dp_vs_prof_conf_array *array;
+    const struct dpvs_prof_lcore *p;
+    size_t nhist = 0;
+    lcoreid_t cid;
+    int i;
+
+    /* lockless read, histograms may be a sample behind */
+    RTE_LCORE_FOREACH(cid) {
+        if (cid >= DPVS_MAX_LCORE)
+            continue;
+        p = &dpvs_prof_lcores[cid];
+        if (p->reset_gen != dpvs_prof_reset_gen)
+            continue;   /* reset pending */
+
+        for (i = 0; i < DPVS_PROF_STAGE_MAX; i++)
+            nhist += !!p->stages[i].count;
+        for (i = 0; i < prof_nb_jobs; i++)
+            nhist += !!p->jobs[i].count;
+        nhist += !!p->loop.count;
+    }
+
+    *outsize = sizeof(*array) + nhist * sizeof(struct dp_vs_prof_hist);
+    array = rte_calloc_socket(NULL, 1, *outsize, 0, rte_socket_id());
+    if (!array)
+        return EDPVS_NOMEM;
+
+    array->enabled = dpvs_prof_enabled;
+    array->sample = dpvs_prof_sample_mask + 1;
+    array->tsc_hz = rte_get_tsc_hz();
+
+    RTE_LCORE_FOREACH(cid) {
+        if (cid >= DPVS_MAX_LCORE)
+            continue;
+        p = &dpvs_prof_lcores[cid];
+        if (p->reset_gen != dpvs_prof_reset_gen)
+            continue;
+
+        for (i = 0; i < DPVS_PROF_STAGE_MAX && array->nhist < nhist; i++) {
+            if (!p->stages[i].count)
+                continue;
+            prof_fill_hist(&array->hists[array->nhist++], cid,
+                           DPVS_PROF_KIND_STAGE, i, dpvs_prof_stage_name(i),
+                           &p->stages[i]);
+        }
+
+        for (i = 0; i < prof_nb_jobs && array->nhist < nhist; i++) {
+            if (!p->jobs[i].count)
+                continue;
+            prof_fill_hist(&array->hists[array->nhist++], cid,
+                           DPVS_PROF_KIND_JOB, i, prof_job_names[i],
+                           &p->jobs[i]);
+        }
+
+        if (p->loop.count && array->nhist < nhist)
+            prof_fill_hist(&array->hists[array->nhist++], cid,
+                           DPVS_PROF_KIND_LOOP, 0, "loop", &p->loop);
+    }
+
+    /* lcores may have sampled more since counted */
+    *outsize = sizeof(*array) + array->nhist * sizeof(struct dp_vs_prof_hist);
+    *out = array;
+    return EDPVS_OK;
+}
+
+static struct dpvs_sockopts prof_sockopts = {
+    .version            = SOCKOPT_VERSION,
+    .set_opt_min        = SOCKOPT_SET_PROF,
+    .set_opt_max        = SOCKOPT_SET_PROF_RESET,
+    .set                = prof_sockopt_set,
+    .get_opt_min        = SOCKOPT_GET_PROF_SHOW,
+    .get_opt_max        = SOCKOPT_GET_PROF_SHOW,
+    .get                = prof_sockopt_get,
+};
+
+int dpvs_prof_init(void)
+{
+    return sockopt_register(&prof_sockopts);
+}
+
+int dpvs_prof_term(void)
+{
+    return sockopt_unregister(&prof_sockopts);
+}
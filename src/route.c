@@ -50,6 +50,7 @@ struct route_lcore {
 static RTE_DEFINE_PER_LCORE(struct route_lcore, route_lcore);
 static RTE_DEFINE_PER_LCORE(rte_atomic32_t, num_routes);
 static RTE_DEFINE_PER_LCORE(rte_atomic32_t, num_out_routes);
+RTE_DEFINE_PER_LCORE(uint32_t, route4_genid);
 
 static inline bool net_cmp(const struct netif_port *port, uint32_t dest,
                            uint8_t mask, const struct route_entry *route_node)
@@ -84,7 +85,8 @@ static struct route_entry *route_new_entry(struct in_addr* dest,
     struct route_entry *new_route=NULL;
     if(!dest)
         return NULL;
-    new_route = rte_zmalloc("new_route_entry", sizeof(struct route_entry), 0);
+    new_route = rte_zmalloc_socket("new_route_entry", sizeof(struct route_entry),
+                                   0, rte_socket_id());
     if (new_route == NULL){
         return NULL;
     }
@@ -264,6 +266,7 @@ static int route_add_lcore(struct in_addr* dest,uint8_t netmask, uint32_t flag,
               struct in_addr* gw, struct netif_port *port,
               struct in_addr* src, unsigned long mtu,short metric)
 {
+    this_route4_genid++;
 
     if((flag & RTF_LOCALIN) || (flag & RTF_KNI))
         return route_local_add(dest, netmask, flag, gw,
@@ -291,6 +294,8 @@ static int route_del_lcore(struct in_addr* dest,uint8_t netmask, uint32_t flag,
 {
     struct route_entry *route = NULL;
 
+    this_route4_genid++;
+
     if(flag & RTF_LOCALIN || (flag & RTF_KNI)){
         route = route_local_lookup(dest->s_addr, port);
         if (!route)
@@ -470,6 +475,8 @@ static int route_lcore_flush(void)
     int i = 0;
     struct route_entry *route_node;
 
+    this_route4_genid++;
+
     for (i = 0; i < LOCAL_ROUTE_TAB_SIZE; i++){
         list_for_each_entry(route_node, &this_local_route_table[i], list){
             list_del(&route_node->list);
@@ -23,12 +23,19 @@
  * ways to achieve the goal. one is to calc RSS the same way of
  * NIC to select the currect CPU for connect.
  *
- * the way we use is based on Flow-Director (fdir), allocate
+ * the default way we use is based on Flow-Director (fdir), allocate
  * local source (e.g., <ip, port>) for each CPU core in advance.
  * and redirect the back traffic to that CPU by fdir. it does not
  * need too many fdir rules, the number of rules can be equal to
  * the number of CPU core.
  *
+ * for NICs without fdir, "rss_precalc" can be enabled. the RSS key
+ * and RETA of the port are learned from the NIC, and the Toeplitz
+ * hash of the back traffic <rip, lip, rport, lport> is calculated in
+ * software, so that only the lport hashed to the current lcore's
+ * rx queue is fetched. it falls back to fdir if the port's RSS
+ * cannot be calculated.
+ *
  * LVS use laddr and try <laddr,lport> to see if is used when
  * allocation. if the pair occupied it continue to use next port
  * and trails for thounds of times unitl given up. it causes CPU
@@ -47,9 +54,11 @@
 #include "dpdk.h"
 #include "inet.h"
 #include "netif.h"
+#include "vlan.h"
 #include "route.h"
 #include "route6.h"
 #include "ctrl.h"
+#include "timer.h"
 #include "sa_pool.h"
 #include "linux_ipv6.h"
 #include "parser/parser.h"
@@ -69,6 +78,17 @@
 #define SAPOOL_MIN_HASH_SZ  1
 #define SAPOOL_MAX_HASH_SZ  128
 
+/* IPv6 <saddr, daddr, sport, dport> is the longest RSS input */
+#define SA_RSS_TUPLE_LEN    36
+/* 32 bits of key are needed for each input bit */
+#define SA_RSS_KEY_LEN      (SA_RSS_TUPLE_LEN + 4)
+#define SA_RSS_KEY_BUF_LEN  64
+#define SA_RSS_RETA_MAX     ETH_RSS_RETA_SIZE_512
+
+#define SA_RSS_V4_LPORT_OFF 10
+#define SA_RSS_V6_LPORT_OFF 34
+#define SA_RSS_RETRY_US     100000
+
 enum {
     SA_F_USED               = 0x01,
 };
@@ -102,6 +122,50 @@ struct sa_entry_pool {
     rte_atomic16_t          used_cnt;
     rte_atomic16_t          free_cnt;
     uint32_t                miss_cnt;
+    uint32_t                rss_cursor; /* spread rss candidates */
+};
+
+/*
+ * software RSS state of a port, used by "rss_precalc" mode.
+ *
+ * Toeplitz hash is linear (XOR) over input bits, so it's calculated
+ * byte by byte with lookup tables, and the lport's contribution to
+ * the RETA index can be pre-calculated regardless of <rip, lip, rport>.
+ * lports are grouped by that contribution, then for a given tuple the
+ * candidates of an lcore are the groups XOR-ed to its own RETA indexes.
+ */
+struct sa_rss {
+    uint64_t                rss_hf;
+    uint16_t                reta_size;
+    uint16_t                reta[SA_RSS_RETA_MAX];
+
+    /* tbl[i][v]: hash of byte value v at input offset i */
+    uint32_t                tbl[SA_RSS_TUPLE_LEN][256];
+
+    /* lports grouped by (hash & reta_mask), group v of IPv4 (0) or
+     * IPv6 (1) is lports[af][lport_off[af][v] ... lport_off[af][v+1]) */
+    uint32_t                lport_off[2][SA_RSS_RETA_MAX + 1];
+    uint16_t                lports[2][MAX_PORT];
+
+    /* RETA indexes pointing to rx queues of each lcore */
+    uint16_t                nidx[DPVS_MAX_LCORE];
+    uint16_t                idx[DPVS_MAX_LCORE][SA_RSS_RETA_MAX];
+};
+
+/*
+ * RSS state is rebuilt when the port restarts, as RETA, key or queues
+ * may have changed. workers read bufs[cur] without lock, the other one
+ * is rebuilt and switched to, once all workers have left the old one
+ * since the last switch (see netif_lcores_quiescent). if they haven't,
+ * the rebuild is retried from @timer until they have.
+ */
+struct sa_rss_port {
+    uint8_t                 cur;
+    bool                    pending;    /* rebuild waiting on @timer */
+    struct netif_port       *dev;
+    struct dpvs_timer       timer;
+    uint64_t                loops[DPVS_MAX_LCORE];  /* at last switch */
+    struct sa_rss           bufs[2];
 };
 
 /* no lock needed because inet_ifaddr.sa_pool[]
@@ -121,6 +185,9 @@ struct sa_pool {
 
     /* fdir filter ID */
     uint32_t                filter_id[MAX_FDIR_PROTO];
+
+    /* non-NULL if lport is selected by RSS pre-calculating */
+    const struct sa_rss_port *rss;
 };
 
 struct sa_fdir {
@@ -139,6 +206,287 @@ static uint8_t              sa_nlcore;
 static uint64_t             sa_lcore_mask;
 
 static uint8_t              sa_pool_hash_size   = SAPOOL_DEF_HASH_SZ;
+static bool                 sa_rss_precalc      = false;
+
+/* per-port software RSS state, built on first use */
+static struct sa_rss_port   *sa_rss_ports[NETIF_MAX_PORTS];
+
+static inline const struct sa_rss *sa_rss_cur(const struct sa_rss_port *rp)
+{
+    return &rp->bufs[*(volatile const uint8_t *)&rp->cur];
+}
+
+/* 32 bits of @key starting from bit @bit, MSB first */
+static inline uint32_t sa_rss_key_word(const uint8_t *key, int bit)
+{
+    int byte = bit / 8, shift = bit % 8;
+    uint64_t word;
+
+    word = ((uint64_t)key[byte] << 32) | ((uint64_t)key[byte + 1] << 24)
+         | ((uint64_t)key[byte + 2] << 16) | ((uint64_t)key[byte + 3] << 8)
+         | (uint64_t)key[byte + 4];
+
+    return (uint32_t)(word >> (8 - shift));
+}
+
+static void sa_rss_build_tbl(struct sa_rss *rss, const uint8_t *key)
+{
+    int i, v, b;
+    uint32_t hash;
+
+    for (i = 0; i < SA_RSS_TUPLE_LEN; i++) {
+        for (v = 0; v < 256; v++) {
+            hash = 0;
+            for (b = 0; b < 8; b++) {
+                if (v & (0x80 >> b))
+                    hash ^= sa_rss_key_word(key, i * 8 + b);
+            }
+            rss->tbl[i][v] = hash;
+        }
+    }
+}
+
+static inline uint32_t sa_rss_hash(const struct sa_rss *rss,
+                                   const uint8_t *tuple, int len)
+{
+    uint32_t hash = 0;
+    int i;
+
+    for (i = 0; i < len; i++)
+        hash ^= rss->tbl[i][tuple[i]];
+
+    return hash;
+}
+
+static inline uint32_t sa_rss_lport_hash(const struct sa_rss *rss,
+                                         int off, uint16_t lport)
+{
+    return rss->tbl[off][lport >> 8] ^ rss->tbl[off + 1][lport & 0xff];
+}
+
+static void sa_rss_build_lports(struct sa_rss *rss, int afi, int off)
+{
+    uint32_t mask = rss->reta_size - 1;
+    uint32_t pos[SA_RSS_RETA_MAX + 1];
+    uint32_t port, v;
+
+    for (port = 0; port < MAX_PORT; port++) {
+        v = sa_rss_lport_hash(rss, off, port) & mask;
+        rss->lport_off[afi][v + 1]++;
+    }
+    for (v = 0; v < rss->reta_size; v++)
+        rss->lport_off[afi][v + 1] += rss->lport_off[afi][v];
+
+    memcpy(pos, rss->lport_off[afi], sizeof(pos));
+    for (port = 0; port < MAX_PORT; port++) {
+        v = sa_rss_lport_hash(rss, off, port) & mask;
+        rss->lports[afi][pos[v]++] = port;
+    }
+}
+
+static int sa_rss_fill(struct sa_rss *rss, struct netif_port *dev)
+{
+    struct rte_eth_rss_conf rss_conf;
+    struct rte_eth_rss_reta_entry64 reta_conf[SA_RSS_RETA_MAX / RTE_RETA_GROUP_SIZE];
+    uint8_t key[SA_RSS_KEY_BUF_LEN];
+    lcoreid_t cid;
+    int i;
+
+    if (dev->dev_info.reta_size == 0 ||
+            dev->dev_info.reta_size > SA_RSS_RETA_MAX ||
+            !rte_is_power_of_2(dev->dev_info.reta_size) ||
+            dev->dev_info.hash_key_size < SA_RSS_KEY_LEN ||
+            dev->dev_info.hash_key_size > SA_RSS_KEY_BUF_LEN) {
+        RTE_LOG(WARNING, SAPOOL, "%s: %s RETA size %u or key size %u not "
+                "supported\n", __func__, dev->name, dev->dev_info.reta_size,
+                dev->dev_info.hash_key_size);
+        return EDPVS_NOTSUPP;
+    }
+
+    memset(&rss_conf, 0, sizeof(rss_conf));
+    rss_conf.rss_key = key;
+    rss_conf.rss_key_len = dev->dev_info.hash_key_size;
+    if (rte_eth_dev_rss_hash_conf_get(dev->id, &rss_conf) != 0) {
+        RTE_LOG(WARNING, SAPOOL, "%s: fail to get RSS key of %s\n",
+                __func__, dev->name);
+        return EDPVS_DPDKAPIFAIL;
+    }
+
+    memset(reta_conf, 0, sizeof(reta_conf));
+    for (i = 0; i < dev->dev_info.reta_size / RTE_RETA_GROUP_SIZE; i++)
+        reta_conf[i].mask = ~0ULL;
+    if (rte_eth_dev_rss_reta_query(dev->id, reta_conf,
+                                   dev->dev_info.reta_size) != 0) {
+        RTE_LOG(WARNING, SAPOOL, "%s: fail to query RETA of %s\n",
+                __func__, dev->name);
+        return EDPVS_DPDKAPIFAIL;
+    }
+
+    memset(rss, 0, sizeof(*rss));
+    rss->rss_hf = rss_conf.rss_hf;
+    rss->reta_size = dev->dev_info.reta_size;
+    for (i = 0; i < rss->reta_size; i++) {
+        rss->reta[i] = reta_conf[i / RTE_RETA_GROUP_SIZE].
+                       reta[i % RTE_RETA_GROUP_SIZE];
+
+        if (netif_get_queue_lcore(dev, rss->reta[i], &cid) != EDPVS_OK ||
+                cid >= DPVS_MAX_LCORE || !(sa_lcore_mask & (1L << cid))) {
+            RTE_LOG(WARNING, SAPOOL, "%s: %s RETA[%d] queue %u is not processed"
+                    " by any worker\n", __func__, dev->name, i, rss->reta[i]);
+            continue;
+        }
+        rss->idx[cid][rss->nidx[cid]++] = i;
+    }
+
+    sa_rss_build_tbl(rss, key);
+    sa_rss_build_lports(rss, 0, SA_RSS_V4_LPORT_OFF);
+    sa_rss_build_lports(rss, 1, SA_RSS_V6_LPORT_OFF);
+
+    return EDPVS_OK;
+}
+
+static struct sa_rss_port *sa_rss_create(struct netif_port *dev)
+{
+    struct sa_rss_port *rp;
+
+    rp = rte_zmalloc_socket(NULL, sizeof(*rp), RTE_CACHE_LINE_SIZE,
+                            dev->socket);
+    if (!rp)
+        return NULL;
+
+    if (sa_rss_fill(&rp->bufs[0], dev) != EDPVS_OK) {
+        rte_free(rp);
+        return NULL;
+    }
+    rp->dev = dev;
+
+    RTE_LOG(INFO, SAPOOL, "%s: RSS pre-calculating enabled for %s "
+            "(RETA size %u, rss_hf 0x%"PRIx64")\n", __func__, dev->name,
+            rp->bufs[0].reta_size, rp->bufs[0].rss_hf);
+
+    return rp;
+}
+
+/*
+ * get software RSS state of @dev, NULL if rss_precalc is off or
+ * the device RSS cannot be calculated, fdir is used then.
+ */
+static const struct sa_rss_port *sa_rss_get(int af, struct netif_port *dev)
+{
+    const struct sa_rss *rss;
+    uint64_t need_hf;
+
+    if (!sa_rss_precalc || !dev)
+        return NULL;
+
+    if (dev->type == PORT_TYPE_VLAN)
+        dev = ((struct vlan_dev_priv *)netif_priv(dev))->real_dev;
+
+    if ((dev->type != PORT_TYPE_GENERAL && dev->type != PORT_TYPE_BOND_MASTER)
+            || dev->id >= NETIF_MAX_PORTS || dev->nrxq <= 1)
+        return NULL;
+
+    if (!sa_rss_ports[dev->id])
+        sa_rss_ports[dev->id] = sa_rss_create(dev);
+
+    if (!sa_rss_ports[dev->id])
+        return NULL;
+    rss = sa_rss_cur(sa_rss_ports[dev->id]);
+
+    /* both TCP and UDP back traffic must be hashed with L4 ports */
+    if (af == AF_INET)
+        need_hf = ETH_RSS_NONFRAG_IPV4_TCP | ETH_RSS_NONFRAG_IPV4_UDP;
+    else
+        need_hf = ETH_RSS_NONFRAG_IPV6_TCP | ETH_RSS_NONFRAG_IPV6_UDP;
+
+    if ((rss->rss_hf & need_hf) != need_hf) {
+        RTE_LOG(WARNING, SAPOOL, "%s: %s rss_hf 0x%"PRIx64" not hash TCP/UDP "
+                "ports, fall back to fdir\n", __func__, dev->name, rss->rss_hf);
+        return NULL;
+    }
+
+    return sa_rss_ports[dev->id];
+}
+
+static int __sa_pool_rss_update(struct sa_rss_port *rp)
+{
+    struct netif_port *dev = rp->dev;
+    uint8_t next;
+    int err;
+
+    if (!netif_lcores_quiescent(rp->loops))
+        return EDPVS_BUSY;
+
+    next = !rp->cur;
+    err = sa_rss_fill(&rp->bufs[next], dev);
+    if (err != EDPVS_OK) {
+        /* pools own lports of all lcores, they can't turn to fdir */
+        RTE_LOG(ERR, SAPOOL, "%s: fail to rebuild RSS state of %s, lports "
+                "may not come back to their lcores\n", __func__, dev->name);
+        return err;
+    }
+
+    rte_smp_wmb();
+    rp->cur = next;
+
+    netif_lcore_loops_save(rp->loops);
+
+    RTE_LOG(INFO, SAPOOL, "%s: RSS state of %s rebuilt (RETA size %u, "
+            "rss_hf 0x%"PRIx64")\n", __func__, dev->name,
+            rp->bufs[next].reta_size, rp->bufs[next].rss_hf);
+    return EDPVS_OK;
+}
+
+static int sa_rss_retry(void *arg)
+{
+    struct sa_rss_port *rp = arg;
+
+    if (__sa_pool_rss_update(rp) == EDPVS_BUSY) {
+        dpvs_timer_reset_nolock(&rp->timer, true);
+        return DTIMER_OK;
+    }
+
+    rp->pending = false;
+    return DTIMER_STOP;
+}
+
+/*
+ * rebuild software RSS state of @dev after it's (re)started, pools
+ * already using it follow the new RETA, key and queues at once.
+ * if workers may still be on the spare state, the rebuild is deferred
+ * and EDPVS_INPROGRESS is returned.
+ */
+int sa_pool_rss_update(struct netif_port *dev)
+{
+    struct timeval timeout = { 0, SA_RSS_RETRY_US };
+    struct sa_rss_port *rp;
+    int err;
+
+    if (!dev || dev->id >= NETIF_MAX_PORTS || !sa_rss_ports[dev->id])
+        return EDPVS_OK; /* built on first use */
+    rp = sa_rss_ports[dev->id];
+
+    /* the retry reads the device state then, which is the latest */
+    if (rp->pending)
+        return EDPVS_INPROGRESS;
+
+    err = __sa_pool_rss_update(rp);
+    if (err != EDPVS_BUSY)
+        return err;
+
+    RTE_LOG(INFO, SAPOOL, "%s: RSS state of %s is in use, retry later\n",
+            __func__, dev->name);
+
+    err = dpvs_timer_sched(&rp->timer, &timeout, sa_rss_retry, rp, true);
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, SAPOOL, "%s: fail to defer RSS rebuild of %s: %s\n",
+                __func__, dev->name, dpvs_strerror(err));
+        return err;
+    }
+
+    rp->pending = true;
+    return EDPVS_INPROGRESS;
+}
 
 static int __add_del_filter(int af, struct netif_port *dev, lcoreid_t cid,
                             const union inet_addr *dip, __be16 dport,
@@ -245,14 +593,14 @@ static inline int sa_del_filter(int af, struct netif_port *dev, lcoreid_t cid,
 }
 
 static int sa_pool_alloc_hash(struct sa_pool *ap, uint8_t hash_sz,
-                               const struct sa_fdir *fdir)
+                               const struct sa_fdir *fdir, int socket)
 {
     int hash;
     struct sa_entry_pool *pool;
     uint32_t port; /* should be u32 or 65535==0 */
 
-    ap->pool_hash = rte_malloc(NULL, sizeof(struct sa_entry_pool) * hash_sz,
-                               RTE_CACHE_LINE_SIZE);
+    ap->pool_hash = rte_malloc_socket(NULL, sizeof(struct sa_entry_pool) * hash_sz,
+                                      RTE_CACHE_LINE_SIZE, socket);
     if (!ap->pool_hash)
         return EDPVS_NOMEM;
 
@@ -270,7 +618,8 @@ static int sa_pool_alloc_hash(struct sa_pool *ap, uint8_t hash_sz,
         for (port = ap->low; port <= ap->high; port++) {
             struct sa_entry *sa;
 
-            if (fdir->mask &&
+            /* all lcores share the whole port range with rss_precalc */
+            if (!ap->rss && fdir->mask &&
                 ((uint16_t)port & fdir->mask) != ntohs(fdir->port_base))
                 continue;
 
@@ -295,6 +644,7 @@ static int sa_pool_free_hash(struct sa_pool *ap)
 int sa_pool_create(struct inet_ifaddr *ifa, uint16_t low, uint16_t high)
 {
     struct sa_pool *ap;
+    const struct sa_rss_port *rss;
     int err;
     lcoreid_t cid;
 
@@ -306,6 +656,8 @@ int sa_pool_create(struct inet_ifaddr *ifa, uint16_t low, uint16_t high)
         return EDPVS_INVAL;
     }
 
+    rss = sa_rss_get(ifa->af, ifa->idev->dev);
+
     for (cid = 0; cid < RTE_MAX_LCORE; cid++) {
         uint32_t filtids[MAX_FDIR_PROTO];
         struct sa_fdir *fdir = &sa_fdirs[cid];
@@ -315,7 +667,9 @@ int sa_pool_create(struct inet_ifaddr *ifa, uint16_t low, uint16_t high)
             continue;
         assert(rte_lcore_is_enabled(cid) && cid != rte_get_master_lcore());
 
-        ap = rte_zmalloc(NULL, sizeof(struct sa_pool), 0);
+        /* per-lcore pool lives on the lcore's NUMA socket */
+        ap = rte_zmalloc_socket(NULL, sizeof(struct sa_pool), 0,
+                                rte_lcore_to_socket_id(cid));
         if (!ap) {
             err = EDPVS_NOMEM;
             goto errout;
@@ -324,14 +678,21 @@ int sa_pool_create(struct inet_ifaddr *ifa, uint16_t low, uint16_t high)
         ap->ifa = ifa;
         ap->low = low;
         ap->high = high;
+        ap->rss = rss;
         rte_atomic32_set(&ap->refcnt, 0);
 
-        err = sa_pool_alloc_hash(ap, sa_pool_hash_size, fdir);
+        err = sa_pool_alloc_hash(ap, sa_pool_hash_size, fdir,
+                                 rte_lcore_to_socket_id(cid));
         if (err != EDPVS_OK) {
             rte_free(ap);
             goto errout;
         }
 
+        if (ap->rss) {
+            ifa->sa_pools[cid] = ap;
+            continue;
+        }
+
         /* if add filter failed, waste some soft-id is acceptable. */
         filtids[0] = fdir->soft_id++;
         filtids[1] = fdir->soft_id++;
@@ -382,8 +743,9 @@ int sa_pool_destroy(struct inet_ifaddr *ifa)
             return EDPVS_BUSY;
         }
 
-        sa_del_filter(ifa->af, ifa->idev->dev, cid, &ifa->addr,
-                      fdir->port_base, ap->filter_id);
+        if (!ap->rss)
+            sa_del_filter(ifa->af, ifa->idev->dev, cid, &ifa->addr,
+                          fdir->port_base, ap->filter_id);
         sa_pool_free_hash(ap);
         rte_free(ap);
         ifa->sa_pools[cid] = NULL;
@@ -427,11 +789,69 @@ sa_pool_hash(const struct sa_pool *ap, const struct sockaddr_storage *ss)
     }
 }
 
-static inline int sa_pool_fetch(struct sa_entry_pool *pool,
+/*
+ * find a free entry whose lport makes the back traffic from @daddr
+ * (<rip, rport>) hashed to one of current lcore's rx queues.
+ */
+static struct sa_entry *sa_rss_fetch(const struct sa_pool *ap,
+                                     struct sa_entry_pool *pool,
+                                     const struct sockaddr_storage *daddr)
+{
+    const struct sa_rss *rss = sa_rss_cur(ap->rss);
+    lcoreid_t cid = rte_lcore_id();
+    uint8_t tuple[SA_RSS_TUPLE_LEN];
+    uint32_t hash, v, off, cnt, i, j;
+    uint16_t port;
+    struct sa_entry *ent;
+    int afi;
+
+    if (daddr->ss_family == AF_INET) {
+        const struct sockaddr_in *sin = (const struct sockaddr_in *)daddr;
+
+        memcpy(&tuple[0], &sin->sin_addr, 4);
+        memcpy(&tuple[4], &ap->ifa->addr.in, 4);
+        memcpy(&tuple[8], &sin->sin_port, 2);
+        hash = sa_rss_hash(rss, tuple, SA_RSS_V4_LPORT_OFF);
+        afi = 0;
+    } else {
+        const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)daddr;
+
+        memcpy(&tuple[0], &sin6->sin6_addr, 16);
+        memcpy(&tuple[16], &ap->ifa->addr.in6, 16);
+        memcpy(&tuple[32], &sin6->sin6_port, 2);
+        hash = sa_rss_hash(rss, tuple, SA_RSS_V6_LPORT_OFF);
+        afi = 1;
+    }
+
+    for (i = 0; i < rss->nidx[cid]; i++) {
+        v = (hash ^ rss->idx[cid][(i + pool->rss_cursor) % rss->nidx[cid]])
+            & (rss->reta_size - 1);
+        off = rss->lport_off[afi][v];
+        cnt = rss->lport_off[afi][v + 1] - off;
+
+        for (j = 0; j < cnt; j++) {
+            port = rss->lports[afi][off + (j + pool->rss_cursor) % cnt];
+            if (port < ap->low || port > ap->high)
+                continue;
+
+            ent = &pool->sa_entries[port];
+            if (!(ent->flags & SA_F_USED)) {
+                pool->rss_cursor++;
+                return ent;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static inline int sa_pool_fetch(const struct sa_pool *ap,
+                                const struct sockaddr_storage *daddr,
                                 struct sockaddr_storage *ss)
 {
-    assert(pool && ss);
+    assert(ap && ss);
 
+    struct sa_entry_pool *pool;
     struct sa_entry *ent;
     struct sockaddr_in *sin = (struct sockaddr_in *)ss;
     struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ss;
@@ -439,7 +859,16 @@ static inline int sa_pool_fetch(struct sa_entry_pool *pool,
     char addr[64];
 #endif
 
-    ent = list_first_entry_or_null(&pool->free_enties, struct sa_entry, list);
+    pool = sa_pool_hash(ap, daddr);
+    if (unlikely(!pool))
+        return EDPVS_NOTSUPP;
+
+    /* without dest, RSS of back traffic is unknown, take any one */
+    if (ap->rss && daddr)
+        ent = sa_rss_fetch(ap, pool, daddr);
+    else
+        ent = list_first_entry_or_null(&pool->free_enties,
+                                       struct sa_entry, list);
     if (!ent) {
 #ifdef CONFIG_DPVS_SAPOOL_DEBUG
         RTE_LOG(DEBUG, SAPOOL, "%s: no entry (used/free %d/%d)\n", __func__,
@@ -502,7 +931,7 @@ static inline int sa_pool_release(struct sa_entry_pool *pool,
      * matchs @sin. */
     ent = &pool->sa_entries[port];
     if (!(ent->flags & SA_F_USED)) {
-        RTE_LOG(WARNING, SAPOOL, "%s: port %d not in use !\n", __func__, port);
+        RTE_BLOG(WARNING, SAPOOL, "%s: port %d not in use !\n", __func__, port);
         return EDPVS_INVAL;
     }
 
@@ -527,6 +956,44 @@ static inline int sa_pool_release(struct sa_entry_pool *pool,
     return EDPVS_OK;
 }
 
+/* take the given entry, it must belong to this lcore and be free */
+static inline int sa_pool_reserve(const struct sa_pool *ap,
+                                  struct sa_entry_pool *pool,
+                                  const struct sockaddr_storage *ss)
+{
+    const struct sa_fdir *fdir = &sa_fdirs[rte_lcore_id()];
+    const struct sockaddr_in *sin = (const struct sockaddr_in *)ss;
+    const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)ss;
+    struct sa_entry *ent;
+    uint16_t port;
+
+    assert(ap && pool && ss);
+
+    if (ss->ss_family == AF_INET)
+        port = ntohs(sin->sin_port);
+    else if (ss->ss_family == AF_INET6)
+        port = ntohs(sin6->sin6_port);
+    else
+        return EDPVS_NOTSUPP;
+
+    if (port < ap->low || port > ap->high)
+        return EDPVS_INVAL;
+    /* entries of other lcores are not initialized */
+    if (!ap->rss && fdir->mask && (port & fdir->mask) != ntohs(fdir->port_base))
+        return EDPVS_NOTEXIST;
+
+    ent = &pool->sa_entries[port];
+    if (ent->flags & SA_F_USED)
+        return EDPVS_EXIST;
+
+    ent->flags |= SA_F_USED;
+    list_move_tail(&ent->list, &pool->used_enties);
+    rte_atomic16_inc(&pool->used_cnt);
+    rte_atomic16_dec(&pool->free_cnt);
+
+    return EDPVS_OK;
+}
+
 /*
  * fetch unused <saddr, sport> pair by given hint.
  * given @ap equivalent to @dev+@saddr, and dport is useless.
@@ -574,13 +1041,13 @@ static int sa4_fetch(struct netif_port *dev,
             return EDPVS_NOTEXIST;
 
         if (!ifa->this_sa_pool) {
-            RTE_LOG(WARNING, SAPOOL, "%s: fetch addr on IP without pool.", __func__);
+            RTE_BLOG(WARNING, SAPOOL, "%s: fetch addr on IP without pool.", __func__);
             inet_addr_ifa_put(ifa);
             return EDPVS_INVAL;
         }
 
-        err = sa_pool_fetch(sa_pool_hash(ifa->this_sa_pool,
-                            (struct sockaddr_storage *)daddr),
+        err = sa_pool_fetch(ifa->this_sa_pool,
+                            (const struct sockaddr_storage *)daddr,
                             (struct sockaddr_storage *)saddr);
         if (err == EDPVS_OK)
             rte_atomic32_inc(&ifa->this_sa_pool->refcnt);
@@ -610,15 +1077,15 @@ static int sa4_fetch(struct netif_port *dev,
     route4_put(rt);
 
     if (!ifa->this_sa_pool) {
-        RTE_LOG(WARNING, SAPOOL, "%s: fetch addr on IP without pool.",
+        RTE_BLOG(WARNING, SAPOOL, "%s: fetch addr on IP without pool.",
                 __func__);
         inet_addr_ifa_put(ifa);
         return EDPVS_INVAL;
     }
 
     /* do fetch socket address */
-    err = sa_pool_fetch(sa_pool_hash(ifa->this_sa_pool,
-                        (struct sockaddr_storage *)daddr),
+    err = sa_pool_fetch(ifa->this_sa_pool,
+                        (const struct sockaddr_storage *)daddr,
                         (struct sockaddr_storage *)saddr);
     if (err == EDPVS_OK)
         rte_atomic32_inc(&ifa->this_sa_pool->refcnt);
@@ -648,13 +1115,13 @@ static int sa6_fetch(struct netif_port *dev,
             return EDPVS_NOTEXIST;
 
         if (!ifa->this_sa_pool) {
-            RTE_LOG(WARNING, SAPOOL, "%s: fetch addr on IP without pool.", __func__);
+            RTE_BLOG(WARNING, SAPOOL, "%s: fetch addr on IP without pool.", __func__);
             inet_addr_ifa_put(ifa);
             return EDPVS_INVAL;
         }
 
-        err = sa_pool_fetch(sa_pool_hash(ifa->this_sa_pool,
-                            (struct sockaddr_storage *)daddr),
+        err = sa_pool_fetch(ifa->this_sa_pool,
+                            (const struct sockaddr_storage *)daddr,
                             (struct sockaddr_storage *)saddr);
         if (err == EDPVS_OK)
             rte_atomic32_inc(&ifa->this_sa_pool->refcnt);
@@ -689,15 +1156,15 @@ static int sa6_fetch(struct netif_port *dev,
     route6_put(rt6);
 
     if (!ifa->this_sa_pool) {
-        RTE_LOG(WARNING, SAPOOL, "%s: fetch addr on IP without pool.",
+        RTE_BLOG(WARNING, SAPOOL, "%s: fetch addr on IP without pool.",
                 __func__);
         inet_addr_ifa_put(ifa);
         return EDPVS_INVAL;
     }
 
     /* do fetch socket address */
-    err = sa_pool_fetch(sa_pool_hash(ifa->this_sa_pool,
-                        (struct sockaddr_storage *)daddr),
+    err = sa_pool_fetch(ifa->this_sa_pool,
+                        (const struct sockaddr_storage *)daddr,
                         (struct sockaddr_storage *)saddr);
     if (err == EDPVS_OK)
         rte_atomic32_inc(&ifa->this_sa_pool->refcnt);
@@ -754,7 +1221,7 @@ int sa_release(const struct netif_port *dev,
         return EDPVS_NOTEXIST;
 
     if (!ifa->this_sa_pool) {
-        RTE_LOG(WARNING, SAPOOL, "%s: release addr on IP without pool.",
+        RTE_BLOG(WARNING, SAPOOL, "%s: release addr on IP without pool.",
                 __func__);
         inet_addr_ifa_put(ifa);
         return EDPVS_INVAL;
@@ -767,6 +1234,48 @@ int sa_release(const struct netif_port *dev,
     return err;
 }
 
+/* call me with `saddr` must not NULL */
+int sa_reserve(const struct netif_port *dev,
+               const struct sockaddr_storage *daddr,
+               const struct sockaddr_storage *saddr)
+{
+    struct inet_ifaddr *ifa;
+    int err;
+
+    if (!saddr)
+        return EDPVS_INVAL;
+
+    if (daddr && saddr->ss_family != daddr->ss_family)
+        return EDPVS_INVAL;
+
+    if (AF_INET == saddr->ss_family) {
+        const struct sockaddr_in *saddr4 = (const struct sockaddr_in *)saddr;
+        ifa = inet_addr_ifa_get(AF_INET, dev,
+                (union inet_addr*)&saddr4->sin_addr);
+    } else if (AF_INET6 == saddr->ss_family) {
+        const struct sockaddr_in6 *saddr6 = (const struct sockaddr_in6 *)saddr;
+        ifa = inet_addr_ifa_get(AF_INET6, dev,
+                (union inet_addr*)&saddr6->sin6_addr);
+    } else {
+        return EDPVS_NOTSUPP;
+    }
+
+    if (!ifa)
+        return EDPVS_NOTEXIST;
+
+    if (!ifa->this_sa_pool) {
+        inet_addr_ifa_put(ifa);
+        return EDPVS_NOTEXIST;
+    }
+
+    err = sa_pool_reserve(ifa->this_sa_pool,
+                          sa_pool_hash(ifa->this_sa_pool, daddr), saddr);
+    if (err == EDPVS_OK)
+        rte_atomic32_inc(&ifa->this_sa_pool->refcnt);
+    inet_addr_ifa_put(ifa);
+    return err;
+}
+
 int sa_pool_stats(const struct inet_ifaddr *ifa, struct sa_pool_stats *stats)
 {
     struct dpvs_msg *req, *reply;
@@ -885,9 +1394,19 @@ int sa_pool_init(void)
 int sa_pool_term(void)
 {
     int err;
+    portid_t pid;
 
     err = msg_type_mc_unregister(&sa_stats_msg);
 
+    for (pid = 0; pid < NETIF_MAX_PORTS; pid++) {
+        if (sa_rss_ports[pid]) {
+            if (sa_rss_ports[pid]->pending)
+                dpvs_timer_cancel(&sa_rss_ports[pid]->timer, true);
+            rte_free(sa_rss_ports[pid]);
+            sa_rss_ports[pid] = NULL;
+        }
+    }
+
     return err;
 }
 
@@ -912,8 +1431,29 @@ static void sa_pool_hash_size_conf(vector_t tokens)
     FREE_PTR(str);
 }
 
+static void sa_pool_rss_precalc_conf(vector_t tokens)
+{
+    char *str = set_value(tokens);
+
+    if (!str)
+        return;
+
+    if (strcasecmp(str, "on") == 0)
+        sa_rss_precalc = true;
+    else if (strcasecmp(str, "off") == 0)
+        sa_rss_precalc = false;
+    else
+        RTE_LOG(WARNING, SAPOOL, "invalid sa_pool:rss_precalc %s\n", str);
+
+    RTE_LOG(INFO, SAPOOL, "sa_pool:rss_precalc = %s\n",
+            sa_rss_precalc ? "on" : "off");
+
+    FREE_PTR(str);
+}
+
 void install_sa_pool_keywords(void)
 {
     install_keyword_root("sa_pool", NULL);
     install_keyword("pool_hash_size", sa_pool_hash_size_conf, KW_TYPE_INIT);
+    install_keyword("rss_precalc", sa_pool_rss_precalc_conf, KW_TYPE_INIT);
 }
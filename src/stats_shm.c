@@ -0,0 +1,474 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "common.h"
+#include "netif.h"
+#include "timer.h"
+#include "parser/parser.h"
+#include "ipvs/conn.h"
+#include "ipvs/dest.h"
+#include "ipvs/stats.h"
+#include "stats_shm.h"
+
+#define STATS_SHM_NAME_LEN          64
+#define STATS_SHM_MAX_PORTS         64
+#define STATS_SHM_MAX_DESTS_DEF     4096
+#define STATS_SHM_MAX_DESTS_MAX     (1 << 20)
+#define STATS_SHM_LCORE_LOOPS       1024    /* lcore slots refresh */
+#define STATS_SHM_INTERVAL          1       /* port/dest slots refresh, sec */
+
+/* config file */
+static bool stats_shm_enable = false;
+static char stats_shm_name[STATS_SHM_NAME_LEN] = DPVS_SHM_NAME_DEF;
+static uint32_t stats_shm_max_dests = STATS_SHM_MAX_DESTS_DEF;
+
+static struct dpvs_shm_hdr *stats_shm = NULL;
+
+/* dest slots, owned by master */
+static struct dp_vs_dest **stats_shm_dests;
+static uint32_t *stats_shm_free;
+static uint32_t stats_shm_nfree;
+
+static struct dpvs_timer stats_shm_timer;
+static struct netif_lcore_loop_job stats_shm_job;
+
+int dpvs_stats_shm_dest_attach(struct dp_vs_dest *dest)
+{
+    struct dpvs_shm_dest *sd;
+    struct dpvs_shm_stats *stats;
+    uint32_t idx;
+
+    if (!stats_shm || !stats_shm_nfree)
+        return EDPVS_NOROOM;
+
+    idx = stats_shm_free[--stats_shm_nfree];
+    sd = dpvs_shm_dest(stats_shm, idx);
+
+    /* page faults taken here rather than on the data path */
+    stats = dpvs_shm_dest_stats(stats_shm, idx);
+    memset(stats, 0, sizeof(*stats) * stats_shm->max_lcores);
+
+    dpvs_shm_write_begin(&sd->seq);
+    sd->gen++;
+    sd->af = dest->af;
+    sd->proto = dest->proto;
+    sd->vport = dest->vport;
+    sd->fwmark = dest->vfwmark;
+    sd->port = dest->port;
+    sd->weight = rte_atomic16_read(&dest->weight);
+    memset(sd->vaddr, 0, sizeof(sd->vaddr));
+    memset(sd->addr, 0, sizeof(sd->addr));
+    if (dest->af == AF_INET6) {
+        memcpy(sd->vaddr, &dest->vaddr.in6, sizeof(struct in6_addr));
+        memcpy(sd->addr, &dest->addr.in6, sizeof(struct in6_addr));
+    } else {
+        memcpy(sd->vaddr, &dest->vaddr.in, sizeof(struct in_addr));
+        memcpy(sd->addr, &dest->addr.in, sizeof(struct in_addr));
+    }
+    sd->actconns = 0;
+    sd->inactconns = 0;
+    sd->persistconns = 0;
+    sd->active = 1;
+    dpvs_shm_write_end(&sd->seq);
+
+    stats_shm_dests[idx] = dest;
+    dest->stats_shm = sd;
+    dest->stats = (struct dp_vs_stats *)stats;
+
+    return EDPVS_OK;
+}
+
+void dpvs_stats_shm_dest_detach(struct dp_vs_dest *dest)
+{
+    struct dpvs_shm_dest *sd = dest->stats_shm;
+    uint32_t idx;
+
+    if (!sd)
+        return;
+
+    idx = sd - dpvs_shm_dest(stats_shm, 0);
+    assert(idx < stats_shm->max_dests && stats_shm_dests[idx] == dest);
+
+    dpvs_shm_write_begin(&sd->seq);
+    sd->active = 0;
+    dpvs_shm_write_end(&sd->seq);
+
+    stats_shm_dests[idx] = NULL;
+    stats_shm_free[stats_shm_nfree++] = idx;
+    dest->stats_shm = NULL;
+    dest->stats = NULL;
+}
+
+/* lcore job, each lcore publishes its own slot */
+static void stats_shm_lcore_publish(void *arg)
+{
+    lcoreid_t cid = rte_lcore_id();
+    struct netif_lcore_stats nstats;
+    struct dp_vs_stats vstats;
+    struct dpvs_shm_lcore *sl;
+
+    netif_copy_lcore_stats(&nstats);
+    dp_vs_stats_lcore_get(&vstats);
+
+    sl = dpvs_shm_lcore(stats_shm, cid);
+
+    dpvs_shm_write_begin(&sl->seq);
+    sl->active      = 1;
+    sl->update_tsc  = rte_rdtsc();
+    sl->loops       = nstats.lcore_loop;
+    sl->ipackets    = nstats.ipackets;
+    sl->ibytes      = nstats.ibytes;
+    sl->opackets    = nstats.opackets;
+    sl->obytes      = nstats.obytes;
+    sl->dropped     = nstats.dropped;
+    sl->txdrop      = nstats.txdrop;
+    sl->busy_cycles = nstats.busy_cycles;
+    sl->conns       = vstats.conns;
+    sl->inpkts      = vstats.inpkts;
+    sl->inbytes     = vstats.inbytes;
+    sl->outpkts     = vstats.outpkts;
+    sl->outbytes    = vstats.outbytes;
+    sl->conn_count  = dp_vs_conn_count_get();
+    dpvs_shm_write_end(&sl->seq);
+}
+
+static void stats_shm_ports_publish(void)
+{
+    struct dpvs_shm_port *sp;
+    struct netif_port *dev;
+    struct rte_eth_stats stats;
+    uint32_t idx = 0;
+    portid_t pid;
+
+    for (pid = 0; pid < NETIF_MAX_PORTS && idx < stats_shm->max_ports; pid++) {
+        dev = netif_port_get(pid);
+        if (!dev || netif_get_stats(dev, &stats) != EDPVS_OK)
+            continue;
+
+        sp = dpvs_shm_port(stats_shm, idx++);
+
+        dpvs_shm_write_begin(&sp->seq);
+        sp->active      = 1;
+        sp->port_id     = pid;
+        snprintf(sp->name, sizeof(sp->name), "%s", dev->name);
+        sp->ipackets    = stats.ipackets;
+        sp->opackets    = stats.opackets;
+        sp->ibytes      = stats.ibytes;
+        sp->obytes      = stats.obytes;
+        sp->imissed     = stats.imissed;
+        sp->ierrors     = stats.ierrors;
+        sp->oerrors     = stats.oerrors;
+        sp->rx_nombuf   = stats.rx_nombuf;
+        dpvs_shm_write_end(&sp->seq);
+    }
+
+    /* ports gone */
+    for (; idx < stats_shm->max_ports; idx++) {
+        sp = dpvs_shm_port(stats_shm, idx);
+        if (!sp->active)
+            break;
+
+        dpvs_shm_write_begin(&sp->seq);
+        sp->active = 0;
+        dpvs_shm_write_end(&sp->seq);
+    }
+}
+
+static void stats_shm_dests_publish(void)
+{
+    struct dpvs_shm_dest *sd;
+    struct dp_vs_dest *dest;
+    uint32_t idx;
+
+    for (idx = 0; idx < stats_shm->max_dests; idx++) {
+        dest = stats_shm_dests[idx];
+        if (!dest)
+            continue;
+
+        sd = dpvs_shm_dest(stats_shm, idx);
+
+        /* the aggr timer only sums up dests with conn thresholds */
+        dp_vs_dest_conns_aggregate(dest);
+
+        dpvs_shm_write_begin(&sd->seq);
+        sd->weight = rte_atomic16_read(&dest->weight);
+        sd->actconns = dest->actconns;
+        sd->inactconns = dest->inactconns;
+        sd->persistconns = dest->persistconns;
+        dpvs_shm_write_end(&sd->seq);
+    }
+}
+
+static int stats_shm_publish(void *arg)
+{
+    stats_shm_ports_publish();
+    stats_shm_dests_publish();
+
+    return DTIMER_OK;
+}
+
+static size_t stats_shm_layout(struct dpvs_shm_hdr *hdr)
+{
+    size_t off = RTE_ALIGN_CEIL(sizeof(*hdr), DPVS_SHM_ALIGN);
+
+    hdr->lcore_size = sizeof(struct dpvs_shm_lcore);
+    hdr->port_size  = sizeof(struct dpvs_shm_port);
+    hdr->dest_size  = sizeof(struct dpvs_shm_dest);
+    hdr->stats_size = sizeof(struct dpvs_shm_stats);
+
+    hdr->max_lcores = DPVS_MAX_LCORE;
+    hdr->max_ports  = STATS_SHM_MAX_PORTS;
+    hdr->max_dests  = stats_shm_max_dests;
+
+    hdr->lcore_off = off;
+    off += (size_t)hdr->lcore_size * hdr->max_lcores;
+    hdr->port_off = off;
+    off += (size_t)hdr->port_size * hdr->max_ports;
+    hdr->dest_off = off;
+    off += (size_t)hdr->dest_size * hdr->max_dests;
+    off = RTE_ALIGN_CEIL(off, getpagesize());
+    hdr->dest_stats_off = off;
+    off += (size_t)hdr->stats_size * hdr->max_lcores * hdr->max_dests;
+
+    return RTE_ALIGN_CEIL(off, getpagesize());
+}
+
+static int stats_shm_create(void)
+{
+    struct dpvs_shm_hdr hdr;
+    void *addr;
+    size_t size;
+    int fd;
+
+    memset(&hdr, 0, sizeof(hdr));
+    size = stats_shm_layout(&hdr);
+
+    fd = shm_open(stats_shm_name, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    if (fd < 0) {
+        RTE_LOG(ERR, STATSHM, "%s: shm_open %s: %s\n",
+                __func__, stats_shm_name, strerror(errno));
+        return EDPVS_SYSCALL;
+    }
+
+    if (ftruncate(fd, size) < 0) {
+        RTE_LOG(ERR, STATSHM, "%s: ftruncate %s: %s\n",
+                __func__, stats_shm_name, strerror(errno));
+        close(fd);
+        shm_unlink(stats_shm_name);
+        return EDPVS_SYSCALL;
+    }
+
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        RTE_LOG(ERR, STATSHM, "%s: mmap %s: %s\n",
+                __func__, stats_shm_name, strerror(errno));
+        shm_unlink(stats_shm_name);
+        return EDPVS_SYSCALL;
+    }
+
+    hdr.magic = DPVS_SHM_MAGIC;
+    hdr.version = DPVS_SHM_VERSION;
+    hdr.pid = getpid();
+    hdr.size = size;
+    hdr.start_time = time(NULL);
+    hdr.tsc_hz = rte_get_tsc_hz();
+
+    /* the segment is zero filled, so all slots are inactive */
+    stats_shm = addr;
+    memcpy(stats_shm, &hdr, sizeof(hdr));
+    rte_smp_wmb();
+    stats_shm->ready = 1;
+
+    RTE_LOG(INFO, STATSHM, "stats exported to %s, %lu bytes, %u dests\n",
+            stats_shm_name, size, hdr.max_dests);
+    return EDPVS_OK;
+}
+
+int dpvs_stats_shm_init(void)
+{
+    struct timeval tv = {
+        .tv_sec = STATS_SHM_INTERVAL,
+    };
+    uint32_t i;
+    int err;
+
+    /* dest->stats is indexed as struct dp_vs_stats */
+    RTE_BUILD_BUG_ON(sizeof(struct dpvs_shm_stats) !=
+                     sizeof(struct dp_vs_stats));
+
+    if (!stats_shm_enable)
+        return EDPVS_OK;
+
+    stats_shm_dests = rte_zmalloc("stats_shm_dests",
+            sizeof(*stats_shm_dests) * stats_shm_max_dests, 0);
+    stats_shm_free = rte_malloc("stats_shm_free",
+            sizeof(*stats_shm_free) * stats_shm_max_dests, 0);
+    if (!stats_shm_dests || !stats_shm_free) {
+        err = EDPVS_NOMEM;
+        goto errout;
+    }
+
+    /* lowest slots first */
+    for (i = 0; i < stats_shm_max_dests; i++)
+        stats_shm_free[i] = stats_shm_max_dests - 1 - i;
+    stats_shm_nfree = stats_shm_max_dests;
+
+    err = stats_shm_create();
+    if (err != EDPVS_OK)
+        goto errout;
+
+    snprintf(stats_shm_job.name, sizeof(stats_shm_job.name) - 1, "%s",
+             "stats_shm");
+    stats_shm_job.func = stats_shm_lcore_publish;
+    stats_shm_job.data = NULL;
+    stats_shm_job.type = NETIF_LCORE_JOB_SLOW;
+    stats_shm_job.skip_loops = STATS_SHM_LCORE_LOOPS;
+    err = netif_lcore_loop_job_register(&stats_shm_job);
+    if (err != EDPVS_OK)
+        goto errout;
+
+    err = dpvs_timer_sched_period(&stats_shm_timer, &tv,
+                                  stats_shm_publish, NULL, true);
+    if (err != EDPVS_OK) {
+        netif_lcore_loop_job_unregister(&stats_shm_job);
+        goto errout;
+    }
+
+    return EDPVS_OK;
+
+errout:
+    if (stats_shm) {
+        munmap(stats_shm, stats_shm->size);
+        stats_shm = NULL;
+        shm_unlink(stats_shm_name);
+    }
+    rte_free(stats_shm_dests);
+    rte_free(stats_shm_free);
+    stats_shm_dests = NULL;
+    stats_shm_free = NULL;
+    stats_shm_nfree = 0;
+    return err;
+}
+
+int dpvs_stats_shm_term(void)
+{
+    if (!stats_shm)
+        return EDPVS_OK;
+
+    dpvs_timer_cancel(&stats_shm_timer, true);
+    netif_lcore_loop_job_unregister(&stats_shm_job);
+
+    /*
+     * keep it mapped, dests freed later and lcores still running count
+     * into it. readers see it's gone by @ready.
+     */
+    stats_shm->ready = 0;
+    shm_unlink(stats_shm_name);
+
+    return EDPVS_OK;
+}
+
+/*
+ * config file
+ */
+static void stats_shm_switch_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+
+    assert(str);
+
+    if (strcasecmp(str, "on") == 0)
+        stats_shm_enable = true;
+    else if (strcasecmp(str, "off") == 0)
+        stats_shm_enable = false;
+    else
+        RTE_LOG(WARNING, STATSHM, "invalid stats_shm:switch %s\n", str);
+
+    RTE_LOG(INFO, STATSHM, "stats_shm:switch = %s\n",
+            stats_shm_enable ? "on" : "off");
+
+    FREE_PTR(str);
+}
+
+static void stats_shm_name_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    size_t slen;
+
+    assert(str);
+
+    slen = strlen(str);
+    /* a single path component led by '/', see shm_open(3) */
+    if (slen > 1 && slen < sizeof(stats_shm_name) && str[0] == '/' &&
+            !strchr(str + 1, '/')) {
+        RTE_LOG(INFO, STATSHM, "stats_shm:name = %s\n", str);
+        snprintf(stats_shm_name, sizeof(stats_shm_name), "%s", str);
+    } else {
+        RTE_LOG(WARNING, STATSHM, "invalid stats_shm:name %s, "
+                "using default %s\n", str, DPVS_SHM_NAME_DEF);
+        snprintf(stats_shm_name, sizeof(stats_shm_name), "%s",
+                 DPVS_SHM_NAME_DEF);
+    }
+
+    FREE_PTR(str);
+}
+
+static void stats_shm_max_dests_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int dests;
+
+    assert(str);
+
+    dests = atoi(str);
+    if (dests > 0 && dests <= STATS_SHM_MAX_DESTS_MAX) {
+        stats_shm_max_dests = dests;
+        RTE_LOG(INFO, STATSHM, "stats_shm:max_dests = %d\n", dests);
+    } else {
+        RTE_LOG(WARNING, STATSHM, "invalid stats_shm:max_dests %s, "
+                "using default %d\n", str, STATS_SHM_MAX_DESTS_DEF);
+        stats_shm_max_dests = STATS_SHM_MAX_DESTS_DEF;
+    }
+
+    FREE_PTR(str);
+}
+
+void stats_shm_keyword_value_init(void)
+{
+    if (dpvs_state_get() == DPVS_STATE_INIT) {
+        /* KW_TYPE_INIT keyword */
+        stats_shm_enable = false;
+        snprintf(stats_shm_name, sizeof(stats_shm_name), "%s",
+                 DPVS_SHM_NAME_DEF);
+        stats_shm_max_dests = STATS_SHM_MAX_DESTS_DEF;
+    }
+    /* KW_TYPE_NORMAL keyword */
+}
+
+void install_stats_shm_keywords(void)
+{
+    install_keyword("switch", stats_shm_switch_handler, KW_TYPE_INIT);
+    install_keyword("name", stats_shm_name_handler, KW_TYPE_INIT);
+    install_keyword("max_dests", stats_shm_max_dests_handler, KW_TYPE_INIT);
+}
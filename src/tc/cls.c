@@ -22,10 +22,13 @@
  */
 #include <assert.h>
 #include <linux/if_ether.h>
+#include "netif.h"
 #include "tc/tc.h"
 #include "tc/sch.h"
 #include "tc/cls.h"
 
+static int cls_recycle_timeout_us = 100000;
+
 static inline tc_handle_t cls_alloc_handle(struct Qsch *sch)
 {
     int i = 0x8000;
@@ -132,13 +135,9 @@ errout:
     return NULL;
 }
 
-void tc_cls_destroy(struct tc_cls *cls)
+static void __tc_cls_destroy(struct tc_cls *cls)
 {
     struct tc_cls_ops *ops = cls->ops;
-    struct Qsch *sch = cls->sch;
-
-    list_del(&cls->list);
-    sch->cls_cnt--;
 
     if (ops->destroy)
         ops->destroy(cls);
@@ -147,6 +146,34 @@ void tc_cls_destroy(struct tc_cls *cls)
     cls_free(cls);
 }
 
+static int cls_recycle(void *arg)
+{
+    struct tc_cls *cls = arg;
+
+    if (!netif_lcores_quiescent(cls->rc_loops)) {
+        dpvs_timer_reset_nolock(&cls->rc_timer, true);
+        RTE_LOG(DEBUG, TC, "%s: cls %u is in use.\n", __func__, cls->handle);
+        return DTIMER_OK;
+    }
+
+    __tc_cls_destroy(cls);
+    return DTIMER_STOP;
+}
+
+void tc_cls_destroy(struct tc_cls *cls)
+{
+    struct timeval timeout = { 0, cls_recycle_timeout_us };
+    struct Qsch *sch = cls->sch;
+
+    /* lcores walking sch->cls_list may be on it, keep its next
+     * pointer valid and free it after a grace period */
+    __list_del(cls->list.prev, cls->list.next);
+    sch->cls_cnt--;
+
+    netif_lcore_loops_save(cls->rc_loops);
+    dpvs_timer_sched(&cls->rc_timer, &timeout, cls_recycle, cls, true);
+}
+
 int tc_cls_change(struct tc_cls *cls, const void *arg)
 {
     if (!cls->ops->change)
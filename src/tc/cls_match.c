@@ -39,6 +39,7 @@ struct match_cls_priv {
     struct dp_vs_match      match;
 
     struct tc_cls_result    result;
+    struct tc_policer       police;
 };
 
 static int match_classify(struct tc_cls *cls, struct rte_mbuf *mbuf,
@@ -157,6 +158,8 @@ l2parse:
 match:
     /* all matchs */
     *result = priv->result;
+    if (unlikely(priv->police.rate) && !tc_policer_conform(&priv->police))
+        result->drop = true;
     err = TC_ACT_OK;
 
 done:
@@ -182,14 +185,9 @@ done:
     return err;
 }
 
-static int match_init(struct tc_cls *cls, const void *arg)
+static void match_set(struct match_cls_priv *priv,
+                      const struct tc_cls_match_copt *copt)
 {
-    struct match_cls_priv *priv = tc_cls_priv(cls);
-    const struct tc_cls_match_copt *copt = arg;
-
-    if (!arg)
-        return EDPVS_OK;
-
     if (copt->proto)
         priv->proto = copt->proto;
 
@@ -228,6 +226,37 @@ static int match_init(struct tc_cls *cls, const void *arg)
             priv->result.drop = false; /* exclusive with sch_id */
         }
     }
+}
+
+static int match_init(struct tc_cls *cls, const void *arg)
+{
+    struct match_cls_priv *priv = tc_cls_priv(cls);
+    const struct tc_cls_match_copt *copt = arg;
+
+    if (!arg)
+        return EDPVS_OK;
+
+    match_set(priv, copt);
+
+    if (copt->police.rate)
+        tc_policer_init(&priv->police, &copt->police);
+
+    return EDPVS_OK;
+}
+
+static int match_change(struct tc_cls *cls, const void *arg)
+{
+    struct match_cls_priv *priv = tc_cls_priv(cls);
+    const struct tc_cls_match_copt *copt = arg;
+
+    if (!arg)
+        return EDPVS_OK;
+
+    match_set(priv, copt);
+
+    /* lcores may be policing with it, don't reset their buckets */
+    if (copt->police.rate)
+        tc_policer_change(&priv->police, &copt->police);
 
     return EDPVS_OK;
 }
@@ -240,6 +269,7 @@ static int match_dump(struct tc_cls *cls, void *arg)
     copt->proto = priv->proto;
     copt->match = priv->match;
     copt->result = priv->result;
+    tc_policer_dump(&priv->police, &copt->police);
 
     return EDPVS_OK;
 }
@@ -249,6 +279,6 @@ struct tc_cls_ops match_cls_ops = {
     .priv_size  = sizeof(struct match_cls_priv),
     .classify   = match_classify,
     .init       = match_init,
-    .change     = match_init,
+    .change     = match_change,
     .dump       = match_dump,
 };
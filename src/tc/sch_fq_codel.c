@@ -0,0 +1,546 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * the Fair Queue CoDel scheduler of traffic control module.
+ * see linux/net/sched/sch_fq_codel.c and RFC 8290.
+ *
+ * packets are hashed to flow queues served by DRR, new flows first.
+ * each flow queue drops by CoDel on the sojourn time of its head.
+ * all state is per lcore, like the queues of other Qsch. it drains only
+ * when dequeued below a rate, so it's meant as the inner queue of tbf:
+ *
+ *   dpip qsch add dev dpdk0 handle 1: parent 0: tbf rate 100m burst 100000 ...
+ *   dpip qsch add dev dpdk0 handle 2: parent 1: fq_codel
+ */
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <rte_jhash.h>
+#include "netif.h"
+#include "mbuf.h"
+#include "tc/tc.h"
+#include "tc/sch.h"
+#include "conf/tc.h"
+
+#define FQ_CODEL_MAX_FLOWS      1024
+#define FQ_CODEL_DROP_BATCH     64
+
+/* defaults */
+#define FQ_CODEL_LIMIT          1024
+#define FQ_CODEL_TARGET         5000    /* us */
+#define FQ_CODEL_INTERVAL       100000  /* us */
+
+/* 1/sqrt(count) in Q0.16, see linux/include/net/codel_impl.h */
+#define REC_INV_SQRT_BITS       16
+#define REC_INV_SQRT_SHIFT      (32 - REC_INV_SQRT_BITS)
+
+struct codel_vars {
+    uint32_t                count;      /* drops since entering dropping */
+    uint32_t                lastcount;
+    bool                    dropping;
+    uint16_t                rec_inv_sqrt;
+    uint64_t                first_above_time;   /* TSC */
+    uint64_t                drop_next;          /* TSC */
+};
+
+struct fq_codel_flow {
+    struct list_head        mbufs;      /* tc_mbuf{} */
+    struct list_head        list;       /* new_flows or old_flows */
+    uint32_t                backlog;    /* bytes */
+    int32_t                 deficit;
+    struct codel_vars       cvars;
+};
+
+/* per-lcore */
+struct fq_codel_lcore {
+    struct list_head        new_flows;
+    struct list_head        old_flows;
+    struct tc_mbuf          *peeked;    /* dequeued by peek */
+    struct fq_codel_flow    flows[FQ_CODEL_MAX_FLOWS];
+};
+
+struct fq_codel_sch_priv {
+    uint32_t                flows;
+    uint32_t                quantum;
+    uint32_t                target_us;
+    uint32_t                interval_us;
+    uint64_t                target;     /* TSC */
+    uint64_t                interval;   /* TSC */
+};
+
+/* high bits of hash to flow index, the low bits of RSS hash chose rxq. */
+static inline uint32_t fq_codel_hash(const struct fq_codel_sch_priv *priv,
+                                     struct rte_mbuf *mbuf)
+{
+    struct ether_hdr *eh = rte_pktmbuf_mtod(mbuf, struct ether_hdr *);
+    uint32_t hash, ports = 0;
+    int offset = sizeof(*eh);
+    uint8_t proto;
+
+    if (mbuf->ol_flags & PKT_RX_RSS_HASH) {
+        hash = mbuf->hash.rss;
+        goto out;
+    }
+
+    switch (ntohs(eh->ether_type)) {
+    case ETH_P_IP: {
+        struct iphdr *iph;
+
+        if (mbuf_may_pull(mbuf, offset + sizeof(*iph)) != 0)
+            return 0;
+        iph = rte_pktmbuf_mtod_offset(mbuf, struct iphdr *, offset);
+        proto = iph->protocol;
+        offset += iph->ihl << 2;
+
+        /* non-first fragments have no ports */
+        if ((iph->frag_off & htons(IP_MF | IP_OFFMASK)) == 0 &&
+            (proto == IPPROTO_TCP || proto == IPPROTO_UDP) &&
+            mbuf_may_pull(mbuf, offset + 4) == 0)
+            ports = *rte_pktmbuf_mtod_offset(mbuf, uint32_t *, offset);
+
+        hash = rte_jhash_3words(iph->saddr, iph->daddr, ports, proto);
+        break;
+    }
+    case ETH_P_IPV6: {
+        struct ip6_hdr *ip6h;
+
+        if (mbuf_may_pull(mbuf, offset + sizeof(*ip6h)) != 0)
+            return 0;
+        ip6h = rte_pktmbuf_mtod_offset(mbuf, struct ip6_hdr *, offset);
+        proto = ip6h->ip6_nxt;
+        offset += sizeof(*ip6h);
+
+        /* extension headers are not walked, hashed by addresses only */
+        if ((proto == IPPROTO_TCP || proto == IPPROTO_UDP) &&
+            mbuf_may_pull(mbuf, offset + 4) == 0)
+            ports = *rte_pktmbuf_mtod_offset(mbuf, uint32_t *, offset);
+
+        hash = rte_jhash(&ip6h->ip6_src, 2 * sizeof(struct in6_addr),
+                         ports ^ proto);
+        break;
+    }
+    default:
+        return 0;
+    }
+
+out:
+    return ((uint64_t)hash * priv->flows) >> 32;
+}
+
+static inline struct tc_mbuf *flow_dequeue(struct Qsch *sch,
+                                           struct fq_codel_flow *flow)
+{
+    struct tc_mbuf *tm;
+    uint32_t len;
+
+    if (list_empty(&flow->mbufs))
+        return NULL;
+
+    tm = list_first_entry(&flow->mbufs, struct tc_mbuf, list);
+    list_del(&tm->list);
+
+    len = tm->mbuf->pkt_len;
+    flow->backlog -= len;
+    sch->this_q.qlen--;
+    sch->this_qstats.qlen--;
+    sch->this_qstats.backlog -= len;
+
+    return tm;
+}
+
+static inline void flow_drop(struct Qsch *sch, struct tc_mbuf *tm)
+{
+    qsch_drop(sch, tm->mbuf);
+    rte_mempool_put(sch->tc->tc_mbuf_pool, tm);
+}
+
+static inline void codel_newton_step(struct codel_vars *cv)
+{
+    uint32_t invsqrt = ((uint32_t)cv->rec_inv_sqrt) << REC_INV_SQRT_SHIFT;
+    uint32_t invsqrt2 = ((uint64_t)invsqrt * invsqrt) >> 32;
+    uint64_t val = (3ULL << 32) - ((uint64_t)cv->count * invsqrt2);
+
+    val >>= 2; /* avoid overflow in following multiply */
+    val = (val * invsqrt) >> (32 - 2 + 1);
+
+    cv->rec_inv_sqrt = val >> REC_INV_SQRT_SHIFT;
+}
+
+/* t + interval / sqrt(count) */
+static inline uint64_t codel_control_law(uint64_t t, uint64_t interval,
+                                         uint16_t rec_inv_sqrt)
+{
+    return t + ((interval * rec_inv_sqrt) >> REC_INV_SQRT_BITS);
+}
+
+static bool codel_should_drop(struct Qsch *sch,
+                              const struct fq_codel_sch_priv *priv,
+                              struct fq_codel_flow *flow,
+                              const struct tc_mbuf *tm, uint64_t now)
+{
+    struct codel_vars *cv = &flow->cvars;
+
+    if (!tm) {
+        cv->first_above_time = 0;
+        return false;
+    }
+
+    /* below target, or less than an MTU left to send */
+    if (now - tm->tstamp < priv->target ||
+        flow->backlog <= qsch_dev(sch)->mtu) {
+        cv->first_above_time = 0;
+        return false;
+    }
+
+    if (cv->first_above_time == 0) {
+        cv->first_above_time = now + priv->interval;
+        return false;
+    }
+
+    return (int64_t)(now - cv->first_above_time) >= 0;
+}
+
+static struct tc_mbuf *codel_dequeue(struct Qsch *sch,
+                                     const struct fq_codel_sch_priv *priv,
+                                     struct fq_codel_flow *flow)
+{
+    struct codel_vars *cv = &flow->cvars;
+    uint64_t now = rte_rdtsc();
+    struct tc_mbuf *tm;
+    uint32_t delta;
+
+    tm = flow_dequeue(sch, flow);
+    if (!codel_should_drop(sch, priv, flow, tm, now)) {
+        cv->dropping = false;
+        return tm;
+    }
+
+    if (cv->dropping) {
+        /* drop at the pace of control law while staying above target */
+        while (cv->dropping && (int64_t)(now - cv->drop_next) >= 0) {
+            cv->count++;
+            codel_newton_step(cv);
+            flow_drop(sch, tm);
+
+            tm = flow_dequeue(sch, flow);
+            if (!codel_should_drop(sch, priv, flow, tm, now))
+                cv->dropping = false;
+            else
+                cv->drop_next = codel_control_law(cv->drop_next, priv->interval,
+                                                  cv->rec_inv_sqrt);
+        }
+    } else {
+        flow_drop(sch, tm);
+        tm = flow_dequeue(sch, flow);
+        codel_should_drop(sch, priv, flow, tm, now);
+
+        /* resume the drop rate of last dropping state if it was recent */
+        cv->dropping = true;
+        delta = cv->count - cv->lastcount;
+        if (delta > 1 &&
+            (int64_t)(now - cv->drop_next) < (int64_t)(16 * priv->interval)) {
+            cv->count = delta;
+            codel_newton_step(cv);
+        } else {
+            cv->count = 1;
+            cv->rec_inv_sqrt = ~0U >> REC_INV_SQRT_SHIFT;
+        }
+        cv->lastcount = cv->count;
+        cv->drop_next = codel_control_law(now, priv->interval,
+                                          cv->rec_inv_sqrt);
+    }
+
+    return tm;
+}
+
+/* drop half of the fattest flow (at most a batch), on queue overflow */
+static struct fq_codel_flow *fq_codel_drop(struct Qsch *sch,
+                                           const struct fq_codel_sch_priv *priv,
+                                           struct fq_codel_lcore *fq)
+{
+    struct fq_codel_flow *fat = &fq->flows[0];
+    uint32_t i, threshold;
+
+    for (i = 1; i < priv->flows; i++) {
+        if (fq->flows[i].backlog > fat->backlog)
+            fat = &fq->flows[i];
+    }
+
+    threshold = fat->backlog >> 1;
+    for (i = 0; i < FQ_CODEL_DROP_BATCH && fat->backlog > threshold; i++)
+        flow_drop(sch, flow_dequeue(sch, fat));
+
+    return fat;
+}
+
+static int fq_codel_enqueue(struct Qsch *sch, struct rte_mbuf *mbuf)
+{
+    struct fq_codel_sch_priv *priv = qsch_priv(sch);
+    struct fq_codel_lcore *fq = qsch_this_priv(sch);
+    struct fq_codel_flow *flow;
+    struct tc_mbuf *tm;
+
+    if (unlikely(rte_mempool_get(sch->tc->tc_mbuf_pool, (void **)&tm) != 0)) {
+        RTE_LOG(WARNING, TC, "%s: no memory\n", __func__);
+        qsch_drop(sch, mbuf);
+        return EDPVS_NOMEM;
+    }
+
+    flow = &fq->flows[fq_codel_hash(priv, mbuf)];
+
+    tm->mbuf = mbuf;
+    tm->tstamp = rte_rdtsc();
+    list_add_tail(&tm->list, &flow->mbufs);
+    flow->backlog += mbuf->pkt_len;
+    sch->this_q.qlen++;
+    sch->this_qstats.qlen++;
+    sch->this_qstats.backlog += mbuf->pkt_len;
+
+    if (list_empty(&flow->list)) {
+        list_add_tail(&flow->list, &fq->new_flows);
+        flow->deficit = priv->quantum;
+    }
+
+    if (likely(sch->this_q.qlen <= sch->limit))
+        return EDPVS_OK;
+
+    sch->this_qstats.overlimits++;
+
+    /* drops are from head, the new packet is gone only if its flow is */
+    if (fq_codel_drop(sch, priv, fq) == flow && list_empty(&flow->mbufs))
+        return EDPVS_DROP;
+
+    return EDPVS_OK;
+}
+
+static struct rte_mbuf *fq_codel_dequeue(struct Qsch *sch)
+{
+    struct fq_codel_sch_priv *priv = qsch_priv(sch);
+    struct fq_codel_lcore *fq = qsch_this_priv(sch);
+    struct fq_codel_flow *flow;
+    struct list_head *head;
+    struct tc_mbuf *tm;
+    struct rte_mbuf *mbuf;
+
+    if (fq->peeked) {
+        tm = fq->peeked;
+        fq->peeked = NULL;
+
+        sch->this_q.qlen--;
+        sch->this_qstats.qlen--;
+        sch->this_qstats.backlog -= tm->mbuf->pkt_len;
+        goto out;
+    }
+
+begin:
+    head = &fq->new_flows;
+    if (list_empty(head)) {
+        head = &fq->old_flows;
+        if (list_empty(head))
+            return NULL;
+    }
+
+    flow = list_first_entry(head, struct fq_codel_flow, list);
+    if (flow->deficit <= 0) {
+        flow->deficit += priv->quantum;
+        list_move_tail(&flow->list, &fq->old_flows);
+        goto begin;
+    }
+
+    tm = codel_dequeue(sch, priv, flow);
+    if (!tm) {
+        /* a pass through old flows first, not to starve them */
+        if (head == &fq->new_flows && !list_empty(&fq->old_flows))
+            list_move_tail(&flow->list, &fq->old_flows);
+        else
+            list_del_init(&flow->list);
+        goto begin;
+    }
+
+    flow->deficit -= tm->mbuf->pkt_len;
+
+out:
+    mbuf = tm->mbuf;
+    rte_mempool_put(sch->tc->tc_mbuf_pool, tm);
+
+    sch->this_bstats.packets++;
+    sch->this_bstats.bytes += mbuf->pkt_len;
+    return mbuf;
+}
+
+/* which packet is next depends on drops at dequeue, so dequeue it ahead */
+static struct rte_mbuf *fq_codel_peek(struct Qsch *sch)
+{
+    struct fq_codel_lcore *fq = qsch_this_priv(sch);
+    struct rte_mbuf *mbuf;
+    struct tc_mbuf *tm;
+
+    if (fq->peeked)
+        return fq->peeked->mbuf;
+
+    mbuf = fq_codel_dequeue(sch);
+    if (!mbuf)
+        return NULL;
+
+    /* not sent yet */
+    sch->this_bstats.packets--;
+    sch->this_bstats.bytes -= mbuf->pkt_len;
+
+    if (unlikely(rte_mempool_get(sch->tc->tc_mbuf_pool, (void **)&tm) != 0)) {
+        qsch_drop(sch, mbuf);
+        return NULL;
+    }
+
+    /* still queued until dequeued, as parents (tbf) follow our qlen */
+    tm->mbuf = mbuf;
+    fq->peeked = tm;
+    sch->this_q.qlen++;
+    sch->this_qstats.qlen++;
+    sch->this_qstats.backlog += mbuf->pkt_len;
+    return mbuf;
+}
+
+static int fq_codel_change(struct Qsch *sch, const void *arg)
+{
+    struct fq_codel_sch_priv *priv = qsch_priv(sch);
+    const struct tc_fq_codel_qopt *qopt = arg;
+    uint64_t us_cycles = rte_get_tsc_hz() / 1000000;
+
+    if (!qopt)
+        return EDPVS_OK;
+
+    /* flows are hashed, number of them can't be changed */
+    if (qopt->flows && qopt->flows != priv->flows)
+        return EDPVS_NOTSUPP;
+
+    if (qopt->limit)
+        sch->limit = qopt->limit;
+    if (qopt->quantum)
+        priv->quantum = qopt->quantum;
+    if (qopt->target)
+        priv->target_us = qopt->target;
+    if (qopt->interval)
+        priv->interval_us = qopt->interval;
+
+    priv->target = priv->target_us * us_cycles;
+    priv->interval = priv->interval_us * us_cycles;
+
+    return EDPVS_OK;
+}
+
+static void fq_codel_lcore_init(struct fq_codel_lcore *fq, uint32_t flows)
+{
+    struct fq_codel_flow *flow;
+    uint32_t i;
+
+    fq->peeked = NULL;
+    INIT_LIST_HEAD(&fq->new_flows);
+    INIT_LIST_HEAD(&fq->old_flows);
+
+    for (i = 0; i < flows; i++) {
+        flow = &fq->flows[i];
+        INIT_LIST_HEAD(&flow->mbufs);
+        INIT_LIST_HEAD(&flow->list);
+        flow->backlog = 0;
+        flow->deficit = 0;
+        memset(&flow->cvars, 0, sizeof(flow->cvars));
+    }
+}
+
+static void fq_codel_reset(struct Qsch *sch)
+{
+    struct fq_codel_sch_priv *priv = qsch_priv(sch);
+    struct fq_codel_lcore *fq;
+    struct tc_mbuf *tm, *n;
+    lcoreid_t cid;
+    uint32_t i;
+
+    for (cid = 0; cid < NELEMS(sch->lcore); cid++) {
+        if (!sch->lcore[cid])
+            continue;
+
+        fq = qsch_lcore_priv(sch, cid);
+        if (fq->peeked)
+            flow_drop(sch, fq->peeked);
+
+        for (i = 0; i < priv->flows; i++) {
+            list_for_each_entry_safe(tm, n, &fq->flows[i].mbufs, list)
+                flow_drop(sch, tm);
+        }
+
+        fq_codel_lcore_init(fq, priv->flows);
+        sch->lcore[cid]->q.qlen = 0;
+        sch->lcore[cid]->qstats.qlen = 0;
+        sch->lcore[cid]->qstats.backlog = 0;
+    }
+}
+
+static int fq_codel_init(struct Qsch *sch, const void *arg)
+{
+    struct fq_codel_sch_priv *priv = qsch_priv(sch);
+    const struct tc_fq_codel_qopt *qopt = arg;
+    lcoreid_t cid;
+
+    priv->flows = FQ_CODEL_MAX_FLOWS;
+    if (qopt && qopt->flows) {
+        if (qopt->flows > FQ_CODEL_MAX_FLOWS)
+            return EDPVS_INVAL;
+        priv->flows = qopt->flows;
+    }
+
+    sch->limit = FQ_CODEL_LIMIT;
+    priv->quantum = qsch_dev(sch)->mtu + sizeof(struct ether_hdr);
+    priv->target_us = FQ_CODEL_TARGET;
+    priv->interval_us = FQ_CODEL_INTERVAL;
+
+    for (cid = 0; cid < NELEMS(sch->lcore); cid++) {
+        if (sch->lcore[cid])
+            fq_codel_lcore_init(qsch_lcore_priv(sch, cid), priv->flows);
+    }
+
+    return fq_codel_change(sch, arg);
+}
+
+static int fq_codel_dump(struct Qsch *sch, void *arg)
+{
+    struct fq_codel_sch_priv *priv = qsch_priv(sch);
+    struct tc_fq_codel_qopt *qopt = arg;
+
+    qopt->limit     = sch->limit;
+    qopt->flows     = priv->flows;
+    qopt->quantum   = priv->quantum;
+    qopt->target    = priv->target_us;
+    qopt->interval  = priv->interval_us;
+
+    return EDPVS_OK;
+}
+
+struct Qsch_ops fq_codel_sch_ops = {
+    .name       = "fq_codel",
+    .priv_size  = sizeof(struct fq_codel_sch_priv),
+    .lcore_priv_size = sizeof(struct fq_codel_lcore),
+    .enqueue    = fq_codel_enqueue,
+    .dequeue    = fq_codel_dequeue,
+    .peek       = fq_codel_peek,
+    .init       = fq_codel_init,
+    .reset      = fq_codel_reset,
+    .change     = fq_codel_change,
+    .dump       = fq_codel_dump,
+};
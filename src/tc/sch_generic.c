@@ -29,7 +29,7 @@
 
 /* may configurable in the future. */
 static int dev_tx_weight = 64;
-static int qsch_recycle_timeout = 5;
+static int qsch_recycle_timeout_us = 100000;
 
 static inline int sch_hash(tc_handle_t handle, int hash_size)
 {
@@ -56,33 +56,53 @@ static inline int sch_dequeue_xmit(struct Qsch *sch, int *npkt)
     return sch_qlen(sch);
 }
 
+static inline void sch_free(struct Qsch *sch)
+{
+    lcoreid_t cid;
+
+    for (cid = 0; cid < NELEMS(sch->lcore); cid++) {
+        if (sch->lcore[cid])
+            rte_free(sch->lcore[cid]);
+    }
+
+    rte_free(sch);
+}
+
 static inline struct Qsch *sch_alloc(struct netif_tc *tc, struct Qsch_ops *ops)
 {
     struct Qsch *sch;
     unsigned int size = TC_ALIGN(sizeof(*sch)) + ops->priv_size;
+    unsigned int lsize = TC_ALIGN(sizeof(struct qsch_lcore)) +
+                         ops->lcore_priv_size;
     lcoreid_t cid;
 
     sch = rte_zmalloc(NULL, size, RTE_CACHE_LINE_SIZE);
     if (!sch)
         return NULL;
 
-    for (cid = 0; cid < NELEMS(sch->q); cid++)
-        tc_mbuf_head_init(&sch->q[cid]);
+    /* each lcore's queue and counters on its own cache lines and node */
+    for (cid = 0; cid < NELEMS(sch->lcore); cid++) {
+        if (!rte_lcore_is_enabled(cid))
+            continue;
+
+        sch->lcore[cid] = rte_zmalloc_socket(NULL, lsize, RTE_CACHE_LINE_SIZE,
+                                             rte_lcore_to_socket_id(cid));
+        if (!sch->lcore[cid]) {
+            sch_free(sch);
+            return NULL;
+        }
+
+        tc_mbuf_head_init(&sch->lcore[cid]->q);
+    }
 
     INIT_LIST_HEAD(&sch->cls_list);
     INIT_HLIST_NODE(&sch->hlist);
     sch->tc = tc;
     sch->ops = ops;
-    rte_atomic32_set(&sch->refcnt, 1);
 
     return sch;
 }
 
-static inline void sch_free(struct Qsch *sch)
-{
-    rte_free(sch);
-}
-
 static void __qsch_destroy(struct Qsch *sch)
 {
     struct Qsch_ops *ops = sch->ops;
@@ -100,9 +120,9 @@ static int sch_recycle(void *arg)
 {
     struct Qsch *sch = arg;
 
-    if (rte_atomic32_read(&sch->refcnt)) {
+    if (!netif_lcores_quiescent(sch->rc_loops)) {
         dpvs_timer_reset_nolock(&sch->rc_timer, true);
-        RTE_LOG(WARNING, TC, "%s: sch %u is in use.\n", __func__, sch->handle);
+        RTE_LOG(DEBUG, TC, "%s: sch %u is in use.\n", __func__, sch->handle);
         return DTIMER_OK;
     }
 
@@ -112,8 +132,9 @@ static int sch_recycle(void *arg)
 
 static void sch_dying(struct Qsch *sch)
 {
-    struct timeval timeout = { qsch_recycle_timeout, 0 };
+    struct timeval timeout = { 0, qsch_recycle_timeout_us };
 
+    netif_lcore_loops_save(sch->rc_loops);
     dpvs_timer_sched(&sch->rc_timer, &timeout, sch_recycle, sch, true);
 }
 
@@ -139,7 +160,7 @@ struct Qsch *qsch_create(struct netif_port *dev, const char *kind,
 {
     int err;
     struct Qsch_ops *ops = NULL;
-    struct Qsch *sch = NULL;
+    struct Qsch *sch = NULL, *q = NULL;
     struct netif_tc *tc = netif_tc(dev);
     assert(dev && kind && errp);
 
@@ -165,7 +186,6 @@ struct Qsch *qsch_create(struct netif_port *dev, const char *kind,
             goto errout;
         }
     } else { /* egress */
-        struct Qsch *q;
 
         if (handle == 0) {
             handle = sch_alloc_handle(dev);
@@ -205,8 +225,16 @@ struct Qsch *qsch_create(struct netif_port *dev, const char *kind,
     if (sch->flags & QSCH_F_INGRESS) {
         tc->qsch_ingress = sch;
         sch->tc->qsch_cnt++;
-    } else
+    } else {
         qsch_hash_add(sch, false);
+
+        /* becomes the inner queue of a parent having one */
+        if (q->ops->graft && (err = q->ops->graft(q, sch)) != EDPVS_OK) {
+            qsch_destroy(sch);
+            *errp = err;
+            return NULL;
+        }
+    }
     *errp = EDPVS_OK;
     return sch;
 
@@ -245,8 +273,30 @@ struct Qsch *qsch_create_dflt(struct netif_port *dev, struct Qsch_ops *ops,
     return sch;
 }
 
+/*
+ * inner queues grafted to @sch are destroyed with it by ops->destroy,
+ * unhash them now so no control op can reach them meanwhile.
+ */
+static void sch_unhash_inner(struct Qsch *sch)
+{
+    struct netif_tc *tc = sch->tc;
+    struct Qsch *q;
+    struct hlist_node *n;
+    int h;
+
+    for (h = 0; h < tc->qsch_hash_size; h++) {
+        hlist_for_each_entry_safe(q, n, &tc->qsch_hash[h], hlist) {
+            if (q != sch && q->parent == sch->handle)
+                qsch_hash_del(q);
+        }
+    }
+}
+
 void qsch_destroy(struct Qsch *sch)
 {
+    if (sch->ops->graft)
+        sch_unhash_inner(sch);
+
     if (sch->flags & QSCH_F_INGRESS) {
         assert(sch->tc->qsch_ingress == sch);
         sch->tc->qsch_ingress = NULL;
@@ -258,13 +308,8 @@ void qsch_destroy(struct Qsch *sch)
         qsch_hash_del(sch);
     }
 
-    if (!rte_atomic32_dec_and_test(&sch->refcnt)) {
-        RTE_LOG(WARNING, TC, "%s: sch %u is in use.\n", __func__, sch->handle);
-        sch_dying(sch);
-        return;
-    }
-
-    __qsch_destroy(sch);
+    /* lcores may be still on it, free after a grace period */
+    sch_dying(sch);
 }
 
 int qsch_change(struct Qsch *sch, const void *arg)
@@ -282,8 +327,35 @@ void qsch_reset(struct Qsch *sch)
     if (sch->ops->reset)
         sch->ops->reset(sch);
 
-    for (cid = 0; cid < NELEMS(sch->q); cid++)
-        sch->q[cid].qlen = 0;
+    for (cid = 0; cid < NELEMS(sch->lcore); cid++) {
+        if (sch->lcore[cid])
+            sch->lcore[cid]->q.qlen = 0;
+    }
+}
+
+void qsch_stats(struct Qsch *sch, struct qsch_qstats *qstats,
+                struct qsch_bstats *bstats)
+{
+    lcoreid_t cid;
+    const struct qsch_lcore *ql;
+
+    memset(qstats, 0, sizeof(*qstats));
+    memset(bstats, 0, sizeof(*bstats));
+
+    for (cid = 0; cid < NELEMS(sch->lcore); cid++) {
+        ql = sch->lcore[cid];
+        if (!ql)
+            continue;
+
+        qstats->qlen        += ql->qstats.qlen;
+        qstats->backlog     += ql->qstats.backlog;
+        qstats->drops       += ql->qstats.drops;
+        qstats->requeues    += ql->qstats.requeues;
+        qstats->overlimits  += ql->qstats.overlimits;
+
+        bstats->bytes       += ql->bstats.bytes;
+        bstats->packets     += ql->bstats.packets;
+    }
 }
 
 void qsch_hash_add(struct Qsch *sch, bool invisible)
@@ -309,6 +381,10 @@ void qsch_hash_del(struct Qsch *sch)
     if (sch->parent == TC_H_ROOT || (sch->flags & QSCH_F_INGRESS))
         return;
 
+    /* inner queue unhashed with its parent already */
+    if (hlist_unhashed(&sch->hlist))
+        return;
+
     hlist_del_init(&sch->hlist);
     sch->tc->qsch_cnt--;
 }
@@ -334,17 +410,6 @@ struct Qsch *qsch_lookup_noref(const struct netif_tc *tc, tc_handle_t handle)
     return NULL;
 }
 
-struct Qsch *qsch_lookup(const struct netif_tc *tc, tc_handle_t handle)
-{
-    struct Qsch *sch = NULL;
-
-    sch = qsch_lookup_noref(tc, handle);
-    if (sch)
-        qsch_get(sch);
-
-    return sch;
-}
-
 void qsch_do_sched(struct Qsch *sch)
 {
     int quota = dev_tx_weight;
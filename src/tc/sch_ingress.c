@@ -0,0 +1,43 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * the ingress scheduler of traffic control module.
+ * see linux/net/sched/sch_ingress.c
+ *
+ * classify-only, it never queues. classifiers attached to it are run
+ * on received packets before L3, to drop or police them.
+ */
+#include <linux/pkt_sched.h>
+#include "netif.h"
+#include "tc/tc.h"
+#include "tc/sch.h"
+#include "conf/tc.h"
+
+static int ingress_init(struct Qsch *sch, const void *arg)
+{
+    if (!(sch->flags & QSCH_F_INGRESS))
+        return EDPVS_INVAL;
+
+    return EDPVS_OK;
+}
+
+struct Qsch_ops ingress_sch_ops = {
+    .name       = "ingress",
+    .priv_size  = 0,
+    .init       = ingress_init,
+};
@@ -38,12 +38,10 @@ static const uint8_t prio2band[TC_PRIO_MAX + 1] = {
 
 static const int bitmap2band[] = {-1, 0, 1, 0, 2, 0, 1, 0};
 
+/* per-lcore */
 struct pfifo_fast_priv {
-    uint32_t bitmap[RTE_MAX_LCORE];
-    struct tc_mbuf_head q[RTE_MAX_LCORE][PFIFO_FAST_BANDS];
-
-#define this_bitmap bitmap[rte_lcore_id()]
-#define this_pff_q  q[rte_lcore_id()]
+    uint32_t bitmap;
+    struct tc_mbuf_head q[PFIFO_FAST_BANDS];
 };
 
 static inline struct tc_mbuf_head *band2list(struct pfifo_fast_priv *priv,
@@ -51,15 +49,7 @@ static inline struct tc_mbuf_head *band2list(struct pfifo_fast_priv *priv,
 {
     assert(band >= 0 && band < PFIFO_FAST_BANDS);
 
-    return priv->this_pff_q + band;
-}
-
-static inline struct tc_mbuf_head *band2list_cpu(struct pfifo_fast_priv *priv,
-                                                 int band, lcoreid_t cid)
-{
-    assert(band >= 0 && band < PFIFO_FAST_BANDS);
-
-    return priv->q[cid] + band;
+    return priv->q + band;
 }
 
 static int pfifo_fast_enqueue(struct Qsch *sch, struct rte_mbuf *mbuf)
@@ -82,12 +72,12 @@ static int pfifo_fast_enqueue(struct Qsch *sch, struct rte_mbuf *mbuf)
         prio = (uint8_t)mbuf->udata64;
 
     band = prio2band[prio];
-    priv = qsch_priv(sch);
+    priv = qsch_this_priv(sch);
     qh = band2list(priv, band);
 
     err = __qsch_enqueue_tail(sch, mbuf, qh);
     if (err == EDPVS_OK) {
-        priv->this_bitmap |= (1 << band);
+        priv->bitmap |= (1 << band);
         sch->this_q.qlen++;
         sch->this_qstats.qlen++;
     }
@@ -97,8 +87,8 @@ static int pfifo_fast_enqueue(struct Qsch *sch, struct rte_mbuf *mbuf)
 
 static struct rte_mbuf *pfifo_fast_dequeue(struct Qsch *sch)
 {
-    struct pfifo_fast_priv *priv = qsch_priv(sch);
-    int band = bitmap2band[priv->this_bitmap];
+    struct pfifo_fast_priv *priv = qsch_this_priv(sch);
+    int band = bitmap2band[priv->bitmap];
     struct tc_mbuf_head *qh;
     struct rte_mbuf *mbuf;
 
@@ -114,15 +104,15 @@ static struct rte_mbuf *pfifo_fast_dequeue(struct Qsch *sch)
     }
 
     if (likely(qh->qlen == 0))
-        priv->this_bitmap &= ~(1 << band);
+        priv->bitmap &= ~(1 << band);
 
     return mbuf;
 }
 
 static struct rte_mbuf *pfifo_fast_peek(struct Qsch *sch)
 {
-    struct pfifo_fast_priv *priv = qsch_priv(sch);
-    int band = bitmap2band[priv->this_bitmap];
+    struct pfifo_fast_priv *priv = qsch_this_priv(sch);
+    int band = bitmap2band[priv->bitmap];
     struct tc_mbuf_head *qh;
     struct tc_mbuf *tm;
 
@@ -141,12 +131,15 @@ static int pfifo_fast_init(struct Qsch *sch, const void *arg)
 {
     int band;
     lcoreid_t cid;
-    struct pfifo_fast_priv *priv = qsch_priv(sch);
+    struct pfifo_fast_priv *priv;
+
+    for (cid = 0; cid < NELEMS(sch->lcore); cid++) {
+        if (!sch->lcore[cid])
+            continue;
 
-    for (cid = 0; cid < NELEMS(priv->q); cid++) {
-        for (band = 0; band < PFIFO_FAST_BANDS; band++) {
-            tc_mbuf_head_init(band2list_cpu(priv, band, cid));
-        }
+        priv = qsch_lcore_priv(sch, cid);
+        for (band = 0; band < PFIFO_FAST_BANDS; band++)
+            tc_mbuf_head_init(band2list(priv, band));
     }
 
     /* FIXME: txq_desc_nb is not set when alloc device.
@@ -164,15 +157,19 @@ static void pfifo_fast_reset(struct Qsch *sch)
 {
     int band;
     lcoreid_t cid;
-    struct pfifo_fast_priv *priv = qsch_priv(sch);
+    struct pfifo_fast_priv *priv;
+
+    for (cid = 0; cid < NELEMS(sch->lcore); cid++) {
+        if (!sch->lcore[cid])
+            continue;
 
-    for (cid = 0; cid < NELEMS(priv->q); cid++) {
+        priv = qsch_lcore_priv(sch, cid);
         for (band = 0; band < PFIFO_FAST_BANDS; band++)
-            __qsch_reset_queue(sch, band2list_cpu(priv, band, cid));
+            __qsch_reset_queue(sch, band2list(priv, band));
 
-        priv->bitmap[cid] = 0;
-        sch->q[cid].qlen = 0;
-        sch->qstats[cid].qlen = 0;
+        priv->bitmap = 0;
+        sch->lcore[cid]->q.qlen = 0;
+        sch->lcore[cid]->qstats.qlen = 0;
     }
 }
 
@@ -188,7 +185,8 @@ static int pfifo_fast_dump(struct Qsch *sch, void *arg)
 
 struct Qsch_ops pfifo_fast_ops = {
     .name       = "pfifo_fast",
-    .priv_size  = sizeof(struct pfifo_fast_priv),
+    .priv_size  = 0,
+    .lcore_priv_size = sizeof(struct pfifo_fast_priv),
     .enqueue    = pfifo_fast_enqueue,
     .dequeue    = pfifo_fast_dequeue,
     .peek       = pfifo_fast_peek,
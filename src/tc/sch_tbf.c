@@ -54,9 +54,29 @@ static inline bool tbf_peak_present(const struct tbf_sch_priv *priv)
     return priv->peak.rate_bytes_ps;
 }
 
+/*
+ * inner queue may drop packets by itself, e.g., fq_codel drops on
+ * overflow and at dequeue. follow its length instead of counting,
+ * and take packets missing from @expect as our drops.
+ */
+static inline void tbf_sync_child(struct Qsch *sch, struct Qsch *child,
+                                  uint32_t expect)
+{
+    uint32_t qlen = child->this_q.qlen;
+
+    if (expect > qlen)
+        sch->this_qstats.drops += expect - qlen;
+
+    sch->this_q.qlen = qlen;
+    sch->this_qstats.qlen = qlen;
+    sch->this_qstats.backlog = child->this_qstats.backlog;
+}
+
 static int tbf_enqueue(struct Qsch *sch, struct rte_mbuf *mbuf)
 {
     struct tbf_sch_priv *priv = qsch_priv(sch);
+    struct Qsch *child = priv->qsch;
+    uint32_t expect;
     int err;
 
     if (unlikely(mbuf->pkt_len > priv->max_size)) {
@@ -64,34 +84,34 @@ static int tbf_enqueue(struct Qsch *sch, struct rte_mbuf *mbuf)
         return qsch_drop(sch, mbuf);
     }
 
-    assert(priv->qsch);
+    assert(child);
 
     /*
      * enqueue is simple: just put into inner backlog queue,
      * if it's full then drop the packet (by inner queue).
      */
-    err = priv->qsch->ops->enqueue(priv->qsch, mbuf);
-    if (err != EDPVS_OK) {
-        sch->this_qstats.drops++;
-        return err;
-    }
+    expect = child->this_q.qlen + 1;
+    err = child->ops->enqueue(child, mbuf);
+    tbf_sync_child(sch, child, expect);
 
-    sch->this_qstats.backlog += mbuf->pkt_len;
-    sch->this_qstats.qlen++;
-    sch->this_q.qlen++;
-    return EDPVS_OK;
+    return err;
 }
 
 static struct rte_mbuf *tbf_dequeue(struct Qsch *sch)
 {
     struct tbf_sch_priv *priv = qsch_priv(sch);
+    struct Qsch *child = priv->qsch; /* may be grafted meanwhile */
     struct rte_mbuf *mbuf;
     int64_t now, toks, ptoks; /* need "signed" to compare with 0 */
     unsigned int pkt_len;
+    uint32_t expect;
 
-    assert(priv->qsch);
+    assert(child);
 
-    mbuf = priv->qsch->ops->peek(priv->qsch);
+    /* peek of fq_codel etc. may drop packets */
+    expect = child->this_q.qlen;
+    mbuf = child->ops->peek(child);
+    tbf_sync_child(sch, child, expect);
     if (unlikely(!mbuf))
         return NULL;
     pkt_len = mbuf->pkt_len;
@@ -124,7 +144,9 @@ static struct rte_mbuf *tbf_dequeue(struct Qsch *sch)
      * current toks/ptoks was subtracted by pkt_len inadvance.
      * so < zero means not enough and >= 0 means enough. */
     if ((toks|ptoks) >= 0) {
-        mbuf = qsch_dequeue_head(priv->qsch);
+        expect = child->this_q.qlen;
+        mbuf = child->ops->dequeue(child);
+        tbf_sync_child(sch, child, (mbuf && expect) ? expect - 1 : expect);
         if (unlikely(!mbuf))
             return NULL;
 
@@ -133,9 +155,6 @@ static struct rte_mbuf *tbf_dequeue(struct Qsch *sch)
         priv->tokens = toks;
         priv->ptokens = ptoks;
 
-        sch->this_qstats.backlog -= pkt_len;
-        sch->this_qstats.qlen--;
-        sch->this_q.qlen--;
         sch->this_bstats.bytes += pkt_len;
         sch->this_bstats.packets++;
 
@@ -240,6 +259,22 @@ static int tbf_init(struct Qsch *sch, const void *arg)
     return tbf_change(sch, qopt);
 }
 
+static int tbf_graft(struct Qsch *sch, struct Qsch *child)
+{
+    struct tbf_sch_priv *priv = qsch_priv(sch);
+    struct Qsch *old = priv->qsch;
+
+    if (!child->ops->enqueue || !child->ops->dequeue || !child->ops->peek)
+        return EDPVS_NOTSUPP;
+
+    /* lcores see either queue, the old one is freed after grace period */
+    priv->qsch = child;
+    if (old)
+        qsch_destroy(old);
+
+    return EDPVS_OK;
+}
+
 static void tbf_destroy(struct Qsch *sch)
 {
     struct tbf_sch_priv *priv = qsch_priv(sch);
@@ -253,10 +288,13 @@ static void tbf_reset(struct Qsch *sch)
     struct tbf_sch_priv *priv = qsch_priv(sch);
 
     qsch_reset(priv->qsch);
-    for (cid = 0; cid < NELEMS(sch->q); cid++) {
-        sch->qstats[cid].backlog = 0;
-        sch->qstats[cid].qlen = 0;
-        sch->q[cid].qlen = 0;
+    for (cid = 0; cid < NELEMS(sch->lcore); cid++) {
+        if (!sch->lcore[cid])
+            continue;
+
+        sch->lcore[cid]->qstats.backlog = 0;
+        sch->lcore[cid]->qstats.qlen = 0;
+        sch->lcore[cid]->q.qlen = 0;
     }
 
     priv->t_c = tc_get_ns();
@@ -296,4 +334,5 @@ struct Qsch_ops tbf_sch_ops = {
     .destroy    = tbf_destroy,
     .change     = tbf_change,
     .dump       = tbf_dump,
+    .graft      = tbf_graft,
 };
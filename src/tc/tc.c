@@ -32,6 +32,8 @@ extern struct Qsch_ops pfifo_sch_ops;
 extern struct Qsch_ops bfifo_sch_ops;
 extern struct Qsch_ops pfifo_fast_ops;
 extern struct Qsch_ops tbf_sch_ops;
+extern struct Qsch_ops ingress_sch_ops;
+extern struct Qsch_ops fq_codel_sch_ops;
 extern struct tc_cls_ops match_cls_ops;
 
 static struct list_head qsch_ops_base;
@@ -192,8 +194,6 @@ struct rte_mbuf *tc_handle_egress(struct netif_tc *tc,
         return mbuf;
     }
 
-    qsch_get(sch);
-
     /*
      * classify the traffic first.
      * support classify for child schedulers only.
@@ -218,7 +218,11 @@ again:
         if (unlikely(cls_res.drop))
             goto drop;
 
-        child_sch = qsch_lookup(sch->tc, cls_res.sch_id);
+        /* police-only rule, conforming packets stay in this Qsch */
+        if (cls_res.sch_id == TC_H_UNSPEC)
+            break;
+
+        child_sch = qsch_lookup_noref(sch->tc, cls_res.sch_id);
 
         if (unlikely(!child_sch)) {
             RTE_LOG(WARNING, TC, "%s: target Qsch not exist.\n",
@@ -229,12 +233,10 @@ again:
         if (unlikely(child_sch->parent != sch->handle)) {
             RTE_LOG(WARNING, TC, "%s: classified to non-children scheduler\n",
                     __func__);
-            qsch_put(child_sch);
             continue;
         }
 
         /* pass the packet to child scheduler */
-        qsch_put(sch);
         sch = child_sch;
 
         if (unlikely(limit++ >= max_reclassify_loop)) {
@@ -260,12 +262,61 @@ again:
     qsch_do_sched(sch);
 
 out:
-    qsch_put(sch);
     return mbuf;
 
 drop:
     *ret = qsch_drop(sch, mbuf);
-    qsch_put(sch);
+    return NULL;
+}
+
+/*
+ * run classifiers of ingress Qsch on a received packet, @eth_type is
+ * the (inner VLAN) ether type. the first matching classifier decides:
+ * drop, or pass on to L3. the mbuf is consumed if NULL is returned.
+ */
+struct rte_mbuf *tc_handle_ingress(struct netif_tc *tc, __be16 eth_type,
+                                   struct rte_mbuf *mbuf, int *ret)
+{
+    int err;
+    struct Qsch *sch;
+    struct tc_cls *cls;
+    struct tc_cls_result cls_res;
+
+    assert(tc && mbuf && ret);
+
+    *ret = EDPVS_OK;
+
+    sch = tc->qsch_ingress;
+    if (unlikely(!sch))
+        return mbuf;
+
+    list_for_each_entry(cls, &sch->cls_list, list) {
+        if (unlikely(cls->pkt_type != ntohs(eth_type) &&
+                     cls->pkt_type != ETH_P_ALL))
+            continue;
+
+        err = cls->ops->classify(cls, mbuf, &cls_res);
+        switch (err) {
+        case TC_ACT_OK:
+            break;
+        case TC_ACT_SHOT:
+            goto drop;
+        default:
+            continue;
+        }
+
+        if (unlikely(cls_res.drop))
+            goto drop;
+
+        break;
+    }
+
+    sch->this_bstats.packets++;
+    sch->this_bstats.bytes += mbuf->pkt_len;
+    return mbuf;
+
+drop:
+    *ret = qsch_drop(sch, mbuf);
     return NULL;
 }
 
@@ -354,6 +405,8 @@ int tc_init(void)
     tc_register_qsch(&bfifo_sch_ops);
     tc_register_qsch(&pfifo_fast_ops);
     tc_register_qsch(&tbf_sch_ops);
+    tc_register_qsch(&ingress_sch_ops);
+    tc_register_qsch(&fq_codel_sch_ops);
 
     /* classifier */
     rte_rwlock_init(&cls_ops_lock);
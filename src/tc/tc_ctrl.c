@@ -31,9 +31,7 @@
 static int fill_qsch_param(struct Qsch *sch, struct tc_qsch_param *pr)
 {
     int err;
-    struct dpvs_msg *req, *reply;
-    struct dpvs_multicast_queue *replies = NULL;
-    struct tc_qsch_stats *st;
+    lcoreid_t cid;
 
     memset(pr, 0, sizeof(*pr));
 
@@ -44,38 +42,17 @@ static int fill_qsch_param(struct Qsch *sch, struct tc_qsch_param *pr)
     if (sch->ops->dump && (err = sch->ops->dump(sch, &pr->qopt)) != EDPVS_OK)
         return err;
 
-    /* send msg to workers for per-cpu stats */
-    req = msg_make(MSG_TYPE_TC_STATS, 0, DPVS_MSG_MULTICAST,
-                   rte_lcore_id(), sizeof(struct Qsch *), &sch);
-    if (!req)
-        return EDPVS_NOMEM;
+    /* per-lcore stats are read in place, no need to ask workers */
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        if (!sch->lcore[cid])
+            continue;
 
-    err = multicast_msg_send(req, 0, &replies);
-    if (err != EDPVS_OK) {
-        RTE_LOG(ERR, TC, "%s: send msg: %s\n", __func__, dpvs_strerror(err));
-        msg_destroy(&req);
-        return err;
+        pr->qstats_cpus[cid] = sch->lcore[cid]->qstats;
+        pr->bstats_cpus[cid] = sch->lcore[cid]->bstats;
     }
 
-    /* handle replies */
-    list_for_each_entry(reply, &replies->mq, mq_node) {
-        st = (struct tc_qsch_stats *)reply->data;
-        assert(st && reply->cid < RTE_MAX_LCORE);
-
-        pr->qstats_cpus[reply->cid] = st->qstats;
-        pr->bstats_cpus[reply->cid] = st->bstats;
+    qsch_stats(sch, &pr->qstats, &pr->bstats);
 
-        pr->qstats.qlen         += st->qstats.qlen;
-        pr->qstats.backlog      += st->qstats.backlog;
-        pr->qstats.drops        += st->qstats.drops;
-        pr->qstats.requeues     += st->qstats.requeues;
-        pr->qstats.overlimits   += st->qstats.overlimits;
-
-        pr->bstats.bytes        += st->bstats.bytes;
-        pr->bstats.packets      += st->bstats.packets;
-    }
-
-    msg_destroy(&req);
     return EDPVS_OK;
 }
 
@@ -101,7 +78,7 @@ static int fill_cls_param(struct tc_cls *cls, struct tc_cls_param *pr)
 static int __tc_so_qsch_set(struct netif_tc *tc, tc_oper_t oper,
                             const struct tc_qsch_param *qpar)
 {
-    struct Qsch *sch = NULL;
+    struct Qsch *sch = NULL, *parent;
     tc_handle_t where;
     int err;
 
@@ -115,6 +92,11 @@ static int __tc_so_qsch_set(struct netif_tc *tc, tc_oper_t oper,
         /* egress root is readonly */
         if (sch == tc->qsch)
             return EDPVS_NOTSUPP;
+
+        /* inner queue of tbf etc. can only be replaced by adding another */
+        parent = qsch_lookup_noref(tc, sch->parent);
+        if (oper != SOCKOPT_TC_CHANGE && parent && parent->ops->graft)
+            return EDPVS_NOTSUPP;
     }
 
     switch (oper) {
@@ -403,49 +385,7 @@ static struct dpvs_sockopts tc_sockopts = {
     .get            = tc_sockopt_get,
 };
 
-static int tc_msg_get_stats(struct dpvs_msg *msg)
-{
-    void *ptr;
-    struct Qsch *qsch;
-    struct tc_qsch_stats *st;
-
-    assert(msg && msg->len == sizeof(struct Qsch *));
-
-    ptr = msg->data;
-    qsch = *(struct Qsch **)ptr;
-
-    st = msg_reply_alloc(sizeof(*st));
-    if (!st)
-        return EDPVS_NOMEM;
-
-    st->qstats = qsch->this_qstats;
-    st->bstats = qsch->this_bstats;
-
-    msg->reply.len = sizeof(*st);
-    msg->reply.data = st;
-
-    return EDPVS_OK;
-}
-
-static struct dpvs_msg_type tc_stats_msg = {
-    .type           = MSG_TYPE_TC_STATS,
-    .prio           = MSG_PRIO_LOW,
-    .unicast_msg_cb = tc_msg_get_stats,
-};
-
 int tc_ctrl_init(void)
 {
-    int err;
-
-    err = sockopt_register(&tc_sockopts);
-    if (err != EDPVS_OK)
-        return err;
-
-    err = msg_type_mc_register(&tc_stats_msg);
-    if (err != EDPVS_OK) {
-        sockopt_unregister(&tc_sockopts);
-        return err;
-    }
-
-    return EDPVS_OK;
+    return sockopt_register(&tc_sockopts);
 }
@@ -703,6 +703,46 @@ int dpvs_time_now(struct timeval *now, bool global)
     return EDPVS_OK;
 }
 
+/*
+ * the wheel slot of a timer is found by walking its list to the slot head.
+ * exact for timers in the first wheel, within one turn of it otherwise.
+ */
+int dpvs_timer_remaining(const struct dpvs_timer *timer, bool global,
+                         struct timeval *left)
+{
+    struct timer_scheduler *sched = this_lcore_sched(global);
+    const struct list_head *pos;
+    uint32_t hash, off;
+    dpvs_tick_t ticks;
+    int level;
+
+    if (!sched || !timer || !left)
+        return EDPVS_INVAL;
+
+    timer_sched_lock(sched);
+    if (!timer_pending(timer)) {
+        timer_sched_unlock(sched);
+        return EDPVS_NOTEXIST;
+    }
+
+    for (pos = timer->list.next; ; pos = pos->next) {
+        for (level = 0; level < LEVEL_DEPTH; level++) {
+            if (pos >= sched->hashs[level] &&
+                    pos < sched->hashs[level] + LEVEL_SIZE)
+                goto found;
+        }
+    }
+
+found:
+    hash = pos - sched->hashs[level];
+    off = (hash + LEVEL_SIZE - sched->cursors[level]) % LEVEL_SIZE;
+    ticks = off * get_level_ticks(level) + timer->delay % get_level_ticks(level);
+    timer_sched_unlock(sched);
+
+    ticks_to_timeval(ticks, left);
+    return EDPVS_OK;
+}
+
 void dpvs_time_rand_delay(struct timeval *tv, long delay_us)
 {
     assert(delay_us > 0);
@@ -18,8 +18,8 @@
 /*
  * dpvs VLAN (802.1q) implementation.
  *
- * currently only 802.1q is supported, and may support
- * 802.1ad in the future.
+ * 802.1ad (QinQ) is supported by stacking 802.1q device on
+ * 802.1ad device, just like linux.
  *
  * raychen@qiyi.com, May 2017, initial.
  */
@@ -38,50 +38,132 @@
 
 #define this_vlan_stats(vlan)       ((vlan)->lcore_stats[rte_lcore_id()])
 
+static int vlan_recycle_timeout_us = 100000;
+
 static inline bool vlan_id_valid(__be16 id)
 {
     return ntohs(id) > 0 && ntohs(id) < VLAN_ID_MAX;
 }
 
-static inline int vlan_dev_hash(__be16 proto __rte_unused, __be16 id)
+static inline int vlan_proto_index(__be16 proto)
+{
+    if (likely(proto == htons(ETH_P_8021Q)))
+        return VLAN_PROTO_8021Q;
+    if (proto == htons(ETH_P_8021AD))
+        return VLAN_PROTO_8021AD;
+    return -1;
+}
+
+static inline struct netif_port **vlan_dev_slot(struct vlan_info *vinfo,
+                                                __be16 proto, __be16 id)
 {
-    return ntohs(id) & VLAN_ID_MASK;
+    int idx = vlan_proto_index(proto);
+
+    if (unlikely(idx < 0))
+        return NULL;
+    return &vinfo->vlan_devs[idx][ntohs(id) & VLAN_ID_MASK];
+}
+
+/* lock-free lookup, see vlan_dev_publish() */
+static inline struct netif_port *__vlan_find_dev(const struct netif_port *real_dev,
+                                                 __be16 proto, __be16 id)
+{
+    struct vlan_info *vinfo = *(struct vlan_info * volatile *)&real_dev->vlan_info;
+    struct netif_port **slot;
+
+    if (unlikely(!vinfo))
+        return NULL;
+
+    slot = vlan_dev_slot(vinfo, proto, id);
+    if (unlikely(!slot))
+        return NULL;
+
+    return *(struct netif_port * volatile *)slot;
+}
+
+static inline void vlan_dev_publish(struct netif_port **slot,
+                                    struct netif_port *dev)
+{
+    /* make dev visible after it's initialized */
+    rte_wmb();
+    *(struct netif_port * volatile *)slot = dev;
 }
 
 static int alloc_vlan_info(struct netif_port *dev)
 {
     struct vlan_info *vinfo;
-    int i;
 
     vinfo = rte_zmalloc(NULL, sizeof(*vinfo), 0);
     if (!vinfo)
         return EDPVS_NOMEM;
 
-    vinfo->vlan_dev_hash = rte_zmalloc(NULL,
-                            sizeof(struct hlist_head *) * VLAN_ID_MAX, 0);
-    if (!vinfo->vlan_dev_hash) {
+    vinfo->vlan_devs = rte_zmalloc(NULL,
+                            sizeof(*vinfo->vlan_devs) * VLAN_PROTO_NUM, 0);
+    if (!vinfo->vlan_devs) {
         rte_free(vinfo);
         return EDPVS_NOMEM;
     }
 
-    for (i = 0; i < VLAN_ID_MAX; i++)
-        INIT_HLIST_HEAD(&vinfo->vlan_dev_hash[i]);
-
     vinfo->real_dev = dev;
     rte_rwlock_init(&vinfo->vlan_lock);
     rte_atomic32_set(&vinfo->refcnt, 1);
+
+    rte_wmb();
     dev->vlan_info = vinfo;
 
     return EDPVS_OK;
 }
 
+static void free_vlan_info(struct netif_port *dev)
+{
+    struct vlan_info *vinfo = dev->vlan_info;
+
+    if (!vinfo)
+        return;
+
+    dev->vlan_info = NULL;
+    rte_free(vinfo->vlan_devs);
+    rte_free(vinfo);
+}
+
+static int vlan_recycle(void *arg)
+{
+    struct netif_port *dev = arg;
+    struct vlan_dev_priv *vlan = netif_priv(dev);
+
+    if (!netif_lcores_quiescent(vlan->rc_loops)) {
+        dpvs_timer_reset_nolock(&vlan->rc_timer, true);
+        RTE_LOG(DEBUG, VLAN, "%s: %s is in use.\n", __func__, dev->name);
+        return DTIMER_OK;
+    }
+
+    free_vlan_info(dev);
+    netif_free(dev);
+    return DTIMER_STOP;
+}
+
 static int vlan_xmit(struct rte_mbuf *mbuf, struct netif_port *dev)
 {
     struct vlan_dev_priv *vlan = netif_priv(dev);
-    struct ether_hdr *ethhdr = rte_pktmbuf_mtod(mbuf, struct ether_hdr *);
+    struct ether_hdr *ethhdr;
     unsigned int len;
     int err;
 
+    /**
+     * tag of 802.1q device stacked on us (QinQ) is still in mbuf,
+     * it's the inner one and must be in packet before ours.
+     */
+    if (unlikely(mbuf->ol_flags & PKT_TX_VLAN_PKT)) {
+        err = vlan_insert_tag(mbuf, htons(ETH_P_8021Q),
+                              mbuf_vlan_tag_get_id(mbuf));
+        mbuf->ol_flags &= (~PKT_TX_VLAN_PKT);
+        mbuf->vlan_tci = 0;
+        if (unlikely(err != EDPVS_OK))
+            goto drop;
+    }
+
+    ethhdr = rte_pktmbuf_mtod(mbuf, struct ether_hdr *);
+
     /**
      * store vlan tag and let real device to handle it.
      * that device may support HW vlan offloading.
@@ -93,10 +175,18 @@ static int vlan_xmit(struct rte_mbuf *mbuf, struct netif_port *dev)
      *
      * see validate_xmit_mbuf() for more info.
      * just as linux:validate_xmit_skb().
+     *
+     * HW offloading knows 802.1q only, S-tag is inserted here.
      */
-    if (ethhdr->ether_type != htons(ETH_P_8021Q)) {
-        mbuf->vlan_tci = ntohs(vlan->vlan_id);
-        mbuf->ol_flags |= PKT_TX_VLAN_PKT;
+    if (ethhdr->ether_type != vlan->vlan_proto) {
+        if (likely(vlan->vlan_proto == htons(ETH_P_8021Q))) {
+            mbuf->vlan_tci = ntohs(vlan->vlan_id);
+            mbuf->ol_flags |= PKT_TX_VLAN_PKT;
+        } else {
+            err = vlan_insert_tag(mbuf, vlan->vlan_proto, vlan->vlan_id);
+            if (unlikely(err != EDPVS_OK))
+                goto drop;
+        }
     }
 
     /* hand over it to real device */
@@ -113,6 +203,11 @@ static int vlan_xmit(struct rte_mbuf *mbuf, struct netif_port *dev)
     }
 
     return err;
+
+drop:
+    rte_pktmbuf_free(mbuf);
+    this_vlan_stats(vlan).tx_dropped++;
+    return err;
 }
 
 static int vlan_set_mc_list(struct netif_port *dev)
@@ -209,15 +304,22 @@ int vlan_add_dev(struct netif_port *real_dev, const char *ifname,
 {
     int err;
     struct vlan_info *vinfo;
-    struct hlist_head *head;
+    struct netif_port **slot;
     struct netif_port *dev;
     struct vlan_dev_priv *vlan;
     char name_buf[IFNAMSIZ];
 
-    /* support 802.1q only currently */
-    if (!real_dev || vlan_proto != htons(ETH_P_8021Q) || !vlan_id_valid(vlan_id))
+    if (!real_dev || vlan_proto_index(vlan_proto) < 0 || !vlan_id_valid(vlan_id))
         return EDPVS_INVAL;
 
+    /* only 802.1q stacks, on 802.1ad (QinQ) */
+    if (real_dev->type == PORT_TYPE_VLAN) {
+        vlan = netif_priv(real_dev);
+        if (vlan_proto != htons(ETH_P_8021Q) ||
+            vlan->vlan_proto != htons(ETH_P_8021AD))
+            return EDPVS_NOTSUPP;
+    }
+
     /* alloc vlan_info of real_dev when adding first vlan dev */
     if (!real_dev->vlan_info) {
         if ((err = alloc_vlan_info(real_dev)) != EDPVS_OK)
@@ -225,15 +327,13 @@ int vlan_add_dev(struct netif_port *real_dev, const char *ifname,
     }
     vinfo = real_dev->vlan_info;
 
-    head = &vinfo->vlan_dev_hash[vlan_dev_hash(vlan_proto, vlan_id)];
+    slot = vlan_dev_slot(vinfo, vlan_proto, vlan_id);
     rte_rwlock_write_lock(&vinfo->vlan_lock);
 
     /* already exist ? */
-    hlist_for_each_entry(vlan, head, hlist) {
-        if (vlan->vlan_proto == vlan_proto && vlan->vlan_id == vlan_id) {
-            err = EDPVS_EXIST;
-            goto out;
-        }
+    if (*slot) {
+        err = EDPVS_EXIST;
+        goto out;
     }
 
     if (ifname && strlen(ifname) > 0) {
@@ -258,6 +358,7 @@ int vlan_add_dev(struct netif_port *real_dev, const char *ifname,
     dev->flag &= ~NETIF_PORT_FLAG_TX_TCP_CSUM_OFFLOAD;
     dev->flag &= ~NETIF_PORT_FLAG_TX_UDP_CSUM_OFFLOAD;
     dev->type = PORT_TYPE_VLAN;
+    dev->hw_header_len = real_dev->hw_header_len + VLAN_HLEN;
     ether_addr_copy(&real_dev->addr, &dev->addr);
 
     vlan = netif_priv(dev);
@@ -280,7 +381,7 @@ int vlan_add_dev(struct netif_port *real_dev, const char *ifname,
         goto out;
     }
 
-    hlist_add_head(&vlan->hlist, head);
+    vlan_dev_publish(slot, dev);
     rte_atomic32_inc(&vinfo->refcnt);
     vinfo->vlan_dev_num++;
     err = EDPVS_OK;
@@ -293,46 +394,51 @@ out:
 int vlan_del_dev(struct netif_port *real_dev, __be16 vlan_proto,
                  __be16 vlan_id)
 {
+    struct timeval timeout = { 0, vlan_recycle_timeout_us };
     struct vlan_info *vinfo;
-    struct hlist_head *head;
-    struct netif_port *dev = NULL;
+    struct netif_port **slot;
+    struct netif_port *dev;
     struct vlan_dev_priv *vlan;
     int err;
 
-    if (!real_dev || !vlan_id_valid(vlan_id))
+    if (!real_dev || vlan_proto_index(vlan_proto) < 0 || !vlan_id_valid(vlan_id))
         return EDPVS_INVAL;
 
     vinfo = real_dev->vlan_info;
     if (!vinfo)
         return EDPVS_NOTEXIST;
 
-    head = &vinfo->vlan_dev_hash[vlan_dev_hash(vlan_proto, vlan_id)];
+    slot = vlan_dev_slot(vinfo, vlan_proto, vlan_id);
     rte_rwlock_write_lock(&vinfo->vlan_lock);
 
-    hlist_for_each_entry(vlan, head, hlist) {
-        if (vlan->vlan_proto == vlan_proto && vlan->vlan_id == vlan_id) {
-            dev = vlan->dev;
-            break;
-        }
-    }
-
+    dev = *slot;
     if (!dev) {
         rte_rwlock_write_unlock(&vinfo->vlan_lock);
         return EDPVS_NOTEXIST;
     }
 
+    /* QinQ: 802.1q devices on it should be deleted first */
+    if (dev->vlan_info && dev->vlan_info->vlan_dev_num > 0) {
+        rte_rwlock_write_unlock(&vinfo->vlan_lock);
+        return EDPVS_BUSY;
+    }
+
     err = kni_del_dev(dev);
     if (err != EDPVS_OK) {
         RTE_LOG(WARNING, VLAN, "%s: fail to del kni device: %s\n",
                 __func__, dpvs_strerror(err));
     }
 
-    hlist_del(&vlan->hlist);
+    vlan_dev_publish(slot, NULL);
     vinfo->vlan_dev_num--;
     rte_rwlock_write_unlock(&vinfo->vlan_lock);
 
     netif_port_unregister(dev);
-    netif_free(dev);
+
+    /* data plane may still hold it, free after a grace period */
+    vlan = netif_priv(dev);
+    netif_lcore_loops_save(vlan->rc_loops);
+    dpvs_timer_sched(&vlan->rc_timer, &timeout, vlan_recycle, dev, true);
 
     /* just leave it for later use even no more reference. */
     rte_atomic32_dec(&vinfo->refcnt);
@@ -342,29 +448,10 @@ int vlan_del_dev(struct netif_port *real_dev, __be16 vlan_proto,
 struct netif_port *vlan_find_dev(const struct netif_port *real_dev,
                                 __be16 vlan_proto, __be16 vlan_id)
 {
-    struct vlan_info *vinfo;
-    struct hlist_head *head;
-    struct vlan_dev_priv *vlan;
-
     if (!real_dev || !vlan_id_valid(vlan_id))
         return NULL;
 
-    vinfo = real_dev->vlan_info;
-    if (!vinfo)
-        return NULL;
-
-    head = &vinfo->vlan_dev_hash[vlan_dev_hash(vlan_proto, vlan_id)];
-    rte_rwlock_read_lock(&vinfo->vlan_lock);
-
-    hlist_for_each_entry(vlan, head, hlist) {
-        if (vlan->vlan_proto == vlan_proto && vlan->vlan_id == vlan_id) {
-            rte_rwlock_read_unlock(&vinfo->vlan_lock);
-            return vlan->dev;
-        }
-    }
-
-    rte_rwlock_read_unlock(&vinfo->vlan_lock);
-    return NULL;
+    return __vlan_find_dev(real_dev, vlan_proto, vlan_id);
 }
 
 /**
@@ -374,29 +461,41 @@ struct netif_port *vlan_find_dev(const struct netif_port *real_dev,
  * because netif_deliver_mbuf() remember the m.data_off and
  * restore it if mbuf should be deliver to KNI device.
  * if vlan tag stripped the m.data_off remembered will be wrong.
+ *
+ * return vlan device of the outer tag, which is stripped only if
+ * the device exists, no memmove for packets to be dropped.
  */
-static inline int vlan_untag_mbuf(struct rte_mbuf *mbuf)
+static inline struct netif_port *vlan_untag_mbuf(struct rte_mbuf *mbuf,
+                                                 const struct netif_port *real_dev)
 {
     struct vlan_ethhdr *vehdr = NULL;
+    struct netif_port *dev;
 
     /* VLAN RX offloaded (vlan stripped by HW) ? */
-    if (mbuf->ol_flags & PKT_RX_VLAN_STRIPPED)
-        return EDPVS_OK;
+    if (mbuf->ol_flags & PKT_RX_VLAN_STRIPPED) {
+        mbuf->ol_flags &= (~PKT_RX_VLAN_STRIPPED);
+        return __vlan_find_dev(real_dev, htons(ETH_P_8021Q),
+                               mbuf_vlan_tag_get_id(mbuf));
+    }
 
     if (unlikely(mbuf_may_pull(mbuf, sizeof(struct ether_hdr) + \
                                      sizeof(struct vlan_hdr)) != 0))
-        return EDPVS_INVPKT;
+        return NULL;
 
     /* the data_off of mbuf is still at ethernet header. */
     vehdr = rte_pktmbuf_mtod(mbuf, struct vlan_ethhdr *);
 
-    mbuf->ol_flags |= PKT_RX_VLAN_STRIPPED; /* "borrow" it */
+    dev = __vlan_find_dev(real_dev, vehdr->h_vlan_proto,
+                          vehdr->h_vlan_TCI & htons(VLAN_ID_MASK));
+    if (!dev)
+        return NULL;
+
     mbuf->vlan_tci = ntohs(vehdr->h_vlan_TCI);
 
     /* strip the vlan header */
     memmove((void *)vehdr + VLAN_HLEN, vehdr, 2 * ETH_ALEN);
     rte_pktmbuf_adj(mbuf, VLAN_HLEN);
-    return EDPVS_OK;
+    return dev;
 }
 
 /*
@@ -409,17 +508,22 @@ int vlan_rcv(struct rte_mbuf *mbuf, struct netif_port *real_dev)
 {
     struct netif_port *dev;
     struct vlan_dev_priv *vlan;
-    struct ether_hdr *ehdr = rte_pktmbuf_mtod(mbuf, struct ether_hdr *);
-    int err;
+    struct ether_hdr *ehdr;
 
-    err = vlan_untag_mbuf(mbuf);
-    if (unlikely(err != EDPVS_OK))
-        return err;
+    /* QinQ: C-tag is looked up on device of S-tag */
+    do {
+        dev = vlan_untag_mbuf(mbuf, real_dev);
+        if (!dev)
+            return EDPVS_NODEV;
 
-    dev = vlan_find_dev(real_dev, htons(ETH_P_8021Q),
-                        mbuf_vlan_tag_get_id(mbuf));
-    if (!dev)
-        return EDPVS_NODEV;
+        vlan = netif_priv(dev);
+        this_vlan_stats(vlan).rx_packets++;
+        this_vlan_stats(vlan).rx_bytes += mbuf->pkt_len;
+
+        real_dev = dev;
+        ehdr = rte_pktmbuf_mtod(mbuf, struct ether_hdr *);
+    } while (unlikely(vlan->vlan_proto == htons(ETH_P_8021AD)) &&
+             ehdr->ether_type == htons(ETH_P_8021Q));
 
     mbuf->port = dev->id;
     if (unlikely(mbuf->packet_type == ETH_PKT_OTHERHOST)) {
@@ -431,13 +535,8 @@ int vlan_rcv(struct rte_mbuf *mbuf, struct netif_port *real_dev)
             mbuf->packet_type = ETH_PKT_HOST;
     }
 
-    mbuf->ol_flags &= (~PKT_RX_VLAN_STRIPPED);
     mbuf->vlan_tci = 0;
 
-    /* statistics */
-    vlan = netif_priv(dev);
-    this_vlan_stats(vlan).rx_packets++;
-    this_vlan_stats(vlan).rx_bytes += mbuf->pkt_len;
     if (mbuf->packet_type == ETH_PKT_MULTICAST)
         this_vlan_stats(vlan).rx_multicast++;
 
@@ -468,8 +567,9 @@ static int vlan_sockopt_set(sockoptid_t opt, const void *conf, size_t size)
             return EDPVS_NODEV;
         }
 
-        if (param->vlan_proto != ETH_P_8021Q) {
-            RTE_LOG(WARNING, VLAN, "%s: support 802.1q only\n", __func__);
+        if (vlan_proto_index(htons(param->vlan_proto)) < 0) {
+            RTE_LOG(WARNING, VLAN, "%s: support 802.1q/802.1ad only\n",
+                    __func__);
             return EDPVS_INVAL;
         }
 
@@ -519,7 +619,7 @@ static int vlan_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
     struct netif_port *real_dev, *dev;
     struct vlan_info *vinfo;
     struct vlan_dev_priv *vlan;
-    int i;
+    int p, i;
 
     if (!conf || size < sizeof(*param) || !out || !outsize)
         return EDPVS_INVAL;
@@ -582,13 +682,18 @@ static int vlan_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
         return EDPVS_NOMEM;
     }
 
-    for (i = 0; i < VLAN_ID_MAX; i++) {
-        hlist_for_each_entry(vlan, &vinfo->vlan_dev_hash[i], hlist) {
+    for (p = 0; p < VLAN_PROTO_NUM; p++) {
+        for (i = 0; i < VLAN_ID_MAX; i++) {
             struct vlan_param *outparam;
 
+            dev = vinfo->vlan_devs[p][i];
+            if (!dev)
+                continue;
+
             if (array->nparam >= vinfo->vlan_dev_num)
                 goto end;
 
+            vlan = netif_priv(dev);
             outparam = &array->params[array->nparam];
 
             if (param->vlan_proto &&
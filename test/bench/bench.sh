@@ -0,0 +1,270 @@
+#!/bin/bash
+#
+# DPVS is a software load balancer (Virtual Server) based on DPDK.
+#
+# Copyright (C) 2017 iQIYI (www.iqiyi.com).
+# All Rights Reserved.
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+
+#
+# offline benchmark: replay a pcap through dpvs on a net_pcap vdev for a
+# set of forwarding scenarios, and print per-stage cycles per packet as
+# "key=value" lines. dpvs must be built with CONFIG_DPVS_BENCH.
+#
+# see test/bench/README.md.
+#
+
+BENCH_DIR=$(cd $(dirname $0) && pwd)
+BIN_DIR=$BENCH_DIR/../../bin
+PCAP=
+RESULT=bench.result
+SCENARIOS="fnat fnat-synproxy dr nat snat"
+EAL_ARGS="-l 0-1 -n 4 --no-pci"
+NPKTS=1000000
+MIX="syn=20,tcp=50,udp=20,frag=10"
+TIMEOUT=300
+
+DPVS_CONF=/etc/dpvs.conf
+DPVS_PID=
+
+# addresses, clients are 10.0.0.0/16 as pcap_gen does
+VIP=192.168.100.100
+HOST_IP=192.168.100.1
+LIP=192.168.100.200
+RS_LIST=('192.168.100.2' '192.168.100.3')
+RS_MAC_LIST=('00:00:00:00:01:02' '00:00:00:00:01:03')
+PORT_MAC=00:00:00:00:00:01
+GW_IP=192.168.100.254
+GW_MAC=00:00:00:00:01:fe
+SRC_RANGE='10.0.0.1-10.0.255.254'
+
+usage() {
+    echo "Usage: $0 [-b BIN_DIR] [-p PCAP] [-s \"SCENARIOS\"] [-o RESULT]"
+    echo "          [-n NPKTS] [-m MIX] [-e \"EAL_ARGS\"]"
+    echo "    -b BIN_DIR     where dpvs, dpip, ipvsadm are ($BIN_DIR)"
+    echo "    -p PCAP        pcap to replay, generated by pcap_gen if not set"
+    echo "    -s SCENARIOS   subset of \"$SCENARIOS\""
+    echo "    -o RESULT      result file ($RESULT)"
+    echo "    -n NPKTS       packets to generate ($NPKTS)"
+    echo "    -m MIX         traffic mix to generate ($MIX)"
+    echo "    -e EAL_ARGS    extra EAL arguments ($EAL_ARGS)"
+    exit 1
+}
+
+while getopts "b:p:s:o:n:m:e:h" arg; do
+    case $arg in
+    b) BIN_DIR=$OPTARG ;;
+    p) PCAP=$OPTARG ;;
+    s) SCENARIOS=$OPTARG ;;
+    o) RESULT=$OPTARG ;;
+    n) NPKTS=$OPTARG ;;
+    m) MIX=$OPTARG ;;
+    e) EAL_ARGS=$OPTARG ;;
+    *) usage ;;
+    esac
+done
+
+DPVS="$BIN_DIR/dpvs"
+DPIP="$BIN_DIR/dpip"
+IPVSADM="$BIN_DIR/ipvsadm"
+
+for b in $DPVS $DPIP $IPVSADM; do
+    if [ ! -x $b ]; then
+        echo "$b not found" >&2
+        exit 1
+    fi
+done
+
+run() {
+    $@ > /dev/null 2>&1 || echo "WARN: failed: $@" >&2
+}
+
+gen_pcap() {
+    PCAP=/tmp/dpvs_bench.$$.pcap
+    gcc -O2 -o /tmp/dpvs_pcap_gen.$$ $BENCH_DIR/pcap_gen.c || exit 1
+    /tmp/dpvs_pcap_gen.$$ -o $PCAP -n $NPKTS -m $MIX -v $VIP -d $PORT_MAC >&2 || exit 1
+    rm -f /tmp/dpvs_pcap_gen.$$
+}
+
+dpvs_start() {
+    $DPVS -- $EAL_ARGS \
+        --vdev "net_pcap0,rx_pcap=$PCAP,tx_pcap=/dev/null" \
+        > /tmp/dpvs_bench.$1.log 2>&1 &
+    DPVS_PID=$!
+
+    # wait for control plane
+    for i in $(seq 1 60); do
+        if $DPIP bench show > /dev/null 2>&1; then
+            return 0
+        fi
+        if ! kill -0 $DPVS_PID 2> /dev/null; then
+            break
+        fi
+        sleep 1
+    done
+
+    echo "dpvs fail to start, see /tmp/dpvs_bench.$1.log" >&2
+    dpvs_stop
+    return 1
+}
+
+dpvs_stop() {
+    [ -z "$DPVS_PID" ] && return
+    kill -9 $DPVS_PID 2> /dev/null
+    wait $DPVS_PID 2> /dev/null
+    DPVS_PID=
+}
+
+# base network, neighbours are static since nobody replies in pcap mode
+setup_net() {
+    run $DPIP addr add $HOST_IP/24 dev dpdk0
+    for i in ${!RS_LIST[@]}; do
+        run $DPIP neigh add ${RS_LIST[$i]} lladdr ${RS_MAC_LIST[$i]} dev dpdk0
+    done
+    run $DPIP neigh add $GW_IP lladdr $GW_MAC dev dpdk0
+    run $DPIP route add 10.0.0.0/16 via $GW_IP dev dpdk0
+}
+
+# $1: forwarding option of ipvsadm, $2: synproxy
+setup_lb() {
+    local fwd=$1 synproxy=$2
+
+    run $DPIP addr add $VIP/32 dev dpdk0
+    run $IPVSADM -A -t $VIP:80 -s rr $synproxy
+    run $IPVSADM -A -u $VIP:80 -s rr
+    for rs in ${RS_LIST[@]}; do
+        run $IPVSADM -a -t $VIP:80 -r $rs:80 $fwd
+        run $IPVSADM -a -u $VIP:80 -r $rs:80 $fwd
+    done
+
+    if [ "$fwd" == "-b" ]; then
+        run $DPIP addr add $LIP/32 dev dpdk0 sapool
+        run $IPVSADM -P -t $VIP:80 -z $LIP -F dpdk0
+        run $IPVSADM -P -u $VIP:80 -z $LIP -F dpdk0
+    fi
+}
+
+setup_snat() {
+    local m
+
+    # VIP acts as an internet host, reached by the default route
+    run $DPIP addr add $LIP/24 dev dpdk0 sapool
+    run $DPIP neigh add $VIP lladdr $GW_MAC dev dpdk0
+    run $DPIP route add default via $GW_IP dev dpdk0
+    for p in tcp udp; do
+        m="proto=$p,src-range=$SRC_RANGE,oif=dpdk0"
+        run $IPVSADM -A -s rr -H $m
+        run $IPVSADM -a -H $m -r $LIP:0 -w 100 -J
+    done
+}
+
+setup_scenario() {
+    setup_net
+
+    case $1 in
+    fnat)           setup_lb -b "" ;;
+    fnat-synproxy)  setup_lb -b "-j enable" ;;
+    dr)             setup_lb -g "" ;;
+    nat)            setup_lb -m "" ;;
+    snat)           setup_snat ;;
+    *)
+        echo "unknown scenario $1" >&2
+        return 1
+        ;;
+    esac
+}
+
+rx_pkts() {
+    $DPIP bench show 2> /dev/null | awk '/lcore=all stage=rx / {
+        for (i = 1; i <= NF; i++)
+            if ($i ~ /^pkts=/) { sub("pkts=", "", $i); print $i }
+    }'
+}
+
+# replay is done when rx counter stops increasing
+wait_replay() {
+    local last=-1 cur stable=0 elapsed=0
+
+    while [ $elapsed -lt $TIMEOUT ]; do
+        sleep 1
+        elapsed=$((elapsed + 1))
+        cur=$(rx_pkts)
+        cur=${cur:-0}
+        if [ "$cur" == "$last" ] && [ $cur -gt 0 ]; then
+            stable=$((stable + 1))
+            [ $stable -ge 2 ] && return 0
+        else
+            stable=0
+        fi
+        last=$cur
+    done
+
+    echo "replay timeout" >&2
+    return 1
+}
+
+run_scenario() {
+    local s=$1
+
+    dpvs_start $s || return 1
+
+    if ! $DPIP bench show | grep -q "enabled=1"; then
+        echo "dpvs is not built with CONFIG_DPVS_BENCH" >&2
+        dpvs_stop
+        return 1
+    fi
+
+    setup_scenario $s || { dpvs_stop; return 1; }
+
+    run $DPIP bench flush
+    run $DPIP bench set rx on
+    wait_replay
+
+    $DPIP bench show | sed "s/^/scenario=$s /" | tee -a $RESULT
+
+    dpvs_stop
+}
+
+##### main #####
+if [ -z "$PCAP" ]; then
+    gen_pcap
+    GEN_PCAP=1
+fi
+
+# restore user's config however we leave
+cleanup() {
+    dpvs_stop
+    if [ -f $DPVS_CONF.bench-save ]; then
+        mv -f $DPVS_CONF.bench-save $DPVS_CONF
+    else
+        rm -f $DPVS_CONF
+    fi
+    [ -n "$GEN_PCAP" ] && rm -f $PCAP
+}
+
+if [ -f $DPVS_CONF ]; then
+    cp -f $DPVS_CONF $DPVS_CONF.bench-save || exit 1
+fi
+
+trap cleanup EXIT
+trap 'exit 1' INT TERM
+
+cp -f $BENCH_DIR/dpvs.bench.conf $DPVS_CONF || exit 1
+
+> $RESULT
+for s in $SCENARIOS; do
+    echo "##### $s #####" >&2
+    run_scenario $s
+done
+
+exit 0
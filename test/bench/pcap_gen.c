@@ -0,0 +1,520 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * generate a pcap file of synthetic client-to-VIP traffic for the
+ * offline benchmark, no libpcap needed.
+ *
+ *   gcc -O2 -o pcap_gen pcap_gen.c
+ *   ./pcap_gen -o mix.pcap -n 1000000 -m syn=20,tcp=50,udp=20,frag=10
+ *
+ * traffic classes:
+ *   syn   - SYN from random clients, each one creates a new connection.
+ *   tcp   - packets of a fixed set of established-looking flows, the
+ *           first packet of each flow is a SYN, later ones are ACK/data.
+ *   udp   - datagrams of a fixed set of flows.
+ *   frag  - UDP datagrams split into two IPv4 fragments.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#define PCAP_MAGIC          0xa1b2c3d4
+#define PCAP_LINKTYPE_ETH   1
+#define SNAPLEN             65535
+#define MAX_FRAME           2048
+
+#define TCP_FIN             0x01
+#define TCP_SYN             0x02
+#define TCP_PSH             0x08
+#define TCP_ACK             0x10
+
+enum {
+    CLS_SYN = 0,
+    CLS_TCP,
+    CLS_UDP,
+    CLS_FRAG,
+    CLS_MAX,
+};
+
+static const char *cls_names[CLS_MAX] = {
+    [CLS_SYN]   = "syn",
+    [CLS_TCP]   = "tcp",
+    [CLS_UDP]   = "udp",
+    [CLS_FRAG]  = "frag",
+};
+
+struct pcap_file_hdr {
+    uint32_t    magic;
+    uint16_t    ver_major;
+    uint16_t    ver_minor;
+    int32_t     thiszone;
+    uint32_t    sigfigs;
+    uint32_t    snaplen;
+    uint32_t    linktype;
+};
+
+struct pcap_rec_hdr {
+    uint32_t    ts_sec;
+    uint32_t    ts_usec;
+    uint32_t    caplen;
+    uint32_t    len;
+};
+
+struct flow {
+    uint32_t    saddr;
+    uint16_t    sport;
+    uint32_t    seq;
+    int         started;
+};
+
+static struct {
+    const char  *output;
+    long        npkts;
+    int         mix[CLS_MAX];
+    uint32_t    vip;
+    uint16_t    tcp_vport;
+    uint16_t    udp_vport;
+    uint32_t    client_net;
+    int         client_bits;
+    int         nflows;
+    int         payload;
+    uint8_t     dmac[6];
+    uint8_t     smac[6];
+    unsigned    seed;
+} cfg = {
+    .output     = "mix.pcap",
+    .npkts      = 1000000,
+    .mix        = { 20, 50, 20, 10 },
+    .tcp_vport  = 80,
+    .udp_vport  = 80,
+    .client_bits = 16,
+    .nflows     = 10000,
+    .payload    = 64,
+    .dmac       = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 },
+    .smac       = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x02 },
+    .seed       = 1,
+};
+
+static uint16_t ip_id;
+static uint32_t ts_sec, ts_usec;
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [OPTIONS]\n"
+            "    -o FILE         output pcap (mix.pcap)\n"
+            "    -n NUM          number of packets (1000000)\n"
+            "    -m MIX          percentage of classes, "
+                                "syn=20,tcp=50,udp=20,frag=10\n"
+            "    -v VIP          IPv4 VIP (192.168.100.100)\n"
+            "    -t PORT         TCP vport (80)\n"
+            "    -u PORT         UDP vport (80)\n"
+            "    -c NET/BITS     client network (10.0.0.0/16)\n"
+            "    -f NUM          established TCP/UDP flows (10000)\n"
+            "    -p LEN          L4 payload length (64)\n"
+            "    -d MAC          destination MAC, i.e., the dpdk port\n"
+            "    -s SEED         random seed (1)\n",
+            prog);
+}
+
+static int parse_mac(const char *str, uint8_t *mac)
+{
+    unsigned int m[6];
+    int i;
+
+    if (sscanf(str, "%x:%x:%x:%x:%x:%x",
+               &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) != 6)
+        return -1;
+
+    for (i = 0; i < 6; i++)
+        mac[i] = m[i];
+    return 0;
+}
+
+static int parse_mix(char *str)
+{
+    char *tok, *val;
+    int i, sum = 0;
+
+    memset(cfg.mix, 0, sizeof(cfg.mix));
+
+    for (tok = strtok(str, ","); tok; tok = strtok(NULL, ",")) {
+        val = strchr(tok, '=');
+        if (!val)
+            return -1;
+        *val++ = '\0';
+
+        for (i = 0; i < CLS_MAX; i++) {
+            if (strcmp(tok, cls_names[i]) == 0)
+                break;
+        }
+        if (i == CLS_MAX)
+            return -1;
+
+        cfg.mix[i] = atoi(val);
+        sum += cfg.mix[i];
+    }
+
+    return sum > 0 ? 0 : -1;
+}
+
+static uint16_t csum_fold(uint32_t sum)
+{
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+static uint32_t csum_add(uint32_t sum, const void *data, int len)
+{
+    const uint8_t *p = data;
+
+    while (len > 1) {
+        sum += (p[0] << 8) | p[1];
+        p += 2;
+        len -= 2;
+    }
+    if (len)
+        sum += p[0] << 8;
+
+    return sum;
+}
+
+/* returns frame length, L4 header+payload at @l4 of length @l4len */
+static int build_ipv4(uint8_t *frame, uint32_t saddr, uint32_t daddr,
+                      uint8_t proto, int l4len, uint16_t frag_off,
+                      uint16_t id)
+{
+    uint8_t *iph = frame + 14;
+    uint16_t tot = 20 + l4len;
+    uint16_t sum;
+
+    memcpy(frame, cfg.dmac, 6);
+    memcpy(frame + 6, cfg.smac, 6);
+    frame[12] = 0x08;
+    frame[13] = 0x00;
+
+    iph[0] = 0x45;
+    iph[1] = 0;
+    *(uint16_t *)(iph + 2) = htons(tot);
+    *(uint16_t *)(iph + 4) = htons(id);
+    *(uint16_t *)(iph + 6) = htons(frag_off);
+    iph[8] = 64;
+    iph[9] = proto;
+    *(uint16_t *)(iph + 10) = 0;
+    *(uint32_t *)(iph + 12) = saddr;
+    *(uint32_t *)(iph + 16) = daddr;
+
+    sum = csum_fold(csum_add(0, iph, 20));
+    *(uint16_t *)(iph + 10) = htons(sum);
+
+    return 14 + tot;
+}
+
+static uint16_t l4_csum(uint32_t saddr, uint32_t daddr, uint8_t proto,
+                        const uint8_t *l4, int len)
+{
+    uint8_t pseudo[12];
+
+    memcpy(pseudo, &saddr, 4);
+    memcpy(pseudo + 4, &daddr, 4);
+    pseudo[8] = 0;
+    pseudo[9] = proto;
+    *(uint16_t *)(pseudo + 10) = htons(len);
+
+    return csum_fold(csum_add(csum_add(0, pseudo, 12), l4, len));
+}
+
+static int build_tcp(uint8_t *frame, uint32_t saddr, uint16_t sport,
+                     uint32_t seq, uint8_t flags, int paylen)
+{
+    uint8_t *th = frame + 14 + 20;
+    int len = 20 + paylen;
+    uint16_t sum;
+
+    *(uint16_t *)(th + 0) = htons(sport);
+    *(uint16_t *)(th + 2) = htons(cfg.tcp_vport);
+    *(uint32_t *)(th + 4) = htonl(seq);
+    *(uint32_t *)(th + 8) = htonl(flags & TCP_ACK ? 1 : 0);
+    th[12] = 5 << 4;
+    th[13] = flags;
+    *(uint16_t *)(th + 14) = htons(65535);
+    *(uint16_t *)(th + 16) = 0;
+    *(uint16_t *)(th + 18) = 0;
+    memset(th + 20, 'x', paylen);
+
+    sum = l4_csum(saddr, cfg.vip, IPPROTO_TCP, th, len);
+    *(uint16_t *)(th + 16) = htons(sum);
+
+    return build_ipv4(frame, saddr, cfg.vip, IPPROTO_TCP, len, 0, ip_id++);
+}
+
+static int build_udp(uint8_t *frame, uint32_t saddr, uint16_t sport,
+                     int paylen)
+{
+    uint8_t *uh = frame + 14 + 20;
+    int len = 8 + paylen;
+    uint16_t sum;
+
+    *(uint16_t *)(uh + 0) = htons(sport);
+    *(uint16_t *)(uh + 2) = htons(cfg.udp_vport);
+    *(uint16_t *)(uh + 4) = htons(len);
+    *(uint16_t *)(uh + 6) = 0;
+    memset(uh + 8, 'u', paylen);
+
+    sum = l4_csum(saddr, cfg.vip, IPPROTO_UDP, uh, len);
+    *(uint16_t *)(uh + 6) = htons(sum ? sum : 0xffff);
+
+    return build_ipv4(frame, saddr, cfg.vip, IPPROTO_UDP, len, 0, ip_id++);
+}
+
+static void write_frame(FILE *fp, const uint8_t *frame, int len)
+{
+    struct pcap_rec_hdr rh = {
+        .ts_sec     = ts_sec,
+        .ts_usec    = ts_usec,
+        .caplen     = len,
+        .len        = len,
+    };
+
+    if (++ts_usec >= 1000000) {
+        ts_usec = 0;
+        ts_sec++;
+    }
+
+    fwrite(&rh, sizeof(rh), 1, fp);
+    fwrite(frame, len, 1, fp);
+}
+
+static uint32_t rand_client(void)
+{
+    uint32_t host = (uint32_t)random() & ((1u << (32 - cfg.client_bits)) - 1);
+
+    if (!host)
+        host = 1;
+    return htonl(ntohl(cfg.client_net) | host);
+}
+
+static uint16_t rand_port(void)
+{
+    return 1024 + random() % (65536 - 1024);
+}
+
+/* a UDP datagram as two fragments, returns number of frames written */
+static int write_frags(FILE *fp, uint8_t *frame, uint32_t saddr, uint16_t sport)
+{
+    uint8_t datagram[MAX_FRAME];
+    int paylen = cfg.payload * 2 + 16;
+    int len = 8 + paylen;
+    int first = (len / 2) & ~7;     /* fragment offset unit is 8 bytes */
+    uint16_t id = ip_id++;
+    uint16_t sum;
+
+    *(uint16_t *)(datagram + 0) = htons(sport);
+    *(uint16_t *)(datagram + 2) = htons(cfg.udp_vport);
+    *(uint16_t *)(datagram + 4) = htons(len);
+    *(uint16_t *)(datagram + 6) = 0;
+    memset(datagram + 8, 'f', paylen);
+    sum = l4_csum(saddr, cfg.vip, IPPROTO_UDP, datagram, len);
+    *(uint16_t *)(datagram + 6) = htons(sum ? sum : 0xffff);
+
+    memcpy(frame + 14 + 20, datagram, first);
+    write_frame(fp, frame, build_ipv4(frame, saddr, cfg.vip, IPPROTO_UDP,
+                                      first, 0x2000 /* MF */, id));
+
+    memcpy(frame + 14 + 20, datagram + first, len - first);
+    write_frame(fp, frame, build_ipv4(frame, saddr, cfg.vip, IPPROTO_UDP,
+                                      len - first, first / 8, id));
+    return 2;
+}
+
+int main(int argc, char *argv[])
+{
+    struct pcap_file_hdr fh = {
+        .magic      = PCAP_MAGIC,
+        .ver_major  = 2,
+        .ver_minor  = 4,
+        .snaplen    = SNAPLEN,
+        .linktype   = PCAP_LINKTYPE_ETH,
+    };
+    uint8_t frame[MAX_FRAME];
+    long count[CLS_MAX] = { 0 };
+    struct flow *tcp_flows, *udp_flows, *f;
+    char net[64], *slash;
+    int opt, i, cls, sum = 0, r;
+    long n = 0;
+    FILE *fp;
+
+    inet_pton(AF_INET, "192.168.100.100", &cfg.vip);
+    inet_pton(AF_INET, "10.0.0.0", &cfg.client_net);
+
+    while ((opt = getopt(argc, argv, "o:n:m:v:t:u:c:f:p:d:s:h")) != -1) {
+        switch (opt) {
+        case 'o':
+            cfg.output = optarg;
+            break;
+        case 'n':
+            cfg.npkts = atol(optarg);
+            break;
+        case 'm':
+            if (parse_mix(optarg) != 0) {
+                fprintf(stderr, "invalid mix\n");
+                return 1;
+            }
+            break;
+        case 'v':
+            if (inet_pton(AF_INET, optarg, &cfg.vip) != 1) {
+                fprintf(stderr, "invalid VIP\n");
+                return 1;
+            }
+            break;
+        case 't':
+            cfg.tcp_vport = atoi(optarg);
+            break;
+        case 'u':
+            cfg.udp_vport = atoi(optarg);
+            break;
+        case 'c':
+            snprintf(net, sizeof(net), "%s", optarg);
+            slash = strchr(net, '/');
+            if (slash) {
+                *slash++ = '\0';
+                cfg.client_bits = atoi(slash);
+            }
+            if (inet_pton(AF_INET, net, &cfg.client_net) != 1 ||
+                cfg.client_bits < 8 || cfg.client_bits > 30) {
+                fprintf(stderr, "invalid client network\n");
+                return 1;
+            }
+            break;
+        case 'f':
+            cfg.nflows = atoi(optarg);
+            break;
+        case 'p':
+            cfg.payload = atoi(optarg);
+            if (cfg.payload < 0 || cfg.payload > 600) {
+                fprintf(stderr, "payload out of range 0-600\n");
+                return 1;
+            }
+            break;
+        case 'd':
+            if (parse_mac(optarg, cfg.dmac) != 0) {
+                fprintf(stderr, "invalid MAC\n");
+                return 1;
+            }
+            break;
+        case 's':
+            cfg.seed = strtoul(optarg, NULL, 10);
+            break;
+        case 'h':
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (cfg.npkts <= 0 || cfg.nflows <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    srandom(cfg.seed);
+
+    tcp_flows = calloc(cfg.nflows, sizeof(struct flow));
+    udp_flows = calloc(cfg.nflows, sizeof(struct flow));
+    if (!tcp_flows || !udp_flows) {
+        fprintf(stderr, "no memory\n");
+        return 1;
+    }
+
+    for (i = 0; i < cfg.nflows; i++) {
+        tcp_flows[i].saddr = rand_client();
+        tcp_flows[i].sport = rand_port();
+        tcp_flows[i].seq = random();
+        udp_flows[i].saddr = rand_client();
+        udp_flows[i].sport = rand_port();
+    }
+
+    fp = fopen(cfg.output, "wb");
+    if (!fp) {
+        perror(cfg.output);
+        return 1;
+    }
+    fwrite(&fh, sizeof(fh), 1, fp);
+
+    for (i = 0; i < CLS_MAX; i++)
+        sum += cfg.mix[i];
+
+    while (n < cfg.npkts) {
+        r = random() % sum;
+        for (cls = 0; cls < CLS_MAX - 1; cls++) {
+            if (r < cfg.mix[cls])
+                break;
+            r -= cfg.mix[cls];
+        }
+
+        switch (cls) {
+        case CLS_SYN:
+            write_frame(fp, frame, build_tcp(frame, rand_client(), rand_port(),
+                                             random(), TCP_SYN, 0));
+            n++;
+            break;
+        case CLS_TCP:
+            f = &tcp_flows[random() % cfg.nflows];
+            if (!f->started) {
+                write_frame(fp, frame, build_tcp(frame, f->saddr, f->sport,
+                                                 f->seq++, TCP_SYN, 0));
+                f->started = 1;
+            } else {
+                write_frame(fp, frame, build_tcp(frame, f->saddr, f->sport,
+                                                 f->seq, TCP_ACK | TCP_PSH,
+                                                 cfg.payload));
+                f->seq += cfg.payload;
+            }
+            n++;
+            break;
+        case CLS_UDP:
+            f = &udp_flows[random() % cfg.nflows];
+            write_frame(fp, frame, build_udp(frame, f->saddr, f->sport,
+                                             cfg.payload));
+            n++;
+            break;
+        case CLS_FRAG:
+            f = &udp_flows[random() % cfg.nflows];
+            n += write_frags(fp, frame, f->saddr, f->sport);
+            break;
+        }
+        count[cls]++;
+    }
+
+    fclose(fp);
+    free(tcp_flows);
+    free(udp_flows);
+
+    printf("file=%s pkts=%ld", cfg.output, n);
+    for (i = 0; i < CLS_MAX; i++)
+        printf(" %s=%ld", cls_names[i], count[i]);
+    printf("\n");
+
+    return 0;
+}
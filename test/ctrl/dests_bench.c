@@ -0,0 +1,185 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * control plane benchmark: add and remove N real servers of a service
+ * one request per dest, then in batch requests, and print the time.
+ *
+ *   LIBIPVS=../../tools/keepalived/keepalived/libipvs-2.6
+ *   gcc -O2 -I ../../include -I $LIBIPVS -o dests_bench dests_bench.c \
+ *       $LIBIPVS/libipvs.c $LIBIPVS/sockopt.c $LIBIPVS/ip_vs_nl_policy.c \
+ *       ../../src/common.c -lpthread -lnuma
+ *   ./dests_bench -v 192.168.100.100:80 -n 100000 -b 4096
+ *
+ * the service is created (TCP, rr) and deleted by the program, dests are
+ * 10.0.0.1:80 and onwards, FULLNAT.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include "libipvs.h"
+
+static int nr_dests = 100000;
+static int batch_size = 4096;
+static ipvs_service_t svc;
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-v VIP:PORT] [-n DESTS] [-b BATCH]\n", prog);
+    exit(1);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill_dest(ipvs_dest_t *dest, int i)
+{
+    memset(dest, 0, sizeof(*dest));
+    dest->af = AF_INET;
+    dest->addr.ip = htonl((10 << 24) + i + 1);
+    dest->__addr_v4 = dest->addr.ip;
+    dest->port = htons(80);
+    dest->conn_flags = IP_VS_CONN_F_FULLNAT;
+    dest->weight = 1;
+}
+
+static void report(const char *what, int n, int fails, double t)
+{
+    printf("%-12s dests=%d failed=%d time=%.3fs rate=%.0f/s\n",
+           what, n, fails, t, t > 0 ? n / t : 0);
+}
+
+static void one_by_one(ipvs_dest_t *dests)
+{
+    double t;
+    int i, fails;
+
+    for (t = now(), fails = 0, i = 0; i < nr_dests; i++)
+        if (ipvs_add_dest(&svc, &dests[i]))
+            fails++;
+    report("add", nr_dests, fails, now() - t);
+
+    for (t = now(), fails = 0, i = 0; i < nr_dests; i++)
+        if (ipvs_del_dest(&svc, &dests[i]))
+            fails++;
+    report("del", nr_dests, fails, now() - t);
+}
+
+static int count_fails(const int *errs, int n)
+{
+    int i, fails = 0;
+
+    for (i = 0; i < n; i++)
+        if (errs[i])
+            fails++;
+    return fails;
+}
+
+static void batched(ipvs_dest_t *dests, int *errs)
+{
+    double t;
+    int i, n, fails;
+
+    for (t = now(), fails = 0, i = 0; i < nr_dests; i += n) {
+        n = nr_dests - i < batch_size ? nr_dests - i : batch_size;
+        if (ipvs_add_dests(&svc, &dests[i], n, errs))
+            fails += n;
+        else
+            fails += count_fails(errs, n);
+    }
+    report("batch-add", nr_dests, fails, now() - t);
+
+    for (t = now(), fails = 0, i = 0; i < nr_dests; i += n) {
+        n = nr_dests - i < batch_size ? nr_dests - i : batch_size;
+        if (ipvs_del_dests(&svc, &dests[i], n, errs))
+            fails += n;
+        else
+            fails += count_fails(errs, n);
+    }
+    report("batch-del", nr_dests, fails, now() - t);
+}
+
+int main(int argc, char *argv[])
+{
+    char vip[64] = "192.168.100.100:80", *p;
+    ipvs_dest_t *dests;
+    int *errs;
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, "v:n:b:h")) != -1) {
+        switch (opt) {
+        case 'v':
+            snprintf(vip, sizeof(vip), "%s", optarg);
+            break;
+        case 'n':
+            nr_dests = atoi(optarg);
+            break;
+        case 'b':
+            batch_size = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (nr_dests <= 0 || batch_size <= 0 || !(p = strchr(vip, ':')))
+        usage(argv[0]);
+    *p++ = '\0';
+
+    memset(&svc, 0, sizeof(svc));
+    svc.af = AF_INET;
+    svc.protocol = IPPROTO_TCP;
+    if (inet_pton(AF_INET, vip, &svc.addr.ip) != 1)
+        usage(argv[0]);
+    svc.__addr_v4 = svc.addr.ip;
+    svc.port = htons(atoi(p));
+    svc.netmask = ~0;
+    snprintf(svc.sched_name, sizeof(svc.sched_name), "rr");
+
+    dests = calloc(nr_dests, sizeof(*dests));
+    errs = calloc(batch_size, sizeof(*errs));
+    if (!dests || !errs) {
+        fprintf(stderr, "no memory\n");
+        return 1;
+    }
+    for (i = 0; i < nr_dests; i++)
+        fill_dest(&dests[i], i);
+
+    if (ipvs_init() || ipvs_add_service(&svc)) {
+        fprintf(stderr, "fail to add service %s:%s\n", vip, p);
+        return 1;
+    }
+
+    one_by_one(dests);
+    batched(dests, errs);
+
+    ipvs_del_service(&svc);
+    ipvs_close();
+    free(errs);
+    free(dests);
+    return 0;
+}
@@ -0,0 +1,221 @@
+#!/bin/bash
+#
+# DPVS is a software load balancer (Virtual Server) based on DPDK.
+#
+# Copyright (C) 2017 iQIYI (www.iqiyi.com).
+# All Rights Reserved.
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+
+#
+# native health check against real servers on the host: dpvs runs on a
+# net_tap vdev, the tap interface stands in for the real server network
+# and python3 provides the servers. prints one PASS/FAIL line per case.
+#
+# needs root, python3 and a dpvs/dpip/ipvsadm build in BIN_DIR.
+#
+
+HC_DIR=$(cd $(dirname $0) && pwd)
+BIN_DIR=$HC_DIR/../../bin
+EAL_ARGS="-l 0-1 -n 4 --no-pci"
+TAP=dpvs-hc
+
+DPVS_CONF=/etc/dpvs.conf
+DPVS_PID=
+SERVER_PIDS=
+
+VIP=192.168.200.100
+LIP=192.168.200.2
+RS=192.168.200.1
+HTTP_PORT=8080      # python http.server
+DEAD_PORT=8081      # nobody listens
+UDP_PORT=8053       # python udp echo
+
+# short intervals to keep it quick, damping off unless tested
+HC_OPTS="interval 300 timeout 200 rise 2 fall 2 damping 0"
+WAIT=2
+
+usage() {
+    echo "Usage: $0 [-b BIN_DIR] [-e \"EAL_ARGS\"]"
+    echo "    -b BIN_DIR     where dpvs, dpip, ipvsadm are ($BIN_DIR)"
+    echo "    -e EAL_ARGS    extra EAL arguments ($EAL_ARGS)"
+    exit 1
+}
+
+while getopts "b:e:h" arg; do
+    case $arg in
+    b) BIN_DIR=$OPTARG ;;
+    e) EAL_ARGS=$OPTARG ;;
+    *) usage ;;
+    esac
+done
+
+DPVS="$BIN_DIR/dpvs"
+DPIP="$BIN_DIR/dpip"
+IPVSADM="$BIN_DIR/ipvsadm"
+
+for b in $DPVS $DPIP $IPVSADM; do
+    if [ ! -x $b ]; then
+        echo "$b not found" >&2
+        exit 1
+    fi
+done
+
+run() {
+    $@ > /dev/null 2>&1 || echo "WARN: failed: $@" >&2
+}
+
+dpvs_start() {
+    $DPVS -- $EAL_ARGS --vdev "net_tap0,iface=$TAP" \
+        > /tmp/dpvs_hc.log 2>&1 &
+    DPVS_PID=$!
+
+    for i in $(seq 1 60); do
+        if $DPIP hc show > /dev/null 2>&1; then
+            return 0
+        fi
+        if ! kill -0 $DPVS_PID 2> /dev/null; then
+            break
+        fi
+        sleep 1
+    done
+
+    echo "dpvs fail to start, see /tmp/dpvs_hc.log" >&2
+    return 1
+}
+
+cleanup() {
+    for p in $SERVER_PIDS; do
+        kill $p 2> /dev/null
+    done
+    if [ -n "$DPVS_PID" ]; then
+        kill -9 $DPVS_PID 2> /dev/null
+        wait $DPVS_PID 2> /dev/null
+    fi
+    if [ -f $DPVS_CONF.hc-save ]; then
+        mv -f $DPVS_CONF.hc-save $DPVS_CONF
+    fi
+}
+
+http_start() {
+    python3 -m http.server $HTTP_PORT --bind $RS > /dev/null 2>&1 &
+    HTTP_PID=$!
+    SERVER_PIDS="$SERVER_PIDS $HTTP_PID"
+}
+
+http_stop() {
+    kill $HTTP_PID 2> /dev/null
+    wait $HTTP_PID 2> /dev/null
+}
+
+udp_start() {
+    python3 -c "
+import socket
+s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+s.bind(('$RS', $UDP_PORT))
+while True:
+    d, a = s.recvfrom(2048)
+    s.sendto(d, a)
+" &
+    SERVER_PIDS="$SERVER_PIDS $!"
+}
+
+# $1: dest port, prints state of the dest
+hc_state() {
+    $DPIP hc show | awk -v d="$RS" -v p="$1" '
+        $5 == d && $6 == p { for (i = 1; i < NF; i++) if ($i == "type") print $(i + 2) }'
+}
+
+# $1: case name, $2: dest port, $3: expected state
+expect() {
+    local st=$(hc_state $2)
+
+    if [ "$st" == "$3" ]; then
+        echo "PASS: $1"
+    else
+        echo "FAIL: $1, $RS:$2 is \"$st\", expect \"$3\""
+        FAILED=1
+    fi
+}
+
+setup() {
+    ip link set $TAP up
+    ip addr add $RS/24 dev $TAP
+
+    run $DPIP addr add $LIP/24 dev dpdk0 sapool
+    run $DPIP addr add $VIP/32 dev dpdk0
+
+    run $IPVSADM -A -t $VIP:80 -s rr
+    run $IPVSADM -a -t $VIP:80 -r $RS:$HTTP_PORT -b
+    run $IPVSADM -a -t $VIP:80 -r $RS:$DEAD_PORT -b
+    run $IPVSADM -P -t $VIP:80 -z $LIP -F dpdk0
+
+    run $IPVSADM -A -u $VIP:53 -s rr
+    run $IPVSADM -a -u $VIP:53 -r $RS:$UDP_PORT -b
+    run $IPVSADM -P -u $VIP:53 -z $LIP -F dpdk0
+}
+
+##### main #####
+if [ -f $DPVS_CONF ]; then
+    cp -f $DPVS_CONF $DPVS_CONF.hc-save
+fi
+cp -f $HC_DIR/../bench/dpvs.bench.conf $DPVS_CONF
+
+trap 'cleanup; exit 1' INT TERM
+
+dpvs_start || { cleanup; exit 1; }
+setup
+http_start
+udp_start
+sleep 1
+
+run $DPIP hc add tcp $VIP 80 type http src $LIP $HC_OPTS
+run $DPIP hc add udp $VIP 53 type udp src $LIP payload ping $HC_OPTS
+sleep $WAIT
+
+expect "http up" $HTTP_PORT up
+expect "refused down" $DEAD_PORT down
+expect "udp up" $UDP_PORT up
+
+http_stop
+sleep $WAIT
+expect "http down" $HTTP_PORT down
+
+http_start
+sleep $WAIT
+expect "http back" $HTTP_PORT up
+
+# tcp only, on the same dests
+run $DPIP hc add tcp $VIP 80 type tcp src $LIP $HC_OPTS
+sleep $WAIT
+expect "tcp up" $HTTP_PORT up
+expect "tcp refused down" $DEAD_PORT down
+
+# two flaps within a half-life suppress the dest
+run $DPIP hc add tcp $VIP 80 type tcp src $LIP ${HC_OPTS/damping 0/damping 60}
+sleep $WAIT
+for i in 1 2; do
+    http_stop
+    sleep $WAIT
+    http_start
+    sleep $WAIT
+done
+expect "flap suppressed" $HTTP_PORT suppressed
+
+# del gives dests back
+run $DPIP hc del tcp $VIP 80
+expect "del" $DEAD_PORT ""
+
+$DPIP hc show
+cleanup
+
+exit ${FAILED:-0}
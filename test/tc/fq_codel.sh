@@ -0,0 +1,242 @@
+#!/bin/bash
+#
+# DPVS is a software load balancer (Virtual Server) based on DPDK.
+#
+# Copyright (C) 2017 iQIYI (www.iqiyi.com).
+# All Rights Reserved.
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+
+#
+# fq_codel against bufferbloat: dpvs runs on a net_tap vdev, egress to the
+# tap is shaped by tbf, a bulk UDP flow fills the queue and the RTT of a
+# sparse UDP echo flow through the same queue is measured, first with the
+# default bfifo inner queue of tbf, then with fq_codel grafted instead.
+# prints one PASS/FAIL line per case.
+#
+# needs root, python3 and a dpvs/dpip/ipvsadm build in BIN_DIR.
+#
+
+TC_DIR=$(cd $(dirname $0) && pwd)
+BIN_DIR=$TC_DIR/../../bin
+EAL_ARGS="-l 0-1 -n 4 --no-pci"
+TAP=dpvs-tc
+
+DPVS_CONF=/etc/dpvs.conf
+DPVS_PID=
+SERVER_PIDS=
+
+VIP=192.168.201.100
+LIP=192.168.201.2
+RS=192.168.201.1
+BULK_PORT=8009      # python udp sink
+ECHO_PORT=8007      # python udp echo
+
+# 200ms worth of queue at 10mbit, bulk offers about twice the rate
+TBF_OPTS="rate 10m burst 10000 latency 200"
+BULK_SECS=6
+PROBES=20
+
+usage() {
+    echo "Usage: $0 [-b BIN_DIR] [-e \"EAL_ARGS\"]"
+    echo "    -b BIN_DIR     where dpvs, dpip, ipvsadm are ($BIN_DIR)"
+    echo "    -e EAL_ARGS    extra EAL arguments ($EAL_ARGS)"
+    exit 1
+}
+
+while getopts "b:e:h" arg; do
+    case $arg in
+    b) BIN_DIR=$OPTARG ;;
+    e) EAL_ARGS=$OPTARG ;;
+    *) usage ;;
+    esac
+done
+
+DPVS="$BIN_DIR/dpvs"
+DPIP="$BIN_DIR/dpip"
+IPVSADM="$BIN_DIR/ipvsadm"
+
+for b in $DPVS $DPIP $IPVSADM; do
+    if [ ! -x $b ]; then
+        echo "$b not found" >&2
+        exit 1
+    fi
+done
+
+run() {
+    $@ > /dev/null 2>&1 || echo "WARN: failed: $@" >&2
+}
+
+dpvs_start() {
+    $DPVS -- $EAL_ARGS --vdev "net_tap0,iface=$TAP" \
+        > /tmp/dpvs_tc.log 2>&1 &
+    DPVS_PID=$!
+
+    for i in $(seq 1 60); do
+        if $DPIP link show dpdk0 > /dev/null 2>&1; then
+            return 0
+        fi
+        if ! kill -0 $DPVS_PID 2> /dev/null; then
+            break
+        fi
+        sleep 1
+    done
+
+    echo "dpvs fail to start, see /tmp/dpvs_tc.log" >&2
+    return 1
+}
+
+cleanup() {
+    for p in $SERVER_PIDS; do
+        kill $p 2> /dev/null
+    done
+    if [ -n "$DPVS_PID" ]; then
+        kill -9 $DPVS_PID 2> /dev/null
+        wait $DPVS_PID 2> /dev/null
+    fi
+    if [ -f $DPVS_CONF.tc-save ]; then
+        mv -f $DPVS_CONF.tc-save $DPVS_CONF
+    fi
+}
+
+servers_start() {
+    python3 -c "
+import socket
+s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+s.bind(('$RS', $BULK_PORT))
+while True:
+    s.recvfrom(2048)
+" &
+    SERVER_PIDS="$SERVER_PIDS $!"
+
+    python3 -c "
+import socket
+s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+s.bind(('$RS', $ECHO_PORT))
+while True:
+    d, a = s.recvfrom(2048)
+    s.sendto(d, a)
+" &
+    SERVER_PIDS="$SERVER_PIDS $!"
+}
+
+# about 20mbit of 1000B datagrams to the bulk service for BULK_SECS
+bulk_start() {
+    python3 -c "
+import socket, time
+s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+d = b'x' * 1000
+end = time.time() + $BULK_SECS
+while time.time() < end:
+    for i in range(25):
+        s.sendto(d, ('$VIP', 9))
+    time.sleep(0.01)
+" &
+    BULK_PID=$!
+}
+
+# prints median RTT of the echo service in ms, 1000 if all lost
+probe() {
+    python3 -c "
+import socket, time
+s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+s.settimeout(1)
+rtts = []
+for i in range($PROBES):
+    t = time.time()
+    s.sendto(b'ping', ('$VIP', 7))
+    try:
+        s.recvfrom(64)
+        rtts.append((time.time() - t) * 1000)
+    except socket.timeout:
+        pass
+    time.sleep(0.1)
+rtts.sort()
+print(int(rtts[len(rtts) // 2]) if rtts else 1000)
+"
+}
+
+# prints median RTT under bulk load
+loaded_rtt() {
+    bulk_start
+    sleep 2         # let the queue build
+    probe
+    wait $BULK_PID 2> /dev/null
+    sleep 1         # and drain
+}
+
+setup() {
+    ip link set $TAP up
+    ip addr add $RS/24 dev $TAP
+
+    run $DPIP addr add $LIP/24 dev dpdk0 sapool
+    run $DPIP addr add $VIP/32 dev dpdk0
+
+    run $IPVSADM -A -u $VIP:9 -s rr
+    run $IPVSADM -a -u $VIP:9 -r $RS:$BULK_PORT -b
+    run $IPVSADM -P -u $VIP:9 -z $LIP -F dpdk0
+
+    run $IPVSADM -A -u $VIP:7 -s rr
+    run $IPVSADM -a -u $VIP:7 -r $RS:$ECHO_PORT -b
+    run $IPVSADM -P -u $VIP:7 -z $LIP -F dpdk0
+
+    # everything to the tap goes through tbf 1:, whose inner queue is bfifo
+    run $DPIP link set dpdk0 tc-egress on
+    run $DPIP qsch add dev dpdk0 handle 1: parent 0: tbf $TBF_OPTS
+    run $DPIP cls add dev dpdk0 qsch 0: match pattern "udp,to=$RS" target 1:
+}
+
+##### main #####
+if [ -f $DPVS_CONF ]; then
+    cp -f $DPVS_CONF $DPVS_CONF.tc-save
+fi
+cp -f $TC_DIR/../bench/dpvs.bench.conf $DPVS_CONF
+
+trap 'cleanup; exit 1' INT TERM
+
+dpvs_start || { cleanup; exit 1; }
+setup
+servers_start
+sleep 1
+
+IDLE=$(probe)
+BFIFO=$(loaded_rtt)
+
+# graft fq_codel as inner queue of tbf, the bfifo is freed
+run $DPIP qsch add dev dpdk0 handle 2: parent 1: fq_codel
+FQ_CODEL=$(loaded_rtt)
+
+echo "median RTT: idle ${IDLE}ms, bfifo ${BFIFO}ms, fq_codel ${FQ_CODEL}ms"
+
+if [ $BFIFO -gt $((IDLE + 50)) ]; then
+    echo "PASS: bfifo bloated"
+else
+    echo "FAIL: bfifo bloated, queue not built, check tbf rate"
+    FAILED=1
+fi
+
+if [ $((FQ_CODEL * 4)) -lt $BFIFO ]; then
+    echo "PASS: fq_codel sparse flow"
+else
+    echo "FAIL: fq_codel sparse flow, RTT not cut by 4x"
+    FAILED=1
+fi
+
+if $DPIP -s qsch show dev dpdk0 handle 2: | grep -q "dropped [1-9]"; then
+    echo "PASS: fq_codel codel drops"
+else
+    echo "FAIL: fq_codel codel drops, bulk flow not dropped"
+    FAILED=1
+fi
+
+cleanup
+exit ${FAILED:-0}
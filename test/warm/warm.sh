@@ -0,0 +1,251 @@
+#!/bin/bash
+#
+# DPVS is a software load balancer (Virtual Server) based on DPDK.
+#
+# Copyright (C) 2017 iQIYI (www.iqiyi.com).
+# All Rights Reserved.
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+
+#
+# warm restart: dpvs runs on a net_ring vdev, which loops what dpvs sends
+# back to its rx. UDP flows sent from the host to the KNI of the port come
+# back as clients, FNAT conns are made for two services. conns are saved,
+# dpvs is restarted with only one of the services, and conns are restored.
+# restored conns and their <lip:lport> must be the same as saved ones, the
+# lports taken again in sa_pool, and conns of the other service skipped.
+# prints one PASS/FAIL line per case.
+#
+# needs root, the rte_kni module, python3 and a dpvs/dpip/ipvsadm build in
+# BIN_DIR.
+#
+
+WARM_DIR=$(cd $(dirname $0) && pwd)
+BIN_DIR=$WARM_DIR/../../bin
+EAL_ARGS="-l 0-1 -n 4 --no-pci"
+KNI=dpdk0.kni
+WARM_FILE=/mnt/huge/dpvs_warm_test
+
+DPVS_CONF=/etc/dpvs.conf
+DPVS_PID=
+
+VIP=192.168.202.100
+LIP=192.168.202.2
+CIP=192.168.202.1   # host, on the KNI
+RS=192.168.202.3    # nobody, sent to the ring and dropped
+RS_MAC=02:00:00:00:02:03
+PORT1=53            # kept after restart
+PORT2=54            # not configured again
+RS_PORT=8053
+
+FLOWS1=100
+FLOWS2=20
+CPORT1=20000
+CPORT2=30000
+CPORT3=40000        # new flows after restore
+
+usage() {
+    echo "Usage: $0 [-b BIN_DIR] [-e \"EAL_ARGS\"]"
+    echo "    -b BIN_DIR     where dpvs, dpip, ipvsadm are ($BIN_DIR)"
+    echo "    -e EAL_ARGS    extra EAL arguments ($EAL_ARGS)"
+    exit 1
+}
+
+while getopts "b:e:h" arg; do
+    case $arg in
+    b) BIN_DIR=$OPTARG ;;
+    e) EAL_ARGS=$OPTARG ;;
+    *) usage ;;
+    esac
+done
+
+DPVS="$BIN_DIR/dpvs"
+DPIP="$BIN_DIR/dpip"
+IPVSADM="$BIN_DIR/ipvsadm"
+
+for b in $DPVS $DPIP $IPVSADM; do
+    if [ ! -x $b ]; then
+        echo "$b not found" >&2
+        exit 1
+    fi
+done
+
+run() {
+    $@ > /dev/null 2>&1 || echo "WARN: failed: $@" >&2
+}
+
+dpvs_start() {
+    $DPVS -- $EAL_ARGS --vdev "net_ring0" >> /tmp/dpvs_warm.log 2>&1 &
+    DPVS_PID=$!
+
+    for i in $(seq 1 60); do
+        if $DPIP warm show > /dev/null 2>&1 && ip link show $KNI \
+                > /dev/null 2>&1; then
+            return 0
+        fi
+        if ! kill -0 $DPVS_PID 2> /dev/null; then
+            break
+        fi
+        sleep 1
+    done
+
+    echo "dpvs fail to start, see /tmp/dpvs_warm.log" >&2
+    return 1
+}
+
+dpvs_stop() {
+    kill $DPVS_PID 2> /dev/null
+    for i in $(seq 1 10); do
+        kill -0 $DPVS_PID 2> /dev/null || break
+        sleep 1
+    done
+    kill -9 $DPVS_PID 2> /dev/null
+    wait $DPVS_PID 2> /dev/null
+    DPVS_PID=
+}
+
+cleanup() {
+    if [ -n "$DPVS_PID" ]; then
+        kill -9 $DPVS_PID 2> /dev/null
+        wait $DPVS_PID 2> /dev/null
+    fi
+    rm -f $WARM_FILE
+    if [ -f $DPVS_CONF.warm-save ]; then
+        mv -f $DPVS_CONF.warm-save $DPVS_CONF
+    fi
+}
+
+# $1: vport to configure, repeat for more
+setup() {
+    ip link set $KNI up
+    ip addr add $CIP/24 dev $KNI
+    ip neigh replace $VIP lladdr $(cat /sys/class/net/$KNI/address) \
+        dev $KNI nud permanent
+
+    run $DPIP addr add $LIP/24 dev dpdk0 sapool
+    run $DPIP addr add $VIP/32 dev dpdk0
+    run $DPIP neigh add $RS lladdr $RS_MAC dev dpdk0
+
+    for p in $@; do
+        run $IPVSADM -A -u $VIP:$p -s rr
+        run $IPVSADM -a -u $VIP:$p -r $RS:$RS_PORT -b
+        run $IPVSADM -P -u $VIP:$p -z $LIP -F dpdk0
+    done
+}
+
+# $1: vport, $2: first client port, $3: number of flows
+flows() {
+    python3 -c "
+import socket
+for i in range($3):
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    s.bind(('$CIP', $2 + i))
+    s.sendto(b'warm', ('$VIP', $1))
+    s.close()
+"
+}
+
+# conns without the expire column, "[cpu]proto state client vip local dest"
+conns() {
+    $IPVSADM -lnc | awk '$1 ~ /^\[/ { print $1, $3, $4, $5, $6, $7 }' | sort
+}
+
+sa_used() {
+    $DPIP addr show dev dpdk0 | awk -v l="$LIP" '
+        $2 ~ "^"l"/" { f = 1; next }
+        f { for (i = 1; i < NF; i++) if ($i == "sa_used") print $(i + 1); f = 0 }'
+}
+
+# $1: skip reason, prints its count in Total
+skipped() {
+    $DPIP warm show | awk -v r="$1" '
+        /^Total:/ { f = 1; next }
+        /^cpu / { f = 0 }
+        f && $1 == r { n = $2 }
+        END { print n + 0 }'
+}
+
+restored() {
+    $DPIP warm show | awk '/^Total:/ { print $3 }'
+}
+
+# $1: case name, $2: value, $3: expected value
+expect() {
+    if [ "$2" == "$3" ]; then
+        echo "PASS: $1"
+    else
+        echo "FAIL: $1, got \"$2\", expect \"$3\""
+        FAILED=1
+    fi
+}
+
+##### main #####
+if [ -f $DPVS_CONF ]; then
+    cp -f $DPVS_CONF $DPVS_CONF.warm-save
+fi
+sed -e "s|^ipvs_defs {|ipvs_defs {\n    warm_restart {\n        file    $WARM_FILE\n        max_age 60\n    }\n|" \
+    $WARM_DIR/../bench/dpvs.bench.conf > $DPVS_CONF
+rm -f $WARM_FILE /tmp/dpvs_warm.log
+
+trap 'cleanup; exit 1' INT TERM
+
+dpvs_start || { cleanup; exit 1; }
+setup $PORT1 $PORT2
+flows $PORT1 $CPORT1 $FLOWS1
+flows $PORT2 $CPORT2 $FLOWS2
+sleep 1
+
+SAVED=$(conns)
+expect "conns made" $(echo "$SAVED" | grep -c .) $((FLOWS1 + FLOWS2))
+expect "lports taken" "$(sa_used)" $((FLOWS1 + FLOWS2))
+
+run $DPIP warm set save
+expect "save" "$($DPIP warm show | awk '/^last save:/ { print $3 }')" "OK"
+expect "saved conns" "$(restored)" $((FLOWS1 + FLOWS2))
+expect "file" "$([ -f $WARM_FILE ] && echo yes)" "yes"
+
+dpvs_stop
+dpvs_start || { cleanup; exit 1; }
+setup $PORT1
+
+expect "no conns before restore" $(conns | grep -c .) 0
+expect "no lports before restore" "$(sa_used)" 0
+
+run $DPIP warm set restore
+$DPIP warm show all
+
+expect "restore" "$($DPIP warm show | awk '/^last restore:/ { print $3 }')" \
+    "OK"
+expect "restored conns" "$(restored)" $FLOWS1
+expect "skipped no_service" "$(skipped no_service)" $FLOWS2
+for r in expired no_lcore no_dest no_lport exist synproxy no_room other; do
+    expect "skipped $r" "$(skipped $r)" 0
+done
+
+# same tuples, state, dest and <lip:lport> as saved ones
+expect "conns match" \
+    "$(conns | md5sum)" \
+    "$(echo "$SAVED" | awk -v v="$VIP:$PORT1" '$4 == v' | md5sum)"
+expect "lports taken again" "$(sa_used)" $FLOWS1
+expect "file removed" "$([ -f $WARM_FILE ] && echo yes)" ""
+
+# new flows must not be given any restored lport
+flows $PORT1 $CPORT3 $FLOWS2
+sleep 1
+expect "new conns" $(conns | grep -c .) $((FLOWS1 + FLOWS2))
+expect "lports unique" \
+    $(conns | awk '{ print $5 }' | sort | uniq -d | grep -c .) 0
+expect "lports all taken" "$(sa_used)" $((FLOWS1 + FLOWS2))
+
+cleanup
+
+exit ${FAILED:-0}
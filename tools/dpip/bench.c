@@ -0,0 +1,195 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * bench.c - data path cycle accounting of dpip tool.
+ *
+ * output is one "key=value" record per line, for scripts.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "dpip.h"
+#include "utils.h"
+#include "conf/bench.h"
+#include "sockopt.h"
+
+struct bench_param {
+    int     rx;         /* -1: not set */
+};
+
+static void bench_help(void)
+{
+    fprintf(stderr,
+            "Usage:\n"
+            "    dpip bench show\n"
+            "    dpip bench flush\n"
+            "    dpip bench set rx { on | off }\n"
+            "Notes:\n"
+            "    Counters are only available if dpvs is built with\n"
+            "    CONFIG_DPVS_BENCH, and rx is held until \"set rx on\".\n"
+            "    Stage timing is inclusive of nested stages.\n"
+            "Examples:\n"
+            "    dpip bench set rx on\n"
+            "    dpip bench show\n"
+            "    dpip bench flush\n");
+}
+
+static int bench_parse(struct dpip_obj *obj, struct dpip_conf *conf)
+{
+    struct bench_param *param = obj->param;
+
+    memset(param, 0, sizeof(*param));
+    param->rx = -1;
+
+    while (conf->argc > 0) {
+        if (strcmp(conf->argv[0], "rx") == 0) {
+            NEXTARG_CHECK(conf, conf->argv[0]);
+            if (strcmp(conf->argv[0], "on") == 0)
+                param->rx = 1;
+            else if (strcmp(conf->argv[0], "off") == 0)
+                param->rx = 0;
+            else
+                return EDPVS_INVAL;
+        } else {
+            fprintf(stderr, "too many arguments\n");
+            return EDPVS_INVAL;
+        }
+
+        NEXTARG(conf);
+    }
+
+    return EDPVS_OK;
+}
+
+static int bench_check(const struct dpip_obj *obj, dpip_cmd_t cmd)
+{
+    const struct bench_param *param = obj->param;
+
+    switch (cmd) {
+    case DPIP_CMD_SET:
+        if (param->rx < 0) {
+            fprintf(stderr, "missing rx on|off\n");
+            return EDPVS_INVAL;
+        }
+        return EDPVS_OK;
+    case DPIP_CMD_SHOW:
+    case DPIP_CMD_FLUSH:
+        return EDPVS_OK;
+    default:
+        return EDPVS_NOTSUPP;
+    }
+}
+
+static void bench_entry_dump(const char *lcore, int stage, uint64_t calls,
+                             uint64_t pkts, uint64_t cycles)
+{
+    printf("lcore=%s stage=%s calls=%lu pkts=%lu cycles=%lu "
+           "cycles_per_pkt=%.1f\n", lcore, dpvs_bench_stage_name(stage),
+           calls, pkts, cycles, pkts ? (double)cycles / pkts : 0.0);
+}
+
+static int bench_show(void)
+{
+    struct dp_vs_bench_conf_array *array;
+    const struct dp_vs_bench_entry *ent;
+    uint64_t calls[DPVS_BENCH_STAGE_MAX] = { 0 };
+    uint64_t pkts[DPVS_BENCH_STAGE_MAX] = { 0 };
+    uint64_t cycles[DPVS_BENCH_STAGE_MAX] = { 0 };
+    char lcore[8];
+    size_t size;
+    int err, i;
+
+    err = dpvs_getsockopt(SOCKOPT_GET_BENCH_SHOW, NULL, 0,
+                          (void **)&array, &size);
+    if (err != 0)
+        return err;
+
+    if (size < sizeof(*array)
+            || size < sizeof(*array) + \
+                      array->nentry * sizeof(struct dp_vs_bench_entry)) {
+        fprintf(stderr, "corrupted response.\n");
+        dpvs_sockopt_msg_free(array);
+        return EDPVS_INVAL;
+    }
+
+    printf("enabled=%u rx=%s tsc_hz=%lu\n", array->enabled,
+           array->rx_enabled ? "on" : "off", array->tsc_hz);
+
+    for (i = 0; i < array->nentry; i++) {
+        ent = &array->entries[i];
+        if (ent->stage >= DPVS_BENCH_STAGE_MAX)
+            continue;
+
+        snprintf(lcore, sizeof(lcore), "%u", ent->cid);
+        bench_entry_dump(lcore, ent->stage, ent->calls, ent->pkts, ent->cycles);
+
+        calls[ent->stage] += ent->calls;
+        pkts[ent->stage] += ent->pkts;
+        cycles[ent->stage] += ent->cycles;
+    }
+
+    for (i = 0; i < DPVS_BENCH_STAGE_MAX; i++) {
+        if (calls[i])
+            bench_entry_dump("all", i, calls[i], pkts[i], cycles[i]);
+    }
+
+    dpvs_sockopt_msg_free(array);
+    return EDPVS_OK;
+}
+
+static int bench_do_cmd(struct dpip_obj *obj, dpip_cmd_t cmd,
+                        struct dpip_conf *conf)
+{
+    const struct bench_param *param = obj->param;
+    struct dp_vs_bench_rx_conf rx_conf;
+
+    switch (cmd) {
+    case DPIP_CMD_SET:
+        rx_conf.enable = param->rx;
+        return dpvs_setsockopt(SOCKOPT_SET_BENCH_RX, &rx_conf, sizeof(rx_conf));
+    case DPIP_CMD_FLUSH:
+        return dpvs_setsockopt(SOCKOPT_SET_BENCH_RESET, NULL, 0);
+    case DPIP_CMD_SHOW:
+        return bench_show();
+    default:
+        return EDPVS_NOTSUPP;
+    }
+}
+
+static struct bench_param bench_param;
+
+static struct dpip_obj dpip_bench = {
+    .name       = "bench",
+    .param      = &bench_param,
+
+    .help       = bench_help,
+    .parse      = bench_parse,
+    .check      = bench_check,
+    .do_cmd     = bench_do_cmd,
+};
+
+static void __init bench_init(void)
+{
+    dpip_register_obj(&dpip_bench);
+}
+
+static void __exit bench_exit(void)
+{
+    dpip_unregister_obj(&dpip_bench);
+}
@@ -34,7 +34,7 @@ static void cls_help(void)
     fprintf(stderr,
         "Usage:\n"
         "    dpip cls { add | del | change | replace | show } dev STRING\n"
-        "             [ handle HANDLE ] [ qsch HANDLE ]\n"
+        "             [ handle HANDLE ] [ qsch { HANDLE | ingress } ]\n"
         "             [ pkttype PKTTYPE ] [ prio PRIO ]\n"
         "             [ CLS_TYPE [ COPTIONS ] ]\n"
         "\n"
@@ -46,6 +46,7 @@ static void cls_help(void)
         "\n"
         "Match options:\n"
         "    MATCH_OPTS := pattern PATTERN { target { CHILD_QSCH | drop } }\n"
+        "                  [ police PPS [ burst PKTS ] ]\n"
         "    PATTERN    := comma seperated of tokens below,\n"
         "                  { PROTO | SRANGE | DRANGE | IIF | OIF }\n"
         "    CHILD_QSCH := child qsch handle of the qsch cls attached.\n"
@@ -55,6 +56,9 @@ static void cls_help(void)
         "    RANGE      := ADDR[-ADDR][:PORT[-PORT]]\n"
         "    IIF        := \"iif=IFNAME\"\n"
         "    OIF        := \"oif=IFNAME\"\n"
+        "    PPS        := packets per second shared by all lcores, matched\n"
+        "                  packets over it are dropped.\n"
+        "    PKTS       := burst in packets, default PPS/10.\n"
         "\n"
         "Examples:\n"
         "    dpip cls show dev dpdk0 qsch 1:\n"
@@ -64,6 +68,9 @@ static void cls_help(void)
         "         match pattern 'tcp,from=192.168.0.1:1-1024,oif=eth1'\\\n"
         "         target 1:1\n"
         "    dpip cls del dev dpdk0 qsch 1: handle 1:10\n"
+        "    dpip qsch add dev dpdk0 ingress\n"
+        "    dpip cls add dev dpdk0 qsch ingress \\\n"
+        "         match pattern 'udp,to=10.0.0.100:53' police 100000\n"
         );
 }
 
@@ -89,6 +96,11 @@ static void cls_dump_param(const char *ifname, const union tc_param *param)
 
         printf("%s target %s",
                dump_match(m->proto, &m->match, patt, sizeof(patt)), result);
+
+        if (m->police.rate)
+            printf(" police %u burst %u passed %lu dropped %lu",
+                   m->police.rate, m->police.burst,
+                   m->police.passed, m->police.dropped);
     }
 
     printf("\n");
@@ -116,7 +128,10 @@ static int cls_parse(struct dpip_obj *obj, struct dpip_conf *cf)
             param->handle = tc_handle_atoi(CURRARG(cf));
         } else if (strcmp(CURRARG(cf), "qsch") == 0) {
             NEXTARG_CHECK(cf, CURRARG(cf));
-            param->sch_id = tc_handle_atoi(CURRARG(cf));
+            if (strcmp(CURRARG(cf), "ingress") == 0)
+                param->sch_id = TC_H_MAKE(TC_H_INGRESS, 0);
+            else
+                param->sch_id = tc_handle_atoi(CURRARG(cf));
         } else if (strcmp(CURRARG(cf), "pkttype") == 0) {
             NEXTARG_CHECK(cf, CURRARG(cf));
             if (strcasecmp(CURRARG(cf), "ipv4") == 0)
@@ -149,6 +164,17 @@ static int cls_parse(struct dpip_obj *obj, struct dpip_conf *cf)
                         m->result.drop = true;
                     else
                         m->result.sch_id = tc_handle_atoi(CURRARG(cf));
+                } else if (strcmp(CURRARG(cf), "police") == 0) {
+                    NEXTARG_CHECK(cf, CURRARG(cf));
+                    m->police.rate = atoi(CURRARG(cf));
+                    if (!m->police.rate) {
+                        fprintf(stderr, "invalid police rate: `%s'\n",
+                                CURRARG(cf));
+                        return EDPVS_INVAL;
+                    }
+                } else if (strcmp(CURRARG(cf), "burst") == 0) {
+                    NEXTARG_CHECK(cf, CURRARG(cf));
+                    m->police.burst = atoi(CURRARG(cf));
                 }
             } else {
                 fprintf(stderr, "invalid/miss cls type: `%s'\n", param->kind);
@@ -24,6 +24,9 @@
 #include "dpip.h"
 #include "list.h"
 #include "common.h"
+#include "sockopt.h"
+
+#define DPIP_BATCH_ARGS_MAX     64
 
 static struct list_head dpip_objs = LIST_HEAD_INIT(dpip_objs);
 
@@ -34,7 +37,8 @@ static void usage(void)
         "    "DPIP_NAME" [OPTIONS] OBJECT { COMMAND | help }\n"
         "Parameters:\n"
         "    OBJECT  := { link | addr | route | neigh | vlan | tunnel |\n"
-        "                 qsch | cls | ipv6 }\n"
+        "                 qsch | cls | ipv6 | bench | hc | icmp | overload |\n"
+        "                 offload | prof | warm }\n"
         "    COMMAND := { add | del | change | replace | show | flush }\n"
         "Options:\n"
         "    -v, --verbose\n"
@@ -44,6 +48,8 @@ static void usage(void)
         "    -6, --family=inet6\n"
         "    -s, --stats, statistics\n"
         "    -C, --color\n"
+        "    -b, --batch=FILE  run commands of FILE (one per line) in one\n"
+        "                      request, \"-\" for stdin\n"
         );
 }
 
@@ -59,6 +65,7 @@ static struct dpip_obj *dpip_obj_get(const char *name)
     return NULL;
 }
 
+/* return 1 if nothing to run (help or version shown), -1 on error */
 static int parse_args(int argc, char *argv[], struct dpip_conf *conf)
 {
     int opt;
@@ -73,6 +80,7 @@ static int parse_args(int argc, char *argv[], struct dpip_conf *conf)
         {"color",  no_argument, NULL, 'C'},
         {"interval", required_argument, NULL, 'i'},
         {"count", required_argument, NULL, 'c'},
+        {"batch", required_argument, NULL, 'b'},
         {NULL, 0, NULL, 0},
     };
 
@@ -81,20 +89,20 @@ static int parse_args(int argc, char *argv[], struct dpip_conf *conf)
 
     if (argc <= 1) {
         usage();
-        exit(0);
+        return 1;
     }
 
-    while ((opt = getopt_long(argc, argv, "vhV46f:si:c:C", opts, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "vhV46f:si:c:Cb:", opts, NULL)) != -1) {
         switch (opt) {
         case 'v':
             conf->verbose = 1;
             break;
         case 'h':
             usage();
-            exit(0);
+            return 1;
         case 'V':
             printf(DPIP_NAME"-"DPIP_VERSION"\n");
-            exit(0);
+            return 1;
         case '4':
             conf->af = AF_INET;
             break;
@@ -123,6 +131,9 @@ static int parse_args(int argc, char *argv[], struct dpip_conf *conf)
         case 'C':
                 conf->color = true;
             break;
+        case 'b':
+            conf->batch = optarg;
+            break;
         case '?':
         default:
             fprintf(stderr, "Invalid option: %s\n", argv[optind]);
@@ -130,10 +141,13 @@ static int parse_args(int argc, char *argv[], struct dpip_conf *conf)
         }
     }
 
+    if (conf->batch)
+        return 0;
+
     /* at least two args for: obj and cmd */
     if (optind >= argc) {
         usage();
-        exit(1);
+        return -1;
     }
 
     if (conf->count && !conf->interval)
@@ -149,7 +163,7 @@ static int parse_args(int argc, char *argv[], struct dpip_conf *conf)
             obj->help();
         else
             usage();
-        exit(1);
+        return -1;
     }
 
     if (strcmp(argv[1], "add") == 0)
@@ -170,7 +184,7 @@ static int parse_args(int argc, char *argv[], struct dpip_conf *conf)
         conf->cmd = DPIP_CMD_HELP;
     else {
         fprintf(stderr, "invalid command %s\n", argv[1]);
-        exit(1);
+        return -1;
     }
 
     conf->argc = argc - 2;
@@ -191,47 +205,163 @@ void dpip_unregister_obj(struct dpip_obj *obj)
         list_del(&obj->list);
 }
 
-int main(int argc, char *argv[])
+static int dpip_run(const char *prog, struct dpip_conf *conf)
 {
-    char *prog;
-    struct dpip_conf conf;
     struct dpip_obj *obj;
     int err;
 
-    if ((prog = strchr(argv[0], '/')) != NULL)
-        *prog++ = '\0';
-    else
-        prog = argv[0];
-
-    if (parse_args(argc, argv, &conf) != 0)
-        exit(1);
-
-    if ((obj = dpip_obj_get(conf.obj)) == NULL) {
+    if ((obj = dpip_obj_get(conf->obj)) == NULL) {
         fprintf(stderr, "%s: invalid object, use `-h' for help.\n", prog);
-        exit(1);
+        return EDPVS_INVAL;
     }
 
-    if (conf.cmd == DPIP_CMD_HELP) {
+    if (conf->cmd == DPIP_CMD_HELP) {
         if (obj->help) {
             obj->help();
             return EDPVS_OK;
         }
     }
 
-    if (obj->parse && (err = obj->parse(obj, &conf)) != EDPVS_OK) {
+    if (obj->parse && (err = obj->parse(obj, conf)) != EDPVS_OK) {
         fprintf(stderr, "%s: parse: %s\n", prog, dpvs_strerror(err));
-        exit(1);
+        return err;
     }
 
-    if (obj->check && (err = obj->check(obj, conf.cmd)) != EDPVS_OK) {
+    if (obj->check && (err = obj->check(obj, conf->cmd)) != EDPVS_OK) {
         fprintf(stderr, "%s: check: %s\n", prog, dpvs_strerror(err));
-        exit(1);
+        return err;
     }
 
-    if ((err = obj->do_cmd(obj, conf.cmd, &conf)) != EDPVS_OK) {
+    if ((err = obj->do_cmd(obj, conf->cmd, conf)) != EDPVS_OK) {
         fprintf(stderr, "%s: %s\n", prog, dpvs_strerror(err));
+        return err;
+    }
+
+    return EDPVS_OK;
+}
+
+/*
+ * batch mode: SET msgs of all lines are queued and sent to dpvs in one
+ * request (commands need GET, e.g. "show", flush the queue first), then
+ * errors are reported per line.
+ */
+static int dpip_batch(char *prog, const char *file)
+{
+    struct dpip_conf conf;
+    char *line = NULL, *p, *tok;
+    void *tmp;
+    char *args[DPIP_BATCH_ARGS_MAX + 1];
+    size_t size = 0;
+    int *lineno = NULL, *first = NULL, nline = 0;
+    int *errs = NULL, nerrs = 0;
+    int i, j, n, err, ret = EDPVS_OK;
+    int argc;
+    FILE *fp;
+
+    if (strcmp(file, "-") == 0)
+        fp = stdin;
+    else if ((fp = fopen(file, "r")) == NULL) {
+        fprintf(stderr, "%s: fail to open %s\n", prog, file);
+        return EDPVS_NOTEXIST;
+    }
+
+    if ((err = dpvs_sockopt_batch_begin(0)) != 0) {
+        fprintf(stderr, "%s: fail to start batch: %s\n", prog, dpvs_strerror(err));
+        goto out;
+    }
+
+    for (n = 1; getline(&line, &size, fp) != -1; n++) {
+        if ((p = strchr(line, '#')) != NULL)
+            *p = '\0';
+
+        args[0] = prog;
+        for (argc = 1, tok = strtok(line, " \t\r\n");
+             tok && argc < DPIP_BATCH_ARGS_MAX; tok = strtok(NULL, " \t\r\n"))
+            args[argc++] = strdup(tok); /* getopt may permute argv */
+        args[argc] = NULL;
+        if (argc == 1)
+            continue;
+
+        if ((tmp = realloc(lineno, (nline + 1) * sizeof(int))) != NULL)
+            lineno = tmp;
+        if (tmp && (tmp = realloc(first, (nline + 2) * sizeof(int))) != NULL)
+            first = tmp;
+        if (!tmp) {
+            ret = EDPVS_NOMEM;
+            for (i = 1; i < argc; i++)
+                free(args[i]);
+            break;
+        }
+        lineno[nline] = n;
+        first[nline] = dpvs_sockopt_batch_queued();
+
+        optind = 0;
+        err = parse_args(argc, args, &conf);
+        if (err < 0 || (err == 0 && conf.batch)) {
+            fprintf(stderr, "%s: line %d: invalid command\n", prog, n);
+            ret = EDPVS_INVAL;
+        } else if (err == 0 && (err = dpip_run(prog, &conf)) != EDPVS_OK) {
+            fprintf(stderr, "%s: line %d: failed\n", prog, n);
+            ret = err;
+        }
+        nline++;
+        first[nline] = dpvs_sockopt_batch_queued();
+
+        /* msgs are queued with their own copy of parsed args */
+        for (i = 1; i < argc; i++)
+            free(args[i]);
+    }
+
+    if ((err = dpvs_sockopt_batch_end(&errs, &nerrs)) != 0) {
+        fprintf(stderr, "%s: batch request failed: %s\n", prog, dpvs_strerror(err));
+        ret = err;
+        goto out;
+    }
+
+    for (i = 0; i < nline; i++) {
+        for (j = first[i]; j < first[i + 1] && j < nerrs; j++) {
+            if (errs[j] != EDPVS_OK) {
+                fprintf(stderr, "%s: line %d: %s\n", prog, lineno[i],
+                        dpvs_strerror(errs[j]));
+                ret = errs[j];
+            }
+        }
+    }
+
+out:
+    free(errs);
+    free(first);
+    free(lineno);
+    free(line);
+    if (fp != stdin)
+        fclose(fp);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    char *prog;
+    struct dpip_conf conf;
+
+    if ((prog = strchr(argv[0], '/')) != NULL)
+        *prog++ = '\0';
+    else
+        prog = argv[0];
+
+    switch (parse_args(argc, argv, &conf)) {
+    case 0:
+        break;
+    case 1:
+        exit(0);
+    default:
         exit(1);
     }
 
+    if (conf.batch)
+        exit(dpip_batch(prog, conf.batch) == EDPVS_OK ? 0 : 1);
+
+    if (dpip_run(prog, &conf) != EDPVS_OK)
+        exit(1);
+
     exit(0);
 }
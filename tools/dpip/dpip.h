@@ -40,6 +40,7 @@ struct dpip_conf {
     int         interval;
     int         count;
     bool        color;
+    char        *batch;
     char        *obj;
     dpip_cmd_t  cmd;
     int         argc;
@@ -0,0 +1,300 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * hc.c - native health check of real servers of dpip tool.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "common.h"
+#include "dpip.h"
+#include "utils.h"
+#include "conf/hc.h"
+#include "sockopt.h"
+
+#define HC_DEF_DAMP_HALFLIFE    30  /* seconds */
+
+static const char *hc_type_names[] = {
+    [DP_VS_HC_TCP]          = "tcp",
+    [DP_VS_HC_HTTP]         = "http",
+    [DP_VS_HC_UDP]          = "udp",
+};
+
+static const char *hc_state_names[] = {
+    [DP_VS_HC_ST_UP]        = "up",
+    [DP_VS_HC_ST_DOWN]      = "down",
+    [DP_VS_HC_ST_SUPPRESSED]= "suppressed",
+};
+
+static const char *hc_result_names[] = {
+    [DP_VS_HC_RES_NONE]     = "none",
+    [DP_VS_HC_RES_OK]       = "ok",
+    [DP_VS_HC_RES_TIMEOUT]  = "timeout",
+    [DP_VS_HC_RES_REFUSED]  = "refused",
+    [DP_VS_HC_RES_BAD_STATUS] = "bad-status",
+    [DP_VS_HC_RES_NO_SOURCE] = "no-source",
+    [DP_VS_HC_RES_NO_ROUTE] = "no-route",
+};
+
+static void hc_help(void)
+{
+    fprintf(stderr,
+            "Usage:\n"
+            "    dpip hc add SERVICE type TYPE [ src LIP ] [ port PORT ]\n"
+            "                [ interval MS ] [ timeout MS ] [ rise N ] [ fall N ]\n"
+            "                [ damping SEC ] [ path PATH ] [ status CODE ]\n"
+            "                [ payload STRING ]\n"
+            "    dpip hc del SERVICE\n"
+            "    dpip hc show [ SERVICE ]\n"
+            "Parameters:\n"
+            "    SERVICE := { tcp | udp } VIP VPORT | fwmark MARK\n"
+            "    TYPE    := { tcp | http | udp }\n"
+            "Notes:\n"
+            "    Probes are sent from LIPs with sapool, by route if src is\n"
+            "    not set. damping 0 disables flap damping (default %d).\n"
+            "Examples:\n"
+            "    dpip hc add tcp 192.168.100.100 80 type http path /health\n"
+            "    dpip hc add udp 192.168.100.100 53 type udp payload ping\n"
+            "    dpip hc show\n"
+            "    dpip hc del tcp 192.168.100.100 80\n",
+            HC_DEF_DAMP_HALFLIFE);
+}
+
+static int hc_parse_svc(struct dpip_conf *conf, struct dp_vs_hc_conf *hc)
+{
+    if (strcmp(CURRARG(conf), "fwmark") == 0) {
+        NEXTARG_CHECK(conf, CURRARG(conf));
+        hc->af = AF_INET;
+        hc->fwmark = atoi(CURRARG(conf));
+        return EDPVS_OK;
+    }
+
+    if (strcmp(CURRARG(conf), "tcp") == 0)
+        hc->proto = IPPROTO_TCP;
+    else if (strcmp(CURRARG(conf), "udp") == 0)
+        hc->proto = IPPROTO_UDP;
+    else
+        return EDPVS_INVAL;
+
+    NEXTARG_CHECK(conf, CURRARG(conf));
+    if (inet_pton_try(&hc->af, CURRARG(conf), &hc->vaddr) <= 0) {
+        fprintf(stderr, "invalid vip `%s'\n", CURRARG(conf));
+        return EDPVS_INVAL;
+    }
+
+    NEXTARG_CHECK(conf, CURRARG(conf));
+    hc->vport = htons(atoi(CURRARG(conf)));
+    return EDPVS_OK;
+}
+
+static int hc_parse(struct dpip_obj *obj, struct dpip_conf *conf)
+{
+    struct dp_vs_hc_conf *hc = obj->param;
+    int i;
+
+    memset(hc, 0, sizeof(*hc));
+    hc->damp_halflife = HC_DEF_DAMP_HALFLIFE;
+
+    if (conf->argc <= 0)
+        return EDPVS_OK;
+
+    if (hc_parse_svc(conf, hc) != EDPVS_OK)
+        return EDPVS_INVAL;
+    NEXTARG(conf);
+
+    while (conf->argc > 0) {
+        if (strcmp(CURRARG(conf), "type") == 0) {
+            NEXTARG_CHECK(conf, CURRARG(conf));
+            for (i = 0; i < NELEMS(hc_type_names); i++) {
+                if (hc_type_names[i] &&
+                        strcmp(CURRARG(conf), hc_type_names[i]) == 0)
+                    hc->type = i;
+            }
+            if (!hc->type) {
+                fprintf(stderr, "invalid type `%s'\n", CURRARG(conf));
+                return EDPVS_INVAL;
+            }
+        } else if (strcmp(CURRARG(conf), "src") == 0) {
+            NEXTARG_CHECK(conf, CURRARG(conf));
+            if (inet_pton_try(&hc->saf, CURRARG(conf), &hc->saddr) <= 0) {
+                fprintf(stderr, "invalid src `%s'\n", CURRARG(conf));
+                return EDPVS_INVAL;
+            }
+        } else if (strcmp(CURRARG(conf), "port") == 0) {
+            NEXTARG_CHECK(conf, CURRARG(conf));
+            hc->port = atoi(CURRARG(conf));
+        } else if (strcmp(CURRARG(conf), "interval") == 0) {
+            NEXTARG_CHECK(conf, CURRARG(conf));
+            hc->interval = atoi(CURRARG(conf));
+        } else if (strcmp(CURRARG(conf), "timeout") == 0) {
+            NEXTARG_CHECK(conf, CURRARG(conf));
+            hc->timeout = atoi(CURRARG(conf));
+        } else if (strcmp(CURRARG(conf), "rise") == 0) {
+            NEXTARG_CHECK(conf, CURRARG(conf));
+            hc->rise = atoi(CURRARG(conf));
+        } else if (strcmp(CURRARG(conf), "fall") == 0) {
+            NEXTARG_CHECK(conf, CURRARG(conf));
+            hc->fall = atoi(CURRARG(conf));
+        } else if (strcmp(CURRARG(conf), "damping") == 0) {
+            NEXTARG_CHECK(conf, CURRARG(conf));
+            hc->damp_halflife = atoi(CURRARG(conf));
+        } else if (strcmp(CURRARG(conf), "path") == 0) {
+            NEXTARG_CHECK(conf, CURRARG(conf));
+            if (strlen(CURRARG(conf)) >= sizeof(hc->path)) {
+                fprintf(stderr, "path too long\n");
+                return EDPVS_INVAL;
+            }
+            strcpy(hc->path, CURRARG(conf));
+        } else if (strcmp(CURRARG(conf), "status") == 0) {
+            NEXTARG_CHECK(conf, CURRARG(conf));
+            hc->http_status = atoi(CURRARG(conf));
+        } else if (strcmp(CURRARG(conf), "payload") == 0) {
+            NEXTARG_CHECK(conf, CURRARG(conf));
+            if (strlen(CURRARG(conf)) > sizeof(hc->payload)) {
+                fprintf(stderr, "payload too long\n");
+                return EDPVS_INVAL;
+            }
+            hc->payload_len = strlen(CURRARG(conf));
+            memcpy(hc->payload, CURRARG(conf), hc->payload_len);
+        } else {
+            fprintf(stderr, "too many arguments\n");
+            return EDPVS_INVAL;
+        }
+
+        NEXTARG(conf);
+    }
+
+    return EDPVS_OK;
+}
+
+static int hc_check(const struct dpip_obj *obj, dpip_cmd_t cmd)
+{
+    const struct dp_vs_hc_conf *hc = obj->param;
+
+    switch (cmd) {
+    case DPIP_CMD_ADD:
+        if (!hc->type) {
+            fprintf(stderr, "missing type\n");
+            return EDPVS_INVAL;
+        }
+        /* fall through */
+    case DPIP_CMD_DEL:
+        if (hc->af == AF_UNSPEC) {
+            fprintf(stderr, "missing service\n");
+            return EDPVS_INVAL;
+        }
+        return EDPVS_OK;
+    case DPIP_CMD_SHOW:
+        return EDPVS_OK;
+    default:
+        return EDPVS_NOTSUPP;
+    }
+}
+
+static void hc_entry_dump(const struct dp_vs_hc_entry *ent)
+{
+    char vaddr[64], daddr[64];
+
+    if (ent->fwmark)
+        snprintf(vaddr, sizeof(vaddr), "fwmark:%u", ent->fwmark);
+    else if (!inet_ntop(ent->af, &ent->vaddr, vaddr, sizeof(vaddr)))
+        strcpy(vaddr, "::");
+
+    if (!inet_ntop(ent->daf, &ent->daddr, daddr, sizeof(daddr)))
+        strcpy(daddr, "::");
+
+    printf("%s %s %u -> %s %u type %s %s since %us\n",
+           ent->proto == IPPROTO_UDP ? "udp" : "tcp", vaddr, ntohs(ent->vport),
+           daddr, ntohs(ent->dport),
+           ent->type < NELEMS(hc_type_names) && hc_type_names[ent->type] ?
+           hc_type_names[ent->type] : "unknown",
+           ent->state < NELEMS(hc_state_names) ?
+           hc_state_names[ent->state] : "unknown", ent->since);
+    printf("    last %s rtt %uus srtt %uus probes %lu succ %lu fail %lu "
+           "flaps %u penalty %u lcore %u\n",
+           ent->result < NELEMS(hc_result_names) ?
+           hc_result_names[ent->result] : "unknown",
+           ent->rtt_us, ent->srtt_us, ent->probes, ent->succ, ent->fail,
+           ent->flaps, ent->penalty, ent->cid);
+}
+
+static int hc_show(const struct dp_vs_hc_conf *hc)
+{
+    struct dp_vs_hc_entry_array *array;
+    size_t size;
+    int err, i;
+
+    err = dpvs_getsockopt(SOCKOPT_GET_HC_SHOW, hc, sizeof(*hc),
+                          (void **)&array, &size);
+    if (err != 0)
+        return err;
+
+    if (size < sizeof(*array)
+            || size < sizeof(*array) + \
+                      array->nentry * sizeof(struct dp_vs_hc_entry)) {
+        fprintf(stderr, "corrupted response.\n");
+        dpvs_sockopt_msg_free(array);
+        return EDPVS_INVAL;
+    }
+
+    for (i = 0; i < array->nentry; i++)
+        hc_entry_dump(&array->entries[i]);
+
+    dpvs_sockopt_msg_free(array);
+    return EDPVS_OK;
+}
+
+static int hc_do_cmd(struct dpip_obj *obj, dpip_cmd_t cmd,
+                     struct dpip_conf *conf)
+{
+    struct dp_vs_hc_conf *hc = obj->param;
+
+    switch (cmd) {
+    case DPIP_CMD_ADD:
+        return dpvs_setsockopt(SOCKOPT_SET_HC_ADD, hc, sizeof(*hc));
+    case DPIP_CMD_DEL:
+        return dpvs_setsockopt(SOCKOPT_SET_HC_DEL, hc, sizeof(*hc));
+    case DPIP_CMD_SHOW:
+        return hc_show(hc);
+    default:
+        return EDPVS_NOTSUPP;
+    }
+}
+
+static struct dp_vs_hc_conf hc_param;
+
+static struct dpip_obj dpip_hc = {
+    .name       = "hc",
+    .param      = &hc_param,
+
+    .help       = hc_help,
+    .parse      = hc_parse,
+    .check      = hc_check,
+    .do_cmd     = hc_do_cmd,
+};
+
+static void __init hc_init(void)
+{
+    dpip_register_obj(&dpip_hc);
+}
+
+static void __exit hc_exit(void)
+{
+    dpip_unregister_obj(&dpip_hc);
+}
@@ -0,0 +1,166 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * icmp.c - ICMP error rate limit of dpip tool.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "dpip.h"
+#include "sockopt.h"
+#include "conf/icmp.h"
+
+enum {
+    ICMP_STATS_CPU_ALL      = -1,
+    ICMP_STATS_CPU_TOTAL    = -2,
+};
+
+struct icmp_conf {
+    int stats_cpu;
+};
+
+static struct icmp_conf icmp_conf;
+
+static void icmp_help(void)
+{
+    fprintf(stderr,
+            "Usage:\n"
+            "    dpip icmp show [ cpu CPU | all | total ]\n"
+            "Notes:\n"
+            "    Shows the rate limit of ICMP/ICMPv6 errors, set by icmp_defs\n"
+            "    of the config file.\n"
+            "Examples:\n"
+            "    dpip icmp show\n"
+            "    dpip icmp show cpu 2\n");
+}
+
+static int icmp_parse(struct dpip_obj *obj, struct dpip_conf *cf)
+{
+    struct icmp_conf *conf = obj->param;
+
+    memset(conf, 0, sizeof(*conf));
+    conf->stats_cpu = ICMP_STATS_CPU_TOTAL;
+
+    while (cf->argc > 0) {
+        if (strcmp(CURRARG(cf), "cpu") == 0) {
+            NEXTARG_CHECK(cf, CURRARG(cf));
+
+            conf->stats_cpu = atoi(CURRARG(cf));
+            if (conf->stats_cpu < 0 || conf->stats_cpu >= DPVS_MAX_LCORE) {
+                fprintf(stderr, "bad cpu id `%s'\n", CURRARG(cf));
+                return EDPVS_INVAL;
+            }
+        } else if (strcmp(CURRARG(cf), "all") == 0) {
+            conf->stats_cpu = ICMP_STATS_CPU_ALL;
+        } else if (strcmp(CURRARG(cf), "total") == 0) {
+            conf->stats_cpu = ICMP_STATS_CPU_TOTAL;
+        } else {
+            fprintf(stderr, "unknow argument `%s'\n", CURRARG(cf));
+            return EDPVS_INVAL;
+        }
+
+        NEXTARG(cf);
+    }
+
+    return EDPVS_OK;
+}
+
+static void icmp_rl_stats_dump(const char *title,
+                               const struct icmp_rl_stats *stats)
+{
+    printf("%s:\n", title);
+    printf("    %-16s%lu\n", "passed", stats->passed);
+    printf("    %-16s%lu\n", "host-limited", stats->host_limited);
+    printf("    %-16s%lu\n", "global-limited", stats->global_limited);
+    printf("    %-16s%lu\n", "evicted", stats->evicted);
+}
+
+static int icmp_do_cmd(struct dpip_obj *obj, dpip_cmd_t cmd,
+                       struct dpip_conf *conf)
+{
+    const struct icmp_conf *cf = obj->param;
+    struct icmp_rl_param *param;
+    char cpu[16];
+    size_t size;
+    int err, i;
+
+    if (cmd != DPIP_CMD_SHOW)
+        return EDPVS_NOTSUPP;
+
+    err = dpvs_getsockopt(SOCKOPT_GET_ICMP_RL, NULL, 0, (void **)&param, &size);
+    if (err != EDPVS_OK)
+        return err;
+
+    if (size != sizeof(*param)) {
+        fprintf(stderr, "corrupted response.\n");
+        dpvs_sockopt_msg_free(param);
+        return EDPVS_INVAL;
+    }
+
+    printf("rate limit (per cpu): ratelimit %ums burst %u ratemask 0x%x "
+           "prefix /%u /%u msgs-per-sec %u msgs-burst %u buckets %u\n",
+           param->ratelimit, param->ratelimit_burst, param->ratemask,
+           param->prefix_len, param->prefix6_len, param->msgs_per_sec,
+           param->msgs_burst, param->buckets);
+
+    switch (cf->stats_cpu) {
+    case ICMP_STATS_CPU_TOTAL:
+        icmp_rl_stats_dump("Total", &param->stats);
+        break;
+    case ICMP_STATS_CPU_ALL:
+        icmp_rl_stats_dump("All", &param->stats);
+
+        for (i = 0; i < NELEMS(param->stats_cpus); i++) {
+            if (!param->stats_cpus[i].passed &&
+                !param->stats_cpus[i].host_limited &&
+                !param->stats_cpus[i].global_limited)
+                continue;
+            snprintf(cpu, sizeof(cpu), "cpu %d", i);
+            icmp_rl_stats_dump(cpu, &param->stats_cpus[i]);
+        }
+        break;
+    default:
+        snprintf(cpu, sizeof(cpu), "cpu %d", cf->stats_cpu);
+        icmp_rl_stats_dump(cpu, &param->stats_cpus[cf->stats_cpu]);
+        break;
+    }
+
+    dpvs_sockopt_msg_free(param);
+
+    return EDPVS_OK;
+}
+
+static struct dpip_obj dpip_icmp = {
+    .name       = "icmp",
+    .param      = &icmp_conf,
+
+    .help       = icmp_help,
+    .parse      = icmp_parse,
+    .do_cmd     = icmp_do_cmd,
+};
+
+static void __init icmp_init(void)
+{
+    dpip_register_obj(&dpip_icmp);
+}
+
+static void __exit icmp_exit(void)
+{
+    dpip_unregister_obj(&dpip_icmp);
+}
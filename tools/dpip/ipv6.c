@@ -37,6 +37,7 @@ enum {
 
 struct ipv6_conf {
     int stats_cpu;
+    bool frag;
 };
 
 static struct ipv6_conf ipv6_conf;
@@ -44,13 +45,14 @@ static struct ipv6_conf ipv6_conf;
 static void ipv6_help(void)
 {
     fprintf(stderr, "Usage:\n");
-    fprintf(stderr, "    dpip ipv6 show [ cpu CPU | all | total ]\n");
+    fprintf(stderr, "    dpip ipv6 show [ frag ] [ cpu CPU | all | total ]\n");
     fprintf(stderr, "\n");
     fprintf(stderr, "Example:\n");
     fprintf(stderr, "    dpip ipv6 show\n");
     fprintf(stderr, "    dpip ipv6 show total\n");
     fprintf(stderr, "    dpip ipv6 show all\n");
     fprintf(stderr, "    dpip ipv6 show cpu 6\n");
+    fprintf(stderr, "    dpip ipv6 show frag all\n");
 }
 
 static int ipv6_parse(struct dpip_obj *obj, struct dpip_conf *cf)
@@ -73,6 +75,8 @@ static int ipv6_parse(struct dpip_obj *obj, struct dpip_conf *cf)
             conf->stats_cpu = IPV6_STATS_CPU_ALL;
         } else if (strcmp(CURRARG(cf), "total") == 0) {
             conf->stats_cpu = IPV6_STATS_CPU_TOTAL;
+        } else if (strcmp(CURRARG(cf), "frag") == 0) {
+            conf->frag = true;
         } else {
             fprintf(stderr, "unknow argument `%s'\n", CURRARG(cf));
             return EDPVS_INVAL;
@@ -84,6 +88,72 @@ static int ipv6_parse(struct dpip_obj *obj, struct dpip_conf *cf)
     return EDPVS_OK;
 }
 
+static void ipv6_frag_stats_dump(const char *title,
+                                 const struct ip6_frag_stats *stats)
+{
+    printf("%s:\n", title);
+    printf("    %-16s%u\n", "in-use", stats->use_entries);
+    printf("    %-16s%lu\n", "added", stats->add_num);
+    printf("    %-16s%lu\n", "deleted", stats->del_num);
+    printf("    %-16s%lu\n", "timeout-reused", stats->reuse_num);
+    printf("    %-16s%lu\n", "failed", stats->fail_total);
+    printf("    %-16s%lu\n", "table-full", stats->fail_nospace);
+}
+
+static int ipv6_frag_show(const struct ipv6_conf *cf)
+{
+    struct ip6_frag_param *param;
+    char cpu[16];
+    size_t size;
+    int err, i;
+
+    err = dpvs_getsockopt(SOCKOPT_IP6_FRAG, NULL, 0, (void **)&param, &size);
+    if (err != EDPVS_OK)
+        return EDPVS_INVAL;
+
+    if (size != sizeof(*param)) {
+        fprintf(stderr, "corrupted response.\n");
+        dpvs_sockopt_msg_free(param);
+        return EDPVS_INVAL;
+    }
+
+    printf("reassembly limits (per cpu): buckets %u bucket-entries %u "
+           "max-entries %u max-frags %u ttl %us\n",
+           param->buckets, param->bucket_entries, param->max_entries,
+           param->max_frags, param->ttl);
+
+    switch (cf->stats_cpu) {
+    case IPV6_STATS_CPU_TOTAL:
+        ipv6_frag_stats_dump("Total", &param->stats);
+        break;
+    case IPV6_STATS_CPU_ALL:
+        ipv6_frag_stats_dump("All", &param->stats);
+
+        for (i = 0; i < NELEMS(param->stats_cpus); i++) {
+            if (!param->stats_cpus[i].add_num &&
+                !param->stats_cpus[i].fail_total)
+                continue;
+            snprintf(cpu, sizeof(cpu), "cpu %d", i);
+            ipv6_frag_stats_dump(cpu, &param->stats_cpus[i]);
+        }
+        break;
+    default:
+        if (cf->stats_cpu < 0 ||
+            cf->stats_cpu >= NELEMS(param->stats_cpus)) {
+            fprintf(stderr, "bad cpu id %d.\n", cf->stats_cpu);
+            break;
+        }
+
+        snprintf(cpu, sizeof(cpu), "cpu %d", cf->stats_cpu);
+        ipv6_frag_stats_dump(cpu, &param->stats_cpus[cf->stats_cpu]);
+        break;
+    }
+
+    dpvs_sockopt_msg_free(param);
+
+    return EDPVS_OK;
+}
+
 static int ipv6_do_cmd(struct dpip_obj *obj, dpip_cmd_t cmd,
                        struct dpip_conf *conf)
 {
@@ -96,6 +166,9 @@ static int ipv6_do_cmd(struct dpip_obj *obj, dpip_cmd_t cmd,
     if (cmd != DPIP_CMD_SHOW)
         return EDPVS_NOTSUPP;
 
+    if (cf->frag)
+        return ipv6_frag_show(cf);
+
     err = dpvs_getsockopt(SOCKOPT_IP6_STATS, NULL, 0, (void **)&stats, &size);
     if (err != EDPVS_OK)
         return EDPVS_INVAL;
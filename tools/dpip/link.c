@@ -513,7 +513,7 @@ static int dump_cpu_basic(lcoreid_t cid)
 
 static int dump_cpu_stats(lcoreid_t cid)
 {
-    int err;
+    int err, i;
     size_t len = 0;
     netif_lcore_stats_get_t get, *p_get = NULL;
 
@@ -540,11 +540,51 @@ static int dump_cpu_stats(lcoreid_t cid)
     printf("    %-20lu%-20lu%-20lu%-20lu\n",
             get.ipackets, get.ibytes, get.opackets, get.obytes);
 
+    printf("    %-20s%-20s\n", "txretry", "txdrop");
+    printf("    %-20lu%-20lu\n", get.txretry, get.txdrop);
+
+    for (i = 0; i < get.ntxq && i < NELEMS(get.txqs); i++)
+        printf("    port %u tx%u: retried %lu dropped %lu\n",
+               get.txqs[i].pid, get.txqs[i].qid,
+               get.txqs[i].retried, get.txqs[i].dropped);
+
     return EDPVS_OK;
 }
 
 static int dump_cpu_verbose(lcoreid_t cid)
 {
+    int i, err;
+    size_t len = 0;
+    netif_lcore_numa_get_t *p_get = NULL;
+    struct netif_lcore_numa_entry *ent;
+
+    err = dpvs_getsockopt(SOCKOPT_NETIF_GET_LCORE_NUMA, &cid, sizeof(cid),
+        (void **)&p_get, &len);
+    if (err != EDPVS_OK || !p_get || !len)
+        return err;
+    assert(len >= sizeof(netif_lcore_numa_get_t));
+
+    printf("    --- numa placement (socket %d) ---\n", p_get->socket_id);
+    printf("    %-20s%-16s%-16s%-16s\n", "queue", "nic-socket",
+            "mbufpool-socket", "placement");
+    for (i = 0; i < p_get->nentries; i++) {
+        char qname[32];
+
+        ent = &p_get->entries[i];
+        snprintf(qname, sizeof(qname), "%s:%s%d", ent->port_name,
+                ent->is_rx ? "rx" : "tx", ent->qid);
+        printf("    %-20s%-16d%-16d%-16s\n", qname, ent->port_socket,
+                ent->pool_socket,
+                (ent->port_socket != p_get->socket_id ||
+                 ent->pool_socket != p_get->socket_id) ? "remote" : "local");
+    }
+    printf("    %-20s%-16s%-16d%-16s\n", "arp_ring", "--",
+            p_get->arp_ring_socket,
+            p_get->arp_ring_socket != p_get->socket_id ? "remote" : "local");
+    printf("    remote placements: %d\n", p_get->nremote);
+
+    dpvs_sockopt_msg_free(p_get);
+
     return EDPVS_OK;
 }
 
@@ -775,6 +815,26 @@ static int link_show(struct link_param *param)
                         }
                     }
                 }
+
+                if (lcores.kni_lcore_num > 0) {
+                    printf("<< KNI I/O >>\n");
+                    err = link_cpu_show(lcores.kni_lcore_id, param);
+                    if (err) {
+                        fprintf(stderr, "Fail to get information for cpu%d\n",
+                                lcores.kni_lcore_id);
+                        ret = err;
+                    }
+                }
+
+                if (lcores.neigh_lcore_num > 0) {
+                    printf("<< Neighbour Relay >>\n");
+                    err = link_cpu_show(lcores.neigh_lcore_id, param);
+                    if (err) {
+                        fprintf(stderr, "Fail to get information for cpu%d\n",
+                                lcores.neigh_lcore_id);
+                        ret = err;
+                    }
+                }
                 return ret;
             }
             break;
@@ -0,0 +1,170 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * offload.c - flow offload of dpip tool.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "dpip.h"
+#include "utils.h"
+#include "sockopt.h"
+#include "conf/offload.h"
+
+enum {
+    OFFLOAD_STATS_CPU_ALL       = -1,
+    OFFLOAD_STATS_CPU_TOTAL     = -2,
+};
+
+static int offload_stats_cpu = OFFLOAD_STATS_CPU_TOTAL;
+
+static const char *offload_backend_names[] = {
+    [DP_VS_OFFLOAD_RTE_FLOW]    = "rte_flow",
+    [DP_VS_OFFLOAD_SW]          = "sw",
+};
+
+static void offload_help(void)
+{
+    fprintf(stderr,
+            "Usage:\n"
+            "    dpip offload show [ cpu CPU | all | total ]\n"
+            "Notes:\n"
+            "    Shows NIC rules of hot DR/tunnel flows per cpu, set by\n"
+            "    ipvs_defs:flow_offload of the config file. \"hits\" counts\n"
+            "    packets found their conns by rule marks.\n"
+            "Examples:\n"
+            "    dpip offload show\n"
+            "    dpip offload show all\n");
+}
+
+static int offload_parse(struct dpip_obj *obj, struct dpip_conf *cf)
+{
+    int *stats_cpu = obj->param;
+
+    *stats_cpu = OFFLOAD_STATS_CPU_TOTAL;
+
+    while (cf->argc > 0) {
+        if (strcmp(CURRARG(cf), "cpu") == 0) {
+            NEXTARG_CHECK(cf, CURRARG(cf));
+
+            *stats_cpu = atoi(CURRARG(cf));
+            if (*stats_cpu < 0 || *stats_cpu >= DPVS_MAX_LCORE) {
+                fprintf(stderr, "bad cpu id `%s'\n", CURRARG(cf));
+                return EDPVS_INVAL;
+            }
+        } else if (strcmp(CURRARG(cf), "all") == 0) {
+            *stats_cpu = OFFLOAD_STATS_CPU_ALL;
+        } else if (strcmp(CURRARG(cf), "total") == 0) {
+            *stats_cpu = OFFLOAD_STATS_CPU_TOTAL;
+        } else {
+            fprintf(stderr, "unknow argument `%s'\n", CURRARG(cf));
+            return EDPVS_INVAL;
+        }
+
+        NEXTARG(cf);
+    }
+
+    return EDPVS_OK;
+}
+
+static void offload_stats_dump(const char *title,
+                               const struct dp_vs_offload_stats *stats)
+{
+    printf("%s:\n", title);
+    printf("    %-16s%u/%u\n", "rules", stats->used, stats->slots);
+    printf("    %-16s%lu\n", "added", stats->added);
+    printf("    %-16s%lu\n", "removed", stats->removed);
+    printf("    %-16s%lu\n", "evicted", stats->evicted);
+    printf("    %-16s%lu\n", "failed", stats->failed);
+    printf("    %-16s%lu\n", "hits", stats->hits);
+    printf("    %-16s%lu\n", "stale", stats->stale);
+}
+
+static int offload_do_cmd(struct dpip_obj *obj, dpip_cmd_t cmd,
+                          struct dpip_conf *conf)
+{
+    int stats_cpu = *(int *)obj->param;
+    struct dp_vs_offload_param *param;
+    char cpu[16];
+    size_t size;
+    int err, i;
+
+    if (cmd != DPIP_CMD_SHOW)
+        return EDPVS_NOTSUPP;
+
+    err = dpvs_getsockopt(SOCKOPT_GET_OFFLOAD, NULL, 0,
+                          (void **)&param, &size);
+    if (err != EDPVS_OK)
+        return err;
+
+    if (size != sizeof(*param)) {
+        fprintf(stderr, "corrupted response.\n");
+        dpvs_sockopt_msg_free(param);
+        return EDPVS_INVAL;
+    }
+
+    printf("flow offload %s: backend %s max-rules %u threshold %u\n",
+           param->enable ? "on" : "off",
+           param->backend < NELEMS(offload_backend_names) ?
+           offload_backend_names[param->backend] : "unknown",
+           param->max_rules, param->threshold);
+
+    switch (stats_cpu) {
+    case OFFLOAD_STATS_CPU_TOTAL:
+        offload_stats_dump("Total", &param->stats);
+        break;
+    case OFFLOAD_STATS_CPU_ALL:
+        offload_stats_dump("All", &param->stats);
+
+        for (i = 0; i < NELEMS(param->stats_cpus); i++) {
+            if (!param->stats_cpus[i].slots)
+                continue;
+            snprintf(cpu, sizeof(cpu), "cpu %d", i);
+            offload_stats_dump(cpu, &param->stats_cpus[i]);
+        }
+        break;
+    default:
+        snprintf(cpu, sizeof(cpu), "cpu %d", stats_cpu);
+        offload_stats_dump(cpu, &param->stats_cpus[stats_cpu]);
+        break;
+    }
+
+    dpvs_sockopt_msg_free(param);
+
+    return EDPVS_OK;
+}
+
+static struct dpip_obj dpip_offload = {
+    .name       = "offload",
+    .param      = &offload_stats_cpu,
+
+    .help       = offload_help,
+    .parse      = offload_parse,
+    .do_cmd     = offload_do_cmd,
+};
+
+static void __init offload_init(void)
+{
+    dpip_register_obj(&dpip_offload);
+}
+
+static void __exit offload_exit(void)
+{
+    dpip_unregister_obj(&dpip_offload);
+}
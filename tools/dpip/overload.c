@@ -0,0 +1,220 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * overload.c - overload protection of dpip tool.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "common.h"
+#include "dpip.h"
+#include "utils.h"
+#include "sockopt.h"
+#include "conf/overload.h"
+
+enum {
+    OVERLOAD_STATS_CPU_ALL      = -1,
+    OVERLOAD_STATS_CPU_TOTAL    = -2,
+};
+
+struct overload_conf {
+    int stats_cpu;
+    struct dp_vs_overload_param param;
+};
+
+static struct overload_conf overload_conf;
+
+static const char *overload_policy_names[] = {
+    [DP_VS_SHED_DROP]       = "drop",
+    [DP_VS_SHED_RST]        = "rst",
+    [DP_VS_SHED_SYNCOOKIE]  = "syncookie",
+};
+
+static void overload_help(void)
+{
+    fprintf(stderr,
+            "Usage:\n"
+            "    dpip overload show [ SERVICE ] [ cpu CPU | all | total ]\n"
+            "Parameters:\n"
+            "    SERVICE := { tcp | udp } VIP VPORT | fwmark MARK\n"
+            "Notes:\n"
+            "    Shows load and shedding of new flows per cpu, set by\n"
+            "    ipvs_defs:overload of the config file. \"svc-shed\" counts\n"
+            "    new flows of SERVICE shed, if given.\n"
+            "Examples:\n"
+            "    dpip overload show\n"
+            "    dpip overload show tcp 192.168.100.100 80 all\n");
+}
+
+static int overload_parse_svc(struct dpip_conf *cf,
+                              struct dp_vs_overload_param *param)
+{
+    if (strcmp(CURRARG(cf), "fwmark") == 0) {
+        NEXTARG_CHECK(cf, CURRARG(cf));
+        param->af = AF_INET;
+        param->fwmark = atoi(CURRARG(cf));
+        return EDPVS_OK;
+    }
+
+    if (strcmp(CURRARG(cf), "tcp") == 0)
+        param->proto = IPPROTO_TCP;
+    else if (strcmp(CURRARG(cf), "udp") == 0)
+        param->proto = IPPROTO_UDP;
+
+    NEXTARG_CHECK(cf, CURRARG(cf));
+    if (inet_pton_try(&param->af, CURRARG(cf), &param->vaddr) <= 0) {
+        fprintf(stderr, "invalid vip `%s'\n", CURRARG(cf));
+        return EDPVS_INVAL;
+    }
+
+    NEXTARG_CHECK(cf, CURRARG(cf));
+    param->vport = htons(atoi(CURRARG(cf)));
+    return EDPVS_OK;
+}
+
+static int overload_parse(struct dpip_obj *obj, struct dpip_conf *cf)
+{
+    struct overload_conf *conf = obj->param;
+
+    memset(conf, 0, sizeof(*conf));
+    conf->stats_cpu = OVERLOAD_STATS_CPU_TOTAL;
+
+    while (cf->argc > 0) {
+        if (strcmp(CURRARG(cf), "tcp") == 0 ||
+                strcmp(CURRARG(cf), "udp") == 0 ||
+                strcmp(CURRARG(cf), "fwmark") == 0) {
+            if (overload_parse_svc(cf, &conf->param) != EDPVS_OK)
+                return EDPVS_INVAL;
+        } else if (strcmp(CURRARG(cf), "cpu") == 0) {
+            NEXTARG_CHECK(cf, CURRARG(cf));
+
+            conf->stats_cpu = atoi(CURRARG(cf));
+            if (conf->stats_cpu < 0 || conf->stats_cpu >= DPVS_MAX_LCORE) {
+                fprintf(stderr, "bad cpu id `%s'\n", CURRARG(cf));
+                return EDPVS_INVAL;
+            }
+        } else if (strcmp(CURRARG(cf), "all") == 0) {
+            conf->stats_cpu = OVERLOAD_STATS_CPU_ALL;
+        } else if (strcmp(CURRARG(cf), "total") == 0) {
+            conf->stats_cpu = OVERLOAD_STATS_CPU_TOTAL;
+        } else {
+            fprintf(stderr, "unknow argument `%s'\n", CURRARG(cf));
+            return EDPVS_INVAL;
+        }
+
+        NEXTARG(cf);
+    }
+
+    return EDPVS_OK;
+}
+
+static void overload_stats_dump(const char *title, bool svc, bool total,
+                                const struct dp_vs_overload_stats *stats)
+{
+    printf("%s:\n", title);
+    if (total) {
+        printf("    %-16s%u\n", "overloaded", stats->overloaded);
+    } else {
+        printf("    %-16s%s\n", "state", stats->overloaded ? "overloaded" : "normal");
+        printf("    %-16s%u%%\n", "busy", stats->busy);
+        printf("    %-16s%u%%\n", "rxq", stats->rxq);
+    }
+    printf("    %-16s%lu\n", "enters", stats->enters);
+    printf("    %-16s%lu\n", "overload-ms", stats->overload_ms);
+    printf("    %-16s%lu\n", "shed", stats->shed);
+    printf("    %-16s%lu\n", "rst", stats->rst);
+    printf("    %-16s%lu\n", "syncookie", stats->syncookie);
+    if (svc)
+        printf("    %-16s%lu\n", "svc-shed", stats->svc_shed);
+}
+
+static int overload_do_cmd(struct dpip_obj *obj, dpip_cmd_t cmd,
+                           struct dpip_conf *conf)
+{
+    const struct overload_conf *cf = obj->param;
+    struct dp_vs_overload_param *param;
+    bool svc = cf->param.af != AF_UNSPEC;
+    char cpu[16];
+    size_t size;
+    int err, i;
+
+    if (cmd != DPIP_CMD_SHOW)
+        return EDPVS_NOTSUPP;
+
+    err = dpvs_getsockopt(SOCKOPT_GET_OVERLOAD, &cf->param, sizeof(cf->param),
+                          (void **)&param, &size);
+    if (err != EDPVS_OK)
+        return err;
+
+    if (size != sizeof(*param)) {
+        fprintf(stderr, "corrupted response.\n");
+        dpvs_sockopt_msg_free(param);
+        return EDPVS_INVAL;
+    }
+
+    printf("overload protection %s: policy %s busy %u%%/%u%% rxq %u%%/%u%% "
+           "hold %ums\n", param->enable ? "on" : "off",
+           param->policy < NELEMS(overload_policy_names) ?
+           overload_policy_names[param->policy] : "unknown",
+           param->busy_high, param->busy_low, param->rxq_high,
+           param->rxq_low, param->hold_ms);
+
+    switch (cf->stats_cpu) {
+    case OVERLOAD_STATS_CPU_TOTAL:
+        overload_stats_dump("Total", svc, true, &param->stats);
+        break;
+    case OVERLOAD_STATS_CPU_ALL:
+        overload_stats_dump("All", svc, true, &param->stats);
+
+        for (i = 0; i < NELEMS(param->stats_cpus); i++) {
+            if (!param->stats_cpus[i].busy && !param->stats_cpus[i].enters)
+                continue;
+            snprintf(cpu, sizeof(cpu), "cpu %d", i);
+            overload_stats_dump(cpu, svc, false, &param->stats_cpus[i]);
+        }
+        break;
+    default:
+        snprintf(cpu, sizeof(cpu), "cpu %d", cf->stats_cpu);
+        overload_stats_dump(cpu, svc, false, &param->stats_cpus[cf->stats_cpu]);
+        break;
+    }
+
+    dpvs_sockopt_msg_free(param);
+
+    return EDPVS_OK;
+}
+
+static struct dpip_obj dpip_overload = {
+    .name       = "overload",
+    .param      = &overload_conf,
+
+    .help       = overload_help,
+    .parse      = overload_parse,
+    .do_cmd     = overload_do_cmd,
+};
+
+static void __init overload_init(void)
+{
+    dpip_register_obj(&dpip_overload);
+}
+
+static void __exit overload_exit(void)
+{
+    dpip_unregister_obj(&dpip_overload);
+}
@@ -0,0 +1,315 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * prof.c - sampled latency histograms of dpip tool.
+ *
+ * output is one "key=value" record per line, for scripts.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "dpip.h"
+#include "utils.h"
+#include "conf/prof.h"
+#include "sockopt.h"
+
+struct prof_param {
+    int         enable;     /* -1: not set */
+    uint32_t    sample;     /* 0: not set */
+    int         cid;        /* -1: all lcores */
+};
+
+static void prof_help(void)
+{
+    fprintf(stderr,
+            "Usage:\n"
+            "    dpip prof show [ lcore CID ]\n"
+            "    dpip prof flush\n"
+            "    dpip prof set { on | off } [ sample N ]\n"
+            "Parameters:\n"
+            "    N       := 1 of N calls per lcore is timed, power of 2\n"
+            "Notes:\n"
+            "    Percentiles are estimated from log-linear histograms,\n"
+            "    with an error below 25%%. Stage timing is inclusive of\n"
+            "    nested stages.\n"
+            "Examples:\n"
+            "    dpip prof set on sample 64\n"
+            "    dpip prof show lcore 1\n"
+            "    dpip prof flush\n"
+            "    dpip prof set off\n");
+}
+
+static int prof_parse(struct dpip_obj *obj, struct dpip_conf *conf)
+{
+    struct prof_param *param = obj->param;
+    int sample;
+
+    memset(param, 0, sizeof(*param));
+    param->enable = -1;
+    param->cid = -1;
+
+    while (conf->argc > 0) {
+        if (strcmp(conf->argv[0], "on") == 0) {
+            param->enable = 1;
+        } else if (strcmp(conf->argv[0], "off") == 0) {
+            param->enable = 0;
+        } else if (strcmp(conf->argv[0], "sample") == 0) {
+            NEXTARG_CHECK(conf, conf->argv[0]);
+            sample = atoi(conf->argv[0]);
+            if (sample <= 0 || (sample & (sample - 1)) != 0) {
+                fprintf(stderr, "sample must be a power of 2\n");
+                return EDPVS_INVAL;
+            }
+            param->sample = sample;
+        } else if (strcmp(conf->argv[0], "lcore") == 0) {
+            NEXTARG_CHECK(conf, conf->argv[0]);
+            param->cid = atoi(conf->argv[0]);
+            if (param->cid < 0 || param->cid > 255)
+                return EDPVS_INVAL;
+        } else {
+            fprintf(stderr, "too many arguments\n");
+            return EDPVS_INVAL;
+        }
+
+        NEXTARG(conf);
+    }
+
+    return EDPVS_OK;
+}
+
+static int prof_check(const struct dpip_obj *obj, dpip_cmd_t cmd)
+{
+    const struct prof_param *param = obj->param;
+
+    switch (cmd) {
+    case DPIP_CMD_SET:
+        if (param->enable < 0) {
+            fprintf(stderr, "missing on|off\n");
+            return EDPVS_INVAL;
+        }
+        return EDPVS_OK;
+    case DPIP_CMD_SHOW:
+    case DPIP_CMD_FLUSH:
+        return EDPVS_OK;
+    default:
+        return EDPVS_NOTSUPP;
+    }
+}
+
+/* merged histogram of a kind/id over lcores */
+struct prof_sum {
+    uint8_t     kind;
+    uint8_t     id;
+    char        name[DPVS_PROF_NAME_LEN];
+    uint64_t    count;
+    uint64_t    cycles;
+    uint64_t    max;
+    uint64_t    buckets[DPVS_PROF_HIST_BUCKETS];
+};
+
+/* lower bound of the bucket holding quantile @q, capped by @max */
+static uint64_t prof_quantile(const uint64_t *buckets, uint64_t count,
+                              uint64_t max, double q)
+{
+    uint64_t rank, seen = 0;
+    int i;
+
+    if (!count)
+        return 0;
+
+    rank = (uint64_t)(q * count);
+    if (rank >= count)
+        rank = count - 1;
+
+    for (i = 0; i < DPVS_PROF_HIST_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen > rank)
+            break;
+    }
+    if (i >= DPVS_PROF_HIST_BUCKETS)
+        return max;
+
+    return dpvs_prof_hist_lower(i) < max ? dpvs_prof_hist_lower(i) : max;
+}
+
+static const char *prof_kind_name(int kind)
+{
+    switch (kind) {
+    case DPVS_PROF_KIND_STAGE:
+        return "stage";
+    case DPVS_PROF_KIND_JOB:
+        return "job";
+    case DPVS_PROF_KIND_LOOP:
+        return "loop";
+    default:
+        return "<unknow>";
+    }
+}
+
+static void prof_dump(const char *lcore, int kind, const char *name,
+                      uint64_t count, uint64_t cycles, uint64_t max,
+                      const uint64_t *buckets, uint64_t tsc_hz)
+{
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    static const char *qnames[] = { "p50", "p90", "p99", "p999" };
+    double ns_per_cycle = tsc_hz ? 1E9 / tsc_hz : 0.0;
+    uint64_t val;
+    int i;
+
+    printf("lcore=%s %s=%s count=%lu avg=%.1f", lcore, prof_kind_name(kind),
+           name, count, count ? (double)cycles / count : 0.0);
+    for (i = 0; i < NELEMS(quantiles); i++) {
+        val = prof_quantile(buckets, count, max, quantiles[i]);
+        printf(" %s=%lu", qnames[i], val);
+    }
+    printf(" max=%lu", max);
+
+    printf(" avg_ns=%.1f", count ? (double)cycles / count * ns_per_cycle : 0.0);
+    for (i = 0; i < NELEMS(quantiles); i++) {
+        val = prof_quantile(buckets, count, max, quantiles[i]);
+        printf(" %s_ns=%.1f", qnames[i], val * ns_per_cycle);
+    }
+    printf(" max_ns=%.1f\n", max * ns_per_cycle);
+}
+
+static struct prof_sum *prof_sum_get(struct prof_sum *sums, int *nsum,
+                                     const struct dp_vs_prof_hist *h)
+{
+    int i;
+
+    for (i = 0; i < *nsum; i++) {
+        if (sums[i].kind == h->kind && sums[i].id == h->id)
+            return &sums[i];
+    }
+
+    memset(&sums[i], 0, sizeof(sums[i]));
+    sums[i].kind = h->kind;
+    sums[i].id = h->id;
+    snprintf(sums[i].name, sizeof(sums[i].name), "%s", h->name);
+    (*nsum)++;
+    return &sums[i];
+}
+
+static int prof_show(const struct prof_param *param)
+{
+    struct dp_vs_prof_conf_array *array;
+    const struct dp_vs_prof_hist *h;
+    struct prof_sum *sums, *sum;
+    uint64_t buckets[DPVS_PROF_HIST_BUCKETS];
+    char lcore[8];
+    int err, i, j, nsum = 0;
+    size_t size;
+
+    err = dpvs_getsockopt(SOCKOPT_GET_PROF_SHOW, NULL, 0,
+                          (void **)&array, &size);
+    if (err != 0)
+        return err;
+
+    if (size < sizeof(*array)
+            || size < sizeof(*array) + \
+                      array->nhist * sizeof(struct dp_vs_prof_hist)) {
+        fprintf(stderr, "corrupted response.\n");
+        dpvs_sockopt_msg_free(array);
+        return EDPVS_INVAL;
+    }
+
+    printf("enabled=%s sample=%u tsc_hz=%lu\n",
+           array->enabled ? "on" : "off", array->sample, array->tsc_hz);
+
+    sums = calloc(array->nhist + 1, sizeof(*sums));
+    if (!sums) {
+        dpvs_sockopt_msg_free(array);
+        return EDPVS_NOMEM;
+    }
+
+    for (i = 0; i < array->nhist; i++) {
+        h = &array->hists[i];
+        if (param->cid >= 0 && h->cid != param->cid)
+            continue;
+
+        /* copy out of the packed struct */
+        memcpy(buckets, h->buckets, sizeof(buckets));
+
+        snprintf(lcore, sizeof(lcore), "%u", h->cid);
+        prof_dump(lcore, h->kind, h->name, h->count, h->cycles, h->max,
+                  buckets, array->tsc_hz);
+
+        sum = prof_sum_get(sums, &nsum, h);
+        sum->count += h->count;
+        sum->cycles += h->cycles;
+        if (h->max > sum->max)
+            sum->max = h->max;
+        for (j = 0; j < DPVS_PROF_HIST_BUCKETS; j++)
+            sum->buckets[j] += buckets[j];
+    }
+
+    if (param->cid < 0) {
+        for (i = 0; i < nsum; i++) {
+            sum = &sums[i];
+            prof_dump("all", sum->kind, sum->name, sum->count, sum->cycles,
+                      sum->max, sum->buckets, array->tsc_hz);
+        }
+    }
+
+    free(sums);
+    dpvs_sockopt_msg_free(array);
+    return EDPVS_OK;
+}
+
+static int prof_do_cmd(struct dpip_obj *obj, dpip_cmd_t cmd,
+                       struct dpip_conf *conf)
+{
+    const struct prof_param *param = obj->param;
+    struct dp_vs_prof_conf prof_conf;
+
+    switch (cmd) {
+    case DPIP_CMD_SET:
+        prof_conf.enable = param->enable;
+        prof_conf.sample = param->sample;
+        return dpvs_setsockopt(SOCKOPT_SET_PROF, &prof_conf, sizeof(prof_conf));
+    case DPIP_CMD_FLUSH:
+        return dpvs_setsockopt(SOCKOPT_SET_PROF_RESET, NULL, 0);
+    case DPIP_CMD_SHOW:
+        return prof_show(param);
+    default:
+        return EDPVS_NOTSUPP;
+    }
+}
+
+static struct prof_param prof_param;
+
+static struct dpip_obj dpip_prof = {
+    .name       = "prof",
+    .param      = &prof_param,
+
+    .help       = prof_help,
+    .parse      = prof_parse,
+    .check      = prof_check,
+    .do_cmd     = prof_do_cmd,
+};
+
+static void __init prof_init(void)
+{
+    dpip_register_obj(&dpip_prof);
+}
+
+static void __exit prof_exit(void)
+{
+    dpip_unregister_obj(&dpip_prof);
+}
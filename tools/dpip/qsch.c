@@ -39,14 +39,17 @@ static void qsch_help(void)
         "              [ QSCH_KIND [ QOPTIONS ] ]\n"
         "\n"
         "Parameters:\n"
-        "    QSCH_KIND := { [b|p]fifo | tbf }\n"
-        "    QOPTIONS  := { FIFO_OPTS | TBF_OPTS }\n"
+        "    QSCH_KIND := { [b|p]fifo | tbf | ingress | fq_codel }\n"
+        "    QOPTIONS  := { FIFO_OPTS | TBF_OPTS | FQ_CODEL_OPTS }\n"
         "    FIFO_OPTS := [ limit NUMBER ]\n"
         "    TBF_OPTS  := rate RATE burst BYTES { latency MS | limit BYTES }\n"
         "                 [ peakrate RATE mtu BYTES ]\n"
+        "    FQ_CODEL_OPTS := [ limit PACKETS ] [ flows NUMBER ] [ quantum BYTES ]\n"
+        "                 [ target US ] [ interval US ]\n"
         "    RATE      := raw bits per-second, and possible followed by\n"
         "                 a SI unit (k, m, g).\n"
         "    MS        := milliseconds.\n"
+        "    US        := microseconds.\n"
         );
 }
 
@@ -138,12 +141,16 @@ static int qsch_parse(struct dpip_obj *obj, struct dpip_conf *cf)
         } else if (strcmp(CURRARG(cf), "ingress") == 0) {
             param->where = TC_H_INGRESS;
             param->handle = TC_H_INGRESS;
+            /* classify-only ingress Qsch unless a kind is given */
+            if (!strlen(param->kind))
+                snprintf(param->kind, TCNAMESIZ, "%s", "ingress");
         } else if (strcmp(CURRARG(cf), "parent") == 0) {
             NEXTARG_CHECK(cf, CURRARG(cf));
             param->where = tc_handle_atoi(CURRARG(cf));
         } else if (strcmp(CURRARG(cf), "bfifo") == 0 ||
                    strcmp(CURRARG(cf), "pfifo") == 0 ||
-                   strcmp(CURRARG(cf), "tbf") == 0) {
+                   strcmp(CURRARG(cf), "tbf") == 0 ||
+                   strcmp(CURRARG(cf), "fq_codel") == 0) {
             snprintf(param->kind, TCNAMESIZ, "%s", CURRARG(cf));
         } else { /* kind must be set ahead then QOPTIONS */
             if (strcmp(&param->kind[1], "fifo") == 0) {
@@ -196,6 +203,27 @@ static int qsch_parse(struct dpip_obj *obj, struct dpip_conf *cf)
                             param->kind, CURRARG(cf));
                     return EDPVS_INVAL;
                 }
+            } else if (strcmp(param->kind, "fq_codel") == 0) {
+                if (strcmp(CURRARG(cf), "limit") == 0) {
+                    NEXTARG_CHECK(cf, CURRARG(cf));
+                    param->qopt.fq_codel.limit = atoi(CURRARG(cf));
+                } else if (strcmp(CURRARG(cf), "flows") == 0) {
+                    NEXTARG_CHECK(cf, CURRARG(cf));
+                    param->qopt.fq_codel.flows = atoi(CURRARG(cf));
+                } else if (strcmp(CURRARG(cf), "quantum") == 0) {
+                    NEXTARG_CHECK(cf, CURRARG(cf));
+                    param->qopt.fq_codel.quantum = atoi(CURRARG(cf));
+                } else if (strcmp(CURRARG(cf), "target") == 0) {
+                    NEXTARG_CHECK(cf, CURRARG(cf));
+                    param->qopt.fq_codel.target = atoi(CURRARG(cf));
+                } else if (strcmp(CURRARG(cf), "interval") == 0) {
+                    NEXTARG_CHECK(cf, CURRARG(cf));
+                    param->qopt.fq_codel.interval = atoi(CURRARG(cf));
+                } else {
+                    fprintf(stderr, "invalid option for %s: `%s'\n",
+                            param->kind, CURRARG(cf));
+                    return EDPVS_INVAL;
+                }
             } else {
                 fprintf(stderr, "invalid/miss qsch kind: `%s'\n", param->kind);
                 return EDPVS_INVAL;
@@ -238,6 +266,13 @@ static int qsch_check(const struct dpip_obj *obj, dpip_cmd_t cmd)
                 fprintf(stderr, "missing buffer for tbf.\n");
                 return EDPVS_INVAL;
             }
+        } else if (strcmp(param->kind, "fq_codel") == 0) {
+            /* all options have defaults */
+        } else if (strcmp(param->kind, "ingress") == 0) {
+            if (param->handle != TC_H_INGRESS) {
+                fprintf(stderr, "ingress qsch must be at ingress.\n");
+                return EDPVS_INVAL;
+            }
         } else {
             fprintf(stderr, "invalid qsch kind.\n");
             return EDPVS_INVAL;
@@ -255,7 +290,8 @@ static int qsch_check(const struct dpip_obj *obj, dpip_cmd_t cmd)
 
         if (strcmp(param->kind, "pfifo") != 0 &&
             strcmp(param->kind, "bfifo") != 0 &&
-            strcmp(param->kind, "tbf") != 0) {
+            strcmp(param->kind, "tbf") != 0 &&
+            strcmp(param->kind, "fq_codel") != 0) {
             fprintf(stderr, "invalid qsch kind.\n");
             return EDPVS_INVAL;
         }
@@ -314,6 +350,11 @@ static void qsch_dump_param(const char *ifname, const union tc_param *param,
                    rate_itoa(tbf->peakrate.rate, rate, sizeof(rate)), tbf->mtu);
 
         printf(" limit %uB", tbf->limit);
+    } else if (strcmp(qsch->kind, "fq_codel") == 0) {
+        const struct tc_fq_codel_qopt *fq = &qsch->qopt.fq_codel;
+
+        printf(" limit %up flows %u quantum %uB target %uus interval %uus",
+               fq->limit, fq->flows, fq->quantum, fq->target, fq->interval);
     }
     printf("\n");
 
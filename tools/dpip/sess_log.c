@@ -0,0 +1,160 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * sess_log.c - session log stats of dpip tool.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "dpip.h"
+#include "utils.h"
+#include "sockopt.h"
+#include "conf/sess_log.h"
+
+enum {
+    SESS_LOG_STATS_CPU_ALL      = -1,
+    SESS_LOG_STATS_CPU_TOTAL    = -2,
+};
+
+static int sess_log_stats_cpu;
+
+static void sess_log_help(void)
+{
+    fprintf(stderr,
+            "Usage:\n"
+            "    dpip sesslog show [ cpu CPU | all | total ]\n"
+            "Notes:\n"
+            "    Shows records of session log (ipvs_defs:session_log of\n"
+            "    the config file). \"dropped\" counts records lost because\n"
+            "    the exporter fell behind and ring_size records of the cpu\n"
+            "    were all waiting to be exported.\n"
+            "Examples:\n"
+            "    dpip sesslog show\n"
+            "    dpip sesslog show all\n");
+}
+
+static int sess_log_parse(struct dpip_obj *obj, struct dpip_conf *cf)
+{
+    int *stats_cpu = obj->param;
+
+    *stats_cpu = SESS_LOG_STATS_CPU_TOTAL;
+
+    while (cf->argc > 0) {
+        if (strcmp(CURRARG(cf), "cpu") == 0) {
+            NEXTARG_CHECK(cf, CURRARG(cf));
+
+            *stats_cpu = atoi(CURRARG(cf));
+            if (*stats_cpu < 0 || *stats_cpu >= DPVS_MAX_LCORE) {
+                fprintf(stderr, "bad cpu id `%s'\n", CURRARG(cf));
+                return EDPVS_INVAL;
+            }
+        } else if (strcmp(CURRARG(cf), "all") == 0) {
+            *stats_cpu = SESS_LOG_STATS_CPU_ALL;
+        } else if (strcmp(CURRARG(cf), "total") == 0) {
+            *stats_cpu = SESS_LOG_STATS_CPU_TOTAL;
+        } else {
+            fprintf(stderr, "unknow argument `%s'\n", CURRARG(cf));
+            return EDPVS_INVAL;
+        }
+
+        NEXTARG(cf);
+    }
+
+    return EDPVS_OK;
+}
+
+static void sess_log_stats_dump(const char *title,
+                                const struct dp_vs_sess_log_stats *stats)
+{
+    printf("%s:\n", title);
+    printf("    %-16s%lu\n", "logged", stats->logged);
+    printf("    %-16s%lu\n", "dropped", stats->dropped);
+    printf("    %-16s%lu\n", "pending", stats->pending);
+}
+
+static int sess_log_do_cmd(struct dpip_obj *obj, dpip_cmd_t cmd,
+                           struct dpip_conf *conf)
+{
+    int stats_cpu = *(int *)obj->param;
+    struct dp_vs_sess_log_param *param;
+    char cpu[16];
+    size_t size;
+    int err, i;
+
+    if (cmd != DPIP_CMD_SHOW)
+        return EDPVS_NOTSUPP;
+
+    err = dpvs_getsockopt(SOCKOPT_GET_SESS_LOG, NULL, 0,
+                          (void **)&param, &size);
+    if (err != EDPVS_OK)
+        return err;
+
+    if (size != sizeof(*param)) {
+        fprintf(stderr, "corrupted response.\n");
+        dpvs_sockopt_msg_free(param);
+        return EDPVS_INVAL;
+    }
+
+    printf("session log %s: ring size %u exported %lu export-errors %lu\n",
+           param->enable ? "on" : "off", param->ring_size,
+           param->exported, param->export_err);
+
+    switch (stats_cpu) {
+    case SESS_LOG_STATS_CPU_TOTAL:
+        sess_log_stats_dump("Total", &param->stats);
+        break;
+    case SESS_LOG_STATS_CPU_ALL:
+        sess_log_stats_dump("All", &param->stats);
+
+        for (i = 0; i < NELEMS(param->stats_cpus); i++) {
+            if (!param->stats_cpus[i].logged && !param->stats_cpus[i].dropped)
+                continue;
+            snprintf(cpu, sizeof(cpu), "cpu %d", i);
+            sess_log_stats_dump(cpu, &param->stats_cpus[i]);
+        }
+        break;
+    default:
+        snprintf(cpu, sizeof(cpu), "cpu %d", stats_cpu);
+        sess_log_stats_dump(cpu, &param->stats_cpus[stats_cpu]);
+        break;
+    }
+
+    dpvs_sockopt_msg_free(param);
+
+    return EDPVS_OK;
+}
+
+static struct dpip_obj dpip_sess_log = {
+    .name       = "sesslog",
+    .param      = &sess_log_stats_cpu,
+
+    .help       = sess_log_help,
+    .parse      = sess_log_parse,
+    .do_cmd     = sess_log_do_cmd,
+};
+
+static void __init sess_log_init(void)
+{
+    dpip_register_obj(&dpip_sess_log);
+}
+
+static void __exit sess_log_exit(void)
+{
+    dpip_unregister_obj(&dpip_sess_log);
+}
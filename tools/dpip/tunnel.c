@@ -37,6 +37,25 @@ static int addr_atoi(const char *addr, __be32 *ip)
     return EDPVS_OK;
 }
 
+static int addr6_atoi(const char *addr, struct in6_addr *ip6)
+{
+    if (strcmp(addr, "any") == 0)
+        memset(ip6, 0, sizeof(*ip6));
+    else if (inet_pton(AF_INET6, addr, ip6) <= 0)
+        return EDPVS_INVAL;
+
+    return EDPVS_OK;
+}
+
+/* remote/local ADDR of either family, IPv6 goes to @ip6h. */
+static int tnl_addr_atoi(const char *addr, __be32 *ip, struct in6_addr *ip6)
+{
+    if (strchr(addr, ':'))
+        return addr6_atoi(addr, ip6);
+
+    return addr_atoi(addr, ip);
+}
+
 static int ttl_atoi(const char *ttl)
 {
     if (strcmp(ttl, "inherit") == 0)
@@ -69,9 +88,19 @@ static __be32 key_atoi(const char *key)
 static void tnl_dump_param(const struct ip_tunnel_param *param)
 {
     char sip[64], dip[64];
-
-    inet_ntop(AF_INET, &param->iph.saddr, sip, sizeof(sip));
-    inet_ntop(AF_INET, &param->iph.daddr, dip, sizeof(dip));
+    uint8_t ttl, tos;
+
+    if (ip_tunnel_kind_is_ip6(param->kind)) {
+        inet_ntop(AF_INET6, &param->ip6h.ip6_src, sip, sizeof(sip));
+        inet_ntop(AF_INET6, &param->ip6h.ip6_dst, dip, sizeof(dip));
+        ttl = param->ip6h.ip6_hlim;
+        tos = ip6_tnl_tclass(param->ip6h.ip6_flow);
+    } else {
+        inet_ntop(AF_INET, &param->iph.saddr, sip, sizeof(sip));
+        inet_ntop(AF_INET, &param->iph.daddr, dip, sizeof(dip));
+        ttl = param->iph.ttl;
+        tos = param->iph.tos;
+    }
 
     printf("%s: %4s remote %s local %s ",
            param->ifname, param->kind, dip, sip);
@@ -79,13 +108,15 @@ static void tnl_dump_param(const struct ip_tunnel_param *param)
     if (strlen(param->link))
         printf("dev %s ", param->link);
 
-    if (param->iph.ttl)
-        printf("ttl %d ", param->iph.ttl);
+    if (ttl)
+        printf("ttl %d ", ttl);
     else
         printf("ttl inherit ");
 
-    if (param->iph.tos)
-        printf("tos 0x%x ", param->iph.tos);
+    if (tos == 0x1)
+        printf("tos inherit ");
+    else if (tos)
+        printf("tos 0x%x ", tos);
 
     if (param->i_flags)
         printf("i_flags 0x%x ", ntohs(param->i_flags));
@@ -104,12 +135,13 @@ static void tnl_help(void)
     fprintf(stderr,
         "Usage:\n"
         "    dpip tunnel { add | change | del | show } [ NAME ]\n"
-        "         [ mode { ipip | gre } ] [ remote ADDR ] [ local ADDR ]\n"
+        "         [ mode { ipip | gre | ip6ip6 | ipip6 | ip6gre } ]\n"
+        "         [ remote ADDR ] [ local ADDR ]\n"
         "         [ [i|o]seq ] [ [i|o]key KEY ] [ [i|o]csum ]\n"
         "         [ ttl TTL ] [ tos TOS ] [ dev PHYS_DEV ]\n"
         "Parameters:\n"
         "    NAME    := STRING\n"
-        "    ADDR    := { IP_ADDRESS | any }\n"
+        "    ADDR    := { IP_ADDRESS | IPV6_ADDRESS | any }\n"
         "    TOS     := { 0..255 | inherit }\n"
         "    TTL     := { 1..255 | inherit }\n"
         "    KEY     := { DOTTED_QUAD | NUMBER }\n"
@@ -130,13 +162,15 @@ static int tnl_parse(struct dpip_obj *obj, struct dpip_conf *cf)
             snprintf(param->kind, sizeof(param->kind), "%s", CURRARG(cf));
         } else if (strcmp(CURRARG(cf), "remote") == 0) {
             NEXTARG_CHECK(cf, CURRARG(cf));
-            if (addr_atoi(CURRARG(cf), &param->iph.daddr) != EDPVS_OK) {
+            if (tnl_addr_atoi(CURRARG(cf), &param->iph.daddr,
+                              &param->ip6h.ip6_dst) != EDPVS_OK) {
                 fprintf(stderr, "invalid remote address: `%s'\n", CURRARG(cf));
                 return EDPVS_INVAL;
             }
         } else if (strcmp(CURRARG(cf), "local") == 0) {
             NEXTARG_CHECK(cf, CURRARG(cf));
-            if (addr_atoi(CURRARG(cf), &param->iph.saddr) != EDPVS_OK) {
+            if (tnl_addr_atoi(CURRARG(cf), &param->iph.saddr,
+                              &param->ip6h.ip6_src) != EDPVS_OK) {
                 fprintf(stderr, "invalid local address: `%s'\n", CURRARG(cf));
                 return EDPVS_INVAL;
             }
@@ -195,6 +229,10 @@ static int tnl_parse(struct dpip_obj *obj, struct dpip_conf *cf)
         return EDPVS_INVAL;
     }
 
+    /* ttl and tos are shared by outer IPv4 and IPv6 header */
+    param->ip6h.ip6_hlim = param->iph.ttl;
+    param->ip6h.ip6_flow = htonl(0x60000000 | (param->iph.tos << 20));
+
     return EDPVS_OK;
 }
 
@@ -55,9 +55,12 @@ static void vlan_help(void)
             "\n"
             "    The default VLAN-PROTO is 802.1q (vlan).\n"
             "    802.1q equals to vlan, so does 802.1ad and QinQ.\n"
+            "    For QinQ, add 802.1q device on 802.1ad device.\n"
             "Examples:\n"
             "    dpip vlan add dpdk0.100 link dpdk0 id 100\n"
             "    dpip vlan add link dpdk1 proto 802.1q id 100\n"
+            "    dpip vlan add dpdk1.s10 link dpdk1 proto 802.1ad id 10\n"
+            "    dpip vlan add link dpdk1.s10 proto 802.1q id 100\n"
             "    dpip vlan del dpdk0.100\n"
             "    dpip vlan del link dpdk1 id 100\n"
             "    dpip vlan show dpdk0.100\n"
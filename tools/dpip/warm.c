@@ -0,0 +1,217 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * warm.c - warm restart of dpip tool.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "common.h"
+#include "dpip.h"
+#include "utils.h"
+#include "sockopt.h"
+#include "conf/warm.h"
+
+struct warm_param {
+    int         op;         /* DP_VS_WARM_OP_XXX of "set" */
+    bool        all;        /* show each cpu */
+};
+
+static struct warm_param warm_param;
+
+static const char *warm_op_names[] = {
+    [DP_VS_WARM_OP_NONE]    = "none",
+    [DP_VS_WARM_OP_SAVE]    = "save",
+    [DP_VS_WARM_OP_RESTORE] = "restore",
+};
+
+static void warm_help(void)
+{
+    fprintf(stderr,
+            "Usage:\n"
+            "    dpip warm set { save | restore }\n"
+            "    dpip warm show [ all ]\n"
+            "Notes:\n"
+            "    \"save\" writes conns of all cpus to the file of\n"
+            "    ipvs_defs:warm_restart before DPVS is stopped, \"restore\"\n"
+            "    rebuilds them in the new DPVS once services are configured\n"
+            "    again. The file is removed after restore.\n"
+            "Examples:\n"
+            "    dpip warm set save\n"
+            "    dpip warm set restore\n"
+            "    dpip warm show all\n");
+}
+
+static int warm_parse(struct dpip_obj *obj, struct dpip_conf *cf)
+{
+    struct warm_param *param = obj->param;
+
+    memset(param, 0, sizeof(*param));
+
+    while (cf->argc > 0) {
+        if (strcmp(CURRARG(cf), "save") == 0) {
+            param->op = DP_VS_WARM_OP_SAVE;
+        } else if (strcmp(CURRARG(cf), "restore") == 0) {
+            param->op = DP_VS_WARM_OP_RESTORE;
+        } else if (strcmp(CURRARG(cf), "all") == 0) {
+            param->all = true;
+        } else {
+            fprintf(stderr, "unknow argument `%s'\n", CURRARG(cf));
+            return EDPVS_INVAL;
+        }
+
+        NEXTARG(cf);
+    }
+
+    return EDPVS_OK;
+}
+
+static int warm_check(const struct dpip_obj *obj, dpip_cmd_t cmd)
+{
+    const struct warm_param *param = obj->param;
+
+    switch (cmd) {
+    case DPIP_CMD_SET:
+        if (param->op == DP_VS_WARM_OP_NONE) {
+            fprintf(stderr, "missing save|restore\n");
+            return EDPVS_INVAL;
+        }
+        return EDPVS_OK;
+    case DPIP_CMD_SHOW:
+        return EDPVS_OK;
+    default:
+        return EDPVS_NOTSUPP;
+    }
+}
+
+static void warm_stats_dump(const char *title,
+                            const struct dp_vs_warm_stats *stats)
+{
+    int i;
+
+    printf("%s: conns %u time %u ms\n", title, stats->conns,
+           stats->usecs / 1000);
+    for (i = 0; i < DP_VS_WARM_SKIP_MAX; i++) {
+        if (stats->skipped[i])
+            printf("    %-16s%u\n", dp_vs_warm_skip_name(i),
+                   stats->skipped[i]);
+    }
+}
+
+static inline bool warm_stats_empty(const struct dp_vs_warm_stats *stats)
+{
+    int i;
+
+    if (stats->conns)
+        return false;
+    for (i = 0; i < DP_VS_WARM_SKIP_MAX; i++) {
+        if (stats->skipped[i])
+            return false;
+    }
+    return true;
+}
+
+static int warm_show(const struct warm_param *param)
+{
+    struct dp_vs_warm_report *report;
+    char cpu[16], tbuf[32];
+    time_t t;
+    size_t size;
+    int err, i;
+
+    err = dpvs_getsockopt(SOCKOPT_GET_WARM_SHOW, NULL, 0,
+                          (void **)&report, &size);
+    if (err != EDPVS_OK)
+        return err;
+
+    if (size != sizeof(*report)) {
+        fprintf(stderr, "corrupted response.\n");
+        dpvs_sockopt_msg_free(report);
+        return EDPVS_INVAL;
+    }
+
+    printf("warm restart: file %s max-age %u s\n",
+           report->file, report->max_age);
+
+    if (report->op == DP_VS_WARM_OP_NONE ||
+            report->op >= NELEMS(warm_op_names)) {
+        printf("no save or restore yet\n");
+        dpvs_sockopt_msg_free(report);
+        return EDPVS_OK;
+    }
+
+    t = report->time;
+    strftime(tbuf, sizeof(tbuf), "%F %T", localtime(&t));
+    printf("last %s: %s at %s, %u ms", warm_op_names[report->op],
+           dpvs_strerror(report->result), tbuf, report->usecs / 1000);
+    if (report->op == DP_VS_WARM_OP_RESTORE)
+        printf(", file age %u ms", report->age_ms);
+    printf("\n");
+
+    warm_stats_dump("Total", &report->total);
+
+    if (param->all) {
+        for (i = 0; i < NELEMS(report->lcores); i++) {
+            if (warm_stats_empty(&report->lcores[i]))
+                continue;
+            snprintf(cpu, sizeof(cpu), "cpu %d", i);
+            warm_stats_dump(cpu, &report->lcores[i]);
+        }
+    }
+
+    dpvs_sockopt_msg_free(report);
+    return EDPVS_OK;
+}
+
+static int warm_do_cmd(struct dpip_obj *obj, dpip_cmd_t cmd,
+                       struct dpip_conf *conf)
+{
+    const struct warm_param *param = obj->param;
+
+    switch (cmd) {
+    case DPIP_CMD_SET:
+        if (param->op == DP_VS_WARM_OP_SAVE)
+            return dpvs_setsockopt(SOCKOPT_SET_WARM_SAVE, NULL, 0);
+        return dpvs_setsockopt(SOCKOPT_SET_WARM_RESTORE, NULL, 0);
+    case DPIP_CMD_SHOW:
+        return warm_show(param);
+    default:
+        return EDPVS_NOTSUPP;
+    }
+}
+
+static struct dpip_obj dpip_warm = {
+    .name       = "warm",
+    .param      = &warm_param,
+
+    .help       = warm_help,
+    .parse      = warm_parse,
+    .check      = warm_check,
+    .do_cmd     = warm_do_cmd,
+};
+
+static void __init warm_init(void)
+{
+    dpip_register_obj(&dpip_warm);
+}
+
+static void __exit warm_exit(void)
+{
+    dpip_unregister_obj(&dpip_warm);
+}
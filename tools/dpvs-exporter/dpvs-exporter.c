@@ -0,0 +1,413 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2017 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * dpvs-exporter - reference reader of the dpvs statistics shared memory,
+ * see include/conf/stats_shm.h. it never talks to dpvs: it maps the
+ * segment (or a copy of it, for testing) read-only and prints the
+ * counters in Prometheus text format, e.g. for the textfile collector
+ * of node_exporter or an inetd style scrape.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "conf/stats_shm.h"
+
+#define SHM_PATH_DEF    "/dev/shm" DPVS_SHM_NAME_DEF
+#define READ_TRIES      1000
+
+#define NELEMS(a)       (sizeof(a) / sizeof((a)[0]))
+
+struct metric {
+    const char  *name;
+    const char  *help;
+    const char  *type;
+    size_t      offset;
+    int         width;          /* 32 or 64 bits */
+};
+
+#define METRIC64(n, h, t, s, f)   { n, h, t, offsetof(s, f), 64 }
+#define METRIC32(n, h, t, s, f)   { n, h, t, offsetof(s, f), 32 }
+
+static const struct metric lcore_metrics[] = {
+    METRIC64("dpvs_lcore_loops_total", "Loops of the lcore.",
+             "counter", struct dpvs_shm_lcore, loops),
+    METRIC64("dpvs_lcore_rx_packets_total", "Packets received.",
+             "counter", struct dpvs_shm_lcore, ipackets),
+    METRIC64("dpvs_lcore_rx_bytes_total", "Bytes received.",
+             "counter", struct dpvs_shm_lcore, ibytes),
+    METRIC64("dpvs_lcore_tx_packets_total", "Packets transmitted.",
+             "counter", struct dpvs_shm_lcore, opackets),
+    METRIC64("dpvs_lcore_tx_bytes_total", "Bytes transmitted.",
+             "counter", struct dpvs_shm_lcore, obytes),
+    METRIC64("dpvs_lcore_dropped_total", "Packets dropped by software.",
+             "counter", struct dpvs_shm_lcore, dropped),
+    METRIC64("dpvs_lcore_tx_dropped_total", "Packets dropped on full tx queues.",
+             "counter", struct dpvs_shm_lcore, txdrop),
+    METRIC64("dpvs_lcore_busy_cycles_total", "TSC cycles of non-empty rx bursts.",
+             "counter", struct dpvs_shm_lcore, busy_cycles),
+    METRIC64("dpvs_lcore_conns_created_total", "Connections created.",
+             "counter", struct dpvs_shm_lcore, conns),
+    METRIC64("dpvs_lcore_ipvs_in_packets_total", "Packets forwarded to servers.",
+             "counter", struct dpvs_shm_lcore, inpkts),
+    METRIC64("dpvs_lcore_ipvs_in_bytes_total", "Bytes forwarded to servers.",
+             "counter", struct dpvs_shm_lcore, inbytes),
+    METRIC64("dpvs_lcore_ipvs_out_packets_total", "Packets forwarded to clients.",
+             "counter", struct dpvs_shm_lcore, outpkts),
+    METRIC64("dpvs_lcore_ipvs_out_bytes_total", "Bytes forwarded to clients.",
+             "counter", struct dpvs_shm_lcore, outbytes),
+    METRIC32("dpvs_lcore_conns", "Connections in the table of the lcore.",
+             "gauge", struct dpvs_shm_lcore, conn_count),
+};
+
+static const struct metric port_metrics[] = {
+    METRIC64("dpvs_port_rx_packets_total", "Packets received.",
+             "counter", struct dpvs_shm_port, ipackets),
+    METRIC64("dpvs_port_tx_packets_total", "Packets transmitted.",
+             "counter", struct dpvs_shm_port, opackets),
+    METRIC64("dpvs_port_rx_bytes_total", "Bytes received.",
+             "counter", struct dpvs_shm_port, ibytes),
+    METRIC64("dpvs_port_tx_bytes_total", "Bytes transmitted.",
+             "counter", struct dpvs_shm_port, obytes),
+    METRIC64("dpvs_port_rx_missed_total", "Packets dropped by the NIC.",
+             "counter", struct dpvs_shm_port, imissed),
+    METRIC64("dpvs_port_rx_errors_total", "Erroneous packets received.",
+             "counter", struct dpvs_shm_port, ierrors),
+    METRIC64("dpvs_port_tx_errors_total", "Failed transmissions.",
+             "counter", struct dpvs_shm_port, oerrors),
+    METRIC64("dpvs_port_rx_nombuf_total", "Receive mbuf allocation failures.",
+             "counter", struct dpvs_shm_port, rx_nombuf),
+};
+
+/* a dest with counters summed over lcores */
+struct dest_snap {
+    struct dpvs_shm_dest    dest;
+    struct dpvs_shm_stats   stats;
+    char                    svc[72];
+    char                    rs[64];
+};
+
+static const struct metric dest_metrics[] = {
+    METRIC64("dpvs_dest_conns_total", "Connections scheduled to the server.",
+             "counter", struct dest_snap, stats.conns),
+    METRIC64("dpvs_dest_in_packets_total", "Packets forwarded to the server.",
+             "counter", struct dest_snap, stats.inpkts),
+    METRIC64("dpvs_dest_in_bytes_total", "Bytes forwarded to the server.",
+             "counter", struct dest_snap, stats.inbytes),
+    METRIC64("dpvs_dest_out_packets_total", "Packets forwarded from the server.",
+             "counter", struct dest_snap, stats.outpkts),
+    METRIC64("dpvs_dest_out_bytes_total", "Bytes forwarded from the server.",
+             "counter", struct dest_snap, stats.outbytes),
+    METRIC32("dpvs_dest_active_conns", "Active connections.",
+             "gauge", struct dest_snap, dest.actconns),
+    METRIC32("dpvs_dest_inactive_conns", "Inactive connections.",
+             "gauge", struct dest_snap, dest.inactconns),
+    METRIC32("dpvs_dest_persistent_conns", "Persistent connections.",
+             "gauge", struct dest_snap, dest.persistconns),
+};
+
+static uint64_t metric_value(const struct metric *m, const void *obj)
+{
+    const char *p = (const char *)obj + m->offset;
+
+    if (m->width == 32)
+        return *(const uint32_t *)p;
+    return *(const uint64_t *)p;
+}
+
+static void metric_head(const struct metric *m)
+{
+    printf("# HELP %s %s\n", m->name, m->help);
+    printf("# TYPE %s %s\n", m->name, m->type);
+}
+
+/* copy a seqlock protected slot, -1 if the writer never settles */
+static int slot_read(void *dst, const void *slot, size_t size)
+{
+    const volatile uint32_t *seq = slot;
+    int tries = READ_TRIES;
+    uint32_t s;
+
+    do {
+        s = dpvs_shm_read_begin(seq);
+        memcpy(dst, slot, size);
+    } while (dpvs_shm_read_retry(seq, s) && --tries > 0);
+
+    return tries > 0 ? 0 : -1;
+}
+
+static const char *proto_name(uint8_t proto)
+{
+    switch (proto) {
+    case IPPROTO_TCP:
+        return "tcp";
+    case IPPROTO_UDP:
+        return "udp";
+    case IPPROTO_ICMP:
+        return "icmp";
+    case IPPROTO_ICMPV6:
+        return "icmpv6";
+    default:
+        return "unknown";
+    }
+}
+
+static void addr_port_fmt(char *buf, size_t len, int af,
+                          const uint8_t *addr, uint16_t port)
+{
+    char ip[INET6_ADDRSTRLEN];
+
+    if (!inet_ntop(af, addr, ip, sizeof(ip)))
+        snprintf(ip, sizeof(ip), "?");
+
+    if (af == AF_INET6)
+        snprintf(buf, len, "[%s]:%u", ip, ntohs(port));
+    else
+        snprintf(buf, len, "%s:%u", ip, ntohs(port));
+}
+
+static int dest_snap_cmp(const void *a, const void *b)
+{
+    const struct dest_snap *da = a, *db = b;
+    int ret = strcmp(da->svc, db->svc);
+
+    return ret ? ret : strcmp(da->rs, db->rs);
+}
+
+static void dump_lcores(const struct dpvs_shm_hdr *hdr)
+{
+    struct dpvs_shm_lcore *snaps;
+    unsigned cid, n = 0, i, j;
+    unsigned *cids;
+
+    snaps = calloc(hdr->max_lcores, sizeof(*snaps));
+    cids = calloc(hdr->max_lcores, sizeof(*cids));
+    if (!snaps || !cids)
+        goto out;
+
+    for (cid = 0; cid < hdr->max_lcores; cid++) {
+        if (slot_read(&snaps[n], dpvs_shm_lcore(hdr, cid), sizeof(*snaps)))
+            continue;
+        if (snaps[n].active)
+            cids[n++] = cid;
+    }
+
+    for (i = 0; i < NELEMS(lcore_metrics); i++) {
+        metric_head(&lcore_metrics[i]);
+        for (j = 0; j < n; j++)
+            printf("%s{lcore=\"%u\"} %lu\n", lcore_metrics[i].name, cids[j],
+                   metric_value(&lcore_metrics[i], &snaps[j]));
+    }
+
+out:
+    free(snaps);
+    free(cids);
+}
+
+static void dump_ports(const struct dpvs_shm_hdr *hdr)
+{
+    struct dpvs_shm_port *snaps;
+    unsigned idx, n = 0, i, j;
+
+    snaps = calloc(hdr->max_ports, sizeof(*snaps));
+    if (!snaps)
+        return;
+
+    for (idx = 0; idx < hdr->max_ports; idx++) {
+        if (slot_read(&snaps[n], dpvs_shm_port(hdr, idx), sizeof(*snaps)))
+            continue;
+        if (snaps[n].active) {
+            snaps[n].name[sizeof(snaps[n].name) - 1] = '\0';
+            n++;
+        }
+    }
+
+    for (i = 0; i < NELEMS(port_metrics); i++) {
+        metric_head(&port_metrics[i]);
+        for (j = 0; j < n; j++)
+            printf("%s{port=\"%s\"} %lu\n", port_metrics[i].name,
+                   snaps[j].name, metric_value(&port_metrics[i], &snaps[j]));
+    }
+
+    free(snaps);
+}
+
+static void dump_dests(const struct dpvs_shm_hdr *hdr)
+{
+    const struct dpvs_shm_stats *stats;
+    struct dest_snap *snaps, *ds;
+    struct dpvs_shm_dest sd;
+    unsigned idx, cid, n = 0, i, j;
+    uint32_t gen;
+
+    snaps = calloc(hdr->max_dests, sizeof(*snaps));
+    if (!snaps)
+        return;
+
+    for (idx = 0; idx < hdr->max_dests; idx++) {
+        if (slot_read(&sd, dpvs_shm_dest(hdr, idx), sizeof(sd)) || !sd.active)
+            continue;
+        gen = sd.gen;
+
+        ds = &snaps[n];
+        memset(ds, 0, sizeof(*ds));
+        ds->dest = sd;
+
+        stats = dpvs_shm_dest_stats(hdr, idx);
+        for (cid = 0; cid < hdr->max_lcores; cid++) {
+            ds->stats.conns += stats[cid].conns;
+            ds->stats.inpkts += stats[cid].inpkts;
+            ds->stats.inbytes += stats[cid].inbytes;
+            ds->stats.outpkts += stats[cid].outpkts;
+            ds->stats.outbytes += stats[cid].outbytes;
+        }
+
+        /* slot reused while summing, counters belong to another dest */
+        if (slot_read(&sd, dpvs_shm_dest(hdr, idx), sizeof(sd)) ||
+                !sd.active || sd.gen != gen)
+            continue;
+
+        if (ds->dest.fwmark) {
+            snprintf(ds->svc, sizeof(ds->svc), "fwmark/%u", ds->dest.fwmark);
+        } else {
+            char vs[56];
+
+            addr_port_fmt(vs, sizeof(vs), ds->dest.af, ds->dest.vaddr,
+                          ds->dest.vport);
+            snprintf(ds->svc, sizeof(ds->svc), "%s/%s",
+                     proto_name(ds->dest.proto), vs);
+        }
+        addr_port_fmt(ds->rs, sizeof(ds->rs), ds->dest.af, ds->dest.addr,
+                      ds->dest.port);
+        n++;
+    }
+
+    /* dests of a service together */
+    qsort(snaps, n, sizeof(*snaps), dest_snap_cmp);
+
+    for (i = 0; i < NELEMS(dest_metrics); i++) {
+        metric_head(&dest_metrics[i]);
+        for (j = 0; j < n; j++)
+            printf("%s{service=\"%s\",server=\"%s\"} %lu\n",
+                   dest_metrics[i].name, snaps[j].svc, snaps[j].rs,
+                   metric_value(&dest_metrics[i], &snaps[j]));
+    }
+
+    free(snaps);
+}
+
+static int hdr_check(const struct dpvs_shm_hdr *hdr, size_t size)
+{
+    if (size < sizeof(*hdr) || hdr->magic != DPVS_SHM_MAGIC) {
+        fprintf(stderr, "not a dpvs stats segment\n");
+        return -1;
+    }
+
+    if (hdr->version != DPVS_SHM_VERSION ||
+            hdr->lcore_size != sizeof(struct dpvs_shm_lcore) ||
+            hdr->port_size != sizeof(struct dpvs_shm_port) ||
+            hdr->dest_size != sizeof(struct dpvs_shm_dest) ||
+            hdr->stats_size != sizeof(struct dpvs_shm_stats)) {
+        fprintf(stderr, "unsupported segment version %u\n", hdr->version);
+        return -1;
+    }
+
+    if (hdr->size > size || hdr->dest_stats_off +
+            (uint64_t)hdr->stats_size * hdr->max_lcores * hdr->max_dests > size) {
+        fprintf(stderr, "truncated segment\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-f PATH]\n"
+            "    -f PATH   segment or a copy of it, default " SHM_PATH_DEF "\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = SHM_PATH_DEF;
+    const struct dpvs_shm_hdr *hdr;
+    struct stat st;
+    void *addr;
+    int fd, opt, up;
+
+    while ((opt = getopt(argc, argv, "f:h")) != -1) {
+        switch (opt) {
+        case 'f':
+            path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    hdr = addr;
+    if (hdr_check(hdr, st.st_size) != 0) {
+        munmap(addr, st.st_size);
+        return 1;
+    }
+
+    /* a copy of the segment is always read, dpvs may be elsewhere */
+    up = hdr->ready && (kill(hdr->pid, 0) == 0 || errno == EPERM);
+
+    printf("# HELP dpvs_up Whether dpvs owning the segment is running.\n");
+    printf("# TYPE dpvs_up gauge\n");
+    printf("dpvs_up %d\n", up);
+    printf("# HELP dpvs_start_time_seconds Start time of dpvs since epoch.\n");
+    printf("# TYPE dpvs_start_time_seconds gauge\n");
+    printf("dpvs_start_time_seconds %lu\n", hdr->start_time);
+    printf("# HELP dpvs_tsc_hz TSC frequency of dpvs, for cycle counters.\n");
+    printf("# TYPE dpvs_tsc_hz gauge\n");
+    printf("dpvs_tsc_hz %lu\n", hdr->tsc_hz);
+
+    dump_lcores(hdr);
+    dump_ports(hdr);
+    dump_dests(hdr);
+
+    munmap(addr, st.st_size);
+    return 0;
+}
@@ -200,6 +200,9 @@ static const char* optnames[] = {
 	"ifname" ,
 	"sockpair" ,
 	"hash-target",
+	"vxlan/geneve",
+	"vtep",
+	"inner-mac",
 };
 
 /*
@@ -212,27 +215,27 @@ static const char* optnames[] = {
  */
 static const char commands_v_options[NUMBER_OF_CMD][NUMBER_OF_OPT] =
 {
-        /* -n   -c   svc  -s   -p   -M   -r   fwd  -w   -x   -y   -mc  tot  dmn  -st  -rt  thr  -pc  srt  sid  -ex  ops  pe   laddr blst syn ifname sockpair hashtag*/
-/*ADD*/      {'x', 'x', '+', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x',  ' ', 'x' ,'x' ,' '},
-/*EDIT*/     {'x', 'x', '+', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x',  ' ', 'x' ,'x' ,' '},
-/*DEL*/      {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x'},
-/*FLUSH*/    {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x'},
-/*LIST*/     {' ', '1', '1', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '1', '1', ' ', ' ', ' ', ' ', ' ', ' ', ' ', 'x', 'x', 'x', 'x',  'x', 'x' ,' ' ,'x'},
-/*ADDSRV*/   {'x', 'x', '+', 'x', 'x', 'x', '+', ' ', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x'},
-/*DELSRV*/   {'x', 'x', '+', 'x', 'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x'},
-/*EDITSRV*/  {'x', 'x', '+', 'x', 'x', 'x', '+', ' ', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x'},
-/*TIMEOUT*/  {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x'},
-/*STARTD*/   {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x'},
-/*STOPD*/    {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x'},
-/*RESTORE*/  {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x'},
-/*SAVE*/     {' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x'},
-/*ZERO*/     {'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x'},
-/*ADDLADDR*/ {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '+', 'x',  'x', '+' ,'x' ,'x'},
-/*DELLADDR*/ {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '+', 'x',  'x', '+' ,'x' ,'x'},
-/*GETLADDR*/ {'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x'},
-/*ADDBLKLST*/{'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '+',  'x', 'x' ,'x' ,'x'},
-/*DELBLKLST*/{'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '+',  'x', 'x' ,'x' ,'x'},
-/*GETBLKLST*/{'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x'},
+        /* -n   -c   svc  -s   -p   -M   -r   fwd  -w   -x   -y   -mc  tot  dmn  -st  -rt  thr  -pc  srt  sid  -ex  ops  pe   laddr blst syn ifname sockpair hashtag encap vtep imac*/
+/*ADD*/      {'x', 'x', '+', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x',  ' ', 'x' ,'x' ,' ' ,'x' ,'x' ,'x'},
+/*EDIT*/     {'x', 'x', '+', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x',  ' ', 'x' ,'x' ,' ' ,'x' ,'x' ,'x'},
+/*DEL*/      {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x' ,'x' ,'x' ,'x'},
+/*FLUSH*/    {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x' ,'x' ,'x' ,'x'},
+/*LIST*/     {' ', '1', '1', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '1', '1', ' ', ' ', ' ', ' ', ' ', ' ', ' ', 'x', 'x', 'x', 'x',  'x', 'x' ,' ' ,'x' ,'x' ,'x' ,'x'},
+/*ADDSRV*/   {'x', 'x', '+', 'x', 'x', 'x', '+', ' ', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x' ,' ' ,' ' ,' '},
+/*DELSRV*/   {'x', 'x', '+', 'x', 'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x' ,'x' ,'x' ,'x'},
+/*EDITSRV*/  {'x', 'x', '+', 'x', 'x', 'x', '+', ' ', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x' ,' ' ,' ' ,' '},
+/*TIMEOUT*/  {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x' ,'x' ,'x' ,'x'},
+/*STARTD*/   {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x' ,'x' ,'x' ,'x'},
+/*STOPD*/    {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x' ,'x' ,'x' ,'x'},
+/*RESTORE*/  {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x' ,'x' ,'x' ,'x'},
+/*SAVE*/     {' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x' ,'x' ,'x' ,'x'},
+/*ZERO*/     {'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x' ,'x' ,'x' ,'x'},
+/*ADDLADDR*/ {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '+', 'x',  'x', '+' ,'x' ,'x' ,'x' ,'x' ,'x'},
+/*DELLADDR*/ {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '+', 'x',  'x', '+' ,'x' ,'x' ,'x' ,'x' ,'x'},
+/*GETLADDR*/ {'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x' ,'x' ,'x' ,'x'},
+/*ADDBLKLST*/{'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '+',  'x', 'x' ,'x' ,'x' ,'x' ,'x' ,'x'},
+/*DELBLKLST*/{'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '+',  'x', 'x' ,'x' ,'x' ,'x' ,'x' ,'x'},
+/*GETBLKLST*/{'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',  'x', 'x' ,'x' ,'x' ,'x' ,'x' ,'x'},
 };
 
 /* printing format flags */
@@ -285,6 +288,10 @@ enum {
 	TAG_NO_SORT,
 	TAG_PERSISTENCE_ENGINE,
 	TAG_SOCKPAIR,
+	TAG_VXLAN,
+	TAG_GENEVE,
+	TAG_VTEP,
+	TAG_INNER_MAC,
 };
 
 /* various parsing helpers & parsing functions */
@@ -454,6 +461,11 @@ parse_options(int argc, char **argv, struct ipvs_command_entry *ce,
 		{ "ifname", 'F', POPT_ARG_STRING, &optarg, 'F', NULL, NULL },
 		{ "match", 'H', POPT_ARG_STRING, &optarg, 'H', NULL, NULL },
 		{ "hash-target", 'Y', POPT_ARG_STRING, &optarg, 'Y', NULL, NULL },
+		{ "vxlan", '\0', POPT_ARG_STRING, &optarg, TAG_VXLAN, NULL, NULL },
+		{ "geneve", '\0', POPT_ARG_STRING, &optarg, TAG_GENEVE, NULL, NULL },
+		{ "vtep", '\0', POPT_ARG_STRING, &optarg, TAG_VTEP, NULL, NULL },
+		{ "inner-mac", '\0', POPT_ARG_STRING, &optarg, TAG_INNER_MAC,
+		  NULL, NULL },
 		{ NULL, 0, 0, NULL, 0, NULL, NULL }
 	};
 
@@ -795,6 +807,46 @@ parse_options(int argc, char **argv, struct ipvs_command_entry *ce,
 				fail(2 , "hash target not support\n");
 			break;
 			}
+		case TAG_VXLAN:
+		case TAG_GENEVE:
+			{
+			int vni;
+
+			set_option(options, OPT_ENCAP);
+			if ((vni = string_to_number(optarg, 0, 0xffffff)) == -1)
+				fail(2, "illegal vni specified");
+			ce->dest.vni = vni;
+			ce->dest.encap = (c == TAG_VXLAN) ? IP_VS_DEST_ENCAP_VXLAN
+							  : IP_VS_DEST_ENCAP_GENEVE;
+			break;
+			}
+		case TAG_VTEP:
+			{
+			ipvs_service_t		nsvc;
+
+			set_option(options, OPT_VTEP);
+			parse = parse_service(optarg, &nsvc);
+			if (parse != SERVICE_ADDR)
+				fail(2, "illegal vtep address");
+			ce->dest.vtep = nsvc.addr;
+			break;
+			}
+		case TAG_INNER_MAC:
+			{
+			unsigned int m[6];
+			int i;
+
+			set_option(options, OPT_INNERMAC);
+			if (sscanf(optarg, "%x:%x:%x:%x:%x:%x",
+				   &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) != 6)
+				fail(2, "illegal inner mac address");
+			for (i = 0; i < 6; i++) {
+				if (m[i] > 0xff)
+					fail(2, "illegal inner mac address");
+				ce->dest.inner_dmac[i] = m[i];
+			}
+			break;
+			}
 		default:
 			fail(2, "invalid option `%s'",
 			     poptBadOption(context, POPT_BADOPTION_NOALIAS));
@@ -900,6 +952,13 @@ static int process_options(int argc, char **argv, int reading_stdin)
 		strcpy(ce.daemon.mcast_ifn, DEF_MCAST_IFN);
 
 	if (ce.cmd == CMD_ADDDEST || ce.cmd == CMD_EDITDEST) {
+		if (options & (OPT_VTEP|OPT_INNERMAC) && !(options & OPT_ENCAP))
+			fail(2, "--vtep and --inner-mac need --vxlan or --geneve");
+
+		/* encapsulation without other method means overlay forwarding */
+		if (options & OPT_ENCAP && !(options & OPT_FORWARD))
+			ce.dest.conn_flags = IP_VS_CONN_F_OVERLAY;
+
 		/*
 		 * The destination port must be equal to the service port
 		 * if the IP_VS_CONN_F_TUNNEL or IP_VS_CONN_F_DROUTE is set.
@@ -907,7 +966,8 @@ static int process_options(int argc, char **argv, int reading_stdin)
 		 */
 		if (!ce.svc.fwmark &&
 		    (ce.dest.conn_flags == IP_VS_CONN_F_TUNNEL
-		     || ce.dest.conn_flags == IP_VS_CONN_F_DROUTE))
+		     || ce.dest.conn_flags == IP_VS_CONN_F_DROUTE
+		     || ce.dest.conn_flags == IP_VS_CONN_F_OVERLAY))
 			ce.dest.port = ce.svc.port;
 	}
 
@@ -1329,7 +1389,7 @@ generic_opt_check(int command, int options)
 	i = command - CMD_NONE -1;
 
 	for (j = 0; j < NUMBER_OF_OPT; j++) {
-		if (!(options & (1<<j))) {
+		if (!(options & (1U<<j))) {
 			if (commands_v_options[i][j] == '+')
 				fail(2, "You need to supply the '%s' "
 				     "option for the '%s' command",
@@ -1466,6 +1526,10 @@ static void usage_exit(const char *program, const int exit_status)
 		"  --fullnat      -b                   fullnat mode\n"
 		"  --snat         -J                   SNAT mode\n"
 		"  --masquerading -m                   masquerading (NAT)\n"
+		"  --vxlan vni                         VXLAN encapsulation, overlay mode unless -b\n"
+		"  --geneve vni                        GENEVE encapsulation, overlay mode unless -b\n"
+		"  --vtep address                      VTEP of real server (default server-address)\n"
+		"  --inner-mac mac                     inner destination MAC (default broadcast)\n"
 		"  --weight       -w weight            capacity of real server\n"
 		"  --u-threshold  -x uthreshold        upper threshold of connections\n"
 		"  --l-threshold  -y lthreshold        lower threshold of connections\n"
@@ -1647,6 +1711,9 @@ static inline char *fwd_name(unsigned flags)
 	case IP_VS_CONN_F_SNAT:
 		fwd = "SNAT";
 		break;
+	case IP_VS_CONN_F_OVERLAY:
+		fwd = "Overlay";
+		break;
 	}
 	return fwd;
 }
@@ -1667,6 +1734,20 @@ static inline char *fwd_switch(unsigned flags)
 	return swt;
 }
 
+static void print_encap_rule(ipvs_dest_entry_t *e)
+{
+	char pbuf[INET6_ADDRSTRLEN];
+	const uint8_t *m = e->inner_dmac;
+
+	printf(" --%s %u", e->encap == IP_VS_DEST_ENCAP_VXLAN ? "vxlan" : "geneve",
+	       e->vni);
+	if (inet_ntop(e->af, &e->vtep, pbuf, sizeof(pbuf)))
+		printf(" --vtep %s", pbuf);
+	if (m[0] | m[1] | m[2] | m[3] | m[4] | m[5])
+		printf(" --inner-mac %02x:%02x:%02x:%02x:%02x:%02x",
+		       m[0], m[1], m[2], m[3], m[4], m[5]);
+}
+
 /*notice when rs is deleted svc stats count will be less than before*/
 static void copy_stats_from_dest(ipvs_service_entry_t *se, struct ip_vs_get_dests *d)
 {
@@ -1916,8 +1997,14 @@ print_service_entry(ipvs_service_entry_t *se, unsigned int format)
 			dname[28] = '\0';
 
 		if (format & FMT_RULE) {
-			printf("-a %s -r %s %s -w %d\n", svc_name, dname,
-			       fwd_switch(e->conn_flags), e->weight);
+			if ((e->conn_flags & IP_VS_CONN_F_FWD_MASK) == IP_VS_CONN_F_OVERLAY)
+				printf("-a %s -r %s", svc_name, dname);
+			else
+				printf("-a %s -r %s %s", svc_name, dname,
+				       fwd_switch(e->conn_flags));
+			if (e->encap != IP_VS_DEST_ENCAP_NONE)
+				print_encap_rule(e);
+			printf(" -w %d\n", e->weight);
 		} else if (format & FMT_STATS) {
 			printf("  -> %-28s", dname);
 			print_largenum(e->stats.conns, format);
@@ -375,6 +375,9 @@ dump_vs(void *data)
 	case IP_VS_CONN_F_SNAT:
 		log_message(LOG_INFO, "   lb_kind = SNAT");
 		break;
+	case IP_VS_CONN_F_OVERLAY:
+		log_message(LOG_INFO, "   lb_kind = OVERLAY");
+		break;
 #endif
 	}
 
@@ -481,6 +484,13 @@ dump_rs(void *data)
 			    , inet_sockaddrtos(&rs->addr)
 			    , ntohs(inet_sockaddrport(&rs->addr))
 			    , rs->weight);
+#ifdef _WITH_LVS_
+	if (rs->encap)
+		log_message(LOG_INFO, "     -> %s VNI = %u, VTEP = %s",
+			    rs->encap == IP_VS_DEST_ENCAP_VXLAN ? "VXLAN" : "GENEVE",
+			    rs->vni, rs->vtep.ss_family ?
+			    inet_sockaddrtos(&rs->vtep) : "RIP");
+#endif
 	if (rs->inhibit)
 		log_message(LOG_INFO, "     -> Inhibit service on failure");
 	if (rs->notify_up)
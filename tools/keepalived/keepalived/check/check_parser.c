@@ -120,6 +120,8 @@ lbkind_handler(vector_t *strvec)
 		vs->loadbalancing_kind = IP_VS_CONN_F_FULLNAT;
 	else if (!strcmp(str, "SNAT"))
 		vs->loadbalancing_kind = IP_VS_CONN_F_SNAT;
+	else if (!strcmp(str, "OVERLAY"))
+		vs->loadbalancing_kind = IP_VS_CONN_F_OVERLAY;
 	else
 		log_message(LOG_INFO, "PARSER : unknown [%s] routing method.", str);
 }
@@ -232,6 +234,51 @@ lthreshold_handler(vector_t *strvec)
 }
 #endif
 static void
+encap_handler(vector_t *strvec)
+{
+	virtual_server_t *vs = LIST_TAIL_DATA(check_data->vs);
+	real_server_t *rs = LIST_TAIL_DATA(vs->rs);
+	char *str = vector_slot(strvec, 1);
+
+	if (!strcmp(str, "vxlan"))
+		rs->encap = IP_VS_DEST_ENCAP_VXLAN;
+	else if (!strcmp(str, "geneve"))
+		rs->encap = IP_VS_DEST_ENCAP_GENEVE;
+	else
+		log_message(LOG_INFO, "PARSER : unknown [%s] encapsulation.", str);
+}
+static void
+vni_handler(vector_t *strvec)
+{
+	virtual_server_t *vs = LIST_TAIL_DATA(check_data->vs);
+	real_server_t *rs = LIST_TAIL_DATA(vs->rs);
+	rs->vni = strtoul(vector_slot(strvec, 1), NULL, 10);
+}
+static void
+vtep_handler(vector_t *strvec)
+{
+	virtual_server_t *vs = LIST_TAIL_DATA(check_data->vs);
+	real_server_t *rs = LIST_TAIL_DATA(vs->rs);
+	inet_stosockaddr(vector_slot(strvec, 1), NULL, &rs->vtep);
+}
+static void
+inner_mac_handler(vector_t *strvec)
+{
+	virtual_server_t *vs = LIST_TAIL_DATA(check_data->vs);
+	real_server_t *rs = LIST_TAIL_DATA(vs->rs);
+	unsigned int m[6];
+	int i;
+
+	if (sscanf(vector_slot(strvec, 1), "%x:%x:%x:%x:%x:%x",
+		   &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) != 6) {
+		log_message(LOG_INFO, "PARSER : invalid inner_mac [%s].",
+			    (char *)vector_slot(strvec, 1));
+		return;
+	}
+	for (i = 0; i < 6; i++)
+		rs->inner_mac[i] = m[i];
+}
+static void
 inhibit_handler(vector_t *strvec)
 {
 	virtual_server_t *vs = LIST_TAIL_DATA(check_data->vs);
@@ -535,6 +582,10 @@ check_init_keywords(void)
 	install_keyword("uthreshold", &uthreshold_handler);
 	install_keyword("lthreshold", &lthreshold_handler);
 #endif
+	install_keyword("encap", &encap_handler);
+	install_keyword("vni", &vni_handler);
+	install_keyword("vtep", &vtep_handler);
+	install_keyword("inner_mac", &inner_mac_handler);
 	install_keyword("inhibit_on_failure", &inhibit_handler);
 	install_keyword("notify_up", &notify_up_handler);
 	install_keyword("notify_down", &notify_down_handler);
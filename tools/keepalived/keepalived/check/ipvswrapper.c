@@ -666,6 +666,16 @@ ipvs_set_rule(int cmd, virtual_server_t * vs, real_server_t * rs)
 			drule->weight = rs->weight;	
 			drule->u_threshold = rs->u_threshold;
 			drule->l_threshold = rs->l_threshold;
+			if (rs->encap) {
+				drule->encap = rs->encap;
+				drule->vni = rs->vni;
+				if (rs->vtep.ss_family == AF_INET6)
+					inet_sockaddrip6(&rs->vtep, &drule->vtep.in6);
+				else if (rs->vtep.ss_family == AF_INET)
+					drule->vtep.ip = inet_sockaddrip4(&rs->vtep);
+				memcpy(drule->inner_dmac, rs->inner_mac,
+				       sizeof(drule->inner_dmac));
+			}
 		}
 	}
 }
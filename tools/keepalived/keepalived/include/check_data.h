@@ -82,6 +82,10 @@ typedef struct _real_server {
 							 */
 	char				*notify_up;	/* Script to launch when RS is added to LVS */
 	char				*notify_down;	/* Script to launch when RS is removed from LVS */
+	int				encap;		/* VXLAN/GENEVE encapsulation towards RS */
+	uint32_t			vni;
+	struct sockaddr_storage		vtep;		/* RS VTEP, RS address if unset */
+	uint8_t				inner_mac[6];	/* inner dest MAC, broadcast if unset */
 	int				alive;
 	list				failed_checkers;/* List of failed checkers */
 	int				set;		/* in the IPVS table */
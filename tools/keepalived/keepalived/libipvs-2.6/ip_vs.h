@@ -109,6 +109,7 @@
 #define IP_VS_CONN_F_BYPASS	0x0004		/* cache bypass */
 #define IP_VS_CONN_F_FULLNAT	0x0005		/* full nat mode */
 #define IP_VS_CONN_F_SNAT	0x0006		/* SNAT mode */
+#define IP_VS_CONN_F_OVERLAY	0x0007		/* VXLAN/GENEVE encapsulation */
 
 #define IP_VS_CONN_F_SYNC	0x0020		/* entry created by sync */
 #define IP_VS_CONN_F_HASHED	0x0040		/* hashed entry */
@@ -121,6 +122,13 @@
 #define IP_VS_CONN_F_TEMPLATE	0x1000		/* template, not connection */
 #define IP_VS_CONN_F_ONE_PACKET	0x2000		/* forward only one packet */
 
+/*
+ *      Real server overlay encapsulation, for OVERLAY and FULLNAT
+ */
+#define IP_VS_DEST_ENCAP_NONE	0
+#define IP_VS_DEST_ENCAP_VXLAN	1
+#define IP_VS_DEST_ENCAP_GENEVE	2
+
 #define IP_VS_SCHEDNAME_MAXLEN	16
 #define IP_VS_PENAME_MAXLEN	16
 #define IP_VS_IFNAME_MAXLEN	16
@@ -215,6 +223,12 @@ struct ip_vs_dest_user {
 	u_int32_t		l_threshold;	/* lower threshold */
 	u_int16_t		af;
 	union nf_inet_addr	addr;
+
+	/* overlay encapsulation */
+	u_int8_t		encap;		/* IP_VS_DEST_ENCAP_XXX */
+	u_int32_t		vni;
+	union nf_inet_addr	vtep;		/* outer destination */
+	u_int8_t		inner_dmac[6];	/* inner destination MAC */
 };
 
 struct ip_vs_laddr_kern {
@@ -375,6 +389,14 @@ struct ip_vs_dest_entry {
 	struct ip_vs_stats_user stats;
 	u_int16_t		af;
 	union nf_inet_addr	addr;
+
+	u_int8_t		encap;
+	u_int32_t		vni;
+	union nf_inet_addr	vtep;
+	u_int8_t		inner_dmac[6];
+
+	u_int32_t		rtt_us;		/* handshake RTT, EWMA */
+	u_int64_t		rtt_samples;
 };
 
 struct ip_vs_laddr_entry_kern {
@@ -93,7 +93,11 @@ typedef struct dpvs_servicedest_s {
 	memcpy(&X->addr, &Y->addr, sizeof(X->addr)); 		\
 	X->port             = Y->port; 				\
 	X->conn_flags       = Y->conn_flags; 			\
-	X->weight           = Y->weight;}
+	X->weight           = Y->weight; 			\
+	X->encap            = Y->encap; 			\
+	X->vni              = Y->vni; 				\
+	memcpy(&X->vtep, &Y->vtep, sizeof(X->vtep)); 		\
+	memcpy(X->inner_dmac, Y->inner_dmac, sizeof(X->inner_dmac));}
 
 #define IPRS_2_DPRS(X, Y) {					\
 	DST_CONVERT(X, Y) 					\
@@ -107,6 +111,8 @@ typedef struct dpvs_servicedest_s {
 	X->activeconns      = Y->actconns;			\
 	X->inactconns       = Y->inactconns;			\
 	X->persistconns     = Y->persistconns;			\
+	X->rtt_us           = Y->rtt_us;			\
+	X->rtt_samples      = Y->rtt_samples;			\
 	memcpy(&X->stats, &Y->stats, sizeof(X->stats));}
 
 void ipvs_service_entry_2_user(const ipvs_service_entry_t *entry, ipvs_service_t *user);
@@ -317,6 +323,47 @@ int ipvs_del_dest(ipvs_service_t *svc, ipvs_dest_t *dest)
 	return dpvs_setsockopt(DPVS_SO_SET_DELDEST, &svcdest, sizeof(svcdest)); 
 }
 
+static int ipvs_dests_batch(sockoptid_t cmd, ipvs_service_t *svc,
+			    ipvs_dest_t *dests, int n, int *errs)
+{
+	struct dpvs_sockopt_batch *batch;
+	dpvs_servicedest_t svcdest;
+	struct dp_vs_service_user *dpvs_svc_ptr = &svcdest.svc;
+	struct dp_vs_dest_user *dpvs_dest_ptr = &svcdest.dest;
+	ipvs_dest_t *dest;
+	int i, ret;
+
+	batch = dpvs_sockopt_batch_alloc();
+	if (!batch)
+		return ENOMEM;
+
+	IPVS_2_DPVS(dpvs_svc_ptr, svc);
+	for (i = 0; i < n; i++) {
+		dest = &dests[i];
+		IPRS_2_DPRS(dpvs_dest_ptr, dest);
+		ret = dpvs_sockopt_batch_add(batch, cmd, &svcdest, sizeof(svcdest));
+		if (ret)
+			goto out;
+	}
+
+	ret = dpvs_sockopt_batch_commit(batch, 0, errs);
+
+out:
+	dpvs_sockopt_batch_free(batch);
+	return ret;
+}
+
+/* add/remove destinations in one request, errcode of each is in @errs */
+int ipvs_add_dests(ipvs_service_t *svc, ipvs_dest_t *dests, int n, int *errs)
+{
+	return ipvs_dests_batch(DPVS_SO_SET_ADDDEST, svc, dests, n, errs);
+}
+
+int ipvs_del_dests(ipvs_service_t *svc, ipvs_dest_t *dests, int n, int *errs)
+{
+	return ipvs_dests_batch(DPVS_SO_SET_DELDEST, svc, dests, n, errs);
+}
+
 static void ipvs_fill_laddr_conf(ipvs_service_t *svc, ipvs_laddr_t *laddr, 
                                  struct dp_vs_laddr_conf *conf)
 {
@@ -914,7 +961,7 @@ ipvs_daemon_t *ipvs_get_daemon(void)
 
 void ipvs_close(void)
 {
-    //close(sockfd);
+	dpvs_sockopt_close();
 }
 
 
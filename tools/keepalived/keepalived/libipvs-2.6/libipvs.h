@@ -42,7 +42,10 @@
 #define OPT_IFNAME		0x4000000
 #define OPT_SOCKPAIR		0x8000000
 #define OPT_HASHTAG		0x10000000
-#define NUMBER_OF_OPT		29
+#define OPT_ENCAP		0x20000000
+#define OPT_VTEP		0x40000000
+#define OPT_INNERMAC		0x80000000
+#define NUMBER_OF_OPT		32
 
 #define MINIMUM_IPVS_VERSION_MAJOR      1
 #define MINIMUM_IPVS_VERSION_MINOR      1
@@ -119,6 +122,11 @@ extern int ipvs_update_dest(ipvs_service_t *svc, ipvs_dest_t *dest);
 /* remove a destination server from a service */
 extern int ipvs_del_dest(ipvs_service_t *svc, ipvs_dest_t *dest);
 
+/* add/remove n destinations of a service in one batch request,
+ * errcode of each destination is in errs[] (optional) */
+extern int ipvs_add_dests(ipvs_service_t *svc, ipvs_dest_t *dests, int n, int *errs);
+extern int ipvs_del_dests(ipvs_service_t *svc, ipvs_dest_t *dests, int n, int *errs);
+
 extern struct ip_vs_conn_array* ip_vs_get_conns(const struct ip_vs_conn_req *req);
 
 extern int ipvs_add_laddr(ipvs_service_t *svc, ipvs_laddr_t * laddr);
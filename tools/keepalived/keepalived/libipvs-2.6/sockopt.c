@@ -3,11 +3,76 @@
 #include <errno.h>
 #include <malloc.h>
 #include <pthread.h>
+#include <stdbool.h>
 #include <unistd.h>
 #include "common.h"
 
 #define UNIX_DOMAIN "/var/run/dpvs_ctrl"
 
+/*
+ * one connection per process, reused by all requests. it's reopened
+ * after fork, or if dpvs closed it (e.g., restarted, or an old dpvs
+ * which closes after each reply).
+ */
+static pthread_mutex_t sockopt_lock = PTHREAD_MUTEX_INITIALIZER;
+static int sockopt_fd = -1;
+static pid_t sockopt_pid = 0;
+
+/* deferred mode */
+static struct dpvs_sockopt_batch *sockopt_defer = NULL;
+static uint32_t sockopt_defer_flags = 0;
+static int *sockopt_defer_errs = NULL;
+static int sockopt_defer_cnt = 0;
+
+static int sockopt_connect(void)
+{
+    struct sockaddr_un clt_addr;
+    int clt_fd;
+
+    if (sockopt_fd >= 0 && sockopt_pid == getpid())
+        return sockopt_fd;
+
+    if (sockopt_fd >= 0)
+        close(sockopt_fd); /* inherited from parent */
+    sockopt_fd = -1;
+
+    memset(&clt_addr, 0, sizeof(struct sockaddr_un));
+    clt_addr.sun_family = AF_UNIX;
+    strncpy(clt_addr.sun_path, UNIX_DOMAIN, sizeof(clt_addr.sun_path) - 1);
+
+    clt_fd = socket(PF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (clt_fd < 0) {
+        fprintf(stderr, "[%s] fail to create socket: %s\n",
+                __func__, strerror(errno));
+        return -ESOCKOPT_IO;
+    }
+
+    if (-1 == connect(clt_fd, (struct sockaddr *)&clt_addr, sizeof(clt_addr))) {
+        fprintf(stderr, "[%s] scoket msg connection error: %s\n",
+                __func__, strerror(errno));
+        close(clt_fd);
+        return -ESOCKOPT_IO;
+    }
+
+    sockopt_fd = clt_fd;
+    sockopt_pid = getpid();
+    return sockopt_fd;
+}
+
+static void sockopt_disconnect(void)
+{
+    if (sockopt_fd >= 0 && sockopt_pid == getpid())
+        close(sockopt_fd);
+    sockopt_fd = -1;
+}
+
+void dpvs_sockopt_close(void)
+{
+    pthread_mutex_lock(&sockopt_lock);
+    sockopt_disconnect();
+    pthread_mutex_unlock(&sockopt_lock);
+}
+
 static inline int sockopt_msg_send(int clt_fd,
         const struct dpvs_sock_msg *hdr,
         const char *data, int data_len)
@@ -21,6 +86,8 @@ static inline int sockopt_msg_send(int clt_fd,
 
     len = sizeof(struct dpvs_sock_msg);
     res = sendn(clt_fd, hdr, len, MSG_NOSIGNAL);
+    if (res < 0 && (errno == EPIPE || errno == ECONNRESET))
+        return -ESOCKOPT_UNKOWN; /* closed by server */
     if (len != res) {
         fprintf(stderr, "[%s] socket msg header send error -- %d/%d sent\n",
                 __func__, res, len);
@@ -29,6 +96,8 @@ static inline int sockopt_msg_send(int clt_fd,
 
     if (data && data_len) {
         res = sendn(clt_fd, data, data_len, MSG_NOSIGNAL);
+        if (res < 0 && (errno == EPIPE || errno == ECONNRESET))
+            return -ESOCKOPT_UNKOWN;
         if (data_len != res) {
             fprintf(stderr, "[%s] scoket msg body send error -- %d/%d sent\n",
                     __func__, res, data_len);
@@ -39,7 +108,7 @@ static inline int sockopt_msg_send(int clt_fd,
     return 0;
 }
 
-static inline int sockopt_msg_recv(int clt_fd, struct dpvs_sock_msg_reply *reply_hdr, 
+static inline int sockopt_msg_recv(int clt_fd, struct dpvs_sock_msg_reply *reply_hdr,
         void **out, size_t *out_len)
 {
     void *msg = NULL;
@@ -59,6 +128,9 @@ static inline int sockopt_msg_recv(int clt_fd, struct dpvs_sock_msg_reply *reply
     memset(reply_hdr, 0, len);
     res = readn(clt_fd, reply_hdr, len);
     if (len != res) {
+        /* connection closed (or reset) before request handled */
+        if (res == 0 || (res < 0 && errno == ECONNRESET))
+            return -ESOCKOPT_UNKOWN;
         fprintf(stderr, "[%s] socket msg header recv error -- %d/%d recieved\n",
                 __func__, res, len);
         return -ESOCKOPT_IO;
@@ -107,75 +179,80 @@ static inline int sockopt_msg_recv(int clt_fd, struct dpvs_sock_msg_reply *reply
     return ESOCKOPT_OK;
 }
 
-int dpvs_setsockopt(sockoptid_t cmd, const void *in, size_t in_len)
+/* send one request and wait for its reply, caller holds sockopt_lock */
+static int sockopt_request(enum sockopt_type type, sockoptid_t cmd,
+        const void *in, size_t in_len, void **out, size_t *out_len)
 {
-    struct dpvs_sock_msg *msg;
+    struct dpvs_sock_msg msg;
     struct dpvs_sock_msg_reply reply_hdr;
-    struct sockaddr_un clt_addr;
-    int clt_fd;
-    int res;
-    size_t msg_len;
-
-    memset(&clt_addr, 0, sizeof(struct sockaddr_un));
-    clt_addr.sun_family = AF_UNIX;
-    strncpy(clt_addr.sun_path, UNIX_DOMAIN, sizeof(clt_addr.sun_path) - 1);
-
-    msg_len = sizeof(struct dpvs_sock_msg);
-    msg = malloc(msg_len);
-    if (NULL == msg) {
-        fprintf(stderr, "[%s] no memory\n", __func__);
-        return -ESOCKOPT_INVAL;
+    bool reused, sent = false;
+    int clt_fd, res;
+
+retry:
+    reused = (sockopt_fd >= 0 && sockopt_pid == getpid());
+    clt_fd = sockopt_connect();
+    if (clt_fd < 0)
+        return clt_fd;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.version = SOCKOPT_VERSION;
+    msg.id = cmd;
+    msg.type = type;
+    msg.len = in_len;
+
+    res = sockopt_msg_send(clt_fd, &msg, in, in_len);
+    if (!res) {
+        sent = true;
+        res = sockopt_msg_recv(clt_fd, &reply_hdr, out, out_len);
     }
 
-    clt_fd = socket(PF_UNIX, SOCK_STREAM, 0);
-    res = connect(clt_fd, (struct sockaddr *)&clt_addr, sizeof(clt_addr));
-    if (-1 == res) {
-        fprintf(stderr, "[%s] scoket msg connection error: %s\n",
-                __func__, strerror(errno));
-        free(msg);
+    switch (res) {
+    case ESOCKOPT_OK:
+        break;
+    case -ESOCKOPT_UNKOWN:
+        sockopt_disconnect();
+        /*
+         * peer closed the idle connection. a request sent may have been
+         * handled before, e.g., dpvs restarted, only GETs are replayed.
+         */
+        if (reused && (!sent || type == SOCKOPT_GET))
+            goto retry;
+        fprintf(stderr, "[%s] connection closed by server\n", __func__);
         return -ESOCKOPT_IO;
+    case -ESOCKOPT_IO:
+    case -ESOCKOPT_NOMEM:
+    case -ESOCKOPT_VERSION:
+        /* stream is out of sync */
+        sockopt_disconnect();
+        return res;
+    default:
+        /* errcode from server, connection is still usable */
+        return res;
     }
 
-    memset(msg, 0, msg_len);
-    msg->version = SOCKOPT_VERSION;
-    msg->id = cmd;
-    msg->type = SOCKOPT_SET;
-    msg->len = in_len;
-    res = sockopt_msg_send(clt_fd, msg, in, in_len);
-
-    free(msg);
-    msg = NULL;
+    return ESOCKOPT_OK;
+}
 
-    if (res) {
-        close(clt_fd);
-        return res;
-    }
+static int sockopt_defer_flush(void);
 
-    res = sockopt_msg_recv(clt_fd, &reply_hdr, NULL, NULL);
-    if (res) {
-        close(clt_fd);
-        return res;
-    }
+int dpvs_setsockopt(sockoptid_t cmd, const void *in, size_t in_len)
+{
+    int res;
 
-    if (reply_hdr.errcode) {
-        fprintf(stderr, "[%s] Server error: %s\n", __func__, reply_hdr.errstr);
-        close(clt_fd);
-        return reply_hdr.errcode;
-    }
+    pthread_mutex_lock(&sockopt_lock);
+    if (sockopt_defer)
+        res = dpvs_sockopt_batch_add(sockopt_defer, cmd, in, in_len);
+    else
+        res = sockopt_request(SOCKOPT_SET, cmd, in, in_len, NULL, NULL);
+    pthread_mutex_unlock(&sockopt_lock);
 
-    close(clt_fd);
-    return ESOCKOPT_OK;
+    return res;
 }
 
 int dpvs_getsockopt(sockoptid_t cmd, const void *in, size_t in_len,
         void **out, size_t *out_len)
 {
-    struct dpvs_sock_msg *msg;
-    struct dpvs_sock_msg_reply reply_hdr;
-    struct sockaddr_un clt_addr;
-    int clt_fd;
     int res;
-    size_t msg_len;
 
     if (NULL == out || NULL == out_len) {
         fprintf(stderr, "[%s] no pointer for info return\n", __func__);
@@ -184,53 +261,227 @@ int dpvs_getsockopt(sockoptid_t cmd, const void *in, size_t in_len,
     *out = NULL;
     *out_len = 0;
 
-    memset(&clt_addr, 0, sizeof(struct sockaddr_un));
-    clt_addr.sun_family = AF_UNIX;
-    strncpy(clt_addr.sun_path, UNIX_DOMAIN, sizeof(clt_addr.sun_path) - 1);
+    pthread_mutex_lock(&sockopt_lock);
+    res = sockopt_defer_flush();
+    if (!res)
+        res = sockopt_request(SOCKOPT_GET, cmd, in, in_len, out, out_len);
+    pthread_mutex_unlock(&sockopt_lock);
 
-    msg_len = sizeof(struct dpvs_sock_msg);
-    msg = malloc(msg_len);
-    if (NULL == msg) {
-        fprintf(stderr, "[%s] no memory\n", __func__);
-        return -ESOCKOPT_NOMEM;
+    return res;
+}
+
+/////////////////////////////// batch ///////////////////////////////////////////
+
+struct dpvs_sockopt_batch *dpvs_sockopt_batch_alloc(void)
+{
+    struct dpvs_sockopt_batch *batch;
+
+    batch = calloc(1, sizeof(*batch));
+    if (!batch)
+        return NULL;
+
+    batch->size = SOCKOPT_MSG_BUFFER_SIZE;
+    batch->hdr = calloc(1, batch->size);
+    if (!batch->hdr) {
+        free(batch);
+        return NULL;
     }
+    batch->len = sizeof(struct dpvs_sock_batch_hdr);
 
-    clt_fd = socket(PF_UNIX, SOCK_STREAM, 0);
-    res = connect(clt_fd, (struct sockaddr*)&clt_addr, sizeof(clt_addr));
-    if (-1 == res) {
-        fprintf(stderr, "[%s] scoket msg connection error: %s\n",
-                __func__, strerror(errno));
-        free(msg);
-        return -ESOCKOPT_IO;
+    return batch;
+}
+
+void dpvs_sockopt_batch_free(struct dpvs_sockopt_batch *batch)
+{
+    if (!batch)
+        return;
+    free(batch->hdr);
+    free(batch);
+}
+
+static inline void sockopt_batch_reset(struct dpvs_sockopt_batch *batch)
+{
+    batch->hdr->nitem = 0;
+    batch->len = sizeof(struct dpvs_sock_batch_hdr);
+}
+
+int dpvs_sockopt_batch_add(struct dpvs_sockopt_batch *batch, sockoptid_t cmd,
+        const void *in, size_t in_len)
+{
+    struct dpvs_sock_batch_item *item;
+    size_t need, size;
+    void *hdr;
+
+    if (!batch || (in_len && !in) || in_len > UINT32_MAX)
+        return -ESOCKOPT_INVAL;
+    if (batch->hdr->nitem >= SOCKOPT_BATCH_MAX)
+        return -ESOCKOPT_INVAL;
+
+    need = batch->len + SOCKOPT_BATCH_ITEM_SIZE(in_len);
+    if (need > batch->size) {
+        for (size = batch->size; size < need; size <<= 1)
+            ;
+        hdr = realloc(batch->hdr, size);
+        if (!hdr)
+            return -ESOCKOPT_NOMEM;
+        batch->hdr = hdr;
+        batch->size = size;
     }
 
-    memset(msg, 0, msg_len);
-    msg->version = SOCKOPT_VERSION;
-    msg->id = cmd;
-    msg->type = SOCKOPT_GET;
-    msg->len = in_len;
-    res = sockopt_msg_send(clt_fd, msg, in, in_len);
+    item = (void *)batch->hdr + batch->len;
+    memset(item, 0, SOCKOPT_BATCH_ITEM_SIZE(in_len));
+    item->id = cmd;
+    item->len = in_len;
+    if (in_len)
+        memcpy(item->data, in, in_len);
 
-    free(msg);
-    msg = NULL;
+    batch->len = need;
+    batch->hdr->nitem++;
 
-    if (res) {
-        close(clt_fd);
+    return ESOCKOPT_OK;
+}
+
+/* caller holds sockopt_lock */
+static int sockopt_batch_commit(struct dpvs_sockopt_batch *batch,
+        uint32_t flags, int *errs)
+{
+    struct dpvs_sock_batch_reply *reply = NULL;
+    size_t reply_len = 0;
+    uint32_t nitem = batch->hdr->nitem;
+    int res;
+
+    if (!nitem)
+        return ESOCKOPT_OK;
+
+    batch->hdr->flags = flags;
+    res = sockopt_request(SOCKOPT_BATCH, 0, batch->hdr, batch->len,
+                          (void **)&reply, &reply_len);
+    if (res)
         return res;
+
+    if (!reply || reply_len < sizeof(*reply) + nitem * sizeof(int) ||
+            reply->nitem != nitem) {
+        fprintf(stderr, "[%s] invalid batch reply\n", __func__);
+        free(reply);
+        return -ESOCKOPT_INVAL;
     }
 
-    res = sockopt_msg_recv(clt_fd, &reply_hdr, out, out_len);
-    if (res) {
-        close(clt_fd);
+    if (errs)
+        memcpy(errs, reply->errcode, nitem * sizeof(int));
+
+    free(reply);
+    sockopt_batch_reset(batch);
+    return ESOCKOPT_OK;
+}
+
+/*
+ * return ESOCKOPT_OK if the batch is handled by dpvs, and errcode of
+ * each item is in @errs, or errcode if the batch is rejected as a whole.
+ * the batch is emptied after handled.
+ */
+int dpvs_sockopt_batch_commit(struct dpvs_sockopt_batch *batch,
+        uint32_t flags, int *errs)
+{
+    int res;
+
+    if (!batch)
+        return -ESOCKOPT_INVAL;
+
+    pthread_mutex_lock(&sockopt_lock);
+    res = sockopt_batch_commit(batch, flags, errs);
+    pthread_mutex_unlock(&sockopt_lock);
+
+    return res;
+}
+
+/* caller holds sockopt_lock */
+static int sockopt_defer_flush(void)
+{
+    uint32_t nitem;
+    int *errs;
+    int res;
+
+    if (!sockopt_defer || !(nitem = dpvs_sockopt_batch_count(sockopt_defer)))
+        return ESOCKOPT_OK;
+
+    errs = realloc(sockopt_defer_errs, (sockopt_defer_cnt + nitem) * sizeof(int));
+    if (!errs)
+        return -ESOCKOPT_NOMEM;
+    sockopt_defer_errs = errs;
+
+    res = sockopt_batch_commit(sockopt_defer, sockopt_defer_flags,
+                               errs + sockopt_defer_cnt);
+    if (res)
         return res;
+
+    sockopt_defer_cnt += nitem;
+    return ESOCKOPT_OK;
+}
+
+int dpvs_sockopt_batch_begin(uint32_t flags)
+{
+    int res = ESOCKOPT_OK;
+
+    pthread_mutex_lock(&sockopt_lock);
+    if (sockopt_defer) {
+        res = -ESOCKOPT_INVAL;
+        goto out;
     }
 
-    if (reply_hdr.errcode) {
-        fprintf(stderr, "[%s] Server error: %s\n", __func__, reply_hdr.errstr);
-        close(clt_fd);
-        return reply_hdr.errcode;
+    sockopt_defer = dpvs_sockopt_batch_alloc();
+    if (!sockopt_defer) {
+        res = -ESOCKOPT_NOMEM;
+        goto out;
     }
+    sockopt_defer_flags = flags;
+    sockopt_defer_errs = NULL;
+    sockopt_defer_cnt = 0;
 
-    close(clt_fd);
-    return ESOCKOPT_OK;
+out:
+    pthread_mutex_unlock(&sockopt_lock);
+    return res;
+}
+
+int dpvs_sockopt_batch_queued(void)
+{
+    int n = 0;
+
+    pthread_mutex_lock(&sockopt_lock);
+    if (sockopt_defer)
+        n = sockopt_defer_cnt + dpvs_sockopt_batch_count(sockopt_defer);
+    pthread_mutex_unlock(&sockopt_lock);
+
+    return n;
+}
+
+int dpvs_sockopt_batch_end(int **errs, int *nerrs)
+{
+    int res;
+
+    if (errs)
+        *errs = NULL;
+    if (nerrs)
+        *nerrs = 0;
+
+    pthread_mutex_lock(&sockopt_lock);
+    if (!sockopt_defer) {
+        pthread_mutex_unlock(&sockopt_lock);
+        return -ESOCKOPT_INVAL;
+    }
+
+    res = sockopt_defer_flush();
+    if (res == ESOCKOPT_OK && errs && nerrs) {
+        *errs = sockopt_defer_errs;
+        *nerrs = sockopt_defer_cnt;
+        sockopt_defer_errs = NULL;
+    }
+
+    free(sockopt_defer_errs);
+    dpvs_sockopt_batch_free(sockopt_defer);
+    sockopt_defer = NULL;
+    sockopt_defer_errs = NULL;
+    sockopt_defer_cnt = 0;
+    pthread_mutex_unlock(&sockopt_lock);
+
+    return res;
 }
@@ -26,6 +26,7 @@ typedef uint32_t sockoptid_t;
 enum sockopt_type {
     SOCKOPT_GET = 0,
     SOCKOPT_SET,
+    SOCKOPT_BATCH,
     SOCKOPT_TYPE_MAX,
 };
 
@@ -47,10 +48,71 @@ struct dpvs_sock_msg_reply {
     char data[0];
 };
 
+/* batch of SET msgs, see include/ctrl.h */
+#define SOCKOPT_BATCH_F_STOP_ON_ERR     0x1
+#define SOCKOPT_BATCH_MAX               (1 << 20)
+#define SOCKOPT_BATCH_ITEM_SIZE(len)    \
+    ((sizeof(struct dpvs_sock_batch_item) + (len) + 7) & ~7UL)
+
+struct dpvs_sock_batch_hdr {
+    uint32_t nitem;
+    uint32_t flags;
+    char items[0];
+};
+
+struct dpvs_sock_batch_item {
+    sockoptid_t id;
+    uint32_t len;
+    char data[0];
+};
+
+struct dpvs_sock_batch_reply {
+    uint32_t nitem;
+    uint32_t ndone;
+    int errcode[0];
+};
+
+struct dpvs_sockopt_batch {
+    size_t len;
+    size_t size;
+    struct dpvs_sock_batch_hdr *hdr;
+};
+
 int dpvs_setsockopt(sockoptid_t cmd, const void *in, size_t in_len);
 int dpvs_getsockopt(sockoptid_t cmd, const void *in, size_t in_len,
         void **out, size_t *out_len);
 
+/* the connection is kept and reused, close it explicitly if needed */
+void dpvs_sockopt_close(void);
+
+/*
+ * batch api: SET msgs added are sent in one request and applied by
+ * dpvs in order, @errs (optional, nitem entries) gets errcode of each.
+ */
+struct dpvs_sockopt_batch *dpvs_sockopt_batch_alloc(void);
+int dpvs_sockopt_batch_add(struct dpvs_sockopt_batch *batch, sockoptid_t cmd,
+        const void *in, size_t in_len);
+int dpvs_sockopt_batch_commit(struct dpvs_sockopt_batch *batch,
+        uint32_t flags, int *errs);
+void dpvs_sockopt_batch_free(struct dpvs_sockopt_batch *batch);
+
+static inline uint32_t dpvs_sockopt_batch_count(const struct dpvs_sockopt_batch *batch)
+{
+    return batch->hdr->nitem;
+}
+
+/*
+ * deferred mode: dpvs_setsockopt() between begin and end is queued to a
+ * batch instead of being sent, dpvs_getsockopt() sends the pending ones
+ * first to keep the order. dpvs_sockopt_batch_end() sends the rest, and
+ * gives errcode of all queued msgs in @errs (@nerrs entries), which must
+ * be freed by caller.
+ */
+int dpvs_sockopt_batch_begin(uint32_t flags);
+int dpvs_sockopt_batch_end(int **errs, int *nerrs);
+/* number of msgs queued since begin */
+int dpvs_sockopt_batch_queued(void);
+
 static inline void dpvs_sockopt_msg_free(void *msg)
 {
     free(msg);